@@ -78,12 +78,65 @@ struct s_Opus
   unsigned getBlockAtSampleId(int sid) const;
 };
 
+/**
+ * @brief The s_OpusStream struct streams Opus audio-data from a baked file (written by "s_Opus::write", alone or inside a baked archive).
+ * Only the block index is loaded (16 bytes per block). The encoded blocks are read on demand, ahead of the reader:
+ * - where available, the file is memory-mapped: the blocks are read in place (zero-copy). An I/O thread reads the pages ahead of the reader, and drops the pages behind it.
+ *   A block is acquired once its pages are resident, so that the reader never waits for the disk.
+ * - otherwise, an I/O thread reads the blocks into a cache of "k_cacheBlockCount" blocks.
+ * In both cases, the resident memory of a stream is bounded to about "k_cacheBlockCount" blocks.
+ * The blocks are expected in sequence (the next block after the last one is the first one, for gapless looping). Another block restarts the read-ahead.
+ * The stream has a single reader (the decoder of one sound): a stream cannot be played by 2 sounds at the same time.
+ */
+struct s_OpusStream
+{
+  static const int      m_freq = 48000;
+  static const unsigned k_cacheBlockCount = 16; ///< blocks read ahead (about 1 s of sound with 60 ms blocks). Power of 2.
+
+  unsigned m_nSamples = 0;
+  bool     m_stereo = false;
+
+  struct s_blockRef
+  {
+    uint64_t m_offset; ///< position of the encoded data in the file
+    uint32_t m_size;
+    int      m_sampleStart; ///< sample-index of the first encoded sample.
+  };
+  std::vector<s_blockRef> m_blocks;
+
+  s_OpusStream() {}
+  s_OpusStream(const s_OpusStream &) = delete;
+  ~s_OpusStream() { close(); }
+
+  s_OpusStream &operator =(const s_OpusStream &) = delete;
+
+  bool open(const std::string &filename, uint64_t offset = 0, bool allowMapping = true); ///< Open a baked file, where the Opus audio-data starts at "offset". It starts the I/O thread.
+  void close(); ///< Close the file. Warning: unsafe. Don't use it while a sound is playing the stream in the audioContext.
+  bool isOpen() const { return m_io != nullptr; }
+  bool isMapped() const;
+
+  unsigned getBlockAtSampleId(int sid) const;
+
+  /// Get the encoded data of a block (valid until the next call), or nullptr if it is not read yet: retry later.
+  /// Called by the reader only (the decoder of the sound). It never waits for the I/O thread.
+  const uint8_t *acquireBlock(unsigned block, unsigned &size) const;
+
+  unsigned    readyAhead() const; ///< nbr of blocks, from the last acquired one, that "acquireBlock" returns without waiting for the I/O thread, or unsigned(-1) if it never waits.
+  std::size_t residentSize() const; ///< bytes of the file held in memory by the stream (cache, or resident pages of the mapping)
+
+protected:
+  struct s_io;
+  s_io *m_io = nullptr;
+};
+
 } // namespace "soundData"
 
 // ============================================================================
 
 /**
  * @brief The soundInterface class defines the interface (API) needed to be processed by the audio-context.
+ * The audio-context never locks the audio-thread: "sync" and "sample" can run at the same time, on different threads.
+ * The implementation is responsible to exchange its data safely between them (wait-free queues, atomics, ...).
  */
 class soundInterface
 {
@@ -93,18 +146,30 @@ public:
 
   /**
    * @brief synchronization point
-   * Called outside of the sound-thread, to exchange safely data between the audio-thread and other threads.
+   * Called outside of the sound-thread (by "audioContext::addSound" and "audioContext::updateSystem"), to send and receive data to/from the audio-thread.
+   * It is called while the audio-thread is running, so the data must be exchanged with thread-safe primitives.
    */
   virtual void sync() = 0;
 
   /**
    * @brief raw sampling by the audio-thread
    * Called inside the sound-thread, when the audio-thread requires stereo-data (LR, LR, LR, ...)
+   * It must not block (no lock, no allocation, no I/O).
    * @param outBufferAdd audio buffer (data must be 'added')
    * @param sampleCount (number of samples (1 sample is 2 floats, representing the left and right chanel data)
    * @param sampleFraq (frequency required for the out buffer
    */
   virtual void sample(float* __restrict outBufferAdd, unsigned sampleCount, int sampleFreq) = 0;
+
+  /**
+   * @brief background decoding (optional)
+   * The decoder workers of the audio-context (see "audioContext::startDecoders") decode the compressed audio-data ahead of the play cursor,
+   * so that "sample" only copies and mixes the decoded data. These methods are called by the workers, while "sync" and "sample" run on other threads.
+   * A sound is never served by 2 workers at the same time.
+   */
+  virtual void     setBackgroundDecoding(bool enabled) { (void)enabled; } ///< called by the audio-context (game-thread): when disabled, "sample" must decode the data itself.
+  virtual unsigned decodedAhead() const { return unsigned(-1); } ///< nbr of decoded samples ahead of the play cursor, or unsigned(-1) if there is nothing to decode. The workers serve first the lowest value.
+  virtual bool     decode() { return false; } ///< decode the next chunk (a few ms) of audio-data. Returns false if nothing was decoded (the encoded data is not available yet, ...).
 };
 
 // ============================================================================
@@ -112,12 +177,19 @@ public:
 /**
  * @brief The audioContext class opens a SDL audio device and it feeds the audio data.
  * It plays sounds that have been recorded by "addSound(soundInterface*)". The caller is responsible to keep the given pointer valid.
- * The sound-list update and the sound-data change will take effect on the next "updateSystem()" call.
- * In particular, the sound-pointer can be freed after the call of "removeSound(...)" and "updateSystem()" in this order.
+ * The game-thread and the audio-thread communicate through wait-free queues, so that neither of them waits for the other:
+ * - the commands (add or remove a sound) are sent to the audio-thread, that applies them on its next callback,
+ * - the audio-thread sends back the slots of the removed sounds, and the profiling data.
+ * The sounds are stored in pre-allocated slots (maximum "k_soundSlotCount" sounds at the same time).
+ * The sound-data change will take effect on the next "updateSystem()" call.
+ * The sound-pointer can be freed after the call of "removeSound(...)", once "isReleased(...)" returns true (it is updated by "updateSystem()" and "stopSystem()").
+ * Optionally, decoder workers decode the compressed audio-data in background, so that the audio-thread never decodes (see "startDecoders").
  */
 class audioContext
 {
 public:
+  static const unsigned k_soundSlotCount = 256; ///< maximum number of sounds handled at the same time
+
   audioContext() {}
   ~audioContext() { stopSystem(); }
 
@@ -130,35 +202,89 @@ public:
    */
   bool startSystem(const char *deviceName, unsigned bufferMS = 33, SDL_AudioSpec *requiredAudioSpec = nullptr);
 
-  void updateSystem(); ///< sync with the audio-context (send the sound-list, send sound-data, receive play stats). To be called on the main application tick.
+  /**
+   * @brief create the audio-context without audio device (headless)
+   * The audio is generated by "renderOffline(...)", that runs the audio-callback on the calling thread.
+   * @param freq the sample frequency
+   * @param bufferSamples the maximum number of samples generated by one audio-callback (max 8192)
+   */
+  bool startOffline(int freq, unsigned bufferSamples = 1024);
+
+  /// Generate audio in offline mode (stereo, 16-bit signed integers), with one audio-callback per chunk of "bufferSamples" samples.
+  /// The calling thread plays the role of the audio-thread. It must not run concurrently with "stopSystem()".
+  void renderOffline(int16_t *outBufferLR, unsigned sampleCount);
 
-  void stopSystem(); ///< shut-down the audio-context and clear data.
+  void updateSystem(); ///< sync the sounds, receive the released slots and the play stats. To be called on the main application tick. It never waits for the audio-thread.
+
+  void stopSystem(); ///< shut-down the audio-context and clear data. The recorded sounds are kept (they will be played again by the next "startSystem"). The decoder workers are stopped.
+
+  /**
+   * @brief start the decoder workers
+   * The workers decode the compressed audio-data of the sounds ahead of their play cursor, into a ring-buffer per sound.
+   * They serve first the sounds with the least decoded data ahead (the closest to an underrun). Without workers, the audio-callback decodes the data itself.
+   * @param workerCount the nbr of threads
+   * @return false if the threads are not available
+   */
+  bool startDecoders(unsigned workerCount = 1);
+  void stopDecoders(); ///< stop the decoder workers. The audio-callback decodes the data itself again.
 
   const SDL_AudioSpec *getAudioSpec() const { return m_audioSpec; }
 
-  void addSound(soundInterface *sound); ///< add a sound playable by the audio. The sound is actually ready to be played once 'updateSystem()' is called.
-  void removeSound(soundInterface *sound); ///< remove a sound playable by the audio. The sound is actually removed on the next 'updateSystem()' call. Do not free it before !
+  bool addSound(soundInterface *sound); ///< add a sound playable by the audio. The sound is played from the next audio-callback. Returns false if all the slots are used.
+  void removeSound(soundInterface *sound); ///< remove a sound playable by the audio. The sound is removed on the next audio-callback. Do not free it before "isReleased(sound)" returns true !
+  bool isReleased(const soundInterface *sound) const; ///< returns true if the sound is not referenced by the audio-thread.
 
 protected:
   SDL_AudioDeviceID m_deviceID = 0;
   SDL_AudioSpec     *m_audioSpec = nullptr;
+  bool              m_isOffline = false;
+
+  enum e_slotState : uint8_t
+  {
+    SLOT_FREE,
+    SLOT_USED,
+    SLOT_RELEASING, ///< waiting for the acknowledgement of the audio-thread
+    SLOT_RELEASED,  ///< waiting for a decoder worker, that is still using the sound
+  };
+
+  struct s_slot
+  {
+    soundInterface *m_sound = nullptr;
+    e_slotState    m_state = SLOT_FREE;
+  };
+  std::array<s_slot, k_soundSlotCount> m_slots;
 
-  std::vector<soundInterface*> m_listSounds;
+  /// Sounds served by the decoder workers. A worker sets "m_busy" before it reads "m_sound", and clears it when it does not use the sound anymore.
+  struct s_decodeSlot
+  {
+    std::atomic<soundInterface*> m_sound = { nullptr };
+    std::atomic<bool>            m_busy = { false };
+  };
+  std::array<s_decodeSlot, k_soundSlotCount> m_decodeSlots;
+
+  struct s_decoderPool;
+  s_decoderPool *m_decoderPool = nullptr;
+
+  void _receiveReleasedSlots();
+  void _setBackgroundDecoding(bool enabled);
 
 #ifdef TRE_PROFILE
 protected:
   unsigned m_perf_nbrCall = 0;
   float    m_perf_elapsedTime = 0.f;
+  float    m_perf_maxElapsedTime = 0.f;
   float    m_perf_accElapsedTime = 0.f;
   float    m_perf_accGenTime = 0.f;
 public:
   unsigned getPerf_nbrCall() const { return m_perf_nbrCall; } ///< Nbr of calls of the audio callback, since the last sync.
   float    getPerf_total() const { return m_perf_elapsedTime; } ///< Elapsed time spent in the audio callback, since the last sync. (in seconds)
+  float    getPerf_max() const { return m_perf_maxElapsedTime; } ///< Maximum elapsed time spent in one audio callback, since the last sync. (in seconds)
   float    getPerf_load() const { return m_perf_accElapsedTime / std::max(m_perf_accGenTime, 1.e-6f); } ///< Compute load of the audio thread. = ElapsedTime / SoundTimeGenerated
 #else
 public:
   unsigned getPerf_nbrCall() const { return 0; }
   float    getPerf_total() const { return 0.f; }
+  float    getPerf_max() const { return 0.f; }
   float    getPerf_load() const { return 0.f; }
 #endif
 
@@ -166,18 +292,42 @@ public:
   static void getDevicesName(std::vector<std::string> &devices); ///< Helper, that gets the list of detected devices
 
 private:
+  struct s_command
+  {
+    enum e_type : uint8_t { CMD_ADD, CMD_REMOVE };
+    soundInterface *m_sound;
+    unsigned       m_slot;
+    e_type         m_type;
+  };
+
+#ifdef TRE_PROFILE
+  struct s_perf
+  {
+    unsigned m_nbrCall = 0;
+    float    m_elapsedTime = 0.f;
+    float    m_maxElapsedTime = 0.f;
+    float    m_genTime = 0.f;
+  };
+#endif
+
   struct s_audioCallbackContext
   {
-    std::vector<soundInterface*> ac_listSounds;
-    std::vector<float>           ac_bufferF32;
-    int                          ac_freq = 0;
-    unsigned                     ac_channels = 0;
+    // A slot holds at most one "add" and one "remove" in the queue before its release is received. So the queues cannot overflow.
+    spscQueue<s_command, 2 * k_soundSlotCount> ac_queueCommands; ///< game-thread -> audio-thread
+    spscQueue<unsigned, k_soundSlotCount>      ac_queueReleased; ///< audio-thread -> game-thread (released slots)
 #ifdef TRE_PROFILE
-    unsigned                     ac_perf_nbrCall = 0;
-    float                        ac_perf_elapsedTime = 0.f;
-    float                        ac_perf_genTime = 0.f;
+    spscQueue<s_perf, 16>                      ac_queuePerf;     ///< audio-thread -> game-thread
+    s_perf                                     ac_perf;
 #endif
 
+    arrayCounted<soundInterface*, k_soundSlotCount> ac_listSounds; ///< sounds to be played (dense list)
+    std::array<unsigned, k_soundSlotCount>          ac_listSlots; ///< slot of each sound of "ac_listSounds"
+    std::array<unsigned, k_soundSlotCount>          ac_slotToList; ///< index in "ac_listSounds" of each used slot
+    std::vector<float>                              ac_bufferF32;
+    int                                             ac_freq = 0;
+    unsigned                                        ac_channels = 0;
+
+    void receiveCommands();
     void run(uint8_t* stream, int len);
   };
   s_audioCallbackContext m_audioCallbackContext;
@@ -199,13 +349,23 @@ private:
  * The controls must define the two following methods:
  * - <control> mix(<control>, <control>, float cursor);
  * - <void> apply(float &valueL, float &valueR) const;
+ * The "apply" method must scale the values: it is evaluated on (1, 1) to get the gains of the left and right channels.
  *
  * The sampler is defining the following method and members
  * - <void> sample(<soundData>, <controls>, <controls>, float* outBufferAdd, unsigned sampleCount, int sampleFreq);
+ * The samplers process the audio by blocks, with SIMD kernels: the gains are computed from the controls on the block boundaries only.
  */
 namespace soundSampler
 {
 
+// Interpolation: ---
+
+enum e_interpolation
+{
+  INTERP_LINEAR, ///< linear interpolation. It is cheap, but it aliases when the sound is pitched up, and it dulls the high frequencies.
+  INTERP_SINC,   ///< polyphase windowed-sinc (32 taps, Kaiser window). When the sound is pitched up, the filter is stretched to cut the aliased frequencies.
+};
+
 // Controls: ---
 
 struct s_noControl
@@ -239,203 +399,210 @@ struct s_stereoControl
   }
 };
 
-// Samplers: ---
+// Gains: ---
 
-struct s_sampler_Raw
+/**
+ * @brief The s_blockGains struct holds the gains of the left and right channels, computed from the controls once per block of "k_blockSize" samples.
+ * In a block, the gains follow a quadratic ramp (fitted on the first, middle and last sample), that is exact for linear
+ * and bilinear controls (volume ramp, pan ramp, or both). It is checked on 2 other samples: if the check fails (non-smooth controls),
+ * the gains of the block are evaluated on each sample, and stored in a table.
+ * The gain of the i-th sample of the block "b" is "m_gain[b] + i * (m_slope[b] + i * m_curve[b])", or "m_table[m_tableId[b] * k_blockSize + i]" if "m_tableId[b]" is valid.
+ */
+struct s_blockGains
 {
-  float    m_cursor = 0.f;
-  bool     m_repet = false;
+  static const unsigned k_blockSize = 64;
+  static const unsigned k_blockCountMax = 128; ///< max 8192 samples per audio-callback
+  static const unsigned k_tableCount = 4; ///< max nbr of blocks with per-sample gains (then, the quadratic ramp is used)
+  static const uint8_t  k_noTable = 0xFF;
 
-  float   m_valuePeak = 0.f; ///< [out]
-  float   m_valueRMS = 0.f;  ///< [out]
+  std::array<float, k_blockCountMax>   m_gainL, m_gainR;
+  std::array<float, k_blockCountMax>   m_slopeL, m_slopeR;
+  std::array<float, k_blockCountMax>   m_curveL, m_curveR;
+  std::array<uint8_t, k_blockCountMax> m_tableId;
+  std::array<float, k_blockSize * k_tableCount> m_tableL, m_tableR;
 
-  /// "sample" returns stereo float audio stream, at "sampleFreq" Hz.
-  template<class _controls, typename _rawType>
-  void _sample(const soundData::s_RawSDL &data, const _controls &controlsStart, const _controls &controlsEnd,
-              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+  template<class _controls>
+  void compute(const _controls &controlsStart, const _controls &controlsEnd, unsigned sampleCount)
   {
-    TRE_ASSERT(SDL_AUDIO_BITSIZE(data.m_format) / 8 == sizeof(_rawType));
-
-    const float                 freqRatio = float(data.m_freq) / float(sampleFreq);
-    const unsigned              dataSampleCount = data.m_nSamples;
-    const int                   dataSampleCountM2 = int(dataSampleCount) - 2;
-    const _rawType * __restrict dataRawTyped = reinterpret_cast<const _rawType*>(data.m_rawData.data());
-    unsigned                    curSample = 0;
-    const float                 invSampleCountM1 = 1.f / (sampleCount - 1);
-    static const float          valueNormalizer = 1.f / float(std::numeric_limits<_rawType>::max());
-    const _rawType              mV = std::numeric_limits<_rawType>::max();
-
-    TRE_ASSERT(dataSampleCount != 0);
-    if (m_repet)
+    TRE_ASSERT(sampleCount <= k_blockSize * k_blockCountMax);
+    const float invSampleCountM1 = (sampleCount > 1) ? 1.f / (sampleCount - 1) : 0.f;
+    auto fnGains = [&](unsigned isample, float &gainL, float &gainR)
     {
-      while (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
-    }
-
-    m_valuePeak = 0.f;
-    m_valueRMS = 0.f;
-
-    while (m_cursor < dataSampleCount && curSample < sampleCount)
+      gainL = gainR = 1.f;
+      _controls::mix(controlsStart, controlsEnd, isample * invSampleCountM1).apply(gainL, gainR);
+    };
+    auto fnCheck = [](float gain, float gainRef, float scale) { return std::abs(gain - gainRef) <= 2.e-6f * scale + 1.e-12f; };
+
+    unsigned tableCount = 0;
+    float    gainL, gainR;
+    fnGains(0, gainL, gainR);
+    for (unsigned iblock = 0, iStart = 0; iStart < sampleCount; ++iblock, iStart += k_blockSize)
     {
-      if (data.m_stereo)
+      const unsigned length = std::min(k_blockSize, sampleCount - 1 - iStart); // the ramp ends on the first sample of the next block, or on the last sample
+      const unsigned iMid = length / 2;
+      float gainMidL = gainL, gainMidR = gainR, gainEndL = gainL, gainEndR = gainR;
+      if (length != 0)
       {
-        unsigned isample = 0;
-        float    localCursor = m_cursor;
-        while (localCursor < dataSampleCount && curSample < sampleCount)
-        {
-          const int localCursorInt = std::min(int(localCursor), dataSampleCountM2);
-          const float valueL_0 = float(dataRawTyped[2 * localCursorInt + 0]) * valueNormalizer;
-          const float valueR_0 = float(dataRawTyped[2 * localCursorInt + 1]) * valueNormalizer;
-          const float valueL_1 = float(dataRawTyped[2 * localCursorInt + 2]) * valueNormalizer;
-          const float valueR_1 = float(dataRawTyped[2 * localCursorInt + 3]) * valueNormalizer;
-          const float w_1 = localCursor - localCursorInt;
-          const float w_0 = 1.f - w_1;
-          float valueL = w_0 * valueL_0 + w_1 * valueL_1;
-          float valueR = w_0 * valueR_0 + w_1 * valueR_1;
-          _controls::mix(controlsStart, controlsEnd, curSample * invSampleCountM1).apply(valueL, valueR);
-          ++curSample;
-          *outBufferAdd++ += valueL;
-          *outBufferAdd++ += valueR;
-          m_valuePeak = std::max(m_valuePeak, std::max(std::abs(valueL), std::abs(valueR)));
-          m_valueRMS += 0.5f * (valueL * valueL + valueR * valueR);
-          localCursor = m_cursor + (++isample) * freqRatio;
-        }
-        m_cursor = localCursor;
+        fnGains(iStart + iMid, gainMidL, gainMidR);
+        fnGains(iStart + length, gainEndL, gainEndR);
       }
-      else
+
+      m_gainL[iblock] = gainL;
+      m_gainR[iblock] = gainR;
+      m_slopeL[iblock] = (length != 0) ? (gainEndL - gainL) / float(length) : 0.f;
+      m_slopeR[iblock] = (length != 0) ? (gainEndR - gainR) / float(length) : 0.f;
+      m_curveL[iblock] = m_curveR[iblock] = 0.f;
+      m_tableId[iblock] = k_noTable;
+
+      bool isSmooth = (length == 0);
+      if (length >= 4)
       {
-        unsigned isample = 0;
-        float    localCursor = m_cursor;
-        while (localCursor < dataSampleCount && curSample < sampleCount)
+        const float d1L = (gainMidL - gainL) / float(iMid),   d1R = (gainMidR - gainR) / float(iMid);
+        const float d2L = (gainEndL - gainL) / float(length), d2R = (gainEndR - gainR) / float(length);
+        m_curveL[iblock] = (d2L - d1L) / float(length - iMid);
+        m_curveR[iblock] = (d2R - d1R) / float(length - iMid);
+        m_slopeL[iblock] = d1L - m_curveL[iblock] * float(iMid);
+        m_slopeR[iblock] = d1R - m_curveR[iblock] * float(iMid);
+        const float scaleL = std::abs(gainL) + std::abs(gainMidL) + std::abs(gainEndL);
+        const float scaleR = std::abs(gainR) + std::abs(gainMidR) + std::abs(gainEndR);
+        isSmooth = true;
+        for (const unsigned i : { length / 4, (3 * length) / 4 })
         {
-          const int localCursorInt = std::min(int(localCursor), dataSampleCountM2);
-          const float value_0 = float(dataRawTyped[localCursorInt + 0]) * valueNormalizer;
-          const float value_1 = float(dataRawTyped[localCursorInt + 1]) * valueNormalizer;
-          const float w_1 = localCursor - localCursorInt;
-          const float w_0 = 1.f - w_1;
-          float valueL = w_0 * value_0 + w_1 * value_1;
-          float valueR = valueL;
-          _controls::mix(controlsStart, controlsEnd, curSample * invSampleCountM1).apply(valueL, valueR);
-          ++curSample;
-          *outBufferAdd++ += valueL;
-          *outBufferAdd++ += valueR;
-          m_valuePeak = std::max(m_valuePeak, std::max(std::abs(valueL), std::abs(valueR)));
-          m_valueRMS += 0.5f * (valueL * valueL + valueR * valueR);
-          localCursor = m_cursor + (++isample) * freqRatio;
+          float checkL, checkR;
+          fnGains(iStart + i, checkL, checkR);
+          isSmooth &= fnCheck(gainL + float(i) * (m_slopeL[iblock] + float(i) * m_curveL[iblock]), checkL, scaleL);
+          isSmooth &= fnCheck(gainR + float(i) * (m_slopeR[iblock] + float(i) * m_curveR[iblock]), checkR, scaleR);
         }
-        m_cursor = localCursor;
       }
-
-      if (m_repet)
+      if (!isSmooth && tableCount < k_tableCount)
       {
-        if (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
+        m_tableId[iblock] = uint8_t(tableCount);
+        for (unsigned i = 0; i < k_blockSize && iStart + i < sampleCount; ++i)
+          fnGains(iStart + i, m_tableL[tableCount * k_blockSize + i], m_tableR[tableCount * k_blockSize + i]);
+        ++tableCount;
       }
-    }
 
-    m_valueRMS = std::sqrt(m_valueRMS / sampleCount);
+      gainL = gainEndL;
+      gainR = gainEndR;
+    }
   }
+};
+
+// Samplers: ---
+
+struct s_sampler_Raw
+{
+  float           m_cursor = 0.f;
+  bool            m_repet = false;
+  e_interpolation m_interpolation = INTERP_LINEAR;
+
+  float   m_valuePeak = 0.f; ///< [out]
+  float   m_valueRMS = 0.f;  ///< [out]
 
   /// "sample" returns stereo float audio stream, at "sampleFreq" Hz.
   template<class _controls>
   void sample(const soundData::s_RawSDL &data, const _controls &controlsStart, const _controls &controlsEnd,
               float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
   {
-    if (data.m_format == AUDIO_S16)
-      _sample<_controls, int16_t>(data, controlsStart, controlsEnd, outBufferAdd, sampleCount, sampleFreq);
-    else if (data.m_format == AUDIO_S32)
-      _sample<_controls, int32_t>(data, controlsStart, controlsEnd, outBufferAdd, sampleCount, sampleFreq);
-    else
-      TRE_FATAL("soundSampler: the audio format (" << int(data.m_format) << ") for raw-sampling is not supported.");
+    s_blockGains gains;
+    gains.compute(controlsStart, controlsEnd, sampleCount);
+    sample(data, gains, outBufferAdd, sampleCount, sampleFreq);
   }
+
+  /// "sample" returns stereo float audio stream, at "sampleFreq" Hz, with the interpolation "m_interpolation".
+  void sample(const soundData::s_RawSDL &data, const s_blockGains &gains,
+              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq);
 };
 
+/**
+ * @brief The s_sampler_Opus struct samples Opus audio-data, that is decoded into a ring-buffer ahead of the play cursor.
+ * The ring is written by the decoder ("decode"), and read by the audio-thread ("sample"). They can run on different threads,
+ * without lock: the decoder is a worker of the audio-context (background decoding), or the audio-thread itself.
+ * The samples are indexed with the stream position, that keeps increasing when the sound loops (the decoder continues on the next lap, without gap).
+ * When the audio-thread needs data that is not in the ring (the cursor has been set), it sends a seek request to the decoder, that restarts
+ * with a pre-roll (blocks decoded before the target, and dropped, to settle the decoder state).
+ * The samples that are not decoded in time are played as silence (underrun), and the cursor continues.
+ */
 struct s_sampler_Opus
 {
-  s_sampler_Opus();
+  static const unsigned k_ringSize = 8192; ///< decoded samples (stereo) in the ring (170 ms at 48 kHz). Power of 2.
+  static const unsigned k_blockSizeMax = 2880; ///< max nbr of samples in an Opus block (60 ms at 48 kHz).
+  static const unsigned k_prerollBlockCount = 1; ///< nbr of blocks decoded and dropped before the target block, after a seek.
+
   ~s_sampler_Opus();
 
   float    m_cursor = 0.f;
   bool     m_repet = false;
 
-  OpusDecoder                        *m_decoder = nullptr;
-  unsigned                           m_decompressedSlot = unsigned(-1);
-  unsigned                           m_decompressedCount = unsigned(-1); ///< nbr of samples in the buffer. Maximun 2880 (60ms of sound at 48 kHz).
-  std::array<int16_t, 2880 * 2 + 16> m_decompressedBuffer; ///< decompressed data (extra data to handle linear-interpolation on the last element) [maximun size allowed]
+  float    m_valuePeak = 0.f; ///< [out]
+  float    m_valueRMS = 0.f;  ///< [out]
+  unsigned m_underrunCount = 0; ///< [out] nbr of samples played as silence, because they were not decoded in time. The silence while a seek is pending is not counted.
 
-  float   m_valuePeak = 0.f; ///< [out]
-  float   m_valueRMS = 0.f;  ///< [out]
+  std::atomic<bool> m_backgroundDecoding = { false }; ///< when false, "sample" decodes the data itself.
 
-  bool decodeSlot(const soundData::s_Opus &data, unsigned slot);
+  /// Decode the next block into the ring (called by a decoder worker, or by the audio-thread). Returns false if nothing was decoded.
+  bool decode(const soundData::s_Opus &data);
+  bool decode(const soundData::s_OpusStream &data); ///< (it returns false while the block is not read from the file)
 
-  /// "sample" returns stereo float audio stream, at "sampleFreq" Hz.
-  template<class _controls>
-  void sample(const soundData::s_Opus &data, const _controls &controlsStart, const _controls &controlsEnd,
+  /// Nbr of decoded samples ahead of the play cursor (0 if a seek is pending), or unsigned(-1) if there is nothing to decode (ring full, end of data, or no background decoding).
+  unsigned decodedAhead() const;
+
+  /// Check the data needed at the cursor, and send the seek request if needed (called by the audio-thread, also when the sound is not playing: it pre-rolls the data).
+  void prepare(const soundData::s_Opus &data) { _prepare(data.m_nSamples); }
+  void prepare(const soundData::s_OpusStream &data) { _prepare(data.m_nSamples); }
+
+  /// "sample" returns stereo float audio stream, at "sampleFreq" Hz. The data is a soundData::s_Opus or a soundData::s_OpusStream.
+  template<class _opusData, class _controls>
+  void sample(const _opusData &data, const _controls &controlsStart, const _controls &controlsEnd,
               float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
   {
-    const float        freqRatio = float(soundData::s_Opus::m_freq) / float(sampleFreq);
-    const unsigned     dataSampleCount = data.m_nSamples;
-    unsigned           curSample = 0;
-    const float        invSampleCountM1 = 1.f / (sampleCount - 1);
-    static const float valueNormalizer = 1.f / float(0x7FFF);
-
-    TRE_ASSERT(dataSampleCount != 0);
-    if (m_repet)
-    {
-      while (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
-    }
+    s_blockGains gains;
+    gains.compute(controlsStart, controlsEnd, sampleCount);
+    sample(data, gains, outBufferAdd, sampleCount, sampleFreq);
+  }
 
-    m_valuePeak = 0.f;
-    m_valueRMS = 0.f;
+  /// "sample" returns stereo float audio stream, at "sampleFreq" Hz, with linear interpolation.
+  void sample(const soundData::s_Opus &data, const s_blockGains &gains,
+              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq);
+  void sample(const soundData::s_OpusStream &data, const s_blockGains &gains,
+              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq);
 
-    while (m_cursor < dataSampleCount && curSample < sampleCount)
-    {
-      const int      cursorInt = int(m_cursor);
-      const unsigned targetSlot = data.getBlockAtSampleId(cursorInt);
-      if (targetSlot == unsigned(-1))
-      {
-        TRE_LOG("audio sampling: invalid input data from a soundData::s_Opus");
-        return; // bad data
-      }
-      if (!decodeSlot(data, targetSlot))
-      {
-        TRE_LOG("audio sampling: failed to decode slot " << targetSlot << " from a soundData::s_Opus");
-        return;
-      }
+protected:
+  std::vector<int16_t> m_ring; ///< stereo samples. Allocated on the first use (or by "allocate").
 
-      const int      dataDecodedSampleOffset = data.m_blokcs[targetSlot].m_sampleStart;
-      const unsigned dataDecodedSampleCount = std::min(m_decompressedCount, dataSampleCount - dataDecodedSampleOffset);
+  // written by the decoder, read by the audio-thread
+  std::atomic<uint32_t> m_ringGen = { 0 }; ///< seek-generation of the ring content
+  std::atomic<int64_t>  m_ringBegin = { 0 }; ///< stream position of the first decoded sample (after the last seek)
+  std::atomic<int64_t>  m_ringEnd = { 0 }; ///< stream position after the last decoded sample
+  std::atomic<bool>     m_decodeFinished = { false }; ///< the end of the data is decoded, and the sound does not loop
 
-      unsigned isample = 0;
-      float    localCursorOffset = m_cursor - dataDecodedSampleOffset;
-      float    localCursor = localCursorOffset;
-      while (localCursor < dataDecodedSampleCount && curSample < sampleCount)
-      {
-        const int localCursorInt = int(localCursor); // implicit std::trunc + float-to-int
-        const float valueL_0 = float(m_decompressedBuffer[2 * localCursorInt + 0]) * valueNormalizer;
-        const float valueR_0 = float(m_decompressedBuffer[2 * localCursorInt + 1]) * valueNormalizer;
-        const float valueL_1 = float(m_decompressedBuffer[2 * localCursorInt + 2]) * valueNormalizer;
-        const float valueR_1 = float(m_decompressedBuffer[2 * localCursorInt + 3]) * valueNormalizer;
-        const float w_1 = localCursor - localCursorInt;
-        const float w_0 = 1.f - w_1;
-        float valueL = w_0 * valueL_0 + w_1 * valueL_1;
-        float valueR = w_0 * valueR_0 + w_1 * valueR_1;
-        _controls::mix(controlsStart, controlsEnd, curSample * invSampleCountM1).apply(valueL, valueR);
-        ++curSample;
-        *outBufferAdd++ += valueL;
-        *outBufferAdd++ += valueR;
-        m_valuePeak = std::max(m_valuePeak, std::max(std::abs(valueL), std::abs(valueR)));
-        m_valueRMS += 0.5f * (valueL * valueL + valueR * valueR);
-        localCursor = localCursorOffset + (++isample) * freqRatio;
-      }
-      m_cursor += (localCursor - localCursorOffset);
+  // written by the audio-thread, read by the decoder
+  std::atomic<uint32_t> m_seekGen = { 0 };
+  std::atomic<int64_t>  m_seekPos = { 0 };
+  std::atomic<int64_t>  m_readPos = { 0 }; ///< stream position of the first sample still needed by the audio-thread
+  std::atomic<bool>     m_repetAhead = { false };
 
-      if (m_repet)
-      {
-        if (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
-      }
-    }
+  std::atomic<bool>     m_decodeLock = { false }; ///< taken by the thread that decodes (never waited for)
 
-    m_valueRMS = std::sqrt(m_valueRMS / sampleCount);
-  }
+  // audio-thread data
+  int64_t  m_lapOffset = 0; ///< stream position of the sample 0, in the current lap
+
+  // decoder data
+  OpusDecoder          *m_decoder = nullptr;
+  uint32_t             m_decodeGen = 0;
+  unsigned             m_decodeBlock = 0; ///< next block to decode
+  int64_t              m_decodeLapOffset = 0;
+  std::vector<int16_t> m_decodeBuffer;
+
+  template<class _opusData> bool _decode(const _opusData &data);
+  template<class _opusData> void _sample(const _opusData &data, const s_blockGains &gains, float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq);
+  void _prepare(unsigned dataSampleCount);
+
+  bool _isStreamed(int64_t pos) const; ///< the stream position is decoded, or will be decoded without seek (audio-thread)
+  void _follow(int64_t pos); ///< release the data before the stream position, or request a seek (audio-thread)
+
+public:
+  void allocate(); ///< allocate the ring and the decoder buffers. Call it out of the audio-thread.
 };
 
 } // namespace "soundSampler"
@@ -458,12 +625,15 @@ public:
   // audio-data
 public:
   void setAudioData(const soundData::s_RawSDL *audioD) { m_audioDataRaw = audioD; } ///< warning: unsafe. Don't use it while the sound is playing in the audioContext.
-  void setAudioData(const soundData::s_Opus *audioD) { m_audioDataOpus = audioD; } ///< warning: unsafe. Don't use it while the sound is playing in the audioContext.
-  const soundData::s_RawSDL *audioDataRaw() const { return m_audioDataRaw; }
-  const soundData::s_Opus   *audioDataOpus() const { return m_audioDataOpus; }
+  void setAudioData(const soundData::s_Opus *audioD) { m_audioDataOpus = audioD; ac_samplerOpus.allocate(); } ///< warning: unsafe. Don't use it while the sound is playing in the audioContext.
+  void setAudioData(const soundData::s_OpusStream *audioD) { m_audioDataOpusStream = audioD; ac_samplerOpus.allocate(); } ///< warning: unsafe. Don't use it while the sound is playing in the audioContext. The stream must not be played by another sound.
+  const soundData::s_RawSDL      *audioDataRaw() const { return m_audioDataRaw; }
+  const soundData::s_Opus        *audioDataOpus() const { return m_audioDataOpus; }
+  const soundData::s_OpusStream  *audioDataOpusStream() const { return m_audioDataOpusStream; }
 protected:
-  const soundData::s_RawSDL *m_audioDataRaw = nullptr;
-  const soundData::s_Opus   *m_audioDataOpus = nullptr;
+  const soundData::s_RawSDL      *m_audioDataRaw = nullptr;
+  const soundData::s_Opus        *m_audioDataOpus = nullptr;
+  const soundData::s_OpusStream  *m_audioDataOpusStream = nullptr;
 
   // control
 public:
@@ -474,6 +644,7 @@ public:
     unsigned  m_cursor = unsigned(-1);
     bool      m_isPlaying = false;
     bool      m_isRepeating = false;
+    soundSampler::e_interpolation m_interpolation = soundSampler::INTERP_LINEAR; ///< resampling quality (the Opus audio-data are always linearly interpolated)
 
     void     setTarget(const _controls &s, float delay = 0.f) { m_target = s; m_targetDelay = delay; }
     void     setCursor(unsigned pos) { m_cursor = pos; }
@@ -491,15 +662,30 @@ public:
     _controls m_playedControls; ///< last control values
     unsigned  m_playedSampleCursor = 0;
     unsigned  m_playedSampleCount = 0; ///< Sample count since the last 'sync'
+    unsigned  m_playedUnderrunCount = 0; ///< Sample count played as silence since the last 'sync', because the audio-data was not decoded in time
     float     m_playedLevelPeak = 0.f;
     float     m_playedLevelRMS = 0.f;
+
+    void accumulate(unsigned sampleCount, float levelPeak, float levelRMS)
+    {
+      const unsigned newCount = m_playedSampleCount + sampleCount;
+      if (newCount == 0) return;
+      m_playedLevelPeak = std::max(m_playedLevelPeak, levelPeak);
+      m_playedLevelRMS  = std::sqrt((m_playedLevelRMS * m_playedLevelRMS * m_playedSampleCount + levelRMS * levelRMS * sampleCount) / newCount);
+      m_playedSampleCount = newCount;
+    }
   };
 protected:
   s_feedback m_feedback;
 public:
   const s_feedback &feedback() const { return m_feedback; }
 
-  // safe data for the audio-callback. Resync them with 'sync' method.
+  // data exchanged with the audio-thread. The control is sent on 'sync', the feedback is sent on each 'sample'.
+protected:
+  spscQueue<s_control, 8>        m_queueControl; ///< game-thread -> audio-thread
+  spscQueue<s_feedback, 8>       m_queueFeedback; ///< audio-thread -> game-thread
+
+  // safe data for the audio-callback.
 protected:
   s_control                      ac_control;
   s_feedback                     ac_feedback;
@@ -511,40 +697,97 @@ public:
 
   virtual void sync() override
   {
-    // send
-    ac_control.m_isPlaying = m_control.m_isPlaying;
-    ac_control.m_isRepeating = m_control.m_isRepeating;
-    ac_samplerRaw.m_repet = m_control.m_isRepeating;
-    ac_samplerOpus.m_repet = m_control.m_isRepeating;
-
-    if (m_control.m_targetDelay >= 0.f)
+    // send (the one-shot requests are kept until they are sent)
+    if (m_queueControl.push(m_control))
     {
-      ac_control.m_target = m_control.m_target;
-      ac_control.m_targetDelay = m_control.m_targetDelay;
       m_control.m_targetDelay = -1.f;
-    }
-    if (m_control.m_cursor != unsigned(-1))
-    {
-      ac_control.m_cursor = m_control.m_cursor;
-      ac_samplerRaw.m_cursor = float(m_control.m_cursor);
-      ac_samplerOpus.m_cursor = float(m_control.m_cursor);
       m_control.m_cursor = unsigned(-1);
     }
 
     // receive
-    m_feedback = ac_feedback;
-
-    // reset
-    ac_feedback.m_playedSampleCount = 0;
-    ac_feedback.m_playedLevelPeak = 0.f;
-    ac_feedback.m_playedLevelRMS = 0.f;
+    m_feedback.m_playedSampleCount = 0;
+    m_feedback.m_playedUnderrunCount = 0;
+    m_feedback.m_playedLevelPeak = 0.f;
+    m_feedback.m_playedLevelRMS = 0.f;
+    s_feedback fb;
+    while (m_queueFeedback.pop(fb))
+    {
+      m_feedback.m_playedControls = fb.m_playedControls;
+      m_feedback.m_playedSampleCursor = fb.m_playedSampleCursor;
+      m_feedback.accumulate(fb.m_playedSampleCount, fb.m_playedLevelPeak, fb.m_playedLevelRMS);
+      m_feedback.m_playedUnderrunCount += fb.m_playedUnderrunCount;
+    }
   }
 
   /// sampling with float and stereo, called from the audio-callback
   virtual void sample(float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq) override
   {
-    if (!ac_control.m_isPlaying) return;
+    // receive
+    s_control ctrl;
+    while (m_queueControl.pop(ctrl))
+    {
+      ac_control.m_isPlaying = ctrl.m_isPlaying;
+      ac_control.m_isRepeating = ctrl.m_isRepeating;
+      ac_samplerRaw.m_repet = ctrl.m_isRepeating;
+      ac_samplerOpus.m_repet = ctrl.m_isRepeating;
+      ac_control.m_interpolation = ctrl.m_interpolation;
+      ac_samplerRaw.m_interpolation = ctrl.m_interpolation;
+
+      if (ctrl.m_targetDelay >= 0.f)
+      {
+        ac_control.m_target = ctrl.m_target;
+        ac_control.m_targetDelay = ctrl.m_targetDelay;
+      }
+      if (ctrl.m_cursor != unsigned(-1))
+      {
+        ac_control.m_cursor = ctrl.m_cursor;
+        ac_samplerRaw.m_cursor = float(ctrl.m_cursor);
+        ac_samplerOpus.m_cursor = float(ctrl.m_cursor);
+      }
+    }
+
+    if (ac_control.m_isPlaying)
+      _samplePlaying(outBufferAdd, sampleCount, sampleFreq);
+#ifdef TRE_WITH_OPUS
+    else if (m_audioDataOpus != nullptr && m_audioDataOpus->m_nSamples != 0)
+      ac_samplerOpus.prepare(*m_audioDataOpus); // pre-roll
+    else if (m_audioDataOpusStream != nullptr && m_audioDataOpusStream->m_nSamples != 0)
+      ac_samplerOpus.prepare(*m_audioDataOpusStream); // pre-roll
+#endif
+
+    // send (the feedback is accumulated until it is sent)
+    if (m_queueFeedback.push(ac_feedback))
+    {
+      ac_feedback.m_playedSampleCount = 0;
+      ac_feedback.m_playedUnderrunCount = 0;
+      ac_feedback.m_playedLevelPeak = 0.f;
+      ac_feedback.m_playedLevelRMS = 0.f;
+    }
+  }
+
+  virtual void setBackgroundDecoding(bool enabled) override { ac_samplerOpus.m_backgroundDecoding.store(enabled); }
+
+  virtual unsigned decodedAhead() const override
+  {
+#ifdef TRE_WITH_OPUS
+    if (m_audioDataOpus != nullptr && m_audioDataOpus->m_nSamples != 0) return ac_samplerOpus.decodedAhead();
+    if (m_audioDataOpusStream != nullptr && m_audioDataOpusStream->m_nSamples != 0) return ac_samplerOpus.decodedAhead();
+#endif
+    return unsigned(-1);
+  }
+
+  virtual bool decode() override
+  {
+#ifdef TRE_WITH_OPUS
+    if (m_audioDataOpus != nullptr && m_audioDataOpus->m_nSamples != 0) return ac_samplerOpus.decode(*m_audioDataOpus);
+    if (m_audioDataOpusStream != nullptr && m_audioDataOpusStream->m_nSamples != 0) return ac_samplerOpus.decode(*m_audioDataOpusStream);
+#endif
+    return false;
+  }
 
+protected:
+  void _samplePlaying(float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+  {
     _controls endControls;
     if (ac_control.m_targetDelay >= 0.f)
     {
@@ -567,11 +810,22 @@ public:
       ac_samplerOpus.sample(*m_audioDataOpus, ac_feedback.m_playedControls, endControls, outBufferAdd, sampleCount, sampleFreq);
 
       ac_feedback.m_playedControls = endControls;
-      ac_feedback.m_playedLevelPeak = std::max(ac_feedback.m_playedLevelPeak, ac_samplerOpus.m_valuePeak);
-      ac_feedback.m_playedLevelRMS  = std::sqrt((ac_feedback.m_playedLevelRMS * ac_feedback.m_playedLevelRMS * ac_feedback.m_playedSampleCount +
-                                                 ac_samplerOpus.m_valueRMS    * ac_samplerOpus.m_valueRMS    * sampleCount                      ) /
-                                                (ac_feedback.m_playedSampleCount + sampleCount));
-      ac_feedback.m_playedSampleCount += sampleCount;
+      ac_feedback.accumulate(sampleCount, ac_samplerOpus.m_valuePeak, ac_samplerOpus.m_valueRMS);
+      ac_feedback.m_playedUnderrunCount += ac_samplerOpus.m_underrunCount;
+      ac_feedback.m_playedSampleCursor = unsigned(ac_samplerOpus.m_cursor);
+
+      return;
+    }
+
+    if (m_audioDataOpusStream != nullptr)
+    {
+      if (m_audioDataOpusStream->m_nSamples == 0) return; // no audio data ?!?
+
+      ac_samplerOpus.sample(*m_audioDataOpusStream, ac_feedback.m_playedControls, endControls, outBufferAdd, sampleCount, sampleFreq);
+
+      ac_feedback.m_playedControls = endControls;
+      ac_feedback.accumulate(sampleCount, ac_samplerOpus.m_valuePeak, ac_samplerOpus.m_valueRMS);
+      ac_feedback.m_playedUnderrunCount += ac_samplerOpus.m_underrunCount;
       ac_feedback.m_playedSampleCursor = unsigned(ac_samplerOpus.m_cursor);
 
       return;
@@ -585,11 +839,7 @@ public:
       ac_samplerRaw.sample(*m_audioDataRaw, ac_feedback.m_playedControls, endControls, outBufferAdd, sampleCount, sampleFreq);
 
       ac_feedback.m_playedControls = endControls;
-      ac_feedback.m_playedLevelPeak = std::max(ac_feedback.m_playedLevelPeak, ac_samplerRaw.m_valuePeak);
-      ac_feedback.m_playedLevelRMS  = std::sqrt((ac_feedback.m_playedLevelRMS * ac_feedback.m_playedLevelRMS * ac_feedback.m_playedSampleCount +
-                                                 ac_samplerRaw.m_valueRMS     * ac_samplerRaw.m_valueRMS     * sampleCount                      ) /
-                                                (ac_feedback.m_playedSampleCount + sampleCount));
-      ac_feedback.m_playedSampleCount += sampleCount;
+      ac_feedback.accumulate(sampleCount, ac_samplerRaw.m_valuePeak, ac_samplerRaw.m_valueRMS);
       ac_feedback.m_playedSampleCursor = unsigned(ac_samplerRaw.m_cursor);
 
       return;
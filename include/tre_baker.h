@@ -16,6 +16,7 @@ namespace soundData
 {
   struct s_RawSDL;
   struct s_Opus;
+  struct s_OpusStream;
 }
 
 /**
@@ -50,6 +51,7 @@ public:
 
   bool writeBlock(const soundData::s_Opus *s); ///< Shortcut for getBlockWriteAndAdvance and bake a sound-data
   bool readBlock(soundData::s_Opus *s); ///< Shortcut for getBlockReadAndAdvance and read a sound-data from it
+  bool readBlock(soundData::s_OpusStream *s); ///< Shortcut for getBlockReadAndAdvance and open a stream on the sound-data (only its index is read: the baked file must be kept)
 
 
   void flushAndCloseFile(); ///< flush data and close of the files.
@@ -72,6 +74,7 @@ protected:
   std::ofstream *m_fileOutDescriptor = nullptr;
 
   std::vector<uint64_t> m_blocksAdress;
+  std::string           m_fileInName;
 
   uint32_t m_version;
 };
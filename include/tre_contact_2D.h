@@ -4,9 +4,12 @@
 #include "glm/glm.hpp"
 
 #include <vector>
+#include <utility>
 
 namespace tre {
 
+template <class _t> class span; // forward decl.
+
 //=============================================================================
 
 /**
@@ -196,6 +199,55 @@ public:
  /// @}
 };
 
+//=============================================================================
+
+/**
+ * @brief The broad-phase class
+ * This handles a spatial-hash on an uniform grid, in order to find the potential 2D contacts without testing all pairs.
+ * The grid is rebuilt from scratch at each call of "build" (counting-sort of the objects into a flat array of cells), so it fits with objects that move every frame.
+ * The boxes are given as AABB (xmin, ymin, xmax, ymax). The queries report the objects from their box: the narrow-phase (s_contact2D) must be done afterwards.
+ */
+struct s_broadphase2D
+{
+public:
+  float    cellSize = 1.f;        ///< size of the grid cells. It should be close to the typical size of the objects.
+  unsigned maxCellsPerObject = 16; ///< objects that cover more cells are not put in the grid, but tested against all objects.
+
+  /// Rebuild the grid. The object "i" has the box "AABBs[i]".
+  void build(const span<glm::vec4> &AABBs);
+
+  /// Compute all pairs of objects with overlapping boxes (each pair is reported once, with first < second).
+  void computePairs(std::vector<std::pair<uint32_t, uint32_t>> &pairs) const;
+
+  /// Get the objects that overlap the box (xmin, ymin, xmax, ymax).
+  void queryBox(std::vector<uint32_t> &listObjects, const glm::vec4 &AABB) const;
+
+  /// Get the objects hit by the ray (origin, direction) in the range [0, rayEnd].
+  void queryRay(std::vector<uint32_t> &listObjects, const glm::vec2 &origin, const glm::vec2 &direction, float rayEnd = std::numeric_limits<float>::infinity()) const;
+
+  std::size_t getObjectCount() const { return m_objectCount; }
+
+protected:
+
+  struct s_entry
+  {
+    glm::vec4 box;      ///< copy of the object's box (the entries of a cell are contiguous)
+    uint32_t  objectId;
+  };
+
+  std::size_t            m_objectCount = 0;
+  glm::vec4              m_bounds;       ///< union of all boxes
+  std::vector<glm::vec4> m_boxes;        ///< copy of the objects' boxes
+  uint32_t               m_hashMask = 0; ///< the hash-table has "m_hashMask + 1" buckets
+  std::vector<uint32_t>  m_bucketStart;  ///< entries of the bucket "b" are in [m_bucketStart[b], m_bucketStart[b + 1])
+  std::vector<s_entry>   m_entries;      ///< an object is in the buckets of all cells it covers (but once per bucket)
+  std::vector<uint32_t>  m_bucketsMulti; ///< buckets with at least 2 entries (the only ones that can give pairs)
+  std::vector<uint32_t>  m_largeObjects; ///< objects that are not in the grid
+
+  glm::ivec4 _cellRange(const glm::vec4 &AABB) const;
+  uint32_t   _hash(int ix, int iy) const { return ((uint32_t(ix) * 73856093u) ^ (uint32_t(iy) * 19349663u)) & m_hashMask; }
+};
+
 // ============================================================================
 
 } // namespace
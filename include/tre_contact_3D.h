@@ -3,7 +3,9 @@
 
 #include "glm/glm.hpp"
 
+#include <array>
 #include <vector>
+#include <utility>
 
 namespace tre {
 
@@ -28,7 +30,7 @@ public:
   typedef std::vector<glm::vec3> s_skin;
   typedef span<glm::vec3>        s_skinArg;
 
-  /// Kd-Tree for mesh's skin sampling
+  /// Kd-Tree for mesh's skin sampling (legacy: limited to 32k triangles, prefer the s_skinBvh)
   struct s_skinKdTree
   {
     s_skin skin;
@@ -49,6 +51,51 @@ public:
     void computeTree();
   };
 
+  /// Bounding-Volume-Hierarchy for mesh's skin sampling (binned-SAH build)
+  struct s_skinBvh
+  {
+    s_skin skin; ///< list of triangles (re-ordered by the build)
+
+    struct s_node
+    {
+      glm::vec3 bbMin;        ///< bounding-box of the node
+      uint32_t  first = 0;    ///< inner node: index of the left child (the right child is "first + 1"), leaf: index of the first triangle
+      glm::vec3 bbMax;        ///< bounding-box of the node
+      uint32_t  count = 0;    ///< number of triangles (0 for inner nodes)
+
+      bool isLeaf() const { return count != 0; }
+    };
+    std::vector<s_node> tree; ///< the root node is at index 0
+
+    static constexpr unsigned kMaxDepth = 64;
+    static constexpr unsigned kBinCount = 16; ///< number of bins used to evaluate the SAH along each axis
+    static constexpr unsigned kLeafSize = 4;  ///< nodes with at most this number of triangles are not split
+
+    void computeTree();
+  };
+
+  /// Convex mesh for the GJK/EPA queries: the vertices of a convex mesh's skin, with their adjacency (used by the hill-climbing support mapping)
+  struct s_skinConvex
+  {
+    std::vector<glm::vec3> vertices;       ///< unique vertices
+    std::vector<uint32_t>  adjacencyStart; ///< the neighbors of the vertex "i" are in [adjacencyStart[i], adjacencyStart[i + 1])
+    std::vector<uint32_t>  adjacency;      ///< list of the neighbors
+
+    /// Compute the vertices and the adjacency from the skin (list of triangles). The duplicated vertices are merged.
+    void compute(const s_skin &skin);
+
+    /// Get the vertex that is the farthest along the direction (hill-climbing from the vertex "hint")
+    uint32_t support(const glm::vec3 &direction, uint32_t hint = 0) const;
+  };
+
+  /// Cache for the GJK queries, in order to warm-start from the previous query on the same pair of shapes (for example, from the previous frame)
+  struct s_gjkCache
+  {
+    unsigned                count = 0;  ///< number of vertices of the cached simplex
+    std::array<uint32_t, 4> indexA = {}; ///< support vertices on the shape A
+    std::array<uint32_t, 4> indexB = {}; ///< support vertices on the shape B
+  };
+
   // ===============================================================
   /// @name (0D in 3D) Simple penetration test of a point in a volume
   /// note:
@@ -83,6 +130,15 @@ public:
                          const glm::vec3 & point,
                          const s_skin & pts);
 
+  /// Check penetration of a point and a closed mesh [mesh's skin, sampled by the BVH] => no contact info
+  static bool point_skin(const glm::vec3 & point,
+                         const s_skinBvh & skinBvh);
+
+  /// Check penetration of a point and a closed mesh [mesh's skin, sampled by the BVH]
+  static bool point_skin(s_contact3D & cntSkin,
+                         const glm::vec3 & point,
+                         const s_skinBvh & skinBvh);
+
   /// Check penetration of a point and a sphere (center, radius) => no contact info
   static bool point_sphere(const glm::vec3 &point,
                            const glm::vec3 &center, const float radius);
@@ -141,6 +197,15 @@ public:
                           const glm::vec3 & center, const float radius,
                           const s_skin &pts);
 
+  /// Check intersection of a circle and a closed mesh [mesh's skin, sampled by the BVH] => no contact info
+  static bool sphere_skin(const glm::vec3 & center, const float radius,
+                          const s_skinBvh &skinBvh);
+
+  /// Check intersection of a circle and a closed mesh [mesh's skin, sampled by the BVH]
+  static bool sphere_skin(s_contact3D & cntSphere,
+                          const glm::vec3 & center, const float radius,
+                          const s_skinBvh &skinBvh);
+
   /// Check intersection of a sphere A and a sphere B
   static bool sphere_sphere(s_contact3D & cntSphereA,
                             const glm::vec3 & centerA, const float radiusA,
@@ -148,6 +213,66 @@ public:
 
   /// @}
 
+  //  ===============================================================
+  /// @name (3D in 3D) Convex shapes (GJK for the distance and the intersection, EPA for the penetration)
+  /// note:
+  /// - same conventions as above. The "pt" is the middle of the deepest points.
+  /// - the optional cache allows to warm-start the GJK from the previous query on the same pair of shapes.
+  /// @{
+
+  /// Check intersection of a convex mesh A and a convex mesh B => no contact info
+  static bool skin_skin(const s_skinConvex & skinA,
+                        const s_skinConvex & skinB,
+                        s_gjkCache * cache = nullptr);
+
+  /// Check intersection of a convex mesh A and a convex mesh B
+  static bool skin_skin(s_contact3D & cntSkinA,
+                        const s_skinConvex & skinA,
+                        const s_skinConvex & skinB,
+                        s_gjkCache * cache = nullptr);
+
+  /// Check intersection of a box and a convex mesh => no contact info
+  static bool box_skin(const s_boundbox & box,
+                       const s_skinConvex & skin,
+                       s_gjkCache * cache = nullptr);
+
+  /// Check intersection of a box and a convex mesh
+  static bool box_skin(s_contact3D & cntBox,
+                       const s_boundbox & box,
+                       const s_skinConvex & skin,
+                       s_gjkCache * cache = nullptr);
+
+  /// Check intersection of a sphere (center, radius) and a convex mesh => no contact info
+  static bool sphere_skin(const glm::vec3 & center, const float radius,
+                          const s_skinConvex & skin,
+                          s_gjkCache * cache = nullptr);
+
+  /// Check intersection of a sphere (center, radius) and a convex mesh
+  static bool sphere_skin(s_contact3D & cntSphere,
+                          const glm::vec3 & center, const float radius,
+                          const s_skinConvex & skin,
+                          s_gjkCache * cache = nullptr);
+
+  /// Compute the distance between a convex mesh A and a convex mesh B, with the closest points. Returns 0 when the meshes overlap.
+  static float distance_skin_skin(glm::vec3 & ptA, glm::vec3 & ptB,
+                                  const s_skinConvex & skinA,
+                                  const s_skinConvex & skinB,
+                                  s_gjkCache * cache = nullptr);
+
+  /// Compute the distance between a box and a convex mesh, with the closest points. Returns 0 when the shapes overlap.
+  static float distance_box_skin(glm::vec3 & ptBox, glm::vec3 & ptSkin,
+                                 const s_boundbox & box,
+                                 const s_skinConvex & skin,
+                                 s_gjkCache * cache = nullptr);
+
+  /// Compute the distance between a sphere (center, radius) and a convex mesh, with the closest points. Returns 0 when the shapes overlap.
+  static float distance_sphere_skin(glm::vec3 & ptSphere, glm::vec3 & ptSkin,
+                                    const glm::vec3 & center, const float radius,
+                                    const s_skinConvex & skin,
+                                    s_gjkCache * cache = nullptr);
+
+  /// @}
+
   //  ===============================================================
   /// @name Ray-cast on volume (hit on the point for which the ray goes out of the volume)
   /// note:
@@ -180,9 +305,99 @@ public:
                             const s_skinKdTree & skinKdT,
                             float rayStart = -std::numeric_limits<float>::infinity());
 
+  /// Check if the ray (origin, direction) hits the mesh's skin. Warning: in-face culling. Returns true when the ray hits the skin.
+  static bool raytrace_skin(s_contact3D & hitInfo,
+                            const glm::vec3 & origin, const glm::vec3 & direction,
+                            const s_skinBvh & skinBvh,
+                            float rayStart = -std::numeric_limits<float>::infinity());
+
+  /**
+   * @brief Batched ray-trace on the mesh's skin. Warning: in-face culling.
+   * The rays (origins[i], directions[i]) are traced by packets of 4 when they are coherent, and the batch is split over the threads.
+   * The results match the single-ray version. When the ray "i" does not hit the skin, "hitInfos[i].penet" is +inf.
+   * @return the number of rays that hit the skin
+   */
+  static std::size_t raytrace_skin(const span<s_contact3D> & hitInfos,
+                                   const span<glm::vec3> & origins, const span<glm::vec3> & directions,
+                                   const s_skinBvh & skinBvh,
+                                   float rayStart = -std::numeric_limits<float>::infinity());
+
   /// @}
 };
 
+//=============================================================================
+
+/**
+ * @brief The broad-phase class
+ * This handles a dynamic AABB-tree of proxies (bounding-boxes with an user-data), in order to find the potential 3D contacts without testing all pairs.
+ * The proxies are stored with a fattened box, so a proxy that moves a little does not need to be updated in the tree.
+ * The queries report the proxies from their fattened box: the narrow-phase (s_contact3D) must be done afterwards.
+ */
+struct s_broadphase3D
+{
+public:
+  static constexpr uint32_t kNull = 0xFFFFFFFF; ///< invalid proxy or node
+
+  float fatMargin = 0.1f;           ///< margin added on all sides of the boxes
+  float fatDisplacementFactor = 2.f; ///< the fattened box is extended along the displacement (see "moveProxy") by this factor
+
+  /// Add a proxy. Returns the proxy-id.
+  uint32_t insertProxy(const s_boundbox &box, uint32_t userData);
+
+  /// Remove a proxy.
+  void removeProxy(uint32_t proxyId);
+
+  /// Update the box of a proxy. The "displacement" is the expected motion of the box for the next update. Returns true if the proxy has been re-inserted in the tree.
+  bool moveProxy(uint32_t proxyId, const s_boundbox &box, const glm::vec3 &displacement = glm::vec3(0.f));
+
+  /// Remove all proxies.
+  void clear();
+
+  uint32_t    getUserData(uint32_t proxyId) const { return m_nodes[proxyId].userData; }
+  s_boundbox  getFatBox(uint32_t proxyId) const;
+  std::size_t getProxyCount() const { return m_proxyCount; }
+  unsigned    getHeight() const { return m_root == kNull ? 0 : unsigned(m_nodes[m_root].height) + 1; }
+
+  /// Compute all pairs of proxies with overlapping boxes (pairs of user-data, each pair is reported once).
+  /// The pairs are kept from one call to the next one, so only the proxies inserted or re-inserted in the meantime are processed.
+  void computePairs(std::vector<std::pair<uint32_t, uint32_t>> &pairs);
+
+  /// Get the proxies (user-data) that overlap the box.
+  void queryBox(std::vector<uint32_t> &listUserData, const s_boundbox &box) const;
+
+  /// Get the proxies (user-data) hit by the ray (origin, direction) in the range [0, rayEnd].
+  void queryRay(std::vector<uint32_t> &listUserData, const glm::vec3 &origin, const glm::vec3 &direction, float rayEnd = std::numeric_limits<float>::infinity()) const;
+
+protected:
+
+  struct s_node
+  {
+    glm::vec3 bbMin;          ///< bounding-box (fattened for the leaves)
+    uint32_t  parent = kNull; ///< parent node, or next free node
+    glm::vec3 bbMax;          ///< bounding-box (fattened for the leaves)
+    uint32_t  child1 = kNull; ///< first child (kNull for the leaves)
+    uint32_t  child2 = kNull; ///< second child
+    int32_t   height = -1;    ///< 0 for the leaves, -1 for the free nodes
+    uint32_t  userData = 0;   ///< leaves only
+
+    bool isLeaf() const { return child1 == kNull; }
+  };
+
+  std::vector<s_node> m_nodes;
+  uint32_t            m_root = kNull;
+  uint32_t            m_freeList = kNull;
+  std::size_t         m_proxyCount = 0;
+
+  std::vector<uint32_t>                       m_moved;      ///< proxies inserted, re-inserted or removed since the last "computePairs"
+  std::vector<std::pair<uint32_t, uint32_t>>  m_pairsCache; ///< pairs of proxies found by the last "computePairs"
+
+  uint32_t _allocateNode();
+  void     _freeNode(uint32_t nodeId);
+  void     _insertLeaf(uint32_t leaf);
+  void     _removeLeaf(uint32_t leaf);
+  uint32_t _balance(uint32_t nodeA);
+};
+
 // ============================================================================
 
 } // namespace
@@ -62,7 +62,7 @@ public:
 
 private:
   static s_fontMap _readFNT(const std::string &fileFNT);
-  static void _packTextures(const std::vector<s_fontCache> &caches, SDL_Surface* &packedTexture, std::vector<glm::ivec4> &coords); ///< naive algo (which works better when the bigger texture is put first)
+  static void _packTextures(const std::vector<s_fontCache> &caches, SDL_Surface* &packedTexture, std::vector<glm::ivec4> &coords); ///< pack the textures into an atlas (with 1 pixel of padding)
   /// @}
 
   /// @name Core
@@ -33,6 +33,12 @@ void computeConvexeEnvelop2D_XY(const s_modelDataLayout &layout, const s_partInf
 /// @param listTriangles
 void triangulate(const std::vector<glm::vec2> &envelop, std::vector<unsigned> &listTriangles);
 
+/// @brief triangulate a set of points (constrained Delaunay triangulation). The output triangles are counter-clockwise.
+/// @param constrainedEdges pairs of point-indices that are forced as edges. They must form closed contours whose interior is on the "left"-side
+///        (counter-clockwise boundaries, clockwise holes). Without constrained edge, the convex hull of the points is triangulated.
+/// @param listTriangles Duplicated points are merged: only one of them is referenced.
+void triangulate(const std::vector<glm::vec2> &points, const std::vector<unsigned> &constrainedEdges, std::vector<unsigned> &listTriangles);
+
 //=============================================================================
 // 3D ...
 
@@ -40,10 +46,11 @@ void triangulate(const std::vector<glm::vec2> &envelop, std::vector<unsigned> &l
 /// \return the barycenter (xyz) and the volume (w)
 glm::vec4 computeBarycenter3D(const s_modelDataLayout &layout, const s_partInfo &part);
 
-/// @brief computeConvexeSkin3D extracts the triangles (3 clockwised points) of the convex hull of the mesh.
-/// @param threshold
+/// @brief computeConvexeSkin3D extracts the triangles (3 clockwised points) of the convex hull of the mesh (quickhull).
+/// @param threshold Tolerance (relative to the part's size) below which the points are considered on the hull
 /// @param outSkinTri
-void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &part, const float threshold, std::vector<glm::vec3> &outSkinTri);
+/// @param maxVertexCount Limit of the hull's vertex count (the furthest points are added first). No limit if 0.
+void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &part, const float threshold, std::vector<glm::vec3> &outSkinTri, const std::size_t maxVertexCount = 0);
 
 /// @brief computeSkin3D extracts the triangles (3 clockwised points) of the skin. It assumes that the normals are correctly set.
 /// @param outSkinTri
@@ -61,10 +68,17 @@ void computeTangentFromUV(const s_modelDataLayout &layout, const s_partInfo &par
 std::size_t decimateCurvature(modelIndexed &model, const std::size_t ipartIn, const float threshold);
 
 /// @brief decimate mesh. The algorithm is based on voxels (aka 3d-grid). New vertices may be created, thus additional data (normals, uvs, ...) may be outdated.
-/// @param gridResolution Size of the grid's cells
+/// @param gridResolution Size of the grid's cells. The grid is sparse: the memory usage depends on the occupied cells only.
 /// @return the new part. It returns (-1) on failure.
 std::size_t decimateVoxel(modelIndexed &model, const std::size_t ipartIn, const float gridResolution, const bool keepSharpEdges);
 
+/// @brief decimate mesh. The algorithm collapses the edges with the smallest quadric-error first. No vertex is created nor modified.
+///        The open-boundaries and the attribute-seams (vertices with the same position but different normals, uvs, ...) are kept.
+/// @param targetTriangleCount Stops when the part has this triangle count (0 to ignore)
+/// @param maxError Stops when the next collapse has a larger error. It is the distance to the original surface, relative to the part's size.
+/// @return the new part. It returns (-1) on failure.
+std::size_t decimateQuadric(modelIndexed &model, const std::size_t ipartIn, const std::size_t targetTriangleCount, const float maxError);
+
 /// @brief tetrahedralize from a 3D surface. New vertices may be created, in a new separate part.
 bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t maxTetraCount, bool allowNewVertex, std::vector<unsigned> &listTetrahedrons);
 
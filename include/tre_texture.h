@@ -7,9 +7,14 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 
 namespace tre {
 
+class textureUploader;
+
 /**
  * @brief The texture class
  * It is the base class for textures handling from OpenGL.
@@ -26,6 +31,8 @@ public:
   static const int MMASK_ANISOTROPIC        = 0x0004;
   static const int MMASK_SRBG_SPACE         = 0x0008; ///< The image data is in the sRGB color-space. (Enables auto-convertion to the linear-sapce when sampling it.)
   static const int MMASK_NEAREST_MAG_FILTER = 0x0010; ///< By default, the mag-filter is "linear".
+  static const int MMASK_HDR_RGB9E5         = 0x0020; ///< Float-textures only: pack RGB into 4 bytes with a shared exponent (GL_RGB9_E5). Alpha is dropped, negative values are clamped to 0.
+  static const int MMASK_HDR_R11G11B10F     = 0x0040; ///< Float-textures only: pack RGB into 4 bytes of small unsigned floats (GL_R11F_G11F_B10F). Alpha is dropped, negative values are clamped to 0.
   static const int MMASK_ALPHA_ONLY         = 0x1000;
   static const int MMASK_RG_ONLY            = 0x2000;
   static const int MMASK_FORCE_NO_ALPHA     = 0x4000;
@@ -45,10 +52,11 @@ public:
   bool loadArray(const span<SDL_Surface*> &surfaces, int modemask, const bool freeSurface); ///< Load from multiple SDL_Surface into GPU as 2D-Array-Texture. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
   bool loadCube(const std::array<SDL_Surface *, 6> &cubeFaces, int modemask, const bool freeSurface);  ///< Load from SDL_Surface into GPU as CubeMap-Texture. Textures lost: X+, X-, Y+, Y-, Z+, Z-. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
   bool load3D(const uint8_t *data, int w, int h, int d, int components, int modemask); ///< Load from SDL_Surface into GPU as 3D-Texture. Using modifiers is not allowed. data can be null.
-  bool loadFloat(const glm::vec4 * data, int w, int h, int modemask); ///< Load from float data into GPU as 2D-Texture with RGBA floatting-point format. data can be null.
-  bool loadArrayFloat(const glm::vec4 * data, int w, int h, int layers, int modemask); ///< Load from float data into GPU as 2D-Array-Texture with RGBA floatting-point format. data can be null.
+  bool loadFloat(const glm::vec4 * data, int w, int h, int modemask); ///< Load from float data into GPU as 2D-Texture with RGBA floatting-point format (or packed RGB with MMASK_HDR_*). data can be null.
+  bool loadArrayFloat(const glm::vec4 * data, int w, int h, int layers, int modemask); ///< Load from float data into GPU as 2D-Array-Texture with RGBA floatting-point format (or packed RGB with MMASK_HDR_*). data can be null.
 
   bool update(SDL_Surface *surface, const bool freeSurface, const bool unbind = true) const; ///< Upload new pixels into a 2D-texture. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
+  bool update(SDL_Surface *surface, const bool freeSurface, textureUploader &uploader, uint64_t *ticket = nullptr) const; ///< Push new pixels of a 2D-texture into the uploader (asynchronous upload). The modifiers are applied now. The optional "ticket" tells when the upload is complete.
   bool updateArray(SDL_Surface *surface, int layerIndex, const bool freeSurface, const bool unbind = true) const; ///< Upload new pixels into a single layer of an 2D-Array-Texture. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
   bool update3D(const uint8_t *data, int w, int h, int d, int components, const bool unbind = true) const; ///< Upload new pixels into a 3D-Texture. Using modifiers is not allowed.
   bool updateFloat(const glm::vec4 * data, int w, int h, const bool unbind = true) const; ///< Upload new float pixels into a 2D-Texture with RGBA floatting-point format.
@@ -58,12 +66,16 @@ public:
   bool loadWhite() { return loadColor(0xFFFFFFFF); } ///< Load a plain-white texture into GPU as 2D-Texture.
   bool loadCheckerboard(int width, int height); ///< Load a texture with checker-board pattern into GPU as 2D-Texture.
 
-  static bool write(std::ostream &outbuffer, SDL_Surface *surface, int modemask, const bool freeSurface); ///< Bake and write a surface into binary-format. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
+  static bool write(std::ostream &outbuffer, SDL_Surface *surface, int modemask, const bool freeSurface); ///< Bake and write a surface into binary-format. Using freeSurface=true allows to apply modifiers in-place to the pixel data. With MMASK_MIPMAP, the full mip-chain is baked (and compressed with MMASK_COMPRESS).
   static bool writeArray(std::ostream &outbuffer, const span<SDL_Surface*> &surfaces, int modemask, const bool freeSurface);
-  static bool writeCube(std::ostream &outbuffer, const std::array<SDL_Surface *, 6> &cubeFaces, int modemask, const bool freeSurface); ///< Bake and write a cubemap-surface into binary-format. Using freeSurface=true allows to apply modifiers in-place to the pixel data.
+  static bool writeCube(std::ostream &outbuffer, const std::array<SDL_Surface *, 6> &cubeFaces, int modemask, const bool freeSurface); ///< Bake and write a cubemap-surface into binary-format. Using freeSurface=true allows to apply modifiers in-place to the pixel data. With MMASK_MIPMAP, the full mip-chain is baked (and compressed with MMASK_COMPRESS).
+  static bool writeCubeMipChain(std::ostream &outbuffer, const std::vector<std::array<SDL_Surface *, 6> > &mipChain, int modemask, const bool freeSurface); ///< Write a cubemap-surface with its own mip-chain (ex: prefiltered for image-based lighting) into binary-format. The chain must be complete (down to 1x1). MMASK_MIPMAP is implied.
   static bool write3D(std::ostream &outbuffer, const uint8_t *data, int w, int h, int d, int components, int modemask); ///< Bake and write a 3D-Texture into binary-format. Using modifiers is not allowed.
+  static bool writeFloat(std::ostream &outbuffer, const glm::vec4 *data, int w, int h, int modemask); ///< Bake and write float data into binary-format, packed with MMASK_HDR_RGB9E5 or MMASK_HDR_R11G11B10F (required). With MMASK_MIPMAP, the full mip-chain is baked.
+  static bool writeCubeFloat(std::ostream &outbuffer, const std::array<const glm::vec4*, 6> &cubeFaces, int size, int modemask); ///< Bake and write float cubemap-data into binary-format, packed with MMASK_HDR_RGB9E5 or MMASK_HDR_R11G11B10F (required). With MMASK_MIPMAP, the full mip-chain is baked.
 
-  bool read(std::istream &inbuffer); ///< load texture from binary-file, and load it into GPU.
+  bool read(std::istream &inbuffer); ///< load texture from binary-file, and load it into GPU. The baked mip-chains are uploaded as they are (no mipmap generation on GPU).
+  bool read(std::istream &inbuffer, textureUploader &uploader, uint64_t *ticket = nullptr); ///< load texture from binary-file, and push the pixels into the uploader (asynchronous upload). The levels that do not fit into the uploader are uploaded synchronously.
 
   void clear(); ///< Clear texture from GPU
 
@@ -74,7 +86,7 @@ public:
 
 protected:
 
-  void set_parameters(); ///< Once the texture is created and binded, it sets the OpenGL parameters to the texture.
+  void set_parameters(const bool generateMipmap = true); ///< Once the texture is created and binded, it sets the OpenGL parameters to the texture. Use generateMipmap=false when the mip-levels are already uploaded.
 
   int m_components = 0; ///< Nbr of components, between 1 and 4 included. "1" is specific: it means alpha-only, so the shader will resolve the color with (r=1,b=1,g=1,a=value).
   textureInfoType m_type = TI_NONE;
@@ -85,6 +97,7 @@ protected:
   bool useAnisotropic()      const { return (m_mask & MMASK_ANISOTROPIC) != 0; }
   bool useGammeCorreciton()  const { return (m_mask & MMASK_SRBG_SPACE) != 0; }
   bool useMagFilterNearest() const { return (m_mask & MMASK_NEAREST_MAG_FILTER) != 0; }
+  bool useHDRPacking()       const { return (m_mask & (MMASK_HDR_RGB9E5 | MMASK_HDR_R11G11B10F)) != 0; }
 
 private:
 
@@ -108,6 +121,226 @@ private:
   static void _rawUnpack_A8_to_RGBA8(std::vector<char> &pixelData);
   static void _rawExtend_AddAlpha8(s_SurfaceTemp &surf);
   static unsigned _rawCompress(const s_SurfaceTemp &surf, GLenum targetFormat); ///< compress textures on CPU (inplace, erase the surface's pixels). Returns the buffer byte-size, or zero on failure.
+  static void _rawToFloat(const s_SurfaceTemp &surf, const bool gammaCorrect, std::vector<float> &pixelsOut); ///< convert to linear values [0,1] (tightly packed)
+  static void _rawFromFloat(const std::vector<float> &pixelsIn, unsigned w, unsigned h, unsigned components, const bool gammaCorrect, s_SurfaceTemp &surf); ///< quantize linear values into an own-buffer surface. The buffer is padded with the border pixels to multiple-of-4 dimensions.
+  static void _rawPadToBlocks(s_SurfaceTemp &surf); ///< copy into an own-buffer padded with the border pixels to multiple-of-4 dimensions (no-op when already aligned), as expected by the block compressors.
+  static bool _rawWriteLevels(std::ostream &outbuffer, s_SurfaceTemp &surf, int components, int modemask); ///< write the pixels and, with MMASK_MIPMAP, the mip-chain. It compresses in-place with MMASK_COMPRESS.
+  static bool _rawWriteLevel(std::ostream &outbuffer, s_SurfaceTemp &surf, int components, int modemask); ///< write the pixels of a single level. It compresses in-place with MMASK_COMPRESS.
+  static void _rawPackHDR(const float *pixels, std::size_t count, unsigned components, GLenum packedFormat, uint32_t *packed); ///< pack float pixels (RGB or RGBA, the alpha is dropped) into GL_RGB9_E5 or GL_R11F_G11F_B10F on CPU.
+  static bool _rawWriteLevelsHDR(std::ostream &outbuffer, const glm::vec4 *data, unsigned w, unsigned h, int modemask); ///< pack and write the float pixels and, with MMASK_MIPMAP, the mip-chain.
+
+  bool _prepareSurface(SDL_Surface *surface, const bool freeSurface, s_SurfaceTemp &surfLocal, GLenum &externalformat, unsigned &compressedByteSize) const; ///< apply the modifiers (and the compression) before the upload. The surface's pixels may be modified in-place with freeSurface=true.
+  bool _read(std::istream &inbuffer, textureUploader *uploader, uint64_t *ticket);
+};
+
+// ============================================================================
+
+/**
+ * @brief The textureUploader class uploads pixels into textures asynchronously, through a ring of pixel-buffer objects (PBO).
+ * The pixels are copied into the mapped PBO memory by "push", that can be called from any thread.
+ * The uploads are issued by "process", called from the OpenGL thread once per frame, within a byte-budget.
+ * A PBO is re-mapped once the GPU has consumed it (fence). The ticket of a request tells when its upload is complete.
+ * The OpenGL calls are done through "s_GLBackend", so the scheduling can be tested without OpenGL context.
+ */
+class textureUploader
+{
+public:
+
+  /// Upload request. With "m_internalFormat" set, the level is allocated (glTexImage) instead of updated (glTexSubImage).
+  /// Compressed pixels have the type GL_NONE and their format is the compressed internal-format.
+  struct s_request
+  {
+    GLuint  m_texture = 0;
+    GLenum  m_target = GL_TEXTURE_2D; ///< GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP_POSITIVE_X+i, GL_TEXTURE_2D_ARRAY or GL_TEXTURE_3D
+    GLint   m_level = 0;
+    GLint   m_x = 0, m_y = 0, m_z = 0; ///< offset (m_z is the layer of 2D-Array textures)
+    GLsizei m_w = 0, m_h = 0, m_d = 1;
+    GLenum  m_format = GL_RGBA;
+    GLenum  m_type = GL_UNSIGNED_BYTE;
+    GLenum  m_internalFormat = 0;
+  };
+
+  /// OpenGL entry-points used by the uploader. By default, they call OpenGL. Without "m_mapBufferRange" (WebGL), the PBO is filled with "m_bufferSubData" from a CPU copy.
+  struct s_GLBackend
+  {
+    void      (*m_genBuffers)(GLsizei n, GLuint *buffers);
+    void      (*m_deleteBuffers)(GLsizei n, const GLuint *buffers);
+    void      (*m_bindBuffer)(GLenum target, GLuint buffer);
+    void      (*m_bufferData)(GLenum target, GLsizeiptr size, const void *data, GLenum usage);
+    void      (*m_bufferSubData)(GLenum target, GLintptr offset, GLsizeiptr size, const void *data);
+    void     *(*m_mapBufferRange)(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access);
+    GLboolean (*m_unmapBuffer)(GLenum target);
+    GLsync    (*m_fenceSync)(GLenum condition, GLbitfield flags);
+    GLenum    (*m_clientWaitSync)(GLsync sync, GLbitfield flags, GLuint64 timeout);
+    void      (*m_deleteSync)(GLsync sync);
+    void      (*m_bindTexture)(GLenum target, GLuint texture);
+    void      (*m_pixelStorei)(GLenum pname, GLint param);
+    void      (*m_texImage2D)(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels);
+    void      (*m_texImage3D)(GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels);
+    void      (*m_texSubImage2D)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels);
+    void      (*m_texSubImage3D)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels);
+    void      (*m_compressedTexImage2D)(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data);
+    void      (*m_compressedTexImage3D)(GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data);
+    void      (*m_compressedTexSubImage2D)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data);
+    void      (*m_compressedTexSubImage3D)(GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void *data);
+
+    s_GLBackend(); ///< OpenGL entry-points
+  };
+
+  /// Statistics, accumulated since the init.
+  struct s_stats
+  {
+    std::size_t m_pushCount = 0;     ///< accepted requests
+    std::size_t m_rejectCount = 0;   ///< requests rejected (no room in the mapped PBOs)
+    std::size_t m_uploadCount = 0;   ///< issued uploads (a large request is split into several uploads)
+    std::size_t m_uploadBytes = 0;
+    std::size_t m_frameBytesMax = 0; ///< maximal bytes uploaded by a single "process" call
+  };
+
+  textureUploader() {}
+  textureUploader(const textureUploader &) = delete;
+  ~textureUploader() { TRE_ASSERT(m_slots.empty()); }
+
+  textureUploader & operator =(const textureUploader &) = delete;
+
+  bool init(const std::size_t slotByteSize = 4 * 1024 * 1024, const unsigned slotCount = 4, const s_GLBackend &backend = s_GLBackend()); ///< Create the PBOs (OpenGL thread).
+  void clear(); ///< Release the PBOs (OpenGL thread). The pending requests are dropped.
+
+  /// Copy the pixels into the mapped PBO memory (any thread). It returns the ticket of the request, or zero when there is no room.
+  /// The request is split into bands of rows when it is larger than a PBO (except for allocations, that must fit into a PBO).
+  /// With "wait", it blocks until the room is available (do not wait from the OpenGL thread: the room is made by "process").
+  uint64_t push(const s_request &request, const void *pixels, const std::size_t byteSize, const bool wait = false);
+
+  void process(const std::size_t budgetInBytes); ///< Issue the uploads within the byte-budget, and recycle the PBOs consumed by the GPU (OpenGL thread). At least one upload is issued per call.
+
+  bool isComplete(const uint64_t ticket) const; ///< The upload of the request is done by the GPU.
+  bool isIdle() const; ///< No pending request.
+
+  std::size_t slotByteSize() const { return m_slotByteSize; }
+  s_stats     stats() const;
+
+private:
+
+  enum e_slotState { SLOT_FREE, SLOT_MAPPED, SLOT_UPLOADING, SLOT_INFLIGHT };
+
+  struct s_slot
+  {
+    GLuint               m_pbo = 0;
+    e_slotState          m_state = SLOT_FREE;
+    uint8_t             *m_ptr = nullptr; ///< mapped memory (or CPU copy)
+    std::size_t          m_used = 0;
+    unsigned             m_writers = 0;   ///< pending copies into the mapped memory
+    unsigned             m_chunks = 0;    ///< pending uploads
+    bool                 m_closed = false; ///< no more allocation
+    GLsync               m_fence = nullptr;
+    uint64_t             m_ticketDone = 0; ///< the requests up to this ticket are complete once this slot is consumed
+    std::vector<uint8_t> m_cpuCopy;       ///< without "m_mapBufferRange"
+  };
+
+  struct s_chunk
+  {
+    s_request   m_request;
+    unsigned    m_slot;
+    std::size_t m_offset;
+    std::size_t m_byteSize;
+  };
+
+  struct s_cursor
+  {
+    unsigned    m_slot;
+    std::size_t m_used;
+  };
+
+  // The mutex must be locked.
+  bool _advance(s_cursor &cursor, const std::size_t byteSize, std::size_t &offset) const; ///< find the room for a chunk after the cursor, in the mapped slots.
+  bool _reserve(s_chunk &chunk); ///< reserve the room for the chunk. The slot's writer-count is incremented.
+  void _map(s_slot &slot); ///< the PBO of the slot must be bound.
+  void _unmap(s_slot &slot); ///< the PBO of the slot must be bound.
+  void _upload(const s_chunk &chunk, GLenum &boundTarget, GLuint &boundTexture);
+
+  s_GLBackend              m_backend;
+  std::vector<s_slot>      m_slots;
+  std::size_t              m_slotByteSize = 0;
+  unsigned                 m_slotFilled = 0; ///< slot that receives the next requests
+  std::deque<s_chunk>      m_chunks;         ///< pending uploads, in the push order
+  uint64_t                 m_ticketNext = 1;
+  uint64_t                 m_ticketDone = 0;
+  s_stats                  m_stats;
+  mutable std::mutex       m_mutex;
+  std::condition_variable  m_roomCV;
+};
+
+// ============================================================================
+
+/**
+ * @brief The textureAtlas class packs rectangles (sprites, icons, glyphs) into a 2D-atlas, without rotation.
+ * Two packers are available: the skyline (bottom-left, fast) and the max-rects (best-short-side-fit, denser with heterogeneous sizes).
+ * With PACK_AUTO, the first batch is packed with both, and the denser packer is kept for the next insertions.
+ * The packing is done on cells of "m_alignment" pixels: the reserved rectangles (with padding) are aligned on the cells.
+ * It only computes the layout. The pixels are copied by the caller (ex: SDL_BlitSurface).
+ */
+class textureAtlas
+{
+public:
+
+  enum e_packing { PACK_AUTO, PACK_SKYLINE, PACK_MAXRECTS };
+
+  struct s_settings
+  {
+    unsigned  m_padding;   ///< margin in pixels around each rectangle (the space between 2 rectangles is twice the padding). Default: 1.
+    unsigned  m_alignment; ///< the reserved rectangles are aligned on multiples of this (power of 2). Use 2^n to keep the rectangles separated down to the mip-level n, or 4 for block-compressed atlases. Default: 1.
+    e_packing m_packing;
+
+    s_settings() : m_padding(1), m_alignment(1), m_packing(PACK_AUTO) {}
+  };
+
+  textureAtlas() = default;
+  textureAtlas(int w, int h, const s_settings &settings = s_settings()) { reset(w, h, settings); }
+
+  void reset(int w, int h, const s_settings &settings = s_settings()); ///< Clear the atlas, with the new dimensions (in pixels).
+  bool resetFit(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects, const s_settings &settings = s_settings(), int maxSize = 8192); ///< Reset with the smallest power-of-2 dimensions that fit all the rectangles, and pack them.
+
+  bool        insert(const glm::ivec2 &size, glm::ivec4 &outRect); ///< Insert a rectangle. outRect is {x, y, w, h} in pixels (without the padding). Returns false when there is no room.
+  std::size_t insert(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects); ///< Insert a batch of rectangles (sorted internally for a better packing). The rectangles without room have x = y = -1. Returns the count of packed rectangles.
+
+  int       w() const { return m_w; }
+  int       h() const { return m_h; }
+  int       usedHeight() const; ///< the bottom of the lowest reserved rectangle, in pixels (the atlas can be cropped to it).
+  float     occupancy() const { return float(m_usedArea) / float(std::max(m_w * m_h, 1)); } ///< area of the packed rectangles (without padding) over the atlas area.
+  e_packing packing() const { return m_packing; } ///< the packer in use (PACK_AUTO until the first insertion).
+
+  glm::vec4 uvRect(const glm::ivec4 &rect) const; ///< {Au, Av, Bu, Bv} of a packed rectangle, for "modelRaw2D::fillDataRectangle" (A is the bottom-left corner, the first row of the texture is the top).
+  void      uvRemap(const span<glm::ivec4> &rects, std::vector<glm::vec4> &outUVs) const; ///< uvRect of each packed rectangle.
+
+  /// The instanced models with VI_ATLAS address a regular grid of cells, with the uniform "AtlasInvDim" = cellSize / atlas-size.
+  /// The rectangles of the cell's size are on the grid when packed with zero padding and the cell's size as alignment.
+  int       gridIndex(const glm::ivec4 &rect, const glm::ivec2 &cellSize) const; ///< index of the cell (the value of VI_ATLAS), or -1 when the rectangle is not a cell of the grid.
+  glm::vec2 gridInvDim(const glm::ivec2 &cellSize) const { return glm::vec2(cellSize) / glm::vec2(m_w, m_h); } ///< value of the uniform "AtlasInvDim".
+
+private:
+
+  struct s_skylineNode { int m_x, m_y, m_w; }; ///< in cells
+  struct s_rect { int m_x, m_y, m_w, m_h; };   ///< in cells
+
+  glm::ivec2 _cellSize(const glm::ivec2 &size) const; ///< reserved size, in cells
+  void       _toPixels(const s_rect &cellRect, const glm::ivec2 &size, glm::ivec4 &outRect) const;
+
+  std::size_t _insertBatch(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects); ///< sorted insertion, with the packer in use (not PACK_AUTO).
+
+  bool _skylineInsert(const int w, const int h, s_rect &outRect);
+  bool _skylineFit(const std::size_t inode, const int w, const int h, int &y) const;
+  bool _maxRectsInsert(const int w, const int h, s_rect &outRect);
+  void _maxRectsSplit(const s_rect &used);
+
+  int                        m_w = 0, m_h = 0;         ///< in pixels
+  int                        m_wCell = 0, m_hCell = 0; ///< in cells
+  s_settings                 m_settings;
+  e_packing                  m_packing = PACK_AUTO;
+  int                        m_usedHeightCell = 0;
+  std::size_t                m_usedArea = 0;
+  std::vector<s_skylineNode> m_skyline;
+  std::vector<s_rect>        m_freeRects;
+  std::vector<s_rect>        m_freeRectsNew; ///< scratch of the split
 };
 
 } // namespace
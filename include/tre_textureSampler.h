@@ -4,6 +4,9 @@
 #define GLM_FORCE_INTRINSICS
 #include <glm/glm.hpp>
 
+#include <array>
+#include <cstddef>
+#include <functional>
 #include <vector>
 
 struct SDL_Surface;
@@ -16,6 +19,7 @@ namespace tre {
 /**
  * @brief textureSampler provides functions to re-sample textures to a new UV space.
  * Those functions should be used with off-line processes or in background thread, as they are not optimized/simplified to run in real-time (use the GPU for real-time needs).
+ * The sampling is split into tiles (or rows) that are processed with "parallelFor".
  */
 
 namespace textureSampler {
@@ -81,6 +85,22 @@ void resample_toCubeMap(s_ImageData_R32F *outTexture, TIFF        *inTextureEqui
 
 /// @}
 
+/// @{
+/** resample with equirectangular sphere projection, streamed (out-of-core):
+ * Like resample_toCubeMap(), but the outTexture (of size outW * outH) is not allocated: it is produced per tiles.
+ * The tiles are processed in the order of their first in-row, such as the in-texture is read once, from top to bottom.
+ * Each finished tile is given to "outTile" with its position (u0, v0) in the outTexture, then it is released.
+ * The memory used by the tiles and by the TIFF decoding stays below "budgetInBytes". It returns false if the budget is too small.
+ */
+
+typedef std::function<void(unsigned u0, unsigned v0, SDL_Surface *tile)>             t_tileCallbackRGBA;
+typedef std::function<void(unsigned u0, unsigned v0, const s_ImageData_R32F &tile)> t_tileCallbackR32F;
+
+bool resample_toCubeMap_streamed(const unsigned outW, const unsigned outH, const t_tileCallbackRGBA &outTile, TIFF *inTextureEquirectangular, const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr, const std::size_t budgetInBytes);
+bool resample_toCubeMap_streamed(const unsigned outW, const unsigned outH, const t_tileCallbackR32F &outTile, TIFF *inTextureEquirectangular, const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr, const std::size_t budgetInBytes);
+
+/// @}
+
 /// @{
 /** generate normals from equirectangular sphere projected texture:
  * Like resample() functions, it samples the inTexture within the sub-equirectangular projection defined by in_coord0, in_coordU_incr, in_coordV_incr.
@@ -97,6 +117,63 @@ void mapNormals_toCubeMap(SDL_Surface *outTexture, TIFF        *inTextureEquirec
 
 // ----------------------------------------------------------------------------
 
+/**
+ * @brief s_IBLSettings configures the prefiltering of cube-maps for image-based lighting.
+ */
+struct s_IBLSettings
+{
+  unsigned m_sampleCount = 128;   ///< GGX importance-samples per texel
+  bool     m_gammaCorrect = true; ///< the pixels are in the sRGB color-space (the filtering is done in the linear space)
+};
+
+/// @{
+/** prefilter cube-maps for image-based lighting (typically, the faces produced by resample_toCubeMap()):
+ * - prefilterIBL_specular creates the full mip-chain of the cube-map, where the level "L" is the environment convolved with the GGX lobe
+ *   of roughness L / (levelCount - 1) (level 0 is the input). The shaders should sample the lod "roughness * (levelCount - 1)".
+ *   The created surfaces (outMipChain[level][face]) are owned by the caller. They can be baked with texture::writeCubeMipChain().
+ * - computeIBL_irradianceSH9 projects the environment onto the 9 first spherical-harmonics, convolved with the cosine-lobe and divided by PI.
+ *   Thus, the diffuse lighting is "sum(outSH[i] * Y_i(normal))".
+ * - mapIBL_irradiance evaluates the spherical-harmonics into cube-faces (for baking with texture::writeCube()).
+ * The cube-faces are square and ordered as the OpenGL cube-map targets (+X, -X, +Y, -Y, +Z, -Z).
+ */
+
+bool prefilterIBL_specular(std::vector<std::array<SDL_Surface*, 6> > &outMipChain, const std::array<SDL_Surface*, 6> &inCubeFaces, const s_IBLSettings &settings = s_IBLSettings());
+bool computeIBL_irradianceSH9(glm::vec3 outSH[9], const std::array<SDL_Surface*, 6> &inCubeFaces, const bool gammaCorrect = true);
+void mapIBL_irradiance(const std::array<SDL_Surface*, 6> &outCubeFaces, const glm::vec3 inSH[9], const bool gammaCorrect = true);
+
+/// @}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief s_TIFFCacheSettings configures the decoding of TIFF images (striped or tiled):
+ * The decoded strips (or tiles) are kept in a LRU-cache, bounded by the memory budget (at least 2 strips or tiles are kept).
+ * With "m_prefetch", a background thread decodes ahead the strips (or tiles) that the sampling will read next.
+ * The settings are used by the next sampling calls.
+ */
+struct s_TIFFCacheSettings
+{
+  std::size_t m_budgetInBytes = 64 * 1024 * 1024;
+  bool        m_prefetch = true;
+};
+
+/**
+ * @brief s_TIFFCacheStats reports the decoding of TIFF images, accumulated over the sampling calls.
+ */
+struct s_TIFFCacheStats
+{
+  std::size_t m_decodeCount = 0;   ///< decoded strips (or tiles)
+  std::size_t m_prefetchCount = 0; ///< decoded strips (or tiles) by the background thread
+  std::size_t m_missCount = 0;     ///< decoded strips (or tiles) while the sampling was waiting for them
+  std::size_t m_peakBytes = 0;     ///< maximal memory used by the cache
+};
+
+void             setTIFFCacheSettings(const s_TIFFCacheSettings &settings);
+s_TIFFCacheStats getTIFFCacheStats();
+void             resetTIFFCacheStats();
+
+// ----------------------------------------------------------------------------
+
 } // namespace textureSampler
 
 } // namespace tre
@@ -4,8 +4,10 @@
 #include "tre_openglinclude.h"
 
 #include <array>
+#include <atomic>
 #include <vector>
 #include <iostream>
+#include <functional>
 
 // macros =====================================================================
 
@@ -259,6 +261,58 @@ public:
   typename std::array<_T, capacity>::const_iterator end() const noexcept { return std::array<_T, capacity>::begin() + m_sizeCounted; } // this overwrites the std::array<>::end()
 };
 
+/**
+ * @brief class spscQueue
+ * Wait-free ring-buffer, with a single producer thread and a single consumer thread.
+ * The storage is pre-allocated: "push" fails when the queue is full, and "pop" fails when the queue is empty.
+ * The indices of each side are on their own cache-line, and each side caches the other side's index, so that
+ * the shared atomics are only read when the cached value says the queue is full (producer) or empty (consumer).
+ */
+template<typename _T, std::size_t capacity>
+class spscQueue
+{
+  static_assert((capacity != 0) && (capacity & (capacity - 1)) == 0, "spscQueue requires a power-of-two capacity.");
+
+public:
+  /// Producer-side. Returns false if the queue is full.
+  bool push(const _T &element) noexcept
+  {
+    const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_headCached == capacity)
+    {
+      m_headCached = m_head.load(std::memory_order_acquire);
+      if (tail - m_headCached == capacity) return false;
+    }
+    m_data[tail & (capacity - 1)] = element;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer-side. Returns false if the queue is empty.
+  bool pop(_T &element) noexcept
+  {
+    const std::size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tailCached)
+    {
+      m_tailCached = m_tail.load(std::memory_order_acquire);
+      if (head == m_tailCached) return false;
+    }
+    element = m_data[head & (capacity - 1)];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Approximated size (exact when called from the producer or the consumer while the other side is idle).
+  std::size_t sizeApprox() const noexcept { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+private:
+  alignas(64) std::atomic<std::size_t> m_head = { 0 }; ///< written by the consumer
+  std::size_t                          m_tailCached = 0; ///< consumer-side copy of "m_tail"
+  alignas(64) std::atomic<std::size_t> m_tail = { 0 }; ///< written by the producer
+  std::size_t                          m_headCached = 0; ///< producer-side copy of "m_head"
+  alignas(64) std::array<_T, capacity> m_data;
+};
+
 /// @}
 // Open-GL =====================================================================
 /// @name OpenGL
@@ -597,6 +651,28 @@ template<class _T> void sortRadix(tre::span<_T> array)
 
 }
 
+/// @}
+// Threading ==================================================================
+/// @name Threading
+/// @{
+
+/**
+ * @brief parallelFor
+ * Run "fnct(iBegin, iEnd)" on the chunks of the range [0, count), with the calling thread and the workers of an internal thread-pool.
+ * The chunks are dispatched on demand, so the load is balanced even if the chunks have different costs.
+ * It returns when all chunks are processed.
+ * The chunks are processed on the calling thread only when the platform has no thread support, or when the thread-pool is already busy (nested or concurrent calls).
+ * @param[in] count the number of items
+ * @param[in] grain the number of items per chunk (not zero)
+ * @param[in] fnct the function called on each chunk
+ */
+void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t iBegin, std::size_t iEnd)> &fnct);
+
+/**
+ * @brief parallelThreadCount returns the number of threads used by "parallelFor" (including the calling thread)
+ */
+unsigned parallelThreadCount();
+
 /// @}
 // Shader-Model ===============================================================
 /// @name Shaders and Models
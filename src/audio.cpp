@@ -2,6 +2,8 @@
 
 #include "tre_utils.h"
 
+#include <smmintrin.h> // SSE4.1
+
 #ifdef TRE_PROFILE
 #include <chrono>
 #endif
@@ -10,6 +12,21 @@
 #include "opus.h"
 #endif
 
+#if !defined(TRE_EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+#define TRE_WITH_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#endif
+
+#if !defined(_WIN32) && !defined(TRE_EMSCRIPTEN)
+#define TRE_WITH_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #define SOUND_BIN_VERSION 0x003
 
 namespace tre
@@ -510,244 +527,1766 @@ unsigned soundData::s_Opus::getBlockAtSampleId(int sid) const
   return unsigned(m_blokcs.size() - 1);
 }
 
-// soundSampler ===============================================================
+// soundData::s_OpusStream ====================================================
 
-soundSampler::s_sampler_Opus::s_sampler_Opus()
-{
-  m_decompressedBuffer.fill(0);
-}
+const int      soundData::s_OpusStream::m_freq;
+const unsigned soundData::s_OpusStream::k_cacheBlockCount;
 
 // ----------------------------------------------------------------------------
 
-soundSampler::s_sampler_Opus::~s_sampler_Opus()
+struct soundData::s_OpusStream::s_io
 {
-#ifdef TRE_WITH_OPUS
-  if (m_decoder != nullptr) opus_decoder_destroy(m_decoder);
-  m_decoder = nullptr;
-#endif
-}
+  // file read into the cache (when the file is not mapped)
+  std::ifstream        m_file;
+  std::vector<uint8_t> m_cache; ///< slots of "m_slotSize" bytes
+  unsigned             m_slotSize = 0;
 
-// ----------------------------------------------------------------------------
+  struct s_loaded
+  {
+    uint32_t m_gen;
+    unsigned m_block;
+    unsigned m_slot;
+  };
+  spscQueue<unsigned, k_cacheBlockCount> m_freeSlots; ///< reader -> I/O thread
+  spscQueue<s_loaded, k_cacheBlockCount> m_loadedSlots; ///< I/O thread -> reader, in the block sequence
+
+  // mapped file
+  uint8_t    *m_mapBase = nullptr;
+  std::size_t m_mapSize = 0;
+  uint64_t    m_mapOffset = 0; ///< file position of "m_mapBase" (page aligned)
+  int         m_mapFile = -1; ///< kept open to evict the dropped pages from the page-cache
+
+  // reader -> I/O thread
+  std::atomic<uint32_t> m_requestGen = { 0 };
+  std::atomic<unsigned> m_requestBlock = { 0 }; ///< first block of the sequence to read ahead
+  std::atomic<unsigned> m_readerBlock = { 0 }; ///< last acquired block (mapped file)
+
+  // I/O thread -> reader
+  std::atomic<uint64_t> m_readyBlocks = { 0 }; ///< blocks with resident pages (mapped file): first block in the high 32 bits, count in the low 32 bits
+
+  // reader data
+  uint32_t m_readerGen = 0;
+  unsigned m_readerNext = unsigned(-1); ///< next block expected in the sequence
+  s_loaded m_held = { 0, unsigned(-1), 0 }; ///< block returned by the last "acquireBlock"
+
+  // I/O thread data
+  uint32_t m_ioGen = 0;
+  unsigned m_ioBlock = 0;
+
+  struct s_pages
+  {
+    std::size_t m_begin = 0; ///< page indices in the mapping
+    std::size_t m_end = 0;
+    bool contains(std::size_t page) const { return page >= m_begin && page < m_end; }
+  };
 
-bool soundSampler::s_sampler_Opus::decodeSlot(const soundData::s_Opus &data, unsigned slot)
-{
-#ifdef TRE_WITH_OPUS
-  if (m_decoder == nullptr)
+  /// Blocks ready from "block", given the packed "m_readyBlocks"
+  static unsigned _readyFrom(uint64_t ready, unsigned block, unsigned blockCount)
   {
-    int error;
-    m_decoder = opus_decoder_create(soundData::s_Opus::m_freq, 2, &error);
-    if (m_decoder == nullptr)
-      return false;
-    opus_decoder_ctl(m_decoder, OPUS_RESET_STATE);
+    const unsigned first = unsigned(ready >> 32);
+    const unsigned count = unsigned(ready & 0xFFFFFFFF);
+    const unsigned distance = (block >= first) ? block - first : block + blockCount - first;
+    return (distance < count) ? count - distance : 0;
   }
-  if (slot == unsigned(-1) || slot >= data.m_blokcs.size())
-    return false;
-  if (slot == m_decompressedSlot)
-    return true;
 
-  const int blockSampleCount = opus_packet_get_nb_samples(data.m_blokcs[slot].m_data.data(), opus_int32(data.m_blokcs[slot].m_data.size()), soundData::s_Opus::m_freq);
-  if (blockSampleCount < 0 || blockSampleCount > 2880)
+#ifdef TRE_WITH_THREADS
+  std::thread             m_thread;
+  std::atomic<bool>       m_quit = { false };
+  std::mutex              m_mutex;
+  std::condition_variable m_wakeCV;
+#endif
+
+  bool _readBlock(const s_blockRef &ref, uint8_t *dst)
+  {
+    m_file.seekg(std::ifstream::pos_type(ref.m_offset));
+    m_file.read(reinterpret_cast<char*>(dst), ref.m_size);
+    if (m_file) return true;
+    TRE_LOG("s_OpusStream: fail to read the file");
+    m_file.clear();
     return false;
+  }
 
-  const int ret = opus_decode(m_decoder, data.m_blokcs[slot].m_data.data(), opus_int32(data.m_blokcs[slot].m_data.size()), m_decompressedBuffer.data(), blockSampleCount, 0);
-  m_decompressedSlot = slot;
-  m_decompressedCount = blockSampleCount;
+  /// Read the next block of the sequence into a free slot. Returns false if there is nothing to do.
+  bool _readAhead(const std::vector<s_blockRef> &blocks)
+  {
+    const uint32_t gen = m_requestGen.load(std::memory_order_acquire);
+    if (gen == 0) return false; // nothing requested yet
+    if (gen != m_ioGen)
+    {
+      m_ioGen = gen;
+      m_ioBlock = m_requestBlock.load(std::memory_order_relaxed);
+    }
+    unsigned slot;
+    if (!m_freeSlots.pop(slot)) return false; // the cache is full
+    _readBlock(blocks[m_ioBlock], m_cache.data() + slot * m_slotSize);
+    const bool pushed = m_loadedSlots.push(s_loaded{ gen, m_ioBlock, slot });
+    TRE_ASSERT(pushed);
+    (void)pushed;
+    m_ioBlock = (m_ioBlock + 1 == blocks.size()) ? 0 : m_ioBlock + 1;
+    return true;
+  }
 
-  // copy last data (LR)
-  m_decompressedBuffer[blockSampleCount * 2 + 0] = m_decompressedBuffer[blockSampleCount * 2 - 2 + 0];
-  m_decompressedBuffer[blockSampleCount * 2 + 1] = m_decompressedBuffer[blockSampleCount * 2 - 2 + 1];
+#ifdef TRE_WITH_MMAP
+  /// Pages holding the file range [begin, end). The end is rounded up: a page shared by 2 ranges belongs to both.
+  s_pages _pages(uint64_t begin, uint64_t end) const
+  {
+    const uint64_t pageSize = uint64_t(sysconf(_SC_PAGESIZE));
+    s_pages pages;
+    pages.m_begin = std::size_t((begin - m_mapOffset) / pageSize);
+    pages.m_end = std::size_t(std::min(end - m_mapOffset + pageSize - 1, uint64_t(m_mapSize) + pageSize - 1) / pageSize);
+    return pages;
+  }
 
-  return (ret > 0);
-#else
-  (void)data;
-  (void)slot;
-  return false;
-#endif // OPUS
-}
+  void _advise(std::size_t pageBegin, std::size_t pageEnd, int advice)
+  {
+    if (pageEnd <= pageBegin) return;
+    const std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+    const std::size_t length = std::min(pageEnd * pageSize, m_mapSize) - pageBegin * pageSize;
+    madvise(m_mapBase + pageBegin * pageSize, length, advice);
+#ifdef POSIX_FADV_DONTNEED
+    if (advice == MADV_DONTNEED) posix_fadvise(m_mapFile, off_t(m_mapOffset + pageBegin * pageSize), off_t(length), POSIX_FADV_DONTNEED); // (the pages are not mapped anymore)
+#endif
+  }
 
-// audio-Context methods ======================================================
+  /// Drop the pages that are not in "keep" (the pages read by a previous window, or by the process before).
+  void _dropOutside(const s_pages (&keep)[2])
+  {
+    const std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+    const std::size_t pageCount = (m_mapSize + pageSize - 1) / pageSize;
+    std::size_t       runBegin = 0;
+    for (std::size_t page = 0; page < pageCount; ++page)
+    {
+      if (!keep[0].contains(page) && !keep[1].contains(page)) continue;
+      _advise(runBegin, page, MADV_DONTNEED);
+      runBegin = page + 1;
+    }
+    _advise(runBegin, pageCount, MADV_DONTNEED);
+  }
 
-bool audioContext::startSystem(const char *deviceName, unsigned bufferMS, SDL_AudioSpec *requiredAudioSpec)
-{
-  TRE_ASSERT(m_deviceID == 0 && m_audioSpec == nullptr);
+  /// Prefetch the mapped pages of the blocks ahead of the reader, and drop the pages behind it.
+  /// The pages are touched, then the blocks are published as ready: the reader never faults on a page not read yet.
+  void _prefetch(const std::vector<s_blockRef> &blocks)
+  {
+    const unsigned blockCount = unsigned(blocks.size());
+    const unsigned count = std::min(k_cacheBlockCount, blockCount);
+    const unsigned block = m_readerBlock.load();
+    const uint64_t ready = m_readyBlocks.load(std::memory_order_relaxed);
+    const unsigned readyCount = _readyFrom(ready, block, blockCount);
+    if (unsigned(ready >> 32) == block && readyCount == count) return; // up to date
+
+    // revoke the ready blocks behind the reader, before dropping their pages.
+    // The reader stores its block before loading the ready blocks: if it has moved meanwhile, it is seen here (seq_cst on both sides).
+    m_readyBlocks.store((uint64_t(block) << 32) | readyCount);
+    if (m_readerBlock.load() != block) return; // retry from the new position
+
+    const unsigned blockLast = std::min(block + count, blockCount) - 1;
+    s_pages window[2];
+    window[0] = _pages(blocks[block].m_offset, blocks[blockLast].m_offset + blocks[blockLast].m_size);
+    if (block + count > blockCount) // the next lap
+    {
+      const unsigned headLast = block + count - blockCount - 1;
+      window[1] = _pages(blocks[0].m_offset, blocks[headLast].m_offset + blocks[headLast].m_size);
+    }
 
-  // Open the audio device
-  SDL_AudioSpec audioSettingsWanted;
+    _dropOutside(window);
+    _advise(window[0].m_begin, window[0].m_end, MADV_WILLNEED);
+    _advise(window[1].m_begin, window[1].m_end, MADV_WILLNEED);
 
-  if (requiredAudioSpec == nullptr)
-  {
-    // Default audio settings
-    audioSettingsWanted.freq = 44100; // samples per seconds
-    audioSettingsWanted.channels = 2; // stereo
-    audioSettingsWanted.format = AUDIO_S16LSB; // 16-bits signed (little-endian)
-    static_assert(SDL_BYTEORDER == SDL_LIL_ENDIAN, "Only implemented with little-endian system.");
+    // touch the pages in the block sequence (it waits for the disk), and publish the blocks
+    const std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+    std::size_t       pageTouched = std::size_t(-1);
+    uint8_t           sum = 0;
+    for (unsigned i = readyCount; i < count; ++i)
+    {
+      const unsigned b = (block + i < blockCount) ? block + i : block + i - blockCount;
+      const s_pages  pages = _pages(blocks[b].m_offset, blocks[b].m_offset + blocks[b].m_size);
+      for (std::size_t page = pages.m_begin; page < pages.m_end; ++page)
+      {
+        if (page != pageTouched) sum ^= *static_cast<volatile const uint8_t*>(m_mapBase + page * pageSize);
+        pageTouched = page;
+      }
+      m_readyBlocks.store((uint64_t(block) << 32) | (i + 1), std::memory_order_release);
+    }
+    (void)sum;
   }
-  else
+#endif
+
+#ifdef TRE_WITH_THREADS
+  void run(const std::vector<s_blockRef> &blocks)
   {
-    audioSettingsWanted = *requiredAudioSpec;
+    while (!m_quit.load(std::memory_order_relaxed))
+    {
+#ifdef TRE_WITH_MMAP
+      if (m_mapBase != nullptr)
+        _prefetch(blocks);
+      else
+#endif
+      if (_readAhead(blocks))
+        continue;
+
+      // poll again later (the reader never notifies, it can be the audio-thread)
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeCV.wait_for(lock, std::chrono::milliseconds(2), [this]() { return m_quit.load(std::memory_order_relaxed); });
+    }
   }
+#endif
+};
 
-  audioSettingsWanted.callback = audio_callback;
-  audioSettingsWanted.userdata = & m_audioCallbackContext;
+// ----------------------------------------------------------------------------
 
-  unsigned samples = (audioSettingsWanted.freq * bufferMS) / 1000;
-  // -> power of 2
-  {
-    int count = 0;
-    while ((samples = samples >> 1) != 0) ++count;
-    samples = 0x1 << count;
-  }
-  if (samples <  512) samples = 512;
-  if (samples > 8096) samples = 8096;
+bool soundData::s_OpusStream::open(const std::string &filename, uint64_t offset, bool allowMapping)
+{
+  close();
 
-  audioSettingsWanted.samples = uint16_t(samples);
+  s_io *io = new s_io;
 
-  m_audioSpec = new SDL_AudioSpec;
+  io->m_file.open(filename.c_str(), std::ifstream::binary);
+  if (!io->m_file)
+  {
+    TRE_LOG("s_OpusStream::open: fail to open the file " << filename);
+    delete io;
+    return false;
+  }
 
-  m_deviceID = SDL_OpenAudioDevice(deviceName, 0/*no capture*/, &audioSettingsWanted, m_audioSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
-  if (m_deviceID < 2)
+  // header (see s_Opus::write)
+  io->m_file.seekg(std::ifstream::pos_type(offset));
+  uint32_t header[8];
+  io->m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!io->m_file || header[0] != SOUND_BIN_VERSION || header[3] != 1 || header[5] != uint32_t(m_freq) || header[7] == 0)
   {
-    TRE_LOG("Couldn't open audio device: " << SDL_GetError());
-    delete m_audioSpec; m_audioSpec = nullptr;
+    TRE_LOG("s_OpusStream::open: invalid or incompatible Opus audio-data in " << filename);
+    delete io;
     return false;
   }
 
-  TRE_LOG("Audio device " << (deviceName == nullptr ? "(default)" : deviceName) << " is opened.\n(" <<
-          "freq = " << m_audioSpec->freq / 1000.f << " kHz, " <<
-          "hardware-buffer = " << m_audioSpec->samples * 1000 / m_audioSpec->freq << " ms, " <<
-          "channels = " << m_audioSpec->channels << ", "
-          "bytesPerSample = " << SDL_AUDIO_BITSIZE(m_audioSpec->format) / 8 << " )");
+  m_nSamples = header[1];
+  m_stereo   = (header[2] == 2);
 
-  if (m_audioSpec->channels != 2 || m_audioSpec->format != AUDIO_S16LSB)
+  // index of the blocks
+  m_blocks.resize(header[7]);
+  uint64_t position = offset + sizeof(header);
+  uint32_t sizeMax = 0;
+  for (s_blockRef &b : m_blocks)
   {
-    TRE_LOG("Invalid audio specifications.");
-    stopSystem();
-    return false;
+    int      sampleStart = 0;
+    uint32_t dsize = 0;
+    io->m_file.seekg(std::ifstream::pos_type(position));
+    io->m_file.read(reinterpret_cast<char*>(&sampleStart), sizeof(int));
+    io->m_file.read(reinterpret_cast<char*>(&dsize), sizeof(uint32_t));
+    if (!io->m_file || dsize == 0)
+    {
+      TRE_LOG("s_OpusStream::open: truncated Opus audio-data in " << filename);
+      m_blocks.clear();
+      m_nSamples = 0;
+      delete io;
+      return false;
+    }
+    b.m_offset = position + sizeof(int) + sizeof(uint32_t);
+    b.m_size = dsize;
+    b.m_sampleStart = sampleStart;
+    position = b.m_offset + dsize;
+    sizeMax = std::max(sizeMax, dsize);
   }
-  if (m_audioSpec->size != 2 * sizeof(int16_t) * m_audioSpec->samples)
+
+  // access to the blocks
+#ifdef TRE_WITH_MMAP
+  if (allowMapping)
   {
-    TRE_LOG("Unexpected audio buffer size : " << m_audioSpec->size << " != " << 2 * sizeof(int16_t) * m_audioSpec->samples);
-    stopSystem();
-    return false;
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+      const uint64_t pageSize = uint64_t(sysconf(_SC_PAGESIZE));
+      const uint64_t mapOffset = (offset / pageSize) * pageSize;
+      const std::size_t mapSize = std::size_t(position - mapOffset);
+      void *mapped = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, off_t(mapOffset));
+      if (mapped != MAP_FAILED)
+      {
+        io->m_mapBase = static_cast<uint8_t*>(mapped);
+        io->m_mapSize = mapSize;
+        io->m_mapOffset = mapOffset;
+        io->m_mapFile = fd;
+        io->m_file.close();
+        // the pages are read by the I/O thread only (no read-around on a fault), and the pages read to open the stream are dropped
+        madvise(mapped, mapSize, MADV_RANDOM);
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(fd, off_t(mapOffset), off_t(mapSize), POSIX_FADV_DONTNEED);
+#endif
+      }
+      else
+      {
+        ::close(fd);
+      }
+    }
   }
+#else
+  (void)allowMapping;
+#endif
 
-  // Setup the callback context
-  m_audioCallbackContext.ac_bufferF32.resize(m_audioSpec->samples * m_audioSpec->channels);
-  m_audioCallbackContext.ac_freq = m_audioSpec->freq;
-  m_audioCallbackContext.ac_channels = 2;
+  if (io->m_mapBase == nullptr)
+  {
+    io->m_slotSize = sizeMax;
+#ifdef TRE_WITH_THREADS
+    io->m_cache.resize(std::size_t(k_cacheBlockCount) * sizeMax);
+    for (unsigned slot = 0; slot < k_cacheBlockCount; ++slot) io->m_freeSlots.push(slot);
+#else
+    io->m_cache.resize(sizeMax); // the reader reads the blocks itself
+#endif
+  }
 
-  // Start playing
-  SDL_PauseAudioDevice(m_deviceID, 0);
+  m_io = io;
+
+#ifdef TRE_WITH_THREADS
+  io->m_thread = std::thread(&s_io::run, io, std::cref(m_blocks));
+#endif
+
+  TRE_LOG("s_OpusStream::open: " << filename << " (Samples = " << m_nSamples << ", Blocks = " << m_blocks.size() << ", " << (isMapped() ? "mapped" : "cached") << ")");
 
   return true;
 }
 
 // ----------------------------------------------------------------------------
 
-void audioContext::updateSystem()
+void soundData::s_OpusStream::close()
 {
-  TRE_ASSERT(m_deviceID >= 2 && m_audioSpec != nullptr);
-
-  SDL_LockAudioDevice(m_deviceID);
+  if (m_io == nullptr) return;
 
-  m_audioCallbackContext.ac_listSounds = m_listSounds;
-
-  for (soundInterface *sb : m_listSounds)
+#ifdef TRE_WITH_THREADS
   {
-    sb->sync();
+    std::lock_guard<std::mutex> lock(m_io->m_mutex);
+    m_io->m_quit.store(true, std::memory_order_relaxed);
   }
+  m_io->m_wakeCV.notify_all();
+  m_io->m_thread.join();
+#endif
 
-#ifdef TRE_PROFILE
-  m_perf_nbrCall     = m_audioCallbackContext.ac_perf_nbrCall;
-  m_perf_elapsedTime = m_audioCallbackContext.ac_perf_elapsedTime;
-  m_perf_accElapsedTime = 0.95f * m_perf_accElapsedTime + 0.05f * m_perf_elapsedTime;
-  m_perf_accGenTime     = 0.95f * m_perf_accGenTime     + 0.05f * m_audioCallbackContext.ac_perf_genTime;
-  m_audioCallbackContext.ac_perf_nbrCall = 0;
-  m_audioCallbackContext.ac_perf_elapsedTime = 0.f;
-  m_audioCallbackContext.ac_perf_genTime = 0.f;
+#ifdef TRE_WITH_MMAP
+  if (m_io->m_mapBase != nullptr) munmap(m_io->m_mapBase, m_io->m_mapSize);
+  if (m_io->m_mapFile >= 0) ::close(m_io->m_mapFile);
 #endif
 
-  SDL_UnlockAudioDevice(m_deviceID);
+  delete m_io;
+  m_io = nullptr;
+
+  m_blocks.clear();
+  m_nSamples = 0;
 }
 
 // ----------------------------------------------------------------------------
 
-void audioContext::stopSystem()
+bool soundData::s_OpusStream::isMapped() const
 {
-  if (m_deviceID >= 2)
+  return m_io != nullptr && m_io->m_mapBase != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned soundData::s_OpusStream::getBlockAtSampleId(int sid) const
+{
+  for (unsigned ib = 0; ib < m_blocks.size(); ++ib)
   {
-    SDL_CloseAudioDevice(m_deviceID);
-    m_deviceID = 0;
+    if (sid < m_blocks[ib].m_sampleStart)
+      return unsigned(ib - 1);
   }
+  return unsigned(m_blocks.size() - 1);
+}
 
-  if (m_audioSpec != nullptr)
+// ----------------------------------------------------------------------------
+
+const uint8_t *soundData::s_OpusStream::acquireBlock(unsigned block, unsigned &size) const
+{
+  TRE_ASSERT(m_io != nullptr && block < m_blocks.size());
+  s_io             &io = *m_io;
+  const s_blockRef &ref = m_blocks[block];
+  size = ref.m_size;
+
+  if (io.m_mapBase != nullptr)
   {
-    delete m_audioSpec;
-    m_audioSpec = nullptr;
+#ifdef TRE_WITH_THREADS
+    io.m_readerBlock.store(block); // (seq_cst, see "s_io::_prefetch")
+    if (s_io::_readyFrom(io.m_readyBlocks.load(), block, unsigned(m_blocks.size())) == 0) return nullptr; // the pages are not read yet
+#endif
+    return io.m_mapBase + (ref.m_offset - io.m_mapOffset); // (without the I/O thread, the reader reads the pages itself)
   }
 
-  m_audioCallbackContext.ac_freq = 0;
-  m_audioCallbackContext.ac_channels = 0;
-  m_audioCallbackContext.ac_bufferF32.clear();
-  m_audioCallbackContext.ac_listSounds.clear();
+#ifdef TRE_WITH_THREADS
+  if (io.m_held.m_block == block && io.m_held.m_gen == io.m_readerGen)
+    return io.m_cache.data() + io.m_held.m_slot * io.m_slotSize;
+
+  if (block != io.m_readerNext) // out of the sequence: restart the read-ahead
+  {
+    ++io.m_readerGen;
+    io.m_requestBlock.store(block, std::memory_order_relaxed);
+    io.m_requestGen.store(io.m_readerGen, std::memory_order_release);
+    io.m_readerNext = block;
+  }
+
+  // release the previous block, and the blocks read ahead before the restart
+  if (io.m_held.m_block != unsigned(-1))
+  {
+    io.m_freeSlots.push(io.m_held.m_slot);
+    io.m_held.m_block = unsigned(-1);
+  }
+  s_io::s_loaded loaded;
+  while (io.m_loadedSlots.pop(loaded))
+  {
+    if (loaded.m_gen == io.m_readerGen && loaded.m_block == block)
+    {
+      io.m_held = loaded;
+      io.m_readerNext = (block + 1 == m_blocks.size()) ? 0 : block + 1;
+      return io.m_cache.data() + loaded.m_slot * io.m_slotSize;
+    }
+    io.m_freeSlots.push(loaded.m_slot);
+  }
+  return nullptr; // not read yet
+#else
+  return io._readBlock(ref, io.m_cache.data()) ? io.m_cache.data() : nullptr;
+#endif
 }
 
 // ----------------------------------------------------------------------------
 
-void audioContext::addSound(soundInterface *sound)
+std::size_t soundData::s_OpusStream::residentSize() const
 {
-  for (soundInterface *sBis : m_listSounds)
-  {
-    if (sBis == sound) return; // already added !
-  }
+  if (m_io == nullptr) return 0;
+  if (m_io->m_mapBase == nullptr) return m_io->m_cache.size();
+
+#ifdef TRE_WITH_MMAP
+  // the resident pages of the mapping
+  const std::size_t pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+#ifdef __APPLE__
+  std::vector<char> residency((m_io->m_mapSize + pageSize - 1) / pageSize);
+#else
+  std::vector<unsigned char> residency((m_io->m_mapSize + pageSize - 1) / pageSize);
+#endif
+  if (mincore(m_io->m_mapBase, m_io->m_mapSize, residency.data()) != 0) return 0;
+  std::size_t resident = 0;
+  for (const auto r : residency) resident += (r & 1) * pageSize;
+  return resident;
+#else
+  return 0;
+#endif
+}
 
-  sound->sync(); // sync data.
+// ----------------------------------------------------------------------------
+
+unsigned soundData::s_OpusStream::readyAhead() const
+{
+  if (m_io == nullptr) return 0;
+#ifdef TRE_WITH_THREADS
+  if (m_io->m_mapBase != nullptr)
+    return s_io::_readyFrom(m_io->m_readyBlocks.load(), m_io->m_readerBlock.load(std::memory_order_relaxed), unsigned(m_blocks.size()));
+  return unsigned(m_io->m_loadedSlots.sizeApprox()) + (m_io->m_held.m_block != unsigned(-1) ? 1 : 0);
+#else
+  return unsigned(-1);
+#endif
+}
+
+// soundSampler ===============================================================
+
+const unsigned soundSampler::s_blockGains::k_blockSize;
+const unsigned soundSampler::s_blockGains::k_blockCountMax;
+const unsigned soundSampler::s_blockGains::k_tableCount;
+const uint8_t  soundSampler::s_blockGains::k_noTable;
+
+// ----------------------------------------------------------------------------
 
-  m_listSounds.push_back(sound);
+/// Number of samples, limited to "countMax", whose position "origin + i * ratio" is lower than "posEnd".
+/// It is evaluated with the float arithmetic used by the kernels.
+static unsigned _segmentLength(const float origin, const float ratio, const float posEnd, const unsigned countMax)
+{
+  const double estimate = std::ceil((double(posEnd) - double(origin)) / double(ratio));
+  unsigned     n = unsigned(glm::clamp(estimate, 0., double(countMax)));
+  while (n > 0 && origin + float(n - 1) * ratio >= posEnd) --n;
+  while (n < countMax && origin + float(n) * ratio < posEnd) ++n;
+  return n;
 }
 
 // ----------------------------------------------------------------------------
 
-void audioContext::removeSound(soundInterface *sound)
+/// Load the interpolation pairs of 4 samples, as float (not normalized).
+template<typename _rawType, bool _stereo>
+static inline void _load4(const _rawType * __restrict src, const __m128i vIdx, __m128 &vL0, __m128 &vR0, __m128 &vL1, __m128 &vR1)
 {
-  for (soundInterface* &sBis : m_listSounds)
+  alignas(16) int idx[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(idx), vIdx);
+
+  if (std::is_same<_rawType, int16_t>::value)
   {
-    if (sBis == sound)
+    // the 2 values of a pair are loaded with a 32-bit word
+    if (!_stereo)
     {
-      sBis = m_listSounds.back(); // replace the pointer.
-      m_listSounds.pop_back();
-      return;
+      int32_t w[4];
+      for (unsigned k = 0; k < 4; ++k) memcpy(&w[k], src + idx[k], sizeof(int32_t));
+      const __m128i vW = _mm_setr_epi32(w[0], w[1], w[2], w[3]);
+      vL0 = vR0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(vW, 16), 16));
+      vL1 = vR1 = _mm_cvtepi32_ps(_mm_srai_epi32(vW, 16));
+    }
+    else
+    {
+      int32_t w0[4], w1[4];
+      for (unsigned k = 0; k < 4; ++k)
+      {
+        memcpy(&w0[k], src + 2 * idx[k] + 0, sizeof(int32_t));
+        memcpy(&w1[k], src + 2 * idx[k] + 2, sizeof(int32_t));
+      }
+      const __m128i vW0 = _mm_setr_epi32(w0[0], w0[1], w0[2], w0[3]);
+      const __m128i vW1 = _mm_setr_epi32(w1[0], w1[1], w1[2], w1[3]);
+      vL0 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(vW0, 16), 16));
+      vR0 = _mm_cvtepi32_ps(_mm_srai_epi32(vW0, 16));
+      vL1 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(vW1, 16), 16));
+      vR1 = _mm_cvtepi32_ps(_mm_srai_epi32(vW1, 16));
+    }
+  }
+  else
+  {
+    const int c = _stereo ? 2 : 1;
+    vL0 = _mm_cvtepi32_ps(_mm_setr_epi32(int32_t(src[c * idx[0]    ]), int32_t(src[c * idx[1]    ]), int32_t(src[c * idx[2]    ]), int32_t(src[c * idx[3]    ])));
+    vL1 = _mm_cvtepi32_ps(_mm_setr_epi32(int32_t(src[c * idx[0] + c]), int32_t(src[c * idx[1] + c]), int32_t(src[c * idx[2] + c]), int32_t(src[c * idx[3] + c])));
+    if (!_stereo)
+    {
+      vR0 = vL0;
+      vR1 = vL1;
+    }
+    else
+    {
+      vR0 = _mm_cvtepi32_ps(_mm_setr_epi32(int32_t(src[2 * idx[0] + 1]), int32_t(src[2 * idx[1] + 1]), int32_t(src[2 * idx[2] + 1]), int32_t(src[2 * idx[3] + 1])));
+      vR1 = _mm_cvtepi32_ps(_mm_setr_epi32(int32_t(src[2 * idx[0] + 3]), int32_t(src[2 * idx[1] + 3]), int32_t(src[2 * idx[2] + 3]), int32_t(src[2 * idx[3] + 3])));
     }
   }
 }
 
 // ----------------------------------------------------------------------------
 
-void audioContext::getDevicesName(std::vector<std::string> &devices)
+/// Gains of a block (quadratic ramp, or table).
+struct s_gainRamp
 {
-  devices.clear();
+  float       m_gainL, m_gainR;
+  float       m_slopeL, m_slopeR;
+  float       m_curveL, m_curveR;
+  const float *m_tableL, *m_tableR;
 
-  const int nDevices = SDL_GetNumAudioDevices(0 /*capture*/);
-  if (nDevices <= 0) return;
+  s_gainRamp(const soundSampler::s_blockGains &gains, unsigned iblock)
+  {
+    m_gainL  = gains.m_gainL[iblock];
+    m_gainR  = gains.m_gainR[iblock];
+    m_slopeL = gains.m_slopeL[iblock];
+    m_slopeR = gains.m_slopeR[iblock];
+    m_curveL = gains.m_curveL[iblock];
+    m_curveR = gains.m_curveR[iblock];
+    const bool hasTable = (gains.m_tableId[iblock] != soundSampler::s_blockGains::k_noTable);
+    m_tableL = hasTable ? gains.m_tableL.data() + gains.m_tableId[iblock] * soundSampler::s_blockGains::k_blockSize : nullptr;
+    m_tableR = hasTable ? gains.m_tableR.data() + gains.m_tableId[iblock] * soundSampler::s_blockGains::k_blockSize : nullptr;
+  }
+};
 
-  devices.resize(nDevices);
-  for (int i = 0; i < nDevices; ++i)
-    devices[i] = SDL_GetAudioDeviceName(int(i), 0 /*capture*/);
+/**
+ * @brief Resample with linear interpolation, apply the gains, and add the result into the stereo buffer.
+ * The i-th sample (i in [0, count)) is at the position "origin + (step + i) * ratio" in the source,
+ * and it is the (gainOffset + i)-th sample of the gain block.
+ * The peak and the sum of the squared values are accumulated.
+ */
+template<typename _rawType, bool _stereo, bool _gainTable>
+static void _mixLinear(const _rawType * __restrict src, const int idxMax, const float normalizer,
+                       const float origin, const float ratio, const unsigned step,
+                       const s_gainRamp &ramp, const unsigned gainOffset,
+                       float * __restrict outBufferAdd, const unsigned count, float &peak, float &sumSquare)
+{
+  const __m128  vOrigin = _mm_set1_ps(origin);
+  const __m128  vRatio = _mm_set1_ps(ratio);
+  const __m128i vIdxMax = _mm_set1_epi32(idxMax);
+  const __m128  vNorm = _mm_set1_ps(normalizer);
+  const __m128  vOne = _mm_set1_ps(1.f);
+  const __m128  vHalf = _mm_set1_ps(0.5f);
+  const __m128  vAbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  const __m128  vGainL = _mm_set1_ps(ramp.m_gainL);
+  const __m128  vGainR = _mm_set1_ps(ramp.m_gainR);
+  const __m128  vSlopeL = _mm_set1_ps(ramp.m_slopeL);
+  const __m128  vSlopeR = _mm_set1_ps(ramp.m_slopeR);
+  const __m128  vCurveL = _mm_set1_ps(ramp.m_curveL);
+  const __m128  vCurveR = _mm_set1_ps(ramp.m_curveR);
+  const __m128i vLane = _mm_setr_epi32(0, 1, 2, 3);
+  __m128        vPeak = _mm_setzero_ps();
+  __m128        vSumSquare = _mm_setzero_ps();
+
+  unsigned i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    const __m128  vPos = _mm_add_ps(vOrigin, _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(int(step + i)), vLane)), vRatio));
+    const __m128i vIdx = _mm_min_epi32(_mm_cvttps_epi32(vPos), vIdxMax);
+    const __m128  vW1 = _mm_sub_ps(vPos, _mm_cvtepi32_ps(vIdx));
+    const __m128  vW0 = _mm_sub_ps(vOne, vW1);
+
+    __m128 vL0, vR0, vL1, vR1;
+    _load4<_rawType, _stereo>(src, vIdx, vL0, vR0, vL1, vR1);
+
+    __m128 vGL, vGR;
+    if (_gainTable)
+    {
+      vGL = _mm_loadu_ps(ramp.m_tableL + gainOffset + i);
+      vGR = _mm_loadu_ps(ramp.m_tableR + gainOffset + i);
+    }
+    else
+    {
+      const __m128 vG = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(int(gainOffset + i)), vLane));
+      vGL = _mm_add_ps(vGainL, _mm_mul_ps(vG, _mm_add_ps(vSlopeL, _mm_mul_ps(vG, vCurveL))));
+      vGR = _mm_add_ps(vGainR, _mm_mul_ps(vG, _mm_add_ps(vSlopeR, _mm_mul_ps(vG, vCurveR))));
+    }
+    const __m128 vL = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vW0, _mm_mul_ps(vL0, vNorm)), _mm_mul_ps(vW1, _mm_mul_ps(vL1, vNorm))), vGL);
+    const __m128 vR = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vW0, _mm_mul_ps(vR0, vNorm)), _mm_mul_ps(vW1, _mm_mul_ps(vR1, vNorm))), vGR);
+
+    float * __restrict out = outBufferAdd + 2 * i;
+    _mm_storeu_ps(out + 0, _mm_add_ps(_mm_loadu_ps(out + 0), _mm_unpacklo_ps(vL, vR)));
+    _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4), _mm_unpackhi_ps(vL, vR)));
+
+    vPeak = _mm_max_ps(vPeak, _mm_max_ps(_mm_and_ps(vL, vAbsMask), _mm_and_ps(vR, vAbsMask)));
+    vSumSquare = _mm_add_ps(vSumSquare, _mm_mul_ps(vHalf, _mm_add_ps(_mm_mul_ps(vL, vL), _mm_mul_ps(vR, vR))));
+  }
+
+  alignas(16) float tmp[4];
+  _mm_store_ps(tmp, vPeak);
+  peak = std::max(peak, std::max(std::max(tmp[0], tmp[1]), std::max(tmp[2], tmp[3])));
+  _mm_store_ps(tmp, vSumSquare);
+  sumSquare += (tmp[0] + tmp[1]) + (tmp[2] + tmp[3]);
+
+  const int c = _stereo ? 2 : 1;
+  for (; i < count; ++i)
+  {
+    const float pos = origin + float(step + i) * ratio;
+    const int   idx = std::min(int(pos), idxMax);
+    const float w1 = pos - float(idx);
+    const float w0 = 1.f - w1;
+    const float g = float(gainOffset + i);
+    const float gL = _gainTable ? ramp.m_tableL[gainOffset + i] : ramp.m_gainL + g * (ramp.m_slopeL + g * ramp.m_curveL);
+    const float gR = _gainTable ? ramp.m_tableR[gainOffset + i] : ramp.m_gainR + g * (ramp.m_slopeR + g * ramp.m_curveR);
+    const float valueL = (w0 * (float(src[c * idx        ]) * normalizer) + w1 * (float(src[c * idx + c        ]) * normalizer)) * gL;
+    const float valueR = (w0 * (float(src[c * idx + c - 1]) * normalizer) + w1 * (float(src[c * idx + c + c - 1]) * normalizer)) * gR;
+    outBufferAdd[2 * i + 0] += valueL;
+    outBufferAdd[2 * i + 1] += valueR;
+    peak = std::max(peak, std::max(std::abs(valueL), std::abs(valueR)));
+    sumSquare += 0.5f * (valueL * valueL + valueR * valueR);
+  }
 }
 
 // ----------------------------------------------------------------------------
 
-static void _copystream_F32LR_I16LR(const float * __restrict instream, int16_t * __restrict outstream, unsigned nsamples)
+/// Resample a segment of the source, on the output range [curSample, curSample + count), split on the boundaries of the gain blocks.
+template<typename _rawType, bool _stereo>
+static void _mixSegment(const _rawType * __restrict src, const int idxMax, const float normalizer, const float origin, const float ratio,
+                        const soundSampler::s_blockGains &gains, float * __restrict outBufferAdd, const unsigned curSample, const unsigned count,
+                        float &peak, float &sumSquare)
 {
-  const int16_t *outstop = outstream + 2 * nsamples;
-  while (outstream < outstop)
+  const unsigned bs = soundSampler::s_blockGains::k_blockSize;
+  unsigned step = 0;
+  while (step < count)
   {
-    const float vF32 = glm::clamp(*instream++, -1.f, 1.f);
-    *outstream++ = int16_t(vF32 * 0x7FFF);
+    const unsigned iOut = curSample + step;
+    const unsigned iblock = iOut / bs;
+    const unsigned gainOffset = iOut - iblock * bs;
+    const unsigned n = std::min(count - step, bs - gainOffset);
+    const s_gainRamp ramp(gains, iblock);
+    if (ramp.m_tableL != nullptr)
+      _mixLinear<_rawType, _stereo, true >(src, idxMax, normalizer, origin, ratio, step, ramp, gainOffset, outBufferAdd + 2 * iOut, n, peak, sumSquare);
+    else
+      _mixLinear<_rawType, _stereo, false>(src, idxMax, normalizer, origin, ratio, step, ramp, gainOffset, outBufferAdd + 2 * iOut, n, peak, sumSquare);
+    step += n;
   }
 }
 
-void audioContext::s_audioCallbackContext::run(uint8_t * stream, int len)
+// ----------------------------------------------------------------------------
+
+/**
+ * The polyphase windowed-sinc filter.
+ * The kernel is a sinc (cut-off "k_cutoff", relative to the Nyquist frequency of the source), with a Kaiser window over "k_taps" source samples.
+ * It is tabulated at compile-time on "k_phases + 1" fractional positions. Each phase is normalized (unit DC gain).
+ * The coefficient of the k-th tap at the phase p is "h(k - (k_taps / 2 - 1) - p / k_phases)".
+ * The kernel is also tabulated on a flat grid (step "1 / k_phases", not normalized), to be read at any position by the stretched filter.
+ */
+namespace sincFilter
+{
+static const unsigned   k_taps = 32; ///< must be a multiple of 4
+static const unsigned   k_phases = 128;
+static constexpr double k_cutoff = 0.86;
+static constexpr double k_beta = 7.; ///< ~70 dB of stop-band attenuation
+static const unsigned   k_ratioMax = 16; ///< above, the linear interpolation is used
+static const int        k_halfMax = int(k_taps / 4) * int(k_ratioMax) * 2; ///< max half-length of the stretched filter
+static const int        k_windowSize = int(soundSampler::s_blockGains::k_blockSize) * int(k_ratioMax) + 2 * k_halfMax + 4; ///< max nbr of source samples used by a gain block
+
+constexpr double _pi = 3.14159265358979323846;
+
+constexpr double _sin(double x)
+{
+  while (x >  _pi) x -= 2. * _pi;
+  while (x < -_pi) x += 2. * _pi;
+  double term = x, sum = x;
+  for (int n = 1; n < 12; ++n)
+  {
+    term *= -x * x / double((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+/// I0(x), from "q = (x / 2)^2" (no square-root is needed for the window). The series stops when the terms are negligible.
+constexpr double _besselI0(double q)
+{
+  double term = 1., sum = 1.;
+  for (int k = 1; k < 32 && term > 1.e-17 * sum; ++k)
+  {
+    term *= q / double(k * k);
+    sum += term;
+  }
+  return sum;
+}
+
+static constexpr double k_windowNorm = 1. / _besselI0(0.25 * k_beta * k_beta);
+
+constexpr double _kernel(double x)
+{
+  const double halfLength = double(k_taps / 2);
+  if (x <= -halfLength || x >= halfLength) return 0.;
+  const double a = _pi * k_cutoff * x;
+  const double sinc = (x == 0.) ? k_cutoff : _sin(a) / (_pi * x);
+  const double r = x / halfLength;
+  return sinc * _besselI0(0.25 * k_beta * k_beta * (1. - r * r)) * k_windowNorm;
+}
+
+struct s_flatTable
+{
+  alignas(16) std::array<float, k_taps * k_phases + 2> m_coefs; ///< "h(j / k_phases - k_taps / 2)", with zero on both ends
+};
+
+constexpr s_flatTable _buildFlatTable()
+{
+  // the kernel is even: only the first half is evaluated (the compile-time evaluation has a limited budget)
+  s_flatTable table = {};
+  for (unsigned j = 0; j <= k_taps * k_phases / 2; ++j)
+  {
+    table.m_coefs[j] = float(_kernel(double(j) / double(k_phases) - double(k_taps / 2)));
+    table.m_coefs[k_taps * k_phases - j] = table.m_coefs[j];
+  }
+  table.m_coefs[k_taps * k_phases + 1] = 0.f;
+  return table;
+}
+
+static constexpr s_flatTable k_flatTable = _buildFlatTable();
+
+struct s_table
+{
+  alignas(16) std::array<float, (k_phases + 1) * k_taps> m_coefs;
+};
+
+constexpr s_table _buildTable()
+{
+  // the k-th tap at the phase p is read in the flat table at "(k + 1) * k_phases - p"
+  s_table table = {};
+  for (unsigned p = 0; p <= k_phases; ++p)
+  {
+    double sum = 0.;
+    for (unsigned k = 0; k < k_taps; ++k)
+      sum += double(k_flatTable.m_coefs[(k + 1) * k_phases - p]);
+    for (unsigned k = 0; k < k_taps; ++k)
+      table.m_coefs[p * k_taps + k] = float(double(k_flatTable.m_coefs[(k + 1) * k_phases - p]) / sum);
+  }
+  return table;
+}
+
+static constexpr s_table k_table = _buildTable();
+}
+
+// ----------------------------------------------------------------------------
+
+/// Convert the source samples [first, first + count) into float (normalized), wrapped if "repeat", or zero outside the data.
+template<typename _rawType, bool _stereo>
+static void _fillWindow(const _rawType * __restrict src, const int dataCount, const bool repeat, const float normalizer,
+                        const int first, const int count, float * __restrict winL, float * __restrict winR)
+{
+  const int c = _stereo ? 2 : 1;
+  int j = 0;
+  while (j < count)
+  {
+    int idx = first + j;
+    if (repeat)
+    {
+      idx %= dataCount;
+      if (idx < 0) idx += dataCount;
+    }
+    else if (idx < 0 || idx >= dataCount)
+    {
+      winL[j] = 0.f;
+      if (_stereo) winR[j] = 0.f;
+      ++j;
+      continue;
+    }
+    const int run = std::min(count - j, dataCount - idx);
+    const _rawType * __restrict s = src + c * idx;
+    for (int k = 0; k < run; ++k)
+    {
+      winL[j + k] = float(s[c * k]) * normalizer;
+      if (_stereo) winR[j + k] = float(s[c * k + 1]) * normalizer;
+    }
+    j += run;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+/**
+ * @brief Resample with the polyphase windowed-sinc filter, apply the gains, and add the result into the stereo buffer.
+ * The i-th sample (i in [0, count)) is at the position "origin + (step + i) * ratio" in the source. The source samples are read
+ * from the window, that starts at the source position "winFirst".
+ * With "_stretched", the kernel is stretched by "ratio" (cut-off lowered under the Nyquist frequency of the output), and
+ * its coefficients are interpolated from the flat table, for each tap. Else, 2 phases of the polyphase table are interpolated.
+ */
+template<bool _stereo, bool _gainTable, bool _stretched>
+static void _mixSinc(const float * __restrict winL, const float * __restrict winR, const int winFirst, const int half,
+                     const float origin, const float ratio, const unsigned step,
+                     const s_gainRamp &ramp, const unsigned gainOffset,
+                     float * __restrict outBufferAdd, const unsigned count, float &peak, float &sumSquare)
+{
+  const float   *table = sincFilter::k_table.m_coefs.data();
+  const int     taps = 2 * half;
+  const float   *flat = sincFilter::k_flatTable.m_coefs.data();
+  const float   scale = 1.f / ratio;
+  const __m128  vStep = _mm_set1_ps(scale * float(sincFilter::k_phases));
+  const __m128  vStep4 = _mm_set1_ps(4.f * scale * float(sincFilter::k_phases));
+  const __m128  vFlatEnd = _mm_set1_ps(float(sincFilter::k_taps * sincFilter::k_phases));
+  const __m128  vLane = _mm_setr_ps(0.f, 1.f, 2.f, 3.f);
+  const __m128  vZero = _mm_setzero_ps();
+
+  for (unsigned i = 0; i < count; ++i)
+  {
+    const float pos = origin + float(step + i) * ratio;
+    const int   idx = int(pos);
+    const float frac = pos - float(idx);
+    const float * __restrict wL = winL + (idx - half + 1 - winFirst);
+    const float * __restrict wR = winR + (idx - half + 1 - winFirst);
+
+    __m128 vAccL = _mm_setzero_ps();
+    __m128 vAccR = _mm_setzero_ps();
+    float  norm = 1.f;
+    if (!_stretched)
+    {
+      const float  phase = frac * float(sincFilter::k_phases);
+      const int    p = std::min(int(phase), int(sincFilter::k_phases) - 1);
+      const __m128 vT = _mm_set1_ps(phase - float(p));
+      const float  *rowA = table + p * sincFilter::k_taps;
+      const float  *rowB = rowA + sincFilter::k_taps;
+      for (unsigned k = 0; k < sincFilter::k_taps; k += 4)
+      {
+        const __m128 vA = _mm_load_ps(rowA + k);
+        const __m128 vC = _mm_add_ps(vA, _mm_mul_ps(vT, _mm_sub_ps(_mm_load_ps(rowB + k), vA)));
+        vAccL = _mm_add_ps(vAccL, _mm_mul_ps(vC, _mm_loadu_ps(wL + k)));
+        if (_stereo) vAccR = _mm_add_ps(vAccR, _mm_mul_ps(vC, _mm_loadu_ps(wR + k)));
+      }
+    }
+    else
+    {
+      // the k-th tap is at the offset "x = k - half + 1 - frac" from "pos": its coefficient is "h(x / ratio)",
+      // read in the flat table at "(x / ratio + k_taps / 2) * k_phases". Out of the kernel, the position is clamped on a zero.
+      const float  f0 = ((float(1 - half) - frac) * scale + float(sincFilter::k_taps / 2)) * float(sincFilter::k_phases);
+      __m128       vF = _mm_add_ps(_mm_set1_ps(f0), _mm_mul_ps(vLane, vStep));
+      __m128       vSum = _mm_setzero_ps();
+      for (int k = 0; k < taps; k += 4, vF = _mm_add_ps(vF, vStep4))
+      {
+        const __m128  vFc = _mm_min_ps(_mm_max_ps(vF, vZero), vFlatEnd);
+        const __m128i vIdx = _mm_cvttps_epi32(vFc);
+        const __m128  vT = _mm_sub_ps(vFc, _mm_cvtepi32_ps(vIdx));
+
+        alignas(16) int tIdx[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(tIdx), vIdx);
+        const __m128 vAB01 = _mm_loadh_pi(_mm_loadl_pi(vZero, reinterpret_cast<const __m64*>(flat + tIdx[0])), reinterpret_cast<const __m64*>(flat + tIdx[1]));
+        const __m128 vAB23 = _mm_loadh_pi(_mm_loadl_pi(vZero, reinterpret_cast<const __m64*>(flat + tIdx[2])), reinterpret_cast<const __m64*>(flat + tIdx[3]));
+        const __m128 vA = _mm_shuffle_ps(vAB01, vAB23, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 vB = _mm_shuffle_ps(vAB01, vAB23, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 vC = _mm_add_ps(vA, _mm_mul_ps(vT, _mm_sub_ps(vB, vA)));
+
+        vSum = _mm_add_ps(vSum, vC);
+        vAccL = _mm_add_ps(vAccL, _mm_mul_ps(vC, _mm_loadu_ps(wL + k)));
+        if (_stereo) vAccR = _mm_add_ps(vAccR, _mm_mul_ps(vC, _mm_loadu_ps(wR + k)));
+      }
+      vSum = _mm_hadd_ps(vSum, vSum);
+      vSum = _mm_hadd_ps(vSum, vSum);
+      norm = 1.f / _mm_cvtss_f32(vSum);
+    }
+
+    if (!_stereo) vAccR = vAccL;
+    __m128 vAcc = _mm_hadd_ps(vAccL, vAccR);
+    vAcc = _mm_hadd_ps(vAcc, vAcc);
+    alignas(16) float acc[4];
+    _mm_store_ps(acc, vAcc);
+
+    const float g = float(gainOffset + i);
+    const float gL = _gainTable ? ramp.m_tableL[gainOffset + i] : ramp.m_gainL + g * (ramp.m_slopeL + g * ramp.m_curveL);
+    const float gR = _gainTable ? ramp.m_tableR[gainOffset + i] : ramp.m_gainR + g * (ramp.m_slopeR + g * ramp.m_curveR);
+    const float valueL = acc[0] * norm * gL;
+    const float valueR = acc[1] * norm * gR;
+    outBufferAdd[2 * i + 0] += valueL;
+    outBufferAdd[2 * i + 1] += valueR;
+    peak = std::max(peak, std::max(std::abs(valueL), std::abs(valueR)));
+    sumSquare += 0.5f * (valueL * valueL + valueR * valueR);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+/// Resample a segment of the source with the sinc filter, on the output range [curSample, curSample + count), split on the boundaries of the gain blocks.
+template<typename _rawType, bool _stereo>
+static void _mixSegmentSinc(const _rawType * __restrict src, const int dataCount, const bool repeat, const float normalizer, const float origin, const float ratio,
+                            const soundSampler::s_blockGains &gains, float * __restrict outBufferAdd, const unsigned curSample, const unsigned count,
+                            float &peak, float &sumSquare)
+{
+  TRE_ASSERT(ratio <= float(sincFilter::k_ratioMax));
+  const unsigned bs = soundSampler::s_blockGains::k_blockSize;
+  const bool     stretched = (ratio > 1.f);
+  const int      half = stretched ? 2 * int(std::ceil(float(sincFilter::k_taps / 4) * ratio)) : int(sincFilter::k_taps / 2);
+  TRE_ASSERT(half <= sincFilter::k_halfMax);
+
+  alignas(16) float windowL[sincFilter::k_windowSize];
+  alignas(16) float windowR[_stereo ? sincFilter::k_windowSize : 1];
+  float * __restrict winR = _stereo ? windowR : windowL;
+
+  unsigned step = 0;
+  while (step < count)
+  {
+    const unsigned iOut = curSample + step;
+    const unsigned iblock = iOut / bs;
+    const unsigned gainOffset = iOut - iblock * bs;
+    const unsigned n = std::min(count - step, bs - gainOffset);
+    const s_gainRamp ramp(gains, iblock);
+
+    const int first = int(origin + float(step) * ratio) - half + 1;
+    const int last = int(origin + float(step + n - 1) * ratio) + half;
+    TRE_ASSERT(last - first + 1 <= sincFilter::k_windowSize);
+    _fillWindow<_rawType, _stereo>(src, dataCount, repeat, normalizer, first, last - first + 1, windowL, winR);
+
+    float * __restrict out = outBufferAdd + 2 * iOut;
+    const bool hasTable = (ramp.m_tableL != nullptr);
+    if      ( hasTable &&  stretched) _mixSinc<_stereo, true , true >(windowL, winR, first, half, origin, ratio, step, ramp, gainOffset, out, n, peak, sumSquare);
+    else if ( hasTable && !stretched) _mixSinc<_stereo, true , false>(windowL, winR, first, half, origin, ratio, step, ramp, gainOffset, out, n, peak, sumSquare);
+    else if (!hasTable &&  stretched) _mixSinc<_stereo, false, true >(windowL, winR, first, half, origin, ratio, step, ramp, gainOffset, out, n, peak, sumSquare);
+    else                              _mixSinc<_stereo, false, false>(windowL, winR, first, half, origin, ratio, step, ramp, gainOffset, out, n, peak, sumSquare);
+    step += n;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void soundSampler::s_sampler_Raw::sample(const soundData::s_RawSDL &data, const s_blockGains &gains,
+                                         float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+{
+  const bool isS16 = (data.m_format == AUDIO_S16);
+  if (!isS16 && data.m_format != AUDIO_S32)
+    TRE_FATAL("soundSampler: the audio format (" << int(data.m_format) << ") for raw-sampling is not supported.");
+
+  const float    freqRatio = float(data.m_freq) / float(sampleFreq);
+  const unsigned dataSampleCount = data.m_nSamples;
+  const int      dataSampleCountM2 = int(dataSampleCount) - 2;
+  const float    normalizer = isS16 ? 1.f / float(std::numeric_limits<int16_t>::max()) : 1.f / float(std::numeric_limits<int32_t>::max());
+  unsigned       curSample = 0;
+
+  TRE_ASSERT(dataSampleCount != 0);
+  if (m_repet)
+  {
+    while (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
+  }
+
+  m_valuePeak = 0.f;
+  m_valueRMS = 0.f;
+
+  const bool useSinc = (m_interpolation == INTERP_SINC && freqRatio <= float(sincFilter::k_ratioMax));
+
+  while (m_cursor < dataSampleCount && curSample < sampleCount)
+  {
+    const unsigned n = _segmentLength(m_cursor, freqRatio, float(dataSampleCount), sampleCount - curSample);
+    if (n == 0) break;
+
+    if (useSinc)
+    {
+      if (isS16 && data.m_stereo)
+        _mixSegmentSinc<int16_t, true >(reinterpret_cast<const int16_t*>(data.m_rawData.data()), int(dataSampleCount), m_repet, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+      else if (isS16)
+        _mixSegmentSinc<int16_t, false>(reinterpret_cast<const int16_t*>(data.m_rawData.data()), int(dataSampleCount), m_repet, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+      else if (data.m_stereo)
+        _mixSegmentSinc<int32_t, true >(reinterpret_cast<const int32_t*>(data.m_rawData.data()), int(dataSampleCount), m_repet, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+      else
+        _mixSegmentSinc<int32_t, false>(reinterpret_cast<const int32_t*>(data.m_rawData.data()), int(dataSampleCount), m_repet, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+    }
+    else if (isS16 && data.m_stereo)
+      _mixSegment<int16_t, true >(reinterpret_cast<const int16_t*>(data.m_rawData.data()), dataSampleCountM2, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+    else if (isS16)
+      _mixSegment<int16_t, false>(reinterpret_cast<const int16_t*>(data.m_rawData.data()), dataSampleCountM2, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+    else if (data.m_stereo)
+      _mixSegment<int32_t, true >(reinterpret_cast<const int32_t*>(data.m_rawData.data()), dataSampleCountM2, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+    else
+      _mixSegment<int32_t, false>(reinterpret_cast<const int32_t*>(data.m_rawData.data()), dataSampleCountM2, normalizer, m_cursor, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+
+    curSample += n;
+    m_cursor = m_cursor + float(n) * freqRatio;
+
+    if (m_repet)
+    {
+      if (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
+    }
+  }
+
+  m_valueRMS = std::sqrt(m_valueRMS / sampleCount);
+}
+
+// ----------------------------------------------------------------------------
+
+const unsigned soundSampler::s_sampler_Opus::k_ringSize;
+const unsigned soundSampler::s_sampler_Opus::k_blockSizeMax;
+const unsigned soundSampler::s_sampler_Opus::k_prerollBlockCount;
+
+// ----------------------------------------------------------------------------
+
+soundSampler::s_sampler_Opus::~s_sampler_Opus()
+{
+#ifdef TRE_WITH_OPUS
+  if (m_decoder != nullptr) opus_decoder_destroy(m_decoder);
+  m_decoder = nullptr;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+void soundSampler::s_sampler_Opus::allocate()
+{
+  m_ring.resize(k_ringSize * 2, 0);
+  m_decodeBuffer.resize(k_blockSizeMax * 2, 0);
+}
+
+// ----------------------------------------------------------------------------
+
+#ifdef TRE_WITH_OPUS
+
+// Access to the encoded blocks, from the memory or from the file.
+
+static unsigned _blockCount(const soundData::s_Opus &data) { return unsigned(data.m_blokcs.size()); }
+static unsigned _blockCount(const soundData::s_OpusStream &data) { return unsigned(data.m_blocks.size()); }
+
+static int _blockSampleStart(const soundData::s_Opus &data, unsigned block) { return data.m_blokcs[block].m_sampleStart; }
+static int _blockSampleStart(const soundData::s_OpusStream &data, unsigned block) { return data.m_blocks[block].m_sampleStart; }
+
+static const uint8_t *_blockPacket(const soundData::s_Opus &data, unsigned block, unsigned &size)
+{
+  size = unsigned(data.m_blokcs[block].m_data.size());
+  return data.m_blokcs[block].m_data.data();
+}
+static const uint8_t *_blockPacket(const soundData::s_OpusStream &data, unsigned block, unsigned &size)
+{
+  return data.acquireBlock(block, size);
+}
+
+#endif // OPUS
+
+// ----------------------------------------------------------------------------
+
+template<class _opusData>
+bool soundSampler::s_sampler_Opus::_decode(const _opusData &data)
+{
+#ifdef TRE_WITH_OPUS
+  const unsigned blockCount = _blockCount(data);
+  if (m_ring.empty() || blockCount == 0 || data.m_nSamples == 0) return false;
+  if (m_decodeLock.exchange(true, std::memory_order_acquire)) return false; // another thread is decoding
+
+  if (m_decoder == nullptr)
+  {
+    int error;
+    m_decoder = opus_decoder_create(soundData::s_Opus::m_freq, 2, &error);
+    if (m_decoder == nullptr)
+    {
+      m_decodeLock.store(false, std::memory_order_release);
+      return false;
+    }
+  }
+
+  const int64_t nSamples = data.m_nSamples;
+  bool          decoded = false;
+
+  // seek: restart on the block of the target, after the pre-roll
+  const uint32_t seekGen = m_seekGen.load(std::memory_order_acquire);
+  if (seekGen != m_decodeGen)
+  {
+    const int64_t pos = m_seekPos.load(std::memory_order_relaxed);
+    TRE_ASSERT(pos >= 0);
+    m_decodeLapOffset = (pos / nSamples) * nSamples;
+    m_decodeBlock = data.getBlockAtSampleId(int(pos - m_decodeLapOffset));
+    if (m_decodeBlock >= blockCount) m_decodeBlock = 0;
+
+    opus_decoder_ctl(m_decoder, OPUS_RESET_STATE);
+    for (unsigned b = m_decodeBlock - std::min(m_decodeBlock, k_prerollBlockCount); b < m_decodeBlock; ++b)
+    {
+      unsigned       packetSize;
+      const uint8_t *packet = _blockPacket(data, b, packetSize);
+      if (packet == nullptr) // not read yet: the seek is done again on the next call
+      {
+        m_decodeLock.store(false, std::memory_order_release);
+        return false;
+      }
+      opus_decode(m_decoder, packet, opus_int32(packetSize), m_decodeBuffer.data(), int(k_blockSizeMax), 0); // dropped
+    }
+
+    const int64_t start = m_decodeLapOffset + _blockSampleStart(data, m_decodeBlock);
+    m_ringBegin.store(start, std::memory_order_relaxed);
+    m_ringEnd.store(start, std::memory_order_relaxed);
+    m_decodeFinished.store(false, std::memory_order_relaxed);
+    m_decodeGen = seekGen;
+    m_ringGen.store(seekGen, std::memory_order_release);
+    decoded = true;
+  }
+
+  // next lap
+  if (m_decodeBlock >= blockCount)
+  {
+    if (m_repetAhead.load(std::memory_order_relaxed))
+    {
+      m_decodeBlock = 0;
+      m_decodeLapOffset += nSamples;
+      m_decodeFinished.store(false, std::memory_order_relaxed);
+    }
+    else
+    {
+      m_decodeFinished.store(true, std::memory_order_release);
+    }
+  }
+
+  // decode the next block, if there is room in the ring
+  unsigned       packetSize = 0;
+  const uint8_t *packet = (m_decodeBlock < blockCount) ? _blockPacket(data, m_decodeBlock, packetSize) : nullptr; // (nullptr if not read yet)
+  if (packet != nullptr)
+  {
+    const int     count = opus_packet_get_nb_samples(packet, opus_int32(packetSize), soundData::s_Opus::m_freq);
+    const int64_t ringEnd = m_ringEnd.load(std::memory_order_relaxed);
+    const int64_t blockStart = m_decodeLapOffset + _blockSampleStart(data, m_decodeBlock);
+    const int64_t blockEnd = std::min(blockStart + std::max(count, 0), m_decodeLapOffset + nSamples); // the next lap starts at the end of the data
+    const int64_t readPos = m_readPos.load(std::memory_order_acquire);
+
+    if (count < 0 || count > int(k_blockSizeMax))
+    {
+      TRE_LOG("audio decoding: invalid Opus block " << m_decodeBlock);
+      ++m_decodeBlock; // skipped
+    }
+    else if (blockEnd <= readPos + int64_t(k_ringSize))
+    {
+      const int ret = opus_decode(m_decoder, packet, opus_int32(packetSize), m_decodeBuffer.data(), count, 0);
+      if (ret != count)
+      {
+        TRE_LOG("audio decoding: failed to decode the Opus block " << m_decodeBlock);
+        memset(m_decodeBuffer.data(), 0, count * 2 * sizeof(int16_t));
+      }
+
+      // copy into the ring, from its end (the overlap with the previous lap is dropped, a gap is filled with silence)
+      for (int64_t pos = ringEnd; pos < blockEnd; )
+      {
+        const unsigned r = unsigned(pos & int64_t(k_ringSize - 1));
+        const unsigned n = unsigned(std::min<int64_t>(blockEnd - pos, k_ringSize - r));
+        if (pos < blockStart)
+        {
+          const unsigned nGap = unsigned(std::min<int64_t>(n, blockStart - pos));
+          memset(m_ring.data() + 2 * r, 0, nGap * 2 * sizeof(int16_t));
+          pos += nGap;
+        }
+        else
+        {
+          memcpy(m_ring.data() + 2 * r, m_decodeBuffer.data() + 2 * (pos - blockStart), n * 2 * sizeof(int16_t));
+          pos += n;
+        }
+      }
+      if (blockEnd > ringEnd) m_ringEnd.store(blockEnd, std::memory_order_release);
+
+      ++m_decodeBlock;
+      decoded = true;
+    }
+  }
+
+  m_decodeLock.store(false, std::memory_order_release);
+  return decoded;
+#else
+  (void)data;
+  return false;
+#endif // OPUS
+}
+
+bool soundSampler::s_sampler_Opus::decode(const soundData::s_Opus &data)
+{
+  return _decode(data);
+}
+
+bool soundSampler::s_sampler_Opus::decode(const soundData::s_OpusStream &data)
+{
+  return _decode(data);
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned soundSampler::s_sampler_Opus::decodedAhead() const
+{
+  if (!m_backgroundDecoding.load(std::memory_order_relaxed) || m_ring.empty()) return unsigned(-1);
+  if (m_ringGen.load(std::memory_order_acquire) != m_seekGen.load(std::memory_order_acquire)) return 0; // seek pending
+  if (m_decodeFinished.load(std::memory_order_relaxed) && !m_repetAhead.load(std::memory_order_relaxed)) return unsigned(-1);
+  const int64_t ahead = m_ringEnd.load(std::memory_order_relaxed) - m_readPos.load(std::memory_order_relaxed);
+  if (ahead + int64_t(k_blockSizeMax) > int64_t(k_ringSize)) return unsigned(-1); // full
+  return unsigned(std::max<int64_t>(ahead, 0));
+}
+
+// ----------------------------------------------------------------------------
+
+bool soundSampler::s_sampler_Opus::_isStreamed(int64_t pos) const
+{
+  if (m_ringGen.load(std::memory_order_acquire) != m_seekGen.load(std::memory_order_relaxed)) // seek pending
+  {
+    const int64_t seekPos = m_seekPos.load(std::memory_order_relaxed);
+    return pos >= seekPos && pos <= seekPos + int64_t(k_blockSizeMax);
+  }
+  // the decoder may overwrite the data before "m_readPos"
+  return pos >= m_ringBegin.load(std::memory_order_relaxed) && pos >= m_readPos.load(std::memory_order_relaxed) &&
+         pos <= m_ringEnd.load(std::memory_order_relaxed) + int64_t(k_blockSizeMax);
+}
+
+// ----------------------------------------------------------------------------
+
+void soundSampler::s_sampler_Opus::_follow(int64_t pos)
+{
+  if (_isStreamed(pos))
+  {
+    m_readPos.store(pos, std::memory_order_release); // the data before is released
+    return;
+  }
+  m_seekPos.store(pos, std::memory_order_relaxed);
+  m_readPos.store(pos, std::memory_order_relaxed);
+  m_seekGen.fetch_add(1, std::memory_order_release);
+}
+
+// ----------------------------------------------------------------------------
+
+void soundSampler::s_sampler_Opus::_prepare(unsigned dataSampleCount)
+{
+  TRE_ASSERT(dataSampleCount != 0);
+
+  if (m_ring.empty()) allocate(); // the sound is not handled by an audio-context (else, it is allocated by "setAudioData")
+
+  if (m_repet)
+  {
+    while (m_cursor >= dataSampleCount)
+    {
+      m_cursor -= dataSampleCount;
+      m_lapOffset += dataSampleCount;
+    }
+  }
+  m_repetAhead.store(m_repet, std::memory_order_relaxed);
+
+  if (m_cursor < dataSampleCount) _follow(m_lapOffset + int(m_cursor));
+}
+
+// ----------------------------------------------------------------------------
+
+template<class _opusData>
+void soundSampler::s_sampler_Opus::_sample(const _opusData &data, const s_blockGains &gains,
+                                           float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+{
+  const float        freqRatio = float(soundData::s_Opus::m_freq) / float(sampleFreq);
+  const unsigned     dataSampleCount = data.m_nSamples;
+  const bool         decodeInline = !m_backgroundDecoding.load(std::memory_order_relaxed);
+  unsigned           curSample = 0;
+  static const float valueNormalizer = 1.f / float(0x7FFF);
+
+  const unsigned     chunkSize = 4096;
+  alignas(16) int16_t chunk[2 * chunkSize]; // decoded samples, copied from the ring
+
+  m_valuePeak = 0.f;
+  m_valueRMS = 0.f;
+  m_underrunCount = 0;
+
+  _prepare(dataSampleCount);
+
+  while (m_cursor < dataSampleCount && curSample < sampleCount)
+  {
+    const int     cursorInt = int(m_cursor);
+    const int64_t pos = m_lapOffset + cursorInt;
+    const float   localCursorOffset = m_cursor - float(cursorInt);
+    const float   localEnd = float(dataSampleCount - cursorInt);
+
+    _follow(pos);
+
+    if (decodeInline)
+    {
+      const int64_t posNeeded = pos + std::min(int64_t(chunkSize), int64_t(float(sampleCount - curSample) * freqRatio) + 2);
+      while ((m_ringGen.load(std::memory_order_relaxed) != m_seekGen.load(std::memory_order_relaxed) || m_ringEnd.load(std::memory_order_relaxed) < posNeeded) && decode(data)) {}
+    }
+
+    const bool    isSynced = (m_ringGen.load(std::memory_order_acquire) == m_seekGen.load(std::memory_order_relaxed));
+    const bool    isFinished = m_decodeFinished.load(std::memory_order_acquire);
+    const int64_t avail = isSynced ? std::min(m_ringEnd.load(std::memory_order_acquire) - pos, int64_t(chunkSize)) : 0;
+
+    unsigned n = 0;
+    if (avail >= 2)
+    {
+      // copy the decoded samples from the ring, and mix
+      const unsigned count = unsigned(avail);
+      const unsigned r0 = unsigned(pos & int64_t(k_ringSize - 1));
+      const unsigned count0 = std::min(count, k_ringSize - r0);
+      memcpy(chunk, m_ring.data() + 2 * r0, count0 * 2 * sizeof(int16_t));
+      memcpy(chunk + 2 * count0, m_ring.data(), (count - count0) * 2 * sizeof(int16_t));
+
+      n = _segmentLength(localCursorOffset, freqRatio, std::min(localEnd, float(count - 1)), sampleCount - curSample);
+      if (n == 0) break;
+
+      _mixSegment<int16_t, true>(chunk, int(count) - 2, valueNormalizer, localCursorOffset, freqRatio, gains, outBufferAdd, curSample, n, m_valuePeak, m_valueRMS);
+    }
+    else if (isSynced && isFinished && !m_repet)
+    {
+      m_cursor = float(dataSampleCount); // end of the data
+      break;
+    }
+    else
+    {
+      // the data is not decoded yet: silence (the cursor continues)
+      n = _segmentLength(localCursorOffset, freqRatio, localEnd, sampleCount - curSample);
+      if (n == 0) break;
+      if (isSynced) m_underrunCount += n;
+    }
+
+    curSample += n;
+    m_cursor += ((localCursorOffset + float(n) * freqRatio) - localCursorOffset);
+
+    if (m_repet && m_cursor >= dataSampleCount)
+    {
+      m_cursor -= dataSampleCount;
+      m_lapOffset += dataSampleCount;
+    }
+  }
+
+  if (m_cursor < dataSampleCount) _follow(m_lapOffset + int(m_cursor)); // release the played data
+
+  m_valueRMS = std::sqrt(m_valueRMS / sampleCount);
+}
+
+void soundSampler::s_sampler_Opus::sample(const soundData::s_Opus &data, const s_blockGains &gains,
+                                          float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+{
+  _sample(data, gains, outBufferAdd, sampleCount, sampleFreq);
+}
+
+void soundSampler::s_sampler_Opus::sample(const soundData::s_OpusStream &data, const s_blockGains &gains,
+                                          float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+{
+  _sample(data, gains, outBufferAdd, sampleCount, sampleFreq);
+}
+
+// ============================================================================
+
+// audio-Context methods ======================================================
+
+const unsigned audioContext::k_soundSlotCount;
+
+// ----------------------------------------------------------------------------
+
+/// Workers that decode the compressed sounds ahead of the audio-thread.
+/// A worker picks the sound with the least decoded data ahead, and decodes one block of it.
+struct audioContext::s_decoderPool
+{
+#ifdef TRE_WITH_THREADS
+  std::vector<std::thread> m_workers;
+  std::atomic<bool>        m_quit = { false };
+  std::mutex               m_mutex;
+  std::condition_variable  m_wakeCV;
+
+  void run(std::array<s_decodeSlot, k_soundSlotCount> &slots)
+  {
+    while (!m_quit.load(std::memory_order_relaxed))
+    {
+      // claim the most urgent sound. A claimed sound is not released by the audio-context.
+      // (the claim and the removal are sequentially consistent, so that one of them sees the other)
+      unsigned bestSlot = k_soundSlotCount;
+      unsigned bestAhead = unsigned(-1);
+      for (unsigned islot = 0; islot < k_soundSlotCount; ++islot)
+      {
+        s_decodeSlot &ds = slots[islot];
+        if (ds.m_sound.load(std::memory_order_relaxed) == nullptr || ds.m_busy.exchange(true)) continue;
+        soundInterface *sound = ds.m_sound.load();
+        const unsigned ahead = (sound != nullptr) ? sound->decodedAhead() : unsigned(-1);
+        if (ahead < bestAhead)
+        {
+          if (bestSlot != k_soundSlotCount) slots[bestSlot].m_busy.store(false, std::memory_order_release);
+          bestSlot = islot;
+          bestAhead = ahead;
+        }
+        else
+        {
+          ds.m_busy.store(false, std::memory_order_release);
+        }
+      }
+
+      if (bestSlot != k_soundSlotCount)
+      {
+        soundInterface *sound = slots[bestSlot].m_sound.load();
+        const bool      decoded = (sound != nullptr) && sound->decode();
+        slots[bestSlot].m_busy.store(false, std::memory_order_release);
+        if (decoded) continue;
+      }
+
+      // nothing to decode (or the encoded data is not available yet): poll again later (the audio-thread never notifies)
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wakeCV.wait_for(lock, std::chrono::milliseconds(2), [this]() { return m_quit.load(std::memory_order_relaxed); });
+    }
+  }
+#endif
+};
+
+// ----------------------------------------------------------------------------
+
+bool audioContext::startSystem(const char *deviceName, unsigned bufferMS, SDL_AudioSpec *requiredAudioSpec)
+{
+  TRE_ASSERT(m_deviceID == 0 && m_audioSpec == nullptr && !m_isOffline);
+
+  // Open the audio device
+  SDL_AudioSpec audioSettingsWanted;
+
+  if (requiredAudioSpec == nullptr)
+  {
+    // Default audio settings
+    audioSettingsWanted.freq = 44100; // samples per seconds
+    audioSettingsWanted.channels = 2; // stereo
+    audioSettingsWanted.format = AUDIO_S16LSB; // 16-bits signed (little-endian)
+    static_assert(SDL_BYTEORDER == SDL_LIL_ENDIAN, "Only implemented with little-endian system.");
+  }
+  else
+  {
+    audioSettingsWanted = *requiredAudioSpec;
+  }
+
+  audioSettingsWanted.callback = audio_callback;
+  audioSettingsWanted.userdata = & m_audioCallbackContext;
+
+  unsigned samples = (audioSettingsWanted.freq * bufferMS) / 1000;
+  // -> power of 2
+  {
+    int count = 0;
+    while ((samples = samples >> 1) != 0) ++count;
+    samples = 0x1 << count;
+  }
+  if (samples <  512) samples = 512;
+  if (samples > 8096) samples = 8096;
+
+  audioSettingsWanted.samples = uint16_t(samples);
+
+  m_audioSpec = new SDL_AudioSpec;
+
+  m_deviceID = SDL_OpenAudioDevice(deviceName, 0/*no capture*/, &audioSettingsWanted, m_audioSpec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+  if (m_deviceID < 2)
+  {
+    TRE_LOG("Couldn't open audio device: " << SDL_GetError());
+    delete m_audioSpec; m_audioSpec = nullptr;
+    return false;
+  }
+
+  TRE_LOG("Audio device " << (deviceName == nullptr ? "(default)" : deviceName) << " is opened.\n(" <<
+          "freq = " << m_audioSpec->freq / 1000.f << " kHz, " <<
+          "hardware-buffer = " << m_audioSpec->samples * 1000 / m_audioSpec->freq << " ms, " <<
+          "channels = " << m_audioSpec->channels << ", "
+          "bytesPerSample = " << SDL_AUDIO_BITSIZE(m_audioSpec->format) / 8 << " )");
+
+  if (m_audioSpec->channels != 2 || m_audioSpec->format != AUDIO_S16LSB)
+  {
+    TRE_LOG("Invalid audio specifications.");
+    stopSystem();
+    return false;
+  }
+  if (m_audioSpec->size != 2 * sizeof(int16_t) * m_audioSpec->samples)
+  {
+    TRE_LOG("Unexpected audio buffer size : " << m_audioSpec->size << " != " << 2 * sizeof(int16_t) * m_audioSpec->samples);
+    stopSystem();
+    return false;
+  }
+
+  // Setup the callback context
+  m_audioCallbackContext.ac_bufferF32.resize(m_audioSpec->samples * m_audioSpec->channels);
+  m_audioCallbackContext.ac_freq = m_audioSpec->freq;
+  m_audioCallbackContext.ac_channels = 2;
+
+  // Start playing
+  SDL_PauseAudioDevice(m_deviceID, 0);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool audioContext::startOffline(int freq, unsigned bufferSamples)
+{
+  TRE_ASSERT(m_deviceID == 0 && m_audioSpec == nullptr && !m_isOffline);
+  TRE_ASSERT(freq > 0 && bufferSamples != 0 && bufferSamples <= soundSampler::s_blockGains::k_blockSize * soundSampler::s_blockGains::k_blockCountMax);
+
+  m_audioCallbackContext.ac_bufferF32.resize(bufferSamples * 2);
+  m_audioCallbackContext.ac_freq = freq;
+  m_audioCallbackContext.ac_channels = 2;
+
+  m_isOffline = true;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::renderOffline(int16_t *outBufferLR, unsigned sampleCount)
+{
+  TRE_ASSERT(m_isOffline);
+
+  const unsigned bufferSamples = unsigned(m_audioCallbackContext.ac_bufferF32.size() / 2);
+  while (sampleCount != 0)
+  {
+    const unsigned n = std::min(sampleCount, bufferSamples);
+    m_audioCallbackContext.run(reinterpret_cast<uint8_t*>(outBufferLR), int(n * 2 * sizeof(int16_t)));
+    outBufferLR += 2 * n;
+    sampleCount -= n;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::updateSystem()
+{
+  for (s_slot &slot : m_slots)
+  {
+    if (slot.m_state == SLOT_USED) slot.m_sound->sync();
+  }
+
+  _receiveReleasedSlots();
+
+#ifdef TRE_PROFILE
+  s_perf perfRecv;
+  s_perf perf;
+  while (m_audioCallbackContext.ac_queuePerf.pop(perfRecv))
+  {
+    perf.m_nbrCall += perfRecv.m_nbrCall;
+    perf.m_elapsedTime += perfRecv.m_elapsedTime;
+    perf.m_maxElapsedTime = std::max(perf.m_maxElapsedTime, perfRecv.m_maxElapsedTime);
+    perf.m_genTime += perfRecv.m_genTime;
+  }
+  m_perf_nbrCall        = perf.m_nbrCall;
+  m_perf_elapsedTime    = perf.m_elapsedTime;
+  m_perf_maxElapsedTime = perf.m_maxElapsedTime;
+  m_perf_accElapsedTime = 0.95f * m_perf_accElapsedTime + 0.05f * perf.m_elapsedTime;
+  m_perf_accGenTime     = 0.95f * m_perf_accGenTime     + 0.05f * perf.m_genTime;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::stopSystem()
+{
+  stopDecoders();
+
+  if (m_deviceID >= 2)
+  {
+    SDL_CloseAudioDevice(m_deviceID);
+    m_deviceID = 0;
+  }
+  m_isOffline = false;
+
+  // The audio-callback is not running anymore: the calling thread takes its role to flush the queues.
+  m_audioCallbackContext.receiveCommands();
+  _receiveReleasedSlots();
+
+  if (m_audioSpec != nullptr)
+  {
+    delete m_audioSpec;
+    m_audioSpec = nullptr;
+  }
+
+  m_audioCallbackContext.ac_freq = 0;
+  m_audioCallbackContext.ac_channels = 0;
+  m_audioCallbackContext.ac_bufferF32.clear();
+}
+
+// ----------------------------------------------------------------------------
+
+bool audioContext::addSound(soundInterface *sound)
+{
+  unsigned freeSlot = k_soundSlotCount;
+  for (unsigned islot = 0; islot < k_soundSlotCount; ++islot)
+  {
+    const s_slot &slot = m_slots[islot];
+    if (slot.m_state == SLOT_USED && slot.m_sound == sound) return true; // already added !
+    if (slot.m_state == SLOT_FREE && freeSlot == k_soundSlotCount) freeSlot = islot;
+  }
+  if (freeSlot == k_soundSlotCount) return false; // no free slot
+
+  sound->sync(); // sync data.
+  sound->setBackgroundDecoding(m_decoderPool != nullptr);
+
+  m_slots[freeSlot].m_sound = sound;
+  m_slots[freeSlot].m_state = SLOT_USED;
+  m_decodeSlots[freeSlot].m_sound.store(sound, std::memory_order_release);
+
+  const bool pushed = m_audioCallbackContext.ac_queueCommands.push(s_command{ sound, freeSlot, s_command::CMD_ADD });
+  TRE_ASSERT(pushed);
+  (void)pushed;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::removeSound(soundInterface *sound)
+{
+  for (unsigned islot = 0; islot < k_soundSlotCount; ++islot)
+  {
+    s_slot &slot = m_slots[islot];
+    if (slot.m_state == SLOT_USED && slot.m_sound == sound)
+    {
+      slot.m_state = SLOT_RELEASING;
+      m_decodeSlots[islot].m_sound.store(nullptr);
+      const bool pushed = m_audioCallbackContext.ac_queueCommands.push(s_command{ sound, islot, s_command::CMD_REMOVE });
+      TRE_ASSERT(pushed);
+      (void)pushed;
+      return;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+bool audioContext::isReleased(const soundInterface *sound) const
+{
+  for (const s_slot &slot : m_slots)
+  {
+    if (slot.m_state != SLOT_FREE && slot.m_sound == sound) return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::_receiveReleasedSlots()
+{
+  unsigned islot;
+  while (m_audioCallbackContext.ac_queueReleased.pop(islot))
+  {
+    TRE_ASSERT(islot < k_soundSlotCount && m_slots[islot].m_state == SLOT_RELEASING);
+    m_slots[islot].m_state = SLOT_RELEASED;
+  }
+
+  for (islot = 0; islot < k_soundSlotCount; ++islot)
+  {
+    s_slot &slot = m_slots[islot];
+    if (slot.m_state == SLOT_RELEASED && !m_decodeSlots[islot].m_busy.load()) // no decoder worker uses the sound anymore
+    {
+      slot.m_sound = nullptr;
+      slot.m_state = SLOT_FREE;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+bool audioContext::startDecoders(unsigned workerCount)
+{
+#ifdef TRE_WITH_THREADS
+  TRE_ASSERT(workerCount != 0);
+  if (m_decoderPool != nullptr) return true; // already started
+
+  m_decoderPool = new s_decoderPool;
+  for (unsigned i = 0; i < workerCount; ++i)
+    m_decoderPool->m_workers.emplace_back(&s_decoderPool::run, m_decoderPool, std::ref(m_decodeSlots));
+
+  _setBackgroundDecoding(true);
+  return true;
+#else
+  (void)workerCount;
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::stopDecoders()
+{
+  if (m_decoderPool == nullptr) return;
+
+#ifdef TRE_WITH_THREADS
+  {
+    std::lock_guard<std::mutex> lock(m_decoderPool->m_mutex);
+    m_decoderPool->m_quit.store(true, std::memory_order_relaxed);
+  }
+  m_decoderPool->m_wakeCV.notify_all();
+  for (std::thread &worker : m_decoderPool->m_workers) worker.join();
+#endif
+
+  delete m_decoderPool;
+  m_decoderPool = nullptr;
+
+  _setBackgroundDecoding(false);
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::_setBackgroundDecoding(bool enabled)
+{
+  for (s_slot &slot : m_slots)
+  {
+    if (slot.m_state == SLOT_USED) slot.m_sound->setBackgroundDecoding(enabled);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::getDevicesName(std::vector<std::string> &devices)
+{
+  devices.clear();
+
+  const int nDevices = SDL_GetNumAudioDevices(0 /*capture*/);
+  if (nDevices <= 0) return;
+
+  devices.resize(nDevices);
+  for (int i = 0; i < nDevices; ++i)
+    devices[i] = SDL_GetAudioDeviceName(int(i), 0 /*capture*/);
+}
+
+// ----------------------------------------------------------------------------
+
+static void _copystream_F32LR_I16LR(const float * __restrict instream, int16_t * __restrict outstream, unsigned nsamples)
+{
+  const int16_t *outstop = outstream + 2 * nsamples;
+  while (outstream < outstop)
+  {
+    const float vF32 = glm::clamp(*instream++, -1.f, 1.f);
+    *outstream++ = int16_t(vF32 * 0x7FFF);
+  }
+}
+
+void audioContext::s_audioCallbackContext::receiveCommands()
+{
+  s_command cmd;
+  while (ac_queueCommands.pop(cmd))
+  {
+    if (cmd.m_type == s_command::CMD_ADD)
+    {
+      ac_slotToList[cmd.m_slot] = unsigned(ac_listSounds.sizeCounted());
+      ac_listSlots[ac_listSounds.sizeCounted()] = cmd.m_slot;
+      ac_listSounds.push_back(cmd.m_sound);
+    }
+    else
+    {
+      const unsigned ilist = ac_slotToList[cmd.m_slot];
+      const unsigned ilast = unsigned(ac_listSounds.sizeCounted() - 1);
+      TRE_ASSERT(ilist <= ilast && ac_listSounds[ilist] == cmd.m_sound);
+      ac_listSounds[ilist] = ac_listSounds[ilast]; // replace the pointer.
+      ac_listSlots[ilist] = ac_listSlots[ilast];
+      ac_slotToList[ac_listSlots[ilist]] = ilist;
+      ac_listSounds.pop_back();
+
+      const bool pushed = ac_queueReleased.push(cmd.m_slot);
+      TRE_ASSERT(pushed);
+      (void)pushed;
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void audioContext::s_audioCallbackContext::run(uint8_t * stream, int len)
 {
 #ifdef TRE_PROFILE
   typedef std::chrono::steady_clock systemclock;
@@ -760,6 +2299,8 @@ void audioContext::s_audioCallbackContext::run(uint8_t * stream, int len)
 
   TRE_ASSERT(sampleCount * ac_channels <= ac_bufferF32.size());
 
+  receiveCommands();
+
   memset(ac_bufferF32.data(), 0, sizeof(float) * ac_bufferF32.size());
 
   // mix sounds with floats
@@ -774,10 +2315,12 @@ void audioContext::s_audioCallbackContext::run(uint8_t * stream, int len)
 
 #ifdef TRE_PROFILE
   const systemclock::time_point tickEnd =  systemclock::now();
-  const double timeElapsed = std::chrono::duration<double, std::micro>(tickEnd - tickStart).count();
-  ac_perf_nbrCall += 1;
-  ac_perf_elapsedTime += float(timeElapsed * 1.e-6);
-  ac_perf_genTime += sampleCount / float(ac_freq);
+  const float timeElapsed = float(std::chrono::duration<double>(tickEnd - tickStart).count());
+  ac_perf.m_nbrCall += 1;
+  ac_perf.m_elapsedTime += timeElapsed;
+  ac_perf.m_maxElapsedTime = std::max(ac_perf.m_maxElapsedTime, timeElapsed);
+  ac_perf.m_genTime += sampleCount / float(ac_freq);
+  if (ac_queuePerf.push(ac_perf)) ac_perf = s_perf(); // the perf is accumulated until it is sent
 #endif
 }
 
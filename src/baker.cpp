@@ -66,6 +66,7 @@ bool baker::openBakedFile_forRead(const std::string &filename, unsigned &filever
   }
 
   std::ifstream &myFile = *m_fileInDescriptor;
+  m_fileInName = filename;
 
   s_header header;
   myFile.read(reinterpret_cast<char*>(& header), sizeof(s_header));
@@ -164,6 +165,7 @@ void baker::flushAndCloseFile()
   {
     // close
     m_blocksAdress.clear();
+    m_fileInName.clear();
     m_fileInDescriptor->close();
     delete m_fileInDescriptor;
     m_fileInDescriptor = nullptr;
@@ -217,6 +219,12 @@ bool baker::readBlock(soundData::s_Opus *s)
   return s->read(getBlockReadAndAdvance());
 }
 
+bool baker::readBlock(soundData::s_OpusStream *s)
+{
+  std::istream &stream = getBlockReadAndAdvance();
+  return s->open(m_fileInName, uint64_t(stream.tellg()));
+}
+
 // ============================================================================
 
 } // namespace
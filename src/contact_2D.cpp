@@ -3,6 +3,7 @@
 #include "tre_utils.h"
 
 #include <math.h>
+#include <algorithm>
 
 namespace tre {
 
@@ -1256,4 +1257,282 @@ bool s_contact2D::raytrace_poly(s_contact2D &hitInfo,
   return false;
 }
 
+// Broad-phase ================================================================
+
+static inline bool _broadphase_overlap(const glm::vec4 &boxA, const glm::vec4 &boxB)
+{
+  return boxA.x <= boxB.z && boxB.x <= boxA.z && boxA.y <= boxB.w && boxB.y <= boxA.w;
+}
+
+static inline bool _broadphase_ray(const glm::vec4 &box, const glm::vec2 &origin, const glm::vec2 &invDir, float rayEnd)
+{
+  const float tx0 = (box.x - origin.x) * invDir.x;
+  const float tx1 = (box.z - origin.x) * invDir.x;
+  const float ty0 = (box.y - origin.y) * invDir.y;
+  const float ty1 = (box.w - origin.y) * invDir.y;
+  const float tEnter = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), 0.f);
+  const float tExit = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), rayEnd);
+  return tEnter <= tExit;
+}
+
+// ----------------------------------------------------------------------------
+
+glm::ivec4 s_broadphase2D::_cellRange(const glm::vec4 &AABB) const
+{
+  const float invCellSize = 1.f / cellSize;
+  return glm::ivec4(int(std::floor(AABB.x * invCellSize)), int(std::floor(AABB.y * invCellSize)),
+                    int(std::floor(AABB.z * invCellSize)), int(std::floor(AABB.w * invCellSize)));
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase2D::build(const span<glm::vec4> &AABBs)
+{
+  TRE_ASSERT(cellSize > 0.f);
+
+  m_objectCount = AABBs.size();
+  m_boxes.assign(AABBs.data(), AABBs.dataEnd());
+  m_largeObjects.clear();
+  m_bounds = glm::vec4(std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity(),
+                       -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+
+  // cell ranges
+
+  std::vector<glm::ivec4> cellRanges(m_objectCount);
+  std::size_t             nEntriesMax = 0;
+  for (std::size_t iO = 0; iO < m_objectCount; ++iO)
+  {
+    const glm::vec4 &box = m_boxes[iO];
+    TRE_ASSERT(box.x <= box.z && box.y <= box.w);
+    m_bounds = glm::vec4(glm::min(glm::vec2(m_bounds), glm::vec2(box)), glm::max(glm::vec2(m_bounds.z, m_bounds.w), glm::vec2(box.z, box.w)));
+    const glm::ivec4 range = _cellRange(box);
+    const std::size_t nCells = std::size_t(range.z - range.x + 1) * std::size_t(range.w - range.y + 1);
+    if (nCells > maxCellsPerObject)
+    {
+      m_largeObjects.push_back(uint32_t(iO));
+      cellRanges[iO] = glm::ivec4(0, 0, -1, -1); // empty range
+    }
+    else
+    {
+      cellRanges[iO] = range;
+      nEntriesMax += nCells;
+    }
+  }
+
+  // hash-table
+
+  uint32_t nBuckets = 64;
+  while (nBuckets < nEntriesMax) nBuckets *= 2;
+  m_hashMask = nBuckets - 1;
+
+  // counting-sort of the entries (an object is put once in a bucket, even if several of its cells share the same bucket)
+
+  std::vector<uint32_t> stamp(nBuckets, 0xFFFFFFFF);
+  m_bucketStart.assign(nBuckets + 1, 0);
+  for (uint32_t iO = 0; iO < m_objectCount; ++iO)
+  {
+    const glm::ivec4 &range = cellRanges[iO];
+    for (int iy = range.y; iy <= range.w; ++iy)
+    {
+      for (int ix = range.x; ix <= range.z; ++ix)
+      {
+        const uint32_t b = _hash(ix, iy);
+        if (stamp[b] == iO) continue;
+        stamp[b] = iO;
+        ++m_bucketStart[b + 1];
+      }
+    }
+  }
+
+  m_bucketsMulti.resize(nBuckets);
+  uint32_t nBucketsMulti = 0;
+  for (uint32_t b = 0; b < nBuckets; ++b)
+  {
+    m_bucketsMulti[nBucketsMulti] = b;
+    nBucketsMulti += (m_bucketStart[b + 1] >= 2) ? 1 : 0; // branch-less, as most of the buckets have 0 or 1 entry
+    m_bucketStart[b + 1] += m_bucketStart[b];
+  }
+  m_bucketsMulti.resize(nBucketsMulti);
+
+  m_entries.resize(m_bucketStart[nBuckets]);
+  std::vector<uint32_t> cursor(m_bucketStart.begin(), m_bucketStart.end() - 1);
+  std::fill(stamp.begin(), stamp.end(), 0xFFFFFFFF);
+  for (uint32_t iO = 0; iO < m_objectCount; ++iO)
+  {
+    const glm::ivec4 &range = cellRanges[iO];
+    for (int iy = range.y; iy <= range.w; ++iy)
+    {
+      for (int ix = range.x; ix <= range.z; ++ix)
+      {
+        const uint32_t b = _hash(ix, iy);
+        if (stamp[b] == iO) continue;
+        stamp[b] = iO;
+        s_entry &e = m_entries[cursor[b]++];
+        e.box = m_boxes[iO];
+        e.objectId = iO;
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase2D::computePairs(std::vector<std::pair<uint32_t, uint32_t>> &pairs) const
+{
+  pairs.clear();
+  if (m_objectCount == 0) return;
+
+  const float invCellSize = 1.f / cellSize;
+
+  // pairs in the grid. The pair is reported from the bucket of the cell that contains the min-corner of the boxes' intersection.
+
+  for (uint32_t b : m_bucketsMulti)
+  {
+    const uint32_t eStart = m_bucketStart[b];
+    const uint32_t eStop = m_bucketStart[b + 1];
+    for (uint32_t iA = eStart; iA < eStop; ++iA)
+    {
+      const s_entry &eA = m_entries[iA];
+      for (uint32_t iB = iA + 1; iB < eStop; ++iB)
+      {
+        const s_entry &eB = m_entries[iB];
+        if (!_broadphase_overlap(eA.box, eB.box)) continue;
+        const int ix = int(std::floor(std::max(eA.box.x, eB.box.x) * invCellSize));
+        const int iy = int(std::floor(std::max(eA.box.y, eB.box.y) * invCellSize));
+        if (_hash(ix, iy) != b) continue; // reported from another bucket
+        pairs.emplace_back(std::min(eA.objectId, eB.objectId), std::max(eA.objectId, eB.objectId));
+      }
+    }
+  }
+
+  // pairs with the large objects
+
+  for (std::size_t iL = 0; iL < m_largeObjects.size(); ++iL)
+  {
+    const uint32_t   objL = m_largeObjects[iL];
+    const glm::vec4 &boxL = m_boxes[objL];
+    std::size_t      iLnext = 0; // the large objects are sorted, so the pairs of large objects are reported once
+    for (uint32_t iO = 0; iO < m_objectCount; ++iO)
+    {
+      if (iLnext < m_largeObjects.size() && m_largeObjects[iLnext] == iO)
+      {
+        ++iLnext;
+        if (iO <= objL) continue;
+      }
+      if (iO != objL && _broadphase_overlap(boxL, m_boxes[iO]))
+        pairs.emplace_back(std::min(objL, iO), std::max(objL, iO));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase2D::queryBox(std::vector<uint32_t> &listObjects, const glm::vec4 &AABB) const
+{
+  listObjects.clear();
+  if (m_objectCount == 0) return;
+
+  for (uint32_t objL : m_largeObjects)
+  {
+    if (_broadphase_overlap(AABB, m_boxes[objL])) listObjects.push_back(objL);
+  }
+
+  const glm::ivec4 rangeBounds = _cellRange(m_bounds);
+  const glm::ivec4 rangeQuery = _cellRange(AABB);
+  const glm::ivec4 range = glm::ivec4(glm::max(glm::ivec2(rangeBounds), glm::ivec2(rangeQuery)),
+                                      glm::min(glm::ivec2(rangeBounds.z, rangeBounds.w), glm::ivec2(rangeQuery.z, rangeQuery.w)));
+  if (range.x > range.z || range.y > range.w) return;
+
+  const float invCellSize = 1.f / cellSize;
+
+  // an object is reported from the cell that contains the min-corner of its intersection with the query box.
+  for (int iy = range.y; iy <= range.w; ++iy)
+  {
+    for (int ix = range.x; ix <= range.z; ++ix)
+    {
+      const uint32_t b = _hash(ix, iy);
+      for (uint32_t iE = m_bucketStart[b], iEstop = m_bucketStart[b + 1]; iE < iEstop; ++iE)
+      {
+        const s_entry &e = m_entries[iE];
+        if (!_broadphase_overlap(AABB, e.box)) continue;
+        if (int(std::floor(std::max(AABB.x, e.box.x) * invCellSize)) != ix || int(std::floor(std::max(AABB.y, e.box.y) * invCellSize)) != iy) continue;
+        listObjects.push_back(e.objectId);
+      }
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase2D::queryRay(std::vector<uint32_t> &listObjects, const glm::vec2 &origin, const glm::vec2 &direction, float rayEnd) const
+{
+  listObjects.clear();
+  if (m_objectCount == 0) return;
+
+  const glm::vec2 invDir = 1.f / direction;
+
+  for (uint32_t objL : m_largeObjects)
+  {
+    if (_broadphase_ray(m_boxes[objL], origin, invDir, rayEnd)) listObjects.push_back(objL);
+  }
+
+  // clip the ray with the bounds
+  float tStart, tEnd;
+  {
+    const float tx0 = (m_bounds.x - origin.x) * invDir.x;
+    const float tx1 = (m_bounds.z - origin.x) * invDir.x;
+    const float ty0 = (m_bounds.y - origin.y) * invDir.y;
+    const float ty1 = (m_bounds.w - origin.y) * invDir.y;
+    tStart = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), 0.f);
+    tEnd = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), rayEnd);
+    if (tStart > tEnd) return;
+  }
+
+  // walk through the cells (2D-DDA)
+  const glm::ivec4 rangeBounds = _cellRange(m_bounds);
+  const glm::vec2  pStart = origin + tStart * direction;
+  const float      invCellSize = 1.f / cellSize;
+  int              ix = glm::clamp(int(std::floor(pStart.x * invCellSize)), rangeBounds.x, rangeBounds.z);
+  int              iy = glm::clamp(int(std::floor(pStart.y * invCellSize)), rangeBounds.y, rangeBounds.w);
+  const int        stepX = (direction.x >= 0.f) ? 1 : -1;
+  const int        stepY = (direction.y >= 0.f) ? 1 : -1;
+  const float      tDeltaX = std::abs(cellSize * invDir.x);
+  const float      tDeltaY = std::abs(cellSize * invDir.y);
+  float            tMaxX = (direction.x != 0.f) ? (float(ix + (stepX > 0 ? 1 : 0)) * cellSize - origin.x) * invDir.x : std::numeric_limits<float>::infinity();
+  float            tMaxY = (direction.y != 0.f) ? (float(iy + (stepY > 0 ? 1 : 0)) * cellSize - origin.y) * invDir.y : std::numeric_limits<float>::infinity();
+
+  const std::size_t listLargeSize = listObjects.size();
+
+  while (true)
+  {
+    const uint32_t b = _hash(ix, iy);
+    for (uint32_t iE = m_bucketStart[b], iEstop = m_bucketStart[b + 1]; iE < iEstop; ++iE)
+    {
+      const s_entry &e = m_entries[iE];
+      if (_broadphase_ray(e.box, origin, invDir, rayEnd)) listObjects.push_back(e.objectId);
+    }
+
+    if (tMaxX < tMaxY)
+    {
+      if (tMaxX > tEnd) break;
+      ix += stepX;
+      if (ix < rangeBounds.x || ix > rangeBounds.z) break;
+      tMaxX += tDeltaX;
+    }
+    else
+    {
+      if (tMaxY > tEnd) break;
+      iy += stepY;
+      if (iy < rangeBounds.y || iy > rangeBounds.w) break;
+      tMaxY += tDeltaY;
+    }
+  }
+
+  // an object can be found in several cells
+  std::sort(listObjects.begin() + listLargeSize, listObjects.end());
+  listObjects.erase(std::unique(listObjects.begin() + listLargeSize, listObjects.end()), listObjects.end());
+}
+
+// ============================================================================
+
 } // namespace
@@ -3,6 +3,9 @@
 #include "tre_utils.h"
 
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <smmintrin.h> // SSE4.1
 
 namespace tre {
 
@@ -237,701 +240,2559 @@ bool _skinKdTree_raytrace(const s_contact3D::s_skinKdTree &skinKdTree, const glm
   return false;
 }
 
-// Helpers ====================================================================
-
-inline static float tetra_volume(const glm::vec3 &ptA, const glm::vec3 &ptB, const glm::vec3 &ptC, const glm::vec3 &ptD)
-{
-  return fabsf(glm::dot(glm::cross(ptB - ptA, ptC - ptA), ptD - ptA)) / 6.f;
-}
+// Skin BVH ===================================================================
 
-/// Compute the barycenter of the convex mesh [mesh's skin: list of triangles]. Also compute the volume.
-static void skin_barycenter(const s_contact3D::s_skin &pts, glm::vec3 &center, float &volume)
+inline static float _bboxHalfArea(const glm::vec3 &bbMin, const glm::vec3 &bbMax)
 {
-  TRE_ASSERT(pts.size() % 3 == 0);
-  center = glm::vec3(0.f);
-  volume = 0.f;
-  for (std::size_t iQ = 3, Npts = pts.size(); iQ < Npts; iQ += 3)
-  {
-    const float weightCurr = tetra_volume(pts[0], pts[iQ], pts[iQ + 1], pts[iQ + 2]);
-    center += weightCurr * (pts[0] + pts[iQ] + pts[iQ + 1] + pts[iQ + 2]);
-    volume += weightCurr;
-  }
-  center *= 1.f / (4.f * volume);
+  const glm::vec3 e = bbMax - bbMin;
+  return e.x * e.y + e.y * e.z + e.z * e.x;
 }
 
-// (0D in 3D) Simple penetration test of a point in a volume ==================
+// ----------------------------------------------------------------------------
 
-bool s_contact3D::point_treta(const glm::vec3 & point,
-                              const glm::vec3 & pt0, const glm::vec3 & pt1, const glm::vec3 & pt2, const glm::vec3 & pt3)
+void s_contact3D::s_skinBvh::computeTree()
 {
-  const glm::vec3 v0P = point - pt0;
-
-  const glm::vec3 edge01 = pt1 - pt0;
-  const glm::vec3 edge02 = pt2 - pt0;
-  const glm::vec3 edge03 = pt3 - pt0;
-
-  const glm::vec3 normal012 = glm::cross(edge01, edge02);
-  if (glm::dot(normal012, v0P) * glm::dot(normal012, edge03) < 0.f) return false;
-
-  const glm::vec3 normal013 = glm::cross(edge01, edge03);
-  if (glm::dot(normal013, v0P) * glm::dot(normal013, edge02) < 0.f) return false;
+  TRE_ASSERT(skin.size() % 3 == 0);
+  const std::size_t nTri = skin.size() / 3;
+  TRE_ASSERT(nTri != 0);
+  TRE_ASSERT(nTri <= 0xFFFFFFFF); // 32bits used to encode triangle id
 
-  const glm::vec3 normal023 = glm::cross(edge02, edge03);
-  if (glm::dot(normal023, v0P) * glm::dot(normal023, edge01) < 0.f) return false;
+  tree.clear();
+  tree.reserve(2 * (nTri / kLeafSize) + 1);
 
-  const glm::vec3 v1P = point - pt1;
-  const glm::vec3 edge12 = pt2 - pt1;
-  const glm::vec3 edge13 = pt3 - pt1;
+  // triangle references, partitioned in-place during the build (the data stays contiguous for each node)
+  struct s_triRef { glm::vec3 bbMin; uint32_t id; glm::vec3 bbMax; float pad; };
+  std::vector<s_triRef> triRefs(nTri);
 
-  const glm::vec3 normal123 = glm::cross(edge12, edge13);
-  if (glm::dot(normal123, v1P) * glm::dot(normal123, edge01 /* = -edge10 */) > 0.f) return false;
+  tree.push_back(s_node());
+  tree[0].bbMin = glm::vec3(std::numeric_limits<float>::infinity());
+  tree[0].bbMax = glm::vec3(-std::numeric_limits<float>::infinity());
+  for (std::size_t tri = 0; tri < nTri; ++tri)
+  {
+    s_triRef &tref = triRefs[tri];
+    tref.bbMin = glm::min(glm::min(skin[3 * tri + 0], skin[3 * tri + 1]), skin[3 * tri + 2]);
+    tref.bbMax = glm::max(glm::max(skin[3 * tri + 0], skin[3 * tri + 1]), skin[3 * tri + 2]);
+    tref.id = uint32_t(tri);
+    tree[0].bbMin = glm::min(tree[0].bbMin, tref.bbMin);
+    tree[0].bbMax = glm::max(tree[0].bbMax, tref.bbMax);
+  }
+  tree[0].first = 0;
+  tree[0].count = uint32_t(nTri);
 
-  return true;
-}
+  struct s_bin { glm::vec3 bbMin, bbMax; uint32_t count; };
+  std::array<std::array<s_bin, kBinCount>, 3> bins;
+  std::array<float, kBinCount - 1> costRight;
 
-// ----------------------------------------------------------------------------
+  struct s_buildStack { uint32_t nodeId, depth; };
+  std::vector<s_buildStack> nodeStack;
+  nodeStack.push_back({ 0, 0 });
 
-bool s_contact3D::point_treta(s_contact3D & cntTetra,
-                              const glm::vec3 & point,
-                              const glm::vec3 & pt0, const glm::vec3 & pt1, const glm::vec3 & pt2, const glm::vec3 & pt3)
-{
-  const glm::vec3 v0P = point - pt0;
+  std::size_t maxDepth = 0;
+  std::size_t leafNodes = 0;
 
-  const glm::vec3 edge01 = pt1 - pt0;
-  const glm::vec3 edge02 = pt2 - pt0;
-  const glm::vec3 edge03 = pt3 - pt0;
+  while (!nodeStack.empty())
+  {
+    const s_buildStack cs = nodeStack.back();
+    nodeStack.pop_back();
+    maxDepth = std::max(maxDepth, std::size_t(cs.depth));
 
-  const glm::vec3 normal012 = glm::cross(edge01, edge02);
-  if (glm::dot(normal012, v0P) * glm::dot(normal012, edge03) < 0.f) return false;
+    const uint32_t triFirst = tree[cs.nodeId].first;
+    const uint32_t triCount = tree[cs.nodeId].count;
 
-  const glm::vec3 normal013 = glm::cross(edge01, edge03);
-  if (glm::dot(normal013, v0P) * glm::dot(normal013, edge02) < 0.f) return false;
+    if (triCount <= kLeafSize || cs.depth + 1 >= kMaxDepth)
+    {
+      ++leafNodes;
+      continue;
+    }
 
-  const glm::vec3 normal023 = glm::cross(edge02, edge03);
-  if (glm::dot(normal023, v0P) * glm::dot(normal023, edge01) < 0.f) return false;
+    // bounds of the centroids (the centroids are scaled by 2)
+    glm::vec3 centerMin = glm::vec3(std::numeric_limits<float>::infinity());
+    glm::vec3 centerMax = glm::vec3(-std::numeric_limits<float>::infinity());
+    for (uint32_t i = triFirst, iStop = triFirst + triCount; i < iStop; ++i)
+    {
+      const glm::vec3 center2 = triRefs[i].bbMin + triRefs[i].bbMax;
+      centerMin = glm::min(centerMin, center2);
+      centerMax = glm::max(centerMax, center2);
+    }
+    const glm::vec3 centerExtend = centerMax - centerMin;
+    const glm::vec3 binScale = float(kBinCount) * (1.f - 1.e-6f) / glm::max(centerExtend, glm::vec3(1.e-30f)); // note: the axis with no extend are skipped
 
-  const glm::vec3 v1P = point - pt1;
-  const glm::vec3 edge12 = pt2 - pt1;
-  const glm::vec3 edge13 = pt3 - pt1;
+    // fill the bins of each axis
+    for (auto &binsAxis : bins)
+    {
+      for (s_bin &b : binsAxis)
+      {
+        b.bbMin = glm::vec3(std::numeric_limits<float>::infinity());
+        b.bbMax = glm::vec3(-std::numeric_limits<float>::infinity());
+        b.count = 0;
+      }
+    }
+    for (uint32_t i = triFirst, iStop = triFirst + triCount; i < iStop; ++i)
+    {
+      const s_triRef  &tref = triRefs[i];
+      const glm::vec3 binCoord = (tref.bbMin + tref.bbMax - centerMin) * binScale;
+      for (unsigned axis = 0; axis < 3; ++axis)
+      {
+        s_bin &b = bins[axis][std::min(unsigned(binCoord[axis]), kBinCount - 1)];
+        b.bbMin = glm::min(b.bbMin, tref.bbMin);
+        b.bbMax = glm::max(b.bbMax, tref.bbMax);
+        ++b.count;
+      }
+    }
 
-  const glm::vec3 normal123 = glm::cross(edge12, edge13);
-  if (glm::dot(normal123, v1P) * glm::dot(normal123, edge01 /* = -edge10 */) > 0.f) return false;
+    // evaluate the SAH on each axis: sweep from the right, then from the left
+    float    bestCost = std::numeric_limits<float>::infinity();
+    unsigned bestAxis = 0;
+    unsigned bestSplit = 0;
+    for (unsigned axis = 0; axis < 3; ++axis)
+    {
+      if (centerExtend[axis] <= 0.f) continue;
+      const std::array<s_bin, kBinCount> &binsAxis = bins[axis];
 
-  // the "point" is inside
+      glm::vec3 accMin = glm::vec3(std::numeric_limits<float>::infinity());
+      glm::vec3 accMax = glm::vec3(-std::numeric_limits<float>::infinity());
+      uint32_t  accCount = 0;
+      for (unsigned ib = kBinCount - 1; ib != 0; --ib)
+      {
+        accMin = glm::min(accMin, binsAxis[ib].bbMin);
+        accMax = glm::max(accMax, binsAxis[ib].bbMax);
+        accCount += binsAxis[ib].count;
+        costRight[ib - 1] = (accCount == 0) ? std::numeric_limits<float>::infinity() : float(accCount) * _bboxHalfArea(accMin, accMax);
+      }
+      accMin = glm::vec3(std::numeric_limits<float>::infinity());
+      accMax = glm::vec3(-std::numeric_limits<float>::infinity());
+      accCount = 0;
+      for (unsigned ib = 0; ib < kBinCount - 1; ++ib)
+      {
+        accMin = glm::min(accMin, binsAxis[ib].bbMin);
+        accMax = glm::max(accMax, binsAxis[ib].bbMax);
+        accCount += binsAxis[ib].count;
+        if (accCount == 0 || accCount == triCount) continue;
+        const float cost = float(accCount) * _bboxHalfArea(accMin, accMax) + costRight[ib];
+        if (cost < bestCost)
+        {
+          bestCost = cost;
+          bestAxis = axis;
+          bestSplit = ib;
+        }
+      }
+    }
 
-  cntTetra.penet = std::numeric_limits<float>::infinity();
+    if (!std::isfinite(bestCost)) // all centroids are at the same place, the node cannot be split
+    {
+      ++leafNodes;
+      continue;
+    }
 
-  TRE_ASSERT(glm::length(normal012) > 1.e-6f);
-  const glm::vec3 normal012_unit = glm::normalize(normal012);
-  const float dist012 = glm::dot(normal012_unit, v0P);
-  const float dist012_abs = fabsf(dist012);
-  if (dist012_abs < cntTetra.penet)
-  {
-    cntTetra.penet = dist012_abs;
-    cntTetra.pt = point - dist012 * normal012_unit;
-    cntTetra.normal = - normal012_unit;
-    if (dist012 < 0.f)
-      cntTetra.normal = - cntTetra.normal;
-  }
+    // partition the triangles
+    const float     binScaleAxis = binScale[bestAxis];
+    const float     binOrigin = centerMin[bestAxis];
+    s_triRef *const itMid = std::partition(triRefs.data() + triFirst, triRefs.data() + triFirst + triCount,
+                                           [&](const s_triRef &tref) { return std::min(unsigned((tref.bbMin[bestAxis] + tref.bbMax[bestAxis] - binOrigin) * binScaleAxis), kBinCount - 1) <= bestSplit; });
+    const uint32_t  countLeft = uint32_t(itMid - (triRefs.data() + triFirst));
+    TRE_ASSERT(countLeft != 0 && countLeft != triCount);
+
+    // create the children
+    const uint32_t nidL = uint32_t(tree.size());
+    const uint32_t nidR = nidL + 1;
+    tree.resize(tree.size() + 2);
+    s_node &nodeL = tree[nidL];
+    s_node &nodeR = tree[nidR];
+    nodeL.first = triFirst;
+    nodeL.count = countLeft;
+    nodeR.first = triFirst + countLeft;
+    nodeR.count = triCount - countLeft;
+
+    nodeL.bbMin = nodeR.bbMin = glm::vec3(std::numeric_limits<float>::infinity());
+    nodeL.bbMax = nodeR.bbMax = glm::vec3(-std::numeric_limits<float>::infinity());
+    for (unsigned ib = 0; ib < kBinCount; ++ib)
+    {
+      s_node &nodeLR = (ib <= bestSplit) ? nodeL : nodeR;
+      nodeLR.bbMin = glm::min(nodeLR.bbMin, bins[bestAxis][ib].bbMin);
+      nodeLR.bbMax = glm::max(nodeLR.bbMax, bins[bestAxis][ib].bbMax);
+    }
 
-  TRE_ASSERT(glm::length(normal013) > 1.e-6f);
-  const glm::vec3 normal013_unit = glm::normalize(normal013);
-  const float dist013 = glm::dot(normal013_unit, v0P);
-  const float dist013_abs = fabsf(dist013);
-  if (dist013_abs < cntTetra.penet)
-  {
-    cntTetra.penet = dist013_abs;
-    cntTetra.pt = point - dist013 * normal013_unit;
-    cntTetra.normal = - normal013_unit;
-    if (dist013 < 0.f)
-      cntTetra.normal = - cntTetra.normal;
-  }
+    tree[cs.nodeId].first = nidL;
+    tree[cs.nodeId].count = 0;
 
-  TRE_ASSERT(glm::length(normal023) > 1.e-6f);
-  const glm::vec3 normal023_unit = glm::normalize(normal023);
-  const float dist023 = glm::dot(normal023_unit, v0P);
-  const float dist023_abs = fabsf(dist023);
-  if (dist023_abs < cntTetra.penet)
-  {
-    cntTetra.penet = dist023_abs;
-    cntTetra.pt = point - dist023 * normal023_unit;
-    cntTetra.normal = - normal023_unit;
-    if (dist023 < 0.f)
-      cntTetra.normal = - cntTetra.normal;
+    nodeStack.push_back({ nidR, cs.depth + 1 });
+    nodeStack.push_back({ nidL, cs.depth + 1 });
   }
 
-  TRE_ASSERT(glm::length(normal123) > 1.e-6f);
-  const glm::vec3 normal123_unit = glm::normalize(normal123);
-  const float dist123 = glm::dot(normal123_unit, v1P);
-  const float dist123_abs = fabsf(dist123);
-  if (dist123_abs < cntTetra.penet)
+  // re-order the triangles
   {
-    cntTetra.penet = dist123_abs;
-    cntTetra.pt = point - dist123 * normal123_unit;
-    cntTetra.normal = - normal123_unit;
-    if (dist123 < 0.f)
-      cntTetra.normal = - cntTetra.normal;
+    s_skin skinOrdered(skin.size());
+    for (std::size_t i = 0; i < nTri; ++i)
+    {
+      skinOrdered[3 * i + 0] = skin[3 * triRefs[i].id + 0];
+      skinOrdered[3 * i + 1] = skin[3 * triRefs[i].id + 1];
+      skinOrdered[3 * i + 2] = skin[3 * triRefs[i].id + 2];
+    }
+    skin.swap(skinOrdered);
   }
 
-  return true;
+  TRE_LOG("BVH built: " << nTri << " triangles, " << tree.size() << " nodes (" << leafNodes << " leaves), max-depth = " << maxDepth);
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_box(const glm::vec3 & point,
-                            const s_boundbox & bbox)
+/// @brief Ray-box intersection (slab test) with a BVH node. Returns the entry distance, or +inf when the ray misses the box in [tMin, tMax].
+inline static float _skinBvh_rayNode(const s_contact3D::s_skinBvh::s_node &node, const glm::vec3 &origin, const glm::vec3 &invDir, float tMin, float tMax)
 {
-  //return glm::all(glm::lessThanEqual(bbox.m_min, point)) && glm::all(glm::lessThanEqual(point, bbox.m_max));
-
-  const glm::vec3 vAP = point - bbox.m_min;
-  if (vAP.x < 0.f || vAP.y < 0.f || vAP.z) return false;
+  const glm::vec3 t0 = (node.bbMin - origin) * invDir;
+  const glm::vec3 t1 = (node.bbMax - origin) * invDir;
+  const glm::vec3 tNear = glm::min(t0, t1);
+  const glm::vec3 tFar = glm::max(t0, t1);
+  const float     tEnter = std::max(std::max(std::max(tNear.x, tNear.y), tNear.z), tMin);
+  const float     tExit = std::min(std::min(std::min(tFar.x, tFar.y), tFar.z), tMax);
+  return (tEnter <= tExit) ? tEnter : std::numeric_limits<float>::infinity();
+}
 
-  const glm::vec3 vPB = bbox.m_max - point;
-  if (vPB.x < 0.f || vPB.y < 0.f || vPB.z) return false;
+// ----------------------------------------------------------------------------
 
-  return true;
+/// @brief Squared distance between a point and a BVH node.
+inline static float _skinBvh_distanceSquared(const s_contact3D::s_skinBvh::s_node &node, const glm::vec3 &pos)
+{
+  const glm::vec3 d = glm::max(glm::max(node.bbMin - pos, pos - node.bbMax), glm::vec3(0.f));
+  return glm::dot(d, d);
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_box(s_contact3D & cntBox,
-                            const glm::vec3 & point,
-                            const s_boundbox & bbox)
+/// @brief Templated ray-trace of a skin BVH. The functor is a struct with "operator()(pt0, pt1, pt2) -> bool" defined. Functor can be a lambda.
+/// The nodes are visited front-to-back. The functor must update "tEnd" when it records a closer hit, so the farther nodes are culled.
+template <typename _fnct>
+bool _skinBvh_raytrace(const s_contact3D::s_skinBvh &skinBvh, const glm::vec3 &origin, const glm::vec3 &ray, float tStart, const float &tEnd, _fnct &fnct)
 {
-  const glm::vec3 vAP = point - bbox.m_min;
-  float vAPmin = vAP.x; unsigned vAPminInd = 0;
-  if (vAP.y < vAPmin) { vAPmin = vAP.y; vAPminInd = 1; }
-  if (vAP.z < vAPmin) { vAPmin = vAP.z; vAPminInd = 2; }
-  if (vAPmin < 0.f) return false;
+  TRE_ASSERT(skinBvh.skin.size() % 3 == 0);
+  TRE_ASSERT(!skinBvh.tree.empty());
 
-  const glm::vec3 vPB = bbox.m_max - point;
-  float vPBmin = vPB.x; unsigned vPBminInd = 0;
-  if (vPB.y < vPBmin) { vPBmin = vPB.y; vPBminInd = 1; }
-  if (vPB.z < vPBmin) { vPBmin = vPB.z; vPBminInd = 2; }
-  if (vPBmin < 0.f) return false;
+  const glm::vec3 invDir = 1.f / ray;
 
-  if (vAPmin < vPBmin)
-  {
-    cntBox.penet = vAPmin;
-    cntBox.normal = glm::vec3(0.f);
-    cntBox.normal[vAPminInd] = -1.f;
-    cntBox.pt = point + vAP * cntBox.normal;
-  }
-  else
+  if (!std::isfinite(_skinBvh_rayNode(skinBvh.tree[0], origin, invDir, tStart, tEnd)))
+    return false;
+
+  std::array<uint32_t, s_contact3D::s_skinBvh::kMaxDepth> stack;
+  std::size_t stackSize = 0;
+  uint32_t    nodeCurr = 0;
+  bool        hasHit = false;
+
+  while (true)
   {
-    cntBox.penet = vPBmin;
-    cntBox.normal = glm::vec3(0.f);
-    cntBox.normal[vPBminInd] = 1.f;
-    cntBox.pt = point + vPB * cntBox.normal;
+    const s_contact3D::s_skinBvh::s_node &cnode = skinBvh.tree[nodeCurr];
+    if (cnode.isLeaf())
+    {
+      for (uint32_t tri = cnode.first, triStop = cnode.first + cnode.count; tri < triStop; ++tri)
+        hasHit |= fnct(skinBvh.skin[tri * 3 + 0], skinBvh.skin[tri * 3 + 1], skinBvh.skin[tri * 3 + 2]);
+    }
+    else
+    {
+      const float tL = _skinBvh_rayNode(skinBvh.tree[cnode.first    ], origin, invDir, tStart, tEnd);
+      const float tR = _skinBvh_rayNode(skinBvh.tree[cnode.first + 1], origin, invDir, tStart, tEnd);
+      const bool  hitL = std::isfinite(tL);
+      const bool  hitR = std::isfinite(tR);
+      if (hitL && hitR)
+      {
+        TRE_ASSERT(stackSize < stack.size());
+        const bool nearL = (tL <= tR);
+        stack[stackSize++] = nearL ? cnode.first + 1 : cnode.first;
+        nodeCurr = nearL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+      if (hitL || hitR)
+      {
+        nodeCurr = hitL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+    }
+    // pop (the node is skipped when it is now beyond the closest hit)
+    while (true)
+    {
+      if (stackSize == 0) return hasHit;
+      nodeCurr = stack[--stackSize];
+      if (!hasHit || std::isfinite(_skinBvh_rayNode(skinBvh.tree[nodeCurr], origin, invDir, tStart, tEnd))) break;
+    }
   }
-
-  return true;
+  TRE_FATAL("not reached");
+  return false;
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_skin(const glm::vec3 & point,
-                             const s_skin & pts)
+/// @brief Packet of 4 rays, stored as SoA (the SSE lanes are the rays). The unused lanes have "tEnd = -inf".
+struct s_skinBvh_rayPacket
 {
-  TRE_ASSERT(pts.size() % 3 == 0);
+  __m128 ox, oy, oz;             ///< origins
+  __m128 dx, dy, dz;             ///< directions
+  __m128 idx, idy, idz;          ///< inverse of the directions
+  __m128 tStart;                 ///< ray start (culling of the nodes)
+  __m128 tEnd;                   ///< closest hit (+inf when no hit)
+  __m128 tMinHit;                ///< minimal distance of a valid hit: max(rayStart, epsilon)
+  std::array<uint32_t, 4> triId; ///< triangle of the closest hit
+};
+
+/// @brief Ray-box intersection (slab test) of a packet with a BVH node. Returns the smallest entry distance of the active rays, or +inf when all rays miss the box.
+inline static float _skinBvh_rayNode4(const s_contact3D::s_skinBvh::s_node &node, const s_skinBvh_rayPacket &packet)
+{
+  const __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMin.x), packet.ox), packet.idx);
+  const __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMax.x), packet.ox), packet.idx);
+  const __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMin.y), packet.oy), packet.idy);
+  const __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMax.y), packet.oy), packet.idy);
+  const __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMin.z), packet.oz), packet.idz);
+  const __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(node.bbMax.z), packet.oz), packet.idz);
+  const __m128 tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)), _mm_max_ps(_mm_min_ps(t0z, t1z), packet.tStart));
+  const __m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)), _mm_min_ps(_mm_max_ps(t0z, t1z), packet.tEnd));
+  __m128 tHit = _mm_blendv_ps(_mm_set1_ps(std::numeric_limits<float>::infinity()), tEnter, _mm_cmple_ps(tEnter, tExit));
+  tHit = _mm_min_ps(tHit, _mm_shuffle_ps(tHit, tHit, _MM_SHUFFLE(2, 3, 0, 1)));
+  tHit = _mm_min_ps(tHit, _mm_shuffle_ps(tHit, tHit, _MM_SHUFFLE(1, 0, 3, 2)));
+  return _mm_cvtss_f32(tHit);
+}
 
-  for (std::size_t iQ = 0, Npts = pts.size(); iQ < Npts; iQ += 3)
+/// @brief Ray-triangle intersection of a packet. It mirrors the arithmetic of "triangleRaytrace3D" and the in-face culling of "raytrace_skin", so the hits are the same as with the single-ray trace.
+inline static bool _skinBvh_rayTriangle4(s_skinBvh_rayPacket &packet, const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2, uint32_t triId)
+{
+  const glm::vec3 edge1 = pt1 - pt0;
+  const glm::vec3 edge2 = pt2 - pt0;
+  const glm::vec3 outNormal = glm::cross(edge1, edge2);
+  const __m128    e1x = _mm_set1_ps(edge1.x), e1y = _mm_set1_ps(edge1.y), e1z = _mm_set1_ps(edge1.z);
+  const __m128    e2x = _mm_set1_ps(edge2.x), e2y = _mm_set1_ps(edge2.y), e2z = _mm_set1_ps(edge2.z);
+  // in-face culling
+  const __m128 facing = _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.dx, _mm_set1_ps(outNormal.x)), _mm_mul_ps(packet.dy, _mm_set1_ps(outNormal.y))), _mm_mul_ps(packet.dz, _mm_set1_ps(outNormal.z)));
+  __m128 mask = _mm_cmple_ps(facing, _mm_setzero_ps());
+  // pvec = cross(direction, edge2), det = dot(pvec, edge1)
+  const __m128 px = _mm_sub_ps(_mm_mul_ps(packet.dy, e2z), _mm_mul_ps(packet.dz, e2y));
+  const __m128 py = _mm_sub_ps(_mm_mul_ps(packet.dz, e2x), _mm_mul_ps(packet.dx, e2z));
+  const __m128 pz = _mm_sub_ps(_mm_mul_ps(packet.dx, e2y), _mm_mul_ps(packet.dy, e2x));
+  const __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, e1x), _mm_mul_ps(py, e1y)), _mm_mul_ps(pz, e1z));
+  mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), det), _mm_set1_ps(1.e-6f))); // parallel ray and triangle
+  if (_mm_movemask_ps(mask) == 0) return false;
+  const __m128 invdet = _mm_div_ps(_mm_set1_ps(1.f), det);
+  // AP = origin - pt0, u = dot(pvec, AP) / det
+  const __m128 apx = _mm_sub_ps(packet.ox, _mm_set1_ps(pt0.x));
+  const __m128 apy = _mm_sub_ps(packet.oy, _mm_set1_ps(pt0.y));
+  const __m128 apz = _mm_sub_ps(packet.oz, _mm_set1_ps(pt0.z));
+  const __m128 coordu = _mm_mul_ps(invdet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, apx), _mm_mul_ps(py, apy)), _mm_mul_ps(pz, apz)));
+  mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(coordu, _mm_setzero_ps()), _mm_cmple_ps(coordu, _mm_set1_ps(1.f))));
+  if (_mm_movemask_ps(mask) == 0) return false;
+  // qvec = cross(AP, edge1), v = dot(direction, qvec) / det, t = dot(edge2, qvec) / det
+  const __m128 qx = _mm_sub_ps(_mm_mul_ps(apy, e1z), _mm_mul_ps(apz, e1y));
+  const __m128 qy = _mm_sub_ps(_mm_mul_ps(apz, e1x), _mm_mul_ps(apx, e1z));
+  const __m128 qz = _mm_sub_ps(_mm_mul_ps(apx, e1y), _mm_mul_ps(apy, e1x));
+  const __m128 coordv = _mm_mul_ps(invdet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(packet.dx, qx), _mm_mul_ps(packet.dy, qy)), _mm_mul_ps(packet.dz, qz)));
+  const __m128 coordt = _mm_mul_ps(invdet, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+  mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(coordv, _mm_setzero_ps()), _mm_cmple_ps(_mm_add_ps(coordu, coordv), _mm_set1_ps(1.f))));
+  mask = _mm_and_ps(mask, _mm_and_ps(_mm_cmpge_ps(coordt, packet.tMinHit), _mm_cmplt_ps(coordt, packet.tEnd)));
+  const int laneMask = _mm_movemask_ps(mask);
+  if (laneMask == 0) return false;
+
+  packet.tEnd = _mm_blendv_ps(packet.tEnd, coordt, mask);
+  for (unsigned lane = 0; lane < 4; ++lane)
   {
-    // check against the plane (iQ, iQ+1, iQ+2)
-    const glm::vec3 v0P = point - pts[iQ+0];
+    if ((laneMask >> lane) & 1) packet.triId[lane] = triId;
+  }
+  return true;
+}
 
-    const glm::vec3 edge01 = pts[iQ+1] - pts[iQ+0];
-    const glm::vec3 edge02 = pts[iQ+2] - pts[iQ+0];
-    const glm::vec3 normal012 = glm::cross(edge01, edge02);
-    TRE_ASSERT(glm::length(normal012) > 1.e-12f);
+/// @brief Ray-trace of a packet of rays. The nodes are visited in the order of the smallest entry distance of the packet.
+/// A node is visited as long as one ray of the packet hits it.
+static void _skinBvh_raytrace4(const s_contact3D::s_skinBvh &skinBvh, s_skinBvh_rayPacket &packet)
+{
+  TRE_ASSERT(skinBvh.skin.size() % 3 == 0);
+  TRE_ASSERT(!skinBvh.tree.empty());
 
-    if (glm::dot(normal012, v0P) > 0.f) return false;
+  if (!std::isfinite(_skinBvh_rayNode4(skinBvh.tree[0], packet)))
+    return;
+
+  std::array<uint32_t, s_contact3D::s_skinBvh::kMaxDepth> stack;
+  std::size_t stackSize = 0;
+  uint32_t    nodeCurr = 0;
+  bool        hasHit = false;
+
+  while (true)
+  {
+    const s_contact3D::s_skinBvh::s_node &cnode = skinBvh.tree[nodeCurr];
+    if (cnode.isLeaf())
+    {
+      for (uint32_t tri = cnode.first, triStop = cnode.first + cnode.count; tri < triStop; ++tri)
+        hasHit |= _skinBvh_rayTriangle4(packet, skinBvh.skin[tri * 3 + 0], skinBvh.skin[tri * 3 + 1], skinBvh.skin[tri * 3 + 2], tri);
+    }
+    else
+    {
+      const float tL = _skinBvh_rayNode4(skinBvh.tree[cnode.first    ], packet);
+      const float tR = _skinBvh_rayNode4(skinBvh.tree[cnode.first + 1], packet);
+      const bool  hitL = std::isfinite(tL);
+      const bool  hitR = std::isfinite(tR);
+      if (hitL && hitR)
+      {
+        TRE_ASSERT(stackSize < stack.size());
+        const bool nearL = (tL <= tR);
+        stack[stackSize++] = nearL ? cnode.first + 1 : cnode.first;
+        nodeCurr = nearL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+      if (hitL || hitR)
+      {
+        nodeCurr = hitL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+    }
+    // pop (the node is skipped when it is now beyond the closest hits)
+    while (true)
+    {
+      if (stackSize == 0) return;
+      nodeCurr = stack[--stackSize];
+      if (!hasHit || std::isfinite(_skinBvh_rayNode4(skinBvh.tree[nodeCurr], packet))) break;
+    }
   }
-  return true;
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_skin(s_contact3D & cntSkin,
-                             const glm::vec3 & point,
-                             const s_skin & pts)
+/// @brief Templated sample of a skin BVH, restricted to a sphere. The functor is a struct with "operator()(pt0, pt1, pt2) -> bool" defined. Functor can be a lambda.
+/// It stops processing as soon as a call returned true. The functor can shrink "radiusSquared", so the farther nodes are culled.
+template <typename _fnct>
+bool _skinBvh_sphere(const s_contact3D::s_skinBvh &skinBvh, const glm::vec3 &center, const float &radiusSquared, _fnct &fnct)
 {
-  const std::size_t Npts = pts.size();
-  TRE_ASSERT(Npts % 3 == 0);
+  TRE_ASSERT(skinBvh.skin.size() % 3 == 0);
+  TRE_ASSERT(!skinBvh.tree.empty());
 
-  if (Npts < 12) // at least a tetrahedron
+  if (_skinBvh_distanceSquared(skinBvh.tree[0], center) > radiusSquared)
     return false;
 
-  cntSkin.penet = std::numeric_limits<float>::infinity();
+  std::array<uint32_t, s_contact3D::s_skinBvh::kMaxDepth> stack;
+  std::size_t stackSize = 0;
+  uint32_t    nodeCurr = 0;
 
-  for (std::size_t iQ = 0; iQ < Npts; iQ += 3)
+  while (true)
   {
-    // check against the plane (iQ, iQ+1, iQ+2)
-    const glm::vec3 v0P = point - pts[iQ+0];
-
-    const glm::vec3 edge01 = pts[iQ+1] - pts[iQ+0];
-    const glm::vec3 edge02 = pts[iQ+2] - pts[iQ+0];
-    const glm::vec3 normal012 = glm::normalize(glm::cross(edge01, edge02));
-    TRE_ASSERT(!std::isnan(normal012.x));
-
-    const float dist012 = glm::dot(normal012, v0P);
-
-    if (dist012 > 0.f) return false;
-
-    if (-dist012 < cntSkin.penet)
+    const s_contact3D::s_skinBvh::s_node &cnode = skinBvh.tree[nodeCurr];
+    if (cnode.isLeaf())
     {
-      cntSkin.penet = -dist012;
-      cntSkin.pt = point - dist012 * normal012;
-      cntSkin.normal = normal012;
+      for (uint32_t tri = cnode.first, triStop = cnode.first + cnode.count; tri < triStop; ++tri)
+      {
+        if (fnct(skinBvh.skin[tri * 3 + 0], skinBvh.skin[tri * 3 + 1], skinBvh.skin[tri * 3 + 2])) return true;
+      }
+    }
+    else
+    {
+      const float dL = _skinBvh_distanceSquared(skinBvh.tree[cnode.first    ], center);
+      const float dR = _skinBvh_distanceSquared(skinBvh.tree[cnode.first + 1], center);
+      const bool  hitL = (dL <= radiusSquared);
+      const bool  hitR = (dR <= radiusSquared);
+      if (hitL && hitR)
+      {
+        TRE_ASSERT(stackSize < stack.size());
+        const bool nearL = (dL <= dR);
+        stack[stackSize++] = nearL ? cnode.first + 1 : cnode.first;
+        nodeCurr = nearL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+      if (hitL || hitR)
+      {
+        nodeCurr = hitL ? cnode.first : cnode.first + 1;
+        continue;
+      }
+    }
+    // pop
+    while (true)
+    {
+      if (stackSize == 0) return false;
+      nodeCurr = stack[--stackSize];
+      if (_skinBvh_distanceSquared(skinBvh.tree[nodeCurr], center) <= radiusSquared) break;
     }
   }
-  return true;
+  TRE_FATAL("not reached");
+  return false;
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_sphere(const glm::vec3 &point,
-                               const glm::vec3 &center, const float radius)
+/// @brief Find the closest triangle of the skin BVH to "center", within "radius". Returns false when there is no triangle in the sphere.
+static bool _skinBvh_closest(const s_contact3D::s_skinBvh &skinBvh, const glm::vec3 &center, const float radius, glm::vec3 &ptOnSkin, glm::vec3 &triNormal)
 {
-  const glm::vec3 vCP = point - center;
-  return glm::dot(vCP,vCP) <= radius * radius;
+  float radiusSquared = radius * radius;
+  bool  found = false;
+
+  const auto fnClosest = [&](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+    {
+      glm::vec3 ptOnTri;
+      if (s_contact3D::cross_tri_sphere(ptOnTri, pt0, pt1, pt2, center, std::sqrt(radiusSquared)))
+      {
+        const glm::vec3 vCP = ptOnTri - center;
+        const float     dCP = glm::dot(vCP, vCP);
+        if (dCP < radiusSquared || !found)
+        {
+          radiusSquared = dCP;
+          ptOnSkin = ptOnTri;
+          triNormal = glm::cross(pt1 - pt0, pt2 - pt0);
+          found = true;
+        }
+      }
+      return false;
+    };
+
+  _skinBvh_sphere(skinBvh, center, radiusSquared, fnClosest);
+
+  if (found) triNormal = glm::normalize(triNormal);
+  return found;
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::point_sphere(s_contact3D & cntSphere,
-                               const glm::vec3 &point,
-                               const glm::vec3 &center, const float radius)
+/// @brief Check if the point is inside the closed skin: the closest triangle hit by a ray must be seen from its back-face.
+static bool _skinBvh_inside(const s_contact3D::s_skinBvh &skinBvh, const glm::vec3 &point)
 {
-  const glm::vec3 vCP = point - center;
-  float dCP = glm::dot(vCP,vCP);
-  if (dCP > radius * radius) return false;
-  dCP = std::sqrt(dCP);
+  static const glm::vec3 kRayDir = glm::vec3(0.48f, 0.60f, 0.64f); // unit-vector, not aligned with the main axis.
 
-  const glm::vec3 normalOut = dCP == 0.f ? glm::vec3(1.f, 0.f, 0.f) : vCP / dCP;
-  cntSphere.pt = center + normalOut * radius;
-  cntSphere.normal = normalOut;
-  cntSphere.penet = radius - dCP;
+  float minDist = std::numeric_limits<float>::infinity();
+  bool  isInside = false;
 
-  return true;
+  const auto fnRT = [&point, &minDist, &isInside](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+    {
+      glm::vec3 cUVT;
+      if (triangleRaytrace3D(pt0, pt1, pt2, point, kRayDir, &cUVT) && cUVT.z < minDist)
+      {
+        minDist = cUVT.z;
+        isInside = glm::dot(glm::cross(pt1 - pt0, pt2 - pt0), kRayDir) > 0.f;
+        return true;
+      }
+      return false;
+    };
+
+  _skinBvh_raytrace(skinBvh, point, kRayDir, 0.f, minDist, fnRT);
+
+  return isInside;
 }
 
-// (2D <-> 2D) Surface cross ==================================================
+// Skin Convex (GJK / EPA) ====================================================
 
-bool s_contact3D::cross_tri_sphere(glm::vec3 &ptOnTriangle,
-                                   const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2,
-                                   const glm::vec3 &center, const float radius)
+void s_contact3D::s_skinConvex::compute(const s_skin &skin)
 {
-  // project center on plane (pt0,pt1,pt2)
-  const glm::vec3 v01 = pt1 - pt0;
-  const glm::vec3 v02 = pt2 - pt0;
-  const glm::vec3 eN = glm::normalize(glm::cross(v01, v02));
-  TRE_ASSERT(!std::isnan(eN.x));
-  const glm::vec3 v0C = center - pt0;
-  const float     coordN = glm::dot(v0C, eN);
+  TRE_ASSERT(skin.size() % 3 == 0);
 
-  if (fabsf(coordN) > radius)
-    return false;
+  vertices.clear();
+  adjacencyStart.clear();
+  adjacency.clear();
+  if (skin.empty()) return;
 
-  const float v01v01 = glm::dot(v01, v01);
-  const float v02v02 = glm::dot(v02, v02);
-  const float v01v02 = glm::dot(v01, v02);
+  // merge the duplicated vertices (with a tolerance, the hill-climbing of the support-function does not handle the near-duplicated vertices)
 
-  float cU = glm::dot(v01, v0C) / v01v01;
-  float cV = glm::dot(v02, v0C) / v02v02;
+  s_boundbox bbox;
+  for (const glm::vec3 &pt : skin) bbox.addPointInBox(pt);
+  const float tolerance = 1.e-5f * glm::length(bbox.extend());
+  const float toleranceSquared = tolerance * tolerance;
 
-  // projection on the tri's edge or tri's vertex.
+  std::vector<uint32_t> order(skin.size());
+  for (uint32_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&skin](uint32_t a, uint32_t b) { return skin[a].x < skin[b].x; });
 
-  if (cV < 0.f) // project on edge 01
+  std::vector<uint32_t> skinToVertex(skin.size(), uint32_t(-1));
+  for (std::size_t i = 0; i < order.size(); ++i)
   {
-    // find 0P + a t01 = (cU + a x) * v01 + (cV + a y) * v02 = cUnew * v01
-    // with cVnew = (cV + a y) == 0
-    // thus: cUnew = cU + a x = cU - cV * x / y
+    const glm::vec3 &pt = skin[order[i]];
+    for (std::size_t j = i; j-- != 0 && pt.x - skin[order[j]].x <= tolerance; )
+    {
+      const glm::vec3 d = pt - skin[order[j]];
+      if (glm::dot(d, d) <= toleranceSquared)
+      {
+        skinToVertex[order[i]] = skinToVertex[order[j]];
+        break;
+      }
+    }
+    if (skinToVertex[order[i]] == uint32_t(-1))
+    {
+      skinToVertex[order[i]] = uint32_t(vertices.size());
+      vertices.push_back(pt);
+    }
+  }
 
-    // by definition, we have: t01 = x v01 + y v02
-    // (t01.v01) = x v01.v01 + y v02.v01 = 0
-    // thus: x / y = - v02.v01 / v01.v01
+  // adjacency (from the edges of the triangles)
 
-    // Finally, cUnew = cU + cV * v02.v01 / v01.v01
-    //          cVnew = 0
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  edges.reserve(skin.size() * 2);
+  for (std::size_t iP = 0; iP < skin.size(); iP += 3)
+  {
+    for (unsigned k = 0; k < 3; ++k)
+    {
+      const uint32_t v0 = skinToVertex[iP + k];
+      const uint32_t v1 = skinToVertex[iP + (k + 1) % 3];
+      if (v0 == v1) continue;
+      edges.emplace_back(v0, v1);
+      edges.emplace_back(v1, v0);
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
 
-    TRE_ASSERT(v01v01 > 1.e-6f);
+  adjacencyStart.assign(vertices.size() + 1, 0);
+  adjacency.resize(edges.size());
+  for (std::size_t iE = 0; iE < edges.size(); ++iE)
+  {
+    ++adjacencyStart[edges[iE].first + 1];
+    adjacency[iE] = edges[iE].second;
+  }
+  for (std::size_t iV = 0; iV < vertices.size(); ++iV)
+    adjacencyStart[iV + 1] += adjacencyStart[iV];
+}
 
-    cU = cU + cV * v01v02 / v01v01;
-    cV = 0.f;
+// ----------------------------------------------------------------------------
 
-    if (cU < 0.f)
-       cU = 0.f;
-    else if (cU > 1.f)
-      cU = 1.f;
-  }
-  else if (cU < 0.f) // project on edge 02
+uint32_t s_contact3D::s_skinConvex::support(const glm::vec3 &direction, uint32_t hint) const
+{
+  TRE_ASSERT(!vertices.empty());
+  TRE_ASSERT(adjacencyStart.size() == vertices.size() + 1);
+
+  uint32_t vCurr = (hint < vertices.size()) ? hint : 0;
+  float    dCurr = glm::dot(vertices[vCurr], direction);
+
+  // hill-climbing: on a convex mesh, a vertex that is not the farthest has a farther neighbor.
+  while (true)
   {
-    // find 0P + a t02 = (cU + a x) * v01 + (cV + a y) * v02 = cVnew * v02
-    // with cUnew = (cU + a x) == 0
+    uint32_t vNext = vCurr;
+    for (uint32_t iA = adjacencyStart[vCurr], iAstop = adjacencyStart[vCurr + 1]; iA < iAstop; ++iA)
+    {
+      const uint32_t vN = adjacency[iA];
+      const float    dN = glm::dot(vertices[vN], direction);
+      if (dN > dCurr)
+      {
+        dCurr = dN;
+        vNext = vN;
+      }
+    }
+    if (vNext == vCurr) return vCurr;
+    vCurr = vNext;
+  }
+}
 
-    // in the same way: cUnew = 0
-    //                  cVnew = cV + cU * v02.v01 / v02.v02
+// ----------------------------------------------------------------------------
 
-    cV = cV + cU * v01v02 / v02v02;
-    cU = 0.f;
+/// Shapes for the GJK/EPA. The GJK works on the core of the shapes, the "margin" is a radius added around the core.
+struct _gjkShapeSkin
+{
+  const s_contact3D::s_skinConvex &skin;
 
-    if (cV < 0.f)
-       cV = 0.f;
-    else if (cV > 1.f)
-      cV = 1.f;
-  }
-  else if ((cU + cV) > 1.f) // project on edge 12
+  float     margin() const { return 0.f; }
+  uint32_t  vertexCount() const { return uint32_t(skin.vertices.size()); }
+  glm::vec3 vertex(uint32_t id) const { return skin.vertices[id]; }
+  uint32_t  support(const glm::vec3 &dir, uint32_t hint) const { return skin.support(dir, hint); }
+};
+
+struct _gjkShapeBox
+{
+  const s_boundbox &box;
+
+  float     margin() const { return 0.f; }
+  uint32_t  vertexCount() const { return 8; }
+  glm::vec3 vertex(uint32_t id) const { return glm::vec3((id & 1) ? box.m_max.x : box.m_min.x, (id & 2) ? box.m_max.y : box.m_min.y, (id & 4) ? box.m_max.z : box.m_min.z); }
+  uint32_t  support(const glm::vec3 &dir, uint32_t ) const { return (dir.x > 0.f ? 1u : 0u) | (dir.y > 0.f ? 2u : 0u) | (dir.z > 0.f ? 4u : 0u); }
+};
+
+struct _gjkShapeSphere
+{
+  const glm::vec3 &center;
+  const float     radius;
+
+  float     margin() const { return radius; }
+  uint32_t  vertexCount() const { return 1; }
+  glm::vec3 vertex(uint32_t ) const { return center; }
+  uint32_t  support(const glm::vec3 &, uint32_t ) const { return 0; }
+};
+
+// ----------------------------------------------------------------------------
+
+/// Simplex of the GJK: vertices of the Minkowski difference (A - B), with their barycentric coordinate (lambda) for the closest point to the origin.
+struct _gjkSimplex
+{
+  struct s_vertex
   {
-    // find 0P + a t12 = (cU + a x) * v01 + (cV + a y) * v02 = cUnew * v01 + cVnew * v02
-    // with cUnew + cVnew = cU + cV + a (x + y) = 1.f
+    glm::vec3 w;  ///< w = a - b
+    glm::vec3 a;  ///< support point on A
+    glm::vec3 b;  ///< support point on B
+    uint32_t  iA; ///< support vertex on A
+    uint32_t  iB; ///< support vertex on B
+    float     lambda;
+  };
+  std::array<s_vertex, 4> v;
+  unsigned                count = 0;
+
+  /// Reduce the simplex to the sub-simplex that contains the closest point to the origin, and returns the closest point. (count == 4 means that the origin is inside)
+  glm::vec3 solve();
+
+  glm::vec3 closestA() const { glm::vec3 p(0.f); for (unsigned i = 0; i < count; ++i) p += v[i].lambda * v[i].a; return p; }
+  glm::vec3 closestB() const { glm::vec3 p(0.f); for (unsigned i = 0; i < count; ++i) p += v[i].lambda * v[i].b; return p; }
+
+private:
+  void _keep(unsigned i0) { v[0] = v[i0]; v[0].lambda = 1.f; count = 1; }
+  void _keep(unsigned i0, unsigned i1, float l1) { const s_vertex v0 = v[i0], v1 = v[i1]; v[0] = v0; v[1] = v1; v[0].lambda = 1.f - l1; v[1].lambda = l1; count = 2; }
+  glm::vec3 _solve2();
+  glm::vec3 _solve3();
+  glm::vec3 _solve4();
+};
+
+glm::vec3 _gjkSimplex::_solve2()
+{
+  const glm::vec3 &a = v[0].w, &b = v[1].w;
+  const glm::vec3 ab = b - a;
+  const float     t = -glm::dot(a, ab);
+  if (t <= 0.f) { _keep(0); return a; }
+  const float denom = glm::dot(ab, ab);
+  if (t >= denom) { _keep(1); return b; }
+  const float l1 = t / denom;
+  _keep(0, 1, l1);
+  return a + l1 * ab;
+}
 
-    // by definition, we have: t12 = x v01 + y v02
-    // v12.v01 = t12.t01 = x v02.t01 = x (-v01.t02)
-    // v12.v02 = t12.t02 = y v01.t02
+glm::vec3 _gjkSimplex::_solve3()
+{
+  // closest point on the triangle to the origin (see "Real-Time Collision Detection", C. Ericson, 5.1.5)
+  const glm::vec3 a = v[0].w, b = v[1].w, c = v[2].w;
+  const glm::vec3 ab = b - a, ac = c - a;
 
-    const glm::vec3 v12 = - v01 + v02;
-    const glm::vec3 t02 = glm::cross(eN, v02);
-    const float     v01t02 = glm::dot(v01, t02);
+  const float d1 = -glm::dot(ab, a), d2 = -glm::dot(ac, a);
+  if (d1 <= 0.f && d2 <= 0.f) { _keep(0); return a; }
 
-    const float x = glm::dot(v12, v01) / (-v01t02);
-    const float y = glm::dot(v12, v02) / ( v01t02);
+  const float d3 = -glm::dot(ab, b), d4 = -glm::dot(ac, b);
+  if (d3 >= 0.f && d4 <= d3) { _keep(1); return b; }
 
-    const float a = (1.f - (cU + cV)) / (x + y);
-    TRE_ASSERT(!std::isnan(a) && std::isfinite(a));
+  const float vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f) { const float l = d1 / (d1 - d3); _keep(0, 1, l); return a + l * ab; }
 
-    cU += a * x;
-    cV += a * y;
+  const float d5 = -glm::dot(ab, c), d6 = -glm::dot(ac, c);
+  if (d6 >= 0.f && d5 <= d6) { _keep(2); return c; }
 
-    if (cU > 1.f || cV < 0.f)
-    {
-      cU = 1.f;
-      cV = 0.f;
-    }
-    else if (cU < 0.f || cV > 1.f)
+  const float vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f) { const float l = d2 / (d2 - d6); _keep(0, 2, l); return a + l * ac; }
+
+  const float va = d3 * d6 - d5 * d4;
+  if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f) { const float l = (d4 - d3) / ((d4 - d3) + (d5 - d6)); _keep(1, 2, l); return b + l * (c - b); }
+
+  const float denom = 1.f / (va + vb + vc);
+  const float lb = vb * denom, lc = vc * denom;
+  v[0].lambda = 1.f - lb - lc;
+  v[1].lambda = lb;
+  v[2].lambda = lc;
+  return a + lb * ab + lc * ac;
+}
+
+glm::vec3 _gjkSimplex::_solve4()
+{
+  static const unsigned faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } }; // (face, opposite vertex)
+
+  const _gjkSimplex input = *this;
+  float             bestDistSquared = std::numeric_limits<float>::infinity();
+  glm::vec3         bestPt(0.f);
+  _gjkSimplex       best;
+  bool              isInside = true;
+
+  // a flat tetrahedron cannot contain the origin (it happens with the warm-start)
+  const glm::vec3 e1 = v[1].w - v[0].w, e2 = v[2].w - v[0].w, e3 = v[3].w - v[0].w;
+  const float     volume = std::abs(glm::dot(glm::cross(e1, e2), e3));
+  const float     scale = std::max(std::max(glm::dot(e1, e1), glm::dot(e2, e2)), glm::dot(e3, e3));
+  const bool      isFlat = (volume * volume <= 1.e-12f * scale * scale * scale);
+
+  for (const auto &f : faces)
+  {
+    const glm::vec3 &a = input.v[f[0]].w, &b = input.v[f[1]].w, &c = input.v[f[2]].w, &d = input.v[f[3]].w;
+    const glm::vec3 n = glm::cross(b - a, c - a);
+    const float     signO = -glm::dot(a, n);
+    const float     signD = glm::dot(d - a, n);
+    if (!isFlat && signO * signD > 0.f) continue; // the origin is on the same side than the opposite vertex
+    isInside = false;
+    _gjkSimplex tri;
+    tri.v[0] = input.v[f[0]];
+    tri.v[1] = input.v[f[1]];
+    tri.v[2] = input.v[f[2]];
+    tri.count = 3;
+    const glm::vec3 pt = tri._solve3();
+    const float     distSquared = glm::dot(pt, pt);
+    if (distSquared < bestDistSquared)
     {
-      cU = 0.f;
-      cV = 1.f;
+      bestDistSquared = distSquared;
+      bestPt = pt;
+      best = tri;
     }
   }
 
-  ptOnTriangle = pt0 + cU * v01 + cV * v02;
-
-  const glm::vec3 vCP = ptOnTriangle - center;
-  return glm::dot(vCP,vCP) <= (radius * radius);
+  if (isInside)
+  {
+    for (unsigned i = 0; i < 4; ++i) v[i].lambda = 0.25f;
+    return glm::vec3(0.f);
+  }
+  *this = best;
+  return bestPt;
 }
 
-// (3D in 3D) =================================================================
-
-bool s_contact3D::box_box(const s_boundbox &box_0, const s_boundbox &box_1)
+glm::vec3 _gjkSimplex::solve()
 {
-  s_boundbox boxIntersect;
-  boxIntersect.m_min = glm::max(box_0.m_min, box_1.m_min);
-  boxIntersect.m_max = glm::min(box_0.m_max, box_1.m_max);
-  return glm::all(glm::lessThanEqual(boxIntersect.m_min, boxIntersect.m_max));
+  switch (count)
+  {
+    case 1: v[0].lambda = 1.f; return v[0].w;
+    case 2: return _solve2();
+    case 3: return _solve3();
+    case 4: return _solve4();
+  }
+  TRE_FATAL("invalid simplex");
+  return glm::vec3(0.f);
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::box_sphere(const s_boundbox &box, const glm::vec3 &center, const float radius)
+/// GJK on the cores of the shapes. Returns the distance between the cores (0 when they overlap), and the closest points. The simplex is kept for the EPA.
+template <class _shapeA, class _shapeB>
+static float _gjk(const _shapeA &shapeA, const _shapeB &shapeB, _gjkSimplex &simplex, s_contact3D::s_gjkCache *cache, glm::vec3 &ptA, glm::vec3 &ptB)
 {
-  const glm::vec3 AC = center - box.m_min;
-  const glm::vec3 BC = center - box.m_max;
-  const glm::vec3 rrr = glm::vec3(radius);
+  static constexpr unsigned kMaxIterations = 64;
+  static constexpr float    kRelativeTolerance = 1.e-6f;
+  static constexpr float    kOverlapDistSquared = 1.e-12f;
 
-  if (glm::any(glm::lessThan(AC, -rrr)) || glm::any(glm::greaterThan(BC, rrr)))
-    return false;
+  const auto fnSetVertex = [&](_gjkSimplex::s_vertex &sv, uint32_t iA, uint32_t iB)
+  {
+    sv.iA = iA;
+    sv.iB = iB;
+    sv.a = shapeA.vertex(iA);
+    sv.b = shapeB.vertex(iB);
+    sv.w = sv.a - sv.b;
+  };
 
-  // check the edges and corners ...
-  glm::vec3 PC = AC;
-  if (AC.x > -BC.x) PC.x = BC.x; // TODO : find a "glm::select(vFalse, vTrue, condition)
-  if (AC.y > -BC.y) PC.y = BC.y;
-  if (AC.z > -BC.z) PC.z = BC.z;
-  if (AC.x * BC.x <= 0.f) PC.x = 0.f; // TODO : find a "glm::select(vFalse, vTrue, condition)
-  if (AC.y * BC.y <= 0.f) PC.y = 0.f;
-  if (AC.z * BC.z <= 0.f) PC.z = 0.f;
+  // initial simplex (warm-start from the cache)
 
-  return glm::dot(PC, PC) <= radius * radius;
+  simplex.count = 0;
+  if (cache != nullptr && cache->count != 0 && cache->count <= 4)
+  {
+    for (unsigned i = 0; i < cache->count; ++i)
+    {
+      if (cache->indexA[i] >= shapeA.vertexCount() || cache->indexB[i] >= shapeB.vertexCount()) { simplex.count = 0; break; }
+      fnSetVertex(simplex.v[simplex.count++], cache->indexA[i], cache->indexB[i]);
+    }
+  }
+  if (simplex.count == 0)
+  {
+    const glm::vec3 dir = shapeB.vertex(0) - shapeA.vertex(0);
+    fnSetVertex(simplex.v[0], shapeA.support(dir, 0), shapeB.support(-dir, 0));
+    simplex.count = 1;
+  }
+
+  float distSquared = std::numeric_limits<float>::infinity();
+  bool  isOverlapping = false;
+
+  for (unsigned iter = 0; iter < kMaxIterations; ++iter)
+  {
+    const glm::vec3 v = simplex.solve();
+    if (simplex.count == 4) { isOverlapping = true; break; }
+
+    const float vv = glm::dot(v, v);
+    if (vv < kOverlapDistSquared) { isOverlapping = true; break; }
+    if (vv >= distSquared) break; // no progress (numerical issue)
+    distSquared = vv;
+
+    const _gjkSimplex::s_vertex &last = simplex.v[simplex.count - 1];
+    _gjkSimplex::s_vertex        sv;
+    fnSetVertex(sv, shapeA.support(-v, last.iA), shapeB.support(v, last.iB));
+
+    bool isDuplicated = false;
+    for (unsigned i = 0; i < simplex.count; ++i) isDuplicated |= (simplex.v[i].iA == sv.iA && simplex.v[i].iB == sv.iB);
+    if (isDuplicated) break;
+
+    if (vv - glm::dot(v, sv.w) <= kRelativeTolerance * vv) break; // converged
+
+    simplex.v[simplex.count++] = sv;
+  }
+
+  if (cache != nullptr)
+  {
+    cache->count = simplex.count;
+    for (unsigned i = 0; i < simplex.count; ++i)
+    {
+      cache->indexA[i] = simplex.v[i].iA;
+      cache->indexB[i] = simplex.v[i].iB;
+    }
+  }
+
+  if (isOverlapping)
+  {
+    ptA = ptB = simplex.closestA();
+    return 0.f;
+  }
+
+  // recompute the barycentric coordinates of the final simplex
+  const glm::vec3 v = simplex.solve();
+  ptA = simplex.closestA();
+  ptB = simplex.closestB();
+  return std::sqrt(glm::dot(v, v));
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::sphere_skin(const glm::vec3 &center, const float radius, const s_skin &pts)
+/// EPA on the cores of the shapes, from the simplex given by the GJK (the cores overlap).
+/// Returns the penetration normal (out-normal of A, toward B), the penetration depth and the deepest points.
+template <class _shapeA, class _shapeB>
+static void _epa(const _shapeA &shapeA, const _shapeB &shapeB, const _gjkSimplex &simplex, glm::vec3 &normal, float &depth, glm::vec3 &ptA, glm::vec3 &ptB)
 {
-  TRE_ASSERT(pts.size() % 3 == 0);
+  static constexpr unsigned kMaxVertices = 64;
+  static constexpr unsigned kMaxFaces = 128;
+  static constexpr unsigned kMaxIterations = 48;
+  static constexpr float    kTolerance = 1.e-5f;
 
-  for (std::size_t iP = 0, iTstop = pts.size(); iP < iTstop; iP += 3)
+  struct s_face
   {
-    glm::vec3 dummy;
-    if (cross_tri_sphere(dummy, pts[iP], pts[iP + 1], pts[iP + 2], center, radius))
-      return true;
-  }
+    uint32_t  i0, i1, i2;
+    glm::vec3 n;
+    float     d;
+  };
+
+  std::array<_gjkSimplex::s_vertex, kMaxVertices> verts;
+  std::array<s_face, kMaxFaces>                   faces;
+  unsigned                                        nVerts = 0, nFaces = 0;
+
+  const auto fnSupport = [&](const glm::vec3 &dir, uint32_t hintA, uint32_t hintB) -> _gjkSimplex::s_vertex
+  {
+    _gjkSimplex::s_vertex sv;
+    sv.iA = shapeA.support(dir, hintA);
+    sv.iB = shapeB.support(-dir, hintB);
+    sv.a = shapeA.vertex(sv.iA);
+    sv.b = shapeB.vertex(sv.iB);
+    sv.w = sv.a - sv.b;
+    return sv;
+  };
+
+  const auto fnFallback = [&]() // the Minkowski difference is flat: touching contact
+  {
+    const glm::vec3 d = shapeB.vertex(0) - shapeA.vertex(0);
+    const float     dd = glm::dot(d, d);
+    normal = (dd > 0.f) ? d / std::sqrt(dd) : glm::vec3(0.f, 1.f, 0.f);
+    depth = 0.f;
+    ptA = ptB = simplex.v[0].a;
+  };
+
+  for (unsigned i = 0; i < simplex.count; ++i) verts[nVerts++] = simplex.v[i];
+
+  // grow the simplex to a tetrahedron
+
+  static const glm::vec3 kAxes[6] = { glm::vec3(1.f, 0.f, 0.f), glm::vec3(-1.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f), glm::vec3(0.f, -1.f, 0.f), glm::vec3(0.f, 0.f, 1.f), glm::vec3(0.f, 0.f, -1.f) };
+
+  if (nVerts == 1)
+  {
+    for (const glm::vec3 &dir : kAxes)
+    {
+      const _gjkSimplex::s_vertex sv = fnSupport(dir, verts[0].iA, verts[0].iB);
+      const glm::vec3             d = sv.w - verts[0].w;
+      if (glm::dot(d, d) > 1.e-12f) { verts[nVerts++] = sv; break; }
+    }
+    if (nVerts == 1) { fnFallback(); return; }
+  }
+  if (nVerts == 2)
+  {
+    const glm::vec3 d = verts[1].w - verts[0].w;
+    const glm::vec3 axis = (std::abs(d.x) < std::abs(d.y)) ? ((std::abs(d.x) < std::abs(d.z)) ? kAxes[0] : kAxes[4]) : ((std::abs(d.y) < std::abs(d.z)) ? kAxes[2] : kAxes[4]);
+    const glm::vec3 e1 = glm::cross(d, axis), e2 = glm::cross(d, e1);
+    for (const glm::vec3 &dir : { e1, -e1, e2, -e2 })
+    {
+      const _gjkSimplex::s_vertex sv = fnSupport(dir, verts[0].iA, verts[0].iB);
+      const glm::vec3             c = glm::cross(sv.w - verts[0].w, d);
+      if (glm::dot(c, c) > 1.e-12f * glm::dot(d, d)) { verts[nVerts++] = sv; break; }
+    }
+    if (nVerts == 2) { fnFallback(); return; }
+  }
+  if (nVerts == 3)
+  {
+    const glm::vec3 n = glm::cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w);
+    for (const glm::vec3 &dir : { n, -n })
+    {
+      const _gjkSimplex::s_vertex sv = fnSupport(dir, verts[0].iA, verts[0].iB);
+      if (std::abs(glm::dot(sv.w - verts[0].w, n)) > 1.e-6f * glm::length(n)) { verts[nVerts++] = sv; break; }
+    }
+    if (nVerts == 3) { fnFallback(); return; }
+  }
+
+  // initial polytope (the faces are oriented outward)
+
+  if (glm::dot(glm::cross(verts[1].w - verts[0].w, verts[2].w - verts[0].w), verts[3].w - verts[0].w) > 0.f)
+    std::swap(verts[1], verts[2]);
+
+  const auto fnAddFace = [&](uint32_t i0, uint32_t i1, uint32_t i2) -> bool
+  {
+    if (nFaces == kMaxFaces) return false;
+    s_face &f = faces[nFaces];
+    f.i0 = i0; f.i1 = i1; f.i2 = i2;
+    const glm::vec3 n = glm::cross(verts[i1].w - verts[i0].w, verts[i2].w - verts[i0].w);
+    const float     nn = glm::length(n);
+    if (nn < 1.e-12f) return true; // degenerated face, skipped
+    f.n = n / nn;
+    f.d = glm::dot(f.n, verts[i0].w);
+    ++nFaces;
+    return true;
+  };
+
+  fnAddFace(0, 1, 2);
+  fnAddFace(0, 3, 1);
+  fnAddFace(0, 2, 3);
+  fnAddFace(1, 3, 2);
+  if (nFaces == 0) { fnFallback(); return; }
+
+  // expand the polytope
+
+  unsigned iClosest = 0;
+  for (unsigned iter = 0; iter < kMaxIterations; ++iter)
+  {
+    iClosest = 0;
+    for (unsigned iF = 1; iF < nFaces; ++iF)
+    {
+      if (faces[iF].d < faces[iClosest].d) iClosest = iF;
+    }
+    const s_face closest = faces[iClosest];
+
+    const _gjkSimplex::s_vertex sv = fnSupport(closest.n, verts[closest.i0].iA, verts[closest.i0].iB);
+    if (glm::dot(sv.w, closest.n) - closest.d < kTolerance || nVerts == kMaxVertices) break;
+
+    const uint32_t iNew = nVerts;
+    verts[nVerts++] = sv;
+
+    // remove the faces visible from the new vertex, and get the horizon
+    std::array<std::pair<uint32_t, uint32_t>, kMaxFaces * 3> horizon;
+    unsigned                                                 nHorizon = 0;
+    const auto fnAddEdge = [&](uint32_t e0, uint32_t e1)
+    {
+      for (unsigned iE = 0; iE < nHorizon; ++iE)
+      {
+        if (horizon[iE].first == e1 && horizon[iE].second == e0) { horizon[iE] = horizon[--nHorizon]; return; } // shared by 2 removed faces
+      }
+      horizon[nHorizon++] = std::make_pair(e0, e1);
+    };
+    for (unsigned iF = 0; iF < nFaces;)
+    {
+      const s_face &f = faces[iF];
+      if (glm::dot(f.n, sv.w - verts[f.i0].w) > 0.f)
+      {
+        fnAddEdge(f.i0, f.i1);
+        fnAddEdge(f.i1, f.i2);
+        fnAddEdge(f.i2, f.i0);
+        faces[iF] = faces[--nFaces];
+      }
+      else
+      {
+        ++iF;
+      }
+    }
+
+    bool isFull = false;
+    for (unsigned iE = 0; iE < nHorizon; ++iE)
+      isFull |= !fnAddFace(horizon[iE].first, horizon[iE].second, iNew);
+    if (isFull || nFaces == 0) break;
+  }
+
+  if (nFaces == 0) { fnFallback(); return; }
+  iClosest = 0;
+  for (unsigned iF = 1; iF < nFaces; ++iF)
+  {
+    if (faces[iF].d < faces[iClosest].d) iClosest = iF;
+  }
+  const s_face &closest = faces[iClosest];
+
+  // barycentric coordinates of the projection of the origin on the closest face
+  const _gjkSimplex::s_vertex &v0 = verts[closest.i0], &v1 = verts[closest.i1], &v2 = verts[closest.i2];
+  const glm::vec3 p = closest.d * closest.n;
+  const glm::vec3 e1 = v1.w - v0.w, e2 = v2.w - v0.w, ep = p - v0.w;
+  const float     d11 = glm::dot(e1, e1), d12 = glm::dot(e1, e2), d22 = glm::dot(e2, e2), dp1 = glm::dot(ep, e1), dp2 = glm::dot(ep, e2);
+  const float     denom = d11 * d22 - d12 * d12;
+  const float     l1 = (denom != 0.f) ? glm::clamp((d22 * dp1 - d12 * dp2) / denom, 0.f, 1.f) : 0.f;
+  const float     l2 = (denom != 0.f) ? glm::clamp((d11 * dp2 - d12 * dp1) / denom, 0.f, 1.f - l1) : 0.f;
+  const float     l0 = 1.f - l1 - l2;
+
+  // the closest face of (A - B) gives the translation of B, out of A: its normal is the out-normal of A
+  normal = closest.n;
+  depth = std::max(closest.d, 0.f);
+  ptA = l0 * v0.a + l1 * v1.a + l2 * v2.a;
+  ptB = l0 * v0.b + l1 * v1.b + l2 * v2.b;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Check the intersection of 2 convex shapes. When "cnt" is not null, the contact info is computed.
+template <class _shapeA, class _shapeB>
+static bool _gjk_intersect(s_contact3D *cnt, const _shapeA &shapeA, const _shapeB &shapeB, s_contact3D::s_gjkCache *cache)
+{
+  _gjkSimplex simplex;
+  glm::vec3   ptA, ptB;
+  const float marginAB = shapeA.margin() + shapeB.margin();
+  const float dist = _gjk(shapeA, shapeB, simplex, cache, ptA, ptB);
+
+  if (dist > marginAB) return false;
+  if (cnt == nullptr) return true;
+
+  if (dist > 0.f)
+  {
+    // the cores are separated, but the margins overlap
+    cnt->normal = (ptB - ptA) / dist;
+    cnt->penet = marginAB - dist;
+    ptA += shapeA.margin() * cnt->normal;
+    ptB -= shapeB.margin() * cnt->normal;
+  }
+  else
+  {
+    float depth;
+    _epa(shapeA, shapeB, simplex, cnt->normal, depth, ptA, ptB);
+    cnt->penet = depth + marginAB;
+    ptA += shapeA.margin() * cnt->normal;
+    ptB -= shapeB.margin() * cnt->normal;
+  }
+  cnt->pt = 0.5f * (ptA + ptB);
+  return true;
+}
+
+/// Compute the distance between 2 convex shapes.
+template <class _shapeA, class _shapeB>
+static float _gjk_distance(glm::vec3 &ptA, glm::vec3 &ptB, const _shapeA &shapeA, const _shapeB &shapeB, s_contact3D::s_gjkCache *cache)
+{
+  _gjkSimplex simplex;
+  const float marginAB = shapeA.margin() + shapeB.margin();
+  const float dist = _gjk(shapeA, shapeB, simplex, cache, ptA, ptB);
+  if (dist <= marginAB)
+  {
+    ptA = ptB = 0.5f * (ptA + ptB);
+    return 0.f;
+  }
+  const glm::vec3 n = (ptB - ptA) / dist;
+  ptA += shapeA.margin() * n;
+  ptB -= shapeB.margin() * n;
+  return dist - marginAB;
+}
+
+// Helpers ====================================================================
+
+inline static float tetra_volume(const glm::vec3 &ptA, const glm::vec3 &ptB, const glm::vec3 &ptC, const glm::vec3 &ptD)
+{
+  return fabsf(glm::dot(glm::cross(ptB - ptA, ptC - ptA), ptD - ptA)) / 6.f;
+}
+
+/// Compute the barycenter of the convex mesh [mesh's skin: list of triangles]. Also compute the volume.
+static void skin_barycenter(const s_contact3D::s_skin &pts, glm::vec3 &center, float &volume)
+{
+  TRE_ASSERT(pts.size() % 3 == 0);
+  center = glm::vec3(0.f);
+  volume = 0.f;
+  for (std::size_t iQ = 3, Npts = pts.size(); iQ < Npts; iQ += 3)
+  {
+    const float weightCurr = tetra_volume(pts[0], pts[iQ], pts[iQ + 1], pts[iQ + 2]);
+    center += weightCurr * (pts[0] + pts[iQ] + pts[iQ + 1] + pts[iQ + 2]);
+    volume += weightCurr;
+  }
+  center *= 1.f / (4.f * volume);
+}
+
+// (0D in 3D) Simple penetration test of a point in a volume ==================
+
+bool s_contact3D::point_treta(const glm::vec3 & point,
+                              const glm::vec3 & pt0, const glm::vec3 & pt1, const glm::vec3 & pt2, const glm::vec3 & pt3)
+{
+  const glm::vec3 v0P = point - pt0;
+
+  const glm::vec3 edge01 = pt1 - pt0;
+  const glm::vec3 edge02 = pt2 - pt0;
+  const glm::vec3 edge03 = pt3 - pt0;
+
+  const glm::vec3 normal012 = glm::cross(edge01, edge02);
+  if (glm::dot(normal012, v0P) * glm::dot(normal012, edge03) < 0.f) return false;
+
+  const glm::vec3 normal013 = glm::cross(edge01, edge03);
+  if (glm::dot(normal013, v0P) * glm::dot(normal013, edge02) < 0.f) return false;
+
+  const glm::vec3 normal023 = glm::cross(edge02, edge03);
+  if (glm::dot(normal023, v0P) * glm::dot(normal023, edge01) < 0.f) return false;
+
+  const glm::vec3 v1P = point - pt1;
+  const glm::vec3 edge12 = pt2 - pt1;
+  const glm::vec3 edge13 = pt3 - pt1;
+
+  const glm::vec3 normal123 = glm::cross(edge12, edge13);
+  if (glm::dot(normal123, v1P) * glm::dot(normal123, edge01 /* = -edge10 */) > 0.f) return false;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_treta(s_contact3D & cntTetra,
+                              const glm::vec3 & point,
+                              const glm::vec3 & pt0, const glm::vec3 & pt1, const glm::vec3 & pt2, const glm::vec3 & pt3)
+{
+  const glm::vec3 v0P = point - pt0;
+
+  const glm::vec3 edge01 = pt1 - pt0;
+  const glm::vec3 edge02 = pt2 - pt0;
+  const glm::vec3 edge03 = pt3 - pt0;
+
+  const glm::vec3 normal012 = glm::cross(edge01, edge02);
+  if (glm::dot(normal012, v0P) * glm::dot(normal012, edge03) < 0.f) return false;
+
+  const glm::vec3 normal013 = glm::cross(edge01, edge03);
+  if (glm::dot(normal013, v0P) * glm::dot(normal013, edge02) < 0.f) return false;
+
+  const glm::vec3 normal023 = glm::cross(edge02, edge03);
+  if (glm::dot(normal023, v0P) * glm::dot(normal023, edge01) < 0.f) return false;
+
+  const glm::vec3 v1P = point - pt1;
+  const glm::vec3 edge12 = pt2 - pt1;
+  const glm::vec3 edge13 = pt3 - pt1;
+
+  const glm::vec3 normal123 = glm::cross(edge12, edge13);
+  if (glm::dot(normal123, v1P) * glm::dot(normal123, edge01 /* = -edge10 */) > 0.f) return false;
+
+  // the "point" is inside
+
+  cntTetra.penet = std::numeric_limits<float>::infinity();
+
+  TRE_ASSERT(glm::length(normal012) > 1.e-6f);
+  const glm::vec3 normal012_unit = glm::normalize(normal012);
+  const float dist012 = glm::dot(normal012_unit, v0P);
+  const float dist012_abs = fabsf(dist012);
+  if (dist012_abs < cntTetra.penet)
+  {
+    cntTetra.penet = dist012_abs;
+    cntTetra.pt = point - dist012 * normal012_unit;
+    cntTetra.normal = - normal012_unit;
+    if (dist012 < 0.f)
+      cntTetra.normal = - cntTetra.normal;
+  }
+
+  TRE_ASSERT(glm::length(normal013) > 1.e-6f);
+  const glm::vec3 normal013_unit = glm::normalize(normal013);
+  const float dist013 = glm::dot(normal013_unit, v0P);
+  const float dist013_abs = fabsf(dist013);
+  if (dist013_abs < cntTetra.penet)
+  {
+    cntTetra.penet = dist013_abs;
+    cntTetra.pt = point - dist013 * normal013_unit;
+    cntTetra.normal = - normal013_unit;
+    if (dist013 < 0.f)
+      cntTetra.normal = - cntTetra.normal;
+  }
+
+  TRE_ASSERT(glm::length(normal023) > 1.e-6f);
+  const glm::vec3 normal023_unit = glm::normalize(normal023);
+  const float dist023 = glm::dot(normal023_unit, v0P);
+  const float dist023_abs = fabsf(dist023);
+  if (dist023_abs < cntTetra.penet)
+  {
+    cntTetra.penet = dist023_abs;
+    cntTetra.pt = point - dist023 * normal023_unit;
+    cntTetra.normal = - normal023_unit;
+    if (dist023 < 0.f)
+      cntTetra.normal = - cntTetra.normal;
+  }
+
+  TRE_ASSERT(glm::length(normal123) > 1.e-6f);
+  const glm::vec3 normal123_unit = glm::normalize(normal123);
+  const float dist123 = glm::dot(normal123_unit, v1P);
+  const float dist123_abs = fabsf(dist123);
+  if (dist123_abs < cntTetra.penet)
+  {
+    cntTetra.penet = dist123_abs;
+    cntTetra.pt = point - dist123 * normal123_unit;
+    cntTetra.normal = - normal123_unit;
+    if (dist123 < 0.f)
+      cntTetra.normal = - cntTetra.normal;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_box(const glm::vec3 & point,
+                            const s_boundbox & bbox)
+{
+  //return glm::all(glm::lessThanEqual(bbox.m_min, point)) && glm::all(glm::lessThanEqual(point, bbox.m_max));
+
+  const glm::vec3 vAP = point - bbox.m_min;
+  if (vAP.x < 0.f || vAP.y < 0.f || vAP.z) return false;
+
+  const glm::vec3 vPB = bbox.m_max - point;
+  if (vPB.x < 0.f || vPB.y < 0.f || vPB.z) return false;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_box(s_contact3D & cntBox,
+                            const glm::vec3 & point,
+                            const s_boundbox & bbox)
+{
+  const glm::vec3 vAP = point - bbox.m_min;
+  float vAPmin = vAP.x; unsigned vAPminInd = 0;
+  if (vAP.y < vAPmin) { vAPmin = vAP.y; vAPminInd = 1; }
+  if (vAP.z < vAPmin) { vAPmin = vAP.z; vAPminInd = 2; }
+  if (vAPmin < 0.f) return false;
+
+  const glm::vec3 vPB = bbox.m_max - point;
+  float vPBmin = vPB.x; unsigned vPBminInd = 0;
+  if (vPB.y < vPBmin) { vPBmin = vPB.y; vPBminInd = 1; }
+  if (vPB.z < vPBmin) { vPBmin = vPB.z; vPBminInd = 2; }
+  if (vPBmin < 0.f) return false;
+
+  if (vAPmin < vPBmin)
+  {
+    cntBox.penet = vAPmin;
+    cntBox.normal = glm::vec3(0.f);
+    cntBox.normal[vAPminInd] = -1.f;
+    cntBox.pt = point + vAP * cntBox.normal;
+  }
+  else
+  {
+    cntBox.penet = vPBmin;
+    cntBox.normal = glm::vec3(0.f);
+    cntBox.normal[vPBminInd] = 1.f;
+    cntBox.pt = point + vPB * cntBox.normal;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_skin(const glm::vec3 & point,
+                             const s_skin & pts)
+{
+  TRE_ASSERT(pts.size() % 3 == 0);
+
+  for (std::size_t iQ = 0, Npts = pts.size(); iQ < Npts; iQ += 3)
+  {
+    // check against the plane (iQ, iQ+1, iQ+2)
+    const glm::vec3 v0P = point - pts[iQ+0];
+
+    const glm::vec3 edge01 = pts[iQ+1] - pts[iQ+0];
+    const glm::vec3 edge02 = pts[iQ+2] - pts[iQ+0];
+    const glm::vec3 normal012 = glm::cross(edge01, edge02);
+    TRE_ASSERT(glm::length(normal012) > 1.e-12f);
+
+    if (glm::dot(normal012, v0P) > 0.f) return false;
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_skin(s_contact3D & cntSkin,
+                             const glm::vec3 & point,
+                             const s_skin & pts)
+{
+  const std::size_t Npts = pts.size();
+  TRE_ASSERT(Npts % 3 == 0);
+
+  if (Npts < 12) // at least a tetrahedron
+    return false;
+
+  cntSkin.penet = std::numeric_limits<float>::infinity();
+
+  for (std::size_t iQ = 0; iQ < Npts; iQ += 3)
+  {
+    // check against the plane (iQ, iQ+1, iQ+2)
+    const glm::vec3 v0P = point - pts[iQ+0];
+
+    const glm::vec3 edge01 = pts[iQ+1] - pts[iQ+0];
+    const glm::vec3 edge02 = pts[iQ+2] - pts[iQ+0];
+    const glm::vec3 normal012 = glm::normalize(glm::cross(edge01, edge02));
+    TRE_ASSERT(!std::isnan(normal012.x));
+
+    const float dist012 = glm::dot(normal012, v0P);
+
+    if (dist012 > 0.f) return false;
+
+    if (-dist012 < cntSkin.penet)
+    {
+      cntSkin.penet = -dist012;
+      cntSkin.pt = point - dist012 * normal012;
+      cntSkin.normal = normal012;
+    }
+  }
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_skin(const glm::vec3 & point,
+                             const s_skinBvh & skinBvh)
+{
+  return _skinBvh_inside(skinBvh, point);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_skin(s_contact3D & cntSkin,
+                             const glm::vec3 & point,
+                             const s_skinBvh & skinBvh)
+{
+  if (!_skinBvh_inside(skinBvh, point))
+    return false;
+
+  glm::vec3 ptOnSkin, triNormal;
+  if (!_skinBvh_closest(skinBvh, point, std::numeric_limits<float>::infinity(), ptOnSkin, triNormal))
+    return false;
+
+  cntSkin.pt = ptOnSkin;
+  cntSkin.normal = triNormal;
+  cntSkin.penet = glm::length(ptOnSkin - point);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_sphere(const glm::vec3 &point,
+                               const glm::vec3 &center, const float radius)
+{
+  const glm::vec3 vCP = point - center;
+  return glm::dot(vCP,vCP) <= radius * radius;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::point_sphere(s_contact3D & cntSphere,
+                               const glm::vec3 &point,
+                               const glm::vec3 &center, const float radius)
+{
+  const glm::vec3 vCP = point - center;
+  float dCP = glm::dot(vCP,vCP);
+  if (dCP > radius * radius) return false;
+  dCP = std::sqrt(dCP);
+
+  const glm::vec3 normalOut = dCP == 0.f ? glm::vec3(1.f, 0.f, 0.f) : vCP / dCP;
+  cntSphere.pt = center + normalOut * radius;
+  cntSphere.normal = normalOut;
+  cntSphere.penet = radius - dCP;
+
+  return true;
+}
+
+// (2D <-> 2D) Surface cross ==================================================
+
+bool s_contact3D::cross_tri_sphere(glm::vec3 &ptOnTriangle,
+                                   const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2,
+                                   const glm::vec3 &center, const float radius)
+{
+  // project center on plane (pt0,pt1,pt2)
+  const glm::vec3 v01 = pt1 - pt0;
+  const glm::vec3 v02 = pt2 - pt0;
+  const glm::vec3 eN = glm::normalize(glm::cross(v01, v02));
+  TRE_ASSERT(!std::isnan(eN.x));
+  const glm::vec3 v0C = center - pt0;
+  const float     coordN = glm::dot(v0C, eN);
+
+  if (fabsf(coordN) > radius)
+    return false;
+
+  const float v01v01 = glm::dot(v01, v01);
+  const float v02v02 = glm::dot(v02, v02);
+  const float v01v02 = glm::dot(v01, v02);
+
+  float cU = glm::dot(v01, v0C) / v01v01;
+  float cV = glm::dot(v02, v0C) / v02v02;
+
+  // projection on the tri's edge or tri's vertex.
+
+  if (cV < 0.f) // project on edge 01
+  {
+    // find 0P + a t01 = (cU + a x) * v01 + (cV + a y) * v02 = cUnew * v01
+    // with cVnew = (cV + a y) == 0
+    // thus: cUnew = cU + a x = cU - cV * x / y
+
+    // by definition, we have: t01 = x v01 + y v02
+    // (t01.v01) = x v01.v01 + y v02.v01 = 0
+    // thus: x / y = - v02.v01 / v01.v01
+
+    // Finally, cUnew = cU + cV * v02.v01 / v01.v01
+    //          cVnew = 0
+
+    TRE_ASSERT(v01v01 > 1.e-6f);
+
+    cU = cU + cV * v01v02 / v01v01;
+    cV = 0.f;
+
+    if (cU < 0.f)
+       cU = 0.f;
+    else if (cU > 1.f)
+      cU = 1.f;
+  }
+  else if (cU < 0.f) // project on edge 02
+  {
+    // find 0P + a t02 = (cU + a x) * v01 + (cV + a y) * v02 = cVnew * v02
+    // with cUnew = (cU + a x) == 0
+
+    // in the same way: cUnew = 0
+    //                  cVnew = cV + cU * v02.v01 / v02.v02
+
+    cV = cV + cU * v01v02 / v02v02;
+    cU = 0.f;
+
+    if (cV < 0.f)
+       cV = 0.f;
+    else if (cV > 1.f)
+      cV = 1.f;
+  }
+  else if ((cU + cV) > 1.f) // project on edge 12
+  {
+    // find 0P + a t12 = (cU + a x) * v01 + (cV + a y) * v02 = cUnew * v01 + cVnew * v02
+    // with cUnew + cVnew = cU + cV + a (x + y) = 1.f
+
+    // by definition, we have: t12 = x v01 + y v02
+    // v12.v01 = t12.t01 = x v02.t01 = x (-v01.t02)
+    // v12.v02 = t12.t02 = y v01.t02
+
+    const glm::vec3 v12 = - v01 + v02;
+    const glm::vec3 t02 = glm::cross(eN, v02);
+    const float     v01t02 = glm::dot(v01, t02);
+
+    const float x = glm::dot(v12, v01) / (-v01t02);
+    const float y = glm::dot(v12, v02) / ( v01t02);
+
+    const float a = (1.f - (cU + cV)) / (x + y);
+    TRE_ASSERT(!std::isnan(a) && std::isfinite(a));
+
+    cU += a * x;
+    cV += a * y;
+
+    if (cU > 1.f || cV < 0.f)
+    {
+      cU = 1.f;
+      cV = 0.f;
+    }
+    else if (cU < 0.f || cV > 1.f)
+    {
+      cU = 0.f;
+      cV = 1.f;
+    }
+  }
+
+  ptOnTriangle = pt0 + cU * v01 + cV * v02;
+
+  const glm::vec3 vCP = ptOnTriangle - center;
+  return glm::dot(vCP,vCP) <= (radius * radius);
+}
+
+// (3D in 3D) =================================================================
+
+bool s_contact3D::box_box(const s_boundbox &box_0, const s_boundbox &box_1)
+{
+  s_boundbox boxIntersect;
+  boxIntersect.m_min = glm::max(box_0.m_min, box_1.m_min);
+  boxIntersect.m_max = glm::min(box_0.m_max, box_1.m_max);
+  return glm::all(glm::lessThanEqual(boxIntersect.m_min, boxIntersect.m_max));
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::box_sphere(const s_boundbox &box, const glm::vec3 &center, const float radius)
+{
+  const glm::vec3 AC = center - box.m_min;
+  const glm::vec3 BC = center - box.m_max;
+  const glm::vec3 rrr = glm::vec3(radius);
+
+  if (glm::any(glm::lessThan(AC, -rrr)) || glm::any(glm::greaterThan(BC, rrr)))
+    return false;
+
+  // check the edges and corners ...
+  glm::vec3 PC = AC;
+  if (AC.x > -BC.x) PC.x = BC.x; // TODO : find a "glm::select(vFalse, vTrue, condition)
+  if (AC.y > -BC.y) PC.y = BC.y;
+  if (AC.z > -BC.z) PC.z = BC.z;
+  if (AC.x * BC.x <= 0.f) PC.x = 0.f; // TODO : find a "glm::select(vFalse, vTrue, condition)
+  if (AC.y * BC.y <= 0.f) PC.y = 0.f;
+  if (AC.z * BC.z <= 0.f) PC.z = 0.f;
+
+  return glm::dot(PC, PC) <= radius * radius;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(const glm::vec3 &center, const float radius, const s_skin &pts)
+{
+  TRE_ASSERT(pts.size() % 3 == 0);
+
+  for (std::size_t iP = 0, iTstop = pts.size(); iP < iTstop; iP += 3)
+  {
+    glm::vec3 dummy;
+    if (cross_tri_sphere(dummy, pts[iP], pts[iP + 1], pts[iP + 2], center, radius))
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(s_contact3D &cntSphere, const glm::vec3 &center, const float radius, const s_skin &pts)
+{
+  TRE_ASSERT(pts.size() % 3 == 0);
+
+  if (point_skin(cntSphere, center, pts))
+  {
+    cntSphere.penet = glm::length(cntSphere.pt - center) + radius;
+    cntSphere.normal = -cntSphere.normal;
+    cntSphere.pt += cntSphere.normal * cntSphere.penet * 0.5f;
+    return true;
+  }
+
+
+  const float maxDist = 1.1f * radius;
+  float dist = maxDist;
+
+  // TODO ... (good enough approximation ?)
+
+  for (std::size_t iP = 0, iTstop = pts.size(); iP < iTstop; iP += 3)
+  {
+    glm::vec3 ptOntri;
+    if (cross_tri_sphere(ptOntri, pts[iP], pts[iP + 1], pts[iP + 2], center, radius))
+    {
+      const glm::vec3 vCP = ptOntri - center;
+      const float     lCP = glm::length(vCP);
+      if (lCP < dist)
+      {
+        dist = lCP;
+        cntSphere.penet = radius - lCP;
+        if (lCP > 1.e-6f)
+          cntSphere.normal = vCP / lCP;
+        else
+          cntSphere.normal = - glm::normalize(glm::cross(pts[iP+1] - pts[iP], pts[iP+2] - pts[iP]));
+        cntSphere.pt = center + 0.5f * (radius + lCP) * cntSphere.normal;
+      }
+    }
+  }
+
+  return (dist < maxDist);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(const glm::vec3 &center, const float radius, const s_skinBvh &skinBvh)
+{
+  const float radiusSquared = radius * radius;
+
+  const auto fnCross = [&center, radius](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+    {
+      glm::vec3 dummy;
+      return cross_tri_sphere(dummy, pt0, pt1, pt2, center, radius);
+    };
+
+  if (_skinBvh_sphere(skinBvh, center, radiusSquared, fnCross))
+    return true;
+
+  return _skinBvh_inside(skinBvh, center);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(s_contact3D &cntSphere, const glm::vec3 &center, const float radius, const s_skinBvh &skinBvh)
+{
+  if (point_skin(cntSphere, center, skinBvh))
+  {
+    cntSphere.penet = glm::length(cntSphere.pt - center) + radius;
+    cntSphere.normal = -cntSphere.normal;
+    cntSphere.pt += cntSphere.normal * cntSphere.penet * 0.5f;
+    return true;
+  }
+
+  glm::vec3 ptOnSkin, triNormal;
+  if (!_skinBvh_closest(skinBvh, center, radius, ptOnSkin, triNormal))
+    return false;
+
+  const glm::vec3 vCP = ptOnSkin - center;
+  const float     lCP = glm::length(vCP);
+  cntSphere.penet = radius - lCP;
+  cntSphere.normal = (lCP > 1.e-6f) ? vCP / lCP : -triNormal;
+  cntSphere.pt = center + 0.5f * (radius + lCP) * cntSphere.normal;
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::box_sphere(s_contact3D &cntBox, const s_boundbox &box, const glm::vec3 &center, const float radius)
+{
+  const glm::vec3 AC = center - box.m_min;
+  const glm::vec3 BC = center - box.m_max;
+  const glm::vec3 rrr = glm::vec3(radius);
+
+  if (glm::any(glm::lessThan(AC, -rrr)) || glm::any(glm::greaterThan(BC, rrr)))
+    return false;
+
+  // check the edges and corners ...
+  glm::vec3 PC = AC;
+  if (AC.x > -BC.x) PC.x = BC.x; // TODO : find a "glm::select(vFalse, vTrue, condition)
+  if (AC.y > -BC.y) PC.y = BC.y;
+  if (AC.z > -BC.z) PC.z = BC.z;
+  if (AC.x * BC.x < 0.f) PC.x = 0.f; // TODO : find a "glm::select(vFalse, vTrue, condition)
+  if (AC.y * BC.y < 0.f) PC.y = 0.f;
+  if (AC.z * BC.z < 0.f) PC.z = 0.f;
+
+  const float distSquared = glm::dot(PC, PC);
+  const float radiusSquared = radius * radius;
+  if (distSquared > radiusSquared)
+    return false;
+
+  if (distSquared == 0.f) // center is inside
+  {
+    point_box(cntBox, center, box);
+    cntBox.penet += radius;
+    cntBox.pt -= cntBox.penet * 0.5f * cntBox.normal;
+  }
+  else
+  {
+    cntBox.normal = glm::normalize(PC);
+    const float dist = sqrtf(distSquared);
+    cntBox.penet = radius - dist;
+    cntBox.pt = center - (radius + dist) * 0.5f * cntBox.normal;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_sphere(s_contact3D &cntSphereA, const glm::vec3 &centerA, const float radiusA, const glm::vec3 &centerB, const float radiusB)
+{
+  const glm::vec3 vBA = centerA - centerB;
+
+  const float distSquared = glm::dot(vBA, vBA);
+  const float radiusApB = radiusA + radiusB;
+
+  if (distSquared > radiusApB * radiusApB)
+    return false;
+
+  cntSphereA.pt = (centerA / radiusA + centerB / radiusB) / (1.f/radiusA + 1.f/radiusB);
+  cntSphereA.penet = sqrtf(distSquared) - radiusApB;
+  cntSphereA.normal = glm::normalize(vBA);
+
+  return true;
+}
+
+// (3D in 3D) Convex shapes ===================================================
+
+bool s_contact3D::skin_skin(const s_skinConvex &skinA, const s_skinConvex &skinB, s_gjkCache *cache)
+{
+  return _gjk_intersect(nullptr, _gjkShapeSkin{skinA}, _gjkShapeSkin{skinB}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::skin_skin(s_contact3D &cntSkinA, const s_skinConvex &skinA, const s_skinConvex &skinB, s_gjkCache *cache)
+{
+  return _gjk_intersect(&cntSkinA, _gjkShapeSkin{skinA}, _gjkShapeSkin{skinB}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::box_skin(const s_boundbox &box, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_intersect(nullptr, _gjkShapeBox{box}, _gjkShapeSkin{skin}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::box_skin(s_contact3D &cntBox, const s_boundbox &box, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_intersect(&cntBox, _gjkShapeBox{box}, _gjkShapeSkin{skin}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(const glm::vec3 &center, const float radius, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_intersect(nullptr, _gjkShapeSphere{center, radius}, _gjkShapeSkin{skin}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_contact3D::sphere_skin(s_contact3D &cntSphere, const glm::vec3 &center, const float radius, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_intersect(&cntSphere, _gjkShapeSphere{center, radius}, _gjkShapeSkin{skin}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+float s_contact3D::distance_skin_skin(glm::vec3 &ptA, glm::vec3 &ptB, const s_skinConvex &skinA, const s_skinConvex &skinB, s_gjkCache *cache)
+{
+  return _gjk_distance(ptA, ptB, _gjkShapeSkin{skinA}, _gjkShapeSkin{skinB}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+float s_contact3D::distance_box_skin(glm::vec3 &ptBox, glm::vec3 &ptSkin, const s_boundbox &box, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_distance(ptBox, ptSkin, _gjkShapeBox{box}, _gjkShapeSkin{skin}, cache);
+}
+
+// ----------------------------------------------------------------------------
+
+float s_contact3D::distance_sphere_skin(glm::vec3 &ptSphere, glm::vec3 &ptSkin, const glm::vec3 &center, const float radius, const s_skinConvex &skin, s_gjkCache *cache)
+{
+  return _gjk_distance(ptSphere, ptSkin, _gjkShapeSphere{center, radius}, _gjkShapeSkin{skin}, cache);
+}
+
+// ============================================================================
+
+bool s_contact3D::raytrace_box(s_contact3D & hitInfo,
+                               const glm::vec3 & origin, const glm::vec3 & direction,
+                               const s_boundbox & box,
+                               float rayStart)
+{
+  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+
+  const glm::vec3 extend = box.extend();
+
+  const glm::vec3 vOA = box.m_min - origin;
+  const glm::vec3 vOB = box.m_max - origin;
+
+  for (unsigned iAxis = 0; iAxis < 3; ++iAxis)
+  {
+    const float     dotNormalDir = direction[iAxis]; // glm::dot(planeNormal, direction);
+    if (std::abs(dotNormalDir) < 1.e-3f) continue;
+    const float     vOAn = vOA[iAxis];
+    const float     vOBn = vOB[iAxis];
+    const bool      chooseA = dotNormalDir > 0.f;
+    const float     dist = (chooseA ? vOAn : vOBn) / dotNormalDir;
+    const glm::vec3 vCP = chooseA ? dist * direction - vOA : vOB - dist * direction; // if "B", take the opposite, so the "uv"-check still stay positive.
+
+    // TODO: make it work when inside.
+
+    unsigned condTrue = 0;
+
+    if (iAxis != 0 && 0.f <= vCP.x && vCP.x <= extend.x)
+      ++condTrue;
+    if (iAxis != 1 && 0.f <= vCP.y && vCP.y <= extend.y)
+      ++condTrue;
+    if (iAxis != 2 && 0.f <= vCP.z && vCP.z <= extend.z)
+      ++condTrue;
+
+    if (dist >= rayStart && condTrue == 2)
+    {
+      hitInfo.penet = dist;
+      hitInfo.pt = origin + hitInfo.penet * direction;
+      hitInfo.normal = glm::vec3(0.f);
+      hitInfo.normal[iAxis] = chooseA ? -1.f : 1.f;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// -----------------------------------------------------------------
+
+bool s_contact3D::raytrace_sphere(s_contact3D & hitInfo,
+                                  const glm::vec3 & origin, const glm::vec3 & direction,
+                                  const glm::vec3 & center, const float radius,
+                                  float rayStart)
+{
+  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+
+  const glm::vec3 vOC = center - origin;
+  const float     tOC = glm::dot(vOC, direction);
+  const float     tCP_Squared = tOC * tOC - glm::dot(vOC, vOC) + radius * radius;
+
+  if (tCP_Squared < 0.f)
+    return false;
+
+  const float tCP = std::sqrt(tCP_Squared);
+
+  hitInfo.penet = tOC - tCP;
+  hitInfo.pt = origin + hitInfo.penet * direction;
+  hitInfo.normal = glm::normalize(hitInfo.pt - center);
+
+  if (glm::dot(hitInfo.normal, direction) > 0.f) // inside
+  {
+    hitInfo.penet = tOC + tCP;
+    hitInfo.pt = origin + hitInfo.penet * direction;
+    hitInfo.normal = glm::normalize(center - hitInfo.pt);
+  }
+
+  TRE_ASSERT(glm::dot(hitInfo.normal, direction) <= 0.f);
+  return (hitInfo.penet >= rayStart);
+}
+
+// -----------------------------------------------------------------
+
+bool s_contact3D::raytrace_skin(s_contact3D & hitInfo,
+                                const glm::vec3 &origin, const glm::vec3 &direction,
+                                const s_skin &pts,
+                                float rayStart)
+{
+  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+  TRE_ASSERT(pts.size() % 3 == 0);
+
+  float     minDist = std::numeric_limits<float>::infinity();
+  glm::vec3 cUVT;
+
+  // loop on triangles
+  for (std::size_t iP = 0, iPstop = pts.size(); iP < iPstop; iP += 3)
+  {
+    const glm::vec3 edge01 = pts[iP + 1] - pts[iP];
+    const glm::vec3 edge02 = pts[iP + 2] - pts[iP];
+    const glm::vec3 outNormal = glm::cross(edge01, edge02);
+    if (glm::dot(outNormal, direction) > 0.f)
+      continue;
+
+    if (triangleRaytrace3D(pts[iP + 0], pts[iP + 1], pts[iP + 2], origin, direction, &cUVT))
+    {
+      if (cUVT.z >= rayStart && cUVT.z < minDist)
+      {
+        minDist = cUVT.z;
+        hitInfo.normal = glm::normalize(outNormal);
+        TRE_ASSERT(!std::isnan(hitInfo.normal.x));
+      }
+    }
+  }
+
+  hitInfo.penet = minDist;
+  hitInfo.pt = origin + hitInfo.penet * direction;
+
+  return (std::isfinite(minDist) ? true : false);
+}
+
+// -----------------------------------------------------------------
+
+bool s_contact3D::raytrace_skin(s_contact3D & hitInfo,
+                                const glm::vec3 & origin, const glm::vec3 & direction,
+                                const s_skinKdTree & skinKdT,
+                                float rayStart)
+{
+  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+
+  float minDist = std::numeric_limits<float>::infinity();
+
+  const auto fnRT = [&origin, &direction, rayStart, &minDist, &hitInfo](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+    {
+      const glm::vec3 edge01 = pt1 - pt0;
+      const glm::vec3 edge02 = pt2 - pt0;
+      const glm::vec3 outNormal = glm::cross(edge01, edge02);
+      if (glm::dot(outNormal, direction) > 0.f) return false;
+
+      glm::vec3 cUVT;
+      if (triangleRaytrace3D(pt0, pt1, pt2, origin, direction, &cUVT))
+      {
+        if (cUVT.z >= rayStart && cUVT.z < minDist)
+        {
+          minDist = cUVT.z;
+          hitInfo.normal = glm::normalize(outNormal);
+          TRE_ASSERT(!std::isnan(hitInfo.normal.x));
+          return true;
+        }
+      }
+      return false;
+    };
+
+  _skinKdTree_raytrace(skinKdT, origin, direction, rayStart, std::numeric_limits<float>::infinity(), fnRT);
+
+  hitInfo.penet = minDist;
+  hitInfo.pt = origin + hitInfo.penet * direction;
+
+  return (std::isfinite(minDist) ? true : false);
+}
+
+// -----------------------------------------------------------------
+
+bool s_contact3D::raytrace_skin(s_contact3D & hitInfo,
+                                const glm::vec3 & origin, const glm::vec3 & direction,
+                                const s_skinBvh & skinBvh,
+                                float rayStart)
+{
+  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+
+  float minDist = std::numeric_limits<float>::infinity();
+
+  const auto fnRT = [&origin, &direction, rayStart, &minDist, &hitInfo](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+    {
+      const glm::vec3 edge01 = pt1 - pt0;
+      const glm::vec3 edge02 = pt2 - pt0;
+      const glm::vec3 outNormal = glm::cross(edge01, edge02);
+      if (glm::dot(outNormal, direction) > 0.f) return false;
+
+      glm::vec3 cUVT;
+      if (triangleRaytrace3D(pt0, pt1, pt2, origin, direction, &cUVT))
+      {
+        if (cUVT.z >= rayStart && cUVT.z < minDist)
+        {
+          minDist = cUVT.z;
+          hitInfo.normal = glm::normalize(outNormal);
+          TRE_ASSERT(!std::isnan(hitInfo.normal.x));
+          return true;
+        }
+      }
+      return false;
+    };
+
+  _skinBvh_raytrace(skinBvh, origin, direction, std::max(rayStart, 0.f), minDist, fnRT); // note: the triangle hits are always in front of the ray-origin.
+
+  hitInfo.penet = minDist;
+  hitInfo.pt = origin + hitInfo.penet * direction;
+
+  return (std::isfinite(minDist) ? true : false);
+}
+
+// -----------------------------------------------------------------
+
+std::size_t s_contact3D::raytrace_skin(const span<s_contact3D> & hitInfos,
+                                       const span<glm::vec3> & origins, const span<glm::vec3> & directions,
+                                       const s_skinBvh & skinBvh,
+                                       float rayStart)
+{
+  TRE_ASSERT(hitInfos.size() == origins.size());
+  TRE_ASSERT(hitInfos.size() == directions.size());
+
+  static constexpr std::size_t kGrain = 256; // number of rays processed per task
+
+  const auto fnSignMask = [](const glm::vec3 &dir) -> unsigned { return (dir.x < 0.f ? 1u : 0u) | (dir.y < 0.f ? 2u : 0u) | (dir.z < 0.f ? 4u : 0u); };
+
+  std::atomic<std::size_t> hitCount(0);
+
+  parallelFor(hitInfos.size(), kGrain, [&](std::size_t iBegin, std::size_t iEnd)
+  {
+    std::size_t chunkHitCount = 0;
+    for (std::size_t iP = iBegin; iP < iEnd; iP += 4)
+    {
+      const std::size_t nRays = std::min<std::size_t>(4, iEnd - iP);
+
+      // the packet is used when the rays go in the same octant, otherwise the rays are traced one by one.
+      bool isCoherent = (nRays > 1);
+      for (std::size_t i = 1; i < nRays; ++i) isCoherent &= (fnSignMask(directions[iP + i]) == fnSignMask(directions[iP]));
+
+      if (!isCoherent)
+      {
+        for (std::size_t i = iP; i < iP + nRays; ++i)
+        {
+          if (raytrace_skin(hitInfos[i], origins[i], directions[i], skinBvh, rayStart)) ++chunkHitCount;
+        }
+        continue;
+      }
+
+      alignas(16) std::array<float, 4> ox, oy, oz, dx, dy, dz, tEnd;
+      for (unsigned lane = 0; lane < 4; ++lane)
+      {
+        const std::size_t i = iP + std::min<std::size_t>(lane, nRays - 1);
+        TRE_ASSERT((std::abs(glm::length(directions[i]) - 1.f)) < 1.e-6f);
+        ox[lane] = origins[i].x;
+        oy[lane] = origins[i].y;
+        oz[lane] = origins[i].z;
+        dx[lane] = directions[i].x;
+        dy[lane] = directions[i].y;
+        dz[lane] = directions[i].z;
+        tEnd[lane] = (lane < nRays) ? std::numeric_limits<float>::infinity() : -std::numeric_limits<float>::infinity();
+      }
+
+      s_skinBvh_rayPacket packet;
+      packet.ox = _mm_load_ps(ox.data());
+      packet.oy = _mm_load_ps(oy.data());
+      packet.oz = _mm_load_ps(oz.data());
+      packet.dx = _mm_load_ps(dx.data());
+      packet.dy = _mm_load_ps(dy.data());
+      packet.dz = _mm_load_ps(dz.data());
+      packet.idx = _mm_div_ps(_mm_set1_ps(1.f), packet.dx);
+      packet.idy = _mm_div_ps(_mm_set1_ps(1.f), packet.dy);
+      packet.idz = _mm_div_ps(_mm_set1_ps(1.f), packet.dz);
+      packet.tStart = _mm_set1_ps(std::max(rayStart, 0.f)); // note: the triangle hits are always in front of the ray-origin.
+      packet.tEnd = _mm_load_ps(tEnd.data());
+      packet.tMinHit = _mm_set1_ps(std::max(rayStart, 1.e-6f));
+      packet.triId.fill(0);
+
+      _skinBvh_raytrace4(skinBvh, packet);
+      _mm_store_ps(tEnd.data(), packet.tEnd);
+
+      for (unsigned lane = 0; lane < nRays; ++lane)
+      {
+        s_contact3D &hitInfo = hitInfos[iP + lane];
+        hitInfo.penet = tEnd[lane];
+        hitInfo.pt = origins[iP + lane] + hitInfo.penet * directions[iP + lane];
+        if (std::isfinite(hitInfo.penet))
+        {
+          const std::size_t iT = packet.triId[lane] * 3;
+          hitInfo.normal = glm::normalize(glm::cross(skinBvh.skin[iT + 1] - skinBvh.skin[iT], skinBvh.skin[iT + 2] - skinBvh.skin[iT]));
+          TRE_ASSERT(!std::isnan(hitInfo.normal.x));
+          ++chunkHitCount;
+        }
+      }
+    }
+    hitCount += chunkHitCount;
+  });
+
+  return hitCount;
+}
+
+// Broad-phase ================================================================
+
+static inline float _broadphase_halfArea(const glm::vec3 &bbMin, const glm::vec3 &bbMax)
+{
+  const glm::vec3 d = bbMax - bbMin;
+  return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static inline bool _broadphase_overlap(const glm::vec3 &aMin, const glm::vec3 &aMax, const glm::vec3 &bMin, const glm::vec3 &bMax)
+{
+  return aMin.x <= bMax.x && aMin.y <= bMax.y && aMin.z <= bMax.z &&
+         bMin.x <= aMax.x && bMin.y <= aMax.y && bMin.z <= aMax.z;
+}
+
+// ----------------------------------------------------------------------------
+
+uint32_t s_broadphase3D::_allocateNode()
+{
+  if (m_freeList == kNull)
+  {
+    m_nodes.emplace_back();
+    m_nodes.back().height = 0;
+    return uint32_t(m_nodes.size() - 1);
+  }
+  const uint32_t nodeId = m_freeList;
+  m_freeList = m_nodes[nodeId].parent;
+  m_nodes[nodeId] = s_node();
+  m_nodes[nodeId].height = 0;
+  return nodeId;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase3D::_freeNode(uint32_t nodeId)
+{
+  TRE_ASSERT(nodeId < m_nodes.size());
+  m_nodes[nodeId].parent = m_freeList;
+  m_nodes[nodeId].height = -1;
+  m_freeList = nodeId;
+}
+
+// ----------------------------------------------------------------------------
+
+uint32_t s_broadphase3D::insertProxy(const s_boundbox &box, uint32_t userData)
+{
+  TRE_ASSERT(box.valid());
+  const uint32_t proxyId = _allocateNode();
+  s_node &node = m_nodes[proxyId];
+  node.bbMin = box.m_min - fatMargin;
+  node.bbMax = box.m_max + fatMargin;
+  node.userData = userData;
+  _insertLeaf(proxyId);
+  ++m_proxyCount;
+  m_moved.push_back(proxyId);
+  return proxyId;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase3D::removeProxy(uint32_t proxyId)
+{
+  TRE_ASSERT(proxyId < m_nodes.size() && m_nodes[proxyId].isLeaf() && m_nodes[proxyId].height == 0);
+  _removeLeaf(proxyId);
+  _freeNode(proxyId);
+  TRE_ASSERT(m_proxyCount != 0);
+  --m_proxyCount;
+  m_moved.push_back(proxyId);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_broadphase3D::moveProxy(uint32_t proxyId, const s_boundbox &box, const glm::vec3 &displacement)
+{
+  TRE_ASSERT(proxyId < m_nodes.size() && m_nodes[proxyId].isLeaf() && m_nodes[proxyId].height == 0);
+  TRE_ASSERT(box.valid());
+  s_node &node = m_nodes[proxyId];
+
+  if (glm::all(glm::lessThanEqual(node.bbMin, box.m_min)) && glm::all(glm::lessThanEqual(box.m_max, node.bbMax)))
+    return false; // still in the fattened box
+
+  _removeLeaf(proxyId);
+
+  const glm::vec3 d = fatDisplacementFactor * displacement;
+  node.bbMin = box.m_min - fatMargin + glm::min(d, glm::vec3(0.f));
+  node.bbMax = box.m_max + fatMargin + glm::max(d, glm::vec3(0.f));
+
+  _insertLeaf(proxyId);
+  m_moved.push_back(proxyId);
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_broadphase3D::clear()
+{
+  m_nodes.clear();
+  m_root = kNull;
+  m_freeList = kNull;
+  m_proxyCount = 0;
+  m_moved.clear();
+  m_pairsCache.clear();
+}
+
+// ----------------------------------------------------------------------------
 
-  return false;
+s_boundbox s_broadphase3D::getFatBox(uint32_t proxyId) const
+{
+  TRE_ASSERT(proxyId < m_nodes.size() && m_nodes[proxyId].isLeaf());
+  return s_boundbox(m_nodes[proxyId].bbMin, m_nodes[proxyId].bbMax);
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::sphere_skin(s_contact3D &cntSphere, const glm::vec3 &center, const float radius, const s_skin &pts)
+void s_broadphase3D::_insertLeaf(uint32_t leaf)
 {
-  TRE_ASSERT(pts.size() % 3 == 0);
-
-  if (point_skin(cntSphere, center, pts))
+  if (m_root == kNull)
   {
-    cntSphere.penet = glm::length(cntSphere.pt - center) + radius;
-    cntSphere.normal = -cntSphere.normal;
-    cntSphere.pt += cntSphere.normal * cntSphere.penet * 0.5f;
-    return true;
+    m_root = leaf;
+    m_nodes[leaf].parent = kNull;
+    return;
   }
 
+  // find the best sibling (the insertion cost is the area added to the tree)
 
-  const float maxDist = 1.1f * radius;
-  float dist = maxDist;
-
-  // TODO ... (good enough approximation ?)
+  const glm::vec3 leafMin = m_nodes[leaf].bbMin;
+  const glm::vec3 leafMax = m_nodes[leaf].bbMax;
 
-  for (std::size_t iP = 0, iTstop = pts.size(); iP < iTstop; iP += 3)
+  uint32_t index = m_root;
+  while (!m_nodes[index].isLeaf())
   {
-    glm::vec3 ptOntri;
-    if (cross_tri_sphere(ptOntri, pts[iP], pts[iP + 1], pts[iP + 2], center, radius))
-    {
-      const glm::vec3 vCP = ptOntri - center;
-      const float     lCP = glm::length(vCP);
-      if (lCP < dist)
-      {
-        dist = lCP;
-        cntSphere.penet = radius - lCP;
-        if (lCP > 1.e-6f)
-          cntSphere.normal = vCP / lCP;
-        else
-          cntSphere.normal = - glm::normalize(glm::cross(pts[iP+1] - pts[iP], pts[iP+2] - pts[iP]));
-        cntSphere.pt = center + 0.5f * (radius + lCP) * cntSphere.normal;
-      }
-    }
-  }
+    const s_node &cnode = m_nodes[index];
 
-  return (dist < maxDist);
-}
-
-// ----------------------------------------------------------------------------
+    const float area = _broadphase_halfArea(cnode.bbMin, cnode.bbMax);
+    const float combinedArea = _broadphase_halfArea(glm::min(cnode.bbMin, leafMin), glm::max(cnode.bbMax, leafMax));
 
-bool s_contact3D::box_sphere(s_contact3D &cntBox, const s_boundbox &box, const glm::vec3 &center, const float radius)
-{
-  const glm::vec3 AC = center - box.m_min;
-  const glm::vec3 BC = center - box.m_max;
-  const glm::vec3 rrr = glm::vec3(radius);
+    const float costHere = 2.f * combinedArea; // cost of creating a new parent for this node and the new leaf
+    const float costInheritance = 2.f * (combinedArea - area); // minimum cost of pushing the leaf further down the tree
 
-  if (glm::any(glm::lessThan(AC, -rrr)) || glm::any(glm::greaterThan(BC, rrr)))
-    return false;
+    const auto fnCostChild = [&](uint32_t child) -> float
+    {
+      const s_node &chnode = m_nodes[child];
+      const float   newArea = _broadphase_halfArea(glm::min(chnode.bbMin, leafMin), glm::max(chnode.bbMax, leafMax));
+      return (chnode.isLeaf() ? newArea : newArea - _broadphase_halfArea(chnode.bbMin, chnode.bbMax)) + costInheritance;
+    };
+    const float cost1 = fnCostChild(cnode.child1);
+    const float cost2 = fnCostChild(cnode.child2);
 
-  // check the edges and corners ...
-  glm::vec3 PC = AC;
-  if (AC.x > -BC.x) PC.x = BC.x; // TODO : find a "glm::select(vFalse, vTrue, condition)
-  if (AC.y > -BC.y) PC.y = BC.y;
-  if (AC.z > -BC.z) PC.z = BC.z;
-  if (AC.x * BC.x < 0.f) PC.x = 0.f; // TODO : find a "glm::select(vFalse, vTrue, condition)
-  if (AC.y * BC.y < 0.f) PC.y = 0.f;
-  if (AC.z * BC.z < 0.f) PC.z = 0.f;
+    if (costHere < cost1 && costHere < cost2) break;
+    index = (cost1 < cost2) ? cnode.child1 : cnode.child2;
+  }
 
-  const float distSquared = glm::dot(PC, PC);
-  const float radiusSquared = radius * radius;
-  if (distSquared > radiusSquared)
-    return false;
+  // create a new parent
 
-  if (distSquared == 0.f) // center is inside
+  const uint32_t sibling = index;
+  const uint32_t oldParent = m_nodes[sibling].parent;
+  const uint32_t newParent = _allocateNode();
   {
-    point_box(cntBox, center, box);
-    cntBox.penet += radius;
-    cntBox.pt -= cntBox.penet * 0.5f * cntBox.normal;
+    s_node &pnode = m_nodes[newParent];
+    pnode.parent = oldParent;
+    pnode.bbMin = glm::min(leafMin, m_nodes[sibling].bbMin);
+    pnode.bbMax = glm::max(leafMax, m_nodes[sibling].bbMax);
+    pnode.height = m_nodes[sibling].height + 1;
+    pnode.child1 = sibling;
+    pnode.child2 = leaf;
+  }
+  if (oldParent != kNull)
+  {
+    if (m_nodes[oldParent].child1 == sibling) m_nodes[oldParent].child1 = newParent;
+    else                                      m_nodes[oldParent].child2 = newParent;
   }
   else
   {
-    cntBox.normal = glm::normalize(PC);
-    const float dist = sqrtf(distSquared);
-    cntBox.penet = radius - dist;
-    cntBox.pt = center - (radius + dist) * 0.5f * cntBox.normal;
+    m_root = newParent;
   }
+  m_nodes[sibling].parent = newParent;
+  m_nodes[leaf].parent = newParent;
 
-  return true;
+  // walk back up the tree, fixing the heights and the boxes
+
+  index = m_nodes[leaf].parent;
+  while (index != kNull)
+  {
+    index = _balance(index);
+    s_node &cnode = m_nodes[index];
+    const s_node &c1 = m_nodes[cnode.child1];
+    const s_node &c2 = m_nodes[cnode.child2];
+    cnode.height = 1 + std::max(c1.height, c2.height);
+    cnode.bbMin = glm::min(c1.bbMin, c2.bbMin);
+    cnode.bbMax = glm::max(c1.bbMax, c2.bbMax);
+    index = cnode.parent;
+  }
 }
 
 // ----------------------------------------------------------------------------
 
-bool s_contact3D::sphere_sphere(s_contact3D &cntSphereA, const glm::vec3 &centerA, const float radiusA, const glm::vec3 &centerB, const float radiusB)
+void s_broadphase3D::_removeLeaf(uint32_t leaf)
 {
-  const glm::vec3 vBA = centerA - centerB;
+  if (leaf == m_root)
+  {
+    m_root = kNull;
+    return;
+  }
 
-  const float distSquared = glm::dot(vBA, vBA);
-  const float radiusApB = radiusA + radiusB;
+  const uint32_t parent = m_nodes[leaf].parent;
+  const uint32_t grandParent = m_nodes[parent].parent;
+  const uint32_t sibling = (m_nodes[parent].child1 == leaf) ? m_nodes[parent].child2 : m_nodes[parent].child1;
 
-  if (distSquared > radiusApB * radiusApB)
-    return false;
+  if (grandParent == kNull)
+  {
+    m_root = sibling;
+    m_nodes[sibling].parent = kNull;
+    _freeNode(parent);
+    return;
+  }
 
-  cntSphereA.pt = (centerA / radiusA + centerB / radiusB) / (1.f/radiusA + 1.f/radiusB);
-  cntSphereA.penet = sqrtf(distSquared) - radiusApB;
-  cntSphereA.normal = glm::normalize(vBA);
+  // destroy the parent and connect the sibling to the grand-parent
+  if (m_nodes[grandParent].child1 == parent) m_nodes[grandParent].child1 = sibling;
+  else                                       m_nodes[grandParent].child2 = sibling;
+  m_nodes[sibling].parent = grandParent;
+  _freeNode(parent);
 
-  return true;
+  // adjust the ancestors
+  uint32_t index = grandParent;
+  while (index != kNull)
+  {
+    index = _balance(index);
+    s_node &cnode = m_nodes[index];
+    const s_node &c1 = m_nodes[cnode.child1];
+    const s_node &c2 = m_nodes[cnode.child2];
+    cnode.height = 1 + std::max(c1.height, c2.height);
+    cnode.bbMin = glm::min(c1.bbMin, c2.bbMin);
+    cnode.bbMax = glm::max(c1.bbMax, c2.bbMax);
+    index = cnode.parent;
+  }
 }
 
-// ============================================================================
+// ----------------------------------------------------------------------------
 
-bool s_contact3D::raytrace_box(s_contact3D & hitInfo,
-                               const glm::vec3 & origin, const glm::vec3 & direction,
-                               const s_boundbox & box,
-                               float rayStart)
+/// Perform a left or right rotation if the node A is imbalanced. Returns the new root of the sub-tree.
+uint32_t s_broadphase3D::_balance(uint32_t iA)
 {
-  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+  s_node &A = m_nodes[iA];
+  if (A.isLeaf() || A.height < 2)
+    return iA;
 
-  const glm::vec3 extend = box.extend();
+  const uint32_t iB = A.child1;
+  const uint32_t iC = A.child2;
+  s_node &B = m_nodes[iB];
+  s_node &C = m_nodes[iC];
 
-  const glm::vec3 vOA = box.m_min - origin;
-  const glm::vec3 vOB = box.m_max - origin;
+  const int32_t balance = C.height - B.height;
 
-  for (unsigned iAxis = 0; iAxis < 3; ++iAxis)
+  const auto fnRotate = [&](uint32_t iUp, uint32_t iDown)
   {
-    const float     dotNormalDir = direction[iAxis]; // glm::dot(planeNormal, direction);
-    if (std::abs(dotNormalDir) < 1.e-3f) continue;
-    const float     vOAn = vOA[iAxis];
-    const float     vOBn = vOB[iAxis];
-    const bool      chooseA = dotNormalDir > 0.f;
-    const float     dist = (chooseA ? vOAn : vOBn) / dotNormalDir;
-    const glm::vec3 vCP = chooseA ? dist * direction - vOA : vOB - dist * direction; // if "B", take the opposite, so the "uv"-check still stay positive.
-
-    // TODO: make it work when inside.
-
-    unsigned condTrue = 0;
-
-    if (iAxis != 0 && 0.f <= vCP.x && vCP.x <= extend.x)
-      ++condTrue;
-    if (iAxis != 1 && 0.f <= vCP.y && vCP.y <= extend.y)
-      ++condTrue;
-    if (iAxis != 2 && 0.f <= vCP.z && vCP.z <= extend.z)
-      ++condTrue;
-
-    if (dist >= rayStart && condTrue == 2)
+    // the node "iUp" (child of A) becomes the parent of A. "iDown" is the other child of A, that stays.
+    s_node &U = m_nodes[iUp];
+    const uint32_t iF = U.child1;
+    const uint32_t iG = U.child2;
+    s_node &F = m_nodes[iF];
+    s_node &G = m_nodes[iG];
+
+    U.child1 = iA;
+    U.parent = A.parent;
+    A.parent = iUp;
+
+    if (U.parent != kNull)
     {
-      hitInfo.penet = dist;
-      hitInfo.pt = origin + hitInfo.penet * direction;
-      hitInfo.normal = glm::vec3(0.f);
-      hitInfo.normal[iAxis] = chooseA ? -1.f : 1.f;
-      return true;
+      if (m_nodes[U.parent].child1 == iA) m_nodes[U.parent].child1 = iUp;
+      else                                m_nodes[U.parent].child2 = iUp;
+    }
+    else
+    {
+      m_root = iUp;
     }
-  }
 
-  return false;
-}
+    const s_node &D = m_nodes[iDown];
+    const bool    keepF = (F.height > G.height);
+    const uint32_t iKeep = keepF ? iF : iG; // the higher grand-child stays under U
+    const uint32_t iMove = keepF ? iG : iF; // the other grand-child goes under A
+    s_node &K = m_nodes[iKeep];
+    s_node &M = m_nodes[iMove];
 
-// -----------------------------------------------------------------
+    U.child2 = iKeep;
+    if (A.child1 == iUp) A.child1 = iMove;
+    else                 A.child2 = iMove;
+    M.parent = iA;
 
-bool s_contact3D::raytrace_sphere(s_contact3D & hitInfo,
-                                  const glm::vec3 & origin, const glm::vec3 & direction,
-                                  const glm::vec3 & center, const float radius,
-                                  float rayStart)
-{
-  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+    A.bbMin = glm::min(D.bbMin, M.bbMin);
+    A.bbMax = glm::max(D.bbMax, M.bbMax);
+    U.bbMin = glm::min(A.bbMin, K.bbMin);
+    U.bbMax = glm::max(A.bbMax, K.bbMax);
 
-  const glm::vec3 vOC = center - origin;
-  const float     tOC = glm::dot(vOC, direction);
-  const float     tCP_Squared = tOC * tOC - glm::dot(vOC, vOC) + radius * radius;
+    A.height = 1 + std::max(D.height, M.height);
+    U.height = 1 + std::max(A.height, K.height);
+  };
 
-  if (tCP_Squared < 0.f)
-    return false;
+  if (balance > 1) // rotate C up
+  {
+    fnRotate(iC, iB);
+    return iC;
+  }
+  if (balance < -1) // rotate B up
+  {
+    fnRotate(iB, iC);
+    return iB;
+  }
+  return iA;
+}
 
-  const float tCP = std::sqrt(tCP_Squared);
+// ----------------------------------------------------------------------------
 
-  hitInfo.penet = tOC - tCP;
-  hitInfo.pt = origin + hitInfo.penet * direction;
-  hitInfo.normal = glm::normalize(hitInfo.pt - center);
+void s_broadphase3D::computePairs(std::vector<std::pair<uint32_t, uint32_t>> &pairs)
+{
+  pairs.clear();
 
-  if (glm::dot(hitInfo.normal, direction) > 0.f) // inside
+  if (m_root == kNull)
   {
-    hitInfo.penet = tOC + tCP;
-    hitInfo.pt = origin + hitInfo.penet * direction;
-    hitInfo.normal = glm::normalize(center - hitInfo.pt);
+    m_pairsCache.clear();
+    m_moved.clear();
+    return;
   }
 
-  TRE_ASSERT(glm::dot(hitInfo.normal, direction) <= 0.f);
-  return (hitInfo.penet >= rayStart);
-}
+  if (m_moved.size() * 4 > m_proxyCount)
+  {
+    // many changes: simultaneous traversal of the tree with itself. A stack entry (a, a) means "pairs inside the sub-tree a".
+    m_pairsCache.clear();
 
-// -----------------------------------------------------------------
+    std::vector<std::pair<uint32_t, uint32_t>> stack;
+    stack.reserve(256);
+    stack.emplace_back(m_root, m_root);
 
-bool s_contact3D::raytrace_skin(s_contact3D & hitInfo,
-                                const glm::vec3 &origin, const glm::vec3 &direction,
-                                const s_skin &pts,
-                                float rayStart)
-{
-  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
-  TRE_ASSERT(pts.size() % 3 == 0);
+    while (!stack.empty())
+    {
+      const uint32_t iA = stack.back().first;
+      const uint32_t iB = stack.back().second;
+      stack.pop_back();
 
-  float     minDist = std::numeric_limits<float>::infinity();
-  glm::vec3 cUVT;
+      const s_node &A = m_nodes[iA];
+      if (iA == iB)
+      {
+        if (A.isLeaf()) continue;
+        stack.emplace_back(A.child1, A.child1);
+        stack.emplace_back(A.child2, A.child2);
+        stack.emplace_back(A.child1, A.child2);
+        continue;
+      }
 
-  // loop on triangles
-  for (std::size_t iP = 0, iPstop = pts.size(); iP < iPstop; iP += 3)
+      const s_node &B = m_nodes[iB];
+      if (!_broadphase_overlap(A.bbMin, A.bbMax, B.bbMin, B.bbMax)) continue;
+
+      if (A.isLeaf() && B.isLeaf())
+      {
+        m_pairsCache.emplace_back(iA, iB);
+      }
+      else if (B.isLeaf() || (!A.isLeaf() && _broadphase_halfArea(A.bbMin, A.bbMax) >= _broadphase_halfArea(B.bbMin, B.bbMax))) // descend into the larger node
+      {
+        stack.emplace_back(A.child1, iB);
+        stack.emplace_back(A.child2, iB);
+      }
+      else
+      {
+        stack.emplace_back(iA, B.child1);
+        stack.emplace_back(iA, B.child2);
+      }
+    }
+  }
+  else
   {
-    const glm::vec3 edge01 = pts[iP + 1] - pts[iP];
-    const glm::vec3 edge02 = pts[iP + 2] - pts[iP];
-    const glm::vec3 outNormal = glm::cross(edge01, edge02);
-    if (glm::dot(outNormal, direction) > 0.f)
-      continue;
+    // few changes: the pairs of the other proxies are still valid, as their fattened boxes did not change.
+    std::vector<uint8_t> isMoved(m_nodes.size(), 0);
+    for (uint32_t proxyId : m_moved) isMoved[proxyId] = 1;
 
-    if (triangleRaytrace3D(pts[iP + 0], pts[iP + 1], pts[iP + 2], origin, direction, &cUVT))
+    m_pairsCache.erase(std::remove_if(m_pairsCache.begin(), m_pairsCache.end(),
+                                      [&isMoved](const std::pair<uint32_t, uint32_t> &p) { return isMoved[p.first] != 0 || isMoved[p.second] != 0; }),
+                       m_pairsCache.end());
+
+    std::vector<uint32_t> stack;
+    stack.reserve(64);
+
+    for (uint32_t iL : m_moved)
     {
-      if (cUVT.z >= rayStart && cUVT.z < minDist)
+      if (isMoved[iL] != 1) continue; // already processed
+      isMoved[iL] = 2;
+      const s_node &L = m_nodes[iL];
+      if (L.height != 0) continue; // the proxy has been removed
+
+      stack.push_back(m_root);
+      while (!stack.empty())
       {
-        minDist = cUVT.z;
-        hitInfo.normal = glm::normalize(outNormal);
-        TRE_ASSERT(!std::isnan(hitInfo.normal.x));
+        const uint32_t iN = stack.back();
+        stack.pop_back();
+        const s_node &N = m_nodes[iN];
+        if (!_broadphase_overlap(L.bbMin, L.bbMax, N.bbMin, N.bbMax)) continue;
+        if (!N.isLeaf())
+        {
+          stack.push_back(N.child1);
+          stack.push_back(N.child2);
+        }
+        else if (iN != iL && (isMoved[iN] == 0 || iN > iL)) // when both proxies moved, the pair is reported once
+        {
+          m_pairsCache.emplace_back(iL, iN);
+        }
       }
     }
   }
 
-  hitInfo.penet = minDist;
-  hitInfo.pt = origin + hitInfo.penet * direction;
+  m_moved.clear();
 
-  return (std::isfinite(minDist) ? true : false);
+  pairs.reserve(m_pairsCache.size());
+  for (const auto &p : m_pairsCache)
+    pairs.emplace_back(m_nodes[p.first].userData, m_nodes[p.second].userData);
 }
 
-// -----------------------------------------------------------------
+// ----------------------------------------------------------------------------
 
-bool s_contact3D::raytrace_skin(s_contact3D & hitInfo,
-                                const glm::vec3 & origin, const glm::vec3 & direction,
-                                const s_skinKdTree & skinKdT,
-                                float rayStart)
+void s_broadphase3D::queryBox(std::vector<uint32_t> &listUserData, const s_boundbox &box) const
 {
-  TRE_ASSERT((std::abs(glm::length(direction) - 1.f)) < 1.e-6f);
+  listUserData.clear();
+  if (m_root == kNull) return;
 
-  float minDist = std::numeric_limits<float>::infinity();
+  std::vector<uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(m_root);
 
-  const auto fnRT = [&origin, &direction, rayStart, &minDist, &hitInfo](const glm::vec3 &pt0, const glm::vec3 &pt1, const glm::vec3 &pt2) -> bool
+  while (!stack.empty())
+  {
+    const s_node &cnode = m_nodes[stack.back()];
+    stack.pop_back();
+    if (!_broadphase_overlap(cnode.bbMin, cnode.bbMax, box.m_min, box.m_max)) continue;
+    if (cnode.isLeaf())
     {
-      const glm::vec3 edge01 = pt1 - pt0;
-      const glm::vec3 edge02 = pt2 - pt0;
-      const glm::vec3 outNormal = glm::cross(edge01, edge02);
-      if (glm::dot(outNormal, direction) > 0.f) return false;
+      listUserData.push_back(cnode.userData);
+    }
+    else
+    {
+      stack.push_back(cnode.child1);
+      stack.push_back(cnode.child2);
+    }
+  }
+}
 
-      glm::vec3 cUVT;
-      if (triangleRaytrace3D(pt0, pt1, pt2, origin, direction, &cUVT))
-      {
-        if (cUVT.z >= rayStart && cUVT.z < minDist)
-        {
-          minDist = cUVT.z;
-          hitInfo.normal = glm::normalize(outNormal);
-          TRE_ASSERT(!std::isnan(hitInfo.normal.x));
-          return true;
-        }
-      }
-      return false;
-    };
+// ----------------------------------------------------------------------------
 
-  _skinKdTree_raytrace(skinKdT, origin, direction, rayStart, std::numeric_limits<float>::infinity(), fnRT);
+void s_broadphase3D::queryRay(std::vector<uint32_t> &listUserData, const glm::vec3 &origin, const glm::vec3 &direction, float rayEnd) const
+{
+  listUserData.clear();
+  if (m_root == kNull) return;
 
-  hitInfo.penet = minDist;
-  hitInfo.pt = origin + hitInfo.penet * direction;
+  const glm::vec3 invDir = 1.f / direction;
 
-  return (std::isfinite(minDist) ? true : false);
+  std::vector<uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(m_root);
+
+  while (!stack.empty())
+  {
+    const s_node &cnode = m_nodes[stack.back()];
+    stack.pop_back();
+
+    const glm::vec3 t0 = (cnode.bbMin - origin) * invDir;
+    const glm::vec3 t1 = (cnode.bbMax - origin) * invDir;
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar = glm::max(t0, t1);
+    const float     tEnter = std::max(std::max(std::max(tNear.x, tNear.y), tNear.z), 0.f);
+    const float     tExit = std::min(std::min(std::min(tFar.x, tFar.y), tFar.z), rayEnd);
+    if (tEnter > tExit) continue;
+
+    if (cnode.isLeaf())
+    {
+      listUserData.push_back(cnode.userData);
+    }
+    else
+    {
+      stack.push_back(cnode.child1);
+      stack.push_back(cnode.child2);
+    }
+  }
 }
 
+// ============================================================================
+
 } // namespace
@@ -595,44 +595,18 @@ void font::_packTextures(const std::vector<s_fontCache> &caches, SDL_Surface *&p
   TRE_ASSERT(!caches.empty());
   TRE_ASSERT(packedTexture == nullptr);
 
-  // sort still needed ?
-  /*
-  std::vector<unsigned> fontsizesPixelOrdered = fontsizesPixel;
-  sortAndUniqueBull(fontsizesPixelOrdered);
-  // reverse
-  for (unsigned i = 0, iStop = fontsizesPixelOrdered.size(); i < iStop / 2; ++i)
-    std::swap(fontsizesPixelOrdered[i], fontsizesPixelOrdered[iStop - 1 - i]);
-  */
-
   // compute textures coords
 
-  coords.resize(caches.size()); // {x,y,w,h}
-
-  glm::ivec2 posBlock = glm::ivec2(0);
-  glm::ivec2 coordMax = glm::ivec2(0);
-
+  std::vector<glm::ivec2> sizes(caches.size());
   for (std::size_t it = 0, itStop = caches.size(); it < itStop; ++it)
-  {
-    const glm::ivec2 sizetexture = glm::ivec2(caches[it].m_surface->w, caches[it].m_surface->h);
+    sizes[it] = glm::ivec2(caches[it].m_surface->w, caches[it].m_surface->h);
 
-    if (posBlock.x + sizetexture.x > coordMax.x)
-    {
-      posBlock.x = 0;
-      posBlock.y = coordMax.y;
-    }
-
-    coords[it] = glm::ivec4(posBlock, sizetexture);
-
-    const unsigned extendedWidth = (sizetexture.x & ~0x000F) + 0x0010;
-    const glm::ivec2 sizeBlock = glm::ivec2(extendedWidth, sizetexture.y);
-
-    if (coordMax.x < posBlock.x + sizetexture.x) coordMax.x = posBlock.x + sizeBlock.x;
-    if (coordMax.y < posBlock.y + sizetexture.y) coordMax.y = posBlock.y + sizeBlock.y;
-
-    posBlock.x += sizetexture.x;
-  }
+  textureAtlas atlas;
+  const bool   packSuccess = atlas.resetFit(sizes, coords); // {x,y,w,h}
+  TRE_ASSERT(packSuccess);
+  (void)packSuccess;
 
-  packedTexture = SDL_CreateRGBSurface(0, coordMax.x, coordMax.y, 32, 0, 0, 0, 0);
+  packedTexture = SDL_CreateRGBSurface(0, atlas.w(), atlas.usedHeight(), 32, 0, 0, 0, 0); // cropped to the used rows
   TRE_ASSERT(packedTexture != nullptr);
 
   for (std::size_t it = 0, istop = caches.size(); it < istop; ++it)
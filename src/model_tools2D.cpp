@@ -13,6 +13,20 @@
 
 namespace tre {
 
+/// Point-index with its position along a space-filling curve
+struct s_pointCurveKey
+{
+  unsigned key;
+  unsigned index;
+};
+
+namespace details {
+template<> struct sortRadixKey<s_pointCurveKey>
+{
+  static inline unsigned key(const s_pointCurveKey &v) { return v.key; }
+};
+}
+
 namespace modelTools {
 
 // ============================================================================
@@ -216,266 +230,490 @@ void computeConvexeEnvelop2D_XY(const s_modelDataLayout &layout, const s_partInf
 
 // ============================================================================
 
-static float areaSigned(const glm::vec2 &ptA, const glm::vec2 &ptB, const glm::vec2 &ptC)
+/// Orientation of the triangle (a,b,c): 2 times its signed area (in double precision, the walk and the flips must be consistent).
+static double _orient2D(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c)
 {
-  const glm::vec2 vAB = ptB - ptA;
-  const glm::vec2 vAC = ptC - ptA;
-  return 0.5f * (vAB.x * vAC.y - vAB.y * vAC.x);
+  return (double(b.x) - double(a.x)) * (double(c.y) - double(a.y)) - (double(b.y) - double(a.y)) * (double(c.x) - double(a.x));
 }
 
 // ----------------------------------------------------------------------------
 
-struct s_triangle
+/// Positive when "d" is strictly inside the circumcircle of the counter-clockwise triangle (a,b,c).
+static double _inCircle2D(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c, const glm::vec2 &d)
 {
-  const glm::vec2 *ptA, *ptB, *ptC;
-  s_triangle *adjAB, *adjBC, *adjCA;
-  long flag; // user-flag
+  const glm::dvec2 vDA = glm::dvec2(a) - glm::dvec2(d);
+  const glm::dvec2 vDB = glm::dvec2(b) - glm::dvec2(d);
+  const glm::dvec2 vDC = glm::dvec2(c) - glm::dvec2(d);
+  const double     lDA = glm::dot(vDA, vDA);
+  const double     lDB = glm::dot(vDB, vDB);
+  const double     lDC = glm::dot(vDC, vDC);
+  return lDA * (vDB.x * vDC.y - vDB.y * vDC.x) +
+         lDB * (vDC.x * vDA.y - vDC.y * vDA.x) +
+         lDC * (vDA.x * vDB.y - vDA.y * vDB.x);
+}
 
-  s_triangle()
-    : ptA(nullptr), ptB(nullptr), ptC(nullptr), adjAB(nullptr), adjBC(nullptr), adjCA(nullptr), flag(0) {}
-  s_triangle(const glm::vec2 *A, const glm::vec2 *B, const glm::vec2 *C, s_triangle *tab, s_triangle *tbc, s_triangle *tca)
-    : ptA(A), ptB(B), ptC(C), adjAB(tab), adjBC(tbc), adjCA(tca), flag(0) {}
+// ----------------------------------------------------------------------------
 
-  bool valid()  const
+/// Index along a 2D Hilbert curve, from coordinates on 16 bits (branchless: the quadrant's rotation is done with masks)
+static unsigned _hilbertIndex2D(unsigned x, unsigned y)
+{
+  unsigned index = 0;
+  for (unsigned b = 16; b-- != 0; )
   {
-    TRE_ASSERT(ptA != ptB || (ptA == nullptr && ptB == nullptr));
-    TRE_ASSERT(ptA != ptC || (ptA == nullptr && ptC == nullptr));
-    TRE_ASSERT(ptB != ptC || (ptB == nullptr && ptC == nullptr));
-    const float as = (ptA != nullptr) ? areaSigned(*ptA, *ptB, *ptC) : 1.f;
-    return (ptA != nullptr) && (as > 0.f);
+    const unsigned rx = (x >> b) & 1;
+    const unsigned ry = (y >> b) & 1;
+    index |= ((3 * rx) ^ ry) << (2 * b);
+    const unsigned maskFlip = (ry - 1) & (0u - rx); // (ry == 0 && rx == 1)
+    x ^= maskFlip;
+    y ^= maskFlip;
+    const unsigned tSwap = (x ^ y) & (ry - 1); // (ry == 0)
+    x ^= tSwap;
+    y ^= tSwap;
   }
+  return index;
+}
+
+// ----------------------------------------------------------------------------
 
-  bool hasPoint(const glm::vec2 *pt) const
+/// Sort the points in a "Biased Randomized Insertion Order": the points are shuffled and split in rounds of doubling size
+/// (the last round has half of the points), then each round is sorted along a Hilbert curve.
+static void _sortBRIO(const std::vector<glm::vec2> &inPos, const glm::vec2 &boxMin, const glm::vec2 &boxMax, std::vector<unsigned> &outIndices)
+{
+  static constexpr std::size_t kRoundMinSize = 64;
+
+  const glm::vec2 scale = 65535.f / glm::max(boxMax - boxMin, glm::vec2(std::numeric_limits<float>::min()));
+
+  std::vector<s_pointCurveKey> keys(inPos.size());
+  for (std::size_t i = 0; i < inPos.size(); ++i)
   {
-    return (ptA == pt || ptB == pt || ptC == pt);
+    const glm::vec2 coord = glm::clamp((inPos[i] - boxMin) * scale, glm::vec2(0.f), glm::vec2(65535.f));
+    keys[i].key = _hilbertIndex2D(unsigned(coord.x), unsigned(coord.y));
+    keys[i].index = unsigned(i);
   }
 
-  bool pointInside(const glm::vec2 &pt, const float minArea) const
+  // shuffle (deterministic)
+  uint32_t randState = 0x2545F491u;
+  for (std::size_t i = keys.size(); i-- > 1; )
   {
-    const bool b1 = areaSigned(*ptA, *ptB, pt) >= -minArea;
-    const bool b2 = areaSigned(*ptB, *ptC, pt) >= -minArea;
-    const bool b3 = areaSigned(*ptC, *ptA, pt) >= -minArea;
-    return (b1 && b2 && b3);
+    randState ^= randState << 13;
+    randState ^= randState >> 17;
+    randState ^= randState << 5;
+    std::swap(keys[i], keys[randState % (i + 1)]);
   }
 
-  bool pointInCircumcircle(const glm::vec2 &pt) const
+  // sort the rounds
+  std::size_t roundEnd = keys.size();
+  while (roundEnd != 0)
   {
-    const glm::vec2 vPA = *ptA - pt;
-    const glm::vec2 vPB = *ptB - pt;
-    const glm::vec2 vPC = *ptC - pt;
-    const float     lPA = glm::dot(vPA, vPA);
-    const float     lPB = glm::dot(vPB, vPB);
-    const float     lPC = glm::dot(vPC, vPC);
-    const float det = lPC * (vPA.x * vPB.y - vPA.y * vPB.x) +
-                      lPB * (vPC.x * vPA.y - vPC.y * vPA.x) +
-                      lPA * (vPB.x * vPC.y - vPB.y * vPC.x);
-    return det >= 0.f;
+    const std::size_t roundStart = (roundEnd > kRoundMinSize) ? roundEnd / 2 : 0;
+    sortRadix(tre::span<s_pointCurveKey>(keys, roundStart, roundEnd - roundStart));
+    roundEnd = roundStart;
   }
 
-  bool crossLine(const glm::vec2 *e1, const glm::vec2 *e2) const
-  {
-    const glm::vec2 v12 = *e2 - *e1;
-    const glm::vec2 t12 = glm::vec2(-v12.y, v12.x);
+  outIndices.resize(keys.size());
+  for (std::size_t i = 0; i < keys.size(); ++i) outIndices[i] = keys[i].index;
+}
 
-    if (e1 != ptA && e1 != ptB && e2 != ptA && e2 != ptB)
-    {
-      const glm::vec2 vAB = *ptB - *ptA;
-      const glm::vec2 tAB = glm::vec2(-vAB.y, vAB.x);
-      const glm::vec2 vA1 = *e1 - *ptA;
-      const glm::vec2 param = glm::vec2(glm::dot(vA1, t12), glm::dot(vA1, tAB)) / glm::dot(vAB, t12);
-      if (param.x > 0.f && param.x < 1.f && param.y > 0.f && param.y < 1.f) // note: false if param == NaN
-        return true;
-    }
+// ----------------------------------------------------------------------------
 
-    if (e1 != ptA && e1 != ptC && e2 != ptA && e2 != ptC)
-    {
-      const glm::vec2 vAC = *ptC - *ptA;
-      const glm::vec2 tAC = glm::vec2(-vAC.y, vAC.x);
-      const glm::vec2 vA1 = *e1 - *ptA;
-      const glm::vec2 param = glm::vec2(glm::dot(vA1, t12), glm::dot(vA1, tAC)) / glm::dot(vAC, t12);
-      if (param.x > 0.f && param.x < 1.f && param.y > 0.f && param.y < 1.f) // note: false if param == NaN
-        return true;
-    }
+static inline unsigned _next3(const unsigned i) { return (i == 2) ? 0 : i + 1; }
+static inline unsigned _prev3(const unsigned i) { return (i == 0) ? 2 : i - 1; }
 
-    if (e1 != ptB && e1 != ptC && e2 != ptB && e2 != ptC)
-    {
-      const glm::vec2 vBC = *ptC - *ptB;
-      const glm::vec2 tBC = glm::vec2(-vBC.y, vBC.x);
-      const glm::vec2 vB1 = *e1 - *ptB;
-      const glm::vec2 param = glm::vec2(glm::dot(vB1, t12), glm::dot(vB1, tBC)) / glm::dot(vBC, t12);
-      if (param.x > 0.f && param.x < 1.f && param.y > 0.f && param.y < 1.f) // note: false if param == NaN
-        return true;
+/// Counter-clockwise triangle. The edge "i" is (v[i], v[i+1]), it is shared with the triangle adj[i].
+struct s_triangle
+{
+  static constexpr unsigned kNone = ~0u;
+
+  unsigned v[3];
+  unsigned adj[3];
+  uint8_t  constrained; ///< bit "i": the edge "i" is constrained
+  uint8_t  leftSide;    ///< bit "i": the triangle is on the left-side of the constrained edge "i"
+
+  s_triangle() = default;
+  s_triangle(unsigned A, unsigned B, unsigned C, unsigned tab, unsigned tbc, unsigned tca, uint8_t cflags = 0, uint8_t lflags = 0)
+    : v{A, B, C}, adj{tab, tbc, tca}, constrained(cflags), leftSide(lflags) {}
+
+  unsigned edgeTo(const unsigned iTri) const { TRE_ASSERT(adj[0] == iTri || adj[1] == iTri || adj[2] == iTri); return (adj[0] == iTri) ? 0 : (adj[1] == iTri) ? 1 : 2; }
+  unsigned vertexSlot(const unsigned iV) const { TRE_ASSERT(v[0] == iV || v[1] == iV || v[2] == iV); return (v[0] == iV) ? 0 : (v[1] == iV) ? 1 : 2; }
+  uint8_t  constrainedBit(const unsigned i) const { return (constrained >> i) & 1; }
+  uint8_t  leftSideBit(const unsigned i) const { return (leftSide >> i) & 1; }
+};
+
+// ----------------------------------------------------------------------------
+
+/// Constrained Delaunay triangulation.
+/// The points are inserted in a box (its 4 corners are appended to the points), the triangles are allocated in an arena and
+/// linked by index. The triangles are never deleted: the insertions split them and the flips re-use them.
+struct s_triangulation
+{
+  enum e_location { LOC_INSIDE, LOC_EDGE, LOC_VERTEX, LOC_FAILED };
+
+  std::vector<glm::vec2>  pos;
+  std::vector<s_triangle> listTri;
+  std::vector<unsigned>   vertexToTri; ///< a triangle that contains the vertex
+  std::vector<std::pair<unsigned, unsigned>> stackFlip; ///< (triangle, edge) to legalize
+  std::size_t             nPoints = 0;
+
+  /// The vertices are numbered in the insertion order (the close points have close indices).
+  void init(const std::vector<glm::vec2> &points, const std::vector<unsigned> &insertOrder, const glm::vec2 &boxMin, const glm::vec2 &boxMax)
+  {
+    nPoints = points.size();
+    pos.resize(nPoints + 4);
+    for (std::size_t i = 0; i < nPoints; ++i) pos[i] = points[insertOrder[i]];
+    const unsigned iBox = unsigned(nPoints);
+    pos[iBox + 0] = glm::vec2(boxMin.x, boxMin.y);
+    pos[iBox + 1] = glm::vec2(boxMax.x, boxMin.y);
+    pos[iBox + 2] = glm::vec2(boxMax.x, boxMax.y);
+    pos[iBox + 3] = glm::vec2(boxMin.x, boxMax.y);
+
+    listTri.clear();
+    listTri.reserve(2 * nPoints + 2);
+    listTri.emplace_back(iBox + 0, iBox + 1, iBox + 2, s_triangle::kNone, s_triangle::kNone, 1);
+    listTri.emplace_back(iBox + 2, iBox + 3, iBox + 0, s_triangle::kNone, s_triangle::kNone, 0);
+
+    vertexToTri.assign(nPoints + 4, s_triangle::kNone);
+    vertexToTri[iBox + 0] = 0;
+    vertexToTri[iBox + 1] = 0;
+    vertexToTri[iBox + 2] = 0;
+    vertexToTri[iBox + 3] = 1;
+  }
+
+  void replaceNeighbor(const unsigned iTri, const unsigned oldTri, const unsigned newTri)
+  {
+    if (iTri != s_triangle::kNone) listTri[iTri].adj[listTri[iTri].edgeTo(oldTri)] = newTri;
+  }
+
+  /// Walk from "iTri" to the triangle that contains "pt" (visibility walk, the edge to cross is picked randomly to avoid cycles).
+  /// On an edge, "iSlot" is the edge's index. On a vertex, "iSlot" is the vertex's slot.
+  e_location locate(const glm::vec2 &pt, unsigned &iTri, unsigned &iSlot, unsigned &randState, const std::size_t maxSteps) const
+  {
+    for (std::size_t iStep = 0; iStep < maxSteps; ++iStep)
+    {
+      const s_triangle &t = listTri[iTri];
+      randState = randState * 1664525u + 1013904223u;
+      const unsigned iEdgeStart = (randState >> 30) % 3;
+      double         orient[3];
+      bool           isInside = true;
+      for (unsigned k = 0; k < 3; ++k)
+      {
+        const unsigned iEdge = (iEdgeStart + k) % 3;
+        orient[iEdge] = _orient2D(pos[t.v[iEdge]], pos[t.v[_next3(iEdge)]], pt);
+        if (orient[iEdge] < 0.) // "pt" is behind the edge
+        {
+          if (t.adj[iEdge] == s_triangle::kNone) return LOC_FAILED;
+          iTri = t.adj[iEdge];
+          isInside = false;
+          break;
+        }
+      }
+      if (!isInside) continue;
+      const unsigned nZero = (orient[0] == 0.) + (orient[1] == 0.) + (orient[2] == 0.);
+      if (nZero == 0) return LOC_INSIDE;
+      if (nZero == 1)
+      {
+        iSlot = (orient[0] == 0.) ? 0 : (orient[1] == 0.) ? 1 : 2;
+        return LOC_EDGE;
+      }
+      iSlot = (orient[0] != 0.) ? 2 : (orient[1] != 0.) ? 0 : 1; // vertex shared by the 2 edges
+      return LOC_VERTEX;
     }
+    return LOC_FAILED;
+  }
 
-    return false;
+  /// Split the triangle (a,b,c) into (a,b,p), (b,c,p), (c,a,p).
+  void insertInTriangle(const unsigned iTri, const unsigned p)
+  {
+    const s_triangle  t = listTri[iTri];
+    const unsigned    iN1 = unsigned(listTri.size());
+    const unsigned    iN2 = iN1 + 1;
+    listTri[iTri] = s_triangle(t.v[0], t.v[1], p, t.adj[0], iN1, iN2, t.constrainedBit(0), t.leftSideBit(0));
+    listTri.emplace_back(t.v[1], t.v[2], p, t.adj[1], iN2, iTri, t.constrainedBit(1), t.leftSideBit(1));
+    listTri.emplace_back(t.v[2], t.v[0], p, t.adj[2], iTri, iN1, t.constrainedBit(2), t.leftSideBit(2));
+    replaceNeighbor(t.adj[1], iTri, iN1);
+    replaceNeighbor(t.adj[2], iTri, iN2);
+    vertexToTri[t.v[2]] = iN1;
+    vertexToTri[p] = iTri;
+    stackFlip.emplace_back(iTri, 0);
+    stackFlip.emplace_back(iN1, 0);
+    stackFlip.emplace_back(iN2, 0);
   }
 
-  void clear()
+  /// Split the edge (a,b) of the triangles (a,b,c) and (b,a,d) into (c,a,p), (b,c,p), (a,d,p), (d,b,p).
+  void insertOnEdge(const unsigned iTri, const unsigned iEdge, const unsigned p)
   {
-    ptA = ptB = ptC = nullptr;
-    if (adjAB != nullptr) adjAB->replaceNeigborTri(this, nullptr);
-    if (adjBC != nullptr) adjBC->replaceNeigborTri(this, nullptr);
-    if (adjCA != nullptr) adjCA->replaceNeigborTri(this, nullptr);
-    adjAB = adjBC = adjCA = nullptr;
+    const s_triangle t = listTri[iTri];
+    const unsigned   iU = t.adj[iEdge];
+    TRE_ASSERT(iU != s_triangle::kNone);
+    TRE_ASSERT(t.constrainedBit(iEdge) == 0);
+    const s_triangle u = listTri[iU];
+    const unsigned   jEdge = u.edgeTo(iTri);
+    const unsigned   iE1 = _next3(iEdge), iE2 = _prev3(iEdge);
+    const unsigned   jE1 = _next3(jEdge), jE2 = _prev3(jEdge);
+    const unsigned   a = t.v[iEdge], b = t.v[iE1], c = t.v[iE2], d = u.v[jE2];
+    const unsigned   iN1 = unsigned(listTri.size());
+    const unsigned   iN2 = iN1 + 1;
+    listTri[iTri] = s_triangle(c, a, p, t.adj[iE2], iU, iN1, t.constrainedBit(iE2), t.leftSideBit(iE2));
+    listTri[iU] = s_triangle(a, d, p, u.adj[jE1], iN2, iTri, u.constrainedBit(jE1), u.leftSideBit(jE1));
+    listTri.emplace_back(b, c, p, t.adj[iE1], iTri, iN2, t.constrainedBit(iE1), t.leftSideBit(iE1));
+    listTri.emplace_back(d, b, p, u.adj[jE2], iN1, iU, u.constrainedBit(jE2), u.leftSideBit(jE2));
+    replaceNeighbor(t.adj[iE1], iTri, iN1);
+    replaceNeighbor(u.adj[jE2], iU, iN2);
+    vertexToTri[b] = iN1;
+    vertexToTri[p] = iTri;
+    stackFlip.emplace_back(iTri, 0);
+    stackFlip.emplace_back(iN1, 0);
+    stackFlip.emplace_back(iU, 0);
+    stackFlip.emplace_back(iN2, 0);
   }
 
-  void replaceNeigborTri(s_triangle *oldtri, s_triangle *newtri)
+  /// Flip the edge (p0,p1) of the triangles (p0,p1,p2) and (p1,p0,q).
+  /// The triangle "iTri" becomes (p2,p0,q) and its neighbor becomes (q,p1,p2): the new edge is the edge 2 of "iTri".
+  void flip(const unsigned iTri, const unsigned iEdge)
   {
-    if (adjAB == oldtri) adjAB = newtri;
-    if (adjBC == oldtri) adjBC = newtri;
-    if (adjCA == oldtri) adjCA = newtri;
+    const s_triangle t = listTri[iTri];
+    const unsigned   iU = t.adj[iEdge];
+    const s_triangle u = listTri[iU];
+    const unsigned   jEdge = u.edgeTo(iTri);
+    const unsigned   iE1 = _next3(iEdge), iE2 = _prev3(iEdge);
+    const unsigned   jE1 = _next3(jEdge), jE2 = _prev3(jEdge);
+    const unsigned   p0 = t.v[iEdge], p1 = t.v[iE1], p2 = t.v[iE2], q = u.v[jE2];
+    listTri[iTri] = s_triangle(p2, p0, q, t.adj[iE2], u.adj[jE1], iU,
+                               uint8_t(t.constrainedBit(iE2) | (u.constrainedBit(jE1) << 1)), uint8_t(t.leftSideBit(iE2) | (u.leftSideBit(jE1) << 1)));
+    listTri[iU] = s_triangle(q, p1, p2, u.adj[jE2], t.adj[iE1], iTri,
+                             uint8_t(u.constrainedBit(jE2) | (t.constrainedBit(iE1) << 1)), uint8_t(u.leftSideBit(jE2) | (t.leftSideBit(iE1) << 1)));
+    replaceNeighbor(u.adj[jE1], iU, iTri);
+    replaceNeighbor(t.adj[iE1], iTri, iU);
+    vertexToTri[p0] = iTri;
+    vertexToTri[p1] = iU;
   }
 
-  static void swapEdge(s_triangle &tri1, s_triangle &tri2)
+  /// Restore the Delaunay property by flipping the edges of "stackFlip" (Lawson's algorithm)
+  void legalize()
   {
-    TRE_ASSERT(tri1.valid());
-    TRE_ASSERT(tri2.valid());
-    const glm::vec2 *ptSide1, *ptEdge1;
-    const glm::vec2 *ptEdge2, *ptSide2;
-    s_triangle *tri1_e1, *tri1_e2;
-    s_triangle *tri2_e1, *tri2_e2;
-    // fill
-    if (!tri2.hasPoint(tri1.ptA)) // tri1: edge is B-C
-    {
-      TRE_ASSERT(tri2.hasPoint(tri1.ptB));
-      TRE_ASSERT(tri2.hasPoint(tri1.ptC));
-      ptSide1 = tri1.ptA; ptEdge1 = tri1.ptB; ptEdge2 = tri1.ptC;
-      tri1_e1 = tri1.adjCA; tri1_e2 = tri1.adjAB;
-    }
-    else if (tri2.hasPoint(tri1.ptB)) // tri1: edge is A-B
-    {
-      TRE_ASSERT(!tri2.hasPoint(tri1.ptC));
-      ptSide1 = tri1.ptC; ptEdge1 = tri1.ptA; ptEdge2 = tri1.ptB;
-      tri1_e1 = tri1.adjBC; tri1_e2 = tri1.adjCA;
+    while (!stackFlip.empty())
+    {
+      const unsigned iTri = stackFlip.back().first;
+      const unsigned iEdge = stackFlip.back().second;
+      stackFlip.pop_back();
+      const s_triangle &t = listTri[iTri];
+      const unsigned    iU = t.adj[iEdge];
+      if (iU == s_triangle::kNone || t.constrainedBit(iEdge) != 0) continue;
+      const s_triangle &u = listTri[iU];
+      const unsigned    q = u.v[_prev3(u.edgeTo(iTri))];
+      if (_inCircle2D(pos[t.v[0]], pos[t.v[1]], pos[t.v[2]], pos[q]) <= 0.) continue;
+      flip(iTri, iEdge);
+      stackFlip.emplace_back(iTri, 1);
+      stackFlip.emplace_back(iU, 0);
     }
-    else
-    {
-      TRE_ASSERT(tri2.hasPoint(tri1.ptC)); //tri1: edge is C-A
-      ptSide1 = tri1.ptB; ptEdge1 = tri1.ptC; ptEdge2 = tri1.ptA;
-      tri1_e1 = tri1.adjAB; tri1_e2 = tri1.adjBC;
-    }
-    if (!tri1.hasPoint(tri2.ptA)) // tri2: edge is B-C
-    {
-      TRE_ASSERT(tri1.hasPoint(tri2.ptB));
-      TRE_ASSERT(tri1.hasPoint(tri2.ptC));
-      ptSide2 = tri2.ptA;
-      TRE_ASSERT(ptEdge2 == tri2.ptB);
-      TRE_ASSERT(ptEdge1 == tri2.ptC);
-      tri2_e2 = tri2.adjCA;
-      tri2_e1 = tri2.adjAB;
-    }
-    else if (tri1.hasPoint(tri2.ptB)) // tri2: edge is A-B
+  }
+
+  /// Find the triangle that has the oriented edge (p,q), by turning around "p".
+  /// (the fan of a box's corner is open: it is walked in both directions)
+  bool findEdge(const unsigned p, const unsigned q, unsigned &iTri, unsigned &iEdge) const
+  {
+    const unsigned iStart = vertexToTri[p];
+    for (unsigned iDir = 0; iDir < 2; ++iDir)
     {
-      TRE_ASSERT(!tri1.hasPoint(tri2.ptC));
-      ptSide2 = tri2.ptC;
-      TRE_ASSERT(ptEdge2 == tri2.ptA);
-      TRE_ASSERT(ptEdge1 == tri2.ptB);
-      tri2_e2 = tri2.adjBC;
-      tri2_e1 = tri2.adjCA;
+      unsigned iCurr = iStart;
+      do
+      {
+        const s_triangle &t = listTri[iCurr];
+        const unsigned    i = t.vertexSlot(p);
+        if (t.v[_next3(i)] == q)
+        {
+          iTri = iCurr;
+          iEdge = i;
+          return true;
+        }
+        iCurr = (iDir == 0) ? t.adj[_prev3(i)] : t.adj[i];
+      } while (iCurr != iStart && iCurr != s_triangle::kNone);
+      if (iCurr == iStart) break;
     }
-    else
+    return false;
+  }
+
+  /// Mark the edge "iEdge" of "iTri" as constrained. The triangle "iTri" is on the left-side.
+  void markConstrained(const unsigned iTri, const unsigned iEdge)
+  {
+    s_triangle &t = listTri[iTri];
+    t.constrained |= uint8_t(1u << iEdge);
+    t.leftSide |= uint8_t(1u << iEdge);
+    if (t.adj[iEdge] != s_triangle::kNone)
     {
-      TRE_ASSERT(tri1.hasPoint(tri2.ptC)); //tri2: edge is C-A
-      ptSide2 = tri2.ptB;
-      TRE_ASSERT(ptEdge2 == tri2.ptC);
-      TRE_ASSERT(ptEdge1 == tri2.ptA);
-      tri2_e2 = tri2.adjAB;
-      tri2_e1 = tri2.adjBC;
+      s_triangle &u = listTri[t.adj[iEdge]];
+      u.constrained |= uint8_t(1u << u.edgeTo(iTri));
     }
-    // make the 2 new triangles
-    tri1.ptA = ptSide1; tri1.adjBC = tri2_e2;
-    tri1.ptB = ptEdge1; tri1.adjCA = &tri2;
-    tri1.ptC = ptSide2; tri1.adjAB = tri1_e2;
-    tri2.ptA = ptSide2; tri2.adjBC = tri1_e1;
-    tri2.ptB = ptEdge2; tri2.adjCA = &tri1;
-    tri2.ptC = ptSide1; tri2.adjAB = tri2_e1;
-    // patch neighbour triangles
-    if (tri1_e1 != nullptr) tri1_e1->replaceNeigborTri(&tri1, &tri2);
-    if (tri2_e2 != nullptr) tri1_e2->replaceNeigborTri(&tri2, &tri1);
-    // end
-    TRE_ASSERT(tri1.valid());
-    TRE_ASSERT(tri2.valid());
   }
-};
-
-// ----------------------------------------------------------------------------
 
-static bool _checkInsertionValidity(const std::vector<s_triangle *> &listTetra, s_triangle &tAdd, const glm::vec2 &pt, const float minArea)
-{
-  // Check only surfaces that would be exterior if the tetrahedron is added.
-
-  // get exterior surfaces
-  s_triangle *tadjAB = tAdd.adjAB;
-  s_triangle *tadjBC = tAdd.adjBC;
-  s_triangle *tadjCA = tAdd.adjCA;
-  for (s_triangle *tbis : listTetra)
+  /// Force the edge (a,b) in the triangulation (Sloan's algorithm: the edges that cross (a,b) are flipped, then the Delaunay property is restored).
+  /// The edge is split on the vertices lying on it. It returns false if the edge crosses an other constrained edge.
+  bool insertConstraint(unsigned a, const unsigned b, std::vector<std::pair<unsigned, unsigned>> &listCrossing, std::vector<std::pair<unsigned, unsigned>> &listNewEdges)
   {
-    if      (tbis == tadjAB) tadjAB = nullptr;
-    else if (tbis == tadjBC) tadjBC = nullptr;
-    else if (tbis == tadjCA) tadjCA = nullptr;
-  }
+    while (a != b)
+    {
+      unsigned iTri, iEdge;
+      if (findEdge(a, b, iTri, iEdge))
+      {
+        markConstrained(iTri, iEdge);
+        return true;
+      }
 
-  // check edge AB
-  if (tadjAB != nullptr && areaSigned(*tAdd.ptA, *tAdd.ptB, pt) < minArea)
-      return false;
+      // -> turn around "a" to find the first crossed edge (or a vertex on the segment)
+      const glm::dvec2 vAB = glm::dvec2(pos[b]) - glm::dvec2(pos[a]);
+      const unsigned   iStart = vertexToTri[a];
+      unsigned         iCurr = iStart;
+      unsigned         iEdgeCrossed = s_triangle::kNone;
+      unsigned         vOnSegment = s_triangle::kNone;
+      do
+      {
+        const s_triangle &t = listTri[iCurr];
+        const unsigned    i = t.vertexSlot(a);
+        const unsigned    v1 = t.v[_next3(i)], v2 = t.v[_prev3(i)];
+        const double      o1 = _orient2D(pos[a], pos[b], pos[v1]);
+        const double      o2 = _orient2D(pos[a], pos[b], pos[v2]);
+        if (o1 == 0. && glm::dot(glm::dvec2(pos[v1]) - glm::dvec2(pos[a]), vAB) > 0.)
+        {
+          markConstrained(iCurr, i);
+          vOnSegment = v1;
+          break;
+        }
+        if (o1 < 0. && o2 > 0.)
+        {
+          iEdgeCrossed = _next3(i);
+          break;
+        }
+        iCurr = t.adj[_prev3(i)];
+      } while (iCurr != iStart && iCurr != s_triangle::kNone);
 
-  // check edge BC
-  if (tadjBC != nullptr && areaSigned(*tAdd.ptB, *tAdd.ptC, pt) < minArea)
-      return false;
+      if (vOnSegment != s_triangle::kNone)
+      {
+        a = vOnSegment;
+        continue;
+      }
+      if (iEdgeCrossed == s_triangle::kNone) return false;
 
-  // check edge CA
-  if (tadjCA != nullptr && areaSigned(*tAdd.ptC, *tAdd.ptA, pt) < minArea)
-      return false;
+      // -> walk along the segment, collect the crossed edges, stop at "b" or at a vertex on the segment
+      listCrossing.clear();
+      unsigned vEnd = b;
+      while (true)
+      {
+        const s_triangle &t = listTri[iCurr];
+        if (t.constrainedBit(iEdgeCrossed) != 0) return false;
+        const unsigned    vR = t.v[iEdgeCrossed], vL = t.v[_next3(iEdgeCrossed)];
+        listCrossing.emplace_back(vR, vL);
+        const unsigned    iU = t.adj[iEdgeCrossed];
+        const s_triangle &u = listTri[iU];
+        const unsigned    jEdge = u.edgeTo(iCurr);
+        const unsigned    w = u.v[_prev3(jEdge)];
+        if (w == b) break;
+        const double      ow = _orient2D(pos[a], pos[b], pos[w]);
+        if (ow == 0.)
+        {
+          vEnd = w;
+          break;
+        }
+        iCurr = iU;
+        iEdgeCrossed = (ow < 0.) ? _prev3(jEdge) : _next3(jEdge); // (w,vL) or (vR,w)
+      }
 
-  return true;
-}
+      // -> flip the crossed edges, until none remains
+      listNewEdges.clear();
+      const auto fnCrossSegment = [&](unsigned v1, unsigned v2)
+      {
+        if (v1 == a || v1 == vEnd || v2 == a || v2 == vEnd) return false;
+        const double o1 = _orient2D(pos[a], pos[vEnd], pos[v1]);
+        const double o2 = _orient2D(pos[a], pos[vEnd], pos[v2]);
+        return (o1 < 0. && o2 > 0.) || (o1 > 0. && o2 < 0.);
+      };
+      while (!listCrossing.empty())
+      {
+        std::size_t iKeep = 0;
+        for (const auto &edge : listCrossing)
+        {
+          unsigned iT, iE;
+          const bool found = findEdge(edge.first, edge.second, iT, iE);
+          TRE_ASSERT(found);
+          if (!found) return false;
+          const s_triangle &t = listTri[iT];
+          const s_triangle &u = listTri[t.adj[iE]];
+          const unsigned    p2 = t.v[_prev3(iE)];
+          const unsigned    q = u.v[_prev3(u.edgeTo(iT))];
+          if (_orient2D(pos[p2], pos[edge.first], pos[q]) > 0. && _orient2D(pos[q], pos[edge.second], pos[p2]) > 0.) // convex quad
+          {
+            flip(iT, iE);
+            if (fnCrossSegment(p2, q)) listCrossing[iKeep++] = std::make_pair(q, p2);
+            else                       listNewEdges.emplace_back(q, p2);
+          }
+          else
+          {
+            listCrossing[iKeep++] = edge;
+          }
+        }
+        if (iKeep == listCrossing.size()) return false; // no progress (degenerated geometry)
+        listCrossing.resize(iKeep);
+      }
 
-// ----------------------------------------------------------------------------
+      const bool found = findEdge(a, vEnd, iTri, iEdge);
+      TRE_ASSERT(found);
+      if (!found) return false;
+      markConstrained(iTri, iEdge);
 
-struct s_edge
-{
-  const glm::vec2 *pt1, *pt2;
-  s_triangle *tri12, *tri21;
+      // -> restore the Delaunay property of the new edges
+      static constexpr unsigned kMaxPass = 64;
+      bool hasFlip = true;
+      for (unsigned iPass = 0; hasFlip && iPass < kMaxPass; ++iPass)
+      {
+        hasFlip = false;
+        for (auto &edge : listNewEdges)
+        {
+          unsigned iT, iE;
+          if (!findEdge(edge.first, edge.second, iT, iE)) continue;
+          const s_triangle &t = listTri[iT];
+          if (t.constrainedBit(iE) != 0) continue;
+          const s_triangle &u = listTri[t.adj[iE]];
+          const unsigned    q = u.v[_prev3(u.edgeTo(iT))];
+          if (_inCircle2D(pos[t.v[0]], pos[t.v[1]], pos[t.v[2]], pos[q]) <= 0.) continue;
+          const unsigned    p2 = t.v[_prev3(iE)];
+          flip(iT, iE);
+          edge = std::make_pair(q, p2);
+          hasFlip = true;
+        }
+      }
 
-  s_edge(const glm::vec2 *p1, const glm::vec2 *p2, s_triangle *t12, s_triangle *t21)
-    : pt1(p1), pt2(p2), tri12(t12), tri21(t21) {}
+      a = vEnd;
+    }
+    return true;
+  }
 
-  static bool genContour(const std::vector<s_triangle*> &listTri, std::vector<s_edge> &listEdge)
+  /// Flag the exterior triangles: the ones on the right-side of a constrained edge, or that have a corner of the box, then the flag is
+  /// propagated through the non-constrained edges. The other triangles (on the left-side of the constrained edges) are interior.
+  void classify(std::vector<uint8_t> &listExterior) const
   {
-    listEdge.clear();
-    // find edges
-    for (s_triangle *t : listTri)
+    listExterior.assign(listTri.size(), 0);
+    std::vector<unsigned> stack;
+    for (unsigned iT = 0; iT < listTri.size(); ++iT)
     {
-      bool isEdge_AB = true;
-      bool isEdge_BC = true;
-      bool isEdge_CA = true;
-      s_triangle *tAB = t->adjAB;
-      s_triangle *tBC = t->adjBC;
-      s_triangle *tCA = t->adjCA;
-      for (const s_triangle *tt : listTri)
+      const s_triangle &t = listTri[iT];
+      if (t.leftSide != 0) continue;
+      if (t.constrained != 0 || t.v[0] >= nPoints || t.v[1] >= nPoints || t.v[2] >= nPoints)
       {
-        if (tAB == tt) isEdge_AB = false;
-        if (tBC == tt) isEdge_BC = false;
-        if (tCA == tt) isEdge_CA = false;
+        listExterior[iT] = 1;
+        stack.push_back(iT);
       }
-      if (isEdge_AB) listEdge.push_back(s_edge(t->ptA, t->ptB, t, tAB));
-      if (isEdge_BC) listEdge.push_back(s_edge(t->ptB, t->ptC, t, tBC));
-      if (isEdge_CA) listEdge.push_back(s_edge(t->ptC, t->ptA, t, tCA));
     }
-    // sort edges
-    const std::size_t nEdge = listEdge.size();
-    for (std::size_t iE = 1; iE < nEdge; ++iE)
+    while (!stack.empty())
     {
-      const glm::vec2 *lastPt = listEdge[iE - 1].pt2;
-      std::size_t jE = iE;
-      for (; jE < nEdge; ++jE)
+      const unsigned    iT = stack.back();
+      stack.pop_back();
+      const s_triangle &t = listTri[iT];
+      for (unsigned i = 0; i < 3; ++i)
       {
-        if (lastPt == listEdge[jE].pt1) break;
+        const unsigned iU = t.adj[i];
+        if (iU == s_triangle::kNone || t.constrainedBit(i) != 0 || listExterior[iU] != 0 || listTri[iU].leftSide != 0) continue;
+        listExterior[iU] = 1;
+        stack.push_back(iU);
       }
-      if (jE == nEdge) return false; // failed
-      if (jE != iE) std::swap(listEdge[iE], listEdge[jE]);
     }
-    return true;
   }
 };
 
@@ -492,17 +730,6 @@ struct s_triangulateExporter
   s_triangulateExporter(const std::string &filename) { rawOBJ.open(filename.c_str(), std::ofstream::out); if (rawOBJ.is_open()) rawOBJ << "# WAVEFRONT data - export skin" << std::endl; }
   ~s_triangulateExporter() { rawOBJ.close(); }
 
-  void writePoint(const glm::vec2 &pt)
-  {
-    rawOBJ << "v " << pt.x         << ' ' <<  pt.y - 0.02f << ' ' << 0.f << std::endl;
-    rawOBJ << "v " << pt.x         << ' ' <<  pt.y + 0.02f << ' ' << 0.f << std::endl;
-    rawOBJ << "v " << pt.x - 0.02f << ' ' <<  pt.y         << ' ' << 0.f << std::endl;
-    rawOBJ << "v " << pt.x + 0.02f << ' ' <<  pt.y         << ' ' << 0.f << std::endl;
-    rawOBJ << "f " << offsetVert + 0 << ' ' << offsetVert + 2 << ' ' << offsetVert + 1 << ' ' << std::endl;
-    rawOBJ << "f " << offsetVert + 1 << ' ' << offsetVert + 3 << ' ' << offsetVert + 0 << ' ' << std::endl;
-    offsetVert += 4;
-  }
-
   void writeLine(const glm::vec2 &ptA, const glm::vec2 &ptB)
   {
     rawOBJ << "v " << ptA.x << ' ' <<  ptA.y << ' ' << 0.f - 0.02f << std::endl;
@@ -523,36 +750,20 @@ struct s_triangulateExporter
     offsetVert += 3;
   }
 
-  void report_rawTriangulation(const std::vector<glm::vec2> &envelop, const std::vector<s_triangle> &listTrangles)
+  void report_rawTriangulation(const s_triangulation &cdt)
   {
     if (!rawOBJ.is_open()) return;
-    rawOBJ << "o Step_" << osprinti3(iter) << "_0InEnvelop" << std::endl;
-    for (std::size_t i = 0; i < envelop.size(); ++i)
-    {
-      writePoint(envelop[i]);
-      writeLine(envelop[i], envelop[(i + 1) % envelop.size()]);
-    }
-    for (std::size_t iT = 0; iT < listTrangles.size(); ++iT)
-    {
-      const s_triangle &t = listTrangles[iT];
-      if (t.valid())
-      {
-        rawOBJ << "o Step_" << osprinti3(iter) << "_Triangle" << osprinti3(iT) << std::endl;
-        writeTriangle(*t.ptA, *t.ptB, *t.ptC);
-      }
-    }
+    rawOBJ << "o Step_" << osprinti3(iter) << "_Triangles" << std::endl;
+    for (const s_triangle &t : cdt.listTri)
+      writeTriangle(cdt.pos[t.v[0]], cdt.pos[t.v[1]], cdt.pos[t.v[2]]);
     ++iter;
   }
 
-  void report_edgeFlip(const std::vector<s_triangle*> localTriangles, const glm::vec2 *ptEdge0, const glm::vec2 *ptEdge1, const char *msg)
+  void report_constraintFailure(const s_triangulation &cdt, const unsigned a, const unsigned b)
   {
     if (!rawOBJ.is_open()) return;
-    rawOBJ << "o Step_" << osprinti3(iter) << "_" << msg << std::endl;
-    for (const auto tptr : localTriangles)
-    {
-      writeTriangle(*tptr->ptA, *tptr->ptB, *tptr->ptC);
-    }
-    writeLine(*ptEdge0, *ptEdge1);
+    rawOBJ << "o Step_" << osprinti3(iter) << "_FAILED_Constraint" << std::endl;
+    writeLine(cdt.pos[a], cdt.pos[b]);
     ++iter;
   }
 };
@@ -563,8 +774,8 @@ struct s_triangulateExporter
 {
   s_triangulateExporter(const char *) {}
 
-  void report_rawTriangulation(const std::vector<glm::vec2> &, const std::vector<s_triangle> &) {}
-  void report_edgeFlip(const std::vector<s_triangle*>, const glm::vec2 *, const glm::vec2 *, const char *) {}
+  void report_rawTriangulation(const s_triangulation &) {}
+  void report_constraintFailure(const s_triangulation &, const unsigned, const unsigned) {}
 };
 
 #endif // MESH_DEBUG
@@ -572,18 +783,37 @@ struct s_triangulateExporter
 // ----------------------------------------------------------------------------
 
 void triangulate(const std::vector<glm::vec2> &envelop, std::vector<unsigned> &listTriangles)
+{
+  const std::size_t Npts = envelop.size();
+
+  std::vector<unsigned> constrainedEdges(Npts * 2);
+  for (std::size_t i = 0; i < Npts; ++i)
+  {
+    constrainedEdges[2 * i + 0] = unsigned(i);
+    constrainedEdges[2 * i + 1] = unsigned(i + 1 == Npts ? 0 : i + 1);
+  }
+
+  triangulate(envelop, constrainedEdges, listTriangles);
+}
+
+// ----------------------------------------------------------------------------
+
+void triangulate(const std::vector<glm::vec2> &points, const std::vector<unsigned> &constrainedEdges, std::vector<unsigned> &listTriangles)
 {
   listTriangles.clear();
 
-  if (envelop.size() < 3) return;
+  if (points.size() < 3) return;
 
-  const std::size_t Npts = envelop.size();
+  TRE_ASSERT(constrainedEdges.size() % 2 == 0);
+  TRE_ASSERT(points.size() < s_triangle::kNone / 4);
+
+  const std::size_t Npts = points.size();
 
   // compute b-box
 
-  glm::vec2 boxMin = envelop[0];
-  glm::vec2 boxMax = envelop[0];
-  for (const glm::vec2 &pt : envelop)
+  glm::vec2 boxMin = points[0];
+  glm::vec2 boxMax = points[0];
+  for (const glm::vec2 &pt : points)
   {
     boxMin = glm::min(boxMin, pt);
     boxMax = glm::max(boxMax, pt);
@@ -593,319 +823,164 @@ void triangulate(const std::vector<glm::vec2> &envelop, std::vector<unsigned> &l
   const float     boxArea = boxExtend.x * boxExtend.y;
   if (boxArea == 0.f) return;
 
-  const float triMinArea = boxArea * 1.e-6f;
+  // generate the "master"-quad (2 triangles), with a margin. The points are inserted in a spatially coherent order.
 
-  boxMin -= boxExtend * 0.05f;;
-  boxMax += boxExtend * 0.05f;;
+  std::vector<unsigned> insertOrder;
+  _sortBRIO(points, boxMin, boxMax, insertOrder);
 
-  // generate the "master"-quad (2 triangles)
-
-  const glm::vec2 boxAA = boxMin;
-  const glm::vec2 boxAB = glm::vec2(boxMin.x, boxMax.y);
-  const glm::vec2 boxBA = glm::vec2(boxMax.x, boxMin.y);
-  const glm::vec2 boxBB = boxMax;
-
-  const std::size_t  listTriSizeMax = (Npts + 4) * 2;
-  std::vector<s_triangle> listTri(listTriSizeMax); // warning: don't resize because data must not be re-located
-  std::size_t    listTriSize = 0;
-
-  listTri[0] = s_triangle(&boxAA, &boxBA, &boxBB, nullptr, nullptr, &listTri[1]);
-  listTri[1] = s_triangle(&boxBB, &boxAB, &boxAA, nullptr, nullptr, &listTri[0]);
-  listTriSize = 2;
+  s_triangulation cdt;
+  cdt.init(points, insertOrder, boxMin - boxExtend, boxMax + boxExtend);
 
   s_triangulateExporter exporter("triangulate.obj");
 
-  // process (Delaunay triangulation - Bowyer-Watson algorithm) without edge-constrain
+  // process (Delaunay triangulation - incremental insertion with flips) without edge-constrain
 
-  std::vector<s_triangle*> listTriToProcess;
-  listTriToProcess.reserve(16);
+  std::vector<unsigned> remap(Npts); // duplicated points are merged
+  std::size_t           nDuplicated = 0;
+  unsigned              iTriLast = 0;
+  unsigned              randState = 0x2545F491u;
 
-  for (std::size_t iP = 0; iP < Npts; ++iP)
+  for (unsigned iP = 0; iP < Npts; ++iP)
   {
-    const glm::vec2 *pt = &envelop[iP];
-
-    // -> get list of triangles that will be removed
-    listTriToProcess.clear();
+    const glm::vec2  &pt = cdt.pos[iP];
+    unsigned          iTri = iTriLast;
+    unsigned          iSlot = 0;
+    s_triangulation::e_location loc = cdt.locate(pt, iTri, iSlot, randState, cdt.listTri.size());
+    if (loc == s_triangulation::LOC_FAILED) // (should not happen) fall back to a linear scan
     {
-      // --> find the triangle(s) that contains the point (the point can be on the edge)
-      for (std::size_t i = 0; i < listTriSize; ++i)
+      for (unsigned iT = 0; iT < cdt.listTri.size() && loc == s_triangulation::LOC_FAILED; ++iT)
       {
-        s_triangle &t = listTri[i];
-        TRE_ASSERT(t.valid());
-        if (t.pointInside(*pt, triMinArea)) { listTriToProcess.push_back(&t); }
-      }
-      if (listTriToProcess.size() >= 3)
-      {
-        TRE_LOG("triangulate: a point belongs to more than 3 triangles, results may be wrong."); // TODO: implement the "index"-remapper to consider duplicated points.
-      }
-      // --> add other triangles by checking for neighbors recursively
-      std::size_t queueStart = 0;
-      std::size_t queueEnd = listTriToProcess.size();
-      while (queueStart < queueEnd)
-      {
-        for (std::size_t i = queueStart; i < queueEnd; ++i)
-        {
-          s_triangle &t = *listTriToProcess[i];
-          s_triangle *tadjAB = t.adjAB;
-          s_triangle *tadjBC = t.adjBC;
-          s_triangle *tadjCA = t.adjCA;
-          for (s_triangle *tbis : listTriToProcess)
-          {
-            if      (tbis == tadjAB) tadjAB = nullptr;
-            else if (tbis == tadjBC) tadjBC = nullptr;
-            else if (tbis == tadjCA) tadjCA = nullptr;
-          }
-          if (tadjAB != nullptr && tadjAB->pointInCircumcircle(*pt) && _checkInsertionValidity(listTriToProcess, *tadjAB, *pt, triMinArea))
-            listTriToProcess.push_back(tadjAB);
-          if (tadjBC != nullptr && tadjBC->pointInCircumcircle(*pt) && _checkInsertionValidity(listTriToProcess, *tadjBC, *pt, triMinArea))
-            listTriToProcess.push_back(tadjBC);
-          if (tadjCA != nullptr && tadjCA->pointInCircumcircle(*pt) && _checkInsertionValidity(listTriToProcess, *tadjCA, *pt, triMinArea))
-            listTriToProcess.push_back(tadjCA);
-        }
-        queueStart = queueEnd;
-        queueEnd = listTriToProcess.size();
+        iTri = iT;
+        loc = cdt.locate(pt, iTri, iSlot, randState, 1);
       }
     }
-    TRE_ASSERT(!listTriToProcess.empty());
-
-    // -> generate the contour
-    std::vector<s_edge> listEdge;
-    s_edge::genContour(listTriToProcess, listEdge);
 
-    // -> compute pointers in which new triangles will be created
-    const std::size_t nEdge = listEdge.size();
-    std::vector<s_triangle*> listTriNew(nEdge, nullptr);
+    switch (loc)
     {
-      std::size_t iTnew = 0;
-      for (std::size_t stop = glm::min(nEdge, listTriToProcess.size()); iTnew < stop; ++iTnew)
-        listTriNew[iTnew] = listTriToProcess[iTnew];
-      for (; iTnew < nEdge; ++iTnew)
-      {
-        listTriNew[iTnew] = &listTri[listTriSize++];
-        TRE_ASSERT(listTriSize <= listTriSizeMax);
-      }
-    }
-
-    // -> generate new triangles
-    TRE_ASSERT(listEdge.size() == listTriNew.size());
-    for (std::size_t iE = 0; iE < nEdge; ++iE)
-    {
-      const s_edge &edge = listEdge[iE];
-      s_triangle *prevTri = iE == 0         ? listTriNew.back()  : listTriNew[iE - 1];
-      s_triangle *nextTri = iE == nEdge - 1 ? listTriNew.front() : listTriNew[iE + 1];
-      *listTriNew[iE] = s_triangle(pt, edge.pt1, edge.pt2, prevTri, edge.tri21, nextTri);
-      if (edge.tri21 != nullptr) edge.tri21->replaceNeigborTri(edge.tri12, listTriNew[iE]);
-      TRE_ASSERT(listTriNew[iE]->valid());
+      case s_triangulation::LOC_INSIDE: cdt.insertInTriangle(iTri, iP); break;
+      case s_triangulation::LOC_EDGE:   cdt.insertOnEdge(iTri, iSlot, iP); break;
+      case s_triangulation::LOC_VERTEX: remap[iP] = cdt.listTri[iTri].v[iSlot]; ++nDuplicated; iTriLast = iTri; continue;
+      default:                          TRE_FATAL("not reached");
     }
+    remap[iP] = iP;
+    cdt.legalize();
+    iTriLast = cdt.vertexToTri[iP];
   }
 
-  exporter.report_rawTriangulation(envelop, listTri);
+  if (nDuplicated != 0)
+  {
+    TRE_LOG("triangulate: " << nDuplicated << " duplicated point(s) merged.");
+  }
 
-  // apply the edge-constrain: swap edges to enforce there is existing edge in the triangulation for each envelop's segment
+  exporter.report_rawTriangulation(cdt);
 
-  std::vector<bool> envelopEdgeFound(Npts, false);
+  // apply the edge-constrain. Without constrain, the convex hull of the points is used (monotone chain).
 
-  for (std::size_t iT = 0; iT < listTriSize; ++iT)
+  std::vector<unsigned> listEdges; // (with the internal indices)
+  if (!constrainedEdges.empty())
   {
-    s_triangle &t = listTri[iT];
-    TRE_ASSERT(t.valid());
-    const unsigned iA = unsigned(t.ptA - envelop.data());
-    const unsigned iB = unsigned(t.ptB - envelop.data());
-    const unsigned iC = unsigned(t.ptC - envelop.data());
-
-#define testEdge(i1, i2) \
-    if (i1 < Npts && i2 < Npts) \
-    { \
-      const unsigned iMin = (i1 < i2) ? i1 : i2; \
-      const unsigned iMax = (i1 < i2) ? i2 : i1; \
-      if (iMin + 1 == iMax) \
-        envelopEdgeFound[iMin] = true; \
-      else if (iMin == 0 && iMax == Npts - 1) \
-        envelopEdgeFound[Npts - 1] = true; \
+    std::vector<unsigned> rank(Npts);
+    for (unsigned iP = 0; iP < Npts; ++iP) rank[insertOrder[iP]] = iP;
+    listEdges.resize(constrainedEdges.size());
+    for (std::size_t iE = 0; iE < constrainedEdges.size(); ++iE)
+    {
+      TRE_ASSERT(constrainedEdges[iE] < Npts);
+      listEdges[iE] = remap[rank[constrainedEdges[iE]]];
     }
-
-    testEdge(iA, iB);
-    testEdge(iA, iC);
-    testEdge(iB, iC);
-
-#undef testEdge
   }
-
-  for (std::size_t iE = 0; iE < Npts; ++iE)
+  else
   {
-    if (envelopEdgeFound[iE]) continue;
-
-    const glm::vec2 *ptM = &envelop[iE];
-    const glm::vec2 *ptN = &envelop[iE == Npts -1 ? 0 : iE + 1];
-
-    // edge (ptM, ptN) does not exist in the triangulation.
-    std::vector<s_triangle*> listTriToProcess;
-    for (std::size_t iT = 0; iT < listTriSize; ++iT)
+    // -> discard the points inside the polygon formed by the extreme points along 8 directions (Akl-Toussaint heuristic)
+    static constexpr double kDirs[8][2] = { {0., -1.}, {1., -1.}, {1., 0.}, {1., 1.}, {0., 1.}, {-1., 1.}, {-1., 0.}, {-1., -1.} }; // (counter-clockwise)
+    unsigned extremes[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    for (unsigned iP = 1; iP < Npts; ++iP)
     {
-      s_triangle &t = listTri[iT];
-      if (t.crossLine(ptM, ptN)) listTriToProcess.push_back(&t);
+      const glm::vec2  &pt = cdt.pos[iP];
+      for (unsigned k = 0; k < 8; ++k)
+      {
+        const glm::vec2  &ptExt = cdt.pos[extremes[k]];
+        if (kDirs[k][0] * (double(pt.x) - double(ptExt.x)) + kDirs[k][1] * (double(pt.y) - double(ptExt.y)) > 0.) extremes[k] = iP;
+      }
     }
-    // like in previous step, generate a new triangulation of the area 'listTriToProcess'
-    if (listTriToProcess.size() <= 1)
+    std::vector<unsigned> polygon;
+    for (unsigned k = 0; k < 8; ++k)
     {
-      exporter.report_edgeFlip(listTriToProcess, ptM, ptN, "FAILED_NoEnoughTriangle");
-      continue; // degenerated geometry. Ignore the missing edge :(
+      if (polygon.empty() || (extremes[k] != polygon.back() && extremes[k] != polygon.front())) polygon.push_back(extremes[k]);
     }
-    if (listTriToProcess.size() == 2)
+    const auto fnInsidePolygon = [&](const glm::vec2 &pt)
     {
-      // quick-process
-      s_triangle::swapEdge(*listTriToProcess[0], *listTriToProcess[1]);
-      TRE_ASSERT(listTriToProcess[0]->valid());
-      TRE_ASSERT(listTriToProcess[1]->valid());
-      continue;
-    }
-    // -> generate the contour
-    std::vector<s_edge> listEdge;
-    if (!s_edge::genContour(listTriToProcess, listEdge))
+      if (polygon.size() < 3) return false;
+      for (std::size_t k = 0; k < polygon.size(); ++k)
+      {
+        if (_orient2D(cdt.pos[polygon[k]], cdt.pos[polygon[(k + 1) % polygon.size()]], pt) <= 0.) return false;
+      }
+      return true;
+    };
+    std::vector<unsigned> sorted;
+    for (unsigned iP = 0; iP < Npts; ++iP)
     {
-      exporter.report_edgeFlip(listTriToProcess, ptM, ptN, "FAILED_BadContour");
-      continue; // ignoring ...
+      if (remap[iP] == iP && !fnInsidePolygon(cdt.pos[iP])) sorted.push_back(iP);
     }
-    TRE_ASSERT(listEdge.size() >= 5);
+    std::sort(sorted.begin(), sorted.end(), [&cdt](unsigned i, unsigned j) { return (cdt.pos[i].x != cdt.pos[j].x) ? cdt.pos[i].x < cdt.pos[j].x : cdt.pos[i].y < cdt.pos[j].y; });
 
-    // -> process edge per edge
-    while (true)
+    // -> monotone chain
+    std::vector<unsigned> hull(2 * sorted.size());
+    std::size_t           hullSize = 0;
+    for (std::size_t i = 0; i < sorted.size(); ++i) // lower hull
     {
-      // select the candidate
-      const std::size_t nEdges = listEdge.size();
-      std::size_t iEdge = 0;
-      std::size_t iEdgeP1 = 1;
-      for (; iEdge < nEdges; ++iEdge)
-      {
-        iEdgeP1 = (iEdge == nEdges -1) ? 0 : iEdge + 1;
-        if (listEdge[iEdge].pt2 == ptM || listEdge[iEdge].pt2 == ptN)
-          continue;
-        const glm::vec2 v00 = *listEdge[iEdge  ].pt2 - *listEdge[iEdge].pt1;
-        const glm::vec2 v02 = *listEdge[iEdgeP1].pt2 - *listEdge[iEdge].pt1;
-        const float     spin = v00.x * v02.y - v00.y * v02.x;
-        if (spin > 0.f)
-          break; // got a candidate
-      }
-      TRE_ASSERT(iEdge != nEdges);
-      // generate the triangle
-      s_triangle *triNew = nullptr;
-      if (listTriToProcess.empty())
-      {
-        triNew = &listTri[listTriSize++]; // "allocate" a new triangle
-        TRE_ASSERT(listTriSize <= listTriSizeMax);
-      }
-      else
-      {
-        triNew = listTriToProcess.back();
-        listTriToProcess.pop_back();
-      }
-      s_triangle *triInvalid = reinterpret_cast<s_triangle*>(nEdges * (nEdges + 1) / 2 + iEdge);
-      s_edge &e1 = listEdge[iEdge];
-      s_edge &e2 = listEdge[iEdgeP1];
-
-      triNew->ptA   = e1.pt1;
-      triNew->ptB   = e1.pt2;
-      triNew->ptC   = e2.pt2;
-      triNew->adjAB = e1.tri21;
-      triNew->adjBC = e2.tri21;
-      triNew->adjCA = triInvalid;
-
-      if (e1.tri21 != nullptr)
-        e1.tri21->replaceNeigborTri(e1.tri12, triNew);
-      if (e2.tri21 != nullptr)
-        e2.tri21->replaceNeigborTri(e2.tri12, triNew);
-
-      TRE_ASSERT(triNew->valid());
-
-      e1.pt2   = e2.pt2;
-      e1.tri12 = triInvalid;
-      e1.tri21 = triNew;
-
-      listEdge.erase(listEdge.begin() + iEdgeP1);
-
-      if (listEdge.size() == 2)
-      {
-        listEdge[0].tri21->replaceNeigborTri(listEdge[0].tri12, triNew);
-        listEdge[1].tri21->replaceNeigborTri(listEdge[1].tri12, triNew);
-        break;
-      }
+      while (hullSize >= 2 && _orient2D(cdt.pos[hull[hullSize - 2]], cdt.pos[hull[hullSize - 1]], cdt.pos[sorted[i]]) <= 0.) --hullSize;
+      hull[hullSize++] = sorted[i];
     }
-    TRE_ASSERT(listTriToProcess.empty());
-  }
-
-  // clean exterior triangles
-
-  // -> walk triangles : mark the direct interior triangle and clear the direct exterior triangle
-  for (std::size_t iT = 0; iT < listTriSize; ++iT)
-  {
-    s_triangle &t = listTri[iT];
-    TRE_ASSERT(t.valid());
-    const unsigned iA = unsigned(t.ptA - envelop.data());
-    const unsigned iB = unsigned(t.ptB - envelop.data());
-    const unsigned iC = unsigned(t.ptC - envelop.data());
-
-#define testEdge(iL, iR) \
-    if (iL < Npts && iR < Npts) \
-    { \
-      if (iL + 1 == iR || (iL == Npts - 1 && iR == 0)) \
-        t.flag = 1; \
-      else if (iR + 1 == iL || (iR == Npts - 1 && iL == 0)) \
-        t.clear(); \
-    } \
-    else \
-    { \
-      t.clear(); \
+    for (std::size_t i = sorted.size() - 1, lowerSize = hullSize + 1; i-- > 0; ) // upper hull
+    {
+      while (hullSize >= lowerSize && _orient2D(cdt.pos[hull[hullSize - 2]], cdt.pos[hull[hullSize - 1]], cdt.pos[sorted[i]]) <= 0.) --hullSize;
+      hull[hullSize++] = sorted[i];
+    }
+    for (std::size_t i = 0; i + 1 < hullSize; ++i) // (the last point is the first one)
+    {
+      listEdges.push_back(hull[i]);
+      listEdges.push_back(hull[i + 1]);
     }
-
-    testEdge(iA, iB);
-    testEdge(iB, iC);
-    testEdge(iC, iA);
-
-#undef testEdge
   }
 
-  // -> colorize recursively interior triangles
-  bool hasNewTriangle = true;
-  while (hasNewTriangle)
+  std::vector<std::pair<unsigned, unsigned>> listCrossing, listNewEdges;
+  std::size_t nFailed = 0;
+  for (std::size_t iE = 0; iE + 1 < listEdges.size(); iE += 2)
   {
-    hasNewTriangle = false;
-    for (std::size_t iT = 0; iT < listTriSize; ++iT)
+    const unsigned a = listEdges[iE];
+    const unsigned b = listEdges[iE + 1];
+    if (a == b) continue;
+    if (!cdt.insertConstraint(a, b, listCrossing, listNewEdges))
     {
-       s_triangle &t = listTri[iT];
-      if (!t.valid() || t.flag != 1)
-        continue;
-      if (t.adjAB != nullptr && t.adjAB->flag != 1) { hasNewTriangle = true; t.adjAB->flag = 1; }
-      if (t.adjBC != nullptr && t.adjBC->flag != 1) { hasNewTriangle = true; t.adjBC->flag = 1; }
-      if (t.adjCA != nullptr && t.adjCA->flag != 1) { hasNewTriangle = true; t.adjCA->flag = 1; }
+      exporter.report_constraintFailure(cdt, a, b);
+      ++nFailed;
     }
   }
 
-  // -> delete (un-colorized) exterior triangles
-  for (std::size_t iT = 0; iT < listTriSize; ++iT)
+  if (nFailed != 0)
   {
-    s_triangle &t = listTri[iT];
-    if (t.valid() && t.flag != 1)
-      t.clear();
+    TRE_LOG("triangulate: " << nFailed << " constrained edge(s) cannot be enforced (intersecting or degenerated edges), results may be wrong.");
   }
 
-  // compute output triangle-list
+  // clean exterior triangles
 
-  listTriangles.reserve(listTriSize * 3);
-  for (std::size_t iT = 0; iT < listTriSize; ++iT)
-  {
-    s_triangle &t = listTri[iT];
-    if (t.valid())
-    {
-      TRE_ASSERT(unsigned(t.ptA - envelop.data()) < listTriSize);
-      TRE_ASSERT(unsigned(t.ptB - envelop.data()) < listTriSize);
-      TRE_ASSERT(unsigned(t.ptC - envelop.data()) < listTriSize);
+  std::vector<uint8_t> listExterior;
+  cdt.classify(listExterior);
 
-      listTriangles.push_back(unsigned(t.ptA - envelop.data()));
-      listTriangles.push_back(unsigned(t.ptB - envelop.data()));
-      listTriangles.push_back(unsigned(t.ptC - envelop.data()));
-    }
+  // compute output triangle-list (with the input indices)
+
+  std::size_t nInterior = 0;
+  for (const uint8_t exterior : listExterior) nInterior += (exterior == 0);
+
+  listTriangles.reserve(nInterior * 3);
+  for (std::size_t iT = 0; iT < cdt.listTri.size(); ++iT)
+  {
+    const s_triangle &t = cdt.listTri[iT];
+    if (listExterior[iT] != 0 || t.v[0] >= Npts || t.v[1] >= Npts || t.v[2] >= Npts) continue;
+    listTriangles.push_back(insertOrder[t.v[0]]);
+    listTriangles.push_back(insertOrder[t.v[1]]);
+    listTriangles.push_back(insertOrder[t.v[2]]);
   }
-  listTriangles.shrink_to_fit();
 }
 
 // ============================================================================
@@ -265,7 +265,297 @@ glm::vec4 computeBarycenter3D(const s_modelDataLayout &layout, const s_partInfo
 
 // ============================================================================
 
-void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &part, const float threshold, std::vector<glm::vec3> &outSkinTri)
+/// Quickhull (3D). The faces and the conflict-lists are stored in arenas, there is no allocation during the iterations.
+struct s_quickhull
+{
+  static constexpr uint32_t kNull = uint32_t(-1);
+
+  struct s_face
+  {
+    uint32_t  v[3];                ///< vertices (out-normal = cross(v1 - v0, v2 - v0))
+    uint32_t  neighbor[3];         ///< face accross the edge (v[i], v[i+1])
+    double    normal[3];           ///< plane in double precision (the thin faces are common on large hulls)
+    double    offset;
+    uint32_t  conflictHead = kNull; ///< first point of the conflict-list
+    uint32_t  furthestPoint = kNull;
+    double    furthestDist = 0.;
+    uint32_t  visitStamp = 0;
+    bool      isAlive = false;
+  };
+
+  const std::vector<glm::vec3> &points;
+  double                        epsilon;
+
+  std::vector<s_face>   faces;        ///< arena of faces
+  std::vector<uint32_t> facesFree;    ///< free-list of the faces' arena
+  std::vector<uint32_t> conflictNext; ///< arena of the conflict-lists (linked-list, per point)
+  std::vector<std::pair<double, uint32_t>> queue; ///< faces with a non-empty conflict-list (max-heap on the furthest distance)
+  uint32_t              visitStamp = 0;
+
+  // scratch buffers
+  std::vector<uint32_t> visibleFaces;
+  std::vector<uint32_t> horizon;       ///< (vertex start, vertex end, face behind)
+  std::vector<uint32_t> newFaces;
+  std::vector<uint32_t> newFaceByEdgeStart;
+  std::vector<uint32_t> newFaceByEdgeEnd;
+
+  s_quickhull(const std::vector<glm::vec3> &pts, double eps) : points(pts), epsilon(eps) {}
+
+  double distance(const s_face &f, uint32_t iP) const
+  {
+    const glm::vec3 &pt = points[iP];
+    return f.normal[0] * pt.x + f.normal[1] * pt.y + f.normal[2] * pt.z - f.offset;
+  }
+
+  uint32_t createFace(uint32_t v0, uint32_t v1, uint32_t v2)
+  {
+    uint32_t iF;
+    if (!facesFree.empty())
+    {
+      iF = facesFree.back();
+      facesFree.pop_back();
+    }
+    else
+    {
+      iF = uint32_t(faces.size());
+      faces.emplace_back();
+    }
+    s_face &f = faces[iF];
+    f.v[0] = v0;
+    f.v[1] = v1;
+    f.v[2] = v2;
+    f.neighbor[0] = f.neighbor[1] = f.neighbor[2] = kNull;
+    const glm::vec3 &p0 = points[v0], &p1 = points[v1], &p2 = points[v2];
+    const double    e1[3] = { double(p1.x) - p0.x, double(p1.y) - p0.y, double(p1.z) - p0.z };
+    const double    e2[3] = { double(p2.x) - p0.x, double(p2.y) - p0.y, double(p2.z) - p0.z };
+    const double    n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const double    nLength = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    const double    nInv = (nLength > 0.) ? 1. / nLength : 0.;
+    for (unsigned c = 0; c < 3; ++c) f.normal[c] = n[c] * nInv;
+    f.offset = (f.normal[0] * (double(p0.x) + p1.x + p2.x) + f.normal[1] * (double(p0.y) + p1.y + p2.y) + f.normal[2] * (double(p0.z) + p1.z + p2.z)) / 3.;
+    f.conflictHead = kNull;
+    f.furthestPoint = kNull;
+    f.furthestDist = 0.;
+    f.visitStamp = 0;
+    f.isAlive = true;
+    return iF;
+  }
+
+  void addConflict(uint32_t iF, uint32_t iP, double dist)
+  {
+    s_face &f = faces[iF];
+    conflictNext[iP] = f.conflictHead;
+    f.conflictHead = iP;
+    if (dist > f.furthestDist)
+    {
+      f.furthestDist = dist;
+      f.furthestPoint = iP;
+    }
+  }
+
+  void pushQueue(uint32_t iF)
+  {
+    if (faces[iF].conflictHead == kNull) return;
+    queue.emplace_back(faces[iF].furthestDist, iF);
+    std::push_heap(queue.begin(), queue.end());
+  }
+
+  bool initialize();
+  void addPoint(uint32_t iF);
+  void compute(std::size_t maxVertexCount);
+};
+
+// ----------------------------------------------------------------------------
+
+bool s_quickhull::initialize()
+{
+  const uint32_t nPoints = uint32_t(points.size());
+
+  // initial tetrahedron: the 2 furthest extreme points, then the furthest point from the line, then from the plane.
+
+  uint32_t extremes[6] = { 0, 0, 0, 0, 0, 0 };
+  for (uint32_t iP = 1; iP < nPoints; ++iP)
+  {
+    const glm::vec3 &pt = points[iP];
+    for (unsigned c = 0; c < 3; ++c)
+    {
+      if (pt[c] < points[extremes[2 * c + 0]][c]) extremes[2 * c + 0] = iP;
+      if (pt[c] > points[extremes[2 * c + 1]][c]) extremes[2 * c + 1] = iP;
+    }
+  }
+  uint32_t i0 = 0, i1 = 0;
+  float    distMax = -1.f;
+  for (unsigned a = 0; a < 6; ++a)
+  {
+    for (unsigned b = a + 1; b < 6; ++b)
+    {
+      const glm::vec3 d = points[extremes[b]] - points[extremes[a]];
+      const float     dd = glm::dot(d, d);
+      if (dd > distMax) { distMax = dd; i0 = extremes[a]; i1 = extremes[b]; }
+    }
+  }
+  if (distMax <= epsilon * epsilon) return false;
+
+  const glm::vec3 p0 = points[i0];
+  const glm::vec3 e01 = points[i1] - p0;
+  uint32_t        i2 = kNull;
+  distMax = 0.f;
+  for (uint32_t iP = 0; iP < nPoints; ++iP)
+  {
+    const glm::vec3 c = glm::cross(e01, points[iP] - p0);
+    const float     cc = glm::dot(c, c);
+    if (cc > distMax) { distMax = cc; i2 = iP; }
+  }
+  const float flatTolerance = std::max(float(epsilon), 1.e-6f * std::sqrt(glm::dot(e01, e01))); // the initial tetrahedron must not be flat
+  if (i2 == kNull || distMax <= flatTolerance * flatTolerance * glm::dot(e01, e01)) return false;
+
+  const glm::vec3 n012 = glm::normalize(glm::cross(e01, points[i2] - p0));
+  uint32_t        i3 = kNull;
+  float           dist3 = 0.f;
+  for (uint32_t iP = 0; iP < nPoints; ++iP)
+  {
+    const float d = glm::dot(n012, points[iP] - p0);
+    if (std::abs(d) > std::abs(dist3)) { dist3 = d; i3 = iP; }
+  }
+  if (i3 == kNull || std::abs(dist3) <= flatTolerance) return false;
+
+  if (dist3 > 0.f) std::swap(i1, i2); // the 4th point must be behind the face (i0, i1, i2)
+
+  const uint32_t f0 = createFace(i0, i1, i2);
+  const uint32_t f1 = createFace(i0, i3, i1);
+  const uint32_t f2 = createFace(i1, i3, i2);
+  const uint32_t f3 = createFace(i2, i3, i0);
+  const auto fnLink = [this](uint32_t iF, uint32_t n0, uint32_t n1, uint32_t n2) { faces[iF].neighbor[0] = n0; faces[iF].neighbor[1] = n1; faces[iF].neighbor[2] = n2; };
+  fnLink(f0, f1, f2, f3);
+  fnLink(f1, f3, f2, f0);
+  fnLink(f2, f1, f3, f0);
+  fnLink(f3, f2, f1, f0);
+
+  // initial conflict-lists (the points inside the tetrahedron are discarded)
+
+  conflictNext.assign(nPoints, kNull);
+  const uint32_t initialFaces[4] = { f0, f1, f2, f3 };
+  for (uint32_t iP = 0; iP < nPoints; ++iP)
+  {
+    if (iP == i0 || iP == i1 || iP == i2 || iP == i3) continue;
+    for (uint32_t iF : initialFaces)
+    {
+      const double d = distance(faces[iF], iP);
+      if (d > epsilon) { addConflict(iF, iP, d); break; }
+    }
+  }
+  for (uint32_t iF : initialFaces) pushQueue(iF);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_quickhull::addPoint(uint32_t iFstart)
+{
+  const uint32_t eye = faces[iFstart].furthestPoint;
+  ++visitStamp;
+
+  // visible faces (connected set) and horizon
+
+  visibleFaces.clear();
+  horizon.clear();
+  visibleFaces.push_back(iFstart);
+  faces[iFstart].visitStamp = visitStamp;
+  for (std::size_t k = 0; k < visibleFaces.size(); ++k)
+  {
+    const s_face &f = faces[visibleFaces[k]];
+    for (unsigned e = 0; e < 3; ++e)
+    {
+      const uint32_t iN = f.neighbor[e];
+      s_face        &fN = faces[iN];
+      if (fN.visitStamp == visitStamp) continue; // already visible
+      if (distance(fN, eye) > epsilon)
+      {
+        fN.visitStamp = visitStamp;
+        visibleFaces.push_back(iN);
+      }
+      else
+      {
+        horizon.push_back(f.v[e]);
+        horizon.push_back(f.v[(e + 1) % 3]);
+        horizon.push_back(iN);
+      }
+    }
+  }
+
+  // new faces (cone from the horizon to the eye)
+
+  newFaces.clear();
+  for (std::size_t h = 0; h < horizon.size(); h += 3)
+  {
+    const uint32_t va = horizon[h + 0], vb = horizon[h + 1], iN = horizon[h + 2];
+    const uint32_t iF = createFace(va, vb, eye);
+    newFaces.push_back(iF);
+    faces[iF].neighbor[0] = iN;
+    s_face &fN = faces[iN];
+    for (unsigned e = 0; e < 3; ++e)
+    {
+      if (fN.v[e] == vb && fN.v[(e + 1) % 3] == va) { fN.neighbor[e] = iF; break; }
+    }
+    newFaceByEdgeStart[va] = iF;
+    newFaceByEdgeEnd[vb] = iF;
+  }
+  for (uint32_t iF : newFaces)
+  {
+    s_face &f = faces[iF];
+    f.neighbor[1] = newFaceByEdgeStart[f.v[1]]; // edge (vb, eye)
+    f.neighbor[2] = newFaceByEdgeEnd[f.v[0]];   // edge (eye, va)
+  }
+
+  // re-assign the conflict points, and release the visible faces
+
+  for (uint32_t iV : visibleFaces)
+  {
+    s_face &fV = faces[iV];
+    for (uint32_t iP = fV.conflictHead; iP != kNull; )
+    {
+      const uint32_t iPnext = conflictNext[iP];
+      if (iP != eye)
+      {
+        for (uint32_t iF : newFaces)
+        {
+          const double d = distance(faces[iF], iP);
+          if (d > epsilon) { addConflict(iF, iP, d); break; }
+        }
+      }
+      iP = iPnext;
+    }
+    fV.isAlive = false;
+    fV.conflictHead = kNull;
+    facesFree.push_back(iV);
+  }
+
+  for (uint32_t iF : newFaces) pushQueue(iF);
+}
+
+// ----------------------------------------------------------------------------
+
+void s_quickhull::compute(std::size_t maxVertexCount)
+{
+  newFaceByEdgeStart.resize(points.size());
+  newFaceByEdgeEnd.resize(points.size());
+
+  std::size_t vertexCount = 4;
+  while (!queue.empty() && (maxVertexCount == 0 || vertexCount < maxVertexCount))
+  {
+    std::pop_heap(queue.begin(), queue.end());
+    const uint32_t iF = queue.back().second;
+    queue.pop_back();
+    if (!faces[iF].isAlive || faces[iF].conflictHead == kNull) continue; // outdated entry
+    addPoint(iF);
+    ++vertexCount;
+  }
+}
+
+// ============================================================================
+
+void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &part, const float threshold, std::vector<glm::vec3> &outSkinTri, const std::size_t maxVertexCount)
 {
   TRE_ASSERT(layout.m_vertexCount > 0);
   TRE_ASSERT(layout.m_positions.m_size == 3);
@@ -278,8 +568,7 @@ void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &par
   const std::size_t end = offset + count;
 
   const glm::vec3 boxExtend = part.m_bbox.extend();
-  const float radiusThreshold = threshold * fmaxf(boxExtend.x, boxExtend.y);
-  const float thresholdSquared = radiusThreshold * radiusThreshold;
+  const float radiusThreshold = threshold * fmaxf(fmaxf(boxExtend.x, boxExtend.y), boxExtend.z);
 
   // extract points
   std::vector<glm::vec3> points;
@@ -299,9 +588,30 @@ void computeConvexeSkin3D(const s_modelDataLayout &layout, const s_partInfo &par
     }
   }
 
-  // divide and conquere ...
+  // the tolerance must be above the rounding errors of the planes (computed in double precision)
+  s_boundbox bbox;
+  for (const glm::vec3 &pt : points) bbox.addPointInBox(pt);
+  const glm::vec3 bboxAbsMax = glm::max(glm::abs(bbox.m_min), glm::abs(bbox.m_max));
+  const double    epsilon = std::max(double(radiusThreshold), 1.e-12 * (double(bboxAbsMax.x) + bboxAbsMax.y + bboxAbsMax.z));
 
-  TRE_FATAL("not implemented");
+  // quickhull
+
+  s_quickhull quickhull(points, epsilon);
+  if (!quickhull.initialize())
+  {
+    TRE_LOG("computeConvexeSkin3D: the points are flat (the convex hull has no volume)");
+    return;
+  }
+  quickhull.compute(maxVertexCount);
+
+  outSkinTri.reserve((quickhull.faces.size() - quickhull.facesFree.size()) * 3);
+  for (const s_quickhull::s_face &f : quickhull.faces)
+  {
+    if (!f.isAlive) continue;
+    outSkinTri.push_back(points[f.v[0]]);
+    outSkinTri.push_back(points[f.v[1]]);
+    outSkinTri.push_back(points[f.v[2]]);
+  }
 }
 
 // ============================================================================
@@ -767,24 +1077,130 @@ std::size_t decimateVoxel(modelIndexed &model, const std::size_t ipartIn, const
 
   // it collapses all vertices that are in the same cell of the 3D-grid.
   // it creates a new vertex when needed, and it removes degenerated triangles.
+  // the grid is sparse: only the occupied cells are stored. The cells are hashed per z-slab, and the slabs are processed in parallel.
 
   std::size_t Ntri = countIn / 3;
 
   TRE_LOG("decimateVoxel: processing mesh (Ntri = " << Ntri << ") with grid " << gridDim.x <<" x " << gridDim.y << " x " << gridDim.z);
 
-  // pre-step: fill the 3d-grid
+  // pre-step: compute the cell of each corner (key = linear index in the 3d-grid)
+
+  std::vector<uint64_t> cornerCell(countIn);
+  parallelFor(countIn, 4096, [&](std::size_t iBegin, std::size_t iEnd)
+  {
+    for (std::size_t i = iBegin; i < iEnd; ++i)
+    {
+      const unsigned ind = layout.m_index[offsetIn + i];
+      const glm::vec3  pos = layout.m_positions.get<glm::vec3>(ind);
+      const glm::ivec3 posI =  glm::ivec3((pos - gridMin) / gridResolution);
+      TRE_ASSERT(posI.x >= 0 && posI.x < gridDim.x);
+      TRE_ASSERT(posI.y >= 0 && posI.y < gridDim.y);
+      TRE_ASSERT(posI.z >= 0 && posI.z < gridDim.z);
+      cornerCell[i] = (uint64_t(posI.z) * uint64_t(gridDim.y) + uint64_t(posI.y)) * uint64_t(gridDim.x) + uint64_t(posI.x);
+    }
+  });
+
+  // pre-step: dispatch the corners into z-slabs (stable, the slabs are ordered as the cells)
+
+  const uint64_t    sliceSize = uint64_t(gridDim.x) * uint64_t(gridDim.y);
+  const std::size_t slabCount = std::min(std::size_t(gridDim.z), std::size_t(parallelThreadCount()) * 4);
+  const auto        fnSlab = [&](uint64_t cell) { return std::size_t((cell / sliceSize) * slabCount / uint64_t(gridDim.z)); };
+
+  std::vector<unsigned> slabStart(slabCount + 1, 0);
+  for (const uint64_t cell : cornerCell) ++slabStart[fnSlab(cell) + 1];
+  for (std::size_t s = 0; s < slabCount; ++s) slabStart[s + 1] += slabStart[s];
+
+  std::vector<unsigned> slabCorners(countIn);
+  {
+    std::vector<unsigned> slabFill(slabStart.begin(), slabStart.end() - 1);
+    for (std::size_t i = 0; i < countIn; ++i) slabCorners[slabFill[fnSlab(cornerCell[i])]++] = unsigned(i);
+  }
+
+  // fill the sparse 3d-grid (open-addressing hash-table per slab)
+  // the corners are grouped by cell, sorted by cell, and kept in the index-buffer order in each cell.
+
+  struct s_cell
+  {
+    uint64_t  key;
+    unsigned  cornerFirst;
+    unsigned  cornerCount;
+    glm::vec3 pos; // averaged position of the corners
+  };
+
+  std::vector<std::vector<s_cell>> slabCells(slabCount);
+  std::vector<unsigned>            cellCorners(countIn);
+
+  parallelFor(slabCount, 1, [&](std::size_t sBegin, std::size_t sEnd)
+  {
+    std::vector<unsigned> table;        // cell-index + 1 (0 = empty)
+    std::vector<unsigned> cornerToCell;
+    std::vector<s_cell>   cellsUnsorted;
+    std::vector<unsigned> cellRemap;
+
+    for (std::size_t s = sBegin; s < sEnd; ++s)
+    {
+      const unsigned cStart = slabStart[s];
+      const unsigned cCount = slabStart[s + 1] - cStart;
+
+      unsigned tableBits = 4;
+      while ((1u << tableBits) < 2 * cCount) ++tableBits;
+      const unsigned tableMask = (1u << tableBits) - 1;
+      table.assign(tableMask + 1, 0);
+      cornerToCell.resize(cCount);
+      cellsUnsorted.clear();
+
+      for (unsigned k = 0; k < cCount; ++k)
+      {
+        const uint64_t key = cornerCell[slabCorners[cStart + k]];
+        unsigned h = unsigned((key * 0x9E3779B97F4A7C15ull) >> (64 - tableBits));
+        while (table[h] != 0 && cellsUnsorted[table[h] - 1].key != key) h = (h + 1) & tableMask;
+        if (table[h] == 0)
+        {
+          cellsUnsorted.push_back(s_cell{key, 0, 0, glm::vec3(0.f)});
+          table[h] = unsigned(cellsUnsorted.size());
+        }
+        cornerToCell[k] = table[h] - 1;
+        ++cellsUnsorted[table[h] - 1].cornerCount;
+      }
+
+      std::vector<s_cell> &cells = slabCells[s];
+      cells = cellsUnsorted;
+      std::sort(cells.begin(), cells.end(), [](const s_cell &a, const s_cell &b) { return a.key < b.key; });
+
+      cellRemap.resize(cells.size());
+      unsigned cornerFirst = cStart;
+      for (s_cell &cell : cells)
+      {
+        unsigned h = unsigned((cell.key * 0x9E3779B97F4A7C15ull) >> (64 - tableBits));
+        while (cellsUnsorted[table[h] - 1].key != cell.key) h = (h + 1) & tableMask;
+        cellRemap[table[h] - 1] = unsigned(&cell - cells.data());
+        cell.cornerFirst = cornerFirst;
+        cornerFirst += cell.cornerCount;
+        cell.cornerCount = 0;
+      }
+
+      for (unsigned k = 0; k < cCount; ++k)
+      {
+        s_cell &cell = cells[cellRemap[cornerToCell[k]]];
+        cellCorners[cell.cornerFirst + cell.cornerCount++] = slabCorners[cStart + k];
+      }
+
+      for (s_cell &cell : cells)
+      {
+        if (cell.cornerCount < 2) continue;
+        for (unsigned k = cell.cornerFirst, kStop = cell.cornerFirst + cell.cornerCount; k < kStop; ++k)
+          cell.pos += layout.m_positions.get<glm::vec3>(layout.m_index[offsetIn + cellCorners[k]]);
+        cell.pos /= float(cell.cornerCount);
+      }
+    }
+  });
 
-  std::vector<unsigned> gridVind(gridDim.x * gridDim.y * gridDim.z, 0);
-  for (std::size_t i = offsetIn, stop = offsetIn + countIn; i < stop; ++i)
+  std::vector<s_cell> cells;
   {
-    const unsigned ind = layout.m_index[i];
-    const glm::vec3  pos = layout.m_positions.get<glm::vec3>(ind);
-    const glm::ivec3 posI =  glm::ivec3((pos - gridMin) / gridResolution);
-    const int        g = (posI.z * gridDim.y + posI.y) * gridDim.x + posI.x;
-    TRE_ASSERT(posI.x >= 0 && posI.x < gridDim.x);
-    TRE_ASSERT(posI.y >= 0 && posI.y < gridDim.y);
-    TRE_ASSERT(posI.z >= 0 && posI.z < gridDim.z);
-    gridVind[g] += 1;
+    std::size_t cellCount = 0;
+    for (const auto &sc : slabCells) cellCount += sc.size();
+    cells.reserve(cellCount);
+    for (auto &sc : slabCells) { cells.insert(cells.end(), sc.begin(), sc.end()); sc = std::vector<s_cell>(); }
   }
 
   // count before allocation
@@ -792,11 +1208,11 @@ std::size_t decimateVoxel(modelIndexed &model, const std::size_t ipartIn, const
   std::size_t verticesNew = 0;
   if (keepSharpEdges)
   {
-    for (const unsigned gvind : gridVind) verticesNew += gvind;
+    for (const s_cell &cell : cells) verticesNew += cell.cornerCount;
   }
   else
   {
-    for (const unsigned gvind : gridVind) verticesNew += (gvind >= 2) ? 1 : 0;
+    for (const s_cell &cell : cells) verticesNew += (cell.cornerCount >= 2) ? 1 : 0;
   }
 
   // allocate mesh data
@@ -809,46 +1225,60 @@ std::size_t decimateVoxel(modelIndexed &model, const std::size_t ipartIn, const
 
   // create the new vertices
 
-  std::vector<glm::uvec2> triCollected, triToProcess;
-  triCollected.reserve(16);
-  triToProcess.reserve(16);
-
-  for (int ik = 0, gc = int(gridVind.size()); ik < gc; ++ik)
+  if (!keepSharpEdges)
   {
-    if (gridVind[ik] >= 2)
+    // a unique vertex per cell, the cells are independent.
+
+    std::vector<unsigned> cellVertex(cells.size());
+    for (std::size_t ic = 0; ic < cells.size(); ++ic)
+    {
+      cellVertex[ic] = unsigned(vertexAddOffset);
+      if (cells[ic].cornerCount >= 2) ++vertexAddOffset;
+    }
+
+    parallelFor(cells.size(), 1024, [&](std::size_t iBegin, std::size_t iEnd)
     {
-      // collect triangles
-      triCollected.clear();
-      glm::vec3 vpos = glm::vec3(0.f);
-      int       c = 0;
-      for (std::size_t iT = 0; iT < Ntri; ++iT)
+      for (std::size_t ic = iBegin; ic < iEnd; ++ic)
       {
-        const unsigned indA = layout.m_index[offsetOut + iT * 3 + 0];
-        const unsigned indB = layout.m_index[offsetOut + iT * 3 + 1];
-        const unsigned indC = layout.m_index[offsetOut + iT * 3 + 2];
-        const glm::ivec3 posA = glm::ivec3((layout.m_positions.get<glm::vec3>(indA) - gridMin) / gridResolution);
-        const glm::ivec3 posB = glm::ivec3((layout.m_positions.get<glm::vec3>(indB) - gridMin) / gridResolution);
-        const glm::ivec3 posC = glm::ivec3((layout.m_positions.get<glm::vec3>(indC) - gridMin) / gridResolution);
-        const int gA = (posA.z * gridDim.y + posA.y) * gridDim.x + posA.x;
-        const int gB = (posB.z * gridDim.y + posB.y) * gridDim.x + posB.x;
-        const int gC = (posC.z * gridDim.y + posC.y) * gridDim.x + posC.x;
-        const unsigned flag = (gA == ik) * 0x1 + (gB == ik) * 0x2 + (gC == ik) * 0x4;
-        if (gA == ik) { vpos += layout.m_positions.get<glm::vec3>(indA); c += 1; }
-        if (gB == ik) { vpos += layout.m_positions.get<glm::vec3>(indB); c += 1; }
-        if (gC == ik) { vpos += layout.m_positions.get<glm::vec3>(indC); c += 1; }
-        if (flag != 0) triCollected.push_back(glm::uvec2(iT, flag));
+        const s_cell &cell = cells[ic];
+        if (cell.cornerCount < 2) continue;
+        // the vertex is copied from the first corner of the last triangle
+        unsigned kSrc = cell.cornerFirst + cell.cornerCount - 1;
+        while (kSrc > cell.cornerFirst && cellCorners[kSrc - 1] / 3 == cellCorners[kSrc] / 3) --kSrc;
+        layout.copyVertex(layout.m_index[offsetOut + cellCorners[kSrc]], 1, cellVertex[ic]);
+        layout.m_positions.get<glm::vec3>(cellVertex[ic]) = cell.pos;
+        for (unsigned k = cell.cornerFirst, kStop = cell.cornerFirst + cell.cornerCount; k < kStop; ++k)
+          layout.m_index[offsetOut + cellCorners[k]] = cellVertex[ic];
       }
-      TRE_ASSERT(!triCollected.empty());
-      TRE_ASSERT(c > 1);
-      vpos /= float(c);
-      //
-      while (!triCollected.empty())
+    });
+  }
+  else
+  {
+    // a unique vertex per each set of triangles that share vertices.
+    // the cells are processed in order, because the sets depend on the vertices created in the previous cells.
+
+    std::vector<glm::uvec2> triCollected, triToProcess;
+    triCollected.reserve(16);
+    triToProcess.reserve(16);
+
+    for (const s_cell &cell : cells)
+    {
+      if (cell.cornerCount >= 2)
       {
-        // assign a unique vertex per each set of triangles ...
-        triToProcess.clear();
-        triToProcess.push_back(triCollected.back()); triCollected.pop_back();
-        if (keepSharpEdges) // .. that share vertices
+        // collect triangles
+        triCollected.clear();
+        for (unsigned k = cell.cornerFirst, kStop = cell.cornerFirst + cell.cornerCount; k < kStop; ++k)
+        {
+          const unsigned iT = cellCorners[k] / 3;
+          const unsigned flag = 1u << (cellCorners[k] % 3);
+          if (!triCollected.empty() && triCollected.back().x == iT) triCollected.back().y |= flag;
+          else                                                      triCollected.push_back(glm::uvec2(iT, flag));
+        }
+        //
+        while (!triCollected.empty())
         {
+          triToProcess.clear();
+          triToProcess.push_back(triCollected.back()); triCollected.pop_back();
           for (std::size_t j = 0; j < triCollected.size();)
           {
             const glm::uvec2 tri = triCollected[j];
@@ -878,90 +1308,745 @@ std::size_t decimateVoxel(modelIndexed &model, const std::size_t ipartIn, const
               ++j;
             }
           }
-        }
-        else // ... of all the triangles
-        {
-          for (const auto &tri : triCollected) triToProcess.push_back(tri);
-          triCollected.clear();
-        }
-        // create the vertex and assign triangles
-        bool duplicated = false;
-        for (const auto &tri : triToProcess)
-        {
-          unsigned &indA = layout.m_index[offsetOut + tri.x * 3 + 0];
-          unsigned &indB = layout.m_index[offsetOut + tri.x * 3 + 1];
-          unsigned &indC = layout.m_index[offsetOut + tri.x * 3 + 2];
-          if ((tri.y & 0x1) != 0)
-          {
-            if (!duplicated) layout.copyVertex(indA, 1, vertexAddOffset);
-            duplicated = true;
-            indA = unsigned(vertexAddOffset);
-          }
-          if ((tri.y & 0x2) != 0)
-          {
-            if (!duplicated) layout.copyVertex(indB, 1, vertexAddOffset);
-            duplicated = true;
-            indB = unsigned(vertexAddOffset);
-          }
-          if ((tri.y & 0x4) != 0)
+          // create the vertex and assign triangles
+          bool duplicated = false;
+          for (const auto &tri : triToProcess)
           {
-            if (!duplicated) layout.copyVertex(indC, 1, vertexAddOffset);
-            duplicated = true;
-            indC = unsigned(vertexAddOffset);
+            for (unsigned iC = 0; iC < 3; ++iC)
+            {
+              if ((tri.y & (1u << iC)) == 0) continue;
+              unsigned &ind = layout.m_index[offsetOut + tri.x * 3 + iC];
+              if (!duplicated) layout.copyVertex(ind, 1, vertexAddOffset);
+              duplicated = true;
+              ind = unsigned(vertexAddOffset);
+            }
           }
+          TRE_ASSERT(duplicated);
+          layout.m_positions.get<glm::vec3>(vertexAddOffset) = cell.pos;
+          ++vertexAddOffset;
         }
-        TRE_ASSERT(duplicated);
-        layout.m_positions.get<glm::vec3>(vertexAddOffset) = vpos;
+      }
+      else
+      {
+        // duplicate also the alone vertices
+        unsigned &ind = layout.m_index[offsetOut + cellCorners[cell.cornerFirst]];
+        layout.copyVertex(ind, 1, vertexAddOffset);
+        ind = unsigned(vertexAddOffset);
         ++vertexAddOffset;
       }
     }
-    else if (keepSharpEdges && gridVind[ik] == 1)
+  }
+
+  // remove degenerated triangles
+
+  for (std::size_t iT = 0; iT < Ntri; )
+  {
+    unsigned &indA = layout.m_index[offsetOut + iT * 3 + 0];
+    unsigned &indB = layout.m_index[offsetOut + iT * 3 + 1];
+    unsigned &indC = layout.m_index[offsetOut + iT * 3 + 2];
+    if (indA == indB || indA == indC || indB == indC)
+    {
+      --Ntri;
+      indA = layout.m_index[offsetOut + Ntri * 3 + 0];
+      indB = layout.m_index[offsetOut + Ntri * 3 + 1];
+      indC = layout.m_index[offsetOut + Ntri * 3 + 2];
+    }
+    else
+    {
+      ++iT;
+    }
+  }
+
+  TRE_ASSERT(Ntri * 3 <= countIn);
+
+  model.resizeRawPart(ipartOut, Ntri * 3); // ok, we're not growing.
+
+  TRE_LOG("decimateVoxel: Completed, Ntriangles = " << Ntri << ", new vertices = " << verticesNew << ", occupied cells = " << cells.size());
+
+  return ipartOut;
+}
+
+// ============================================================================
+
+/// Quadric error: sum of the weighted squared distances to a set of planes.
+struct s_quadric
+{
+  float a00 = 0.f, a11 = 0.f, a22 = 0.f, a01 = 0.f, a02 = 0.f, a12 = 0.f;
+  float b0 = 0.f, b1 = 0.f, b2 = 0.f;
+  float c = 0.f;
+  float w = 0.f; ///< accumulated weight
+
+  void addPlane(const glm::vec3 &n, const float d, const float weight)
+  {
+    a00 += weight * n.x * n.x; a11 += weight * n.y * n.y; a22 += weight * n.z * n.z;
+    a01 += weight * n.x * n.y; a02 += weight * n.x * n.z; a12 += weight * n.y * n.z;
+    b0 += weight * n.x * d; b1 += weight * n.y * d; b2 += weight * n.z * d;
+    c += weight * d * d;
+    w += weight;
+  }
+
+  void add(const s_quadric &other)
+  {
+    a00 += other.a00; a11 += other.a11; a22 += other.a22;
+    a01 += other.a01; a02 += other.a02; a12 += other.a12;
+    b0 += other.b0; b1 += other.b1; b2 += other.b2;
+    c += other.c;
+    w += other.w;
+  }
+
+  float eval(const glm::vec3 &p) const
+  {
+    const float rx = a00 * p.x + a01 * p.y + a02 * p.z + 2.f * b0;
+    const float ry = a11 * p.y + a12 * p.z + 2.f * b1;
+    const float rz = a22 * p.z;
+    return p.x * rx + p.y * (ry + a01 * p.x) + p.z * (rz + a02 * p.x + a12 * p.y + 2.f * b2) + c;
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+/// Half-edge collapses ordered by the quadric error (Garland-Heckbert).
+/// The "wedges" are the vertices of the part, the "points" are the unique positions: a point has several wedges on the attribute-seams.
+/// A point is collapsed into one of its neighbors, so that no vertex is created nor modified.
+/// The triangle-fan of a point is a linked-list of corners (corner = 3 * triangle + slot), merged on collapse.
+/// Each point keeps its cheapest collapse in an indexed min-heap, updated when its neighborhood changes.
+struct s_edgeCollapser
+{
+  static constexpr uint32_t kNull = uint32_t(-1);
+
+  enum e_kind : uint8_t
+  {
+    KIND_MANIFOLD, ///< interior point, with one wedge
+    KIND_BORDER,   ///< on an open-boundary, it can only slide along the boundary
+    KIND_SEAM,     ///< on an attribute-seam (2 wedges), it can only slide along the seam
+    KIND_LOCKED,   ///< corners, non-manifold points, ... (or collapsed point)
+  };
+
+  struct alignas(64) s_point
+  {
+    glm::vec3 pos; ///< normalized in the unit box
+    s_quadric quadric;
+    uint32_t  mark = 0; ///< scratch mark (neighbor-search)
+    uint8_t   kind = KIND_MANIFOLD;
+    bool      dirty = false; ///< the target is outdated, it is recomputed when the point reaches the top of the heap
+  };
+
+  struct s_corner
+  {
+    uint32_t point; ///< kNull on the first corner when the triangle is removed
+    uint32_t next;  ///< next corner in the triangle-fan of the point
+  };
+
+  struct s_heapNode
+  {
+    float    error;
+    uint32_t point;
+  };
+
+  static constexpr float kBorderWeight = 10.f;
+  static constexpr float kSeamWeight = 1.f;
+
+  std::vector<uint32_t>   wedgeToGlobal;   ///< wedge -> vertex in the layout
+  std::vector<uint32_t>   wedgeToPoint;
+  std::vector<s_point>    points;
+  std::vector<uint32_t>   pointTarget;     ///< cheapest collapse of the point (kNull if none)
+  std::vector<float>      pointError;      ///< error of the cheapest collapse (squared distance, in the normalized space)
+  std::vector<uint32_t>   pointHeapPos;    ///< position in the heap (kNull if not queued)
+  std::vector<uint32_t>   pointCornerHead; ///< first corner of the point's triangle-fan
+  std::vector<s_corner>   corners;
+  std::vector<uint32_t>   triWedge;        ///< 3 wedges per triangle
+  std::vector<s_heapNode> heap;            ///< min-heap on the error
+  std::vector<glm::uvec3> fan;             ///< scratch: triangle-fan (next point, previous point, wedge)
+  std::vector<std::pair<float, uint32_t>> candidates; ///< scratch: (error, target)
+  uint32_t                wedgeFrom[2], wedgeTo[2]; ///< wedge re-mapping of the validated collapse
+  uint32_t                markStamp = 0;
+  std::size_t             triangleCount = 0;
+  float                   lastError = 0.f;
+
+  static uint32_t _cornerNext(uint32_t c) { return (c % 3 == 2) ? c - 2 : c + 1; }
+  static uint32_t _cornerPrev(uint32_t c) { return (c % 3 == 0) ? c + 2 : c - 1; }
+
+  uint32_t point(uint32_t c) const { return corners[c].point; }
+
+  /// Calls "fn(corner)" on the fan of the point "p". The corners of the removed triangles are unlinked on the fly.
+  template<class _F> void forEachCorner(uint32_t p, _F fn)
+  {
+    uint32_t *link = &pointCornerHead[p];
+    while (*link != kNull)
+    {
+      const uint32_t c = *link;
+      if (corners[c - c % 3].point == kNull) { *link = corners[c].next; continue; }
+      fn(c);
+      link = &corners[c].next;
+    }
+  }
+
+  // 4-ary heap: the children of the node "i" are the nodes (4 * i + 1, ..., 4 * i + 4)
+
+  void heapSiftUp(uint32_t i)
+  {
+    const s_heapNode node = heap[i];
+    while (i > 0)
+    {
+      const uint32_t iParent = (i - 1) / 4;
+      if (heap[iParent].error <= node.error) break;
+      heap[i] = heap[iParent];
+      pointHeapPos[heap[i].point] = i;
+      i = iParent;
+    }
+    heap[i] = node;
+    pointHeapPos[node.point] = i;
+  }
+
+  void heapSiftDown(uint32_t i)
+  {
+    const s_heapNode node = heap[i];
+    const uint32_t   n = uint32_t(heap.size());
+    while (4 * i + 1 < n)
+    {
+      const uint32_t iFirst = 4 * i + 1, iStop = std::min(iFirst + 4, n);
+      uint32_t       iChild = iFirst;
+      for (uint32_t j = iFirst + 1; j < iStop; ++j)
+      {
+        if (heap[j].error < heap[iChild].error) iChild = j;
+      }
+      if (heap[iChild].error >= node.error) break;
+      heap[i] = heap[iChild];
+      pointHeapPos[heap[i].point] = i;
+      i = iChild;
+    }
+    heap[i] = node;
+    pointHeapPos[node.point] = i;
+  }
+
+  /// Inserts the point in the heap, or decreases its key to "pointError[p]".
+  /// An increase of the error is lazy: the key is updated when the point reaches the top of the heap.
+  void heapUpdate(uint32_t p)
+  {
+    uint32_t i = pointHeapPos[p];
+    if (i == kNull)
+    {
+      i = uint32_t(heap.size());
+      heap.push_back(s_heapNode{ pointError[p], p });
+      heapSiftUp(i);
+    }
+    else if (pointError[p] < heap[i].error)
+    {
+      heap[i].error = pointError[p];
+      heapSiftUp(i);
+    }
+  }
+
+  void heapRemove(uint32_t p)
+  {
+    const uint32_t i = pointHeapPos[p];
+    if (i == kNull) return;
+    pointHeapPos[p] = kNull;
+    const s_heapNode nodeLast = heap.back();
+    heap.pop_back();
+    if (nodeLast.point == p) return;
+    heap[i] = nodeLast;
+    heapSiftUp(i);
+    heapSiftDown(pointHeapPos[nodeLast.point]);
+  }
+
+  void  init(const s_modelDataLayout &layout, std::size_t offset, std::size_t count);
+  void  classify();
+  float collapseError(uint32_t p0, uint32_t p1) const;
+  bool  hasFlip(uint32_t p0, uint32_t p1) const;
+  void  computeTarget(uint32_t p);
+  void  updateTarget(uint32_t p);
+  bool  isValid(uint32_t p0, uint32_t p1);
+  void  collapse(uint32_t p0, uint32_t p1);
+  std::size_t simplify(std::size_t targetTriangleCount, float maxError);
+};
+
+// ----------------------------------------------------------------------------
+
+void s_edgeCollapser::init(const s_modelDataLayout &layout, std::size_t offset, std::size_t count)
+{
+  const std::size_t nTri = count / 3;
+
+  // wedges
+
+  std::vector<uint32_t> globalToWedge(layout.m_vertexCount, kNull);
+  triWedge.resize(count);
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const uint32_t ind = layout.m_index[offset + i];
+    if (globalToWedge[ind] == kNull)
+    {
+      globalToWedge[ind] = uint32_t(wedgeToGlobal.size());
+      wedgeToGlobal.push_back(ind);
+    }
+    triWedge[i] = globalToWedge[ind];
+  }
+  const std::size_t nWedges = wedgeToGlobal.size();
+
+  // points (welding by exact position, with an open-addressing hash table)
+
+  std::size_t tableSize = 64;
+  while (tableSize < 2 * nWedges) tableSize *= 2;
+  const std::size_t tableMask = tableSize - 1;
+  std::vector<uint32_t> table(tableSize, kNull);
+
+  wedgeToPoint.resize(nWedges);
+  points.reserve(nWedges);
+  glm::vec3 boxMin = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 boxMax = glm::vec3(-std::numeric_limits<float>::max());
+  for (std::size_t w = 0; w < nWedges; ++w)
+  {
+    const glm::vec3 pos = layout.m_positions.get<glm::vec3>(wedgeToGlobal[w]) + 0.f; // (-0.f becomes +0.f)
+    uint32_t bits[3];
+    memcpy(bits, &pos, sizeof(bits));
+    std::size_t h = std::size_t((bits[0] * 0x9E3779B1u) ^ (bits[1] * 0x85EBCA77u) ^ (bits[2] * 0xC2B2AE3Du));
+    h = (h ^ (h >> 15)) & tableMask;
+    while (table[h] != kNull && points[table[h]].pos != pos) h = (h + 1) & tableMask;
+    if (table[h] == kNull)
+    {
+      table[h] = uint32_t(points.size());
+      points.push_back(s_point{ pos, s_quadric() });
+      boxMin = glm::min(boxMin, pos);
+      boxMax = glm::max(boxMax, pos);
+    }
+    wedgeToPoint[w] = table[h];
+  }
+  const std::size_t nPoints = points.size();
+
+  const glm::vec3 boxExtent = boxMax - boxMin;
+  const float     scale = 1.f / std::max(std::max(boxExtent.x, boxExtent.y), std::max(boxExtent.z, std::numeric_limits<float>::min()));
+  for (s_point &pt : points) pt.pos = (pt.pos - boxMin) * scale;
+
+  // triangle-fans and face-quadrics
+
+  pointTarget.resize(nPoints, kNull);
+  pointError.resize(nPoints, std::numeric_limits<float>::infinity());
+  pointHeapPos.resize(nPoints, kNull);
+  pointCornerHead.resize(nPoints, kNull);
+  corners.resize(count);
+
+  for (std::size_t i = 0; i < count; ++i) corners[i] = s_corner{ wedgeToPoint[triWedge[i]], kNull };
+
+  triangleCount = 0;
+  for (std::size_t iT = 0; iT < nTri; ++iT)
+  {
+    const uint32_t c0 = uint32_t(iT * 3);
+    const uint32_t pa = point(c0), pb = point(c0 + 1), pc = point(c0 + 2);
+    if (pa == pb || pa == pc || pb == pc)
+    {
+      corners[c0].point = kNull; // degenerated triangle: dropped
+      continue;
+    }
+    ++triangleCount;
+    for (uint32_t c = c0; c < c0 + 3; ++c)
+    {
+      const uint32_t p = point(c);
+      corners[c].next = pointCornerHead[p];
+      pointCornerHead[p] = c;
+    }
+    glm::vec3   n = glm::cross(points[pb].pos - points[pa].pos, points[pc].pos - points[pa].pos);
+    const float nLength = glm::length(n);
+    if (nLength == 0.f) continue;
+    n /= nLength;
+    const float d = -glm::dot(n, points[pa].pos);
+    points[pa].quadric.addPlane(n, d, 0.5f * nLength);
+    points[pb].quadric.addPlane(n, d, 0.5f * nLength);
+    points[pc].quadric.addPlane(n, d, 0.5f * nLength);
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void s_edgeCollapser::classify()
+{
+  // the edges (p -> q) and (r -> p) of the fan of "p", with the wedges at both ends
+  std::vector<glm::uvec4> outEdges, inEdges; // (other point, wedge of p, wedge of other point, corner)
+
+  const auto fnAddEdgeQuadric = [this](uint32_t p, uint32_t q, uint32_t corner, float weight)
+  {
+    const uint32_t  c0 = corner - corner % 3;
+    const glm::vec3 &pa = points[point(c0)].pos, &pb = points[point(c0 + 1)].pos, &pc = points[point(c0 + 2)].pos;
+    const glm::vec3 edge = points[q].pos - points[p].pos;
+    glm::vec3       n = glm::cross(edge, glm::cross(pb - pa, pc - pa)); // plane that contains the edge, orthogonal to the face
+    const float     nLength = glm::length(n);
+    if (nLength == 0.f) return;
+    n /= nLength;
+    const float d = -glm::dot(n, points[p].pos);
+    points[p].quadric.addPlane(n, d, weight * glm::dot(edge, edge));
+    points[q].quadric.addPlane(n, d, weight * glm::dot(edge, edge));
+  };
+
+  for (uint32_t p = 0, pStop = uint32_t(points.size()); p < pStop; ++p)
+  {
+    outEdges.clear();
+    inEdges.clear();
+    uint32_t wedges[2] = { kNull, kNull };
+    bool     locked = false;
+    forEachCorner(p, [&](uint32_t c)
+    {
+      const uint32_t w = triWedge[c];
+      if      (wedges[0] == kNull || wedges[0] == w) wedges[0] = w;
+      else if (wedges[1] == kNull || wedges[1] == w) wedges[1] = w;
+      else                                           locked = true; // 3 wedges or more
+      const uint32_t cn = _cornerNext(c), cp = _cornerPrev(c);
+      outEdges.push_back(glm::uvec4(point(cn), w, triWedge[cn], c));
+      inEdges.push_back(glm::uvec4(point(cp), w, triWedge[cp], c));
+    });
+
+    unsigned nBorder = 0, nSeam = 0;
+    for (const glm::uvec4 &eOut : outEdges)
+    {
+      unsigned nOpposite = 0;
+      bool     isSeam = false;
+      for (const glm::uvec4 &eIn : inEdges)
+      {
+        if (eIn.x != eOut.x) continue;
+        ++nOpposite;
+        isSeam = (eIn.y != eOut.y || eIn.z != eOut.z);
+      }
+      if (nOpposite == 0)
+      {
+        ++nBorder;
+        fnAddEdgeQuadric(p, eOut.x, eOut.w, kBorderWeight);
+      }
+      else if (nOpposite == 1)
+      {
+        if (isSeam)
+        {
+          ++nSeam;
+          fnAddEdgeQuadric(p, eOut.x, eOut.w, kSeamWeight); // (the opposite face is added from the fan of the other point)
+        }
+      }
+      else
+      {
+        locked = true; // non-manifold edge
+      }
+    }
+    for (const glm::uvec4 &eIn : inEdges)
+    {
+      bool hasOpposite = false;
+      for (const glm::uvec4 &eOut : outEdges) hasOpposite |= (eOut.x == eIn.x);
+      if (!hasOpposite) ++nBorder;
+    }
+
+    const bool singleWedge = (wedges[1] == kNull);
+    if      (locked)                                     points[p].kind = KIND_LOCKED;
+    else if (nBorder == 0 && nSeam == 0 && singleWedge)  points[p].kind = KIND_MANIFOLD;
+    else if (nBorder == 2 && nSeam == 0 && singleWedge)  points[p].kind = KIND_BORDER;
+    else if (nBorder == 0 && nSeam == 2 && !singleWedge) points[p].kind = KIND_SEAM;
+    else                                                 points[p].kind = KIND_LOCKED;
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+float s_edgeCollapser::collapseError(uint32_t p0, uint32_t p1) const
+{
+  const s_quadric &q0 = points[p0].quadric, &q1 = points[p1].quadric;
+  const float     w = q0.w + q1.w;
+  return (w > 0.f) ? std::max(q0.eval(points[p1].pos) + q1.eval(points[p1].pos), 0.f) / w : 0.f;
+}
+
+// ----------------------------------------------------------------------------
+
+static bool _isFlipped(const glm::vec3 &pos0, const glm::vec3 &pos1, const glm::vec3 &posN, const glm::vec3 &posP)
+{
+  // the triangle (pos0, posN, posP) becomes (pos1, posN, posP)
+  const glm::vec3 nOld = glm::cross(posN - pos0, posP - pos0);
+  const glm::vec3 nNew = glm::cross(posN - pos1, posP - pos1);
+  const float     dotN = glm::dot(nOld, nNew);
+  return dotN <= 0.f || dotN * dotN <= 0.0625f * glm::dot(nOld, nOld) * glm::dot(nNew, nNew); // the face rotates by more than ~75 degrees
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_edgeCollapser::hasFlip(uint32_t p0, uint32_t p1) const
+{
+  const glm::vec3 &pos0 = points[p0].pos, &pos1 = points[p1].pos;
+  for (const glm::uvec3 &tri : fan)
+  {
+    if (tri.x != p1 && tri.y != p1 && _isFlipped(pos0, pos1, points[tri.x].pos, points[tri.y].pos)) return true;
+  }
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_edgeCollapser::computeTarget(uint32_t p)
+{
+  pointTarget[p] = kNull;
+  pointError[p] = std::numeric_limits<float>::infinity();
+  points[p].dirty = false;
+
+  const uint8_t kind = points[p].kind;
+  if (kind == KIND_LOCKED) return;
+
+  fan.clear();
+  forEachCorner(p, [&](uint32_t c) { fan.push_back(glm::uvec3(point(_cornerNext(c)), point(_cornerPrev(c)), (kind == KIND_MANIFOLD) ? 0 : triWedge[c])); });
+
+  candidates.clear();
+  if (kind == KIND_MANIFOLD)
+  {
+    for (const glm::uvec3 &tri : fan) candidates.emplace_back(collapseError(p, tri.x), tri.x); // (the fan is closed)
+  }
+  else
+  {
+    // only along the border-edges (1 triangle) or the seam-edges (2 triangles, with different wedges of p)
+    for (std::size_t i = 0; i < fan.size(); ++i)
     {
-      // duplicate also the alone vertices
-      bool duplicated = false;
-      for (std::size_t i = offsetOut, stop = offsetOut + countIn; i < stop; ++i)
+      for (const uint32_t q : { fan[i].x, fan[i].y })
       {
-        unsigned &ind = layout.m_index[i];
-        const glm::vec3  pos = layout.m_positions.get<glm::vec3>(ind);
-        const glm::ivec3 posI =  glm::ivec3((pos - gridMin) / gridResolution);
-        const int        g = (posI.z * gridDim.y + posI.y) * gridDim.x + posI.x;
-        if (g == ik)
+        if (points[q].kind != kind) continue;
+        unsigned nEdge = 0;
+        bool     sameWedge = false, isFirst = true;
+        for (std::size_t j = 0; j < fan.size(); ++j)
         {
-          if (!duplicated) layout.copyVertex(ind, 1, vertexAddOffset);
-          duplicated = true;
-          ind = vertexAddOffset;
+          if (fan[j].x != q && fan[j].y != q) continue;
+          ++nEdge;
+          isFirst &= (j >= i);
+          sameWedge |= (j != i && fan[j].z == fan[i].z);
         }
+        if (!isFirst) continue; // (already processed)
+        if ((kind == KIND_BORDER) ? (nEdge == 1) : (nEdge == 2 && !sameWedge)) candidates.emplace_back(collapseError(p, q), q);
+      }
+    }
+  }
+
+  // the cheapest collapse without flip (the flip-test is done by increasing error)
+
+  while (!candidates.empty())
+  {
+    std::size_t iBest = 0;
+    for (std::size_t i = 1; i < candidates.size(); ++i)
+    {
+      if (candidates[i].first < candidates[iBest].first) iBest = i;
+    }
+    if (!hasFlip(p, candidates[iBest].second))
+    {
+      pointTarget[p] = candidates[iBest].second;
+      pointError[p] = candidates[iBest].first;
+      return;
+    }
+    candidates[iBest] = candidates.back();
+    candidates.pop_back();
+  }
+}
+
+// ----------------------------------------------------------------------------
+
+void s_edgeCollapser::updateTarget(uint32_t p)
+{
+  computeTarget(p);
+  if (pointTarget[p] == kNull) heapRemove(p);
+  else                         heapUpdate(p);
+}
+
+// ----------------------------------------------------------------------------
+
+bool s_edgeCollapser::isValid(uint32_t p0, uint32_t p1)
+{
+  const glm::vec3 pos0 = points[p0].pos, pos1 = points[p1].pos;
+
+  // validity: link-condition (the common neighbors are the opposite points of the collapsed triangles),
+  // no triangle flip, and the wedges of p0 have a matching wedge in p1 (the seams are kept)
+
+  const uint32_t mark = (markStamp += 2);
+  forEachCorner(p1, [&](uint32_t c)
+  {
+    points[point(_cornerNext(c))].mark = mark;
+    points[point(_cornerPrev(c))].mark = mark;
+  });
+
+  unsigned nShared = 0, nCommon = 0, nMap = 0;
+  bool     valid = true;
+  forEachCorner(p0, [&](uint32_t c)
+  {
+    const uint32_t cn = _cornerNext(c), cp = _cornerPrev(c);
+    const uint32_t qn = point(cn), qp = point(cp);
+    if (points[qn].mark == mark) { points[qn].mark = mark + 1; ++nCommon; }
+    if (points[qp].mark == mark) { points[qp].mark = mark + 1; ++nCommon; }
+    if (qn == p1 || qp == p1)
+    {
+      ++nShared;
+      const uint32_t w0 = triWedge[c];
+      const uint32_t w1 = triWedge[(qn == p1) ? cn : cp];
+      unsigned k = 0;
+      while (k < nMap && wedgeFrom[k] != w0) ++k;
+      if (k == nMap)
+      {
+        if (nMap == 2) { valid = false; return; }
+        wedgeFrom[nMap] = w0;
+        wedgeTo[nMap++] = w1;
       }
-      TRE_ASSERT(duplicated);
-      ++vertexAddOffset;
+      else if (wedgeTo[k] != w1)
+      {
+        valid = false;
+      }
+    }
+    else
+    {
+      valid &= !_isFlipped(pos0, pos1, points[qn].pos, points[qp].pos);
+    }
+  });
+
+  switch (points[p0].kind)
+  {
+    case KIND_MANIFOLD: valid &= (nShared == 2 && nMap == 1); break;
+    case KIND_BORDER:   valid &= (nShared == 1 && nMap == 1); break; // along the border
+    case KIND_SEAM:     valid &= (nShared == 2 && nMap == 2); break; // along the seam
+    default:            valid = false; break;
+  }
+  return valid && nCommon == nShared;
+}
+
+// ----------------------------------------------------------------------------
+
+void s_edgeCollapser::collapse(uint32_t p0, uint32_t p1)
+{
+  // remove the shared triangles, re-map the wedges of p0, and merge the triangle-fans
+
+  uint32_t cornerTail = kNull;
+  forEachCorner(p0, [&](uint32_t c)
+  {
+    cornerTail = c;
+    if (point(_cornerNext(c)) == p1 || point(_cornerPrev(c)) == p1)
+    {
+      corners[c - c % 3].point = kNull;
+      --triangleCount;
+      return;
+    }
+    triWedge[c] = (triWedge[c] == wedgeFrom[0]) ? wedgeTo[0] : wedgeTo[1];
+    corners[c].point = p1;
+  });
+  TRE_ASSERT(cornerTail != kNull && corners[cornerTail].next == kNull);
+  corners[cornerTail].next = pointCornerHead[p1];
+  pointCornerHead[p1] = pointCornerHead[p0];
+  pointCornerHead[p0] = kNull;
+
+  points[p1].quadric.add(points[p0].quadric);
+  points[p0].kind = KIND_LOCKED;
+  pointTarget[p0] = kNull;
+  heapRemove(p0);
+
+  // update the collapses of p1 and of its neighbors.
+  // The neighbors are marked as outdated, and they only compare with the new collapse to p1 that may be cheaper.
+
+  updateTarget(p1);
+  const uint32_t markUpdate = (markStamp += 2);
+  points[p1].mark = markUpdate;
+  const auto fnUpdateNeighbor = [&](uint32_t q)
+  {
+    if (points[q].mark == markUpdate) return;
+    points[q].mark = markUpdate;
+    if (points[q].kind != KIND_MANIFOLD || pointHeapPos[q] == kNull)
+    {
+      updateTarget(q);
+      return;
     }
+    points[q].dirty = true;
+    const float err = collapseError(q, p1);
+    if (err >= pointError[q]) return;
+    pointTarget[q] = p1;
+    pointError[q] = err;
+    heapUpdate(q);
+  };
+  forEachCorner(p1, [&](uint32_t c)
+  {
+    fnUpdateNeighbor(point(_cornerNext(c)));
+    fnUpdateNeighbor(point(_cornerPrev(c)));
+  });
+}
+
+// ----------------------------------------------------------------------------
+
+std::size_t s_edgeCollapser::simplify(std::size_t targetTriangleCount, float maxError)
+{
+  classify();
+
+  // initial heap
+
+  for (uint32_t p = 0, pStop = uint32_t(points.size()); p < pStop; ++p)
+  {
+    computeTarget(p);
+    if (pointTarget[p] == kNull) continue;
+    pointHeapPos[p] = uint32_t(heap.size());
+    heap.push_back(s_heapNode{ pointError[p], p });
   }
+  for (std::size_t i = (heap.size() + 2) / 4; i-- > 0; ) heapSiftDown(uint32_t(i));
 
-  // remove degenerated triangles
+  // collapse
 
-  for (std::size_t iT = 0; iT < Ntri; )
+  const float maxError2 = maxError * maxError;
+  std::size_t nCollapses = 0;
+  while (triangleCount > targetTriangleCount && !heap.empty() && heap.front().error <= maxError2)
   {
-    unsigned &indA = layout.m_index[offsetOut + iT * 3 + 0];
-    unsigned &indB = layout.m_index[offsetOut + iT * 3 + 1];
-    unsigned &indC = layout.m_index[offsetOut + iT * 3 + 2];
-    if (indA == indB || indA == indC || indB == indC)
+    const uint32_t p0 = heap.front().point;
+    if (points[p0].dirty)
     {
-      --Ntri;
-      indA = layout.m_index[offsetOut + Ntri * 3 + 0];
-      indB = layout.m_index[offsetOut + Ntri * 3 + 1];
-      indC = layout.m_index[offsetOut + Ntri * 3 + 2];
+      computeTarget(p0);
+      if (pointTarget[p0] == kNull) { heapRemove(p0); continue; }
     }
-    else
+    if (heap.front().error < pointError[p0]) // outdated key
     {
-      ++iT;
+      heap.front().error = pointError[p0];
+      heapSiftDown(0);
+      continue;
+    }
+    const uint32_t p1 = pointTarget[p0];
+    if (!isValid(p0, p1))
+    {
+      updateTarget(p0); // the neighborhood has changed
+      if (pointTarget[p0] == p1) heapRemove(p0); // link-condition: until its neighborhood changes
+      continue;
     }
+    lastError = pointError[p0];
+    collapse(p0, p1);
+    ++nCollapses;
   }
+  return nCollapses;
+}
 
-  TRE_ASSERT(Ntri * 3 <= countIn);
+// ----------------------------------------------------------------------------
+
+std::size_t decimateQuadric(modelIndexed &model, const std::size_t ipartIn, const std::size_t targetTriangleCount, const float maxError)
+{
+  const s_modelDataLayout &layout = model.layout();
+
+  TRE_ASSERT(layout.m_indexCount > 0); // needed for connectivity
+  TRE_ASSERT(layout.m_vertexCount > 0);
+
+  const std::size_t offsetIn = model.partInfo(ipartIn).m_offset;
+  const std::size_t countIn = model.partInfo(ipartIn).m_size;
+
+  TRE_ASSERT(countIn % 3 == 0);
+  if (countIn == 0 || maxError < 0.f) return std::size_t(-1);
+
+  TRE_LOG("decimateQuadric: processing mesh (Ntri = " << countIn / 3 << ")");
+
+  s_edgeCollapser collapser;
+  collapser.init(layout, offsetIn, countIn);
+  const std::size_t nCollapses = collapser.simplify(targetTriangleCount, maxError);
+
+  std::size_t  vertexAddOffset = 0;
+  const size_t ipartOut = model.createPart(countIn, 0, vertexAddOffset);
+  if (ipartOut == std::size_t(-1)) return std::size_t(-1);
+  const std::size_t offsetOut = model.partInfo(ipartOut).m_offset;
+
+  std::size_t Ntri = 0;
+  for (std::size_t i = 0; i < countIn; i += 3)
+  {
+    if (collapser.corners[i].point == s_edgeCollapser::kNull) continue;
+    layout.m_index[offsetOut + Ntri * 3 + 0] = collapser.wedgeToGlobal[collapser.triWedge[i + 0]];
+    layout.m_index[offsetOut + Ntri * 3 + 1] = collapser.wedgeToGlobal[collapser.triWedge[i + 1]];
+    layout.m_index[offsetOut + Ntri * 3 + 2] = collapser.wedgeToGlobal[collapser.triWedge[i + 2]];
+    ++Ntri;
+  }
+  TRE_ASSERT(Ntri == collapser.triangleCount);
 
   model.resizeRawPart(ipartOut, Ntri * 3); // ok, we're not growing.
 
-  TRE_LOG("decimateVoxel: Completed, Ntriangles = " << Ntri << ", new vertices = " << verticesNew);
+  TRE_LOG("decimateQuadric: Completed, Ntriangles = " << Ntri << ", collapses = " << nCollapses << ", last error = " << std::sqrt(collapser.lastError));
+  (void)nCollapses;
 
   return ipartOut;
 }
@@ -973,22 +2058,22 @@ struct s_tetrahedron
   const glm::vec3 *ptA, *ptB, *ptC, *ptD;
   s_tetrahedron *adjBCD, *adjACD, *adjABD, *adjABC;
   unsigned metadata;
+  unsigned visitStamp; ///< marks the tetrahedron as visited by the current search (cavity, vertex-star, ...)
   float volume;
 
   enum
   {
     kMetaInterior = 1 << 0,
     kMetaExterior = 1 << 1,
-    kMetaHasPoints = 1 << 4,
   };
 
-  s_tetrahedron() : ptA(nullptr), ptB(nullptr), ptC(nullptr), ptD(nullptr), metadata(0)
+  s_tetrahedron() : ptA(nullptr), ptB(nullptr), ptC(nullptr), ptD(nullptr), metadata(0), visitStamp(0)
   {
   }
 
   s_tetrahedron(const glm::vec3 *pa, const glm::vec3 *pb, const glm::vec3 *pc, const glm::vec3 *pd,
                s_tetrahedron *tBCD, s_tetrahedron *tACD, s_tetrahedron *tABD, s_tetrahedron *tABC)
-  : ptA(pa), ptB(pb), ptC(pc), ptD(pd), adjBCD(tBCD), adjACD(tACD), adjABD(tABD), adjABC(tABC), metadata(kMetaHasPoints)
+  : ptA(pa), ptB(pb), ptC(pc), ptD(pd), adjBCD(tBCD), adjACD(tACD), adjABD(tABD), adjABC(tABC), metadata(0), visitStamp(0)
   {
     const glm::vec3 eAB = *pb - *pa;
     const glm::vec3 eAC = *pc - *pa;
@@ -1000,9 +2085,6 @@ struct s_tetrahedron
   bool hasPoint(const glm::vec3 *pt) const { return (ptA == pt) | (ptB == pt) | (ptC == pt) | (ptD == pt); }
   bool hasAdjacant(const s_tetrahedron *other) const { return (adjBCD == other) | (adjACD == other) | (adjABD == other) | (adjABC == other); }
 
-  bool metaContainsPoint() const { return metadata & kMetaHasPoints; }
-  void metaSetNoMorePoints() { metadata &= ~kMetaHasPoints; }
-
   bool metaSideInterior() const { return metadata & kMetaInterior; }
   void metaSetSideInterior() { metadata |= kMetaInterior; }
   bool metaSideExterior() const { return metadata & kMetaExterior; }
@@ -1170,51 +2252,68 @@ struct s_surface
     return glm::dot(normalOut, pInsert - *pt1) / 6.f;
   }
 
-  static void generateOutSurface(const std::vector<s_tetrahedron*> &listTetra, std::vector<s_surface> &listSurf)
+  static void generateOutSurface(const std::vector<s_tetrahedron*> &listTetra, const unsigned stamp, std::vector<s_surface> &listSurf)
   {
-    // find surfaces (n*n algo)
+    // the tetrahedrons of "listTetra" are marked with "stamp": a surface is on the boundary when its neighbor is not marked.
     for (s_tetrahedron *t : listTetra)
     {
-      bool isEdge_BCD = true;
-      bool isEdge_ACD = true;
-      bool isEdge_ABD = true;
-      bool isEdge_ABC = true;
+      TRE_ASSERT(t->visitStamp == stamp);
       s_tetrahedron *tBCD = t->adjBCD;
       s_tetrahedron *tACD = t->adjACD;
       s_tetrahedron *tABD = t->adjABD;
       s_tetrahedron *tABC = t->adjABC;
-      for (const s_tetrahedron *tt : listTetra)
-      {
-        if (tBCD == tt) isEdge_BCD = false;
-        if (tACD == tt) isEdge_ACD = false;
-        if (tABD == tt) isEdge_ABD = false;
-        if (tABC == tt) isEdge_ABC = false;
-      }
-      if (isEdge_BCD) listSurf.push_back(s_surface(t->ptB, t->ptC, t->ptD, tBCD, *t->ptA));
-      if (isEdge_ACD) listSurf.push_back(s_surface(t->ptA, t->ptC, t->ptD, tACD, *t->ptB));
-      if (isEdge_ABD) listSurf.push_back(s_surface(t->ptA, t->ptB, t->ptD, tABD, *t->ptC));
-      if (isEdge_ABC) listSurf.push_back(s_surface(t->ptA, t->ptB, t->ptC, tABC, *t->ptD));
+      if (tBCD == nullptr || tBCD->visitStamp != stamp) listSurf.push_back(s_surface(t->ptB, t->ptC, t->ptD, tBCD, *t->ptA));
+      if (tACD == nullptr || tACD->visitStamp != stamp) listSurf.push_back(s_surface(t->ptA, t->ptC, t->ptD, tACD, *t->ptB));
+      if (tABD == nullptr || tABD->visitStamp != stamp) listSurf.push_back(s_surface(t->ptA, t->ptB, t->ptD, tABD, *t->ptC));
+      if (tABC == nullptr || tABC->visitStamp != stamp) listSurf.push_back(s_surface(t->ptA, t->ptB, t->ptC, tABC, *t->ptD));
     }
   }
 
-  static void computeNeighbors(std::vector<s_surface> &listSurf)
+  /// Entry of the edge hash-table, used to link the surfaces by their edges.
+  struct s_edgeSlot
+  {
+    const glm::vec3 *ptMin, *ptMax;
+    s_surface       *surf;
+  };
+
+  s_surface *&neighborOnEdge(const glm::vec3 *p, const glm::vec3 *q)
+  {
+    TRE_ASSERT(hasPoint(p) && hasPoint(q) && p != q);
+    if (p != pt3 && q != pt3) return surf12;
+    if (p != pt2 && q != pt2) return surf13;
+    return surf23;
+  }
+
+  static void computeNeighbors(std::vector<s_surface> &listSurf, std::vector<s_edgeSlot> &edgeTable)
   {
-    // naive n*n algo
-    for (std::size_t i = 0, count = listSurf.size(); i < count; ++i)
+    // each edge is shared by exactly 2 surfaces: hash the edges (open addressing, linear probing).
+    std::size_t tableSize = 16;
+    while (tableSize < listSurf.size() * 3) tableSize *= 2;
+    tableSize *= 2; // load factor <= 0.5
+    edgeTable.assign(tableSize, s_edgeSlot{nullptr, nullptr, nullptr});
+    const std::size_t tableMask = tableSize - 1;
+
+    for (s_surface &s : listSurf)
     {
-      s_surface &si = listSurf[i];
-      for (std::size_t j = 0; j < i; ++j)
+      for (unsigned iE = 0; iE < 3; ++iE)
       {
-        s_surface &sj = listSurf[j];
-        const unsigned key = (si.pt1 == sj.pt1) * 0x001 | (si.pt1 == sj.pt2) * 0x010 | (si.pt1 == sj.pt3) * 0x100 |
-                         (si.pt2 == sj.pt1) * 0x002 | (si.pt2 == sj.pt2) * 0x020 | (si.pt2 == sj.pt3) * 0x200 |
-                         (si.pt3 == sj.pt1) * 0x004 | (si.pt3 == sj.pt2) * 0x040 | (si.pt3 == sj.pt3) * 0x400;
-        if ((key & 0x111) != 0 && (key & 0x222) != 0) { TRE_ASSERT(si.surf12 == nullptr); si.surf12 = &sj; }
-        if ((key & 0x111) != 0 && (key & 0x444) != 0) { TRE_ASSERT(si.surf13 == nullptr); si.surf13 = &sj; }
-        if ((key & 0x222) != 0 && (key & 0x444) != 0) { TRE_ASSERT(si.surf23 == nullptr); si.surf23 = &sj; }
-        if ((key & 0x007) != 0 && (key & 0x070) != 0) { TRE_ASSERT(sj.surf12 == nullptr); sj.surf12 = &si; }
-        if ((key & 0x007) != 0 && (key & 0x700) != 0) { TRE_ASSERT(sj.surf13 == nullptr); sj.surf13 = &si; }
-        if ((key & 0x070) != 0 && (key & 0x700) != 0) { TRE_ASSERT(sj.surf23 == nullptr); sj.surf23 = &si; }
+        const glm::vec3 *p = (iE == 2) ? s.pt2 : s.pt1;
+        const glm::vec3 *q = (iE == 0) ? s.pt2 : s.pt3;
+        if (q < p) std::swap(p, q);
+        const uint64_t hash = (uint64_t(reinterpret_cast<uintptr_t>(p)) * 0x9E3779B97F4A7C15ull) ^ (uint64_t(reinterpret_cast<uintptr_t>(q)) * 0xC2B2AE3D27D4EB4Full);
+        std::size_t slot = std::size_t(hash >> 32) & tableMask;
+        while (edgeTable[slot].surf != nullptr && (edgeTable[slot].ptMin != p || edgeTable[slot].ptMax != q)) slot = (slot + 1) & tableMask;
+        s_edgeSlot &e = edgeTable[slot];
+        if (e.surf == nullptr)
+        {
+          e = s_edgeSlot{p, q, &s};
+        }
+        else
+        {
+          TRE_ASSERT(s.neighborOnEdge(p, q) == nullptr && e.surf->neighborOnEdge(p, q) == nullptr);
+          s.neighborOnEdge(p, q) = e.surf;
+          e.surf->neighborOnEdge(p, q) = &s;
+        }
       }
     }
     // check (closed surface)
@@ -1256,6 +2355,17 @@ struct s_meshTriangle
 
 // ----------------------------------------------------------------------------
 
+/// Orientation of the tetrahedron (a,b,c,d): 6 times its signed volume (in double precision, the walk must be consistent).
+static double _orient3D(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d)
+{
+  const glm::dvec3 vDA = glm::dvec3(a) - glm::dvec3(d);
+  const glm::dvec3 vDB = glm::dvec3(b) - glm::dvec3(d);
+  const glm::dvec3 vDC = glm::dvec3(c) - glm::dvec3(d);
+  return glm::dot(vDA, glm::cross(vDB, vDC));
+}
+
+// ----------------------------------------------------------------------------
+
 static bool _pointInCircumsphere(const s_tetrahedron &tetra, const glm::vec3 &pt, const float minVolume)
 {
   const glm::vec3 vPA = *tetra.ptA - pt;
@@ -1284,22 +2394,15 @@ static bool _pointInCircumsphere(const s_tetrahedron &tetra, const glm::vec3 &pt
 
 // ----------------------------------------------------------------------------
 
-static bool _checkInsertionValidity(const std::vector<s_tetrahedron *> &listTetra, s_tetrahedron &tAdd, const glm::vec3 &pt, const float minVolume)
+static bool _checkInsertionValidity(const unsigned stamp, s_tetrahedron &tAdd, const glm::vec3 &pt, const float minVolume)
 {
   // Check only surfaces that would be exterior if the tetrahedron is added.
 
-  // get exterior surfaces
-  s_tetrahedron *tadjABC = tAdd.adjABC;
-  s_tetrahedron *tadjABD = tAdd.adjABD;
-  s_tetrahedron *tadjACD = tAdd.adjACD;
-  s_tetrahedron *tadjBCD = tAdd.adjBCD;
-  for (s_tetrahedron *tbis : listTetra)
-  {
-    if      (tbis == tadjABC) tadjABC = nullptr;
-    else if (tbis == tadjABD) tadjABD = nullptr;
-    else if (tbis == tadjACD) tadjACD = nullptr;
-    else if (tbis == tadjBCD) tadjBCD = nullptr;
-  }
+  // get exterior surfaces (the tetrahedrons already in the insertion-geometry are marked with "stamp")
+  s_tetrahedron *tadjABC = (tAdd.adjABC != nullptr && tAdd.adjABC->visitStamp == stamp) ? nullptr : tAdd.adjABC;
+  s_tetrahedron *tadjABD = (tAdd.adjABD != nullptr && tAdd.adjABD->visitStamp == stamp) ? nullptr : tAdd.adjABD;
+  s_tetrahedron *tadjACD = (tAdd.adjACD != nullptr && tAdd.adjACD->visitStamp == stamp) ? nullptr : tAdd.adjACD;
+  s_tetrahedron *tadjBCD = (tAdd.adjBCD != nullptr && tAdd.adjBCD->visitStamp == stamp) ? nullptr : tAdd.adjBCD;
   TRE_ASSERT((tadjABC != nullptr) + (tadjABD != nullptr) + (tadjACD != nullptr) + (tadjBCD != nullptr) < 4);
 
   // check surface ABC
@@ -1323,6 +2426,298 @@ static bool _checkInsertionValidity(const std::vector<s_tetrahedron *> &listTetr
 
 // ----------------------------------------------------------------------------
 
+/// Walk from "tStart" to the tetrahedron that contains "pt" (visibility walk, the face to cross is picked randomly to avoid cycles).
+/// It returns nullptr if the walk leaves the tetrahedrization or does not converge.
+static s_tetrahedron *_locatePoint(s_tetrahedron *tStart, const glm::vec3 &pt, const std::size_t maxSteps, unsigned &randState)
+{
+  s_tetrahedron *t = tStart;
+  for (std::size_t iStep = 0; iStep < maxSteps; ++iStep)
+  {
+    TRE_ASSERT(t->valid());
+    const double orient = _orient3D(*t->ptA, *t->ptB, *t->ptC, *t->ptD);
+    randState = randState * 1664525u + 1013904223u;
+    const unsigned iFaceStart = randState >> 30;
+    bool           isInside = true;
+    for (unsigned k = 0; k < 4; ++k)
+    {
+      const unsigned iFace = (iFaceStart + k) & 3;
+      double         orientFace;
+      s_tetrahedron  *tAdj;
+      switch (iFace)
+      {
+        case 0:  orientFace = _orient3D(pt, *t->ptB, *t->ptC, *t->ptD); tAdj = t->adjBCD; break;
+        case 1:  orientFace = _orient3D(*t->ptA, pt, *t->ptC, *t->ptD); tAdj = t->adjACD; break;
+        case 2:  orientFace = _orient3D(*t->ptA, *t->ptB, pt, *t->ptD); tAdj = t->adjABD; break;
+        default: orientFace = _orient3D(*t->ptA, *t->ptB, *t->ptC, pt); tAdj = t->adjABC; break;
+      }
+      if (orientFace * orient < 0.) // "pt" is behind the face
+      {
+        if (tAdj == nullptr) return nullptr;
+        t = tAdj;
+        isInside = false;
+        break;
+      }
+    }
+    if (isInside) return t;
+  }
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Index along a 3D Hilbert curve, from coordinates on 10 bits (Skilling's algorithm)
+static unsigned _hilbertIndex3D(unsigned x, unsigned y, unsigned z)
+{
+  static constexpr unsigned kBits = 10;
+  unsigned X[3] = { x, y, z };
+  // inverse undo
+  for (unsigned Q = 1u << (kBits - 1); Q > 1; Q >>= 1)
+  {
+    const unsigned P = Q - 1;
+    for (unsigned i = 0; i < 3; ++i)
+    {
+      if (X[i] & Q)
+      {
+        X[0] ^= P;
+      }
+      else
+      {
+        const unsigned t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+  // gray encode
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  unsigned t = 0;
+  for (unsigned Q = 1u << (kBits - 1); Q > 1; Q >>= 1)
+  {
+    if (X[2] & Q) t ^= Q - 1;
+  }
+  X[0] ^= t;
+  X[1] ^= t;
+  X[2] ^= t;
+  // interleave
+  unsigned index = 0;
+  for (unsigned b = kBits; b-- != 0; )
+  {
+    index = (index << 3) | (((X[0] >> b) & 1) << 2) | (((X[1] >> b) & 1) << 1) | ((X[2] >> b) & 1);
+  }
+  return index;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Sort the points in a "Biased Randomized Insertion Order": the points are shuffled and split in rounds of doubling size
+/// (the last round has half of the points), then each round is sorted along a Hilbert curve.
+static void _sortBRIO(std::vector<unsigned> &indices, const s_modelDataLayout::s_vertexData &inPos, const s_boundbox &box)
+{
+  static constexpr std::size_t kRoundMinSize = 64;
+
+  // shuffle (deterministic)
+  uint32_t randState = 0x2545F491u;
+  for (std::size_t i = indices.size(); i-- > 1; )
+  {
+    randState ^= randState << 13;
+    randState ^= randState >> 17;
+    randState ^= randState << 5;
+    std::swap(indices[i], indices[randState % (i + 1)]);
+  }
+
+  // sort the rounds
+  const glm::vec3 boxExtend = box.extend();
+  const glm::vec3 scale = 1023.f / glm::max(boxExtend, glm::vec3(std::numeric_limits<float>::min()));
+
+  std::vector<std::pair<unsigned, unsigned>> keys(indices.size()); // (hilbert-index, point-index)
+  for (std::size_t i = 0; i < indices.size(); ++i)
+  {
+    const glm::vec3 coord = glm::clamp((inPos.get<glm::vec3>(indices[i]) - box.m_min) * scale, glm::vec3(0.f), glm::vec3(1023.f));
+    keys[i] = std::make_pair(_hilbertIndex3D(unsigned(coord.x), unsigned(coord.y), unsigned(coord.z)), indices[i]);
+  }
+
+  std::size_t roundEnd = keys.size();
+  while (roundEnd != 0)
+  {
+    const std::size_t roundStart = (roundEnd > kRoundMinSize) ? roundEnd / 2 : 0;
+    std::sort(keys.begin() + roundStart, keys.begin() + roundEnd);
+    roundEnd = roundStart;
+  }
+
+  for (std::size_t i = 0; i < indices.size(); ++i) indices[i] = keys[i].second;
+}
+
+// ----------------------------------------------------------------------------
+
+/// Contribution of a mesh's triangle to the side-weight of a point (signed apparent-area, weighted by the distance).
+/// The point is interior when the sum over all triangles is positive.
+static float _sideWeight(const s_meshTriangle &tri, const glm::vec3 &pt, const float distOffset)
+{
+  float distToTri;
+  glm::vec3 vFC = pt - *tri.ptF;
+  glm::vec3 vGC = pt - *tri.ptG;
+  glm::vec3 vHC = pt - *tri.ptH;
+  if (glm::dot(glm::cross(tri.edgeNormalizedFG, tri.normal), vFC) <= 0.f &&
+      glm::dot(glm::cross(tri.edgeNormalizedGH, tri.normal), vGC) <= 0.f &&
+      glm::dot(glm::cross(tri.edgeNormalizedHF, tri.normal), vHC) <= 0.f)
+  {
+    distToTri = glm::abs(glm::dot(vFC, tri.normal)); // dist to plane
+  }
+  else
+  {
+    const glm::vec3 vFGC =  glm::clamp(glm::dot(vFC, tri.edgeNormalizedFG), 0.f, 1.f) * tri.edgeNormalizedFG - vFC;
+    const glm::vec3 vGHC =  glm::clamp(glm::dot(vGC, tri.edgeNormalizedGH), 0.f, 1.f) * tri.edgeNormalizedGH - vGC;
+    const glm::vec3 vHFC =  glm::clamp(glm::dot(vHC, tri.edgeNormalizedHF), 0.f, 1.f) * tri.edgeNormalizedHF - vHC;
+    distToTri = std::sqrt(std::min(glm::dot(vFGC,vFGC), std::min(glm::dot(vGHC,vGHC), glm::dot(vHFC,vHFC)))); // dist to edge
+  }
+
+  const float		areaSigned = (glm::dot(tri.normal, vFC) < 0.f) ? 1.f : -1.f;
+
+  vFC = glm::normalize(vFC);
+  vGC = glm::normalize(vGC);
+  vHC = glm::normalize(vHC);
+  const float		areaSeen = glm::length(glm::cross(vGC - vFC, vHC- vFC));
+
+  return areaSeen * areaSigned / (distToTri + distOffset);
+}
+
+// ----------------------------------------------------------------------------
+
+/// Bounding-volume hierarchy over the mesh's triangles, used to evaluate the side-weight of many points.
+/// Far from a node (or from a triangle), its triangles are replaced by their sum of area-weighted normals (far-field approximation).
+struct s_meshTriangleTree
+{
+  struct s_cluster
+  {
+    glm::vec3 center;     ///< area-weighted center of the triangles
+    glm::vec3 areaNormal; ///< sum of the area-weighted normals
+    float     radius;     ///< radius of the sphere, around "center", that contains the triangles
+
+    float farWeight(const glm::vec3 &pt, const float distOffset, bool &isFar) const
+    {
+      const glm::vec3 vCP = pt - center;
+      const float     d2 = glm::dot(vCP, vCP);
+      isFar = d2 > kFarFactor * kFarFactor * radius * radius;
+      if (!isFar) return 0.f;
+      const float d = std::sqrt(d2);
+      return -2.f * glm::dot(areaNormal, vCP) / (d2 * d * (d + distOffset));
+    }
+  };
+
+  struct s_node : s_cluster
+  {
+    unsigned first; ///< first triangle (leaf) or first child (node)
+    unsigned count; ///< triangle count (leaf) or 0 (node)
+  };
+
+  struct s_triangle : s_cluster
+  {
+    const s_meshTriangle *tri;
+  };
+
+  static constexpr unsigned kLeafSize = 8;
+  static constexpr float    kFarFactor = 2.f; ///< the far-field approximation is used when the distance is greater than kFarFactor * radius
+
+  std::vector<s_node>     nodes;
+  std::vector<s_triangle> triangles;
+
+  void build(const std::vector<s_meshTriangle> &listTri, const std::size_t count)
+  {
+    nodes.clear();
+    triangles.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      const s_meshTriangle &tri = listTri[i];
+      s_triangle           &t = triangles[i];
+      t.tri = &tri;
+      t.center = (*tri.ptF + *tri.ptG + *tri.ptH) / 3.f;
+      t.areaNormal = (0.5f * glm::length(glm::cross(*tri.ptG - *tri.ptF, *tri.ptH - *tri.ptF))) * tri.normal;
+      t.radius = std::sqrt(std::max(glm::dot(*tri.ptF - t.center, *tri.ptF - t.center), std::max(glm::dot(*tri.ptG - t.center, *tri.ptG - t.center), glm::dot(*tri.ptH - t.center, *tri.ptH - t.center))));
+    }
+    if (count == 0) return;
+    nodes.reserve(2 * (count / kLeafSize + 1));
+    nodes.push_back(s_node());
+    _buildNode(0, 0, unsigned(count));
+  }
+
+  float sideWeight(const glm::vec3 &pt, const float distOffset) const
+  {
+    if (nodes.empty()) return 0.f;
+    float                      w = 0.f;
+    bool                       isFar;
+    arrayCounted<unsigned, 64> stack; // (the tree is balanced)
+    stack.push_back(0);
+    while (!stack.emptyCounted())
+    {
+      const s_node &node = nodes[stack.pop_back()];
+      w += node.farWeight(pt, distOffset, isFar);
+      if (isFar) continue;
+      if (node.count != 0)
+      {
+        for (unsigned i = node.first, iStop = node.first + node.count; i < iStop; ++i)
+        {
+          w += triangles[i].farWeight(pt, distOffset, isFar);
+          if (!isFar) w += _sideWeight(*triangles[i].tri, pt, distOffset);
+        }
+      }
+      else
+      {
+        stack.push_back(node.first);
+        stack.push_back(node.first + 1);
+      }
+    }
+    return w;
+  }
+
+private:
+  void _buildNode(const unsigned inode, const unsigned first, const unsigned last)
+  {
+    glm::vec3  center = glm::vec3(0.f);
+    glm::vec3  areaNormal = glm::vec3(0.f);
+    float      areaSum = 0.f;
+    s_boundbox boxCenters;
+    for (unsigned i = first; i < last; ++i)
+    {
+      const float area = glm::length(triangles[i].areaNormal);
+      center += area * triangles[i].center;
+      areaNormal += triangles[i].areaNormal;
+      areaSum += area;
+      boxCenters.addPointInBox(triangles[i].center);
+    }
+    center = (areaSum > 0.f) ? center / areaSum : boxCenters.center();
+    float radius = 0.f;
+    for (unsigned i = first; i < last; ++i) radius = std::max(radius, glm::length(triangles[i].center - center) + triangles[i].radius);
+    nodes[inode].center = center;
+    nodes[inode].areaNormal = areaNormal;
+    nodes[inode].radius = radius;
+
+    if (last - first <= kLeafSize)
+    {
+      nodes[inode].first = first;
+      nodes[inode].count = last - first;
+      return;
+    }
+
+    // split at the median, along the largest axis
+    const glm::vec3 extend = boxCenters.extend();
+    const unsigned  axis = (extend.x >= extend.y && extend.x >= extend.z) ? 0 : (extend.y >= extend.z) ? 1 : 2;
+    const unsigned  middle = (first + last) / 2;
+    std::nth_element(triangles.begin() + first, triangles.begin() + middle, triangles.begin() + last,
+                     [axis](const s_triangle &a, const s_triangle &b) { return a.center[axis] < b.center[axis]; });
+
+    const unsigned ichild = unsigned(nodes.size());
+    nodes[inode].first = ichild;
+    nodes[inode].count = 0;
+    nodes.push_back(s_node());
+    nodes.push_back(s_node());
+    _buildNode(ichild, first, middle);
+    _buildNode(ichild + 1, middle, last);
+  }
+};
+
+// ----------------------------------------------------------------------------
+
 #ifdef MESH_DEBUG
 
 struct s_tetraReporter
@@ -1519,8 +2914,6 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
   const glm::vec3 boxMin = part.m_bbox.m_min - 0.2f * boxExtend;
   const glm::vec3 boxMax = part.m_bbox.m_max + 0.2f * boxExtend;
 
-  const float tetraMinVolume = boxVolume * 1.e-7f;
-
   // record the input triangles
 
   std::vector<s_meshTriangle> inTriangles;
@@ -1551,6 +2944,8 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
   if (indices.size() < 3) return false;
 
   const std::size_t indicesInitialSize = indices.size();
+
+  const float tetraMinVolume = boxVolume * 1.e-7f / float(indicesInitialSize); // (relative to the mean volume per point)
   TRE_LOG("tetrahedralize (1/4): will process " << indicesInitialSize << " points (over a part of " << part.m_size / 3 << " triangles)");
 
   // index remapper
@@ -1588,70 +2983,57 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
 
   // main-step 1: Delaunay triangulation (based on Bowyer-Watson algorithm) without surface-constrain
 
-  std::vector<s_tetrahedron*> listTetraToProcess;
-  std::vector<s_tetrahedron*> listTetraNew;
-  std::vector<s_surface>      listSurface;
+  std::vector<s_tetrahedron*>         listTetraToProcess;
+  std::vector<s_tetrahedron*>         listTetraNew;
+  std::vector<s_tetrahedron*>         listTetraFree; // cleared tetrahedrons in "listTetra", re-used by the next insertions
+  std::vector<s_surface>              listSurface;
+  std::vector<s_surface::s_edgeSlot>  surfaceEdgeTable;
+
+  unsigned visitStamp = 0; // the tetrahedrons of the current search are marked with it
+  unsigned locateRandState = 0;
 
   std::size_t indicesFailedCount = 0;
 
-  while (!indices.empty())
+  // -> insert the points in the BRIO order, thus the tetrahedron that contains the next point is found by walking from the last inserted tetrahedron.
+  _sortBRIO(indices, inPos, part.m_bbox);
+
+  s_tetrahedron *tetraLastInserted = &listTetra[4];
+  std::size_t    iPoint = 0;
+
+  for (; iPoint < indices.size(); ++iPoint)
   {
-    // get a point to add
-    const glm::vec3 *pt = nullptr;
+    const glm::vec3 *pt = &inPos.get<glm::vec3>(indices[iPoint]);
 
+    // -> locate the point
+    s_tetrahedron *tContainer = _locatePoint(tetraLastInserted, *pt, listTetra.size(), locateRandState);
+    if (tContainer == nullptr)
     {
-      // -> loop over existing tetrahedra, and get the biggest with points inside.
-      s_tetrahedron *tBest = nullptr;
+      // the walk failed (numerical issue). Loop over the tetrahedrons.
       for (std::size_t iT = 0; iT < listTetra.size(); ++iT)
       {
         s_tetrahedron &t = listTetra[iT];
-        if (!t.metaContainsPoint()) continue;
-        if (tBest == nullptr || tBest->volume < t.volume) tBest = &t;
-      }
-      if (tBest == nullptr) break; // no tetra ?? exit.
-
-      // -> loop over points, and get the best one
-      std::size_t      iptBest = std::size_t(-1);
-      const glm::vec3 *ptBest = nullptr;
-      float            d2Best = std::numeric_limits<float>::infinity();
-      bool             tHasPoint = false;
-
-      const glm::vec3  tetraCenter = 0.25f * (*tBest->ptA + *tBest->ptB + *tBest->ptC + *tBest->ptD);
-      const glm::mat3  transf = glm::mat3(*tBest->ptB - *tBest->ptA, *tBest->ptC - *tBest->ptA, *tBest->ptD - *tBest->ptA); // copy from s_contact3D::point_treta
-      TRE_ASSERT(std::abs(glm::determinant(transf)) > 1.e-12f); // fast but unsafe if the tetrahedron is degenerated.
-      const glm::mat3  transfInv = glm::inverse(transf);
-
-      for (std::size_t iP = 0; iP < indices.size(); ++iP)
-      {
-        const glm::vec3 *p = &inPos.get<glm::vec3>(indices[iP]);
-        const float     d2 = glm::dot(tetraCenter - *p, tetraCenter - *p);
-        const bool      isBetter = (d2 < d2Best);
-        if (tHasPoint && !isBetter) continue;
-        const glm::vec3 coordUVW = transfInv * (*p - *tBest->ptA);
-        const bool      isInside = !((glm::any(glm::lessThan(coordUVW, glm::vec3(0.f))) || (coordUVW.x + coordUVW.y + coordUVW.z) > 1.f));
-        tHasPoint |= isInside;
-        if (isBetter && isInside)
+        if (!t.valid()) continue;
+        const double orient = _orient3D(*t.ptA, *t.ptB, *t.ptC, *t.ptD);
+        if (_orient3D(*pt, *t.ptB, *t.ptC, *t.ptD) * orient >= 0. && _orient3D(*t.ptA, *pt, *t.ptC, *t.ptD) * orient >= 0. &&
+            _orient3D(*t.ptA, *t.ptB, *pt, *t.ptD) * orient >= 0. && _orient3D(*t.ptA, *t.ptB, *t.ptC, *pt) * orient >= 0.)
         {
-          iptBest = iP;
-          ptBest = p;
-          d2Best = d2;
+          tContainer = &t;
+          break;
         }
       }
-      if (!tHasPoint)
-      {
-        tBest->metaSetNoMorePoints();
-        continue; // go to the next iteration
-      }
-
-      // ok
-      TRE_ASSERT(std::isfinite(d2Best));
-      listTetraToProcess.clear();
-      listTetraToProcess.push_back(tBest);
-      pt = ptBest;
-      indices[iptBest] = indices.back(); indices.pop_back(); // remove the index from the list
+    }
+    if (tContainer == nullptr)
+    {
+      exporter.report_Step1_Fail({}, nullptr, *pt, 98);
+      indexRemapper[_indP(pt) - indexRemapperOffset] = unsigned(-1);
+      ++indicesFailedCount;
+      continue; // the point is outside ?? go to the next point
     }
 
-    TRE_ASSERT(listTetraToProcess.size() == 1);
+    ++visitStamp;
+    listTetraToProcess.clear();
+    listTetraToProcess.push_back(tContainer);
+    tContainer->visitStamp = visitStamp;
 
     // -> prepare the insertion geometry
     s_tetrahedron &tRoot = *listTetraToProcess[0];
@@ -1716,21 +3098,14 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
         for (std::size_t i = queueStart; i < queueEnd; ++i)
         {
           s_tetrahedron &t = *listTetraToProcess[i];
-          s_tetrahedron *tadjABC = t.adjABC;
-          s_tetrahedron *tadjABD = t.adjABD;
-          s_tetrahedron *tadjACD = t.adjACD;
-          s_tetrahedron *tadjBCD = t.adjBCD;
-          for (s_tetrahedron *tbis : listTetraToProcess)
+          for (s_tetrahedron *tadj : { t.adjABC, t.adjABD, t.adjACD, t.adjBCD })
           {
-            if      (tbis == tadjABC) tadjABC = nullptr;
-            else if (tbis == tadjABD) tadjABD = nullptr;
-            else if (tbis == tadjACD) tadjACD = nullptr;
-            else if (tbis == tadjBCD) tadjBCD = nullptr;
+            if (tadj != nullptr && tadj->visitStamp != visitStamp && tadj->hasPoint(ptEdge1) && tadj->hasPoint(ptEdge2))
+            {
+              tadj->visitStamp = visitStamp;
+              listTetraToProcess.push_back(tadj);
+            }
           }
-          if (tadjABC != nullptr && tadjABC->hasPoint(ptEdge1) && tadjABC->hasPoint(ptEdge2)) listTetraToProcess.push_back(tadjABC);
-          if (tadjABD != nullptr && tadjABD->hasPoint(ptEdge1) && tadjABD->hasPoint(ptEdge2)) listTetraToProcess.push_back(tadjABD);
-          if (tadjACD != nullptr && tadjACD->hasPoint(ptEdge1) && tadjACD->hasPoint(ptEdge2)) listTetraToProcess.push_back(tadjACD);
-          if (tadjBCD != nullptr && tadjBCD->hasPoint(ptEdge1) && tadjBCD->hasPoint(ptEdge2)) listTetraToProcess.push_back(tadjBCD);
         }
         queueStart = queueEnd;
         queueEnd = listTetraToProcess.size();
@@ -1743,6 +3118,7 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
       else if (onSurfACD)   listTetraToProcess.push_back(tRoot.adjACD);
       else  /*(onSurfBCD)*/ listTetraToProcess.push_back(tRoot.adjBCD);
       TRE_ASSERT(listTetraToProcess.back() != nullptr);
+      listTetraToProcess.back()->visitStamp = visitStamp;
     }
 
     // -> generate the insertion-geometry (add tetra by checking for neighbors recursively)
@@ -1753,32 +3129,21 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
       for (std::size_t i = queueStart; i < queueEnd; ++i)
       {
         s_tetrahedron &t = *listTetraToProcess[i];
-        s_tetrahedron *tadjABC = t.adjABC;
-        s_tetrahedron *tadjABD = t.adjABD;
-        s_tetrahedron *tadjACD = t.adjACD;
-        s_tetrahedron *tadjBCD = t.adjBCD;
-        for (s_tetrahedron *tbis : listTetraToProcess)
+        for (s_tetrahedron *tadj : { t.adjABC, t.adjABD, t.adjACD, t.adjBCD })
         {
-          if      (tbis == tadjABC) tadjABC = nullptr;
-          else if (tbis == tadjABD) tadjABD = nullptr;
-          else if (tbis == tadjACD) tadjACD = nullptr;
-          else if (tbis == tadjBCD) tadjBCD = nullptr;
+          if (tadj != nullptr && tadj->visitStamp != visitStamp && _pointInCircumsphere(*tadj, *pt, tetraMinVolume) && _checkInsertionValidity(visitStamp, *tadj, *pt, tetraMinVolume))
+          {
+            tadj->visitStamp = visitStamp;
+            listTetraToProcess.push_back(tadj);
+          }
         }
-        if (tadjABC != nullptr && _pointInCircumsphere(*tadjABC, *pt, tetraMinVolume) && _checkInsertionValidity(listTetraToProcess, *tadjABC, *pt, tetraMinVolume))
-          listTetraToProcess.push_back(tadjABC);
-        if (tadjABD != nullptr && _pointInCircumsphere(*tadjABD, *pt, tetraMinVolume) && _checkInsertionValidity(listTetraToProcess, *tadjABD, *pt, tetraMinVolume))
-          listTetraToProcess.push_back(tadjABD);
-        if (tadjACD != nullptr && _pointInCircumsphere(*tadjACD, *pt, tetraMinVolume) && _checkInsertionValidity(listTetraToProcess, *tadjACD, *pt, tetraMinVolume))
-          listTetraToProcess.push_back(tadjACD);
-        if (tadjBCD != nullptr && _pointInCircumsphere(*tadjBCD, *pt, tetraMinVolume) && _checkInsertionValidity(listTetraToProcess, *tadjBCD, *pt, tetraMinVolume))
-          listTetraToProcess.push_back(tadjBCD);
       }
       queueStart = queueEnd;
       queueEnd = listTetraToProcess.size();
     }
 
     listSurface.clear();
-    s_surface::generateOutSurface(listTetraToProcess, listSurface);
+    s_surface::generateOutSurface(listTetraToProcess, visitStamp, listSurface);
 
     // -> final check of the insertion-geometry
     bool isInsertionGeomValid = true;
@@ -1798,22 +3163,30 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
       continue; // insertion failed with this point
     }
 
-    s_surface::computeNeighbors(listSurface);
+    s_surface::computeNeighbors(listSurface, surfaceEdgeTable);
 
     const std::size_t nOldTetra = listTetraToProcess.size();
     const std::size_t nSurf = listSurface.size();
 
-    // -> compute pointers in which new tetrahedra will be created
+    // -> compute pointers in which new tetrahedra will be created (re-use the old ones, then the free ones)
     TRE_ASSERT(listTetraNew.empty());
     listTetraNew.resize(nSurf, nullptr);
     {
       const std::size_t m = std::min(nSurf, nOldTetra);
-      const std::size_t listTetraPrevSize = listTetra.size();
-      listTetra.resize(listTetraPrevSize + nSurf - m);
       for (std::size_t iTnew = 0; iTnew < m; ++iTnew)
         listTetraNew[iTnew] = listTetraToProcess[iTnew];
-      for (std::size_t iTnew = m, iTmain = listTetraPrevSize; iTnew < nSurf; ++iTnew, ++iTmain)
+      std::size_t iTnew = m;
+      for (; iTnew < nSurf && !listTetraFree.empty(); ++iTnew)
+      {
+        listTetraNew[iTnew] = listTetraFree.back();
+        listTetraFree.pop_back();
+      }
+      const std::size_t listTetraPrevSize = listTetra.size();
+      listTetra.resize(listTetraPrevSize + nSurf - iTnew);
+      for (std::size_t iTmain = listTetraPrevSize; iTnew < nSurf; ++iTnew, ++iTmain)
         listTetraNew[iTnew] = &listTetra[iTmain];
+      for (std::size_t iTold = m; iTold < nOldTetra; ++iTold)
+        listTetraFree.push_back(listTetraToProcess[iTold]);
     }
 
     for (s_tetrahedron *t : listTetraToProcess) *t = s_tetrahedron();
@@ -1836,34 +3209,18 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
     }
 
     listSurface.clear();
+    tetraLastInserted = listTetraNew[0];
     listTetraNew.clear();
 
-    if (nSurf < nOldTetra)
+    if ((listTetra.size() - listTetraFree.size()) / 2 >= maxTetraCount)
     {
-      // re-pack "listTetra"
-      for (std::size_t iT = listTetra.size(); iT-- != 0; )
-      {
-        if (!listTetra[iT].valid())
-        {
-          const std::size_t jT = listTetra.size() - 1;
-          if (iT != jT)
-          {
-            // move listTetra[jT] into listTetra[iT]
-            listTetra[iT] = listTetra[jT];
-            if (listTetra[iT].adjABC != nullptr) listTetra[iT].adjABC->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
-            if (listTetra[iT].adjABD != nullptr) listTetra[iT].adjABD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
-            if (listTetra[iT].adjACD != nullptr) listTetra[iT].adjACD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
-            if (listTetra[iT].adjBCD != nullptr) listTetra[iT].adjBCD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
-          }
-          listTetra[jT] = s_tetrahedron();
-          listTetra.resize(jT);
-        }
-      }
+      ++iPoint;
+      break;
     }
-
-    if (listTetra.size() / 2 >= maxTetraCount) break;
   }
 
+  indices.erase(indices.begin(), indices.begin() + iPoint); // remaining points
+
   if (!indices.empty())
   {
     for (unsigned ind : indices) exporter.report_Step1_Fail({}, nullptr, inPos.get<glm::vec3>(ind), 99);
@@ -1872,6 +3229,30 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
     indices.clear();
   }
 
+  // -> re-pack "listTetra"
+  if (!listTetraFree.empty())
+  {
+    for (std::size_t iT = listTetra.size(); iT-- != 0; )
+    {
+      if (!listTetra[iT].valid())
+      {
+        const std::size_t jT = listTetra.size() - 1;
+        if (iT != jT)
+        {
+          // move listTetra[jT] into listTetra[iT]
+          listTetra[iT] = listTetra[jT];
+          if (listTetra[iT].adjABC != nullptr) listTetra[iT].adjABC->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
+          if (listTetra[iT].adjABD != nullptr) listTetra[iT].adjABD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
+          if (listTetra[iT].adjACD != nullptr) listTetra[iT].adjACD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
+          if (listTetra[iT].adjBCD != nullptr) listTetra[iT].adjBCD->replaceNeigbourTetra(&listTetra[jT], &listTetra[iT]);
+        }
+        listTetra[jT] = s_tetrahedron();
+        listTetra.resize(jT);
+      }
+    }
+    listTetraFree.clear();
+  }
+
   for (std::size_t iS = 0; iS < listTetra.size(); ++iS)
   {
     TRE_ASSERT(listTetra[iS].valid());
@@ -1881,6 +3262,20 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
 
   // main-step 2: Apply surface-constrain (with topologie)
 
+  // -> a tetrahedron per vertex, to find the tetrahedrons around the mesh's triangles
+  std::vector<s_tetrahedron*> vertexToTetra(indexRemapperSize, nullptr);
+
+  const auto fnUpdateVertexToTetra = [&](s_tetrahedron *t)
+  {
+    for (const glm::vec3 *p : { t->ptA, t->ptB, t->ptC, t->ptD })
+    {
+      const unsigned ind = _indP(p) - indexRemapperOffset;
+      if (ind < indexRemapperSize && &inPos.get<glm::vec3>(ind + indexRemapperOffset) == p) vertexToTetra[ind] = t;
+    }
+  };
+
+  for (std::size_t iT = 0; iT < listTetra.size(); ++iT) fnUpdateVertexToTetra(&listTetra[iT]);
+
   std::size_t Ntriangles = inTriangles.size();
   std::size_t NtrianglesDirectMatch = 0;
 
@@ -1912,17 +3307,38 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
     if ((indF | indG | indH) == unsigned(-1))
       continue; // the mesh's triangle cannot be reconstructed. Skip it.
 
+    // -> loop over the tetrahedrons around the triangle's vertices
     unsigned keyBest = 0;
-    for (std::size_t iT = 0; iT < listTetra.size(); ++iT)
+    ++visitStamp;
+    listTetraToProcess.clear();
+    for (const glm::vec3 *pV : { tri.ptF, tri.ptG, tri.ptH })
     {
-      s_tetrahedron &t = listTetra[iT];
-      TRE_ASSERT(t.valid());
-      const unsigned key = t.hasPoint(tri.ptF) + t.hasPoint(tri.ptG) + t.hasPoint(tri.ptH);
-      if (key > keyBest)
+      if (keyBest == 3) break;
+      const unsigned indV = _indP(pV) - indexRemapperOffset;
+      s_tetrahedron *tV = (indV < indexRemapperSize) ? vertexToTetra[indV] : nullptr;
+      if (tV == nullptr || tV->visitStamp == visitStamp) continue;
+      TRE_ASSERT(tV->hasPoint(pV));
+      const std::size_t queueStart = listTetraToProcess.size();
+      tV->visitStamp = visitStamp;
+      listTetraToProcess.push_back(tV);
+      for (std::size_t i = queueStart; i < listTetraToProcess.size() && keyBest < 3; ++i)
       {
-        tri.tetraNearby = &t;
-        keyBest = key;
-        if (key == 3) break;
+        s_tetrahedron &t = *listTetraToProcess[i];
+        TRE_ASSERT(t.valid());
+        const unsigned key = t.hasPoint(tri.ptF) + t.hasPoint(tri.ptG) + t.hasPoint(tri.ptH);
+        if (key > keyBest)
+        {
+          tri.tetraNearby = &t;
+          keyBest = key;
+        }
+        for (s_tetrahedron *tadj : { t.adjABC, t.adjABD, t.adjACD, t.adjBCD })
+        {
+          if (tadj != nullptr && tadj->visitStamp != visitStamp && tadj->hasPoint(pV))
+          {
+            tadj->visitStamp = visitStamp;
+            listTetraToProcess.push_back(tadj);
+          }
+        }
       }
     }
 
@@ -1956,34 +3372,22 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
       }
 
       // gather candidate tetras around "pt1"
+      ++visitStamp;
       listTetraToProcess.clear();
       listTetraToProcess.push_back(tri.tetraNearby);
+      tri.tetraNearby->visitStamp = visitStamp;
       {
-        std::size_t queueStart = 0;
-        std::size_t queueEnd   = listTetraToProcess.size();
-        while (queueStart < queueEnd)
+        for (std::size_t i = 0; i < listTetraToProcess.size(); ++i)
         {
-          for (std::size_t i = queueStart; i < queueEnd; ++i)
+          s_tetrahedron &t = *listTetraToProcess[i];
+          for (s_tetrahedron *tadj : { t.adjABC, t.adjABD, t.adjACD, t.adjBCD })
           {
-            s_tetrahedron &t = *listTetraToProcess[i];
-            s_tetrahedron *tadjABC = t.adjABC;
-            s_tetrahedron *tadjABD = t.adjABD;
-            s_tetrahedron *tadjACD = t.adjACD;
-            s_tetrahedron *tadjBCD = t.adjBCD;
-            for (s_tetrahedron *tbis : listTetraToProcess)
+            if (tadj != nullptr && tadj->visitStamp != visitStamp && tadj->hasPoint(pt1))
             {
-              if      (tbis == tadjABC) tadjABC = nullptr;
-              else if (tbis == tadjABD) tadjABD = nullptr;
-              else if (tbis == tadjACD) tadjACD = nullptr;
-              else if (tbis == tadjBCD) tadjBCD = nullptr;
+              tadj->visitStamp = visitStamp;
+              listTetraToProcess.push_back(tadj);
             }
-            if (tadjABC != nullptr && tadjABC->hasPoint(pt1)) listTetraToProcess.push_back(tadjABC);
-            if (tadjABD != nullptr && tadjABD->hasPoint(pt1)) listTetraToProcess.push_back(tadjABD);
-            if (tadjACD != nullptr && tadjACD->hasPoint(pt1)) listTetraToProcess.push_back(tadjACD);
-            if (tadjBCD != nullptr && tadjBCD->hasPoint(pt1)) listTetraToProcess.push_back(tadjBCD);
           }
-          queueStart = queueEnd;
-          queueEnd = listTetraToProcess.size();
         }
 
         // check if the edge exists in another nearby tetra.
@@ -2028,6 +3432,9 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
           listTetra.push_back(s_tetrahedron());
           s_tetrahedron *t3 = &listTetra[listTetra.size()-1];
           s_tetrahedron::split_2tetras_to_3tetras(*t1, *t2, *t3);
+          fnUpdateVertexToTetra(t1);
+          fnUpdateVertexToTetra(t2);
+          fnUpdateVertexToTetra(t3);
           listTetraToProcess.push_back(t3);
           exporter.report_Step2({t1, t2, t3}, *pt1, *pt2, "EdgeCREATEDSplit");
           tri.tetraNearby = t1;
@@ -2046,6 +3453,10 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
           {
             s_tetrahedron::conformSharedPoints(*tS1, *tS2);
             s_tetrahedron::swap_Pyramid(*t1, *t2, *tS1, *tS2);
+            fnUpdateVertexToTetra(t1);
+            fnUpdateVertexToTetra(t2);
+            fnUpdateVertexToTetra(tS1);
+            fnUpdateVertexToTetra(tS2);
             exporter.report_Step2({t1, t2, tS1, tS2}, *pt1, *pt2, "EdgeCREATEDSwap");
             tri.tetraNearby = t1;
             break; // loop on tetra
@@ -2081,8 +3492,10 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
       // gather all tetras that contain at least one triangle-point.
       unsigned      keyBest = 0;
       s_tetrahedron *tetraBest = nullptr;
+      ++visitStamp;
       listTetraToProcess.clear();
       listTetraToProcess.push_back(tri.tetraNearby);
+      tri.tetraNearby->visitStamp = visitStamp;
       {
         std::size_t queueStart = 0;
         std::size_t queueEnd   = listTetraToProcess.size();
@@ -2091,25 +3504,18 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
           for (std::size_t i = queueStart; i < queueEnd; ++i)
           {
             s_tetrahedron &t = *listTetraToProcess[i];
-            s_tetrahedron *tadjABC = t.adjABC;
-            s_tetrahedron *tadjABD = t.adjABD;
-            s_tetrahedron *tadjACD = t.adjACD;
-            s_tetrahedron *tadjBCD = t.adjBCD;
-            for (s_tetrahedron *tbis : listTetraToProcess)
-            {
-              if      (tbis == tadjABC) tadjABC = nullptr;
-              else if (tbis == tadjABD) tadjABD = nullptr;
-              else if (tbis == tadjACD) tadjACD = nullptr;
-              else if (tbis == tadjBCD) tadjBCD = nullptr;
-            }
+            s_tetrahedron *tadjABC = (t.adjABC != nullptr && t.adjABC->visitStamp != visitStamp) ? t.adjABC : nullptr;
+            s_tetrahedron *tadjABD = (t.adjABD != nullptr && t.adjABD->visitStamp != visitStamp) ? t.adjABD : nullptr;
+            s_tetrahedron *tadjACD = (t.adjACD != nullptr && t.adjACD->visitStamp != visitStamp) ? t.adjACD : nullptr;
+            s_tetrahedron *tadjBCD = (t.adjBCD != nullptr && t.adjBCD->visitStamp != visitStamp) ? t.adjBCD : nullptr;
             const unsigned keyABC = (tadjABC != nullptr) ? tadjABC->hasPoint(tri.ptF) + tadjABC->hasPoint(tri.ptG) + tadjABC->hasPoint(tri.ptH) : 0;
             const unsigned keyABD = (tadjABD != nullptr) ? tadjABD->hasPoint(tri.ptF) + tadjABD->hasPoint(tri.ptG) + tadjABD->hasPoint(tri.ptH) : 0;
             const unsigned keyACD = (tadjACD != nullptr) ? tadjACD->hasPoint(tri.ptF) + tadjACD->hasPoint(tri.ptG) + tadjACD->hasPoint(tri.ptH) : 0;
             const unsigned keyBCD = (tadjBCD != nullptr) ? tadjBCD->hasPoint(tri.ptF) + tadjBCD->hasPoint(tri.ptG) + tadjBCD->hasPoint(tri.ptH) : 0;
-            if (keyABC != 0) listTetraToProcess.push_back(tadjABC);
-            if (keyABD != 0) listTetraToProcess.push_back(tadjABD);
-            if (keyACD != 0) listTetraToProcess.push_back(tadjACD);
-            if (keyBCD != 0) listTetraToProcess.push_back(tadjBCD);
+            if (keyABC != 0) { tadjABC->visitStamp = visitStamp; listTetraToProcess.push_back(tadjABC); }
+            if (keyABD != 0) { tadjABD->visitStamp = visitStamp; listTetraToProcess.push_back(tadjABD); }
+            if (keyACD != 0) { tadjACD->visitStamp = visitStamp; listTetraToProcess.push_back(tadjACD); }
+            if (keyBCD != 0) { tadjBCD->visitStamp = visitStamp; listTetraToProcess.push_back(tadjBCD); }
             if (keyABC > keyBest) { keyBest = keyABC; tetraBest = tadjABC; }
             if (keyABD > keyBest) { keyBest = keyABD; tetraBest = tadjABD; }
             if (keyACD > keyBest) { keyBest = keyACD; tetraBest = tadjACD; }
@@ -2149,49 +3555,23 @@ bool tetrahedralize(modelIndexed &model, const std::size_t ipartIn, std::size_t
 
   // main-step 3: Compute where belongs tetrahedrons
 
-  for (std::size_t iT = 0; iT < listTetra.size(); ++iT)
-  {
-    s_tetrahedron &t = listTetra[iT];
-
-    const glm::vec3 center = 0.25f * (*t.ptA + *t.ptB + *t.ptC + *t.ptD);
+  s_meshTriangleTree triangleTree;
+  triangleTree.build(inTriangles, Ntriangles);
 
-    float w = 0.f; // signed apparent-area
-
-    for (std::size_t jT = 0; jT < Ntriangles; ++jT)
+  parallelFor(listTetra.size(), 256, [&](std::size_t iBegin, std::size_t iEnd)
+  {
+    for (std::size_t iT = iBegin; iT < iEnd; ++iT)
     {
-      const s_meshTriangle &tri = inTriangles[jT];
-
-      float distToTri;
-      glm::vec3 vFC = center - *tri.ptF;
-      glm::vec3 vGC = center - *tri.ptG;
-      glm::vec3 vHC = center - *tri.ptH;
-      if (glm::dot(glm::cross(tri.edgeNormalizedFG, tri.normal), vFC) <= 0.f &&
-          glm::dot(glm::cross(tri.edgeNormalizedGH, tri.normal), vGC) <= 0.f &&
-          glm::dot(glm::cross(tri.edgeNormalizedHF, tri.normal), vHC) <= 0.f)
-      {
-        distToTri = glm::abs(glm::dot(vFC, tri.normal)); // dist to plane
-      }
-      else
-      {
-        const glm::vec3 vFGC =  glm::clamp(glm::dot(vFC, tri.edgeNormalizedFG), 0.f, 1.f) * tri.edgeNormalizedFG - vFC;
-        const glm::vec3 vGHC =  glm::clamp(glm::dot(vGC, tri.edgeNormalizedGH), 0.f, 1.f) * tri.edgeNormalizedGH - vGC;
-        const glm::vec3 vHFC =  glm::clamp(glm::dot(vHC, tri.edgeNormalizedHF), 0.f, 1.f) * tri.edgeNormalizedHF - vHC;
-        distToTri = std::sqrt(std::min(glm::dot(vFGC,vFGC), std::min(glm::dot(vGHC,vGHC), glm::dot(vHFC,vHFC)))); // dist to edge
-      }
+      s_tetrahedron &t = listTetra[iT];
 
-      const float		areaSigned = (glm::dot(tri.normal, vFC) < 0.f) ? 1.f : -1.f;
+      const glm::vec3 center = 0.25f * (*t.ptA + *t.ptB + *t.ptC + *t.ptD);
 
-      vFC = glm::normalize(vFC);
-      vGC = glm::normalize(vGC);
-      vHC = glm::normalize(vHC);
-      const float		areaSeen = glm::length(glm::cross(vGC - vFC, vHC- vFC));
+      const float w = triangleTree.sideWeight(center, tetraMinVolume); // signed apparent-area
 
-      w += areaSeen * areaSigned / (distToTri + tetraMinVolume);
+      if (w > 0.f) t.metaSetSideInterior();
+      else         t.metaSetSideExterior();
     }
-
-    if (w > 0.f) t.metaSetSideInterior();
-    else         t.metaSetSideExterior();
-  }
+  });
 
   exporter.report_Step3_Interior_Exterior(listTetra, "Direct", true);
 
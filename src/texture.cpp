@@ -16,9 +16,9 @@ static GLenum getTexInternalFormat(int nbComponants, bool isCompressed, bool gam
   TRE_ASSERT(nbComponants > 0 && nbComponants <= 4);
 #ifdef TRE_OPENGL_ES
   static const GLenum formats[4 * 4] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8,
-                                         GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
+                                         GL_COMPRESSED_R11_EAC, GL_COMPRESSED_RG11_EAC, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,
                                          GL_R8, GL_RG8, GL_SRGB8, GL_SRGB8_ALPHA8,
-                                         GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+                                         GL_COMPRESSED_R11_EAC, GL_COMPRESSED_RG11_EAC, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
                                        };
 #else
   static const GLenum formats[4 * 4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA,
@@ -74,6 +74,137 @@ static GLenum getGLTarget(texture::textureInfoType t)
   return kGLTargets[t];
 }
 
+//-----------------------------------------------------------------------------
+
+///< Helper function to get the GL-formats of the float-textures (RGBA16F, or packed RGB with MMASK_HDR_*)
+static void getTexFormatFloat(int modemask, GLenum &internalformat, GLenum &format, GLenum &type)
+{
+  if ((modemask & texture::MMASK_HDR_RGB9E5) != 0)
+  {
+    internalformat = GL_RGB9_E5;
+    format = GL_RGB;
+    type = GL_UNSIGNED_INT_5_9_9_9_REV;
+  }
+  else if ((modemask & texture::MMASK_HDR_R11G11B10F) != 0)
+  {
+    internalformat = GL_R11F_G11F_B10F;
+    format = GL_RGB;
+    type = GL_UNSIGNED_INT_10F_11F_11F_REV;
+  }
+  else
+  {
+    internalformat = GL_RGBA16F;
+    format = GL_RGBA;
+    type = GL_FLOAT;
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+///< Helper function to get the level count of a full mip-chain (down to 1x1)
+static unsigned getMipLevelCount(unsigned w, unsigned h)
+{
+  unsigned levelCount = 1;
+  for (unsigned dim = std::max(w, h); dim > 1; dim /= 2) ++levelCount;
+  return levelCount;
+}
+
+//-----------------------------------------------------------------------------
+
+///< Helper functions for the conversion between the sRGB color-space and the linear color-space
+static float convertSRGBtoLinear(float c) { return (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f); }
+static float convertLinearToSRGB(float c) { return (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f; }
+
+//-----------------------------------------------------------------------------
+
+/**
+ * @brief Helper function to down-sample an image by 2 on both dimensions (a dimension equal to 1 is kept).
+ * The filter is a Kaiser-windowed sinc (6 taps, alpha = 4), separable. The image is wrapped on its borders (as the sampling with GL_REPEAT).
+ * The values must be linear (the filter is applied in the linear color-space).
+ */
+static void downsampleKaiser(const std::vector<float> &pixelsIn, unsigned w, unsigned h, unsigned components, std::vector<float> &pixelsOut)
+{
+  static const std::array<float, 6> kWeights = []()
+  {
+    const auto fnBesselI0 = [](float x)
+    {
+      float sum = 1.f, term = 1.f;
+      for (int k = 1; k < 16; ++k) { term *= (x * x) / (4.f * float(k * k)); sum += term; }
+      return sum;
+    };
+    const float alpha = 4.f;
+    const float radius = 3.f;
+    std::array<float, 6> weights;
+    float                sum = 0.f;
+    for (int k = 0; k < 6; ++k)
+    {
+      const float d = float(k) - 2.5f; // distance (in source pixels) to the center of the destination pixel
+      const float x = 0.5f * d * float(M_PI);
+      const float t = d / radius;
+      weights[k] = (std::sin(x) / x) * fnBesselI0(alpha * std::sqrt(1.f - t * t)) / fnBesselI0(alpha);
+      sum += weights[k];
+    }
+    for (float &wk : weights) wk /= sum;
+    return weights;
+  }();
+
+  const unsigned wOut = std::max(w / 2, 1u);
+  const unsigned hOut = std::max(h / 2, 1u);
+
+  // horizontal pass
+
+  std::vector<float> pixelsTmp;
+  const std::vector<float> *pixelsH = &pixelsIn;
+  if (w > 1)
+  {
+    pixelsTmp.resize(std::size_t(wOut) * h * components);
+    parallelFor(h, 16, [&](std::size_t jBegin, std::size_t jEnd)
+    {
+      for (std::size_t j = jBegin; j < jEnd; ++j)
+      {
+        const float *rowIn = pixelsIn.data() + j * w * components;
+        float       *rowOut = pixelsTmp.data() + j * wOut * components;
+        for (unsigned i = 0; i < wOut; ++i)
+        {
+          for (unsigned c = 0; c < components; ++c) rowOut[i * components + c] = 0.f;
+          for (int k = 0; k < 6; ++k)
+          {
+            const unsigned iIn = unsigned(int(2 * i) + k - 2 + int(w)) % w;
+            for (unsigned c = 0; c < components; ++c) rowOut[i * components + c] += kWeights[k] * rowIn[iIn * components + c];
+          }
+        }
+      }
+    });
+    pixelsH = &pixelsTmp;
+  }
+
+  // vertical pass
+
+  pixelsOut.resize(std::size_t(wOut) * hOut * components);
+  if (h > 1)
+  {
+    const std::size_t rowSize = std::size_t(wOut) * components;
+    parallelFor(hOut, 16, [&](std::size_t jBegin, std::size_t jEnd)
+    {
+      for (std::size_t j = jBegin; j < jEnd; ++j)
+      {
+        float *rowOut = pixelsOut.data() + j * rowSize;
+        for (std::size_t i = 0; i < rowSize; ++i) rowOut[i] = 0.f;
+        for (int k = 0; k < 6; ++k)
+        {
+          const std::size_t jIn = std::size_t(int(2 * j) + k - 2 + int(h)) % h;
+          const float       *rowIn = pixelsH->data() + jIn * rowSize;
+          for (std::size_t i = 0; i < rowSize; ++i) rowOut[i] += kWeights[k] * rowIn[i];
+        }
+      }
+    });
+  }
+  else
+  {
+    pixelsOut = *pixelsH;
+  }
+}
+
 //==============================================================================
 
 SDL_Surface* texture::loadTextureFromBMP(const std::string & filename)
@@ -435,6 +566,14 @@ bool texture::loadFloat(const glm::vec4 * data, int w, int h, int modemask)
     return false;
   }
 
+  if ((modemask & MMASK_HDR_RGB9E5) != 0 && (modemask & MMASK_HDR_R11G11B10F) != 0)
+  {
+    TRE_LOG("Cannot use both MMASK_HDR_RGB9E5 and MMASK_HDR_R11G11B10F. loadFloat failed.");
+    return false;
+  }
+
+  if (useHDRPacking()) m_components = 3;
+
   glGenTextures(1, &m_handle);
 
   const bool success = updateFloat(data, w, h, false);
@@ -468,11 +607,29 @@ bool texture::loadArrayFloat(const glm::vec4 * data, int w, int h, int layers, i
     return false;
   }
 
+  if ((modemask & MMASK_HDR_RGB9E5) != 0 && (modemask & MMASK_HDR_R11G11B10F) != 0)
+  {
+    TRE_LOG("Cannot use both MMASK_HDR_RGB9E5 and MMASK_HDR_R11G11B10F. loadArrayFloat failed.");
+    return false;
+  }
+
+  if (useHDRPacking()) m_components = 3;
+
   glGenTextures(1, &m_handle);
 
+  GLenum internalformat, format, type;
+  getTexFormatFloat(m_mask, internalformat, format, type);
+
+  std::vector<uint32_t> packed;
+  if (useHDRPacking() && data != nullptr)
+  {
+    packed.resize(std::size_t(w) * std::size_t(h) * std::size_t(layers));
+    _rawPackHDR(reinterpret_cast<const float*>(data), packed.size(), 4, internalformat, packed.data());
+  }
+
   {
     glBindTexture(GL_TEXTURE_2D_ARRAY, m_handle);
-    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, w, h, layers, 0, GL_RGBA, GL_FLOAT, data);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalformat, w, h, layers, 0, format, type, packed.empty() ? static_cast<const void*>(data) : packed.data());
   }
 
   set_parameters();
@@ -491,12 +648,97 @@ bool texture::update(SDL_Surface *surface, const bool freeSurface, const bool un
   TRE_ASSERT(surface->w == m_w);
   TRE_ASSERT(surface->h == m_h);
 
-  GLenum       externalformat = getTexFormatSource(surface);
-  const GLenum internalformat = getTexInternalFormat(m_components, useCompress(), useGammeCorreciton());
+  const GLenum  internalformat = getTexInternalFormat(m_components, useCompress(), useGammeCorreciton());
+  s_SurfaceTemp surfLocal;
+  GLenum        externalformat;
+  unsigned      compressedByteSize;
+
+  if (!_prepareSurface(surface, freeSurface, surfLocal, externalformat, compressedByteSize))
+    return false;
+
+  // upload
+
+  glBindTexture(GL_TEXTURE_2D,m_handle);
+
+  if (useCompress())
+    glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalformat, surfLocal.w, surfLocal.h, 0, compressedByteSize, surfLocal.pixels);
+  else
+    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, surfLocal.w, surfLocal.h, 0, externalformat, GL_UNSIGNED_BYTE, surfLocal.pixels);
+
+  if (unbind) glBindTexture(GL_TEXTURE_2D, 0);
+
+  return IsOpenGLok("texture::update - upload pixels");
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::update(SDL_Surface *surface, const bool freeSurface, textureUploader &uploader, uint64_t *ticket /* = nullptr */) const
+{
+  if (ticket != nullptr) *ticket = 0;
+
+  if (surface == nullptr) return false;
+  if (m_handle == 0) return false;
+
+  TRE_ASSERT(surface->w == m_w);
+  TRE_ASSERT(surface->h == m_h);
+
+  const GLenum  internalformat = getTexInternalFormat(m_components, useCompress(), useGammeCorreciton());
+  s_SurfaceTemp surfLocal;
+  GLenum        externalformat;
+  unsigned      compressedByteSize;
+
+  if (!_prepareSurface(surface, freeSurface, surfLocal, externalformat, compressedByteSize))
+    return false;
+
+  textureUploader::s_request request;
+  request.m_texture = m_handle;
+  request.m_target = GL_TEXTURE_2D;
+  request.m_w = int(surfLocal.w);
+  request.m_h = int(surfLocal.h);
+
+  std::size_t byteSize = 0;
+  if (useCompress())
+  {
+    request.m_format = internalformat;
+    request.m_type = GL_NONE;
+    byteSize = compressedByteSize;
+  }
+  else
+  {
+    request.m_format = externalformat;
+    request.m_type = GL_UNSIGNED_BYTE;
+    byteSize = surfLocal.pitch * surfLocal.h;
+    if (surfLocal.pitch != surfLocal.pxByteSize * surfLocal.w) // the uploader expects tightly packed rows
+    {
+      surfLocal.copyToOwnBuffer();
+      const unsigned rowByteSize = surfLocal.pxByteSize * surfLocal.w;
+      for (unsigned j = 1; j < surfLocal.h; ++j)
+        memmove(surfLocal.pixels + j * rowByteSize, surfLocal.pixels + j * surfLocal.pitch, rowByteSize);
+      surfLocal.pitch = rowByteSize;
+      byteSize = rowByteSize * surfLocal.h;
+    }
+  }
+
+  const uint64_t t = uploader.push(request, surfLocal.pixels, byteSize);
+  if (t == 0)
+  {
+    TRE_LOG("texture::update - failed to push the pixels into the uploader");
+    return false;
+  }
+  if (ticket != nullptr) *ticket = t;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::_prepareSurface(SDL_Surface *surface, const bool freeSurface, s_SurfaceTemp &surfLocal, GLenum &externalformat, unsigned &compressedByteSize) const
+{
+  externalformat = getTexFormatSource(surface);
+  compressedByteSize = 0;
 
   // apply modifiers
 
-  s_SurfaceTemp surfLocal = s_SurfaceTemp(surface);
+  surfLocal = s_SurfaceTemp(surface);
 
   if (m_components == 1 && surface->format->BytesPerPixel != 1)
   {
@@ -538,36 +780,21 @@ bool texture::update(SDL_Surface *surface, const bool freeSurface, const bool un
     externalformat = (externalformat == GL_BGR) ? GL_RGB : GL_RGBA;
   }
 
-  // upload
-
-  glBindTexture(GL_TEXTURE_2D,m_handle);
+  // compress (always use the CPU-compressor)
 
   if (useCompress())
   {
-#if 1 // always use the CPU-compressor
     if (!freeSurface) surfLocal.copyToOwnBuffer();
-    const unsigned bufferByteSize = _rawCompress(surfLocal, internalformat); // in-place
-    if (bufferByteSize == 0)
+    const GLenum internalformat = getTexInternalFormat(m_components, true, useGammeCorreciton());
+    compressedByteSize = _rawCompress(surfLocal, internalformat); // in-place
+    if (compressedByteSize == 0)
     {
       TRE_LOG("texture::update - failed to compress the picture (CPU compressor)");
       return false;
     }
-    else
-    {
-      glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalformat, surfLocal.w, surfLocal.h, 0, bufferByteSize, surfLocal.pixels);
-    }
-#else
-    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, surfLocal.w, surfLocal.h, 0, externalformat, GL_UNSIGNED_BYTE, surfLocal.pixels);
-#endif
-  }
-  else
-  {
-    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, surfLocal.w, surfLocal.h, 0, externalformat, GL_UNSIGNED_BYTE, surfLocal.pixels);
   }
 
-  if (unbind) glBindTexture(GL_TEXTURE_2D, 0);
-
-  return IsOpenGLok("texture::update - upload pixels");
+  return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -705,8 +932,18 @@ bool texture::updateFloat(const glm::vec4 * data, int w, int h, const bool unbin
 
   glBindTexture(GL_TEXTURE_2D, m_handle);
 
+  GLenum internalformat, format, type;
+  getTexFormatFloat(m_mask, internalformat, format, type);
+
+  std::vector<uint32_t> packed;
+  if (useHDRPacking() && data != nullptr)
   {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, w, h, 0, GL_RGBA, GL_FLOAT, data);
+    packed.resize(std::size_t(w) * std::size_t(h));
+    _rawPackHDR(reinterpret_cast<const float*>(data), packed.size(), 4, internalformat, packed.data());
+  }
+
+  {
+    glTexImage2D(GL_TEXTURE_2D, 0, internalformat, w, h, 0, format, type, packed.empty() ? static_cast<const void*>(data) : packed.data());
   }
 
   if (unbind) glBindTexture(GL_TEXTURE_2D, 0);
@@ -728,8 +965,18 @@ bool texture::updateArrayFloat(const glm::vec4 * data, int w, int h, int layerIn
 
   glBindTexture(GL_TEXTURE_2D_ARRAY, m_handle);
 
+  GLenum internalformat, format, type;
+  getTexFormatFloat(m_mask, internalformat, format, type);
+
+  std::vector<uint32_t> packed;
+  if (useHDRPacking() && data != nullptr)
+  {
+    packed.resize(std::size_t(w) * std::size_t(h));
+    _rawPackHDR(reinterpret_cast<const float*>(data), packed.size(), 4, internalformat, packed.data());
+  }
+
   {
-    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layerIndex, w, h, 1,  GL_RGBA, GL_FLOAT, data);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layerIndex, w, h, 1, format, type, packed.empty() ? static_cast<const void*>(data) : packed.data());
   }
 
   if (unbind) glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
@@ -773,7 +1020,7 @@ bool texture::loadCheckerboard(int width, int height)
 
 //-----------------------------------------------------------------------------
 
-#define TEXTURE_BIN_VERSION 0x004
+#define TEXTURE_BIN_VERSION 0x005
 
 bool texture::write(std::ostream &outbuffer, SDL_Surface *surface, int modemask, const bool freeSurface)
 {
@@ -828,22 +1075,15 @@ bool texture::write(std::ostream &outbuffer, SDL_Surface *surface, int modemask,
     sourceformat = (sourceformat == GL_BGR) ? GL_RGB : GL_RGBA;
   }
 
-  unsigned pixelData_ByteSize = components * surface->w * surface->h;
-
-  if ((modemask & MMASK_COMPRESS) != 0)
-  {
-    if (!freeSurface) surfLocal.copyToOwnBuffer();
-    pixelData_ByteSize = _rawCompress(surfLocal, getTexInternalFormat(components, true, (modemask & MMASK_SRBG_SPACE) != 0));
-  }
+  if ((modemask & MMASK_COMPRESS) != 0 && !freeSurface) surfLocal.copyToOwnBuffer();
 
   // final write
 
-  outbuffer.write(reinterpret_cast<const char*>(&pixelData_ByteSize), sizeof(pixelData_ByteSize));
-  outbuffer.write(reinterpret_cast<const char*>(surfLocal.pixels), pixelData_ByteSize);
+  const bool success = _rawWriteLevels(outbuffer, surfLocal, components, modemask);
 
   if (freeSurface) SDL_FreeSurface(surface);
 
-  return true;
+  return success;
 }
 
 //-----------------------------------------------------------------------------
@@ -987,35 +1227,115 @@ bool texture::writeCube(std::ostream &outbuffer, const std::array<SDL_Surface *,
     return false;
   }
 
-  unsigned pixelData_ByteSize = components * cubeFaces[0]->w * cubeFaces[0]->h;
-  // TODO: the compression gives the same size given the texture's dimension and components
+  // write each face with its mip-chain
 
-  if ((modemask & MMASK_COMPRESS) != 0)
+  bool success = true;
+
+  for (int iface = 0; iface < 6; ++iface)
   {
-    TRE_ASSERT(freeSurface == true); // local-surface not implemented.
-    const GLenum internalformat = getTexInternalFormat(components, true, (modemask & MMASK_SRBG_SPACE) != 0);
-    pixelData_ByteSize = _rawCompress(cubeFaces[0], internalformat);
-    const unsigned pxbt1   = _rawCompress(cubeFaces[1], internalformat); TRE_ASSERT(pixelData_ByteSize == pxbt1); (void)pxbt1;
-    const unsigned pxbt2   = _rawCompress(cubeFaces[2], internalformat); TRE_ASSERT(pixelData_ByteSize == pxbt2); (void)pxbt2;
-    const unsigned pxbt3   = _rawCompress(cubeFaces[3], internalformat); TRE_ASSERT(pixelData_ByteSize == pxbt3); (void)pxbt3;
-    const unsigned pxbt4   = _rawCompress(cubeFaces[4], internalformat); TRE_ASSERT(pixelData_ByteSize == pxbt4); (void)pxbt4;
-    const unsigned pxbt5   = _rawCompress(cubeFaces[5], internalformat); TRE_ASSERT(pixelData_ByteSize == pxbt5); (void)pxbt5;
-  }
+    SDL_Surface *surface = cubeFaces[iface];
+    if (surface->w != cubeFaces[0]->w || surface->h != cubeFaces[0]->h || surface->format->BytesPerPixel != components)
+    {
+      TRE_LOG("texture::writeCube - mismatching-dimension for cubemap face " << iface);
+      success = false;
+      break;
+    }
 
-  outbuffer.write(reinterpret_cast<const char*>(&pixelData_ByteSize), sizeof(pixelData_ByteSize));
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[0]->pixels), pixelData_ByteSize);
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[1]->pixels), pixelData_ByteSize);
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[2]->pixels), pixelData_ByteSize);
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[3]->pixels), pixelData_ByteSize);
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[4]->pixels), pixelData_ByteSize);
-  outbuffer.write(reinterpret_cast<const char*>(cubeFaces[5]->pixels), pixelData_ByteSize);
+    GLenum        sourceformat = getTexFormatSource(surface);
+    s_SurfaceTemp surfLocal = s_SurfaceTemp(surface);
+
+    if (sourceformat == GL_BGR || sourceformat == GL_BGRA)
+    {
+      if (!freeSurface) surfLocal.copyToOwnBuffer();
+      _rawConvert_BRG_to_RGB(surfLocal);
+    }
+    if ((modemask & MMASK_COMPRESS) != 0 && !freeSurface) surfLocal.copyToOwnBuffer();
+
+    success &= _rawWriteLevels(outbuffer, surfLocal, components, modemask);
+  }
 
   if (freeSurface)
   {
     for (auto &s : cubeFaces) { if (s != nullptr) SDL_FreeSurface(s); }
   }
 
-  return true;
+  return success;
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::writeCubeMipChain(std::ostream &outbuffer, const std::vector<std::array<SDL_Surface *, 6> > &mipChain, int modemask, const bool freeSurface)
+{
+  bool isValid = !mipChain.empty();
+  for (const auto &faces : mipChain)
+    for (SDL_Surface *s : faces) isValid &= (s != nullptr);
+
+  int components = isValid ? mipChain[0][0]->format->BytesPerPixel : 4 /*whatever*/;
+  TRE_ASSERT((modemask & MMASK_ALPHA_ONLY) == 0); // alpha-only modifier not supported
+  TRE_ASSERT((modemask & MMASK_FORCE_NO_ALPHA) == 0); // no-alpha modifier not supported
+  TRE_ASSERT((modemask & MMASK_RG_ONLY) == 0); // 2-chanels modifier not supported
+  modemask |= MMASK_MIPMAP;
+
+  if (isValid && mipChain.size() != getMipLevelCount(mipChain[0][0]->w, mipChain[0][0]->h))
+  {
+    TRE_LOG("texture::writeCubeMipChain - incomplete mip-chain (" << mipChain.size() << " levels)");
+    isValid = false;
+  }
+
+  // header
+  int32_t tinfo[8];
+  tinfo[0] = TI_CUBEMAP;
+  tinfo[1] = isValid ? mipChain[0][0]->w : 0;
+  tinfo[2] = isValid ? mipChain[0][0]->h : 0;
+  tinfo[3] = modemask;
+  tinfo[4] = k_Config; // internal
+  tinfo[5] = 0; // depth
+  tinfo[6] = components;
+  tinfo[7] = TEXTURE_BIN_VERSION;
+
+  outbuffer.write(reinterpret_cast<const char*>(&tinfo), sizeof(tinfo));
+
+  // write each face with its mip-chain
+
+  bool success = isValid;
+
+  for (int iface = 0; success && iface < 6; ++iface)
+  {
+    for (std::size_t level = 0; level < mipChain.size(); ++level)
+    {
+      SDL_Surface *surface = mipChain[level][iface];
+      if (surface->w != std::max(mipChain[0][0]->w >> level, 1) || surface->h != std::max(mipChain[0][0]->h >> level, 1) || surface->format->BytesPerPixel != components)
+      {
+        TRE_LOG("texture::writeCubeMipChain - mismatching-dimension for cubemap face " << iface << " at level " << level);
+        success = false;
+        break;
+      }
+
+      GLenum        sourceformat = getTexFormatSource(surface);
+      s_SurfaceTemp surfLocal = s_SurfaceTemp(surface);
+
+      if (sourceformat == GL_BGR || sourceformat == GL_BGRA)
+      {
+        if (!freeSurface) surfLocal.copyToOwnBuffer();
+        _rawConvert_BRG_to_RGB(surfLocal);
+      }
+      if ((modemask & MMASK_COMPRESS) != 0)
+      {
+        _rawPadToBlocks(surfLocal); // the last levels (2x2, 1x1) are smaller than a block
+        if (!freeSurface) surfLocal.copyToOwnBuffer();
+      }
+
+      success &= _rawWriteLevel(outbuffer, surfLocal, components, modemask);
+    }
+  }
+
+  if (freeSurface)
+  {
+    for (const auto &faces : mipChain)
+      for (SDL_Surface *s : faces) { if (s != nullptr) SDL_FreeSurface(s); }
+  }
+
+  return success;
 }
 
 //-----------------------------------------------------------------------------
@@ -1054,8 +1374,84 @@ bool texture::write3D(std::ostream &outbuffer, const uint8_t *data, int w, int h
 
 //-----------------------------------------------------------------------------
 
+bool texture::writeFloat(std::ostream &outbuffer, const glm::vec4 *data, int w, int h, int modemask)
+{
+  const bool isPacked = ((modemask & MMASK_HDR_RGB9E5) != 0) != ((modemask & MMASK_HDR_R11G11B10F) != 0);
+  const bool isValid = (data != nullptr) && isPacked && (w > 0) && (h > 0);
+  if (!isPacked) TRE_LOG("texture::writeFloat: the float data must be packed with MMASK_HDR_RGB9E5 or MMASK_HDR_R11G11B10F");
+  TRE_ASSERT((modemask & (MMASK_ALPHA_ONLY | MMASK_RG_ONLY | MMASK_FORCE_NO_ALPHA)) == 0); // modifiers not supported
+
+  // header
+  int32_t tinfo[8];
+  tinfo[0] = TI_2D;
+  tinfo[1] = isValid ? w : 0;
+  tinfo[2] = isValid ? h : 0;
+  tinfo[3] = modemask & (~(MMASK_COMPRESS | MMASK_SRBG_SPACE));
+  tinfo[4] = k_Config; // internal
+  tinfo[5] = 0; // depth
+  tinfo[6] = 3; // components
+  tinfo[7] = TEXTURE_BIN_VERSION;
+
+  outbuffer.write(reinterpret_cast<const char*>(&tinfo), sizeof(tinfo));
+
+  if (!isValid) return false;
+
+  return _rawWriteLevelsHDR(outbuffer, data, unsigned(w), unsigned(h), modemask);
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::writeCubeFloat(std::ostream &outbuffer, const std::array<const glm::vec4*, 6> &cubeFaces, int size, int modemask)
+{
+  const bool isPacked = ((modemask & MMASK_HDR_RGB9E5) != 0) != ((modemask & MMASK_HDR_R11G11B10F) != 0);
+  bool       isValid = isPacked && (size > 0);
+  for (const glm::vec4 *face : cubeFaces) isValid &= (face != nullptr);
+  if (!isPacked) TRE_LOG("texture::writeCubeFloat: the float data must be packed with MMASK_HDR_RGB9E5 or MMASK_HDR_R11G11B10F");
+  TRE_ASSERT((modemask & (MMASK_ALPHA_ONLY | MMASK_RG_ONLY | MMASK_FORCE_NO_ALPHA)) == 0); // modifiers not supported
+
+  // header
+  int32_t tinfo[8];
+  tinfo[0] = TI_CUBEMAP;
+  tinfo[1] = isValid ? size : 0;
+  tinfo[2] = isValid ? size : 0;
+  tinfo[3] = modemask & (~(MMASK_COMPRESS | MMASK_SRBG_SPACE));
+  tinfo[4] = k_Config; // internal
+  tinfo[5] = 0; // depth
+  tinfo[6] = 3; // components
+  tinfo[7] = TEXTURE_BIN_VERSION;
+
+  outbuffer.write(reinterpret_cast<const char*>(&tinfo), sizeof(tinfo));
+
+  if (!isValid) return false;
+
+  for (const glm::vec4 *face : cubeFaces)
+  {
+    if (!_rawWriteLevelsHDR(outbuffer, face, unsigned(size), unsigned(size), modemask)) return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 bool texture::read(std::istream &inbuffer)
 {
+  return _read(inbuffer, nullptr, nullptr);
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::read(std::istream &inbuffer, textureUploader &uploader, uint64_t *ticket /* = nullptr */)
+{
+  return _read(inbuffer, &uploader, ticket);
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::_read(std::istream &inbuffer, textureUploader *uploader, uint64_t *ticket)
+{
+  if (ticket != nullptr) *ticket = 0;
+
   // header
   int32_t tinfo[8];
   inbuffer.read(reinterpret_cast<char*>(&tinfo), sizeof(tinfo) );
@@ -1091,14 +1487,6 @@ bool texture::read(std::istream &inbuffer)
     return false;
   }
 
-#ifdef TRE_OPENGL_ES
-  if (useMipmap() && useCompress())
-  {
-    TRE_LOG("texture: OpenGL-ES: Cannot generate mipmaps of compressed texture. Skip mipmap.");
-    m_mask &= ~MMASK_MIPMAP;
-  }
-#endif
-
   if (!useMipmap() && useAnisotropic())
   {
     TRE_LOG("texture: Cannot use anisotropic filter without mipmap. Disable anisotropic filter");
@@ -1120,36 +1508,92 @@ bool texture::read(std::istream &inbuffer)
   bool success = true;
 
   // data and load into GPU
-  const GLenum internalformat = getTexInternalFormat(m_components, useCompress(), useGammeCorreciton());
+  GLenum internalformat = getTexInternalFormat(m_components, useCompress(), useGammeCorreciton());
 #ifdef TRE_OPENGL_ES
   static const GLenum _formats[4] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
-  const GLenum format = _formats[m_components - 1];
+  GLenum format = _formats[m_components - 1];
 #else
-  const GLenum format = internalformat;
+  GLenum format = internalformat;
 #endif
+  GLenum type = GL_UNSIGNED_BYTE;
+  if (useHDRPacking()) getTexFormatFloat(m_mask, internalformat, format, type); // packed float pixels (4 bytes per pixel)
 
   std::vector<char> readBuffer;
   unsigned dataSize = 0;
-  inbuffer.read(reinterpret_cast<char*>(&dataSize), sizeof(unsigned));
-  TRE_ASSERT(int(dataSize) > 0);
+
+  // with the uploader, the level is copied into a pixel-buffer and its upload is deferred.
+  // A level larger than a pixel-buffer is allocated now (without pixels), and its pixels are uploaded by bands.
+  const auto     fnPushLevel = [&](const GLenum target, const unsigned level, const int wLevel, const int hLevel) -> bool
+  {
+    textureUploader::s_request request;
+    request.m_texture = m_handle;
+    request.m_target = target;
+    request.m_level = GLint(level);
+    request.m_w = wLevel;
+    request.m_h = hLevel;
+    request.m_format = useCompress() ? internalformat : format;
+    request.m_type = useCompress() ? GL_NONE : type;
+
+    if (readBuffer.size() <= uploader->slotByteSize())
+    {
+      request.m_internalFormat = internalformat;
+    }
+    else
+    {
+#ifdef TRE_EMSCRIPTEN
+      if (useCompress()) return false; // WebGL does not allow compressed textures without pixels
+#endif
+      if (useCompress()) glCompressedTexImage2D(target, GLint(level), internalformat, wLevel, hLevel, 0, GLsizei(readBuffer.size()), nullptr);
+      else               glTexImage2D(target, GLint(level), internalformat, wLevel, hLevel, 0, format, type, nullptr);
+    }
+
+    const uint64_t t = uploader->push(request, readBuffer.data(), readBuffer.size());
+    if (t == 0) return false; // the level will be uploaded synchronously
+    if (ticket != nullptr) *ticket = t;
+    return true;
+  };
+
+  // 2D-textures and cubemaps: the mip-chain is baked (the levels are tightly packed)
+  const unsigned levelCount = useMipmap() ? getMipLevelCount(m_w, m_h) : 1;
+  const auto     fnReadLevels = [&](const GLenum target) -> bool
+  {
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned level = 0; level < levelCount; ++level)
+    {
+      const int wLevel = std::max(m_w >> level, 1);
+      const int hLevel = std::max(m_h >> level, 1);
+      inbuffer.read(reinterpret_cast<char*>(&dataSize), sizeof(unsigned));
+      if (!inbuffer || dataSize == 0)
+      {
+        TRE_LOG("texture::read invalid data (level " << level << ")");
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return false;
+      }
+      readBuffer.resize(dataSize);
+      inbuffer.read(readBuffer.data(), int(dataSize));
+      if (doConvertAtoRGBA) _rawUnpack_A8_to_RGBA8(readBuffer);
+      if (uploader != nullptr && fnPushLevel(target, level, wLevel, hLevel)) continue;
+      if (useCompress()) glCompressedTexImage2D(target, GLint(level), internalformat, wLevel, hLevel, 0, GLsizei(readBuffer.size()), readBuffer.data());
+      else               glTexImage2D(target, GLint(level), internalformat, wLevel, hLevel, 0, format, type, readBuffer.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
+  };
 
   glGenTextures(1,&m_handle);
   if (m_type == TI_2D)
   {
-    readBuffer.resize(dataSize);
-    TRE_ASSERT(readBuffer.size() == dataSize);
-    inbuffer.read(readBuffer.data(), int(dataSize));
-    if (doConvertAtoRGBA) _rawUnpack_A8_to_RGBA8(readBuffer);
     glBindTexture(GL_TEXTURE_2D,m_handle);
-    if (useCompress()) glCompressedTexImage2D(GL_TEXTURE_2D,0,internalformat,m_w,m_h,0, dataSize,readBuffer.data());
-    else               glTexImage2D(GL_TEXTURE_2D,0,internalformat,m_w,m_h,0,format,GL_UNSIGNED_BYTE,readBuffer.data());
+    success &= fnReadLevels(GL_TEXTURE_2D);
     success &= tre::IsOpenGLok("texture::read (TI_2D) upload pixels");
-    set_parameters();
+    set_parameters(false);
     success &= tre::IsOpenGLok("texture::read (TI_2D) complete texture");
     glBindTexture(GL_TEXTURE_2D,0);
   }
   else if (m_type == TI_2DARRAY)
   {
+    inbuffer.read(reinterpret_cast<char*>(&dataSize), sizeof(unsigned));
+    TRE_ASSERT(int(dataSize) > 0);
     readBuffer.resize(dataSize);
     TRE_ASSERT(readBuffer.size() == dataSize);
     inbuffer.read(readBuffer.data(), int(dataSize));
@@ -1167,20 +1611,17 @@ bool texture::read(std::istream &inbuffer)
     glBindTexture(GL_TEXTURE_CUBE_MAP,m_handle);
     for (int iface = 0; iface < 6; ++iface)
     {
-      readBuffer.resize(dataSize);
-      TRE_ASSERT(readBuffer.size() == dataSize);
-      inbuffer.read(readBuffer.data(), int(dataSize));
-      if (doConvertAtoRGBA) _rawUnpack_A8_to_RGBA8(readBuffer);
-      if (useCompress()) glCompressedTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+iface,0,internalformat,m_w,m_h,0, dataSize,readBuffer.data());
-      else               glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X+iface,0,internalformat,m_w,m_h,0,format,GL_UNSIGNED_BYTE,readBuffer.data());
+      success &= fnReadLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X+iface);
       success &= tre::IsOpenGLok("texture::read (TI_CUBEMAP) upload cube face pixels");
     }
-    set_parameters();
+    set_parameters(false);
     success &= tre::IsOpenGLok("texture::read (TI_CUBEMAP) complete texture");
     glBindTexture(GL_TEXTURE_CUBE_MAP,0);
   }
   else if (m_type == TI_3D)
   {
+    inbuffer.read(reinterpret_cast<char*>(&dataSize), sizeof(unsigned));
+    TRE_ASSERT(int(dataSize) > 0);
     readBuffer.resize(dataSize);
     TRE_ASSERT(readBuffer.size() == dataSize);
     inbuffer.read(readBuffer.data(), int(dataSize));
@@ -1209,11 +1650,11 @@ void texture::clear()
 
 //-----------------------------------------------------------------------------
 
-void texture::set_parameters()
+void texture::set_parameters(const bool generateMipmap /* = true */)
 {
   const GLenum target = getGLTarget(m_type);
 
-  if (useMipmap()) glGenerateMipmap(target);
+  if (useMipmap() && generateMipmap) glGenerateMipmap(target);
   glTexParameteri(target,GL_TEXTURE_WRAP_S,GL_REPEAT);
   glTexParameteri(target,GL_TEXTURE_WRAP_T,GL_REPEAT);
   if (m_type == TI_3D) glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_REPEAT);
@@ -1429,6 +1870,197 @@ void texture::_rawExtend_AddAlpha8(s_SurfaceTemp &surf)
 
 //-----------------------------------------------------------------------------
 
+void texture::_rawToFloat(const s_SurfaceTemp &surf, const bool gammaCorrect, std::vector<float> &pixelsOut)
+{
+  const unsigned components = surf.pxByteSize;
+  const unsigned colorComponents = (gammaCorrect && components >= 3) ? 3 : 0; // the alpha, and the 1- or 2-channels textures, are linear
+
+  std::array<float, 256> convertColor, convertLinear;
+  for (unsigned v = 0; v < 256; ++v)
+  {
+    convertLinear[v] = float(v) / 255.f;
+    convertColor[v] = convertSRGBtoLinear(convertLinear[v]);
+  }
+
+  pixelsOut.resize(std::size_t(surf.w) * surf.h * components);
+  for (unsigned j = 0; j < surf.h; ++j)
+  {
+    const uint8_t *rowIn = surf.pixels + surf.pitch * j;
+    float         *rowOut = pixelsOut.data() + std::size_t(surf.w) * components * j;
+    for (unsigned i = 0; i < surf.w * components; i += components)
+    {
+      for (unsigned c = 0; c < components; ++c)
+        rowOut[i + c] = (c < colorComponents) ? convertColor[rowIn[i + c]] : convertLinear[rowIn[i + c]];
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+void texture::_rawFromFloat(const std::vector<float> &pixelsIn, unsigned w, unsigned h, unsigned components, const bool gammaCorrect, s_SurfaceTemp &surf)
+{
+  const unsigned colorComponents = (gammaCorrect && components >= 3) ? 3 : 0; // the alpha, and the 1- or 2-channels textures, are linear
+  const unsigned wPadded = (w + 3) & ~3u;
+  const unsigned hPadded = (h + 3) & ~3u;
+
+  surf.w = w;
+  surf.h = h;
+  surf.pxByteSize = components;
+  surf.pitch = wPadded * components;
+  surf.pixelsLocalBuffer.resize(std::size_t(surf.pitch) * hPadded);
+  surf.pixels = surf.pixelsLocalBuffer.data();
+
+  parallelFor(h, 16, [&](std::size_t jBegin, std::size_t jEnd)
+  {
+    for (std::size_t j = jBegin; j < jEnd; ++j)
+    {
+      const float *rowIn = pixelsIn.data() + std::size_t(w) * components * j;
+      uint8_t     *rowOut = surf.pixels + std::size_t(surf.pitch) * j;
+      for (unsigned i = 0; i < w * components; i += components)
+      {
+        for (unsigned c = 0; c < components; ++c)
+        {
+          const float value = glm::clamp(rowIn[i + c], 0.f, 1.f);
+          rowOut[i + c] = uint8_t(std::lround(255.f * ((c < colorComponents) ? convertLinearToSRGB(value) : value)));
+        }
+      }
+      for (unsigned i = w * components; i < surf.pitch; ++i) rowOut[i] = rowOut[i - components]; // padding
+    }
+  });
+
+  for (unsigned j = h; j < hPadded; ++j) memcpy(surf.pixels + std::size_t(surf.pitch) * j, surf.pixels + std::size_t(surf.pitch) * (j - 1), surf.pitch); // padding
+}
+
+//-----------------------------------------------------------------------------
+
+void texture::_rawPadToBlocks(s_SurfaceTemp &surf)
+{
+  const unsigned wPadded = (surf.w + 3) & ~3u;
+  const unsigned hPadded = (surf.h + 3) & ~3u;
+  if (wPadded == surf.w && hPadded == surf.h) return;
+
+  const unsigned       pitchPadded = wPadded * surf.pxByteSize;
+  std::vector<uint8_t> buffer(std::size_t(pitchPadded) * hPadded);
+
+  for (unsigned j = 0; j < surf.h; ++j)
+  {
+    uint8_t *rowOut = buffer.data() + std::size_t(pitchPadded) * j;
+    memcpy(rowOut, surf.pixels + std::size_t(surf.pitch) * j, surf.w * surf.pxByteSize);
+    for (unsigned i = surf.w * surf.pxByteSize; i < pitchPadded; ++i) rowOut[i] = rowOut[i - surf.pxByteSize]; // padding
+  }
+  for (unsigned j = surf.h; j < hPadded; ++j) memcpy(buffer.data() + std::size_t(pitchPadded) * j, buffer.data() + std::size_t(pitchPadded) * (j - 1), pitchPadded); // padding
+
+  surf.pixelsLocalBuffer.swap(buffer);
+  surf.pixels = surf.pixelsLocalBuffer.data();
+  surf.pitch = pitchPadded;
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::_rawWriteLevels(std::ostream &outbuffer, s_SurfaceTemp &surf, int components, int modemask)
+{
+  TRE_ASSERT(surf.pxByteSize == unsigned(components));
+
+  const bool     gammaCorrect = (modemask & MMASK_SRBG_SPACE) != 0;
+  const unsigned levelCount = ((modemask & MMASK_MIPMAP) != 0) ? getMipLevelCount(surf.w, surf.h) : 1;
+
+  std::vector<float> levelPixels, levelPixelsNext;
+  if (levelCount > 1) _rawToFloat(surf, gammaCorrect, levelPixels); // before the in-place compression
+
+  s_SurfaceTemp surfLevel;
+  unsigned      w = surf.w, h = surf.h;
+
+  for (unsigned level = 0; level < levelCount; ++level)
+  {
+    s_SurfaceTemp &surfCurrent = (level == 0) ? surf : surfLevel;
+    if (level != 0)
+    {
+      downsampleKaiser(levelPixels, w, h, components, levelPixelsNext);
+      levelPixels.swap(levelPixelsNext);
+      w = std::max(w / 2, 1u);
+      h = std::max(h / 2, 1u);
+      _rawFromFloat(levelPixels, w, h, components, gammaCorrect, surfLevel);
+    }
+
+    if (!_rawWriteLevel(outbuffer, surfCurrent, components, modemask)) return false;
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::_rawWriteLevel(std::ostream &outbuffer, s_SurfaceTemp &surf, int components, int modemask)
+{
+  TRE_ASSERT(surf.pxByteSize == unsigned(components));
+
+  if ((modemask & MMASK_COMPRESS) != 0)
+  {
+    const GLenum   compressedFormat = getTexInternalFormat(components, true, (modemask & MMASK_SRBG_SPACE) != 0);
+    const unsigned pixelData_ByteSize = _rawCompress(surf, compressedFormat);
+    if (pixelData_ByteSize == 0) return false;
+    outbuffer.write(reinterpret_cast<const char*>(&pixelData_ByteSize), sizeof(pixelData_ByteSize));
+    outbuffer.write(reinterpret_cast<const char*>(surf.pixels), pixelData_ByteSize);
+  }
+  else
+  {
+    const unsigned rowByteSize = surf.w * components;
+    const unsigned pixelData_ByteSize = rowByteSize * surf.h;
+    outbuffer.write(reinterpret_cast<const char*>(&pixelData_ByteSize), sizeof(pixelData_ByteSize));
+    for (unsigned j = 0; j < surf.h; ++j)
+      outbuffer.write(reinterpret_cast<const char*>(surf.pixels + std::size_t(surf.pitch) * j), rowByteSize);
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool texture::_rawWriteLevelsHDR(std::ostream &outbuffer, const glm::vec4 *data, unsigned w, unsigned h, int modemask)
+{
+  const GLenum   packedFormat = ((modemask & MMASK_HDR_RGB9E5) != 0) ? GL_RGB9_E5 : GL_R11F_G11F_B10F;
+  const unsigned levelCount = ((modemask & MMASK_MIPMAP) != 0) ? getMipLevelCount(w, h) : 1;
+
+  std::vector<uint32_t> packed(std::size_t(w) * std::size_t(h));
+  _rawPackHDR(reinterpret_cast<const float*>(data), packed.size(), 4, packedFormat, packed.data());
+
+  const unsigned pixelData_ByteSize = unsigned(packed.size() * sizeof(uint32_t));
+  outbuffer.write(reinterpret_cast<const char*>(&pixelData_ByteSize), sizeof(pixelData_ByteSize));
+  outbuffer.write(reinterpret_cast<const char*>(packed.data()), pixelData_ByteSize);
+
+  if (levelCount == 1) return true;
+
+  // mip-chain: filtered on RGB (the values are linear).
+  // The ringing of the filter around the very bright pixels may give negative values, clamped to 0 by the packing.
+  std::vector<float> levelPixels, levelPixelsNext;
+  levelPixels.resize(packed.size() * 3);
+  for (std::size_t ip = 0; ip < packed.size(); ++ip)
+  {
+    levelPixels[ip * 3 + 0] = data[ip].r;
+    levelPixels[ip * 3 + 1] = data[ip].g;
+    levelPixels[ip * 3 + 2] = data[ip].b;
+  }
+
+  for (unsigned level = 1; level < levelCount; ++level)
+  {
+    downsampleKaiser(levelPixels, w, h, 3, levelPixelsNext);
+    levelPixels.swap(levelPixelsNext);
+    w = std::max(w / 2, 1u);
+    h = std::max(h / 2, 1u);
+
+    packed.resize(std::size_t(w) * std::size_t(h));
+    _rawPackHDR(levelPixels.data(), packed.size(), 3, packedFormat, packed.data());
+
+    const unsigned levelData_ByteSize = unsigned(packed.size() * sizeof(uint32_t));
+    outbuffer.write(reinterpret_cast<const char*>(&levelData_ByteSize), sizeof(levelData_ByteSize));
+    outbuffer.write(reinterpret_cast<const char*>(packed.data()), levelData_ByteSize);
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
 texture::s_SurfaceTemp::s_SurfaceTemp(SDL_Surface *surf)
 : w(surf->w), h(surf->h),
   pitch(surf->pitch), pxByteSize(surf->format->BytesPerPixel),
@@ -2,6 +2,17 @@
 
 #include "tre_utils.h"
 
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <smmintrin.h> // SSE4.1
+
+#if !defined(TRE_EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+#define TRE_WITH_THREADS
+#include <thread>
+#include <condition_variable>
+#endif
+
 #ifdef TRE_WITH_LIBTIFF
 #include "tiffio.h"
 #endif
@@ -29,8 +40,8 @@ struct s_RBGA8
 
 struct s_RBGfloat
 {
-  float r,g,b, _padding;
-  inline s_RBGfloat(float v = 0.f) : r(v), g(v), b(v) {}
+  float r,g,b, _padding; // packed as a __m128
+  inline s_RBGfloat(float v = 0.f) : r(v), g(v), b(v), _padding(0.f) {}
   inline s_RBGfloat(const s_RBGA8 &from);
   inline s_RBGfloat operator*(const float scale) const;
   inline s_RBGfloat &operator+=(const s_RBGfloat &other);
@@ -53,16 +64,15 @@ s_RBGfloat::s_RBGfloat(const s_RBGA8 &from)
   r = float(from.r) / float(0xFF);
   b = float(from.b) / float(0xFF);
   g = float(from.g) / float(0xFF);
+  _padding = 0.f;
 }
 
 // ----------------------------------------------------------------------------
 
 s_RBGfloat s_RBGfloat::operator*(const float scale) const
 {
-  s_RBGfloat ret = *this;
-  ret.r *= scale;
-  ret.g *= scale;
-  ret.b *= scale;
+  s_RBGfloat ret;
+  _mm_storeu_ps(&ret.r, _mm_mul_ps(_mm_loadu_ps(&r), _mm_set1_ps(scale)));
   return ret;
 }
 
@@ -70,21 +80,54 @@ s_RBGfloat s_RBGfloat::operator*(const float scale) const
 
 s_RBGfloat &s_RBGfloat::operator+=(const s_RBGfloat &other)
 {
-  r += other.r;
-  g += other.g;
-  b += other.b;
+  _mm_storeu_ps(&r, _mm_add_ps(_mm_loadu_ps(&r), _mm_loadu_ps(&other.r)));
   return *this;
 }
 
+// ----------------------------------------------------------------------------
+
+static inline float _horizontalSum(__m128 v)
+{
+  v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+  v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 0x55));
+  return _mm_cvtss_f32(v);
+}
+
+/// Weighted sum of a row of values: sum(row[i] * w[i]) for i in [0, n). The weights "w" are 16-bytes aligned.
+static inline float _weightedSum(const float * __restrict row, const float * __restrict w, const uint n)
+{
+  __m128 acc = _mm_setzero_ps();
+  uint i = 0;
+  for (; i + 4 <= n; i += 4)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(row + i), _mm_load_ps(w + i)));
+  float ret = _horizontalSum(acc);
+  for (; i < n; ++i)
+    ret += row[i] * w[i];
+  return ret;
+}
+
+static inline s_RBGfloat _weightedSum(const s_RBGfloat * __restrict row, const float * __restrict w, const uint n)
+{
+  __m128 acc = _mm_setzero_ps();
+  for (uint i = 0; i < n; ++i)
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&row[i].r), _mm_set1_ps(w[i])));
+  s_RBGfloat ret;
+  _mm_storeu_ps(&ret.r, acc);
+  return ret;
+}
+
 //=============================================================================
 // Sampler Interface
 
 template <typename _T, class _S>
 struct s_sampler
 {
+  static constexpr bool isThreadSafe = false; // true if "pixelGet" can be called concurrently
   s_sampler(_S *s);
   _T pixelGet(uint u, uint v) const;
   void pixelSet(uint u, uint v, _T value);
+  void schedule(const std::vector<glm::uvec4> &zones); // hint: the zones (u-min, u-max, v-min, v-max) that will be read, in that order
+  void scheduleStep(std::size_t iZone); // hint: the reading of the zone "iZone" starts
 };
 
 // ----------------------------------------------------------------------------
@@ -92,12 +135,16 @@ struct s_sampler
 template<>
 struct s_sampler<s_RBGA8, SDL_Surface>
 {
+  static constexpr bool isThreadSafe = true;
   SDL_Surface *m_surf;
 
   s_sampler(SDL_Surface *s) : m_surf(s)
   {
   }
 
+  void schedule(const std::vector<glm::uvec4> &) {}
+  void scheduleStep(std::size_t) {}
+
   uint8_t *pixelAdress(uint u, uint v) const
   {
     return reinterpret_cast<uint8_t*>(m_surf->pixels) + v * uint(m_surf->pitch) + u * m_surf->format->BytesPerPixel;
@@ -169,12 +216,16 @@ struct s_sampler<s_RBGA8, SDL_Surface>
 template<>
 struct s_sampler<float, SDL_Surface>
 {
+  static constexpr bool isThreadSafe = true;
   s_sampler<s_RBGA8, SDL_Surface> m_sampler;
 
   s_sampler(SDL_Surface *s) : m_sampler(s)
   {
   }
 
+  void schedule(const std::vector<glm::uvec4> &) {}
+  void scheduleStep(std::size_t) {}
+
   float pixelGet(uint u, uint v) const
   {
     return float(m_sampler.pixelGet(u, v).r) / float(0xFF);
@@ -189,11 +240,20 @@ struct s_sampler<float, SDL_Surface>
 
 // ----------------------------------------------------------------------------
 
+static std::mutex                          s_TIFFCache_mutex; // protects the settings and the stats
+static textureSampler::s_TIFFCacheSettings s_TIFFCache_settings;
+static textureSampler::s_TIFFCacheStats    s_TIFFCache_stats;
+
 #ifdef TRE_WITH_LIBTIFF
 
 static const char * orientationNames[] = { "default", "top-left", "top-right", "bot-right", "bot-left", "top-left (COL-MAJOR)", "top-right (COL-MAJOR)", "bot-right (COL-MAJOR)", "bot-left (COL-MAJOR)" };
 static const char * formatNames[] = { "Invalid", "R32F", "RGBA8", "RGB8" };
 
+/**
+ * The driver decodes the strips (or the tiles) of the TIFF image on demand, and keeps them in a LRU-cache bounded by a memory budget.
+ * A zone-schedule can be given: a background thread then decodes ahead the strips (or tiles) of the next zones.
+ * The requests are not thread-safe (the returned pixel is valid until the next request), but they can be done from any thread.
+ */
 struct s_driverTIFF
 {
   TIFF *m_tiff;
@@ -201,21 +261,50 @@ struct s_driverTIFF
   bool m_flipV = false;
 
   enum s_pixelFormat { INVALID, R32F, RGBA8, RGB8 }; // list of supported format by the "s_driverTIFF"
-  s_pixelFormat m_sourceFormat;
+  s_pixelFormat m_sourceFormat = INVALID;
 
   uint m_bytesPerPixel = 0;
-  tsize_t  m_stripSizeInBytes = 0;
-  uint m_rowsPerStrip = 0;
 
-  mutable tstrip_t m_decodedStripID;
-  mutable char*    m_decodedStripData;
+  bool    m_isTiled = false;
+  uint    m_blockW = 0, m_blockH = 0; // size of a strip or of a tile (in pixels)
+  uint    m_blockCountU = 1;           // number of tiles per row (1 for strips)
+  tsize_t m_blockSizeInBytes = 0;
+
+  struct s_block
+  {
+    uint32_t m_id;
+    char     *m_data;
+  };
+
+  typedef std::list<s_block> t_blockList;
+
+  // cache (LRU: the front is the most recently used)
+
+  mutable std::mutex                                            m_mutex; // protects the cache, the schedule and the TIFF handle
+  mutable t_blockList                                           m_blocks;
+  mutable std::unordered_map<uint32_t, t_blockList::iterator>  m_blockMap;
+  mutable const s_block                                         *m_lastBlock = nullptr; // never evicted (the last requested pixel points to it)
+  std::size_t                                                   m_blockCapacity = 2;
+
+  // prefetch
+
+  std::vector<uint32_t>    m_schedule;           // list of the blocks, in the order of the zones
+  std::vector<std::size_t> m_scheduleZoneStart;  // for each zone, its first block in "m_schedule"
+  std::size_t              m_scheduleCursor = 0; // first block of the current zone
+  std::size_t              m_prefetchNext = 0;
+  bool                     m_prefetchQuit = false;
+#ifdef TRE_WITH_THREADS
+  std::condition_variable  m_prefetchCV;
+  std::thread              m_prefetchThread;
+#endif
+
+  mutable textureSampler::s_TIFFCacheStats m_stats;
 
 #ifdef TRE_DEBUG
   mutable uint m_perfCount_pixelReqCount = 0;
-  mutable uint m_perfCount_decodeCount = 0;
 #endif
 
-  s_driverTIFF(TIFF *s) : m_tiff(s)
+  s_driverTIFF(TIFF *s, const textureSampler::s_TIFFCacheSettings *customSettings = nullptr) : m_tiff(s)
   {
     TIFFGetField(m_tiff, TIFFTAG_IMAGEWIDTH, &m_w);
     TIFFGetField(m_tiff, TIFFTAG_IMAGELENGTH, &m_h);
@@ -245,16 +334,33 @@ struct s_driverTIFF
     }
     TRE_ASSERT(m_sourceFormat != INVALID);
 
-    // Get buffer size
-
-    const uint stripCount = TIFFNumberOfStrips(m_tiff);
-    m_stripSizeInBytes = tsize_t(TIFFStripSize(m_tiff));
-    TIFFGetField(m_tiff, TIFFTAG_ROWSPERSTRIP, &m_rowsPerStrip);
-
     m_bytesPerPixel = bytesPerSample * samplePerPixel;
-    m_stripSizeInBytes = tsize_t(TIFFStripSize(m_tiff));
 
-    TRE_ASSERT(stripCount != 0 && m_stripSizeInBytes != 0 && m_rowsPerStrip != 0);
+    // Get the layout (strips or tiles)
+
+    m_isTiled = (TIFFIsTiled(m_tiff) != 0);
+    uint blockCount = 0;
+    if (m_isTiled)
+    {
+      TIFFGetField(m_tiff, TIFFTAG_TILEWIDTH, &m_blockW);
+      TIFFGetField(m_tiff, TIFFTAG_TILELENGTH, &m_blockH);
+      TRE_ASSERT(m_blockW != 0 && m_blockH != 0);
+      m_blockCountU = (m_w + m_blockW - 1) / m_blockW;
+      m_blockSizeInBytes = tsize_t(TIFFTileSize(m_tiff));
+      blockCount = TIFFNumberOfTiles(m_tiff);
+    }
+    else
+    {
+      m_blockW = m_w;
+      m_blockH = m_h;
+      TIFFGetField(m_tiff, TIFFTAG_ROWSPERSTRIP, &m_blockH);
+      m_blockH = glm::min(m_blockH, m_h);
+      m_blockCountU = 1;
+      m_blockSizeInBytes = tsize_t(TIFFStripSize(m_tiff));
+      blockCount = TIFFNumberOfStrips(m_tiff);
+    }
+    TRE_ASSERT(blockCount != 0 && m_blockSizeInBytes != 0 && m_blockH != 0);
+    TRE_ASSERT(tsize_t(m_blockW * m_blockH * m_bytesPerPixel) <= m_blockSizeInBytes);
 
     // Check orientation
     uint16_t orient = 0;
@@ -267,26 +373,63 @@ struct s_driverTIFF
       TRE_LOG("TIFF: unsupported image orientation. Ignore this error.");
     }
 
-    // Allocate data
-    m_decodedStripID = tstrip_t(std::numeric_limits<int>::max());
-    m_decodedStripData = reinterpret_cast<char*>(_TIFFmalloc(m_stripSizeInBytes));
-    TRE_ASSERT(m_decodedStripData != nullptr);
+    // Cache settings
+    textureSampler::s_TIFFCacheSettings settings;
+    if (customSettings != nullptr)
+    {
+      settings = *customSettings;
+    }
+    else
+    {
+      std::lock_guard<std::mutex> lockSettings(s_TIFFCache_mutex);
+      settings = s_TIFFCache_settings;
+    }
+    m_blockCapacity = glm::max(std::size_t(2), settings.m_budgetInBytes / std::size_t(m_blockSizeInBytes));
+    m_blockMap.reserve(m_blockCapacity + 1);
+#ifdef TRE_WITH_THREADS
+    if (settings.m_prefetch) m_prefetchThread = std::thread(&s_driverTIFF::_prefetchLoop, this);
+#endif
 
     // Log
     TRE_LOG("TIFF Image sampler Info" << std::endl <<
-            "- Source = " << formatNames[m_sourceFormat] << " format with dimension " << m_w << " * " << m_h << " with " << orientationNames[orient] << " orientation" << std::endl <<
+            "- Source = " << formatNames[m_sourceFormat] << " format with dimension " << m_w << " * " << m_h << " with " << orientationNames[orient < 9 ? orient : 0] << " orientation" << std::endl <<
             "- BytesPerPixel = " << bytesPerSample << " BytesPerSample * " << samplePerPixel << " SamplesPerPixel" << std::endl <<
-            "- strips = " << stripCount << " strips of size " << m_stripSizeInBytes << " bytes (" << m_rowsPerStrip << " rows per strip)" << std::endl);
+            "- " << (m_isTiled ? "tiles = " : "strips = ") << blockCount << " blocks of size " << m_blockSizeInBytes << " bytes (" << m_blockW << " * " << m_blockH << " pixels)" << std::endl <<
+            "- cache = " << m_blockCapacity << " blocks, prefetch " << (settings.m_prefetch ? "enabled" : "disabled") << std::endl);
   }
 
   ~s_driverTIFF()
   {
-    if (m_decodedStripData != nullptr) _TIFFfree(m_decodedStripData);
-    m_decodedStripData = nullptr;
+#ifdef TRE_WITH_THREADS
+    if (m_prefetchThread.joinable())
+    {
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_prefetchQuit = true;
+      }
+      m_prefetchCV.notify_all();
+      m_prefetchThread.join();
+    }
+#endif
+    for (s_block &block : m_blocks) _TIFFfree(block.m_data);
+    m_blocks.clear();
+    m_blockMap.clear();
 #ifdef TRE_DEBUG
-    TRE_LOG("TIFF Driver perf-counter: NPixelRequests = " << m_perfCount_pixelReqCount << ", NDecodedStrip = " << m_perfCount_decodeCount << " ( " <<
-            float(m_perfCount_decodeCount) / float(m_perfCount_pixelReqCount) * 100.f << " %)");
+    TRE_LOG("TIFF Driver perf-counter: NPixelRequests = " << m_perfCount_pixelReqCount << ", NDecodedBlocks = " << m_stats.m_decodeCount << " (" <<
+            m_stats.m_prefetchCount << " prefetched, " << m_stats.m_missCount << " cache-misses)");
 #endif
+    {
+      std::lock_guard<std::mutex> lockStats(s_TIFFCache_mutex);
+      s_TIFFCache_stats.m_decodeCount   += m_stats.m_decodeCount;
+      s_TIFFCache_stats.m_prefetchCount += m_stats.m_prefetchCount;
+      s_TIFFCache_stats.m_missCount     += m_stats.m_missCount;
+      s_TIFFCache_stats.m_peakBytes      = glm::max(s_TIFFCache_stats.m_peakBytes, m_stats.m_peakBytes);
+    }
+  }
+
+  uint32_t blockID(uint u, uint v) const // v is in the file orientation
+  {
+    return (v / m_blockH) * m_blockCountU + (u / m_blockW);
   }
 
   char *requestPixel(uint u, uint v) const
@@ -297,35 +440,128 @@ struct s_driverTIFF
 
     if (m_flipV) v = m_h - 1 - v;
 
-    tstrip_t reqStrip = TIFFComputeStrip(m_tiff, v, 0);
+    const uint32_t reqBlock = blockID(u, v);
 
-    if (reqStrip != m_decodedStripID)
+    if (m_lastBlock == nullptr || m_lastBlock->m_id != reqBlock)
     {
-      // load a new strip ...
-      m_decodedStripID = reqStrip;
-      tsize_t ret = TIFFReadEncodedStrip(m_tiff, reqStrip, m_decodedStripData, -1);
-      TRE_ASSERT(ret != -1);
-#ifdef TRE_DEBUG
-      ++m_perfCount_decodeCount;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_lastBlock = _getBlock(reqBlock, false);
+    }
+
+    u = u % m_blockW;
+    v = v % m_blockH;
+
+    TRE_ASSERT((v * m_blockW + u) * m_bytesPerPixel < uint(m_blockSizeInBytes));
+    return m_lastBlock->m_data + (v * m_blockW + u) * m_bytesPerPixel;
+  }
+
+  /// Set the zones (u-min, u-max, v-min, v-max, in pixels and inclusive) that will be sampled, in that order.
+  void schedule(const std::vector<glm::uvec4> &zones)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_schedule.clear();
+    m_scheduleZoneStart.resize(zones.size());
+    std::vector<uint32_t> zoneBlocks;
+    for (std::size_t iZone = 0; iZone < zones.size(); ++iZone)
+    {
+      m_scheduleZoneStart[iZone] = m_schedule.size();
+      glm::uvec4 zone = glm::min(zones[iZone], glm::uvec4(m_w - 1, m_w - 1, m_h - 1, m_h - 1));
+      if (m_flipV) zone = glm::uvec4(zone.x, zone.y, m_h - 1 - zone.w, m_h - 1 - zone.z);
+      for (uint v = zone.z - zone.z % m_blockH; v <= zone.w; v += m_blockH)
+        for (uint u = zone.x - zone.x % m_blockW; u <= zone.y; u += m_blockW)
+          m_schedule.push_back(blockID(u, v));
+    }
+    m_scheduleCursor = 0;
+    m_prefetchNext = 0;
+#ifdef TRE_WITH_THREADS
+    m_prefetchCV.notify_all();
+#endif
+  }
+
+  /// Notify that the sampling of the zone "iZone" starts. The prefetch stays ahead of it.
+  void scheduleStep(std::size_t iZone)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (iZone >= m_scheduleZoneStart.size()) return;
+    m_scheduleCursor = glm::max(m_scheduleCursor, m_scheduleZoneStart[iZone]);
+    m_prefetchNext = glm::max(m_prefetchNext, m_scheduleCursor); // skip what is late
+#ifdef TRE_WITH_THREADS
+    m_prefetchCV.notify_all();
 #endif
+  }
+
+private:
+
+  /// Get the block from the cache, or decode it. The mutex must be locked.
+  const s_block *_getBlock(const uint32_t id, const bool isPrefetch) const
+  {
+    auto itMap = m_blockMap.find(id);
+    if (itMap != m_blockMap.end())
+    {
+      m_blocks.splice(m_blocks.begin(), m_blocks, itMap->second); // mark as the most recently used
+      return &m_blocks.front();
     }
 
-    v = v % m_rowsPerStrip;
+    // evict the least recently used blocks
+    char *data = nullptr;
+    while (m_blocks.size() >= m_blockCapacity)
+    {
+      auto itLast = std::prev(m_blocks.end());
+      if (&*itLast == m_lastBlock) m_blocks.splice(m_blocks.begin(), m_blocks, itLast); // keep the block in use
+      itLast = std::prev(m_blocks.end());
+      m_blockMap.erase(itLast->m_id);
+      if (data != nullptr) _TIFFfree(data);
+      data = itLast->m_data; // recycle the buffer
+      m_blocks.erase(itLast);
+    }
+    if (data == nullptr) data = reinterpret_cast<char*>(_TIFFmalloc(m_blockSizeInBytes));
+    TRE_ASSERT(data != nullptr);
+
+    // decode
+    const tsize_t ret = m_isTiled ? TIFFReadEncodedTile(m_tiff, ttile_t(id), data, m_blockSizeInBytes) :
+                                    TIFFReadEncodedStrip(m_tiff, tstrip_t(id), data, m_blockSizeInBytes);
+    TRE_ASSERT(ret != -1);
+    (void)ret;
+
+    ++m_stats.m_decodeCount;
+    if (isPrefetch) ++m_stats.m_prefetchCount;
+    else            ++m_stats.m_missCount;
+
+    m_blocks.push_front(s_block{id, data});
+    m_blockMap[id] = m_blocks.begin();
+    m_stats.m_peakBytes = glm::max(m_stats.m_peakBytes, m_blocks.size() * std::size_t(m_blockSizeInBytes));
+    return &m_blocks.front();
+  }
 
-    TRE_ASSERT((v * m_w + u) * m_bytesPerPixel <= uint(m_stripSizeInBytes));
-    return m_decodedStripData + (v * m_w + u) * m_bytesPerPixel;
+#ifdef TRE_WITH_THREADS
+  void _prefetchLoop()
+  {
+    const std::size_t lookAhead = glm::max(std::size_t(1), m_blockCapacity / 2); // keep half of the cache for the blocks in use
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true)
+    {
+      m_prefetchCV.wait(lock, [&] { return m_prefetchQuit || (m_prefetchNext < m_schedule.size() && m_prefetchNext < m_scheduleCursor + lookAhead); });
+      if (m_prefetchQuit) break;
+      const uint32_t id = m_schedule[m_prefetchNext++];
+      _getBlock(id, true);
+    }
   }
+#endif
 };
 
 template<>
 struct s_sampler<s_RBGA8, TIFF>
 {
+  static constexpr bool isThreadSafe = false; // the driver holds the decoded strip
   s_driverTIFF m_driverTiff;
 
-  s_sampler(TIFF *s) : m_driverTiff(s)
+  s_sampler(TIFF *s, const textureSampler::s_TIFFCacheSettings *customSettings = nullptr) : m_driverTiff(s, customSettings)
   {
   }
 
+  void schedule(const std::vector<glm::uvec4> &zones) { m_driverTiff.schedule(zones); }
+  void scheduleStep(std::size_t iZone) { m_driverTiff.scheduleStep(iZone); }
+
   s_RBGA8 pixelGet(uint u, uint v) const
   {
     if (m_driverTiff.m_sourceFormat == s_driverTIFF::R32F)
@@ -355,12 +591,16 @@ struct s_sampler<s_RBGA8, TIFF>
 template<>
 struct s_sampler<float, TIFF>
 {
+  static constexpr bool isThreadSafe = false; // the driver holds the decoded strip
   s_driverTIFF m_driverTiff;
 
-  s_sampler(TIFF *s) : m_driverTiff(s)
+  s_sampler(TIFF *s, const textureSampler::s_TIFFCacheSettings *customSettings = nullptr) : m_driverTiff(s, customSettings)
   {
   }
 
+  void schedule(const std::vector<glm::uvec4> &zones) { m_driverTiff.schedule(zones); }
+  void scheduleStep(std::size_t iZone) { m_driverTiff.scheduleStep(iZone); }
+
   float pixelGet(uint u, uint v) const
   {
     if (m_driverTiff.m_sourceFormat == s_driverTIFF::R32F)
@@ -388,6 +628,7 @@ struct s_sampler<float, TIFF>
 template<>
 struct s_sampler<float, textureSampler::s_ImageData_R32F>
 {
+  static constexpr bool isThreadSafe = true;
   textureSampler::s_ImageData_R32F *m_sampler;
 
   s_sampler(textureSampler::s_ImageData_R32F *s) : m_sampler(s)
@@ -395,6 +636,9 @@ struct s_sampler<float, textureSampler::s_ImageData_R32F>
     TRE_ASSERT(m_sampler->pixels != nullptr);
   }
 
+  void schedule(const std::vector<glm::uvec4> &) {}
+  void scheduleStep(std::size_t) {}
+
   float pixelGet(uint u, uint v) const
   {
     return m_sampler->pixels[v * m_sampler->w + u];
@@ -415,6 +659,7 @@ struct s_sampler<float, textureSampler::s_ImageData_R32F>
 struct s_kernel_C0
 {
   // C0 kernel: f(x) = { 1 - |x| if |x| <= 1, 0 elsewhere }
+  // The data is row-major: data[iv * dataW + iu]
 
   static inline float kernel_intg_x1(const float &_s, const float &_e)
   {
@@ -425,32 +670,63 @@ struct s_kernel_C0
     return wL0 + w0R;
   }
 
-  template<typename _T> static _T sampleValue(_T * __restrict data, const uint dataW, const uint dataH, const glm::vec4 &uuvv)
+  static inline __m128 kernel_intg_x4(const __m128 _s, const __m128 _e)
+  {
+    const __m128 one     = _mm_set1_ps(1.f);
+    const __m128 two     = _mm_set1_ps(2.f);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    const __m128 s = _mm_min_ps(_mm_max_ps(_s, _mm_set1_ps(-1.f)), one);
+    const __m128 e = _mm_min_ps(_mm_max_ps(_e, _mm_set1_ps(-1.f)), one);
+    const __m128 wL0 = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(-0.5f), _mm_sub_ps(two, _mm_and_ps(s, absMask))), s);
+    const __m128 w0R = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps( 0.5f), _mm_sub_ps(two, _mm_and_ps(e, absMask))), e);
+    return _mm_add_ps(wL0, w0R);
+  }
+
+  template<typename _T> static _T sampleValue(const _T * __restrict data, const uint dataW, const uint dataH, const glm::vec4 &uuvv)
   {
-    const glm::vec4  uuvv_Kf = uuvv - 0.5f;
-    const glm::uvec4 uuvv_Ki = glm::clamp(uuvv_Kf, glm::vec4(0.f), glm::vec4(dataW, dataW, dataH, dataH));
+    const float u_KfStart = uuvv.x - 0.5f, u_KfEnd = uuvv.y - 0.5f;
+    const float v_KfStart = uuvv.z - 0.5f, v_KfEnd = uuvv.w - 0.5f;
+
+    const uint iuStart = uint(glm::clamp(u_KfStart, 0.f, float(dataW))), iuStop = glm::min(uint(glm::clamp(u_KfEnd, 0.f, float(dataW))) + 1, dataW - 1);
+    const uint ivStart = uint(glm::clamp(v_KfStart, 0.f, float(dataH))), ivStop = glm::min(uint(glm::clamp(v_KfEnd, 0.f, float(dataH))) + 1, dataH - 1);
 
-    _T     value  = _T(0);
-    float  weight = 0.f;
+    // The kernel is separable: the weights over "u" are shared by all rows.
+    // They are computed by chunk of columns, so the footprint is not bounded.
 
-    for (uint iv = uuvv_Ki.z, ivStop = glm::min(uuvv_Ki.w + 1, dataH - 1); iv <= ivStop; ++iv)
+    static constexpr uint chunkSize = 64;
+    alignas(16) float u_w[chunkSize];
+
+    _T     value   = _T(0);
+    float  weightU = 0.f;
+    float  weightV = 0.f;
+
+    for (uint iu0 = iuStart; iu0 <= iuStop; iu0 += chunkSize)
     {
-      const float v_fStart = uuvv_Kf.z - iv;
-      const float v_fEnd   = uuvv_Kf.w - iv;
-      const float v_w      = kernel_intg_x1(v_fStart, v_fEnd);
+      const uint nu = glm::min(chunkSize, iuStop + 1 - iu0);
 
-      for (uint iu = uuvv_Ki.x, iuStop = glm::min(uuvv_Ki.y + 1, dataW - 1); iu <= iuStop; ++iu)
+      const __m128 lane      = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+      const __m128 u_fStart0 = _mm_sub_ps(_mm_set1_ps(u_KfStart - iu0), lane);
+      const __m128 u_fEnd0   = _mm_sub_ps(_mm_set1_ps(u_KfEnd - iu0), lane);
+      __m128       u_wSum    = _mm_setzero_ps();
+      for (uint i = 0; i < nu; i += 4)
       {
-        const float u_fStart = uuvv_Kf.x - iu;
-        const float u_fEnd   = uuvv_Kf.y - iu;
-        const float u_w      = kernel_intg_x1(u_fStart, u_fEnd);
+        const __m128 offset = _mm_set1_ps(float(i));
+        const __m128 inside = _mm_cmplt_ps(_mm_add_ps(lane, offset), _mm_set1_ps(float(nu))); // mask the lanes after the last column
+        const __m128 w4     = _mm_and_ps(kernel_intg_x4(_mm_sub_ps(u_fStart0, offset), _mm_sub_ps(u_fEnd0, offset)), inside);
+        _mm_store_ps(u_w + i, w4);
+        u_wSum = _mm_add_ps(u_wSum, w4);
+      }
+      weightU += _horizontalSum(u_wSum);
 
-        const float w_uv = u_w * v_w;
-        weight += w_uv;
-        value += data[iu * dataH + iv] * w_uv;
+      for (uint iv = ivStart; iv <= ivStop; ++iv)
+      {
+        const float v_w = kernel_intg_x1(v_KfStart - iv, v_KfEnd - iv);
+        if (iu0 == iuStart) weightV += v_w;
+        value += _weightedSum(data + iv * dataW + iu0, u_w, nu) * v_w;
       }
     }
 
+    const float weight = weightU * weightV;
     TRE_ASSERT(weight > 0.f);
 
     return value * (1.f / weight);
@@ -480,34 +756,70 @@ void resample_imp(_Sout *outTexture, const uint out_un, const uint out_vn,
   // the tile is 32*32 out-pixels
   const glm::uvec2 tile_nm_out = glm::uvec2(32u);
   const glm::vec2  tile_uv_in = glm::vec2(tile_nm_out) * px_uv;
-  const glm::ivec2 tile_nm_in = tile_uv_in * inWH + 4.f; /* + margin */
+  const glm::ivec2 tile_nm_in = tile_uv_in * inWH + 8.f; /* + margin (kernel support and rounding of the tile center) */
   const glm::ivec4 tile_nnmm_in = glm::ivec4(-tile_nm_in.x, tile_nm_in.x, -tile_nm_in.y, tile_nm_in.y) / 2;
 
-  std::vector<_Tcompute> px_data_in;
-  px_data_in.resize(tile_nm_in.x * tile_nm_in.y);
-  TRE_ASSERT(px_data_in.size() == tile_nm_in.x * tile_nm_in.y);
+  const uint tileCountU = (out_un + tile_nm_out.x - 1) / tile_nm_out.x;
+  const uint tileCountV = (out_vn + tile_nm_out.y - 1) / tile_nm_out.y;
+
+  std::mutex mutexIn; // used when the in-sampler is not thread-safe
 
-  for (uint iv = 0; iv < out_vn; iv += tile_nm_out.y)
+  // get the tiles bounds (in in-pixel unit), and give the reading order to the in-sampler
+
+  std::vector<glm::ivec4> tiles_nnmm_in;
+  tiles_nnmm_in.resize(tileCountU * tileCountV);
+  std::vector<glm::uvec4> tiles_zone_in;
+  tiles_zone_in.resize(tileCountU * tileCountV);
+
+  for (uint iTile = 0; iTile < tileCountU * tileCountV; ++iTile)
   {
+    const uint iu = (iTile % tileCountU) * tile_nm_out.x;
+    const uint iv = (iTile / tileCountU) * tile_nm_out.y;
+    const uint iuCount = glm::min(out_un - iu, tile_nm_out.x);
     const uint ivCount = glm::min(out_vn - iv, tile_nm_out.y);
 
-    for (uint iu = 0; iu < out_un; iu += tile_nm_out.x)
+    const glm::vec2 curtile_uv_C = in_coord0 + du * float(iu + 0.5f + 0.5f * iuCount) + dv * float(iv + 0.5f + 0.5f * ivCount);
+    const glm::ivec2 curtile_nm_C = curtile_uv_C * inWH;
+    tiles_nnmm_in[iTile] = glm::ivec4(curtile_nm_C.x, curtile_nm_C.x, curtile_nm_C.y, curtile_nm_C.y) + tile_nnmm_in;
+
+    const glm::ivec4 zone = glm::ivec4(tiles_nnmm_in[iTile].x, tiles_nnmm_in[iTile].x + tile_nm_in.x - 1, tiles_nnmm_in[iTile].z, tiles_nnmm_in[iTile].z + tile_nm_in.y - 1);
+    tiles_zone_in[iTile] = glm::uvec4(glm::clamp(zone, glm::ivec4(0), glm::ivec4(in_un - 1, in_un - 1, in_vn - 1, in_vn - 1)));
+  }
+
+  samplerIn.schedule(tiles_zone_in);
+
+  // the tiles are processed in parallel: each task has its own in-pixel buffer (row-major)
+
+  parallelFor(tileCountU * tileCountV, 1, [&](std::size_t iTileBegin, std::size_t iTileEnd)
+  {
+    std::vector<_Tcompute> px_data_in;
+    px_data_in.resize(tile_nm_in.x * tile_nm_in.y);
+    TRE_ASSERT(px_data_in.size() == std::size_t(tile_nm_in.x * tile_nm_in.y));
+
+    for (std::size_t iTile = iTileBegin; iTile < iTileEnd; ++iTile)
     {
+      const uint iu = uint(iTile % tileCountU) * tile_nm_out.x;
+      const uint iv = uint(iTile / tileCountU) * tile_nm_out.y;
       const uint iuCount = glm::min(out_un - iu, tile_nm_out.x);
+      const uint ivCount = glm::min(out_vn - iv, tile_nm_out.y);
 
-      // get tile bounds
-      const glm::vec2 curtile_uv_C = in_coord0 + du * float(iu + 0.5f + 0.5f * iuCount) + dv * float(iv + 0.5f + 0.5f * ivCount);
-      const glm::ivec2 curtile_nm_C = curtile_uv_C * inWH;
-      const glm::ivec4 curtile_nnmm_in = glm::ivec4(curtile_nm_C.x, curtile_nm_C.x, curtile_nm_C.y, curtile_nm_C.y) + tile_nnmm_in;
+      const glm::ivec4 &curtile_nnmm_in = tiles_nnmm_in[iTile];
 
       // get in-pixel data
-      for (int ivL = 0; ivL < tile_nm_in.y; ++ivL)
       {
-        const uint ivIn = uint(glm::clamp(curtile_nnmm_in.z + ivL, 0, int(in_vn - 1)));
-        for (int iuL = 0; iuL < tile_nm_in.x; ++iuL)
+        std::unique_lock<std::mutex> lockIn(mutexIn, std::defer_lock);
+        if (!s_sampler<_Tin, _Sin>::isThreadSafe) lockIn.lock();
+        samplerIn.scheduleStep(iTile);
+
+        for (int ivL = 0; ivL < tile_nm_in.y; ++ivL)
         {
-          const uint iuIn = uint(glm::clamp(curtile_nnmm_in.x + iuL, 0, int(in_un - 1)));
-          px_data_in[iuL * tile_nm_in.y + ivL] = samplerIn.pixelGet(iuIn, ivIn);
+          const uint ivIn = uint(glm::clamp(curtile_nnmm_in.z + ivL, 0, int(in_vn - 1)));
+          _Tcompute *px_row = px_data_in.data() + ivL * tile_nm_in.x;
+          for (int iuL = 0; iuL < tile_nm_in.x; ++iuL)
+          {
+            const uint iuIn = uint(glm::clamp(curtile_nnmm_in.x + iuL, 0, int(in_un - 1)));
+            px_row[iuL] = samplerIn.pixelGet(iuIn, ivIn);
+          }
         }
       }
 
@@ -527,7 +839,7 @@ void resample_imp(_Sout *outTexture, const uint out_un, const uint out_vn,
 
       // end of tile sampling
     }
-  }
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -733,6 +1045,181 @@ static glm::vec2 coord_3D_To_2DMap_Repeat(const glm::vec3 &coordUVW, const glm::
   return ret;
 }
 
+static glm::vec4 coord_3D_To_2DMap_Zone(const glm::vec3 &in_coord3D, const glm::vec3 &du, const glm::vec3 &dv, const glm::vec2 &coordRef) // sampling-zone (uuvv) of 1 out-pixel
+{
+  const glm::vec2 in_coordMap = coord_3D_To_2DMap_Repeat(in_coord3D, coordRef);
+
+  const glm::vec3 in_P = glm::normalize(in_coord3D);
+  const glm::vec3 in_dPu = glm::normalize(in_coord3D + 0.5f * du) - in_P;
+  const glm::vec3 in_dPv = glm::normalize(in_coord3D + 0.5f * dv) - in_P;
+  const glm::vec3 map_derr = coord_3D_To_2DMap_Deriv(in_coord3D);
+
+  const glm::vec2 dudv_onU = glm::abs(glm::vec2(map_derr.x * in_dPu.x + map_derr.y * in_dPu.z, map_derr.z * in_dPu.y));
+  const glm::vec2 dudv_onP = glm::abs(glm::vec2(map_derr.x * in_dPv.x + map_derr.y * in_dPv.z, map_derr.z * in_dPv.y));
+
+  const glm::vec2 dudv = glm::max(dudv_onU + dudv_onP, glm::vec2(1.e-6f));
+
+  return glm::vec4(in_coordMap.x - dudv.x, in_coordMap.x + dudv.x, in_coordMap.y - dudv.y, in_coordMap.y + dudv.y);
+}
+
+//-----------------------------------------------------------------------------
+
+/// Projection of the out-pixels of a cube-map face into the equirectangular in-texture
+struct s_cubeMapProjection
+{
+  glm::vec3  m_coord0, m_du, m_dv;
+  glm::vec2  m_coordMapCenter; // to handle the latitude-repeat
+  glm::vec4  m_inWWHH;
+  uint       m_in_un, m_in_vn;
+
+  s_cubeMapProjection(const uint out_un, const uint out_vn, const uint in_un, const uint in_vn,
+                      const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr)
+  {
+    m_coord0 = in_coord0;
+    m_du = in_coordU_incr / float(out_un);
+    m_dv = in_coordV_incr / float(out_vn);
+    m_coordMapCenter = coord_3D_To_2DMap(in_coord0 + m_du * float(out_un / 2 + 0.5f) + m_dv * float(out_vn / 2 + 0.5f));
+    m_inWWHH = glm::vec4(in_un, in_un, in_vn, in_vn);
+    m_in_un = in_un;
+    m_in_vn = in_vn;
+  }
+
+  /// sampling-zone of the out-pixel (iu, iv), in in-pixel unit
+  glm::vec4 pixelZone(const uint iu, const uint iv) const
+  {
+    const glm::vec3 in_coord3D = m_coord0 + m_du * float(iu + 0.5f) + m_dv * float(iv + 0.5f);
+    return coord_3D_To_2DMap_Zone(in_coord3D, m_du, m_dv, m_coordMapCenter) * m_inWWHH;
+  }
+
+  /// bounding-box of the sampling-zones of the out-pixels [iu0, iu1[ * [iv0, iv1[, with the kernel's support (in in-pixel unit)
+  glm::ivec4 bounds(const uint iu0, const uint iu1, const uint iv0, const uint iv1) const
+  {
+    std::vector<glm::vec4> row_nnmm;
+    row_nnmm.resize(iv1 - iv0);
+
+    parallelFor(iv1 - iv0, 8, [&](std::size_t ivBegin, std::size_t ivEnd)
+    {
+      for (std::size_t ivL = ivBegin; ivL < ivEnd; ++ivL)
+      {
+        glm::vec4 cur_nnmm = glm::vec4(std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+                                       std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+        for (uint iu = iu0; iu < iu1; ++iu)
+        {
+          const glm::vec4 nnmm = pixelZone(iu, iv0 + uint(ivL));
+          cur_nnmm = glm::vec4(glm::min(cur_nnmm.x, nnmm.x), glm::max(cur_nnmm.y, nnmm.y), glm::min(cur_nnmm.z, nnmm.z), glm::max(cur_nnmm.w, nnmm.w));
+        }
+        row_nnmm[ivL] = cur_nnmm;
+      }
+    });
+
+    glm::vec4 bound_nnmm = row_nnmm[0];
+    for (const glm::vec4 &cur_nnmm : row_nnmm)
+      bound_nnmm = glm::vec4(glm::min(bound_nnmm.x, cur_nnmm.x), glm::max(bound_nnmm.y, cur_nnmm.y), glm::min(bound_nnmm.z, cur_nnmm.z), glm::max(bound_nnmm.w, cur_nnmm.w));
+
+    // the kernel reads the pixels [floor(n - 0.5), floor(m - 0.5) + 1]
+    const glm::ivec4 nnmm = glm::ivec4(glm::floor(bound_nnmm - 0.5f)) + glm::ivec4(0, 2, 0, 2);
+    TRE_ASSERT(nnmm.y > nnmm.x && nnmm.w > nnmm.z);
+    TRE_ASSERT(nnmm.x > -int(m_in_un) && nnmm.y < 2 * int(m_in_un));
+    TRE_ASSERT(nnmm.z > -int(m_in_vn) && nnmm.w < 2 * int(m_in_vn));
+    return nnmm;
+  }
+
+  /// in-pixel row for the cached row "ivRaw" (pole-flip)
+  uint inRow(const int ivRaw, bool &isFlipped) const
+  {
+    isFlipped = (ivRaw < 0 || ivRaw >= int(m_in_vn));
+    return !isFlipped ? uint(ivRaw) : (ivRaw < 0) ? uint(-ivRaw) : uint(m_in_vn * 2 - 1 - ivRaw);
+  }
+
+  /// zone of the in-texture (u-min, u-max, v-min, v-max, inclusive) read for the cached rows [iv0, iv1[ of the cache "nnmm"
+  glm::uvec4 inZone(const glm::ivec4 &nnmm, const int iv0, const int iv1) const
+  {
+    bool isRepeatedU = (nnmm.x < 0 || nnmm.y > int(m_in_un));
+    glm::uvec2 zoneV = glm::uvec2(m_in_vn, 0);
+    for (int ivRaw = iv0; ivRaw < iv1; ++ivRaw)
+    {
+      bool isFlipped;
+      const uint iv = inRow(ivRaw, isFlipped);
+      isRepeatedU |= isFlipped;
+      zoneV = glm::uvec2(glm::min(zoneV.x, iv), glm::max(zoneV.y, iv));
+    }
+    return isRepeatedU ? glm::uvec4(0, m_in_un - 1, zoneV.x, zoneV.y) : glm::uvec4(nnmm.x, nnmm.y - 1, zoneV.x, zoneV.y);
+  }
+
+  /// fill the cache (row-major) of the in-pixels "nnmm". With "scheduleRows", the reading order is given to the in-sampler.
+  template<typename _Tcompute, typename _Tin, class _Sin>
+  void fillCache(s_sampler<_Tin, _Sin> &samplerIn, const glm::ivec4 &nnmm, std::vector<_Tcompute> &px_data_in, const bool scheduleRows) const
+  {
+    const glm::uvec2 nm = glm::uvec2(nnmm.y - nnmm.x, nnmm.w - nnmm.z);
+    px_data_in.resize(nm.x * nm.y);
+
+    const uint cacheGrain = 16;
+
+    if (scheduleRows)
+    {
+      std::vector<glm::uvec4> chunks_zone_in;
+      chunks_zone_in.resize((nm.y + cacheGrain - 1) / cacheGrain);
+      for (uint iChunk = 0; iChunk < chunks_zone_in.size(); ++iChunk)
+        chunks_zone_in[iChunk] = inZone(nnmm, nnmm.z + int(iChunk * cacheGrain), nnmm.z + int(glm::min(iChunk * cacheGrain + cacheGrain, nm.y)));
+      samplerIn.schedule(chunks_zone_in);
+    }
+
+    std::mutex mutexIn; // used when the in-sampler is not thread-safe
+
+    parallelFor(nm.y, cacheGrain, [&](std::size_t ivCacheBegin, std::size_t ivCacheEnd)
+    {
+      std::unique_lock<std::mutex> lockIn(mutexIn, std::defer_lock);
+      if (!s_sampler<_Tin, _Sin>::isThreadSafe) lockIn.lock();
+      if (scheduleRows) samplerIn.scheduleStep(ivCacheBegin / cacheGrain);
+
+      for (uint ivCache = uint(ivCacheBegin); ivCache < uint(ivCacheEnd); ++ivCache)
+      {
+        _Tcompute *px_row = px_data_in.data() + ivCache * nm.x;
+        bool isFlipped;
+        const uint iv = inRow(int(ivCache) + nnmm.z, isFlipped);
+        if (!isFlipped)
+        {
+          for (uint iuCache = 0; iuCache < nm.x; ++iuCache)
+          {
+            const uint iu = (iuCache + uint(nnmm.x) + 2 * m_in_un) % m_in_un; // latitude-repeat
+            px_row[iuCache] = samplerIn.pixelGet(iu, iv);
+          }
+        }
+        else
+        {
+          for (uint iuCache = 0; iuCache < nm.x; ++iuCache)
+          {
+            const uint iu = (3 * m_in_un - iuCache - uint(nnmm.x)) % m_in_un; // latitude-repeat
+            px_row[iuCache] = samplerIn.pixelGet(iu, iv);
+          }
+        }
+      }
+    });
+  }
+
+  /// sample the out-pixels [iu0, iu1[ * [iv0, iv1[ from the cache "nnmm". The out-pixel (iu, iv) is written at (iu - iu0, iv - iv0).
+  template<class _Kernel, typename _Tcompute, typename _Tout, class _Sout>
+  void sample(s_sampler<_Tout, _Sout> &samplerOut, const glm::ivec4 &nnmm, const std::vector<_Tcompute> &px_data_in,
+              const uint iu0, const uint iu1, const uint iv0, const uint iv1) const
+  {
+    const glm::uvec2 nm = glm::uvec2(nnmm.y - nnmm.x, nnmm.w - nnmm.z);
+    const glm::vec4  nnmm_offset = glm::vec4(nnmm.x, nnmm.x, nnmm.z, nnmm.z);
+
+    parallelFor(iv1 - iv0, 4, [&](std::size_t ivBegin, std::size_t ivEnd)
+    {
+      for (uint ivL = uint(ivBegin); ivL < uint(ivEnd); ++ivL)
+      {
+        for (uint iu = iu0; iu < iu1; ++iu)
+        {
+          const glm::vec4 nnmm_inLocal = pixelZone(iu, iv0 + ivL) - nnmm_offset;
+          const _Tcompute in_value = _Kernel::sampleValue(px_data_in.data(), nm.x, nm.y, nnmm_inLocal);
+          samplerOut.pixelSet(iu - iu0, ivL, in_value);
+        }
+      }
+    });
+  }
+};
+
 //-----------------------------------------------------------------------------
 
 template<class _Kernel, typename _Tin, typename _Tout, typename _Tcompute, class _Sin, class _Sout>
@@ -743,107 +1230,143 @@ void resample_toCubeMap_imp(_Sout *outTexture, const uint out_un, const uint out
   s_sampler<_Tin, _Sin> samplerIn(inTextureEquirectangular);
   s_sampler<_Tout, _Sout> samplerOut(outTexture);
 
-  const glm::vec4 inWWHH = glm::vec4(in_un, in_un, in_vn, in_vn);
+  const s_cubeMapProjection proj(out_un, out_vn, in_un, in_vn, in_coord0, in_coordU_incr, in_coordV_incr);
 
-  const glm::vec3 du = in_coordU_incr / float(out_un);
-  const glm::vec3 dv = in_coordV_incr / float(out_vn);
+  // cache the whole sampling-zone
 
-  // get the bounding-box of the sampling zone
+  const glm::ivec4 global_nnmm = proj.bounds(0, out_un, 0, out_vn);
 
-  glm::vec4 global_uuvv = glm::vec4(std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
-                                    std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity());
+  std::vector<_Tcompute> px_data_in;
+  proj.fillCache(samplerIn, global_nnmm, px_data_in, true);
 
-  const glm::vec2 in_coordMap_Center = coord_3D_To_2DMap(in_coord0 + du * float(out_un / 2 + 0.5f) + dv * float(out_vn / 2 + 0.5f)); // to handle the latitude-repeat.
+  // sample into out-pixel data
 
-  for (uint iv = 0; iv < out_vn; ++iv)
-  {
-    for (uint iu = 0; iu < out_un; ++iu)
-    {
-      const glm::vec3 in_coord3D = in_coord0 + du * float(iu + 0.5f) + dv * float(iv + 0.5f);
-      const glm::vec2 in_coordMap = coord_3D_To_2DMap_Repeat(in_coord3D, in_coordMap_Center);
+  proj.template sample<_Kernel>(samplerOut, global_nnmm, px_data_in, 0, out_un, 0, out_vn);
+}
 
-      const glm::vec3 in_P = glm::normalize(in_coord3D);
-      const glm::vec3 in_dPu = glm::normalize(in_coord3D + 0.5f * du) - in_P;
-      const glm::vec3 in_dPv = glm::normalize(in_coord3D + 0.5f * dv) - in_P;
-      const glm::vec3 map_derr = coord_3D_To_2DMap_Deriv(in_coord3D);
+//-----------------------------------------------------------------------------
 
-      const glm::vec2 dudv_onU = glm::abs(glm::vec2(map_derr.x * in_dPu.x + map_derr.y * in_dPu.z, map_derr.z * in_dPu.y));
-      const glm::vec2 dudv_onP = glm::abs(glm::vec2(map_derr.x * in_dPv.x + map_derr.y * in_dPv.z, map_derr.z * in_dPv.y));
+#ifdef TRE_WITH_LIBTIFF
 
-      const glm::vec2 dudv = glm::max(dudv_onU + dudv_onP, glm::vec2(1.e-6f));
+/// Streamed version: the out-face is processed per tiles, ordered by their first in-row. Only the in-pixels of 1 tile are cached.
+template<class _Kernel, typename _Tin, typename _Tcompute, class _Sin, class _Ftile>
+bool resample_toCubeMap_streamed_imp(const uint out_un, const uint out_vn, const std::size_t outPixelByteSize, const _Ftile &fnctTile,
+                                     _Sin *inTextureEquirectangular, const uint in_un, const uint in_vn,
+                                     const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr,
+                                     const std::size_t budgetInBytes)
+{
+  const s_cubeMapProjection proj(out_un, out_vn, in_un, in_vn, in_coord0, in_coordU_incr, in_coordV_incr);
 
-      global_uuvv.x = glm::min(global_uuvv.x, in_coordMap.x - dudv.x);
-      global_uuvv.y = glm::max(global_uuvv.y, in_coordMap.x + dudv.x);
-      global_uuvv.z = glm::min(global_uuvv.z, in_coordMap.y - dudv.y);
-      global_uuvv.w = glm::max(global_uuvv.w, in_coordMap.y + dudv.y);
-    }
-  }
+  // split into tiles (quad-tree from 256 * 256 pixels), such as 1 tile (in-pixel cache + out-pixels) uses at most the half of the budget.
+  // Near the poles, the in-zone of a tile covers the whole latitude, so the tiles are smaller there.
 
-  // cache the whoe sampling-zone (TODO ? split per tiles)
+  struct s_tile
+  {
+    glm::uvec4 m_uuvv; // out-pixels [u0, u1[ * [v0, v1[
+    glm::ivec4 m_nnmm; // cached in-pixels
+  };
 
-  const glm::ivec4 global_nnmm = glm::ivec4(global_uuvv * inWWHH) + glm::ivec4(0, 1, 0, 1); // sampling-zone (in in-pixel unit)
-  TRE_ASSERT(global_nnmm.y > global_nnmm.x && global_nnmm.w > global_nnmm.z);
-  TRE_ASSERT(global_nnmm.x > -int(in_un) && global_nnmm.y < 2 * int(in_un));
-  TRE_ASSERT(global_nnmm.y > -int(in_vn) && global_nnmm.w < 2 * int(in_vn));
-  const glm::uvec2 global_nm = glm::uvec2(global_nnmm.y - global_nnmm.x, global_nnmm.w - global_nnmm.z); // sampling-extend (in in-pixel unit)
+  const uint tileSizeMax = 256;
+  const uint tileSizeMin = 8;
 
-  std::vector<_Tcompute> px_data_in;
-  px_data_in.resize(global_nm.x * global_nm.y);
-  TRE_ASSERT(px_data_in.size() == global_nm.x * global_nm.y);
+  std::vector<s_tile> tiles;
+  std::vector<s_tile> tilesToSplit;
+  for (uint iv0 = 0; iv0 < out_vn; iv0 += tileSizeMax)
+  {
+    for (uint iu0 = 0; iu0 < out_un; iu0 += tileSizeMax)
+      tilesToSplit.push_back({ glm::uvec4(iu0, glm::min(iu0 + tileSizeMax, out_un), iv0, glm::min(iv0 + tileSizeMax, out_vn)), glm::ivec4(0) });
+  }
+
+  std::size_t tileByteSize = 0;
+  std::size_t cacheSizeMax = 0;
 
-  for (uint ivCache = 0; ivCache < global_nm.y; ++ivCache)
+  while (!tilesToSplit.empty())
   {
-    const int ivRaw = int(ivCache) + global_nnmm.z;
-    if (ivRaw >= 0 && ivRaw < int(in_vn))
+    s_tile tile = tilesToSplit.back();
+    tilesToSplit.pop_back();
+
+    const glm::uvec4 &uuvv = tile.m_uuvv;
+    tile.m_nnmm = proj.bounds(uuvv.x, uuvv.y, uuvv.z, uuvv.w);
+    const std::size_t cacheByteSize = std::size_t(tile.m_nnmm.y - tile.m_nnmm.x) * std::size_t(tile.m_nnmm.w - tile.m_nnmm.z) * sizeof(_Tcompute);
+    const std::size_t curByteSize = cacheByteSize + (uuvv.y - uuvv.x) * (uuvv.w - uuvv.z) * outPixelByteSize;
+
+    if (curByteSize <= budgetInBytes / 2)
     {
-      const uint iv = uint(ivRaw);
-      for (uint iuCache = 0; iuCache < global_nm.x; ++iuCache)
-      {
-        const uint iu = (iuCache + uint(global_nnmm.x) + 2 * in_un) % in_un; // latitude-repeat
-        px_data_in[iuCache * global_nm.y + ivCache] = samplerIn.pixelGet(iu, iv);
-      }
+      tiles.push_back(tile);
+      tileByteSize = glm::max(tileByteSize, curByteSize);
+      cacheSizeMax = glm::max(cacheSizeMax, cacheByteSize / sizeof(_Tcompute));
+      continue;
     }
-    else
+
+    if (uuvv.y - uuvv.x <= tileSizeMin && uuvv.w - uuvv.z <= tileSizeMin)
     {
-      const uint iv = (ivRaw < 0) ? uint(-ivRaw) : uint(in_vn * 2 - 1 - ivRaw);
-      for (uint iuCache = 0; iuCache < global_nm.x; ++iuCache)
-      {
-        const uint iu = (3 * in_un - iuCache - uint(global_nnmm.x)) % in_un; // latitude-repeat
-        px_data_in[iuCache * global_nm.y + ivCache] = samplerIn.pixelGet(iu, iv);
-      }
+      TRE_LOG("resample_toCubeMap_streamed: the memory budget (" << budgetInBytes << " bytes) is too small: a tile of " << tileSizeMin << " pixels needs " << curByteSize << " bytes.");
+      return false;
     }
+
+    const uint um = (uuvv.y - uuvv.x > tileSizeMin) ? (uuvv.x + uuvv.y) / 2 : uuvv.y;
+    const uint vm = (uuvv.w - uuvv.z > tileSizeMin) ? (uuvv.z + uuvv.w) / 2 : uuvv.w;
+    tilesToSplit.push_back({ glm::uvec4(uuvv.x, um, uuvv.z, vm), glm::ivec4(0) });
+    if (um != uuvv.y)                 tilesToSplit.push_back({ glm::uvec4(um, uuvv.y, uuvv.z, vm), glm::ivec4(0) });
+    if (vm != uuvv.w)                 tilesToSplit.push_back({ glm::uvec4(uuvv.x, um, vm, uuvv.w), glm::ivec4(0) });
+    if (um != uuvv.y && vm != uuvv.w) tilesToSplit.push_back({ glm::uvec4(um, uuvv.y, vm, uuvv.w), glm::ivec4(0) });
   }
 
-  // sample into out-pixel data
+  // the tiles are processed by their first in-row: the working-set of in-rows slides along the in-texture
 
-  const glm::vec4 nnmm_offset = glm::vec4(global_nnmm.x, global_nnmm.x, global_nnmm.z, global_nnmm.z);
+  std::vector<uint64_t> tilesOrderKey; // (first in-row, tile index)
+  tilesOrderKey.resize(tiles.size());
+  for (uint iTile = 0; iTile < tilesOrderKey.size(); ++iTile) tilesOrderKey[iTile] = (uint64_t(tiles[iTile].m_nnmm.z + int(in_vn)) << 32) | iTile;
+  sortQuick<uint64_t>(tilesOrderKey);
 
-  for (uint iv = 0; iv < out_vn; ++iv)
+  std::vector<uint> tilesOrder;
+  tilesOrder.resize(tilesOrderKey.size());
+  for (uint iOrder = 0; iOrder < tilesOrder.size(); ++iOrder) tilesOrder[iOrder] = uint(tilesOrderKey[iOrder] & 0xFFFFFFFF);
+
+  // the remaining budget is used by the decoding cache of the in-sampler
+
+  textureSampler::s_TIFFCacheSettings settings;
   {
-    for (uint iu = 0; iu < out_un; ++iu)
-    {
-      const glm::vec3 in_coord3D = in_coord0 + du * float(iu + 0.5f) + dv * float(iv + 0.5f);
-      const glm::vec2 in_coordMap = coord_3D_To_2DMap_Repeat(in_coord3D, in_coordMap_Center);
+    std::lock_guard<std::mutex> lockSettings(s_TIFFCache_mutex);
+    settings = s_TIFFCache_settings;
+  }
+  settings.m_budgetInBytes = budgetInBytes - tileByteSize;
+
+  s_sampler<_Tin, _Sin> samplerIn(inTextureEquirectangular, &settings);
+  if (2 * std::size_t(samplerIn.m_driverTiff.m_blockSizeInBytes) > settings.m_budgetInBytes)
+  {
+    TRE_LOG("resample_toCubeMap_streamed: the memory budget (" << budgetInBytes << " bytes) is too small for the decoding of the in-texture.");
+    return false;
+  }
 
-      const glm::vec3 in_P = glm::normalize(in_coord3D);
-      const glm::vec3 in_dPu = glm::normalize(in_coord3D + 0.5f * du) - in_P;
-      const glm::vec3 in_dPv = glm::normalize(in_coord3D + 0.5f * dv) - in_P;
-      const glm::vec3 map_derr = coord_3D_To_2DMap_Deriv(in_coord3D);
+  std::vector<glm::uvec4> tiles_zone_in;
+  tiles_zone_in.resize(tilesOrder.size());
+  for (uint iOrder = 0; iOrder < tilesOrder.size(); ++iOrder)
+  {
+    const glm::ivec4 &nnmm = tiles[tilesOrder[iOrder]].m_nnmm;
+    tiles_zone_in[iOrder] = proj.inZone(nnmm, nnmm.z, nnmm.w);
+  }
+  samplerIn.schedule(tiles_zone_in);
 
-      const glm::vec2 dudv_onU = glm::abs(glm::vec2(map_derr.x * in_dPu.x + map_derr.y * in_dPu.z, map_derr.z * in_dPu.y));
-      const glm::vec2 dudv_onP = glm::abs(glm::vec2(map_derr.x * in_dPv.x + map_derr.y * in_dPv.z, map_derr.z * in_dPv.y));
+  std::vector<_Tcompute> px_data_in;
+  px_data_in.reserve(cacheSizeMax); // no reallocation (the growth of the vector could exceed the budget)
 
-      const glm::vec2 dudv = glm::max(dudv_onU + dudv_onP, glm::vec2(1.e-6f));
+  for (uint iOrder = 0; iOrder < tilesOrder.size(); ++iOrder)
+  {
+    const s_tile &tile = tiles[tilesOrder[iOrder]];
+    const glm::uvec4 &uuvv = tile.m_uuvv;
 
-      const glm::vec4 nnmm_in = glm::vec4(in_coordMap.x - dudv.x, in_coordMap.x + dudv.x, in_coordMap.y - dudv.y, in_coordMap.y + dudv.y) * inWWHH;
-      const glm::vec4 nnmm_inLocal = nnmm_in - nnmm_offset;
-      const _Tcompute in_value = _Kernel::sampleValue(px_data_in.data(), global_nm.x, global_nm.y, nnmm_inLocal);
+    samplerIn.scheduleStep(iOrder);
+    proj.fillCache(samplerIn, tile.m_nnmm, px_data_in, false);
 
-      samplerOut.pixelSet(iu, iv, in_value);
-    }
+    fnctTile(uuvv.x, uuvv.z, uuvv.y - uuvv.x, uuvv.w - uuvv.z, [&](auto &samplerOut) { proj.template sample<_Kernel>(samplerOut, tile.m_nnmm, px_data_in, uuvv.x, uuvv.y, uuvv.z, uuvv.w); });
   }
+
+  return true;
 }
 
+#endif // TRE_WITH_LIBTIFF
+
 //-----------------------------------------------------------------------------
 
 void textureSampler::resample_toCubeMap(SDL_Surface *outTexture, SDL_Surface *inTextureEquirectangular, const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr)
@@ -920,6 +1443,80 @@ void textureSampler::resample_toCubeMap(s_ImageData_R32F *outTexture, TIFF *inTe
 #endif
 }
 
+//-----------------------------------------------------------------------------
+
+bool textureSampler::resample_toCubeMap_streamed(const unsigned outW, const unsigned outH, const t_tileCallbackRGBA &outTile, TIFF *inTextureEquirectangular, const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr, const std::size_t budgetInBytes)
+{
+#ifdef TRE_WITH_LIBTIFF
+  uint in_un, in_vn;
+  TIFFGetField(inTextureEquirectangular, TIFFTAG_IMAGEWIDTH, &in_un);
+  TIFFGetField(inTextureEquirectangular, TIFFTAG_IMAGELENGTH, &in_vn);
+
+  auto fnctTile = [&](uint u0, uint v0, uint w, uint h, const auto &fnctSample)
+  {
+    SDL_Surface *tile = SDL_CreateRGBSurface(0, int(w), int(h), 32, 0, 0, 0, 0);
+    TRE_ASSERT(tile != nullptr);
+    s_sampler<s_RBGA8, SDL_Surface> samplerOut(tile);
+    fnctSample(samplerOut);
+    outTile(u0, v0, tile);
+    SDL_FreeSurface(tile);
+  };
+
+  return resample_toCubeMap_streamed_imp<s_kernel_C0, s_RBGA8, s_RBGfloat>(outW, outH, 4, fnctTile,
+                                                                          inTextureEquirectangular, in_un, in_vn,
+                                                                          in_coord0, in_coordU_incr, in_coordV_incr, budgetInBytes);
+#else
+  (void)outW;
+  (void)outH;
+  (void)outTile;
+  (void)inTextureEquirectangular;
+  (void)in_coord0;
+  (void)in_coordU_incr;
+  (void)in_coordV_incr;
+  (void)budgetInBytes;
+  return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureSampler::resample_toCubeMap_streamed(const unsigned outW, const unsigned outH, const t_tileCallbackR32F &outTile, TIFF *inTextureEquirectangular, const glm::vec3 &in_coord0, const glm::vec3 &in_coordU_incr, const glm::vec3 &in_coordV_incr, const std::size_t budgetInBytes)
+{
+#ifdef TRE_WITH_LIBTIFF
+  uint in_un, in_vn;
+  TIFFGetField(inTextureEquirectangular, TIFFTAG_IMAGEWIDTH, &in_un);
+  TIFFGetField(inTextureEquirectangular, TIFFTAG_IMAGELENGTH, &in_vn);
+
+  std::vector<float> tilePixels;
+
+  auto fnctTile = [&](uint u0, uint v0, uint w, uint h, const auto &fnctSample)
+  {
+    tilePixels.resize(w * h);
+    s_ImageData_R32F tile;
+    tile.w = w;
+    tile.h = h;
+    tile.pixels = tilePixels.data();
+    s_sampler<float, s_ImageData_R32F> samplerOut(&tile);
+    fnctSample(samplerOut);
+    outTile(u0, v0, tile);
+  };
+
+  return resample_toCubeMap_streamed_imp<s_kernel_C0, float, float>(outW, outH, sizeof(float), fnctTile,
+                                                                   inTextureEquirectangular, in_un, in_vn,
+                                                                   in_coord0, in_coordU_incr, in_coordV_incr, budgetInBytes);
+#else
+  (void)outW;
+  (void)outH;
+  (void)outTile;
+  (void)inTextureEquirectangular;
+  (void)in_coord0;
+  (void)in_coordU_incr;
+  (void)in_coordV_incr;
+  (void)budgetInBytes;
+  return false;
+#endif
+}
+
 //=============================================================================
 // Main entry-points: mapNormals_toCubeMap
 
@@ -1039,6 +1636,459 @@ void textureSampler::mapNormals_toCubeMap(SDL_Surface *outTexture, TIFF *inTextu
 #endif
 }
 
+//=============================================================================
+// Image-based lighting: helpers
+
+static const std::array<float, 256> &_getTableSRGBtoLinear()
+{
+  static const std::array<float, 256> table = []()
+  {
+    std::array<float, 256> t;
+    for (uint i = 0; i < 256; ++i)
+    {
+      const float c = float(i) / 255.f;
+      t[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return t;
+  }();
+  return table;
+}
+
+static inline uint8_t _quantize(float c, const bool gammaCorrect)
+{
+  c = glm::clamp(c, 0.f, 1.f);
+  if (gammaCorrect) c = (c <= 0.0031308f) ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+  return uint8_t(c * 255.f + 0.5f);
+}
+
+// ----------------------------------------------------------------------------
+
+/// Direction of the center of the texel (iu, iv) of a cube-face (OpenGL convention, not normalized).
+static inline glm::vec3 _cubeTexelDirection(const uint face, const uint iu, const uint iv, const uint n)
+{
+  const float sc = 2.f * (float(iu) + 0.5f) / float(n) - 1.f;
+  const float tc = 2.f * (float(iv) + 0.5f) / float(n) - 1.f;
+  switch (face)
+  {
+    case 0:  return glm::vec3( 1.f, -tc, -sc);
+    case 1:  return glm::vec3(-1.f, -tc,  sc);
+    case 2:  return glm::vec3( sc,  1.f,  tc);
+    case 3:  return glm::vec3( sc, -1.f, -tc);
+    case 4:  return glm::vec3( sc, -tc,  1.f);
+    default: return glm::vec3(-sc, -tc, -1.f);
+  }
+}
+
+/// Projection of 4 directions (SoA) onto the cube-faces (OpenGL convention). The face-coordinates (u,v) are in [0,1].
+static inline void _cubeProject4(const __m128 x, const __m128 y, const __m128 z, __m128 &face, __m128 &u, __m128 &v)
+{
+  const __m128 signMask = _mm_set1_ps(-0.f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+
+  const __m128 ax = _mm_andnot_ps(signMask, x);
+  const __m128 ay = _mm_andnot_ps(signMask, y);
+  const __m128 az = _mm_andnot_ps(signMask, z);
+  const __m128 isX = _mm_and_ps(_mm_cmpge_ps(ax, ay), _mm_cmpge_ps(ax, az));
+  const __m128 isY = _mm_andnot_ps(isX, _mm_cmpge_ps(ay, az));
+  const __m128 xNeg = _mm_cmplt_ps(x, zero);
+  const __m128 yNeg = _mm_cmplt_ps(y, zero);
+  const __m128 zNeg = _mm_cmplt_ps(z, zero);
+  const __m128 nx = _mm_xor_ps(x, signMask);
+  const __m128 ny = _mm_xor_ps(y, signMask);
+  const __m128 nz = _mm_xor_ps(z, signMask);
+
+  const __m128 scX = _mm_blendv_ps(nz, z, xNeg);
+  const __m128 scZ = _mm_blendv_ps(x, nx, zNeg);
+  const __m128 tcY = _mm_blendv_ps(z, nz, yNeg);
+
+  const __m128 ma = _mm_blendv_ps(_mm_blendv_ps(az, ay, isY), ax, isX);
+  const __m128 sc = _mm_blendv_ps(_mm_blendv_ps(scZ, x, isY), scX, isX);
+  const __m128 tc = _mm_blendv_ps(ny, tcY, isY);
+  const __m128 faceZ = _mm_add_ps(_mm_set1_ps(4.f), _mm_and_ps(zNeg, one));
+  const __m128 faceY = _mm_add_ps(_mm_set1_ps(2.f), _mm_and_ps(yNeg, one));
+  const __m128 faceX = _mm_and_ps(xNeg, one);
+  face = _mm_blendv_ps(_mm_blendv_ps(faceZ, faceY, isY), faceX, isX);
+
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 scale = _mm_div_ps(half, _mm_max_ps(ma, _mm_set1_ps(1.e-20f)));
+  u = _mm_add_ps(_mm_mul_ps(sc, scale), half);
+  v = _mm_add_ps(_mm_mul_ps(tc, scale), half);
+}
+
+// ----------------------------------------------------------------------------
+
+/// Cube-map in linear float colors, with its box-filtered mip-chain.
+struct s_cubePyramid
+{
+  std::vector<uint>                    m_size;   ///< face-size per level
+  std::vector<std::vector<s_RBGfloat>> m_pixels; ///< per level, the 6 faces (tightly packed)
+
+  bool load(const std::array<SDL_Surface*, 6> &faces, const bool gammaCorrect)
+  {
+    for (SDL_Surface *surf : faces)
+    {
+      if (surf == nullptr || surf->w != faces[0]->w || surf->h != faces[0]->w || surf->w == 0)
+      {
+        TRE_LOG("textureSampler: the cube-faces must be square, with the same size");
+        return false;
+      }
+    }
+
+    const uint n = uint(faces[0]->w);
+    const std::array<float, 256> &toLinear = _getTableSRGBtoLinear();
+
+    m_size.clear();
+    m_pixels.clear();
+    m_size.push_back(n);
+    m_pixels.emplace_back(6 * n * n);
+
+    parallelFor(6 * n, 16, [&](std::size_t iRowBegin, std::size_t iRowEnd)
+    {
+      for (std::size_t iRow = iRowBegin; iRow < iRowEnd; ++iRow)
+      {
+        const s_sampler<s_RBGA8, SDL_Surface> sampler(faces[iRow / n]);
+        s_RBGfloat *dst = m_pixels[0].data() + iRow * n;
+        const uint iv = uint(iRow % n);
+        for (uint iu = 0; iu < n; ++iu)
+        {
+          const s_RBGA8 px = sampler.pixelGet(iu, iv);
+          if (gammaCorrect) { dst[iu].r = toLinear[px.r]; dst[iu].g = toLinear[px.g]; dst[iu].b = toLinear[px.b]; }
+          else              { dst[iu] = s_RBGfloat(px); }
+        }
+      }
+    });
+
+    while (m_size.back() > 1)
+    {
+      const uint nIn = m_size.back();
+      const uint nOut = nIn / 2;
+      const std::vector<s_RBGfloat> &pxIn = m_pixels.back();
+      std::vector<s_RBGfloat> pxOut(6 * nOut * nOut);
+      for (uint iRow = 0; iRow < 6 * nOut; ++iRow)
+      {
+        const s_RBGfloat *rowIn0 = pxIn.data() + ((iRow / nOut) * nIn + (iRow % nOut) * 2) * nIn;
+        const s_RBGfloat *rowIn1 = rowIn0 + nIn;
+        s_RBGfloat       *rowOut = pxOut.data() + iRow * nOut;
+        for (uint iu = 0; iu < nOut; ++iu)
+        {
+          const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&rowIn0[2 * iu].r), _mm_loadu_ps(&rowIn0[2 * iu + 1].r)),
+                                        _mm_add_ps(_mm_loadu_ps(&rowIn1[2 * iu].r), _mm_loadu_ps(&rowIn1[2 * iu + 1].r)));
+          _mm_storeu_ps(&rowOut[iu].r, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+        }
+      }
+      m_size.push_back(nOut);
+      m_pixels.push_back(std::move(pxOut));
+    }
+    return true;
+  }
+
+  __m128 fetch(const uint level, const uint face, const float u, const float v) const // bilinear, clamped on the face's borders
+  {
+    const uint  n = m_size[level];
+    const float pu = glm::clamp(u * float(n) - 0.5f, 0.f, float(n - 1));
+    const float pv = glm::clamp(v * float(n) - 0.5f, 0.f, float(n - 1));
+    const uint  iu0 = uint(pu), iv0 = uint(pv);
+    const uint  iu1 = std::min(iu0 + 1, n - 1), iv1 = std::min(iv0 + 1, n - 1);
+    const float fu = pu - float(iu0), fv = pv - float(iv0);
+
+    const s_RBGfloat *facePx = m_pixels[level].data() + face * n * n;
+    const __m128 p00 = _mm_loadu_ps(&facePx[iv0 * n + iu0].r);
+    const __m128 p01 = _mm_loadu_ps(&facePx[iv0 * n + iu1].r);
+    const __m128 p10 = _mm_loadu_ps(&facePx[iv1 * n + iu0].r);
+    const __m128 p11 = _mm_loadu_ps(&facePx[iv1 * n + iu1].r);
+    const __m128 vfu = _mm_set1_ps(fu);
+    const __m128 p0 = _mm_add_ps(p00, _mm_mul_ps(_mm_sub_ps(p01, p00), vfu));
+    const __m128 p1 = _mm_add_ps(p10, _mm_mul_ps(_mm_sub_ps(p11, p10), vfu));
+    return _mm_add_ps(p0, _mm_mul_ps(_mm_sub_ps(p1, p0), _mm_set1_ps(fv)));
+  }
+
+  __m128 sample(const uint face, const float u, const float v, const float lod) const // trilinear
+  {
+    const float lodC = glm::clamp(lod, 0.f, float(m_size.size() - 1));
+    const uint  level0 = uint(lodC);
+    const float f = lodC - float(level0);
+    const __m128 c0 = fetch(level0, face, u, v);
+    if (f < 1.e-3f) return c0;
+    const __m128 c1 = fetch(level0 + 1, face, u, v);
+    return _mm_add_ps(c0, _mm_mul_ps(_mm_sub_ps(c1, c0), _mm_set1_ps(f)));
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+/// GGX importance-samples around the normal (0,0,1), with V = N (SoA, padded to a multiple of 4 with null weights).
+struct s_GGXSamples
+{
+  std::vector<float> m_x, m_y, m_z, m_weight, m_lod;
+
+  void build(const float roughness, const uint sampleCount, const uint sourceSize)
+  {
+    m_x.clear(); m_y.clear(); m_z.clear(); m_weight.clear(); m_lod.clear();
+
+    const float alpha = std::max(roughness * roughness, 1.e-4f);
+    const float alpha2 = alpha * alpha;
+    const float texelSolidAngle = 4.f * float(M_PI) / (6.f * float(sourceSize) * float(sourceSize));
+
+    for (uint i = 0; i < sampleCount; ++i)
+    {
+      // Hammersley point
+      uint bits = i;
+      bits = (bits << 16u) | (bits >> 16u);
+      bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+      bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+      bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+      bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+      const float xi0 = (float(i) + 0.5f) / float(sampleCount);
+      const float xi1 = float(bits) * 2.3283064365386963e-10f;
+
+      // half-vector H, then L = reflect(-N, H)
+      const float cosTheta2 = (1.f - xi0) / (1.f + (alpha2 - 1.f) * xi0);
+      const float cosTheta = std::sqrt(cosTheta2);
+      const float sinTheta = std::sqrt(1.f - cosTheta2);
+      const float phi = 2.f * float(M_PI) * xi1;
+      const float NdotL = 2.f * cosTheta2 - 1.f;
+      if (NdotL <= 0.f) continue;
+
+      // filtered importance sampling: the source is read at the lod that matches the sample's solid-angle
+      const float d = (alpha2 - 1.f) * cosTheta2 + 1.f;
+      const float pdf = alpha2 / (4.f * float(M_PI) * d * d); // D(h) * NdotH / (4 * VdotH), with V = N
+      const float sampleSolidAngle = 1.f / (float(sampleCount) * pdf);
+      const float lod = std::max(0.f, 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.f);
+
+      m_x.push_back(2.f * cosTheta * sinTheta * std::cos(phi));
+      m_y.push_back(2.f * cosTheta * sinTheta * std::sin(phi));
+      m_z.push_back(NdotL);
+      m_weight.push_back(NdotL);
+      m_lod.push_back(lod);
+    }
+
+    while (m_x.size() % 4 != 0)
+    {
+      m_x.push_back(0.f); m_y.push_back(0.f); m_z.push_back(1.f); m_weight.push_back(0.f); m_lod.push_back(0.f);
+    }
+  }
+};
+
+// ----------------------------------------------------------------------------
+
+/// Real spherical-harmonics basis (bands 0, 1, 2) of a normalized direction.
+static inline void _SH9Basis(const glm::vec3 &d, float basis[9])
+{
+  basis[0] = 0.282095f;
+  basis[1] = 0.488603f * d.y;
+  basis[2] = 0.488603f * d.z;
+  basis[3] = 0.488603f * d.x;
+  basis[4] = 1.092548f * d.x * d.y;
+  basis[5] = 1.092548f * d.y * d.z;
+  basis[6] = 0.315392f * (3.f * d.z * d.z - 1.f);
+  basis[7] = 1.092548f * d.x * d.z;
+  basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+//=============================================================================
+// Main entry-points: image-based lighting
+
+bool textureSampler::prefilterIBL_specular(std::vector<std::array<SDL_Surface*, 6> > &outMipChain, const std::array<SDL_Surface*, 6> &inCubeFaces, const s_IBLSettings &settings)
+{
+  outMipChain.clear();
+
+  s_cubePyramid source;
+  if (!source.load(inCubeFaces, settings.m_gammaCorrect)) return false;
+
+  const uint levelCount = uint(source.m_size.size());
+  const uint sampleCount = std::max(settings.m_sampleCount, 4u);
+
+  outMipChain.resize(levelCount);
+  for (uint level = 0; level < levelCount; ++level)
+  {
+    const uint n = source.m_size[level];
+    for (SDL_Surface *&surf : outMipChain[level]) surf = SDL_CreateRGBSurface(0, int(n), int(n), 32, 0, 0, 0, 0);
+  }
+
+  s_GGXSamples samples;
+
+  for (uint level = 0; level < levelCount; ++level)
+  {
+    const uint  n = source.m_size[level];
+    const float roughness = (levelCount > 1) ? float(level) / float(levelCount - 1) : 0.f;
+
+    if (level != 0) samples.build(roughness, sampleCount, source.m_size[0]);
+
+    parallelFor(6 * n, std::max(1u, 64u / n), [&](std::size_t iRowBegin, std::size_t iRowEnd)
+    {
+      for (std::size_t iRow = iRowBegin; iRow < iRowEnd; ++iRow)
+      {
+        const uint face = uint(iRow / n);
+        const uint iv = uint(iRow % n);
+        s_sampler<s_RBGA8, SDL_Surface> samplerOut(outMipChain[level][face]);
+
+        for (uint iu = 0; iu < n; ++iu)
+        {
+          __m128 color;
+
+          if (level == 0)
+          {
+            color = _mm_loadu_ps(&source.m_pixels[0][(face * n + iv) * n + iu].r); // roughness = 0
+          }
+          else
+          {
+            const glm::vec3 N = glm::normalize(_cubeTexelDirection(face, iu, iv, n));
+            const glm::vec3 up = (std::abs(N.z) < 0.999f) ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(1.f, 0.f, 0.f);
+            const glm::vec3 T = glm::normalize(glm::cross(up, N));
+            const glm::vec3 B = glm::cross(N, T);
+
+            __m128 acc = _mm_setzero_ps();
+            __m128 accWeight = _mm_setzero_ps();
+            alignas(16) float sFace[4], sU[4], sV[4], sW[4];
+
+            for (std::size_t iS = 0; iS < samples.m_x.size(); iS += 4)
+            {
+              const __m128 lx = _mm_loadu_ps(samples.m_x.data() + iS);
+              const __m128 ly = _mm_loadu_ps(samples.m_y.data() + iS);
+              const __m128 lz = _mm_loadu_ps(samples.m_z.data() + iS);
+              const __m128 wx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(T.x)), _mm_mul_ps(ly, _mm_set1_ps(B.x))), _mm_mul_ps(lz, _mm_set1_ps(N.x)));
+              const __m128 wy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(T.y)), _mm_mul_ps(ly, _mm_set1_ps(B.y))), _mm_mul_ps(lz, _mm_set1_ps(N.y)));
+              const __m128 wz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_set1_ps(T.z)), _mm_mul_ps(ly, _mm_set1_ps(B.z))), _mm_mul_ps(lz, _mm_set1_ps(N.z)));
+              __m128 vFace, vU, vV;
+              _cubeProject4(wx, wy, wz, vFace, vU, vV);
+              _mm_store_ps(sFace, vFace);
+              _mm_store_ps(sU, vU);
+              _mm_store_ps(sV, vV);
+              const __m128 vW = _mm_loadu_ps(samples.m_weight.data() + iS);
+              _mm_store_ps(sW, vW);
+              accWeight = _mm_add_ps(accWeight, vW);
+              for (uint k = 0; k < 4; ++k)
+              {
+                if (sW[k] == 0.f) continue;
+                const __m128 c = source.sample(uint(sFace[k]), sU[k], sV[k], samples.m_lod[iS + k]);
+                acc = _mm_add_ps(acc, _mm_mul_ps(c, _mm_set1_ps(sW[k])));
+              }
+            }
+
+            color = _mm_div_ps(acc, _mm_set1_ps(std::max(_horizontalSum(accWeight), 1.e-20f)));
+          }
+
+          alignas(16) float rgb[4];
+          _mm_store_ps(rgb, color);
+          s_RBGA8 px;
+          px.r = _quantize(rgb[0], settings.m_gammaCorrect);
+          px.g = _quantize(rgb[1], settings.m_gammaCorrect);
+          px.b = _quantize(rgb[2], settings.m_gammaCorrect);
+          samplerOut.pixelSet(iu, iv, px);
+        }
+      }
+    });
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureSampler::computeIBL_irradianceSH9(glm::vec3 outSH[9], const std::array<SDL_Surface*, 6> &inCubeFaces, const bool gammaCorrect)
+{
+  for (uint i = 0; i < 9; ++i) outSH[i] = glm::vec3(0.f);
+
+  s_cubePyramid source;
+  if (!source.load(inCubeFaces, gammaCorrect)) return false;
+
+  // the irradiance is low-frequency: integrate on a level of at most 64x64 per face (the box-filtered levels preserve the integral)
+  uint level = 0;
+  while (source.m_size[level] > 64) ++level;
+  const uint  n = source.m_size[level];
+  const float texelArea = 4.f / (float(n) * float(n)); // on the face [-1,1]^2
+
+  std::vector<s_RBGfloat> rowSums(6 * n * 9);
+
+  parallelFor(6 * n, 8, [&](std::size_t iRowBegin, std::size_t iRowEnd)
+  {
+    for (std::size_t iRow = iRowBegin; iRow < iRowEnd; ++iRow)
+    {
+      const uint face = uint(iRow / n);
+      const uint iv = uint(iRow % n);
+      __m128 acc[9];
+      for (__m128 &a : acc) a = _mm_setzero_ps();
+      for (uint iu = 0; iu < n; ++iu)
+      {
+        const glm::vec3 d = _cubeTexelDirection(face, iu, iv, n);
+        const float     len2 = glm::dot(d, d);
+        const float     solidAngle = texelArea / (len2 * std::sqrt(len2));
+        float basis[9];
+        _SH9Basis(d / std::sqrt(len2), basis);
+        const __m128 c = _mm_mul_ps(_mm_loadu_ps(&source.m_pixels[level][(face * n + iv) * n + iu].r), _mm_set1_ps(solidAngle));
+        for (uint i = 0; i < 9; ++i) acc[i] = _mm_add_ps(acc[i], _mm_mul_ps(c, _mm_set1_ps(basis[i])));
+      }
+      for (uint i = 0; i < 9; ++i) _mm_storeu_ps(&rowSums[iRow * 9 + i].r, acc[i]);
+    }
+  });
+
+  // radiance -> irradiance (cosine-lobe convolution), divided by PI
+  static const float bandFactor[9] = { 1.f, 2.f / 3.f, 2.f / 3.f, 2.f / 3.f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+
+  for (uint i = 0; i < 9; ++i)
+  {
+    s_RBGfloat sum;
+    for (uint iRow = 0; iRow < 6 * n; ++iRow) sum += rowSums[iRow * 9 + i];
+    outSH[i] = glm::vec3(sum.r, sum.g, sum.b) * bandFactor[i];
+  }
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureSampler::mapIBL_irradiance(const std::array<SDL_Surface*, 6> &outCubeFaces, const glm::vec3 inSH[9], const bool gammaCorrect)
+{
+  for (uint face = 0; face < 6; ++face)
+  {
+    SDL_Surface *surf = outCubeFaces[face];
+    TRE_ASSERT(surf != nullptr && surf->w == surf->h);
+    const uint n = uint(surf->w);
+    s_sampler<s_RBGA8, SDL_Surface> samplerOut(surf);
+
+    for (uint iv = 0; iv < n; ++iv)
+    {
+      for (uint iu = 0; iu < n; ++iu)
+      {
+        float basis[9];
+        _SH9Basis(glm::normalize(_cubeTexelDirection(face, iu, iv, n)), basis);
+        glm::vec3 irradiance(0.f);
+        for (uint i = 0; i < 9; ++i) irradiance += inSH[i] * basis[i];
+        s_RBGA8 px;
+        px.r = _quantize(irradiance.r, gammaCorrect);
+        px.g = _quantize(irradiance.g, gammaCorrect);
+        px.b = _quantize(irradiance.b, gammaCorrect);
+        samplerOut.pixelSet(iu, iv, px);
+      }
+    }
+  }
+}
+
+//=============================================================================
+// Main entry-points: TIFF cache
+
+void textureSampler::setTIFFCacheSettings(const s_TIFFCacheSettings &settings)
+{
+  std::lock_guard<std::mutex> lock(s_TIFFCache_mutex);
+  s_TIFFCache_settings = settings;
+}
+
+//-----------------------------------------------------------------------------
+
+textureSampler::s_TIFFCacheStats textureSampler::getTIFFCacheStats()
+{
+  std::lock_guard<std::mutex> lock(s_TIFFCache_mutex);
+  return s_TIFFCache_stats;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureSampler::resetTIFFCacheStats()
+{
+  std::lock_guard<std::mutex> lock(s_TIFFCache_mutex);
+  s_TIFFCache_stats = s_TIFFCacheStats();
+}
 
 //=============================================================================
 
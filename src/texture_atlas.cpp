@@ -0,0 +1,386 @@
+#include "tre_texture.h"
+
+#include <algorithm>
+#include <climits>
+#include <numeric>
+
+namespace tre {
+
+//-----------------------------------------------------------------------------
+
+static bool _contains(const int ax, const int ay, const int aw, const int ah, const int bx, const int by, const int bw, const int bh) // A contains B
+{
+  return bx >= ax && by >= ay && bx + bw <= ax + aw && by + bh <= ay + ah;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureAtlas::reset(int w, int h, const s_settings &settings)
+{
+  TRE_ASSERT(settings.m_alignment != 0 && (settings.m_alignment & (settings.m_alignment - 1)) == 0);
+
+  m_settings = settings;
+  m_packing = settings.m_packing;
+  m_w = w;
+  m_h = h;
+  m_wCell = w / int(settings.m_alignment);
+  m_hCell = h / int(settings.m_alignment);
+  m_usedHeightCell = 0;
+  m_usedArea = 0;
+
+  m_skyline.clear();
+  m_skyline.push_back({ 0, 0, m_wCell });
+
+  m_freeRects.clear();
+  m_freeRects.push_back({ 0, 0, m_wCell, m_hCell });
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureAtlas::resetFit(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects, const s_settings &settings, int maxSize)
+{
+  const int alignment = int(settings.m_alignment);
+
+  m_settings = settings;
+
+  std::size_t areaCells = 0;
+  for (const glm::ivec2 &size : sizes)
+  {
+    const glm::ivec2 sizeCell = _cellSize(size);
+    areaCells += std::size_t(sizeCell.x) * std::size_t(sizeCell.y);
+  }
+
+  int side = alignment;
+  while (std::size_t(side / alignment) * std::size_t(side / alignment) < areaCells) side *= 2;
+
+  int w = side, h = side;
+  while (w <= maxSize && h <= maxSize)
+  {
+    reset(w, h, settings);
+    if (insert(sizes, outRects) == sizes.size()) return true;
+    if (w == h) w *= 2;
+    else        h *= 2;
+  }
+
+  TRE_LOG("textureAtlas::resetFit: the rectangles do not fit in " << maxSize << " x " << maxSize);
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureAtlas::insert(const glm::ivec2 &size, glm::ivec4 &outRect)
+{
+  if (m_packing == PACK_AUTO) m_packing = PACK_MAXRECTS; // the max-rects keeps the holes available for the next insertions
+
+  const glm::ivec2 sizeCell = _cellSize(size);
+  s_rect           cellRect;
+  const bool       success = (m_packing == PACK_SKYLINE) ? _skylineInsert(sizeCell.x, sizeCell.y, cellRect) : _maxRectsInsert(sizeCell.x, sizeCell.y, cellRect);
+
+  if (!success)
+  {
+    outRect = glm::ivec4(-1, -1, size.x, size.y);
+    return false;
+  }
+
+  _toPixels(cellRect, size, outRect);
+  m_usedArea += std::size_t(size.x) * std::size_t(size.y);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t textureAtlas::insert(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects)
+{
+  if (m_packing != PACK_AUTO) return _insertBatch(sizes, outRects);
+
+  // heuristic choice: pack with both, keep the one that packs more rectangles, then with the lowest used height.
+
+  textureAtlas              atlasSkyline = *this;
+  std::vector<glm::ivec4>   rectsSkyline;
+  atlasSkyline.m_packing = PACK_SKYLINE;
+  const std::size_t countSkyline = atlasSkyline._insertBatch(sizes, rectsSkyline);
+
+  m_packing = PACK_MAXRECTS;
+  const std::size_t countMaxRects = _insertBatch(sizes, outRects);
+
+  if (countSkyline > countMaxRects || (countSkyline == countMaxRects && atlasSkyline.m_usedHeightCell < m_usedHeightCell))
+  {
+    *this = std::move(atlasSkyline);
+    outRects.swap(rectsSkyline);
+    return countSkyline;
+  }
+  return countMaxRects;
+}
+
+//-----------------------------------------------------------------------------
+
+std::size_t textureAtlas::_insertBatch(const span<glm::ivec2> &sizes, std::vector<glm::ivec4> &outRects)
+{
+  TRE_ASSERT(m_packing != PACK_AUTO);
+
+  outRects.resize(sizes.size());
+
+  // sort: by height for the skyline (the rows stay flat), by the longest side for the max-rects.
+
+  std::vector<glm::ivec2>  sizesCell(sizes.size());
+  std::vector<std::size_t> order(sizes.size());
+  for (std::size_t i = 0; i < sizes.size(); ++i) sizesCell[i] = _cellSize(sizes[i]);
+  std::iota(order.begin(), order.end(), 0);
+
+  if (m_packing == PACK_SKYLINE)
+  {
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+      const glm::ivec2 &sa = sizesCell[a], &sb = sizesCell[b];
+      return (sa.y != sb.y) ? (sa.y > sb.y) : (sa.x != sb.x) ? (sa.x > sb.x) : (a < b);
+    });
+  }
+  else
+  {
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+      const glm::ivec2 &sa = sizesCell[a], &sb = sizesCell[b];
+      const int         maxA = std::max(sa.x, sa.y), maxB = std::max(sb.x, sb.y);
+      const int         minA = std::min(sa.x, sa.y), minB = std::min(sb.x, sb.y);
+      return (maxA != maxB) ? (maxA > maxB) : (minA != minB) ? (minA > minB) : (a < b);
+    });
+  }
+
+  std::size_t count = 0;
+  for (const std::size_t i : order)
+  {
+    s_rect     cellRect;
+    const bool success = (m_packing == PACK_SKYLINE) ? _skylineInsert(sizesCell[i].x, sizesCell[i].y, cellRect) : _maxRectsInsert(sizesCell[i].x, sizesCell[i].y, cellRect);
+    if (success)
+    {
+      _toPixels(cellRect, sizes[i], outRects[i]);
+      m_usedArea += std::size_t(sizes[i].x) * std::size_t(sizes[i].y);
+      ++count;
+    }
+    else
+    {
+      outRects[i] = glm::ivec4(-1, -1, sizes[i].x, sizes[i].y);
+    }
+  }
+  return count;
+}
+
+//-----------------------------------------------------------------------------
+
+int textureAtlas::usedHeight() const
+{
+  return std::min(m_usedHeightCell * int(m_settings.m_alignment), m_h);
+}
+
+//-----------------------------------------------------------------------------
+
+glm::vec4 textureAtlas::uvRect(const glm::ivec4 &rect) const
+{
+  const glm::vec2 invDim = 1.f / glm::vec2(m_w, m_h);
+  return glm::vec4(float(rect.x) * invDim.x, float(rect.y + rect.w) * invDim.y, float(rect.x + rect.z) * invDim.x, float(rect.y) * invDim.y);
+}
+
+//-----------------------------------------------------------------------------
+
+void textureAtlas::uvRemap(const span<glm::ivec4> &rects, std::vector<glm::vec4> &outUVs) const
+{
+  outUVs.resize(rects.size());
+  for (std::size_t i = 0; i < rects.size(); ++i) outUVs[i] = uvRect(rects[i]);
+}
+
+//-----------------------------------------------------------------------------
+
+int textureAtlas::gridIndex(const glm::ivec4 &rect, const glm::ivec2 &cellSize) const
+{
+  if (cellSize.x <= 0 || cellSize.y <= 0 || (m_w % cellSize.x) != 0) return -1;
+  if (rect.z != cellSize.x || rect.w != cellSize.y) return -1;
+  if (rect.x < 0 || rect.y < 0 || (rect.x % cellSize.x) != 0 || (rect.y % cellSize.y) != 0) return -1;
+  const int columns = m_w / cellSize.x;
+  return (rect.y / cellSize.y) * columns + (rect.x / cellSize.x);
+}
+
+//-----------------------------------------------------------------------------
+
+glm::ivec2 textureAtlas::_cellSize(const glm::ivec2 &size) const
+{
+  const int padding = int(m_settings.m_padding);
+  const int alignment = int(m_settings.m_alignment);
+  return glm::max((size + 2 * padding + (alignment - 1)) / alignment, glm::ivec2(1));
+}
+
+//-----------------------------------------------------------------------------
+
+void textureAtlas::_toPixels(const s_rect &cellRect, const glm::ivec2 &size, glm::ivec4 &outRect) const
+{
+  const int padding = int(m_settings.m_padding);
+  const int alignment = int(m_settings.m_alignment);
+  outRect = glm::ivec4(cellRect.m_x * alignment + padding, cellRect.m_y * alignment + padding, size.x, size.y);
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureAtlas::_skylineFit(const std::size_t inode, const int w, const int h, int &y) const
+{
+  const int x = m_skyline[inode].m_x;
+  if (x + w > m_wCell) return false;
+
+  // the rectangle lies on the highest node under it
+  int widthLeft = w;
+  y = 0;
+  for (std::size_t i = inode; widthLeft > 0; ++i)
+  {
+    TRE_ASSERT(i < m_skyline.size());
+    y = std::max(y, m_skyline[i].m_y);
+    if (y + h > m_hCell) return false;
+    widthLeft -= m_skyline[i].m_w;
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureAtlas::_skylineInsert(const int w, const int h, s_rect &outRect)
+{
+  // bottom-left: the lowest top, then the narrowest node
+
+  std::size_t bestNode = m_skyline.size();
+  int         bestTop = INT_MAX, bestWidth = INT_MAX, bestY = 0;
+  for (std::size_t i = 0; i < m_skyline.size(); ++i)
+  {
+    int y;
+    if (!_skylineFit(i, w, h, y)) continue;
+    if (y + h < bestTop || (y + h == bestTop && m_skyline[i].m_w < bestWidth))
+    {
+      bestNode = i;
+      bestTop = y + h;
+      bestWidth = m_skyline[i].m_w;
+      bestY = y;
+    }
+  }
+  if (bestNode == m_skyline.size()) return false;
+
+  outRect = { m_skyline[bestNode].m_x, bestY, w, h };
+
+  // update the skyline: insert the new node, shrink or remove the nodes under it, then merge the nodes at the same level
+
+  m_skyline.insert(m_skyline.begin() + std::ptrdiff_t(bestNode), { outRect.m_x, bestTop, w });
+
+  for (std::size_t i = bestNode + 1; i < m_skyline.size(); )
+  {
+    const s_skylineNode &prev = m_skyline[i - 1];
+    s_skylineNode       &node = m_skyline[i];
+    const int            shrink = prev.m_x + prev.m_w - node.m_x;
+    if (shrink <= 0) break;
+    node.m_x += shrink;
+    node.m_w -= shrink;
+    if (node.m_w > 0) break;
+    m_skyline.erase(m_skyline.begin() + std::ptrdiff_t(i));
+  }
+
+  for (std::size_t i = (bestNode > 0) ? bestNode - 1 : 0; i + 1 < m_skyline.size() && i <= bestNode + 1; )
+  {
+    if (m_skyline[i].m_y == m_skyline[i + 1].m_y)
+    {
+      m_skyline[i].m_w += m_skyline[i + 1].m_w;
+      m_skyline.erase(m_skyline.begin() + std::ptrdiff_t(i + 1));
+    }
+    else
+    {
+      ++i;
+    }
+  }
+
+  m_usedHeightCell = std::max(m_usedHeightCell, bestTop);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureAtlas::_maxRectsInsert(const int w, const int h, s_rect &outRect)
+{
+  // best-short-side-fit: the free rectangle with the smallest leftover on its short side, then on its long side
+
+  int  bestShort = INT_MAX, bestLong = INT_MAX;
+  bool found = false;
+  for (const s_rect &f : m_freeRects)
+  {
+    if (f.m_w < w || f.m_h < h) continue;
+    const int leftoverX = f.m_w - w, leftoverY = f.m_h - h;
+    const int leftoverShort = std::min(leftoverX, leftoverY), leftoverLong = std::max(leftoverX, leftoverY);
+    if (leftoverShort < bestShort || (leftoverShort == bestShort && leftoverLong < bestLong))
+    {
+      outRect = { f.m_x, f.m_y, w, h };
+      bestShort = leftoverShort;
+      bestLong = leftoverLong;
+      found = true;
+    }
+  }
+  if (!found) return false;
+
+  _maxRectsSplit(outRect);
+
+  m_usedHeightCell = std::max(m_usedHeightCell, outRect.m_y + h);
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureAtlas::_maxRectsSplit(const s_rect &used)
+{
+  // split the free rectangles that intersect the used one (up to 4 maximal sub-rectangles each)
+
+  m_freeRectsNew.clear();
+  for (std::size_t i = 0; i < m_freeRects.size(); )
+  {
+    const s_rect f = m_freeRects[i];
+    if (used.m_x >= f.m_x + f.m_w || used.m_x + used.m_w <= f.m_x || used.m_y >= f.m_y + f.m_h || used.m_y + used.m_h <= f.m_y)
+    {
+      ++i;
+      continue;
+    }
+    if (used.m_x > f.m_x)                       m_freeRectsNew.push_back({ f.m_x, f.m_y, used.m_x - f.m_x, f.m_h });
+    if (used.m_x + used.m_w < f.m_x + f.m_w)    m_freeRectsNew.push_back({ used.m_x + used.m_w, f.m_y, f.m_x + f.m_w - used.m_x - used.m_w, f.m_h });
+    if (used.m_y > f.m_y)                       m_freeRectsNew.push_back({ f.m_x, f.m_y, f.m_w, used.m_y - f.m_y });
+    if (used.m_y + used.m_h < f.m_y + f.m_h)    m_freeRectsNew.push_back({ f.m_x, used.m_y + used.m_h, f.m_w, f.m_y + f.m_h - used.m_y - used.m_h });
+    m_freeRects[i] = m_freeRects.back();
+    m_freeRects.pop_back();
+  }
+
+  // prune the new rectangles contained in another one.
+  // The kept free rectangles cannot be contained in a new one (it would have been contained in the split rectangle), so only the new ones are checked.
+
+  for (std::size_t i = 0; i < m_freeRectsNew.size(); ++i)
+  {
+    for (std::size_t j = i + 1; j < m_freeRectsNew.size(); ++j)
+    {
+      const s_rect &a = m_freeRectsNew[i], &b = m_freeRectsNew[j];
+      if (_contains(b.m_x, b.m_y, b.m_w, b.m_h, a.m_x, a.m_y, a.m_w, a.m_h))
+      {
+        m_freeRectsNew.erase(m_freeRectsNew.begin() + std::ptrdiff_t(i));
+        --i;
+        break;
+      }
+      if (_contains(a.m_x, a.m_y, a.m_w, a.m_h, b.m_x, b.m_y, b.m_w, b.m_h))
+      {
+        m_freeRectsNew.erase(m_freeRectsNew.begin() + std::ptrdiff_t(j));
+        --j;
+      }
+    }
+  }
+
+  const std::size_t keptCount = m_freeRects.size();
+  for (const s_rect &n : m_freeRectsNew)
+  {
+    bool isContained = false;
+    for (std::size_t k = 0; k < keptCount && !isContained; ++k)
+    {
+      const s_rect &f = m_freeRects[k];
+      isContained = _contains(f.m_x, f.m_y, f.m_w, f.m_h, n.m_x, n.m_y, n.m_w, n.m_h);
+    }
+    if (!isContained) m_freeRects.push_back(n);
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace
@@ -1,5 +1,7 @@
 #include "tre_texture.h"
 
+#include <smmintrin.h> // SSE4.1
+
 namespace tre {
 
 static_assert(SDL_BYTEORDER == SDL_LIL_ENDIAN  , "Only implemented with little-endian system.");
@@ -8,16 +10,71 @@ typedef unsigned uint;
 
 // ============================================================================
 
-static inline float _errorRGB8(const glm::ivec3 &d_rgb) // perceptual error [0,1]
+static inline __m128 _errorRGB8(const __m128i d_r, const __m128i d_g, const __m128i d_b) // perceptual error [0,1] (4 lanes)
+{
+  const __m128 v65025 = _mm_set1_ps(65025.f);
+  const __m128 errR = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_mullo_epi32(d_r, d_r)), _mm_set1_ps(0.299f)), v65025);
+  const __m128 errG = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_mullo_epi32(d_g, d_g)), _mm_set1_ps(0.587f)), v65025);
+  const __m128 errB = _mm_div_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_mullo_epi32(d_b, d_b)), _mm_set1_ps(0.114f)), v65025);
+  return _mm_add_ps(_mm_add_ps(errR, errG), errB);
+}
+
+static inline __m128 _errorA8(const __m128i d_alpha) // (4 lanes)
 {
-  return (d_rgb.r * d_rgb.r * 0.299f / 65025.f) + (d_rgb.g * d_rgb.g * 0.587f / 65025.f) + (d_rgb.b * d_rgb.b * 0.114f / 65025.f);
+  return _mm_div_ps(_mm_cvtepi32_ps(_mm_mullo_epi32(d_alpha, d_alpha)), _mm_set1_ps(65025.f));
+}
+
+/// Squared error of 16 values (2 x 8 lanes of 16 bits), when each value is quantized to the closest value of the 8-values palette.
+static inline int _errorPalette8(const __m128i values[2], const int16_t palette[8])
+{
+  __m128i diffMin0 = _mm_set1_epi16(0x7FFF);
+  __m128i diffMin1 = _mm_set1_epi16(0x7FFF);
+  for (uint k = 0; k < 8; ++k)
+  {
+    const __m128i pk = _mm_set1_epi16(palette[k]);
+    diffMin0 = _mm_min_epi16(diffMin0, _mm_abs_epi16(_mm_sub_epi16(values[0], pk)));
+    diffMin1 = _mm_min_epi16(diffMin1, _mm_abs_epi16(_mm_sub_epi16(values[1], pk)));
+  }
+  __m128i err = _mm_add_epi32(_mm_madd_epi16(diffMin0, diffMin0), _mm_madd_epi16(diffMin1, diffMin1));
+  err = _mm_add_epi32(err, _mm_shuffle_epi32(err, _MM_SHUFFLE(1, 0, 3, 2)));
+  err = _mm_add_epi32(err, _mm_shuffle_epi32(err, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(err);
 }
 
-static inline float _errorA8(const int d_alpha)
+/// Index of the closest value in the 8-values palette (the lowest index on equality).
+static inline uint _indexPalette8(const int16_t value, const int16_t palette[8])
 {
-  return d_alpha * d_alpha / 65025.f;
+  const __m128i diff = _mm_abs_epi16(_mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(palette)), _mm_set1_epi16(value)));
+  return uint(_mm_extract_epi16(_mm_minpos_epu16(diff), 1));
 }
 
+/// Report of the single-channel encoders. The errors are relative to the channel's range.
+struct s_compressionReportChannel
+{
+  uint  m_blockCount = 0;
+  float m_errorL2 = 0.f;
+  float m_errorInf = 0.f;
+
+  void merge(const s_compressionReportChannel &other)
+  {
+    m_blockCount += other.m_blockCount;
+    m_errorL2 += other.m_errorL2;
+    m_errorInf = glm::max(m_errorInf, other.m_errorInf);
+  }
+
+  void print(const char *formatName) const
+  {
+#ifdef TRE_PRINTS
+    const float errL2 = sqrtf(m_errorL2 / m_blockCount);
+    TRE_LOG("report of conversion to " << formatName << ": " <<
+            "blocks = " << m_blockCount << ", " <<
+            "maxError = " << m_errorInf << ", L2error = " << errL2);
+#else
+    (void)formatName;
+#endif
+  }
+};
+
 // ============================================================================
 /**
  * Ericsson Texture Compression (ETC) is a compression scheme
@@ -33,6 +90,14 @@ struct s_compressionReport
   float m_errorL2 = 0.f;
   float m_errorInf = 0.f;
 
+  void merge(const s_compressionReport &other)
+  {
+    m_modeINDIVcount += other.m_modeINDIVcount;
+    m_modeDIFFcount += other.m_modeDIFFcount;
+    m_errorL2 += other.m_errorL2;
+    m_errorInf = glm::max(m_errorInf, other.m_errorInf);
+  }
+
   void print() const
   {
 #ifdef TRE_PRINTS
@@ -77,28 +142,47 @@ static void _encodeColorZone_ETC(glm::ivec3 &colorZone0, glm::ivec3 &colorZone1,
   }
 }
 
-static glm::ivec3 _encodeTable_ETC(const uint pxid, const uint tid, const int t3, const glm::ivec3 &colorBase, uint &bufferEncoded_LOW)
+static const int _tableETC1_valSmall[8] = { 2,  5,  9, 13, 18, 24,  33,  47 };
+static const int _tableETC1_valLarge[8] = { 8, 17, 29, 42, 60, 80, 106, 183 };
+static const int _tableETC1_sep3[8] = { 5*3, 11*3, 19*3, 27*3, 39*3, 52*3, 69*3, 105*3 };
+
+static uint _encodeModifier_ETC(const uint pxid, const uint tid, const int t3)
 {
-  static const int _tableETC1_val[8][2] = { {2, 8},  {5, 17},  {9, 29}, {13, 42}, {18, 60}, {24, 80},  {33, 106},  {47, 183} };
-  static const int _tableETC1_sep3[8] = { 5*3, 11*3, 19*3, 27*3, 39*3, 52*3, 69*3, 105*3 };
-  // encode
   TRE_ASSERT(tid < 8);
   const uint pixModSign = t3 < 0 ? 1 : 0;
-  const uint pixModLarge = fabs(t3) > _tableETC1_sep3[tid] ? 1 : 0;
+  const uint pixModLarge = abs(t3) > _tableETC1_sep3[tid] ? 1 : 0;
   TRE_ASSERT(pxid < 16);
   const uint n = pxid ^ 0x08;
-  bufferEncoded_LOW |= (pixModSign << (0+n)) | (pixModLarge << (16+n)); // warning: little-endian on 4-bytes word
+  return (pixModSign << (0+n)) | (pixModLarge << (16+n)); // warning: little-endian on 4-bytes word
+}
+
+/// Error of a pixel, decoded with the 4 consecutive tables [tidFirst, tidFirst + 3] (one per lane).
+static inline __m128 _errorTables4_ETC(const uint tidFirst, const int t3, const glm::ivec3 &colorBase, const glm::ivec3 &rgb)
+{
+  TRE_ASSERT(tidFirst + 4 <= 8);
+  // encode
+  const __m128i valSmall = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_tableETC1_valSmall[tidFirst]));
+  const __m128i valLarge = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_tableETC1_valLarge[tidFirst]));
+  const __m128i sep3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&_tableETC1_sep3[tidFirst]));
+  const __m128i pixModLarge = _mm_cmpgt_epi32(_mm_set1_epi32(abs(t3)), sep3);
+  const __m128i pxModifierAbs = _mm_blendv_epi8(valSmall, valLarge, pixModLarge);
+  const __m128i pxModifier = (t3 < 0) ? _mm_sub_epi32(_mm_setzero_si128(), pxModifierAbs) : pxModifierAbs;
   // decode
-  const int pxModifier = (1 - 2 * int(pixModSign)) * _tableETC1_val[tid][pixModLarge];
-  return glm::clamp(colorBase + pxModifier, 0, 255);
+  const __m128i v0 = _mm_setzero_si128();
+  const __m128i v255 = _mm_set1_epi32(255);
+  const __m128i dR = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_set1_epi32(colorBase.r), pxModifier), v0), v255), _mm_set1_epi32(rgb.r));
+  const __m128i dG = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_set1_epi32(colorBase.g), pxModifier), v0), v255), _mm_set1_epi32(rgb.g));
+  const __m128i dB = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(_mm_set1_epi32(colorBase.b), pxModifier), v0), v255), _mm_set1_epi32(rgb.b));
+  return _errorRGB8(dR, dG, dB);
 }
 
+static const int _tableAEC_val[16][4] = { {2, 5, 8, 14}, {2, 6, 9, 12}, {1, 4, 7, 12}, {1, 3, 5, 12},
+                                          {2, 5, 7, 11}, {2, 6, 8, 10}, {3, 6, 7, 10}, {2, 4, 7, 10},
+                                          {1, 5, 7,  9}, {1, 4, 7,  9}, {1, 3, 7,  9}, {1, 4, 6,  9},
+                                          {2, 3, 6,  9}, {0, 1, 2,  9}, {3, 5, 7,  8}, {2, 4, 6,  8} };
+
 static int _encodeTable_EAC(const uint pxid, const uint tid, const int alpha, const int alphaBase, const int multiplier, uint64_t &bufferEncoded_BigEndian)
 {
-  static const int _tableAEC_val[16][4] = { {2, 5, 9, 14}, {2, 6, 9, 12}, {1, 4, 7, 12}, {1, 3, 5, 12},
-                                            {2, 5, 7, 11}, {2, 6, 8, 10}, {3, 6, 7, 10}, {2, 4, 7, 10},
-                                            {1, 5, 7,  9}, {1, 4, 7,  9}, {1, 3, 7,  9}, {1, 4, 6,  9},
-                                            {2, 3, 6,  9}, {0, 1, 2,  9}, {3, 5, 7,  8}, {2, 4, 6,  8} };
   // encode
   TRE_ASSERT(tid < 16);
   const int  t = alpha - alphaBase;
@@ -114,6 +198,26 @@ static int _encodeTable_EAC(const uint pxid, const uint tid, const int alpha, co
   return glm::clamp(alphaBase + multiplier * pxModifier, 0, 255);
 }
 
+/// Error of a pixel, decoded with 4 tables (one per lane). Same arithmetic as "_encodeTable_EAC".
+/// @param tableVal the 4 modifiers of the tables, transposed
+/// @param tableSep the 3 separators (between 2 consecutive modifiers) of the tables, scaled by the multiplier
+static inline __m128 _errorTables4_EAC(const __m128i tableVal[4], const __m128i tableSep[3], const int alpha, const int alphaBase, const int multiplier)
+{
+  // encode
+  const int     t = alpha - alphaBase;
+  const int     pixModSign = t < 0 ? 0 : 1;
+  const __m128i tMag = _mm_set1_epi32((abs(t) + 1 - pixModSign) * 2);
+  __m128i       pixModVal = tableVal[3];
+  pixModVal = _mm_blendv_epi8(pixModVal, tableVal[2], _mm_cmplt_epi32(tMag, tableSep[2]));
+  pixModVal = _mm_blendv_epi8(pixModVal, tableVal[1], _mm_cmplt_epi32(tMag, tableSep[1]));
+  pixModVal = _mm_blendv_epi8(pixModVal, tableVal[0], _mm_cmplt_epi32(tMag, tableSep[0]));
+  // decode
+  const __m128i pxModifier = (pixModSign != 0) ? pixModVal : _mm_sub_epi32(_mm_set1_epi32(-1), pixModVal);
+  const __m128i decoded = _mm_add_epi32(_mm_set1_epi32(alphaBase), _mm_mullo_epi32(_mm_set1_epi32(multiplier), pxModifier));
+  const __m128i alphaDiff = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(decoded, _mm_setzero_si128()), _mm_set1_epi32(255)), _mm_set1_epi32(alpha));
+  return _errorA8(alphaDiff);
+}
+
 static void _rawCompress4x4_RGB8_ETC2(const uint8_t *pixelsIn, uint pxByteSize, uint pitch, uint8_t* __restrict compressed, s_compressionReport &report)
 {
   TRE_ASSERT(pxByteSize >= 3);
@@ -196,63 +300,59 @@ static void _rawCompress4x4_RGB8_ETC2(const uint8_t *pixelsIn, uint pxByteSize,
                          getT( 8, rgbBase_01), getT( 9, rgbBase_01), getT(10, rgbBase_11), getT(11, rgbBase_11),
                          getT(12, rgbBase_01), getT(13, rgbBase_01), getT(14, rgbBase_11), getT(15, rgbBase_11) }; // in fact, we have 3*t
 
-    // Reduce the nbr of tables to evaluate (?)
+    // Loop over tables (for each zone), 4 tables at once
 
-    // Loop over tables (for each zone)
+    float errZone[2][8];
+
+    for (uint tidFirst = 0; tidFirst < 8; tidFirst += 4)
+    {
+      __m128 err_00 = _errorTables4_ETC(tidFirst, t3[ 0], rgbBase_00, rgb[ 0]);
+      err_00 = _mm_add_ps(err_00, _errorTables4_ETC(tidFirst, t3[ 1], rgbBase_00, rgb[ 1]));
+      err_00 = _mm_add_ps(err_00, _errorTables4_ETC(tidFirst, t3[ 4], rgbBase_00, rgb[ 4]));
+      err_00 = _mm_add_ps(err_00, _errorTables4_ETC(tidFirst, t3[ 5], rgbBase_00, rgb[ 5]));
+
+      __m128 err_10 = _errorTables4_ETC(tidFirst, t3[ 2], rgbBase_01, rgb[ 2]);
+      err_10 = _mm_add_ps(err_10, _errorTables4_ETC(tidFirst, t3[ 3], rgbBase_01, rgb[ 3]));
+      err_10 = _mm_add_ps(err_10, _errorTables4_ETC(tidFirst, t3[ 6], rgbBase_01, rgb[ 6]));
+      err_10 = _mm_add_ps(err_10, _errorTables4_ETC(tidFirst, t3[ 7], rgbBase_01, rgb[ 7]));
+
+      __m128 err_01 = _errorTables4_ETC(tidFirst, t3[ 8], rgbBase_10, rgb[ 8]);
+      err_01 = _mm_add_ps(err_01, _errorTables4_ETC(tidFirst, t3[ 9], rgbBase_10, rgb[ 9]));
+      err_01 = _mm_add_ps(err_01, _errorTables4_ETC(tidFirst, t3[12], rgbBase_10, rgb[12]));
+      err_01 = _mm_add_ps(err_01, _errorTables4_ETC(tidFirst, t3[13], rgbBase_10, rgb[13]));
+
+      __m128 err_11 = _errorTables4_ETC(tidFirst, t3[10], rgbBase_11, rgb[10]);
+      err_11 = _mm_add_ps(err_11, _errorTables4_ETC(tidFirst, t3[11], rgbBase_11, rgb[11]));
+      err_11 = _mm_add_ps(err_11, _errorTables4_ETC(tidFirst, t3[14], rgbBase_11, rgb[14]));
+      err_11 = _mm_add_ps(err_11, _errorTables4_ETC(tidFirst, t3[15], rgbBase_11, rgb[15]));
+
+      _mm_storeu_ps(&errZone[0][tidFirst], (fb == 0) ? _mm_add_ps(err_00, err_10) : _mm_add_ps(err_00, err_01));
+      _mm_storeu_ps(&errZone[1][tidFirst], (fb == 0) ? _mm_add_ps(err_01, err_11) : _mm_add_ps(err_10, err_11));
+    }
 
-    glm::ivec3 rgbDelta;
     uint bestTableId_fb[2] = {0, 0};
-    uint bestPixelModifiers_fb[2] = {0, 0};
     float bestError_fp[2] = { std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
 
     for (uint tid = 0; tid < 8; ++tid)
     {
-      uint pixelModifiers_00 = 0; float err_00;
-      rgbDelta = _encodeTable_ETC( 0, tid, t3[ 0], rgbBase_00, pixelModifiers_00) - rgb[ 0]; err_00  = _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 1, tid, t3[ 1], rgbBase_00, pixelModifiers_00) - rgb[ 1]; err_00 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 4, tid, t3[ 4], rgbBase_00, pixelModifiers_00) - rgb[ 4]; err_00 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 5, tid, t3[ 5], rgbBase_00, pixelModifiers_00) - rgb[ 5]; err_00 += _errorRGB8(rgbDelta);
-
-      uint pixelModifiers_10 = 0; float err_10;
-      rgbDelta = _encodeTable_ETC( 2, tid, t3[ 2], rgbBase_01, pixelModifiers_10) - rgb[ 2]; err_10  = _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 3, tid, t3[ 3], rgbBase_01, pixelModifiers_10) - rgb[ 3]; err_10 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 6, tid, t3[ 6], rgbBase_01, pixelModifiers_10) - rgb[ 6]; err_10 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 7, tid, t3[ 7], rgbBase_01, pixelModifiers_10) - rgb[ 7]; err_10 += _errorRGB8(rgbDelta);
-
-      uint pixelModifiers_01 = 0; float err_01;
-      rgbDelta = _encodeTable_ETC( 8, tid, t3[ 8], rgbBase_10, pixelModifiers_01) - rgb[ 8]; err_01  = _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC( 9, tid, t3[ 9], rgbBase_10, pixelModifiers_01) - rgb[ 9]; err_01 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC(12, tid, t3[12], rgbBase_10, pixelModifiers_01) - rgb[12]; err_01 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC(13, tid, t3[13], rgbBase_10, pixelModifiers_01) - rgb[13]; err_01 += _errorRGB8(rgbDelta);
-
-      uint pixelModifiers_11 = 0; float err_11;
-      rgbDelta = _encodeTable_ETC(10, tid, t3[10], rgbBase_11, pixelModifiers_11) - rgb[10]; err_11  = _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC(11, tid, t3[11], rgbBase_11, pixelModifiers_11) - rgb[11]; err_11 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC(14, tid, t3[14], rgbBase_11, pixelModifiers_11) - rgb[14]; err_11 += _errorRGB8(rgbDelta);
-      rgbDelta = _encodeTable_ETC(15, tid, t3[15], rgbBase_11, pixelModifiers_11) - rgb[15]; err_11 += _errorRGB8(rgbDelta);
-
-      const float errZ0 = (fb == 0) ? err_00 + err_10 : err_00 + err_01;
-      if (errZ0 < bestError_fp[0])
-      {
-        bestError_fp[0] = errZ0;
-        bestTableId_fb[0] = tid;
-        bestPixelModifiers_fb[0] = (fb == 0) ? pixelModifiers_00 | pixelModifiers_10 : pixelModifiers_00 | pixelModifiers_01;
-      }
-
-      const float errZ1 = (fb == 0) ? err_01 + err_11 : err_10 + err_11;
-      if (errZ1 < bestError_fp[1])
-      {
-        bestError_fp[1] = errZ1;
-        bestTableId_fb[1] = tid;
-        bestPixelModifiers_fb[1] = (fb == 0) ? pixelModifiers_01 | pixelModifiers_11 : pixelModifiers_10 | pixelModifiers_11;
-      }
-
-      TRE_ASSERT((bestPixelModifiers_fb[0] & bestPixelModifiers_fb[1]) == 0);
+      if (errZone[0][tid] < bestError_fp[0]) { bestError_fp[0] = errZone[0][tid]; bestTableId_fb[0] = tid; }
+      if (errZone[1][tid] < bestError_fp[1]) { bestError_fp[1] = errZone[1][tid]; bestTableId_fb[1] = tid; }
     }
 
     const float bestError_tmp = glm::max(bestError_fp[0], bestError_fp[1]);
     if (bestError_tmp < bestError)
     {
+      // encode the pixel's modifiers of the selected tables
+      static const uint zonePixels[2][2][8] = { { {0, 1, 4, 5, 2, 3, 6, 7}, {8, 9, 12, 13, 10, 11, 14, 15} },
+                                                { {0, 1, 4, 5, 8, 9, 12, 13}, {2, 3, 6, 7, 10, 11, 14, 15} } };
+      uint bestPixelModifiers_fb[2] = {0, 0};
+      for (uint z = 0; z < 2; ++z)
+      {
+        for (const uint px : zonePixels[fb][z])
+          bestPixelModifiers_fb[z] |= _encodeModifier_ETC(px, bestTableId_fb[z], t3[px]);
+      }
+      TRE_ASSERT((bestPixelModifiers_fb[0] & bestPixelModifiers_fb[1]) == 0);
+
       bestError = bestError_tmp;
       bestTablesFlip = (bestTableId_fb[0] << (24+5)) | (bestTableId_fb[1] << (24+2)) | (fb << (24+0));
       bestPixelModifiers = bestPixelModifiers_fb[0] | bestPixelModifiers_fb[1];
@@ -299,61 +399,59 @@ static void _rawCompress4x4_ALPHA_EAC(const uint8_t *pixelsIn, uint pxByteSize,
   const int average = (alpha[ 0] + alpha[ 1] + alpha[ 2] + alpha[ 3] + alpha[ 4] + alpha[ 5] + alpha[ 6] + alpha[ 7] +
                        alpha[ 8] + alpha[ 9] + alpha[10] + alpha[11] + alpha[12] + alpha[13] + alpha[14] + alpha[15] ) / 16;
 
-  // Loop over tables
+  // Get the multiplier
 
-  uint64_t bestEncoded_BigEndian = 0;
-  float    bestError = std::numeric_limits<float>::infinity();
-
-  for (uint tid = 0; tid < 16; ++tid)
+  int multiplier = 1;
   {
-    // Get the multiplier
-    int multiplier = 1;
+    int diffMax = 0;
+    for (std::size_t i = 0; i < 16; ++i)
     {
-      int diffMax = 0;
-      for (std::size_t i = 0; i < 16; ++i)
-      {
-        const int diff_i = abs(alpha[i] - average);
-        if (diff_i > diffMax) diffMax = diff_i;
-      }
-      multiplier = glm::clamp(diffMax / 12, 1, 15);
+      const int diff_i = abs(alpha[i] - average);
+      if (diff_i > diffMax) diffMax = diff_i;
     }
-    TRE_ASSERT(multiplier > 0 && multiplier < 16);
-
-    // Shift the average
-    int localAverage = average;
-
-    TRE_ASSERT(localAverage >= 0 && localAverage <= 0xFF);
-
-    // Compute the error
-
-    uint64_t localEncoded_BigEndian = (uint64_t(localAverage & 0xFF) << 56) | (uint64_t(multiplier & 0xF) << 52) | (uint64_t(tid & 0xF) << 48);
-    float    localError = 0.f;
-    int      alphaDiff;
-
-    alphaDiff = _encodeTable_EAC( 0, tid, alpha[ 0], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 0]; localError  = _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 1, tid, alpha[ 1], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 1]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 2, tid, alpha[ 2], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 2]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 3, tid, alpha[ 3], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 3]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 4, tid, alpha[ 4], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 4]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 5, tid, alpha[ 5], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 5]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 6, tid, alpha[ 6], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 6]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 7, tid, alpha[ 7], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 7]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 8, tid, alpha[ 8], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 8]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC( 9, tid, alpha[ 9], localAverage, multiplier, localEncoded_BigEndian) - alpha[ 9]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(10, tid, alpha[10], localAverage, multiplier, localEncoded_BigEndian) - alpha[10]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(11, tid, alpha[11], localAverage, multiplier, localEncoded_BigEndian) - alpha[11]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(12, tid, alpha[12], localAverage, multiplier, localEncoded_BigEndian) - alpha[12]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(13, tid, alpha[13], localAverage, multiplier, localEncoded_BigEndian) - alpha[13]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(14, tid, alpha[14], localAverage, multiplier, localEncoded_BigEndian) - alpha[14]; localError += _errorA8(alphaDiff);
-    alphaDiff = _encodeTable_EAC(15, tid, alpha[15], localAverage, multiplier, localEncoded_BigEndian) - alpha[15]; localError += _errorA8(alphaDiff);
-
-    if (localError < bestError)
+    multiplier = glm::clamp(diffMax / 12, 1, 15);
+  }
+  TRE_ASSERT(multiplier > 0 && multiplier < 16);
+  TRE_ASSERT(average >= 0 && average <= 0xFF);
+
+  // Loop over tables, 4 tables at once
+
+  float errTable[16];
+
+  for (uint tidFirst = 0; tidFirst < 16; tidFirst += 4)
+  {
+    __m128i tableVal[4];
+    for (uint k = 0; k < 4; ++k)
+      tableVal[k] = _mm_setr_epi32(_tableAEC_val[tidFirst + 0][k], _tableAEC_val[tidFirst + 1][k], _tableAEC_val[tidFirst + 2][k], _tableAEC_val[tidFirst + 3][k]);
+    __m128i tableSep[3];
+    for (uint k = 0; k < 3; ++k)
+      tableSep[k] = _mm_mullo_epi32(_mm_add_epi32(tableVal[k], tableVal[k + 1]), _mm_set1_epi32(multiplier));
+
+    __m128 localError = _errorTables4_EAC(tableVal, tableSep, alpha[0], average, multiplier);
+    for (uint i = 1; i < 16; ++i)
+      localError = _mm_add_ps(localError, _errorTables4_EAC(tableVal, tableSep, alpha[i], average, multiplier));
+
+    _mm_storeu_ps(&errTable[tidFirst], localError);
+  }
+
+  uint  bestTableId = 0;
+  float bestError = std::numeric_limits<float>::infinity();
+
+  for (uint tid = 0; tid < 16; ++tid)
+  {
+    if (errTable[tid] < bestError)
     {
-      bestEncoded_BigEndian = localEncoded_BigEndian;
-      bestError = localError;
+      bestError = errTable[tid];
+      bestTableId = tid;
     }
   }
 
+  // Encode with the selected table
+
+  uint64_t bestEncoded_BigEndian = (uint64_t(average & 0xFF) << 56) | (uint64_t(multiplier & 0xF) << 52) | (uint64_t(bestTableId & 0xF) << 48);
+  for (uint i = 0; i < 16; ++i)
+    _encodeTable_EAC(i, bestTableId, alpha[i], average, multiplier, bestEncoded_BigEndian);
+
   compressed[ 0] = (bestEncoded_BigEndian >> 56) & 0xFF;
   compressed[ 1] = (bestEncoded_BigEndian >> 48) & 0xFF;
   compressed[ 2] = (bestEncoded_BigEndian >> 40) & 0xFF;
@@ -364,6 +462,116 @@ static void _rawCompress4x4_ALPHA_EAC(const uint8_t *pixelsIn, uint pxByteSize,
   compressed[ 7] = (bestEncoded_BigEndian      ) & 0xFF;
 }
 
+static void _buildPalette_R11_EAC(const uint tid, const int base, const int multiplier, int16_t palette[8])
+{
+  const int base11 = base * 8 + 4;
+  const int mult11 = (multiplier == 0) ? 1 : multiplier * 8;
+  for (uint k = 0; k < 4; ++k)
+  {
+    palette[k    ] = int16_t(glm::clamp(base11 - mult11 * (_tableAEC_val[tid][k] + 1), 0, 2047));
+    palette[k + 4] = int16_t(glm::clamp(base11 + mult11 * _tableAEC_val[tid][k], 0, 2047));
+  }
+}
+
+static void _rawCompress4x4_R11_EAC(const uint8_t *pixelsIn, uint pxByteSize, uint pitch, uint channel, uint8_t* __restrict compressed, s_compressionReportChannel &report)
+{
+  TRE_ASSERT(channel < pxByteSize);
+
+  /* pixel layout: |  0 |  4 |  8 | 12 |
+   *               |  1 |  5 |  9 | 13 |
+   *               |  2 |  6 | 10 | 14 |
+   *               |  3 |  7 | 11 | 15 | */
+
+  // mode R11: each pixel has a value clamp(base * 8 + 4 + multiplier * 8 * modifier) on 11 bits, where the modifier is definied per pixel.
+  //           The 8-bits values are scaled to 11 bits.
+
+  int16_t value[16];
+  for (uint i = 0; i < 4; ++i)
+  {
+    for (uint j = 0; j < 4; ++j)
+      value[i * 4 + j] = int16_t((int(pixelsIn[i * pxByteSize + j * pitch + channel]) * 2047 + 127) / 255);
+  }
+
+  int valueMin = value[0];
+  int valueMax = value[0];
+  for (uint i = 1; i < 16; ++i)
+  {
+    valueMin = glm::min(valueMin, int(value[i]));
+    valueMax = glm::max(valueMax, int(value[i]));
+  }
+
+  const __m128i valueV[2] = { _mm_loadu_si128(reinterpret_cast<const __m128i*>(&value[0])),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(&value[8])) };
+
+  // Loop over the tables. For each table, the multiplier and the base fit the range of the values.
+
+  int     bestError = std::numeric_limits<int>::max();
+  uint    bestTableId = 0;
+  int     bestBase = 0;
+  int     bestMultiplier = 0;
+  int16_t palette[8];
+
+  const auto fnTry = [&](const uint tid, const int base, const int multiplier)
+  {
+    _buildPalette_R11_EAC(tid, base, multiplier, palette);
+    const int err = _errorPalette8(valueV, palette);
+    if (err < bestError)
+    {
+      bestError = err;
+      bestTableId = tid;
+      bestBase = base;
+      bestMultiplier = multiplier;
+    }
+  };
+
+  for (uint tid = 0; tid < 16; ++tid)
+  {
+    const int modLow = -(_tableAEC_val[tid][3] + 1);
+    const int modHigh = _tableAEC_val[tid][3];
+    const int mult11 = (valueMax - valueMin) / (modHigh - modLow);
+    const int multiplierLow = glm::min(mult11 / 8, 15);
+    const int multiplierHigh = glm::min(multiplierLow + 1, 15);
+    for (int multiplier = multiplierLow; multiplier <= multiplierHigh; ++multiplier)
+    {
+      const int multiplier11 = (multiplier == 0) ? 1 : multiplier * 8;
+      const int base11 = (valueMin + valueMax - (modLow + modHigh) * multiplier11) / 2;
+      fnTry(tid, glm::clamp(base11 / 8, 0, 255), multiplier); // round((base11 - 4) / 8)
+    }
+  }
+
+  // Refine the base of the selected table
+
+  {
+    const uint tid = bestTableId;
+    const int  base = bestBase;
+    const int  multiplier = bestMultiplier;
+    if (base > 0  ) fnTry(tid, base - 1, multiplier);
+    if (base < 255) fnTry(tid, base + 1, multiplier);
+  }
+
+  // Encode
+
+  _buildPalette_R11_EAC(bestTableId, bestBase, bestMultiplier, palette);
+
+  uint64_t bestEncoded_BigEndian = (uint64_t(bestBase & 0xFF) << 56) | (uint64_t(bestMultiplier & 0xF) << 52) | (uint64_t(bestTableId & 0xF) << 48);
+  int      errorMax = 0;
+  for (uint i = 0; i < 16; ++i)
+  {
+    const uint pxModifier = _indexPalette8(value[i], palette);
+    bestEncoded_BigEndian |= uint64_t(pxModifier) << (45 - i * 3);
+    errorMax = glm::max(errorMax, abs(palette[pxModifier] - value[i]));
+  }
+
+  for (uint k = 0; k < 8; ++k)
+    compressed[k] = (bestEncoded_BigEndian >> (56 - k * 8)) & 0xFF;
+
+  {
+    ++report.m_blockCount;
+    report.m_errorL2 += float(bestError) / (16.f * 2047.f * 2047.f);
+    report.m_errorInf = glm::max(report.m_errorInf, float(errorMax) / 2047.f);
+  }
+}
+
 }
 
 // ============================================================================
@@ -381,6 +589,14 @@ struct s_compressionReport
   float m_errorL2 = 0.f;
   float m_errorInf = 0.f;
 
+  void merge(const s_compressionReport &other)
+  {
+    m_modeHIGHERcount += other.m_modeHIGHERcount;
+    m_modeLOWERcount += other.m_modeLOWERcount;
+    m_errorL2 += other.m_errorL2;
+    m_errorInf = glm::max(m_errorInf, other.m_errorInf);
+  }
+
   void print() const
   {
 #ifdef TRE_PRINTS
@@ -619,24 +835,34 @@ static void _rawCompress4x4_RGB8_S3TC(const uint8_t *pixelsIn, uint pxByteSize,
     glm::ivec3 color1 = glm::clamp(glm::ivec3(colorOffset + param1 * colorSlope), glm::ivec3(0), glm::ivec3(255));
     if (!_compareColor_S3TC_0greaterthan1(color0, color1)) std::swap(color0, color1);
     _encodeColorBase_S3TC(color0, color1, *reinterpret_cast<uint*>(compressed));
-    // -> compute table
+    // -> compute table (4 pixels at once)
     const glm::ivec3 colorT2 = (2 * color0 + color1) / 3;
     const glm::ivec3 colorT3 = (color0 + 2 * color1) / 3;
+    const auto fnErrorT = [](const __m128i r, const __m128i g, const __m128i b, const glm::ivec3 &colorT)
+    {
+      const __m128i errR = _mm_sub_epi32(r, _mm_set1_epi32(colorT.r));
+      const __m128i errG = _mm_sub_epi32(g, _mm_set1_epi32(colorT.g));
+      const __m128i errB = _mm_sub_epi32(b, _mm_set1_epi32(colorT.b));
+      return _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(errR, errR), _mm_mullo_epi32(errG, errG)), _mm_mullo_epi32(errB, errB));
+    };
     uint table = 0;
-    for (std::size_t i = 0; i < 16; ++i)
+    for (std::size_t i = 0; i < 16; i += 4)
     {
-      const glm::ivec3 errV0 = rgb[i] - color0;
-      const glm::ivec3 errV1 = rgb[i] - color1;
-      const glm::ivec3 errV2 = rgb[i] - colorT2;
-      const glm::ivec3 errV3 = rgb[i] - colorT3;
-      const int errT0 = errV0.x * errV0.x + errV0.y * errV0.y + errV0.z * errV0.z; // glm::dot only accepts floats
-      const int errT1 = errV1.x * errV1.x + errV1.y * errV1.y + errV1.z * errV1.z;
-      const int errT2 = errV2.x * errV2.x + errV2.y * errV2.y + errV2.z * errV2.z;
-      const int errT3 = errV3.x * errV3.x + errV3.y * errV3.y + errV3.z * errV3.z;
-      const int errMin = std::min(std::min(errT0, errT1), std::min(errT2, errT3));
-      if      (errMin == errT1) table |= (0x1 << (i * 2));
-      else if (errMin == errT2) table |= (0x2 << (i * 2));
-      else if (errMin == errT3) table |= (0x3 << (i * 2));
+      const __m128i r = _mm_setr_epi32(rgb[i].r, rgb[i + 1].r, rgb[i + 2].r, rgb[i + 3].r);
+      const __m128i g = _mm_setr_epi32(rgb[i].g, rgb[i + 1].g, rgb[i + 2].g, rgb[i + 3].g);
+      const __m128i b = _mm_setr_epi32(rgb[i].b, rgb[i + 1].b, rgb[i + 2].b, rgb[i + 3].b);
+      const __m128i errT0 = fnErrorT(r, g, b, color0);
+      const __m128i errT1 = fnErrorT(r, g, b, color1);
+      const __m128i errT2 = fnErrorT(r, g, b, colorT2);
+      const __m128i errT3 = fnErrorT(r, g, b, colorT3);
+      const __m128i errMin = _mm_min_epi32(_mm_min_epi32(errT0, errT1), _mm_min_epi32(errT2, errT3));
+      // priority: code 1, then code 2, then code 3, then code 0
+      __m128i code = _mm_setzero_si128();
+      code = _mm_blendv_epi8(code, _mm_set1_epi32(0x3), _mm_cmpeq_epi32(errMin, errT3));
+      code = _mm_blendv_epi8(code, _mm_set1_epi32(0x2), _mm_cmpeq_epi32(errMin, errT2));
+      code = _mm_blendv_epi8(code, _mm_set1_epi32(0x1), _mm_cmpeq_epi32(errMin, errT1));
+      table |= (uint(_mm_extract_epi32(code, 0)) << (i * 2 + 0)) | (uint(_mm_extract_epi32(code, 1)) << (i * 2 + 2)) |
+               (uint(_mm_extract_epi32(code, 2)) << (i * 2 + 4)) | (uint(_mm_extract_epi32(code, 3)) << (i * 2 + 6));
     }
     // -> END
     *reinterpret_cast<uint*>(&compressed[4]) = table;
@@ -678,81 +904,352 @@ static void _rawCompress4x4_ALPHA_DXT3(const uint8_t *pixelsIn, uint pxByteSize,
 
 }
 
+// ============================================================================
+/**
+ * Red-Green Texture Compression (RGTC) is a compression scheme for 1 or 2 channels textures.
+ * Called also BC4 (red) and BC5 (red-green, as 2 BC4 blocks)
+ * ref: https://www.khronos.org/opengl/wiki/Red_Green_Texture_Compression
+ */
+namespace formatRGTC {
+
+static void _buildPalette_RGTC(const int red0, const int red1, int16_t palette[8])
+{
+  palette[0] = int16_t(red0);
+  palette[1] = int16_t(red1);
+  if (red0 > red1)
+  {
+    for (int k = 1; k < 7; ++k) palette[k + 1] = int16_t(((7 - k) * red0 + k * red1 + 3) / 7);
+  }
+  else
+  {
+    for (int k = 1; k < 5; ++k) palette[k + 1] = int16_t(((5 - k) * red0 + k * red1 + 2) / 5);
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+static void _rawCompress4x4_R8_RGTC(const uint8_t *pixelsIn, uint pxByteSize, uint pitch, uint channel, uint8_t* __restrict compressed, s_compressionReportChannel &report)
+{
+  TRE_ASSERT(channel < pxByteSize);
+
+  /* pixel layout: |  0 |  1 |  2 |  3 |
+   *               |  4 |  5 |  6 |  7 |
+   *               |  8 |  9 | 10 | 11 |
+   *               | 12 | 13 | 14 | 15 | */
+
+  int16_t value[16];
+  for (uint j = 0; j < 4; ++j)
+  {
+    for (uint i = 0; i < 4; ++i)
+      value[j * 4 + i] = int16_t(pixelsIn[i * pxByteSize + j * pitch + channel]);
+  }
+
+  int valueMin = 255, valueMax = 0;             // all values
+  int valueInnerMin = 255, valueInnerMax = 0;   // values without the extrema 0 and 255
+  for (uint i = 0; i < 16; ++i)
+  {
+    valueMin = glm::min(valueMin, int(value[i]));
+    valueMax = glm::max(valueMax, int(value[i]));
+    if (value[i] != 0 && value[i] != 255)
+    {
+      valueInnerMin = glm::min(valueInnerMin, int(value[i]));
+      valueInnerMax = glm::max(valueInnerMax, int(value[i]));
+    }
+  }
+  if (valueInnerMin > valueInnerMax) valueInnerMin = valueInnerMax = 0;
+
+  const __m128i valueV[2] = { _mm_loadu_si128(reinterpret_cast<const __m128i*>(&value[0])),
+                              _mm_loadu_si128(reinterpret_cast<const __m128i*>(&value[8])) };
+
+  int     bestError = std::numeric_limits<int>::max();
+  int     bestRed0 = 0, bestRed1 = 0;
+  int16_t palette[8];
+
+  const auto fnTry = [&](const int red0, const int red1)
+  {
+    _buildPalette_RGTC(red0, red1, palette);
+    const int err = _errorPalette8(valueV, palette);
+    if (err < bestError)
+    {
+      bestError = err;
+      bestRed0 = red0;
+      bestRed1 = red1;
+    }
+  };
+
+  // mode 8-values (red0 > red1): the palette covers the range of the values.
+
+  if (valueMax > valueMin)
+  {
+    fnTry(valueMax, valueMin);
+
+    // refine the end-points with a least-squares fit of the interpolation weights
+    _buildPalette_RGTC(valueMax, valueMin, palette);
+    static const float weight1[8] = { 0.f, 1.f, 1.f/7.f, 2.f/7.f, 3.f/7.f, 4.f/7.f, 5.f/7.f, 6.f/7.f };
+    float a = 0.f, b = 0.f, c = 0.f, x = 0.f, y = 0.f;
+    for (uint i = 0; i < 16; ++i)
+    {
+      const float w1 = weight1[_indexPalette8(value[i], palette)];
+      const float w0 = 1.f - w1;
+      a += w0 * w0;
+      b += w0 * w1;
+      c += w1 * w1;
+      x += w0 * value[i];
+      y += w1 * value[i];
+    }
+    const float det = a * c - b * b;
+    if (det > 1.e-3f)
+    {
+      const int red0 = glm::clamp(int(std::round((c * x - b * y) / det)), 0, 255);
+      const int red1 = glm::clamp(int(std::round((a * y - b * x) / det)), 0, 255);
+      if (red0 > red1) fnTry(red0, red1);
+    }
+  }
+
+  // mode 6-values (red0 <= red1): the palette covers the range of the values, plus the extrema 0 and 255.
+
+  fnTry(valueInnerMin, valueInnerMax);
+
+  // Encode
+
+  _buildPalette_RGTC(bestRed0, bestRed1, palette);
+
+  uint64_t bestEncoded = 0;
+  int      errorMax = 0;
+  for (uint i = 0; i < 16; ++i)
+  {
+    const uint pxIndex = _indexPalette8(value[i], palette);
+    bestEncoded |= uint64_t(pxIndex) << (i * 3);
+    errorMax = glm::max(errorMax, abs(palette[pxIndex] - value[i]));
+  }
+
+  compressed[0] = uint8_t(bestRed0);
+  compressed[1] = uint8_t(bestRed1);
+  for (uint k = 0; k < 6; ++k)
+    compressed[2 + k] = (bestEncoded >> (k * 8)) & 0xFF;
+
+  {
+    ++report.m_blockCount;
+    report.m_errorL2 += float(bestError) / (16.f * 255.f * 255.f);
+    report.m_errorInf = glm::max(report.m_errorInf, float(errorMax) / 255.f);
+  }
+}
+
+}
+
+// ============================================================================
+
+/**
+ * HDR formats: pack RGB floats into 32 bits (not block-compressed).
+ * - RGB9E5: 9 bits of mantissa per channel, and a shared 5-bits exponent (EXT_texture_shared_exponent).
+ * - R11G11B10F: unsigned floats, 5-bits exponent with 6 bits (R, G) or 5 bits (B) of mantissa (EXT_packed_float).
+ * 4 pixels are packed at once (one pixel per lane). Negative values and NaN are clamped to 0, the infinity to the max value.
+ */
+namespace formatHDR {
+
+/// Pack 4 pixels into RGB9E5 (rounded to nearest).
+static inline __m128i _pack4_RGB9E5(__m128 r, __m128 g, __m128 b)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 maxValue = _mm_set1_ps(65408.f); // (511/512) * 2^16
+  const __m128 half = _mm_set1_ps(0.5f);
+  r = _mm_min_ps(_mm_max_ps(r, zero), maxValue); // (max_ps returns the 2nd operand on NaN)
+  g = _mm_min_ps(_mm_max_ps(g, zero), maxValue);
+  b = _mm_min_ps(_mm_max_ps(b, zero), maxValue);
+  const __m128 maxRGB = _mm_max_ps(_mm_max_ps(r, g), b);
+
+  // shared exponent = max(-16, floor(log2(maxRGB))) + 16, read from the float's exponent bits (no overflow as maxRGB < 2^16)
+  __m128i expShared = _mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(maxRGB), 23), _mm_set1_epi32(127 - 16));
+  expShared = _mm_max_epi32(expShared, _mm_setzero_si128());
+  // scale = 2^(9 + 15 - expShared), built from its exponent bits
+  __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_sub_epi32(_mm_set1_epi32(127 + 24), expShared), 23));
+
+  // the rounding of the max channel may overflow the 9-bits mantissa: use the next exponent
+  const __m128i maxMantissa = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(maxRGB, scale), half));
+  const __m128i overflow = _mm_cmpeq_epi32(maxMantissa, _mm_set1_epi32(512));
+  expShared = _mm_sub_epi32(expShared, overflow);
+  scale = _mm_blendv_ps(scale, _mm_mul_ps(scale, half), _mm_castsi128_ps(overflow));
+
+  const __m128i rm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, scale), half));
+  const __m128i gm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, scale), half));
+  const __m128i bm = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), half));
+  return _mm_or_si128(_mm_or_si128(rm, _mm_slli_epi32(gm, 9)), _mm_or_si128(_mm_slli_epi32(bm, 18), _mm_slli_epi32(expShared, 27)));
+}
+
+/// Pack 4 values into an unsigned float with a 5-bits exponent and a "mantissaBits"-bits mantissa (rounded to nearest).
+template<int mantissaBits>
+static inline __m128i _pack4_smallFloat(__m128 v)
+{
+  const float maxValue = (2.f - 1.f / float(1 << mantissaBits)) * 32768.f;
+  v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(maxValue));
+
+  // normal: re-bias the exponent (127 -> 15) and round the mantissa (the carry propagates into the exponent)
+  const __m128i bits = _mm_add_epi32(_mm_castps_si128(v), _mm_set1_epi32(1 << (22 - mantissaBits)));
+  const __m128i normal = _mm_sub_epi32(_mm_srli_epi32(bits, 23 - mantissaBits), _mm_set1_epi32((127 - 15) << mantissaBits));
+  // denormal (v < 2^-14): v * 2^(14 + mantissaBits), rounded (the rounding up to 2^mantissaBits gives the smallest normal)
+  const __m128i denormal = _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(float(1 << (14 + mantissaBits)))));
+  const __m128  isDenormal = _mm_cmplt_ps(v, _mm_set1_ps(1.f / 16384.f));
+  return _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(normal), _mm_castsi128_ps(denormal), isDenormal));
+}
+
+/// Pack 4 pixels into R11G11B10F.
+static inline __m128i _pack4_R11G11B10F(const __m128 r, const __m128 g, const __m128 b)
+{
+  return _mm_or_si128(_mm_or_si128(_pack4_smallFloat<6>(r), _mm_slli_epi32(_pack4_smallFloat<6>(g), 11)), _mm_slli_epi32(_pack4_smallFloat<5>(b), 22));
+}
+
+/// Load 4 pixels (RGB or RGBA) into 3 lanes-registers. "count" is the number of valid pixels (the others are set to 0).
+static inline void _load4(const float *pixels, uint components, uint count, __m128 &r, __m128 &g, __m128 &b)
+{
+  if (components == 4 && count == 4)
+  {
+    __m128 p0 = _mm_loadu_ps(pixels + 0), p1 = _mm_loadu_ps(pixels + 4), p2 = _mm_loadu_ps(pixels + 8), p3 = _mm_loadu_ps(pixels + 12);
+    _MM_TRANSPOSE4_PS(p0, p1, p2, p3);
+    r = p0;
+    g = p1;
+    b = p2;
+    return;
+  }
+  float rgb[3][4] = {};
+  for (uint ip = 0; ip < count; ++ip)
+  {
+    rgb[0][ip] = pixels[ip * components + 0];
+    rgb[1][ip] = pixels[ip * components + 1];
+    rgb[2][ip] = pixels[ip * components + 2];
+  }
+  r = _mm_loadu_ps(rgb[0]);
+  g = _mm_loadu_ps(rgb[1]);
+  b = _mm_loadu_ps(rgb[2]);
+}
+
+}
+
+// ============================================================================
+
+/**
+ * Compress the 4x4-blocks of an image. The rows of blocks are dispatched on the thread-pool.
+ * The compressed data is written in a separate buffer, as the in-place compression of a row would overwrite the pixels of the next rows.
+ * The reports of the rows are merged in order.
+ */
+template<class _Report, class _Fnct>
+static uint _rawCompressBlocks(uint8_t *pixels, uint w, uint h, uint pitch, uint pxByteSize, uint blockByteSize, _Report &report, const _Fnct &fnctBlock)
+{
+  const uint        blockCountX = (w + 3) / 4;
+  const uint        blockCountY = (h + 3) / 4;
+  const std::size_t rowByteSize = std::size_t(blockCountX) * blockByteSize;
+
+  std::vector<uint8_t> outBuffer(rowByteSize * blockCountY);
+  std::vector<_Report> rowReports(blockCountY);
+
+  parallelFor(blockCountY, 4, [&](std::size_t jBegin, std::size_t jEnd)
+  {
+    for (std::size_t jb = jBegin; jb < jEnd; ++jb)
+    {
+      const uint8_t *rowIn = pixels + pitch * 4 * jb;
+      uint8_t       *rowOut = outBuffer.data() + rowByteSize * jb;
+      _Report       rowReport;
+      for (uint ib = 0; ib < blockCountX; ++ib)
+        fnctBlock(rowIn + pxByteSize * 4 * ib, rowOut + blockByteSize * ib, rowReport);
+      rowReports[jb] = rowReport;
+    }
+  });
+
+  for (const _Report &rowReport : rowReports) report.merge(rowReport);
+
+  memcpy(pixels, outBuffer.data(), outBuffer.size());
+  return uint(outBuffer.size());
+}
+
 // ============================================================================
 
 uint texture::_rawCompress(const s_SurfaceTemp &surf, GLenum targetFormat)
 {
-  const uint8_t *inPixels = const_cast<const uint8_t*>(surf.pixels);
-  uint8_t       *outBuffer = surf.pixels;
-  static_assert (sizeof(uint64_t) == 8, "bad size of uint64_t");
+  const uint pxByteSize = surf.pxByteSize;
+  const uint pitch = surf.pitch;
+  uint       outByteSize = 0;
 
   if (targetFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || targetFormat == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT)
   {
     formatS3TC::s_compressionReport report;
-    for (uint ih = 0; ih < surf.h; ih += 4)
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, pxByteSize, 8, report, [pxByteSize, pitch](const uint8_t *blockIn, uint8_t *blockOut, formatS3TC::s_compressionReport &rowReport)
     {
-      for (uint iw = 0; iw < surf.w; iw += 4)
-      {
-        formatS3TC::_rawCompress4x4_RGB8_S3TC(inPixels + surf.pitch * ih + surf.pxByteSize * iw, surf.pxByteSize, surf.pitch, outBuffer, report);
-        outBuffer += 8;
-      }
-    }
+      formatS3TC::_rawCompress4x4_RGB8_S3TC(blockIn, pxByteSize, pitch, blockOut, rowReport);
+    });
     report.print();
   }
   else if (targetFormat == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT || targetFormat == GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT)
   {
     formatS3TC::s_compressionReport report;
-    TRE_ASSERT(surf.pxByteSize == 4);
-    for (uint ih = 0; ih < surf.h; ih += 4)
+    TRE_ASSERT(pxByteSize == 4);
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, 4, 16, report, [pitch](const uint8_t *blockIn, uint8_t *blockOut, formatS3TC::s_compressionReport &rowReport)
     {
-      for (uint iw = 0; iw < surf.w; iw += 4)
-      {
-        uint64_t out1 = 0;
-        formatS3TC::_rawCompress4x4_ALPHA_DXT3(inPixels + surf.pitch * ih + 4 * iw, 4, surf.pitch, reinterpret_cast<uint8_t*>(&out1), report);
-        uint64_t out2 = 0;
-        formatS3TC::_rawCompress4x4_RGB8_S3TC(inPixels + surf.pitch * ih + 4 * iw, 4, surf.pitch, reinterpret_cast<uint8_t*>(&out2), report);
-        memcpy(outBuffer, &out1, 8);
-        outBuffer += 8;
-        memcpy(outBuffer, &out2, 8);
-        outBuffer += 8;
-      }
-    }
+      formatS3TC::_rawCompress4x4_ALPHA_DXT3(blockIn, 4, pitch, blockOut, rowReport);
+      formatS3TC::_rawCompress4x4_RGB8_S3TC(blockIn, 4, pitch, blockOut + 8, rowReport);
+    });
     report.print();
   }
 
+  else if (targetFormat == GL_COMPRESSED_RED_RGTC1)
+  {
+    s_compressionReportChannel report;
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, pxByteSize, 8, report, [pxByteSize, pitch](const uint8_t *blockIn, uint8_t *blockOut, s_compressionReportChannel &rowReport)
+    {
+      formatRGTC::_rawCompress4x4_R8_RGTC(blockIn, pxByteSize, pitch, 0, blockOut, rowReport);
+    });
+    report.print("RGTC1");
+  }
+  else if (targetFormat == GL_COMPRESSED_RG_RGTC2)
+  {
+    s_compressionReportChannel report;
+    TRE_ASSERT(pxByteSize == 2);
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, 2, 16, report, [pitch](const uint8_t *blockIn, uint8_t *blockOut, s_compressionReportChannel &rowReport)
+    {
+      formatRGTC::_rawCompress4x4_R8_RGTC(blockIn, 2, pitch, 0, blockOut, rowReport);
+      formatRGTC::_rawCompress4x4_R8_RGTC(blockIn, 2, pitch, 1, blockOut + 8, rowReport);
+    });
+    report.print("RGTC2");
+  }
+
 #ifdef TRE_OPENGL_ES
 
+  else if (targetFormat == GL_COMPRESSED_R11_EAC)
+  {
+    s_compressionReportChannel report;
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, pxByteSize, 8, report, [pxByteSize, pitch](const uint8_t *blockIn, uint8_t *blockOut, s_compressionReportChannel &rowReport)
+    {
+      formatETC::_rawCompress4x4_R11_EAC(blockIn, pxByteSize, pitch, 0, blockOut, rowReport);
+    });
+    report.print("EAC R11");
+  }
+  else if (targetFormat == GL_COMPRESSED_RG11_EAC)
+  {
+    s_compressionReportChannel report;
+    TRE_ASSERT(pxByteSize == 2);
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, 2, 16, report, [pitch](const uint8_t *blockIn, uint8_t *blockOut, s_compressionReportChannel &rowReport)
+    {
+      formatETC::_rawCompress4x4_R11_EAC(blockIn, 2, pitch, 0, blockOut, rowReport);
+      formatETC::_rawCompress4x4_R11_EAC(blockIn, 2, pitch, 1, blockOut + 8, rowReport);
+    });
+    report.print("EAC RG11");
+  }
   else if (targetFormat == GL_COMPRESSED_RGB8_ETC2 || targetFormat == GL_COMPRESSED_SRGB8_ETC2)
   {
     formatETC::s_compressionReport report;
-    for (uint ih = 0; ih < surf.h; ih += 4)
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, pxByteSize, 8, report, [pxByteSize, pitch](const uint8_t *blockIn, uint8_t *blockOut, formatETC::s_compressionReport &rowReport)
     {
-      for (uint iw = 0; iw < surf.w; iw += 4)
-      {
-        formatETC::_rawCompress4x4_RGB8_ETC2(inPixels + surf.pitch * ih + surf.pxByteSize * iw, surf.pxByteSize, surf.pitch, outBuffer, report);
-        outBuffer += 8;
-      }
-    }
+      formatETC::_rawCompress4x4_RGB8_ETC2(blockIn, pxByteSize, pitch, blockOut, rowReport);
+    });
     report.print();
   }
   else if (targetFormat == GL_COMPRESSED_RGBA8_ETC2_EAC || targetFormat == GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC)
   {
     formatETC::s_compressionReport report;
-    TRE_ASSERT(surf.pxByteSize == 4);
-    for (uint ih = 0; ih < surf.h; ih += 4)
+    TRE_ASSERT(pxByteSize == 4);
+    outByteSize = _rawCompressBlocks(surf.pixels, surf.w, surf.h, pitch, 4, 16, report, [pitch](const uint8_t *blockIn, uint8_t *blockOut, formatETC::s_compressionReport &rowReport)
     {
-      for (uint iw = 0; iw < surf.w; iw += 4)
-      {
-        uint64_t out1 = 0;
-        formatETC::_rawCompress4x4_ALPHA_EAC(inPixels + surf.pitch * ih + 4 * iw, 4, surf.pitch, reinterpret_cast<uint8_t*>(&out1), report);
-        uint64_t out2 = 0;
-        formatETC::_rawCompress4x4_RGB8_ETC2(inPixels + surf.pitch * ih + 4 * iw, 4, surf.pitch, reinterpret_cast<uint8_t*>(&out2), report);
-        memcpy(outBuffer, &out1, 8);
-        outBuffer += 8;
-        memcpy(outBuffer, &out2, 8);
-        outBuffer += 8;
-      }
-    }
+      formatETC::_rawCompress4x4_ALPHA_EAC(blockIn, 4, pitch, blockOut, rowReport);
+      formatETC::_rawCompress4x4_RGB8_ETC2(blockIn, 4, pitch, blockOut + 8, rowReport);
+    });
     report.print();
   }
 
@@ -763,7 +1260,40 @@ uint texture::_rawCompress(const s_SurfaceTemp &surf, GLenum targetFormat)
     TRE_FATAL("_rawCompress: format not supported");
   }
 
-  return static_cast<uint>(outBuffer - inPixels);
+  return outByteSize;
+}
+
+//-----------------------------------------------------------------------------
+
+void texture::_rawPackHDR(const float *pixels, std::size_t count, uint components, GLenum packedFormat, uint32_t *packed)
+{
+  TRE_ASSERT(components == 3 || components == 4);
+  TRE_ASSERT(packedFormat == GL_RGB9_E5 || packedFormat == GL_R11F_G11F_B10F);
+
+  const bool        isRGB9E5 = (packedFormat == GL_RGB9_E5);
+  const std::size_t groupCount = (count + 3) / 4;
+
+  parallelFor(groupCount, 1024, [&](std::size_t gBegin, std::size_t gEnd)
+  {
+    for (std::size_t ig = gBegin; ig < gEnd; ++ig)
+    {
+      const std::size_t ip = ig * 4;
+      const uint        countGroup = uint(std::min<std::size_t>(count - ip, 4));
+      __m128            r, g, b;
+      formatHDR::_load4(pixels + ip * components, components, countGroup, r, g, b);
+      const __m128i     packed4 = isRGB9E5 ? formatHDR::_pack4_RGB9E5(r, g, b) : formatHDR::_pack4_R11G11B10F(r, g, b);
+      if (countGroup == 4)
+      {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packed + ip), packed4);
+      }
+      else
+      {
+        uint32_t packedTail[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(packedTail), packed4);
+        memcpy(packed + ip, packedTail, countGroup * sizeof(uint32_t));
+      }
+    }
+  });
 }
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,506 @@
+#include "tre_texture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if !defined(TRE_EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+#define TRE_WITH_THREADS
+#endif
+
+namespace tre {
+
+//-----------------------------------------------------------------------------
+
+static const std::size_t k_chunkAlignment = 16;
+
+static std::size_t _alignUp(std::size_t offset) { return (offset + k_chunkAlignment - 1) & ~(k_chunkAlignment - 1); }
+
+static GLenum _getBindTarget(GLenum target)
+{
+  if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z) return GL_TEXTURE_CUBE_MAP;
+  return target;
+}
+
+static bool _is3DTarget(GLenum target) { return target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_3D; }
+
+//-----------------------------------------------------------------------------
+
+textureUploader::s_GLBackend::s_GLBackend()
+{
+  m_genBuffers    = [](GLsizei n, GLuint *buffers) { glGenBuffers(n, buffers); };
+  m_deleteBuffers = [](GLsizei n, const GLuint *buffers) { glDeleteBuffers(n, buffers); };
+  m_bindBuffer    = [](GLenum target, GLuint buffer) { glBindBuffer(target, buffer); };
+  m_bufferData    = [](GLenum target, GLsizeiptr size, const void *data, GLenum usage) { glBufferData(target, size, data, usage); };
+  m_bufferSubData = [](GLenum target, GLintptr offset, GLsizeiptr size, const void *data) { glBufferSubData(target, offset, size, data); };
+#ifdef TRE_EMSCRIPTEN // WebGL does not support the mapping of buffers.
+  m_mapBufferRange = nullptr;
+  m_unmapBuffer    = nullptr;
+#else
+  m_mapBufferRange = [](GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) { return glMapBufferRange(target, offset, length, access); };
+  m_unmapBuffer    = [](GLenum target) { return glUnmapBuffer(target); };
+#endif
+  m_fenceSync      = [](GLenum condition, GLbitfield flags) { return glFenceSync(condition, flags); };
+  m_clientWaitSync = [](GLsync sync, GLbitfield flags, GLuint64 timeout) { return glClientWaitSync(sync, flags, timeout); };
+  m_deleteSync     = [](GLsync sync) { glDeleteSync(sync); };
+  m_bindTexture    = [](GLenum target, GLuint texture) { glBindTexture(target, texture); };
+  m_pixelStorei    = [](GLenum pname, GLint param) { glPixelStorei(pname, param); };
+  m_texImage2D     = [](GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels)
+                     { glTexImage2D(target, level, internalformat, width, height, border, format, type, pixels); };
+  m_texImage3D     = [](GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels)
+                     { glTexImage3D(target, level, internalformat, width, height, depth, border, format, type, pixels); };
+  m_texSubImage2D  = [](GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum type, const void *pixels)
+                     { glTexSubImage2D(target, level, xoffset, yoffset, width, height, format, type, pixels); };
+  m_texSubImage3D  = [](GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void *pixels)
+                     { glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, type, pixels); };
+  m_compressedTexImage2D    = [](GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint border, GLsizei imageSize, const void *data)
+                              { glCompressedTexImage2D(target, level, internalformat, width, height, border, imageSize, data); };
+  m_compressedTexImage3D    = [](GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLsizei imageSize, const void *data)
+                              { glCompressedTexImage3D(target, level, internalformat, width, height, depth, border, imageSize, data); };
+  m_compressedTexSubImage2D = [](GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLsizei imageSize, const void *data)
+                              { glCompressedTexSubImage2D(target, level, xoffset, yoffset, width, height, format, imageSize, data); };
+  m_compressedTexSubImage3D = [](GLenum target, GLint level, GLint xoffset, GLint yoffset, GLint zoffset, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLsizei imageSize, const void *data)
+                              { glCompressedTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height, depth, format, imageSize, data); };
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureUploader::init(const std::size_t slotByteSize, const unsigned slotCount, const s_GLBackend &backend)
+{
+  TRE_ASSERT(m_slots.empty());
+  TRE_ASSERT(slotCount >= 2);
+  TRE_ASSERT(slotByteSize >= k_chunkAlignment);
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_backend = backend;
+  m_slotByteSize = slotByteSize;
+  m_slotFilled = 0;
+  m_ticketNext = 1;
+  m_ticketDone = 0;
+  m_stats = s_stats();
+
+  std::vector<GLuint> pbos(slotCount);
+  m_backend.m_genBuffers(GLsizei(slotCount), pbos.data());
+
+  m_slots.resize(slotCount);
+  for (unsigned iSlot = 0; iSlot < slotCount; ++iSlot)
+  {
+    s_slot &slot = m_slots[iSlot];
+    slot.m_pbo = pbos[iSlot];
+    m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_pbo);
+    m_backend.m_bufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(m_slotByteSize), nullptr, GL_STREAM_DRAW);
+    if (m_backend.m_mapBufferRange == nullptr) slot.m_cpuCopy.resize(m_slotByteSize);
+    _map(slot);
+  }
+  m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  for (const s_slot &slot : m_slots)
+  {
+    if (slot.m_state != SLOT_MAPPED)
+    {
+      TRE_LOG("textureUploader::init: failed to map the pixel-buffers");
+      return false;
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureUploader::clear()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  for (s_slot &slot : m_slots)
+  {
+    TRE_ASSERT(slot.m_writers == 0);
+    if (slot.m_state == SLOT_MAPPED)
+    {
+      m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_pbo);
+      if (m_backend.m_unmapBuffer != nullptr) m_backend.m_unmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    if (slot.m_fence != nullptr) m_backend.m_deleteSync(slot.m_fence);
+    m_backend.m_deleteBuffers(1, &slot.m_pbo);
+  }
+  if (!m_slots.empty()) m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  m_slots.clear();
+  m_chunks.clear();
+  m_slotByteSize = 0;
+  m_roomCV.notify_all(); // the waiting requests are dropped
+}
+
+//-----------------------------------------------------------------------------
+
+uint64_t textureUploader::push(const s_request &request, const void *pixels, const std::size_t byteSize, const bool wait)
+{
+  TRE_ASSERT(pixels != nullptr && byteSize != 0);
+  TRE_ASSERT(request.m_texture != 0 && request.m_w > 0 && request.m_h > 0 && request.m_d > 0);
+#ifndef TRE_WITH_THREADS
+  const bool doWait = false; // nobody would make the room
+#else
+  const bool doWait = wait;
+#endif
+
+  const uint8_t *src = reinterpret_cast<const uint8_t*>(pixels);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  if (m_slots.empty()) return 0;
+
+  // split into bands of rows (blocks of 4 rows for compressed pixels)
+
+  std::vector<s_chunk> bands;
+
+  if (byteSize <= m_slotByteSize)
+  {
+    bands.push_back(s_chunk{ request, 0, 0, byteSize });
+  }
+  else
+  {
+    const GLsizei rowPerBlock = (request.m_type == GL_NONE) ? 4 : 1;
+    const GLsizei blockRowCount = (request.m_h + rowPerBlock - 1) / rowPerBlock;
+    const std::size_t blockRowByteSize = byteSize / std::size_t(blockRowCount);
+    if (request.m_internalFormat != 0 || request.m_d != 1 || blockRowByteSize > m_slotByteSize)
+    {
+      TRE_LOG("textureUploader::push: the request (" << byteSize << " bytes) cannot be split to fit into the pixel-buffers (" << m_slotByteSize << " bytes)");
+      ++m_stats.m_rejectCount;
+      return 0;
+    }
+    TRE_ASSERT(blockRowByteSize * std::size_t(blockRowCount) == byteSize);
+    const GLsizei bandBlockRowCount = GLsizei(m_slotByteSize / blockRowByteSize);
+    for (GLsizei iBlockRow = 0; iBlockRow < blockRowCount; iBlockRow += bandBlockRowCount)
+    {
+      const GLsizei curBlockRowCount = std::min(bandBlockRowCount, blockRowCount - iBlockRow);
+      s_chunk band{ request, 0, 0, std::size_t(curBlockRowCount) * blockRowByteSize };
+      band.m_request.m_y = request.m_y + iBlockRow * rowPerBlock;
+      band.m_request.m_h = std::min(curBlockRowCount * rowPerBlock, request.m_h - iBlockRow * rowPerBlock);
+      bands.push_back(band);
+    }
+  }
+
+  // reserve the room and copy the pixels
+
+  uint64_t ticket = 0;
+
+  if (!doWait)
+  {
+    // all the bands, or nothing
+    s_cursor cursor = { m_slotFilled, m_slots[m_slotFilled].m_used };
+    for (s_chunk &band : bands)
+    {
+      if (!_advance(cursor, band.m_byteSize, band.m_offset))
+      {
+        ++m_stats.m_rejectCount;
+        return 0;
+      }
+    }
+    for (s_chunk &band : bands)
+    {
+      const bool isReserved = _reserve(band);
+      TRE_ASSERT(isReserved);
+      (void)isReserved;
+      m_chunks.push_back(band);
+    }
+    ticket = m_ticketNext++;
+    m_slots[bands.back().m_slot].m_ticketDone = ticket;
+    ++m_stats.m_pushCount;
+
+    lock.unlock();
+    std::size_t srcOffset = 0;
+    for (const s_chunk &band : bands)
+    {
+      memcpy(m_slots[band.m_slot].m_ptr + band.m_offset, src + srcOffset, band.m_byteSize);
+      srcOffset += band.m_byteSize;
+    }
+    lock.lock();
+    for (const s_chunk &band : bands) --m_slots[band.m_slot].m_writers;
+  }
+  else
+  {
+    // band per band: a band is copied before waiting for the room of the next one
+    std::size_t srcOffset = 0;
+    for (std::size_t iBand = 0; iBand < bands.size(); ++iBand)
+    {
+      s_chunk &band = bands[iBand];
+      m_roomCV.wait(lock, [&] { return m_slots.empty() || _reserve(band); });
+      if (m_slots.empty()) return 0; // cleared
+      m_chunks.push_back(band);
+      if (iBand + 1 == bands.size())
+      {
+        ticket = m_ticketNext++;
+        m_slots[band.m_slot].m_ticketDone = ticket;
+        ++m_stats.m_pushCount;
+      }
+
+      uint8_t *dst = m_slots[band.m_slot].m_ptr + band.m_offset;
+      lock.unlock();
+      memcpy(dst, src + srcOffset, band.m_byteSize);
+      lock.lock();
+      --m_slots[band.m_slot].m_writers;
+      srcOffset += band.m_byteSize;
+    }
+  }
+
+  return ticket;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureUploader::process(const std::size_t budgetInBytes)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  if (m_slots.empty()) return;
+
+  // recycle the pixel-buffers consumed by the GPU
+
+  bool hasNewRoom = false;
+
+  for (s_slot &slot : m_slots)
+  {
+    if (slot.m_state != SLOT_INFLIGHT) continue;
+    const GLenum status = m_backend.m_clientWaitSync(slot.m_fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+    m_backend.m_deleteSync(slot.m_fence);
+    slot.m_fence = nullptr;
+    m_ticketDone = std::max(m_ticketDone, slot.m_ticketDone);
+    slot.m_state = SLOT_FREE;
+  }
+
+  for (s_slot &slot : m_slots)
+  {
+    if (slot.m_state != SLOT_FREE) continue;
+    m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_pbo);
+    _map(slot);
+    hasNewRoom |= (slot.m_state == SLOT_MAPPED);
+  }
+
+  // issue the uploads, in the push order
+
+  m_backend.m_pixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  GLuint      boundPBO = 0;
+  GLenum      boundTarget = 0;
+  GLuint      boundTexture = 0;
+  std::size_t frameBytes = 0;
+
+  while (!m_chunks.empty())
+  {
+    const s_chunk &chunk = m_chunks.front();
+    s_slot        &slot = m_slots[chunk.m_slot];
+
+    if (slot.m_state == SLOT_MAPPED)
+    {
+      if (slot.m_writers != 0) break; // the pixels are being copied
+      m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_pbo);
+      boundPBO = slot.m_pbo;
+      _unmap(slot);
+    }
+    TRE_ASSERT(slot.m_state == SLOT_UPLOADING);
+
+    if (frameBytes != 0 && frameBytes + chunk.m_byteSize > budgetInBytes) break;
+
+    if (boundPBO != slot.m_pbo)
+    {
+      m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.m_pbo);
+      boundPBO = slot.m_pbo;
+    }
+    _upload(chunk, boundTarget, boundTexture);
+
+    frameBytes += chunk.m_byteSize;
+    ++m_stats.m_uploadCount;
+    m_stats.m_uploadBytes += chunk.m_byteSize;
+
+    if (--slot.m_chunks == 0)
+    {
+      slot.m_fence = m_backend.m_fenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      slot.m_state = SLOT_INFLIGHT;
+    }
+
+    m_chunks.pop_front();
+  }
+
+  m_stats.m_frameBytesMax = std::max(m_stats.m_frameBytesMax, frameBytes);
+
+  if (boundTarget != 0) m_backend.m_bindTexture(boundTarget, 0);
+  m_backend.m_bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  m_backend.m_pixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  if (hasNewRoom) m_roomCV.notify_all();
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureUploader::isComplete(const uint64_t ticket) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return ticket <= m_ticketDone;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureUploader::isIdle() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_ticketDone + 1 == m_ticketNext;
+}
+
+//-----------------------------------------------------------------------------
+
+textureUploader::s_stats textureUploader::stats() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_stats;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureUploader::_advance(s_cursor &cursor, const std::size_t byteSize, std::size_t &offset) const
+{
+  TRE_ASSERT(byteSize <= m_slotByteSize);
+
+  // in the filled slot
+  const s_slot &slot = m_slots[cursor.m_slot];
+  if (slot.m_state == SLOT_MAPPED && !slot.m_closed && _alignUp(cursor.m_used) + byteSize <= m_slotByteSize)
+  {
+    offset = _alignUp(cursor.m_used);
+    cursor.m_used = offset + byteSize;
+    return true;
+  }
+
+  // in the next mapped slot
+  for (unsigned iNext = 1; iNext < m_slots.size(); ++iNext)
+  {
+    const unsigned iSlot = (cursor.m_slot + iNext) % unsigned(m_slots.size());
+    const s_slot &slotNext = m_slots[iSlot];
+    if (slotNext.m_state == SLOT_MAPPED && !slotNext.m_closed)
+    {
+      TRE_ASSERT(slotNext.m_used == 0);
+      cursor.m_slot = iSlot;
+      cursor.m_used = byteSize;
+      offset = 0;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//-----------------------------------------------------------------------------
+
+bool textureUploader::_reserve(s_chunk &chunk)
+{
+  s_cursor cursor = { m_slotFilled, m_slots[m_slotFilled].m_used };
+  if (!_advance(cursor, chunk.m_byteSize, chunk.m_offset)) return false;
+
+  if (cursor.m_slot != m_slotFilled)
+  {
+    s_slot &slotPrev = m_slots[m_slotFilled];
+    if (slotPrev.m_state == SLOT_MAPPED && slotPrev.m_used != 0) slotPrev.m_closed = true;
+    m_slotFilled = cursor.m_slot;
+  }
+
+  s_slot &slot = m_slots[cursor.m_slot];
+  slot.m_used = cursor.m_used;
+  ++slot.m_writers;
+  ++slot.m_chunks;
+  chunk.m_slot = cursor.m_slot;
+  return true;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureUploader::_map(s_slot &slot)
+{
+  TRE_ASSERT(slot.m_state == SLOT_FREE);
+  if (m_backend.m_mapBufferRange != nullptr)
+  {
+    // the GPU has consumed the previous content (fence), so no synchronization is needed
+    slot.m_ptr = reinterpret_cast<uint8_t*>(m_backend.m_mapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(m_slotByteSize),
+                                                                      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+    if (slot.m_ptr == nullptr)
+    {
+      TRE_LOG("textureUploader: failed to map a pixel-buffer");
+      return;
+    }
+  }
+  else
+  {
+    slot.m_ptr = slot.m_cpuCopy.data();
+  }
+  slot.m_used = 0;
+  slot.m_closed = false;
+  slot.m_ticketDone = 0;
+  slot.m_state = SLOT_MAPPED;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureUploader::_unmap(s_slot &slot)
+{
+  TRE_ASSERT(slot.m_state == SLOT_MAPPED && slot.m_writers == 0);
+  if (m_backend.m_mapBufferRange != nullptr)
+  {
+    if (m_backend.m_unmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE)
+      TRE_LOG("textureUploader: the content of a pixel-buffer has been lost"); // the uploads will use undefined pixels
+  }
+  else
+  {
+    m_backend.m_bufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(slot.m_used), slot.m_ptr);
+  }
+  slot.m_ptr = nullptr;
+  slot.m_closed = true;
+  slot.m_state = SLOT_UPLOADING;
+}
+
+//-----------------------------------------------------------------------------
+
+void textureUploader::_upload(const s_chunk &chunk, GLenum &boundTarget, GLuint &boundTexture)
+{
+  const s_request &req = chunk.m_request;
+  const GLenum     bindTarget = _getBindTarget(req.m_target);
+
+  if (boundTarget != bindTarget || boundTexture != req.m_texture)
+  {
+    if (boundTarget != 0 && boundTarget != bindTarget) m_backend.m_bindTexture(boundTarget, 0);
+    m_backend.m_bindTexture(bindTarget, req.m_texture);
+    boundTarget = bindTarget;
+    boundTexture = req.m_texture;
+  }
+
+  const void     *offset = reinterpret_cast<const void*>(chunk.m_offset); // in the bound pixel-buffer
+  const GLsizei   byteSize = GLsizei(chunk.m_byteSize);
+  const bool      isCompressed = (req.m_type == GL_NONE);
+
+  if (req.m_internalFormat != 0)
+  {
+    if (_is3DTarget(req.m_target))
+    {
+      if (isCompressed) m_backend.m_compressedTexImage3D(req.m_target, req.m_level, req.m_internalFormat, req.m_w, req.m_h, req.m_d, 0, byteSize, offset);
+      else              m_backend.m_texImage3D(req.m_target, req.m_level, GLint(req.m_internalFormat), req.m_w, req.m_h, req.m_d, 0, req.m_format, req.m_type, offset);
+    }
+    else
+    {
+      if (isCompressed) m_backend.m_compressedTexImage2D(req.m_target, req.m_level, req.m_internalFormat, req.m_w, req.m_h, 0, byteSize, offset);
+      else              m_backend.m_texImage2D(req.m_target, req.m_level, GLint(req.m_internalFormat), req.m_w, req.m_h, 0, req.m_format, req.m_type, offset);
+    }
+  }
+  else
+  {
+    if (_is3DTarget(req.m_target))
+    {
+      if (isCompressed) m_backend.m_compressedTexSubImage3D(req.m_target, req.m_level, req.m_x, req.m_y, req.m_z, req.m_w, req.m_h, req.m_d, req.m_format, byteSize, offset);
+      else              m_backend.m_texSubImage3D(req.m_target, req.m_level, req.m_x, req.m_y, req.m_z, req.m_w, req.m_h, req.m_d, req.m_format, req.m_type, offset);
+    }
+    else
+    {
+      if (isCompressed) m_backend.m_compressedTexSubImage2D(req.m_target, req.m_level, req.m_x, req.m_y, req.m_w, req.m_h, req.m_format, byteSize, offset);
+      else              m_backend.m_texSubImage2D(req.m_target, req.m_level, req.m_x, req.m_y, req.m_w, req.m_h, req.m_format, req.m_type, offset);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+
+} // namespace
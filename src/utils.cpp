@@ -3,6 +3,14 @@
 #include "tre_model.h"
 #include "tre_shader.h"
 
+#if !defined(TRE_EMSCRIPTEN) || defined(__EMSCRIPTEN_PTHREADS__)
+#define TRE_WITH_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+
 namespace tre {
 
 // ============================================================================
@@ -598,4 +606,141 @@ void fft2D(glm::vec2 * __restrict data, const std::size_t n, const bool inverse,
 
 // ============================================================================
 
+#ifdef TRE_WITH_THREADS
+
+/// Thread-pool used by "parallelFor". The workers are created on the first call, and joined at exit.
+class s_threadPool
+{
+public:
+  static s_threadPool &get()
+  {
+    static s_threadPool pool;
+    return pool;
+  }
+
+  unsigned threadCount() const { return unsigned(m_workers.size()) + 1; }
+
+  bool run(std::size_t count, std::size_t grain, const std::function<void(std::size_t, std::size_t)> &fnct)
+  {
+    if (m_workers.empty() || t_isWorker) return false;
+    std::unique_lock<std::mutex> lockCaller(m_mutexCaller, std::try_to_lock);
+    if (!lockCaller.owns_lock()) return false; // already busy
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_fnct = &fnct;
+      m_count = count;
+      m_grain = grain;
+      m_next = 0;
+      m_chunksLeft = (count + grain - 1) / grain;
+      ++m_jobId;
+    }
+    m_cvStart.notify_all();
+
+    _processChunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cvDone.wait(lock, [this] { return m_chunksLeft == 0; });
+    m_fnct = nullptr;
+    return true;
+  }
+
+private:
+  s_threadPool()
+  {
+    const unsigned nThreads = std::thread::hardware_concurrency();
+    for (unsigned i = 1; i < nThreads; ++i)
+      m_workers.emplace_back(&s_threadPool::_workerLoop, this);
+  }
+
+  ~s_threadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_quit = true;
+    }
+    m_cvStart.notify_all();
+    for (std::thread &w : m_workers) w.join();
+  }
+
+  void _workerLoop()
+  {
+    t_isWorker = true;
+    std::size_t lastJobId = 0;
+    while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cvStart.wait(lock, [this, lastJobId] { return m_quit || (m_jobId != lastJobId && m_fnct != nullptr); });
+        if (m_quit) return;
+        lastJobId = m_jobId;
+      }
+      _processChunks();
+    }
+  }
+
+  void _processChunks()
+  {
+    std::size_t nDone = 0;
+    while (true)
+    {
+      const std::size_t iBegin = m_next.fetch_add(m_grain);
+      if (iBegin >= m_count) break;
+      (*m_fnct)(iBegin, std::min(iBegin + m_grain, m_count));
+      ++nDone;
+    }
+    if (nDone != 0)
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_chunksLeft -= nDone;
+      if (m_chunksLeft == 0) m_cvDone.notify_all();
+    }
+  }
+
+  std::vector<std::thread>  m_workers;
+  std::mutex                m_mutexCaller;
+  std::mutex                m_mutex;
+  std::condition_variable   m_cvStart;
+  std::condition_variable   m_cvDone;
+  const std::function<void(std::size_t, std::size_t)> *m_fnct = nullptr;
+  std::size_t               m_count = 0;
+  std::size_t               m_grain = 1;
+  std::atomic<std::size_t>  m_next = { 0 };
+  std::size_t               m_chunksLeft = 0;
+  std::size_t               m_jobId = 0;
+  bool                      m_quit = false;
+
+  static thread_local bool  t_isWorker;
+};
+
+thread_local bool s_threadPool::t_isWorker = false;
+
+#endif // TRE_WITH_THREADS
+
+// ----------------------------------------------------------------------------
+
+void parallelFor(std::size_t count, std::size_t grain, const std::function<void(std::size_t iBegin, std::size_t iEnd)> &fnct)
+{
+  TRE_ASSERT(grain != 0);
+  if (count == 0) return;
+#ifdef TRE_WITH_THREADS
+  if (count > grain && s_threadPool::get().run(count, grain, fnct)) return;
+#endif
+  for (std::size_t iBegin = 0; iBegin < count; iBegin += grain)
+    fnct(iBegin, std::min(iBegin + grain, count));
+}
+
+// ----------------------------------------------------------------------------
+
+unsigned parallelThreadCount()
+{
+#ifdef TRE_WITH_THREADS
+  return s_threadPool::get().threadCount();
+#else
+  return 1;
+#endif
+}
+
+// ============================================================================
+
 } // namespace
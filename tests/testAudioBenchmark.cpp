@@ -0,0 +1,955 @@
+#include "tre_utils.h"
+#include "tre_audio.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if !defined(_WIN32) && !defined(TRE_EMSCRIPTEN)
+#include <fcntl.h>
+#include <unistd.h> // sysconf, fsync (the mapped stream)
+#endif
+
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
+// =============================================================================
+
+static const int      k_freq = 44100;
+static const unsigned k_bufferSamples = 256; ///< samples per audio-callback (5.8 ms at 44.1 kHz)
+
+/// Create a mono 16-bit raw sound (a sine if "period" is not zero, a constant otherwise).
+static void createRawSound(tre::soundData::s_RawSDL &data, unsigned sampleCount, unsigned period, int16_t amplitude)
+{
+  std::vector<int16_t> pcm(sampleCount);
+  for (unsigned i = 0; i < sampleCount; ++i)
+    pcm[i] = (period == 0) ? amplitude : int16_t(amplitude * std::sin(6.2831853f * float(i % period) / float(period)));
+  data.loadFromSDLAudio(sampleCount, k_freq, AUDIO_S16, false, reinterpret_cast<uint8_t*>(pcm.data()));
+}
+
+// =============================================================================
+
+static bool testSlots()
+{
+  bool status = true;
+
+  tre::soundData::s_RawSDL dataDC;
+  createRawSound(dataDC, 4096, 0, 0x4000);
+
+  tre::audioContext ctx;
+  status &= ctx.startOffline(k_freq, k_bufferSamples);
+
+  std::vector<std::unique_ptr<tre::sound2D>> sounds(tre::audioContext::k_soundSlotCount + 1);
+  for (std::unique_ptr<tre::sound2D> &s : sounds)
+  {
+    s.reset(new tre::sound2D);
+    s->setAudioData(&dataDC);
+  }
+
+  // fill all the slots
+
+  for (unsigned i = 0; i < tre::audioContext::k_soundSlotCount; ++i)
+    status &= ctx.addSound(sounds[i].get());
+  status &= ctx.addSound(sounds[0].get()); // already added
+  status &= !ctx.addSound(sounds.back().get()); // no free slot
+
+  // the removed sound is released once the audio-thread has processed the command
+
+  ctx.removeSound(sounds[0].get());
+  status &= !ctx.isReleased(sounds[0].get());
+  ctx.updateSystem();
+  status &= !ctx.isReleased(sounds[0].get());
+
+  std::vector<int16_t> out(2 * k_bufferSamples);
+  ctx.renderOffline(out.data(), k_bufferSamples);
+  status &= !ctx.isReleased(sounds[0].get());
+  ctx.updateSystem();
+  status &= ctx.isReleased(sounds[0].get());
+  status &= ctx.addSound(sounds.back().get()); // the slot is free again
+
+  // play one sound: the control is sent on "updateSystem"
+
+  for (unsigned i = 1; i < tre::audioContext::k_soundSlotCount; ++i)
+    ctx.removeSound(sounds[i].get());
+
+  tre::sound2D &sPlay = *sounds.back();
+  sPlay.control().m_isPlaying = true;
+  sPlay.control().m_isRepeating = true;
+  sPlay.control().setTarget(tre::soundSampler::s_stereoControl(1.f, 0.f));
+  ctx.updateSystem();
+
+  ctx.renderOffline(out.data(), k_bufferSamples); // gain ramp
+  ctx.renderOffline(out.data(), k_bufferSamples);
+  ctx.updateSystem();
+  status &= (sPlay.feedback().m_playedSampleCount == 2 * k_bufferSamples);
+  status &= (sPlay.feedback().m_playedLevelRMS > 0.25f && sPlay.feedback().m_playedLevelRMS < 0.5f);
+
+  ctx.renderOffline(out.data(), k_bufferSamples);
+  ctx.updateSystem();
+
+  int maxErr = 0;
+  for (int16_t v : out) maxErr = std::max(maxErr, std::abs(int(v) - 0x4000));
+  status &= (maxErr <= 2);
+  status &= (sPlay.feedback().m_playedSampleCount == k_bufferSamples);
+  status &= (std::abs(sPlay.feedback().m_playedLevelRMS - 0.5f) < 1.e-3f);
+  for (unsigned i = 0; i < tre::audioContext::k_soundSlotCount; ++i)
+    status &= ctx.isReleased(sounds[i].get());
+
+  // the removal is acknowledged when the system stops
+
+  ctx.removeSound(sounds.back().get());
+  ctx.stopSystem();
+  status &= ctx.isReleased(sounds.back().get());
+
+  TRE_LOG("Slots: " << tre::audioContext::k_soundSlotCount << " slots, mixed-output error = " << maxErr);
+  if (!status) TRE_LOG("Slots: FAILED");
+  return status;
+}
+
+// =============================================================================
+
+static bool testStress()
+{
+  bool status = true;
+
+  std::array<tre::soundData::s_RawSDL, 4> datas;
+  for (unsigned i = 0; i < datas.size(); ++i)
+    createRawSound(datas[i], 2048 + 1500 * i, 50 + 30 * i, 0x0400);
+
+  tre::audioContext ctx;
+  status &= ctx.startOffline(k_freq, k_bufferSamples);
+
+  // The audio-thread renders the callbacks back-to-back (faster than real-time),
+  // while the game-thread adds, updates and removes sounds, and frees them once released.
+
+  std::atomic<bool> audioStop(false);
+  unsigned          audioCallCount = 0;
+  float             audioMaxMs = 0.f;
+  double            audioSumMs = 0.;
+  int               audioPeak = 0;
+
+  std::thread audioThread([&]()
+  {
+    std::vector<int16_t> out(2 * k_bufferSamples);
+    while (!audioStop.load())
+    {
+      const systemtick tCall = systemclock::now();
+      ctx.renderOffline(out.data(), k_bufferSamples);
+      const float tMs = _elapsedMs(tCall);
+      audioMaxMs = std::max(audioMaxMs, tMs);
+      audioSumMs += tMs;
+      ++audioCallCount;
+      for (int16_t v : out) audioPeak = std::max(audioPeak, std::abs(int(v)));
+    }
+  });
+
+  const unsigned frameCount = 3000;
+  const unsigned targetCount = 200; // active sounds
+
+  std::mt19937 rng(5);
+  std::vector<std::unique_ptr<tre::sound2D>> active;
+  std::vector<std::unique_ptr<tre::sound2D>> releasing;
+  std::size_t nAdd = 0, nRemove = 0, nFree = 0, nAddFailed = 0;
+  uint64_t    playedSamples = 0;
+  float       updateMaxMs = 0.f;
+
+  const systemtick tStart = systemclock::now();
+
+  for (unsigned iF = 0; iF < frameCount; ++iF)
+  {
+    // add
+    const unsigned addCount = (active.size() < targetCount) ? 1 + rng() % 16 : rng() % 4;
+    for (unsigned k = 0; k < addCount; ++k)
+    {
+      std::unique_ptr<tre::sound2D> s(new tre::sound2D);
+      s->setAudioData(&datas[rng() % datas.size()]);
+      s->control().m_isPlaying = true;
+      s->control().m_isRepeating = (rng() % 2) == 0;
+      s->control().setTarget(tre::soundSampler::s_stereoControl(0.1f, 0.f), 0.05f);
+      if (ctx.addSound(s.get())) { active.push_back(std::move(s)); ++nAdd; }
+      else                       { ++nAddFailed; }
+    }
+
+    // change the controls
+    for (std::unique_ptr<tre::sound2D> &s : active)
+    {
+      const unsigned r = rng() % 64;
+      if      (r == 0) s->control().setCursor(rng() % 1024);
+      else if (r == 1) s->control().setTarget(tre::soundSampler::s_stereoControl(0.1f * float(rng() % 8) / 8.f, float(int(rng() % 3) - 1)), 0.02f);
+      else if (r == 2) s->control().m_isPlaying = !s->control().m_isPlaying;
+    }
+
+    // remove
+    const unsigned removeCount = (active.size() > targetCount) ? 1 + rng() % 16 : rng() % 4;
+    for (unsigned k = 0; k < removeCount && !active.empty(); ++k)
+    {
+      const std::size_t idx = rng() % active.size();
+      ctx.removeSound(active[idx].get());
+      releasing.push_back(std::move(active[idx]));
+      active[idx] = std::move(active.back());
+      active.pop_back();
+      ++nRemove;
+    }
+
+    const systemtick tUpdate = systemclock::now();
+    ctx.updateSystem();
+    updateMaxMs = std::max(updateMaxMs, _elapsedMs(tUpdate));
+
+    for (std::unique_ptr<tre::sound2D> &s : active)
+      playedSamples += s->feedback().m_playedSampleCount;
+
+    // free the released sounds
+    for (std::size_t idx = 0; idx < releasing.size(); )
+    {
+      if (ctx.isReleased(releasing[idx].get()))
+      {
+        releasing[idx] = std::move(releasing.back());
+        releasing.pop_back();
+        ++nFree;
+      }
+      else
+      {
+        ++idx;
+      }
+    }
+
+    if (iF % 4 == 0) std::this_thread::yield();
+  }
+
+  // remove all, and wait for the release
+
+  for (std::unique_ptr<tre::sound2D> &s : active)
+  {
+    ctx.removeSound(s.get());
+    releasing.push_back(std::move(s));
+    ++nRemove;
+  }
+  active.clear();
+
+  const systemtick tDrain = systemclock::now();
+  while (!releasing.empty() && _elapsedMs(tDrain) < 5000.f)
+  {
+    ctx.updateSystem();
+    for (std::size_t idx = 0; idx < releasing.size(); )
+    {
+      if (ctx.isReleased(releasing[idx].get())) { releasing[idx] = std::move(releasing.back()); releasing.pop_back(); ++nFree; }
+      else                                      { ++idx; }
+    }
+    std::this_thread::yield();
+  }
+
+  audioStop.store(true);
+  audioThread.join();
+  ctx.stopSystem();
+
+  const float elapsed = _elapsedMs(tStart);
+  const float budgetMs = 1.e3f * float(k_bufferSamples) / float(k_freq);
+  const float audioAvgMs = (audioCallCount != 0) ? float(audioSumMs / audioCallCount) : 0.f;
+
+  TRE_LOG("Stress: " << frameCount << " frames, " << nAdd << " adds (" << nAddFailed << " without free slot), " << nRemove << " removes, " << nFree << " frees, in " << elapsed << " ms");
+  TRE_LOG("Stress: audio-callback: " << audioCallCount << " calls, avg = " << audioAvgMs << " ms, worst = " << audioMaxMs << " ms (budget = " << budgetMs << " ms), peak = " << audioPeak);
+  TRE_LOG("Stress: updateSystem: worst = " << updateMaxMs << " ms, played-samples = " << playedSamples);
+
+  status &= (nAdd == nRemove && nRemove == nFree && releasing.empty());
+  status &= (audioCallCount != 0 && playedSamples != 0 && audioPeak != 0);
+  if (std::thread::hardware_concurrency() > 1) status &= (audioMaxMs < budgetMs); // with a single core, the audio-thread is preempted by the game-thread
+
+  if (!status) TRE_LOG("Stress: FAILED");
+  return status;
+}
+
+// =============================================================================
+// Reference of the sampling: scalar linear interpolation, with the mix of the controls on each sample.
+
+struct s_refSamplerRaw
+{
+  float m_cursor = 0.f;
+  bool  m_repet = false;
+  float m_valuePeak = 0.f;
+  float m_valueRMS = 0.f;
+
+  template<class _controls, typename _rawType>
+  void sample(const tre::soundData::s_RawSDL &data, const _controls &controlsStart, const _controls &controlsEnd,
+              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+  {
+    const float                 freqRatio = float(data.m_freq) / float(sampleFreq);
+    const unsigned              dataSampleCount = data.m_nSamples;
+    const int                   dataSampleCountM2 = int(dataSampleCount) - 2;
+    const _rawType * __restrict dataRawTyped = reinterpret_cast<const _rawType*>(data.m_rawData.data());
+    const unsigned              nc = data.m_stereo ? 2 : 1;
+    unsigned                    curSample = 0;
+    const float                 invSampleCountM1 = 1.f / (sampleCount - 1);
+    static const float          valueNormalizer = 1.f / float(std::numeric_limits<_rawType>::max());
+
+    if (m_repet)
+    {
+      while (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
+    }
+
+    m_valuePeak = 0.f;
+    m_valueRMS = 0.f;
+
+    while (m_cursor < dataSampleCount && curSample < sampleCount)
+    {
+      unsigned isample = 0;
+      float    localCursor = m_cursor;
+      while (localCursor < dataSampleCount && curSample < sampleCount)
+      {
+        const int localCursorInt = std::min(int(localCursor), dataSampleCountM2);
+        const float valueL_0 = float(dataRawTyped[nc * localCursorInt + 0]) * valueNormalizer;
+        const float valueR_0 = float(dataRawTyped[nc * localCursorInt + nc - 1]) * valueNormalizer;
+        const float valueL_1 = float(dataRawTyped[nc * localCursorInt + nc]) * valueNormalizer;
+        const float valueR_1 = float(dataRawTyped[nc * localCursorInt + 2 * nc - 1]) * valueNormalizer;
+        const float w_1 = localCursor - localCursorInt;
+        const float w_0 = 1.f - w_1;
+        float valueL = w_0 * valueL_0 + w_1 * valueL_1;
+        float valueR = w_0 * valueR_0 + w_1 * valueR_1;
+        _controls::mix(controlsStart, controlsEnd, curSample * invSampleCountM1).apply(valueL, valueR);
+        ++curSample;
+        *outBufferAdd++ += valueL;
+        *outBufferAdd++ += valueR;
+        m_valuePeak = std::max(m_valuePeak, std::max(std::abs(valueL), std::abs(valueR)));
+        m_valueRMS += 0.5f * (valueL * valueL + valueR * valueR);
+        localCursor = m_cursor + (++isample) * freqRatio;
+      }
+      m_cursor = localCursor;
+
+      if (m_repet)
+      {
+        if (m_cursor >= dataSampleCount) m_cursor -= dataSampleCount;
+      }
+    }
+
+    m_valueRMS = std::sqrt(m_valueRMS / sampleCount);
+  }
+
+  template<class _controls>
+  void sample(const tre::soundData::s_RawSDL &data, const _controls &controlsStart, const _controls &controlsEnd,
+              float * __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
+  {
+    if (data.m_format == AUDIO_S16) sample<_controls, int16_t>(data, controlsStart, controlsEnd, outBufferAdd, sampleCount, sampleFreq);
+    else                            sample<_controls, int32_t>(data, controlsStart, controlsEnd, outBufferAdd, sampleCount, sampleFreq);
+  }
+};
+
+/// Create a raw sound (sum of 2 sines and noise), at the given frequency and format.
+static void createRawSignal(tre::soundData::s_RawSDL &data, unsigned sampleCount, int freq, bool stereo, bool s32, unsigned seed)
+{
+  std::mt19937                          rng(seed);
+  std::uniform_real_distribution<float> noise(-0.1f, 0.1f);
+  const unsigned                        nc = stereo ? 2 : 1;
+  std::vector<int32_t>                  pcm32(sampleCount * nc);
+  std::vector<int16_t>                  pcm16(sampleCount * nc);
+  for (unsigned i = 0; i < sampleCount * nc; ++i)
+  {
+    const float t = float(i / nc) / float(freq);
+    const float v = 0.5f * std::sin(6.2831853f * 440.f * t + float(i % nc)) + 0.3f * std::sin(6.2831853f * 3150.f * t) + noise(rng);
+    pcm32[i] = int32_t(double(v) * 2147483647.);
+    pcm16[i] = int16_t(v * 32767.f);
+  }
+  if (s32) data.loadFromSDLAudio(sampleCount, freq, AUDIO_S32, stereo, reinterpret_cast<uint8_t*>(pcm32.data()));
+  else     data.loadFromSDLAudio(sampleCount, freq, AUDIO_S16, stereo, reinterpret_cast<uint8_t*>(pcm16.data()));
+}
+
+// =============================================================================
+
+static bool testMixAccuracy()
+{
+  bool status = true;
+
+  typedef tre::soundSampler::s_stereoControl s_ctrl;
+  const std::array<std::pair<s_ctrl, s_ctrl>, 4> controls = { std::make_pair(s_ctrl(0.8f,  0.2f), s_ctrl(0.8f,  0.2f)),  // constant
+                                                              std::make_pair(s_ctrl(0.1f, -0.3f), s_ctrl(0.9f, -0.3f)),  // volume ramp
+                                                              std::make_pair(s_ctrl(0.7f, -0.6f), s_ctrl(0.7f,  0.8f)),  // pan ramp, crossing the center
+                                                              std::make_pair(s_ctrl(0.2f, -0.5f), s_ctrl(1.0f,  0.5f)) }; // volume and pan ramps
+  const std::array<int, 4> freqs = { k_freq, 22050, 48000, 31000 };
+  const unsigned           callSamples = 1001; // not aligned on the block size, nor on the SIMD width
+
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> base(-0.5f, 0.5f);
+
+  float    maxErr = 0.f, maxErrLevel = 0.f;
+  unsigned caseCount = 0, cursorMismatch = 0;
+
+  for (unsigned fmt = 0; fmt < 4; ++fmt)
+  {
+    const bool stereo = (fmt & 1) != 0;
+    const bool s32 = (fmt & 2) != 0;
+    for (const int freq : freqs)
+    {
+      tre::soundData::s_RawSDL data;
+      createRawSignal(data, 1500 + 37 * fmt, freq, stereo, s32, fmt);
+
+      for (const std::pair<s_ctrl, s_ctrl> &ctrl : controls)
+      {
+        for (const bool repet : { false, true })
+        {
+          tre::soundSampler::s_sampler_Raw sampler;
+          s_refSamplerRaw                  ref;
+          sampler.m_repet = ref.m_repet = repet;
+          sampler.m_cursor = ref.m_cursor = 3.25f;
+
+          std::vector<float> outNew(2 * callSamples), outRef(2 * callSamples);
+          for (unsigned icall = 0; icall < 6; ++icall)
+          {
+            for (std::size_t i = 0; i < outNew.size(); ++i) outNew[i] = outRef[i] = base(rng);
+            sampler.sample(data, ctrl.first, ctrl.second, outNew.data(), callSamples, k_freq);
+            ref.sample(data, ctrl.first, ctrl.second, outRef.data(), callSamples, k_freq);
+            for (std::size_t i = 0; i < outNew.size(); ++i) maxErr = std::max(maxErr, std::abs(outNew[i] - outRef[i]));
+            maxErrLevel = std::max(maxErrLevel, std::abs(sampler.m_valuePeak - ref.m_valuePeak));
+            maxErrLevel = std::max(maxErrLevel, std::abs(sampler.m_valueRMS - ref.m_valueRMS));
+            if (sampler.m_cursor != ref.m_cursor) ++cursorMismatch;
+          }
+          ++caseCount;
+        }
+      }
+    }
+  }
+
+  TRE_LOG("MixAccuracy: " << caseCount << " cases, max error = " << maxErr << " (levels: " << maxErrLevel << "), cursor mismatch = " << cursorMismatch);
+  status &= (maxErr < 1.e-5f && maxErrLevel < 1.e-5f && cursorMismatch == 0);
+
+  if (!status) TRE_LOG("MixAccuracy: FAILED");
+  return status;
+}
+
+// =============================================================================
+
+static bool testMixThroughput()
+{
+  bool status = true;
+
+  const unsigned voiceCount = 128;
+  const unsigned callSamples = 1024;
+  const unsigned callCount = 200;
+
+  std::array<tre::soundData::s_RawSDL, 4> datas;
+  createRawSignal(datas[0], k_freq, k_freq, false, false, 1);
+  createRawSignal(datas[1], 48000, 48000, true, false, 2);
+  createRawSignal(datas[2], 22050, 22050, false, false, 3);
+  createRawSignal(datas[3], 32000, 32000, true, true, 4);
+
+  typedef tre::soundSampler::s_stereoControl s_ctrl;
+  std::vector<tre::soundSampler::s_sampler_Raw> samplers(voiceCount);
+  std::vector<s_refSamplerRaw>                  refs(voiceCount);
+  std::vector<s_ctrl>                           ctrls(voiceCount);
+  for (unsigned iv = 0; iv < voiceCount; ++iv)
+  {
+    samplers[iv].m_repet = refs[iv].m_repet = true;
+    samplers[iv].m_cursor = refs[iv].m_cursor = float(iv * 97);
+    ctrls[iv] = s_ctrl(0.01f * float(iv % 16), float(int(iv % 5) - 2) * 0.3f);
+  }
+
+  std::vector<float> outNew(2 * callSamples), outRef(2 * callSamples);
+
+  const systemtick tRef = systemclock::now();
+  for (unsigned icall = 0; icall < callCount; ++icall)
+  {
+    std::fill(outRef.begin(), outRef.end(), 0.f);
+    for (unsigned iv = 0; iv < voiceCount; ++iv)
+      refs[iv].sample(datas[iv % datas.size()], ctrls[iv], ctrls[(iv + icall) % voiceCount], outRef.data(), callSamples, k_freq);
+  }
+  const float elapsedRef = _elapsedMs(tRef);
+
+  const systemtick tNew = systemclock::now();
+  for (unsigned icall = 0; icall < callCount; ++icall)
+  {
+    std::fill(outNew.begin(), outNew.end(), 0.f);
+    for (unsigned iv = 0; iv < voiceCount; ++iv)
+      samplers[iv].sample(datas[iv % datas.size()], ctrls[iv], ctrls[(iv + icall) % voiceCount], outNew.data(), callSamples, k_freq);
+  }
+  const float elapsedNew = _elapsedMs(tNew);
+
+  float maxErr = 0.f;
+  for (std::size_t i = 0; i < outNew.size(); ++i) maxErr = std::max(maxErr, std::abs(outNew[i] - outRef[i]));
+
+  const float voiceCalls = float(voiceCount * callCount);
+  TRE_LOG("MixThroughput: " << voiceCount << " voices, " << callCount << " callbacks of " << callSamples << " samples: per-sample path = " << voiceCalls / elapsedRef
+          << " voices/ms, block path = " << voiceCalls / elapsedNew << " voices/ms (x" << elapsedRef / elapsedNew << "), max error = " << maxErr);
+  status &= (maxErr < 1.e-4f); // sum of the voices
+
+  if (!status) TRE_LOG("MixThroughput: FAILED");
+  return status;
+}
+
+// =============================================================================
+
+/// Resample a sine with one sampler call, and return the output (left channel).
+static void _resampleSine(std::vector<float> &out, float &ratio, tre::soundSampler::e_interpolation interp, int dataFreq, float toneFreq, unsigned outCount)
+{
+  const float                 amplitude = 0.5f;
+  const unsigned              dataCount = unsigned(float(outCount) * float(dataFreq) / float(k_freq)) + 256;
+  std::vector<int32_t>        pcm(dataCount);
+  for (unsigned i = 0; i < dataCount; ++i)
+    pcm[i] = int32_t(double(amplitude) * std::sin(6.283185307179586 * double(toneFreq) * double(i) / double(dataFreq)) * 2147483647.);
+  tre::soundData::s_RawSDL data;
+  data.loadFromSDLAudio(dataCount, dataFreq, AUDIO_S32, false, reinterpret_cast<uint8_t*>(pcm.data()));
+
+  tre::soundSampler::s_sampler_Raw sampler;
+  sampler.m_cursor = 64.f;
+  sampler.m_interpolation = interp;
+  const tre::soundSampler::s_stereoControl ctrl(1.f, 0.f);
+  std::vector<float> outLR(2 * outCount, 0.f);
+  sampler.sample(data, ctrl, ctrl, outLR.data(), outCount, k_freq);
+
+  ratio = float(dataFreq) / float(k_freq);
+  out.resize(outCount);
+  for (unsigned i = 0; i < outCount; ++i) out[i] = outLR[2 * i];
+}
+
+/// Signal-to-noise ratio (dB) of the resampled sine, against the exact sine evaluated at the positions used by the sampler.
+static float _sineSNR(const std::vector<float> &out, float ratio, int dataFreq, float toneFreq)
+{
+  double sumSignal = 0., sumNoise = 0.;
+  for (unsigned i = 0; i < out.size(); ++i)
+  {
+    const float  pos = 64.f + float(i) * ratio;
+    const double expected = 0.5 * std::sin(6.283185307179586 * double(toneFreq) * double(pos) / double(dataFreq));
+    sumSignal += expected * expected;
+    sumNoise += (double(out[i]) - expected) * (double(out[i]) - expected);
+  }
+  return float(10. * std::log10(sumSignal / std::max(sumNoise, 1.e-30)));
+}
+
+/// Level (dB) of the output, relative to the level of the input sine.
+static float _sineLevel(const std::vector<float> &out)
+{
+  double sum = 0.;
+  for (const float v : out) sum += double(v) * double(v);
+  return float(10. * std::log10(std::max(sum / out.size(), 1.e-30) / (0.5 * 0.5 * 0.5)));
+}
+
+static bool testSincQuality()
+{
+  bool status = true;
+
+  const unsigned outCount = 512;
+  typedef tre::soundSampler::e_interpolation e_interp;
+
+  struct s_case { int dataFreq; float toneFreq; };
+  const s_case passCases[] = { { 32000, 5000.f }, { 32000, 11000.f }, { 44100, 12000.f }, { 48000, 10000.f }, { 66150, 8000.f }, { 110250, 8000.f } };
+  const s_case aliasCases[] = { { 48000, 23500.f }, { 66150, 28000.f }, { 110250, 40000.f }, { 441000, 100000.f } };
+
+  std::vector<float> out;
+  float              ratio;
+
+  for (const s_case &c : passCases) // the tone is under the Nyquist frequencies of the source and of the output
+  {
+    _resampleSine(out, ratio, e_interp::INTERP_LINEAR, c.dataFreq, c.toneFreq, outCount);
+    const float snrLinear = _sineSNR(out, ratio, c.dataFreq, c.toneFreq);
+    _resampleSine(out, ratio, e_interp::INTERP_SINC, c.dataFreq, c.toneFreq, outCount);
+    const float snrSinc = _sineSNR(out, ratio, c.dataFreq, c.toneFreq);
+    TRE_LOG("SincQuality: pass-band tone " << c.toneFreq << " Hz, ratio " << ratio << ": SNR linear = " << snrLinear << " dB, SNR sinc = " << snrSinc << " dB");
+    status &= (snrSinc > 60.f && (ratio == 1.f || snrSinc > snrLinear)); // without resampling, the linear interpolation is exact
+  }
+
+  for (const s_case &c : aliasCases) // the tone is above the Nyquist frequency of the output: it must be removed
+  {
+    _resampleSine(out, ratio, e_interp::INTERP_LINEAR, c.dataFreq, c.toneFreq, outCount);
+    const float levelLinear = _sineLevel(out);
+    _resampleSine(out, ratio, e_interp::INTERP_SINC, c.dataFreq, c.toneFreq, outCount);
+    const float levelSinc = _sineLevel(out);
+    TRE_LOG("SincQuality: alias tone " << c.toneFreq << " Hz, ratio " << ratio << ": level linear = " << levelLinear << " dB, level sinc = " << levelSinc << " dB");
+    if (ratio <= 16.f) status &= (levelSinc < -50.f);
+  }
+
+  // DC: the phases are normalized, the stretched filter too
+  for (const int dataFreq : { 32000, 44100, 48000, 110250 })
+  {
+    tre::soundData::s_RawSDL data;
+    createRawSound(data, 4096, 0, 16384);
+    data.m_freq = dataFreq;
+    tre::soundSampler::s_sampler_Raw sampler;
+    sampler.m_cursor = 100.f;
+    sampler.m_interpolation = e_interp::INTERP_SINC;
+    const tre::soundSampler::s_stereoControl ctrl(1.f, 0.f);
+    std::vector<float> outLR(2 * outCount, 0.f);
+    sampler.sample(data, ctrl, ctrl, outLR.data(), outCount, k_freq);
+    float maxErr = 0.f;
+    for (const float v : outLR) maxErr = std::max(maxErr, std::abs(v - 16384.f / 32767.f));
+    TRE_LOG("SincQuality: DC, ratio " << float(dataFreq) / float(k_freq) << ": max error = " << maxErr);
+    status &= (maxErr < 1.e-5f);
+  }
+
+  if (!status) TRE_LOG("SincQuality: FAILED");
+  return status;
+}
+
+// =============================================================================
+
+static bool testSincThroughput()
+{
+  bool status = true;
+
+  const unsigned voiceCount = 128;
+  const unsigned callSamples = 1024;
+  const unsigned callCount = 100;
+
+  std::array<tre::soundData::s_RawSDL, 4> datas;
+  createRawSignal(datas[0], k_freq, k_freq, false, false, 1);
+  createRawSignal(datas[1], 48000, 48000, true, false, 2);
+  createRawSignal(datas[2], 22050, 22050, false, false, 3);
+  createRawSignal(datas[3], 32000, 32000, true, true, 4);
+
+  typedef tre::soundSampler::s_stereoControl s_ctrl;
+  std::vector<float> out(2 * callSamples);
+  float              elapsed[2];
+  float              peak[2] = { 0.f, 0.f };
+
+  for (const tre::soundSampler::e_interpolation interp : { tre::soundSampler::INTERP_LINEAR, tre::soundSampler::INTERP_SINC })
+  {
+    std::vector<tre::soundSampler::s_sampler_Raw> samplers(voiceCount);
+    for (unsigned iv = 0; iv < voiceCount; ++iv)
+    {
+      samplers[iv].m_repet = true;
+      samplers[iv].m_cursor = float(iv * 97);
+      samplers[iv].m_interpolation = interp;
+    }
+
+    const systemtick tStart = systemclock::now();
+    for (unsigned icall = 0; icall < callCount; ++icall)
+    {
+      std::fill(out.begin(), out.end(), 0.f);
+      for (unsigned iv = 0; iv < voiceCount; ++iv)
+      {
+        const s_ctrl ctrl(0.01f * float(iv % 16), float(int(iv % 5) - 2) * 0.3f);
+        samplers[iv].sample(datas[iv % datas.size()], ctrl, ctrl, out.data(), callSamples, k_freq);
+        peak[interp] = std::max(peak[interp], samplers[iv].m_valuePeak);
+      }
+    }
+    elapsed[interp] = _elapsedMs(tStart);
+  }
+
+  const float voiceCalls = float(voiceCount * callCount);
+  const float callMs = 1000.f * float(callSamples) / float(k_freq);
+  TRE_LOG("SincThroughput: " << voiceCount << " voices, " << callCount << " callbacks of " << callSamples << " samples: linear = " << voiceCalls / elapsed[0]
+          << " voices/ms, sinc = " << voiceCalls / elapsed[1] << " voices/ms (" << voiceCalls / elapsed[1] * callMs << " voices in the " << callMs << " ms of a callback)");
+  status &= (peak[0] > 0.f && peak[1] > 0.f && std::abs(peak[1] - peak[0]) < 0.1f * peak[0]);
+
+  if (!status) TRE_LOG("SincThroughput: FAILED");
+  return status;
+}
+
+// =============================================================================
+
+static bool testDecodeAhead()
+{
+#ifdef TRE_WITH_OPUS
+  bool status = true;
+
+  std::array<tre::soundData::s_Opus, 3> datas;
+  for (unsigned i = 0; i < datas.size(); ++i)
+  {
+    tre::soundData::s_RawSDL raw;
+    createRawSignal(raw, 30000 + 41000 * i, tre::soundData::s_Opus::m_freq, i != 1, false, 10 + i);
+    status &= datas[i].loadFromRaw(raw, 96000);
+  }
+
+  const unsigned voiceCount = 12;
+  const unsigned callCount = 1500; // 8.7 s
+  const unsigned needAhead = unsigned(std::ceil(float(k_bufferSamples) * float(tre::soundData::s_Opus::m_freq) / float(k_freq))) + 2;
+
+  // The context "ctxInline" decodes in the audio-callback, the context "ctxAhead" uses a decoder worker.
+  // Both render the same controls. The output must be the same, when the worker is waited for.
+
+  tre::audioContext ctxInline, ctxAhead;
+  status &= ctxInline.startOffline(k_freq, k_bufferSamples);
+  status &= ctxAhead.startOffline(k_freq, k_bufferSamples);
+  const bool hasDecoders = ctxAhead.startDecoders(1);
+  status &= hasDecoders;
+
+  std::vector<std::unique_ptr<tre::sound2D>> soundsInline(voiceCount), soundsAhead(voiceCount);
+  for (unsigned iv = 0; iv < voiceCount; ++iv)
+  {
+    for (std::unique_ptr<tre::sound2D> *s : { &soundsInline[iv], &soundsAhead[iv] })
+    {
+      s->reset(new tre::sound2D);
+      (*s)->setAudioData(&datas[iv % datas.size()]);
+      (*s)->control().m_isPlaying = false; // the first callback pre-rolls
+      (*s)->control().m_isRepeating = (iv % 4) != 3;
+      (*s)->control().setCursor(iv * 4000);
+      (*s)->control().setTarget(tre::soundSampler::s_stereoControl(0.05f, float(int(iv % 3) - 1) * 0.5f));
+    }
+    status &= ctxInline.addSound(soundsInline[iv].get());
+    status &= ctxAhead.addSound(soundsAhead[iv].get());
+  }
+
+  std::mt19937 rng(3);
+  std::vector<int16_t> outInline(2 * k_bufferSamples), outAhead(2 * k_bufferSamples);
+  unsigned diffCount = 0, seekCount = 0, underrunCount = 0;
+  int      peak = 0;
+
+  for (unsigned icall = 0; icall < callCount; ++icall)
+  {
+    if (icall == 1)
+    {
+      for (unsigned iv = 0; iv < voiceCount; ++iv)
+      {
+        soundsInline[iv]->control().m_isPlaying = true;
+        soundsAhead[iv]->control().m_isPlaying = true;
+      }
+    }
+
+    // seek while paused (the worker pre-rolls the sound), then play again
+    for (unsigned iv = 0; iv < voiceCount && icall > 1; ++iv)
+    {
+      const unsigned r = rng() % 128;
+      const unsigned cursor = rng() % datas[iv % datas.size()].m_nSamples;
+      for (tre::sound2D *s : { soundsInline[iv].get(), soundsAhead[iv].get() })
+      {
+        if (r == 0 && s->control().m_isPlaying)
+        {
+          s->control().m_isPlaying = false;
+          s->control().setCursor(cursor);
+        }
+        else if (r < 8 && !s->control().m_isPlaying)
+        {
+          s->control().m_isPlaying = true;
+        }
+      }
+      seekCount += (r == 0);
+    }
+    ctxInline.updateSystem();
+    ctxAhead.updateSystem();
+    for (const std::unique_ptr<tre::sound2D> &s : soundsAhead) underrunCount += s->feedback().m_playedUnderrunCount;
+
+    // wait for the worker: the next callback must not underrun
+    for (const std::unique_ptr<tre::sound2D> &s : soundsAhead)
+      while (s->decodedAhead() < needAhead) std::this_thread::yield();
+
+    ctxInline.renderOffline(outInline.data(), k_bufferSamples);
+    ctxAhead.renderOffline(outAhead.data(), k_bufferSamples);
+    for (unsigned i = 0; i < outInline.size(); ++i)
+    {
+      diffCount += (outInline[i] != outAhead[i]);
+      peak = std::max(peak, std::abs(int(outInline[i])));
+    }
+  }
+
+  TRE_LOG("DecodeAhead: " << voiceCount << " voices, " << callCount << " callbacks, " << seekCount << " seeks: samples that differ = " << diffCount << ", underruns = " << underrunCount << ", peak = " << peak);
+  status &= (diffCount == 0 && underrunCount == 0 && peak > 0x0200);
+
+  // Without waiting for the worker, report the underruns: the callbacks are paced (real-time) or back-to-back.
+
+  for (const bool paced : { true, false })
+  {
+    for (unsigned iv = 0; iv < voiceCount; ++iv)
+    {
+      soundsAhead[iv]->control().m_isPlaying = true;
+      soundsAhead[iv]->control().setCursor(iv * 4000);
+    }
+    const unsigned runCount = paced ? 200 : callCount;
+    const auto     callPeriod = std::chrono::microseconds(1000000 * k_bufferSamples / k_freq);
+    unsigned       runUnderrunCount = 0;
+    systemtick     tCall = systemclock::now();
+    for (unsigned icall = 0; icall < runCount; ++icall)
+    {
+      ctxAhead.updateSystem();
+      for (const std::unique_ptr<tre::sound2D> &s : soundsAhead) runUnderrunCount += s->feedback().m_playedUnderrunCount;
+      ctxAhead.renderOffline(outAhead.data(), k_bufferSamples);
+      if (paced)
+      {
+        tCall += callPeriod;
+        std::this_thread::sleep_until(tCall);
+      }
+    }
+    TRE_LOG("DecodeAhead: " << (paced ? "paced" : "back-to-back") << " callbacks: " << runUnderrunCount << " underrun samples (over " << runCount * k_bufferSamples * voiceCount << ")");
+  }
+
+  ctxAhead.stopSystem();
+  ctxInline.stopSystem();
+
+  if (!status) TRE_LOG("DecodeAhead: FAILED");
+  return status;
+#else
+  TRE_LOG("DecodeAhead: skipped (the current build does not include OPUS)");
+  return true;
+#endif
+}
+
+// =============================================================================
+
+static bool testOpusStream()
+{
+#ifdef TRE_WITH_OPUS
+  bool status = true;
+
+  // Bake an Opus audio-data into a file, after other data (as in a baked archive).
+
+  const char    *filename = "testAudioStream.tmp";
+  const unsigned prefixSize = 1000;
+
+  tre::soundData::s_Opus dataMem;
+  {
+    tre::soundData::s_RawSDL raw;
+    createRawSignal(raw, 8 * tre::soundData::s_Opus::m_freq, tre::soundData::s_Opus::m_freq, true, false, 20);
+    status &= dataMem.loadFromRaw(raw, 96000);
+
+    std::ofstream file(filename, std::ofstream::binary);
+    const std::vector<char> prefix(prefixSize, 'x');
+    file.write(prefix.data(), prefix.size());
+    status &= dataMem.write(file);
+    status &= bool(file);
+  }
+
+  std::size_t dataSize = 0, blockSizeMax = 0;
+  for (const tre::soundData::s_Opus::s_block &b : dataMem.m_blokcs)
+  {
+    dataSize += b.m_data.size();
+    blockSizeMax = std::max(blockSizeMax, b.m_data.size());
+  }
+
+  const unsigned callCount = 3000; // 17 s: the sound loops twice
+  const unsigned needAhead = unsigned(std::ceil(float(k_bufferSamples) * float(tre::soundData::s_Opus::m_freq) / float(k_freq))) + 2;
+
+  // the written pages are synced, else the mapped stream cannot drop them from the page-cache before they are written back
+  std::size_t pageSize = 0;
+#if !defined(_WIN32) && !defined(TRE_EMSCRIPTEN)
+  pageSize = std::size_t(sysconf(_SC_PAGESIZE));
+  {
+    const int fd = open(filename, O_RDONLY);
+    status &= (fd >= 0 && fsync(fd) == 0);
+    if (fd >= 0) close(fd);
+  }
+#endif
+
+  // The stream is played with the same controls as the audio-data in memory: the output must be the same, when the stream is waited for.
+  // With inline decoding, the audio-callback (here, the test thread) is the reader of the stream. The sound is not seeked then
+  // (a seek decodes blocks that are not read yet, and the callback plays silence instead).
+
+  struct s_config
+  {
+    bool allowMapping;
+    bool decodeInline;
+  };
+
+  for (const s_config config : { s_config{ true, false }, s_config{ false, false }, s_config{ true, true } })
+  {
+    tre::soundData::s_OpusStream dataStream;
+    status &= dataStream.open(filename, prefixSize, config.allowMapping);
+    status &= (dataStream.m_nSamples == dataMem.m_nSamples && dataStream.m_blocks.size() == dataMem.m_blokcs.size());
+
+    const unsigned readyNeeded = std::min(tre::soundData::s_OpusStream::k_cacheBlockCount, unsigned(dataStream.m_blocks.size()));
+
+    if (dataStream.isMapped() && config.decodeInline)
+    {
+      // a block is not acquired before the I/O thread has read its pages
+      unsigned       size;
+      const unsigned farBlock = unsigned(dataStream.m_blocks.size() / 2);
+      status &= (dataStream.acquireBlock(farBlock, size) == nullptr);
+      while (dataStream.acquireBlock(farBlock, size) == nullptr) std::this_thread::yield();
+      while (dataStream.acquireBlock(0, size) == nullptr) std::this_thread::yield(); // back to the start of the sound
+    }
+
+    tre::audioContext ctxMem, ctxStream;
+    status &= ctxMem.startOffline(k_freq, k_bufferSamples);
+    status &= ctxStream.startOffline(k_freq, k_bufferSamples);
+    if (!config.decodeInline) status &= ctxStream.startDecoders(1);
+
+    tre::sound2D soundMem, soundStream;
+    soundMem.setAudioData(&dataMem);
+    soundStream.setAudioData(&dataStream);
+    for (tre::sound2D *s : { &soundMem, &soundStream })
+    {
+      s->control().m_isPlaying = false; // the first callback pre-rolls
+      s->control().m_isRepeating = true;
+      s->control().setCursor(3000);
+      s->control().setTarget(tre::soundSampler::s_stereoControl(0.5f, 0.2f));
+    }
+    status &= ctxMem.addSound(&soundMem);
+    status &= ctxStream.addSound(&soundStream);
+
+    std::mt19937 rng(7);
+    std::vector<int16_t> outMem(2 * k_bufferSamples), outStream(2 * k_bufferSamples);
+    unsigned    diffCount = 0, seekCount = 0, underrunCount = 0;
+    std::size_t residentMax = 0;
+
+    for (unsigned icall = 0; icall < callCount; ++icall)
+    {
+      // seek while paused, then play again
+      const unsigned r = (icall == 1) ? 1 : rng() % 256;
+      const unsigned cursor = rng() % dataMem.m_nSamples;
+      for (tre::sound2D *s : { &soundMem, &soundStream })
+      {
+        if (r == 0 && s->control().m_isPlaying)
+        {
+          s->control().m_isPlaying = false;
+          if (!config.decodeInline) s->control().setCursor(cursor);
+        }
+        else if (r < 8 && !s->control().m_isPlaying)
+        {
+          s->control().m_isPlaying = true;
+        }
+      }
+      seekCount += (r == 0 && icall > 1 && !config.decodeInline);
+
+      ctxMem.updateSystem();
+      ctxStream.updateSystem();
+      underrunCount += soundStream.feedback().m_playedUnderrunCount;
+
+      // wait for the I/O thread and the decoder: the next callback must not underrun
+      if (config.decodeInline)
+        while (dataStream.readyAhead() < readyNeeded) std::this_thread::yield();
+      else
+        while (soundStream.decodedAhead() < needAhead) std::this_thread::yield();
+
+      ctxMem.renderOffline(outMem.data(), k_bufferSamples);
+      ctxStream.renderOffline(outStream.data(), k_bufferSamples);
+      for (unsigned i = 0; i < outMem.size(); ++i) diffCount += (outMem[i] != outStream[i]);
+
+      residentMax = std::max(residentMax, dataStream.residentSize());
+    }
+
+    ctxStream.stopSystem();
+    ctxMem.stopSystem();
+
+    TRE_LOG("OpusStream: " << (dataStream.isMapped() ? "mapped" : "cached") << " file, " << (config.decodeInline ? "inline" : "background") << " decoding, " << callCount << " callbacks, " << seekCount << " seeks: samples that differ = " << diffCount
+            << ", underruns = " << underrunCount << ", resident = " << residentMax / 1024 << " kB (data = " << dataSize / 1024 << " kB)");
+    status &= (diffCount == 0 && underrunCount == 0);
+    // the resident pages are the pages of the blocks ahead of the reader (with the block headers), and the blocks of the next lap (2 partial pages per range)
+    status &= (residentMax <= tre::soundData::s_OpusStream::k_cacheBlockCount * (blockSizeMax + 8) + 4 * pageSize);
+  }
+
+  std::remove(filename);
+
+  if (!status) TRE_LOG("OpusStream: FAILED");
+  return status;
+#else
+  TRE_LOG("OpusStream: skipped (the current build does not include OPUS)");
+  return true;
+#endif
+}
+
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  bool status = true;
+
+  status &= testSlots();
+  status &= testStress();
+  status &= testMixAccuracy();
+  status &= testMixThroughput();
+  status &= testSincQuality();
+  status &= testSincThroughput();
+  status &= testDecodeAhead();
+  status &= testOpusStream();
+
+  TRE_LOG("Quit.");
+
+  return (status ? 0 : -1);
+}
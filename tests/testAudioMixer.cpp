@@ -2,6 +2,7 @@
 #include <iostream>
 #include <sstream>
 #include <array>
+#include <atomic>
 #include <random>
 
 #include "tre_windowContext.h"
@@ -31,11 +32,14 @@ public:
   float m_playedLevelRMS  = 0.f;
 
 protected:
-  bool  ac_isPlaying = false;
-  float ac_gain = 0.f;
-  float ac_gainTarget = 0.f;
-  float ac_playedLevelPeak = 0.f;
-  float ac_playedLevelRMS  = 0.f;
+  // data exchanged with the audio-thread
+  std::atomic<bool>  ac_isPlaying = { false };
+  std::atomic<bool>  ac_requestReset = { false };
+  std::atomic<float> ac_gainTarget = { 0.f };
+  std::atomic<float> ac_playedLevelPeak = { 0.f };
+  std::atomic<float> ac_playedLevelRMS  = { 0.f };
+  // audio-thread only
+  float              ac_gain = 0.f;
 
 protected:
   float                            g_lastSample = 0.f;
@@ -64,7 +68,7 @@ public:
     ac_isPlaying = m_isPlaying;
     if (m_requestReset)
     {
-      g_randEngine.seed(0);
+      ac_requestReset = true;
       m_requestReset = false;
     }
     ac_gainTarget = m_requestGain;
@@ -75,11 +79,13 @@ public:
 
   virtual void sample(float* __restrict outBufferAdd, unsigned sampleCount, int sampleFreq)
   {
+    if (ac_requestReset.exchange(false)) g_randEngine.seed(0);
     ac_playedLevelPeak = 0.f;
     ac_playedLevelRMS  = 0.f;
     if (!ac_isPlaying) return;
 
     const float dt = 1.f / float(sampleFreq);
+    const float gainTarget = ac_gainTarget; // local copy
     const float kGainFade = -float(sampleCount) / 0.1f;
     float sAbsMax = 0.f;
     float sRMS = 0.f;
@@ -89,7 +95,7 @@ public:
       case e_noiseColor::NOISE_BROWN:
         for (unsigned isample = 0; isample < sampleCount; ++isample)
         {
-          const float g = ac_gainTarget + (ac_gain - ac_gainTarget) * std::exp(kGainFade * dt);
+          const float g = gainTarget + (ac_gain - gainTarget) * std::exp(kGainFade * dt);
           const float rd = g_randDistGaussian(g_randEngine);
           g_lastSample = 0.99f * g_lastSample + 0.04f * rd; // leak integrator of gaussian noise
           const float v = g * g_lastSample;
@@ -103,7 +109,7 @@ public:
       case e_noiseColor::NOISE_WHITE:
         for (unsigned isample = 0; isample < sampleCount; ++isample)
         {
-          const float g = ac_gainTarget + (ac_gain - ac_gainTarget) * std::exp(kGainFade * dt);
+          const float g = gainTarget + (ac_gain - gainTarget) * std::exp(kGainFade * dt);
           const float v = g * 0.45f * g_randDistGaussian(g_randEngine);
           outBufferAdd[0] += v;
           outBufferAdd[1] += v;
@@ -114,7 +120,7 @@ public:
         break;
     }
 
-    ac_gain = ac_gainTarget + (ac_gain - ac_gainTarget) * std::exp(kGainFade * dt);
+    ac_gain = gainTarget + (ac_gain - gainTarget) * std::exp(kGainFade * dt);
     ac_playedLevelPeak = sAbsMax;
     ac_playedLevelRMS  = std::sqrt(sRMS / sampleCount);
   }
@@ -362,6 +368,7 @@ static int app_init()
 #else
   withAudio &= audioCtx.startSystem(nullptr);
 #endif
+  if (withAudio) audioCtx.startDecoders(); // the Opus musics are decoded ahead, out of the audio-callback
 
   // -> Load music
 
@@ -429,6 +436,7 @@ static int app_init()
     windowMain->set_cellMargin(tre::ui::s_size(2,tre::ui::SIZE_PIXEL));
     windowMain->create_widgetText(0,0)->set_text("name")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
     windowMain->create_widgetText(0,1)->set_text("play")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
+    windowMain->create_widgetText(0,2)->set_text("sinc")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
     windowMain->create_widgetText(0,3)->set_text("repeat")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
     windowMain->create_widgetText(0,4)->set_text("mute")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
     windowMain->create_widgetText(0,5)->set_text("volume")->set_color(glm::vec4(1.f,1.f,0.f,1.f));
@@ -471,6 +479,13 @@ static int app_init()
         };
         s.m_tracks[0].control().m_isPlaying = false;
 
+        windowMain->create_widgetBoxCheck(iRaw, 2)->set_value(false)->set_isactive(true)->set_iseditable(true)
+                  ->wcb_modified_finished = [&s](tre::ui::widget *w)
+        {
+          tre::ui::widgetBoxCheck *wBox = static_cast<tre::ui::widgetBoxCheck*>(w);
+          s.m_tracks[0].control().m_interpolation = wBox->get_value() ? tre::soundSampler::INTERP_SINC : tre::soundSampler::INTERP_LINEAR;
+        };
+
         windowMain->create_widgetBoxCheck(iRaw, 3)->set_value(true)->set_isactive(true)->set_iseditable(true)
                   ->wcb_modified_finished = [&s](tre::ui::widget *w)
         {
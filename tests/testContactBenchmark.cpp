@@ -0,0 +1,825 @@
+#include "tre_utils.h"
+#include "tre_contact_2D.h"
+#include "tre_contact_3D.h"
+
+#include <random>
+#include <chrono>
+#include <string>
+#include <algorithm>
+
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
+// =============================================================================
+
+/// Generate the skin of a bumpy sphere (closed, non-convex), with about "2 * nLat * nLon" triangles.
+static void genSkinBumpySphere(tre::s_contact3D::s_skin &skin, unsigned nLat, unsigned nLon)
+{
+  const auto fnPos = [nLat, nLon](unsigned i, unsigned j) -> glm::vec3
+  {
+    const float theta = 3.14159265f * float(i) / float(nLat);
+    const float phi = 6.28318531f * float(j % nLon) / float(nLon);
+    const float r = 1.f + 0.1f * std::sin(5.f * theta) * std::cos(3.f * phi);
+    return r * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+  };
+  const auto fnPushTri = [&skin](const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+  {
+    const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    if (glm::dot(n, n) < 1.e-14f) return; // degenerated
+    skin.push_back(p0);
+    if (glm::dot(n, p0 + p1 + p2) >= 0.f) { skin.push_back(p1); skin.push_back(p2); }
+    else                                  { skin.push_back(p2); skin.push_back(p1); }
+  };
+
+  skin.clear();
+  skin.reserve(6 * nLat * nLon);
+  for (unsigned i = 0; i < nLat; ++i)
+  {
+    for (unsigned j = 0; j < nLon; ++j)
+    {
+      const glm::vec3 p00 = fnPos(i, j), p01 = fnPos(i, j + 1), p10 = fnPos(i + 1, j), p11 = fnPos(i + 1, j + 1);
+      if (i != 0)        fnPushTri(p00, p10, p01);
+      if (i != nLat - 1) fnPushTri(p01, p10, p11);
+    }
+  }
+}
+
+// =============================================================================
+
+struct s_rayBatch
+{
+  std::vector<glm::vec3> origins;
+  std::vector<glm::vec3> directions;
+
+  void generate(std::size_t n, unsigned seed)
+  {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> rand11(-1.f, 1.f);
+    origins.resize(n);
+    directions.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      origins[i] = 2.f * glm::vec3(rand11(rng), rand11(rng), rand11(rng));
+      const glm::vec3 target = 0.9f * glm::vec3(rand11(rng), rand11(rng), rand11(rng));
+      directions[i] = glm::normalize(target - origins[i]);
+    }
+  }
+};
+
+// =============================================================================
+
+static bool testSkinBvh()
+{
+  bool status = true;
+
+  s_rayBatch rays;
+  rays.generate(20000, 17);
+
+  // -- small mesh: BVH vs Kd-Tree vs brute-force
+
+  {
+    tre::s_contact3D::s_skinKdTree skinKdTree;
+    genSkinBumpySphere(skinKdTree.skin, 90, 180); // ~32k triangles (the limit of the Kd-Tree)
+
+    tre::s_contact3D::s_skinBvh skinBvh;
+    skinBvh.skin = skinKdTree.skin;
+
+    const tre::s_contact3D::s_skin skinRaw = skinKdTree.skin;
+    const std::size_t nTri = skinRaw.size() / 3;
+
+    systemtick tStart = systemclock::now();
+    skinKdTree.computeTree();
+    const float tBuildKdTree = _elapsedMs(tStart);
+
+    tStart = systemclock::now();
+    skinBvh.computeTree();
+    const float tBuildBvh = _elapsedMs(tStart);
+
+    TRE_LOG("SkinBvh: " << nTri << " triangles, build time: Kd-Tree " << tBuildKdTree << " ms, BVH " << tBuildBvh << " ms");
+
+    std::size_t nHitKd = 0, nHitBvh = 0, nMismatch = 0;
+
+    tStart = systemclock::now();
+    for (std::size_t i = 0; i < rays.origins.size(); ++i)
+    {
+      tre::s_contact3D hit;
+      if (tre::s_contact3D::raytrace_skin(hit, rays.origins[i], rays.directions[i], skinKdTree, 0.f)) ++nHitKd;
+    }
+    const float tRayKdTree = _elapsedMs(tStart);
+
+    tStart = systemclock::now();
+    for (std::size_t i = 0; i < rays.origins.size(); ++i)
+    {
+      tre::s_contact3D hit;
+      if (tre::s_contact3D::raytrace_skin(hit, rays.origins[i], rays.directions[i], skinBvh, 0.f)) ++nHitBvh;
+    }
+    const float tRayBvh = _elapsedMs(tStart);
+
+    for (std::size_t i = 0; i < rays.origins.size(); i += 10)
+    {
+      tre::s_contact3D hitRef, hitBvh;
+      const bool isHitRef = tre::s_contact3D::raytrace_skin(hitRef, rays.origins[i], rays.directions[i], skinRaw, 0.f);
+      const bool isHitBvh = tre::s_contact3D::raytrace_skin(hitBvh, rays.origins[i], rays.directions[i], skinBvh, 0.f);
+      if (isHitRef != isHitBvh || (isHitRef && std::abs(hitRef.penet - hitBvh.penet) > 1.e-4f)) ++nMismatch;
+    }
+
+    TRE_LOG("SkinBvh: ray-trace: Kd-Tree " << int(rays.origins.size() / tRayKdTree) << " k/s (" << nHitKd << " hits), " <<
+                                    "BVH " << int(rays.origins.size() / tRayBvh) << " k/s (" << nHitBvh << " hits), " <<
+                                    nMismatch << " mismatch(es) with the brute-force");
+    if (nMismatch != 0) status = false;
+
+    // point and sphere queries, checked against the ray-parity with the brute-force
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> rand11(-1.2f, 1.2f);
+    std::size_t nInside = 0, nSphere = 0;
+    nMismatch = 0;
+    tStart = systemclock::now();
+    for (std::size_t i = 0; i < 10000; ++i)
+    {
+      const glm::vec3 pt = glm::vec3(rand11(rng), rand11(rng), rand11(rng));
+      tre::s_contact3D cnt;
+      const bool isInside = tre::s_contact3D::point_skin(cnt, pt, skinBvh);
+      if (isInside) ++nInside;
+      if (tre::s_contact3D::sphere_skin(pt, 0.05f, skinBvh)) ++nSphere;
+      if (isInside && (cnt.penet < 0.f || glm::dot(cnt.normal, cnt.pt - pt) < -1.e-5f)) ++nMismatch;
+    }
+    const float tPointBvh = _elapsedMs(tStart);
+
+    for (std::size_t i = 0; i < 1000; ++i)
+    {
+      const glm::vec3 pt = glm::vec3(rand11(rng), rand11(rng), rand11(rng));
+      const glm::vec3 dir = glm::vec3(0.f, 1.f, 0.f);
+      std::size_t     nCross = 0;
+      for (std::size_t iP = 0; iP < skinRaw.size(); iP += 3)
+      {
+        if (tre::triangleRaytrace3D(skinRaw[iP], skinRaw[iP + 1], skinRaw[iP + 2], pt, dir)) ++nCross;
+      }
+      const bool isInsideRef = (nCross % 2) == 1;
+      if (isInsideRef != tre::s_contact3D::point_skin(pt, skinBvh)) ++nMismatch;
+    }
+
+    TRE_LOG("SkinBvh: point+sphere queries: BVH " << int(10000 / tPointBvh) << " k/s (inside: " << nInside << ", sphere-cross: " << nSphere << "), " <<
+                      nMismatch << " mismatch(es)");
+    if (nMismatch != 0) status = false;
+  }
+
+  // -- large mesh: BVH only
+
+  {
+    tre::s_contact3D::s_skinBvh skinBvh;
+    genSkinBumpySphere(skinBvh.skin, 1000, 1000); // ~2M triangles
+    const std::size_t nTri = skinBvh.skin.size() / 3;
+
+    systemtick tStart = systemclock::now();
+    skinBvh.computeTree();
+    const float tBuildBvh = _elapsedMs(tStart);
+
+    std::size_t nHitBvh = 0;
+    tStart = systemclock::now();
+    for (std::size_t i = 0; i < rays.origins.size(); ++i)
+    {
+      tre::s_contact3D hit;
+      if (tre::s_contact3D::raytrace_skin(hit, rays.origins[i], rays.directions[i], skinBvh, 0.f)) ++nHitBvh;
+    }
+    const float tRayBvh = _elapsedMs(tStart);
+
+    TRE_LOG("SkinBvh: " << nTri << " triangles, build time: BVH " << tBuildBvh << " ms, ray-trace: " << int(rays.origins.size() / tRayBvh) << " k/s (" << nHitBvh << " hits)");
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+static bool testSkinBvhBatch()
+{
+  bool status = true;
+
+  tre::s_contact3D::s_skinBvh skinBvh;
+  genSkinBumpySphere(skinBvh.skin, 60, 120); // ~14k triangles
+  skinBvh.computeTree();
+
+  // coherent batch: grid of parallel rays (as for a picking or a shadow-map pass)
+
+  const std::size_t gridSize = 256;
+  s_rayBatch raysCoherent;
+  raysCoherent.origins.resize(gridSize * gridSize);
+  raysCoherent.directions.resize(gridSize * gridSize, glm::normalize(glm::vec3(0.1f, -0.2f, -1.f)));
+  for (std::size_t iy = 0; iy < gridSize; ++iy)
+  {
+    for (std::size_t ix = 0; ix < gridSize; ++ix)
+      raysCoherent.origins[iy * gridSize + ix] = glm::vec3(-1.2f + 2.4f * float(ix) / float(gridSize), -1.2f + 2.4f * float(iy) / float(gridSize), 3.f);
+  }
+
+  // incoherent batch
+
+  s_rayBatch raysIncoherent;
+  raysIncoherent.generate(gridSize * gridSize, 23);
+
+  const auto fnCompare = [&skinBvh, &status](const char *name, const s_rayBatch &rays, float rayStart)
+  {
+    const std::size_t nRays = rays.origins.size();
+    std::vector<tre::s_contact3D> hitSingle(nRays), hitBatch(nRays);
+
+    std::size_t nHitSingle = 0;
+    systemtick tStart = systemclock::now();
+    for (std::size_t i = 0; i < nRays; ++i)
+    {
+      if (tre::s_contact3D::raytrace_skin(hitSingle[i], rays.origins[i], rays.directions[i], skinBvh, rayStart)) ++nHitSingle;
+    }
+    const float tSingle = _elapsedMs(tStart);
+
+    tStart = systemclock::now();
+    const std::size_t nHitBatch = tre::s_contact3D::raytrace_skin(hitBatch, rays.origins, rays.directions, skinBvh, rayStart);
+    const float tBatch = _elapsedMs(tStart);
+
+    std::size_t nMismatch = 0;
+    for (std::size_t i = 0; i < nRays; ++i)
+    {
+      const bool isHitSingle = std::isfinite(hitSingle[i].penet);
+      const bool isHitBatch = std::isfinite(hitBatch[i].penet);
+      if (isHitSingle != isHitBatch) ++nMismatch;
+      else if (isHitSingle && (std::abs(hitSingle[i].penet - hitBatch[i].penet) > 1.e-4f || glm::dot(hitSingle[i].normal, hitBatch[i].normal) < 0.999f)) ++nMismatch;
+    }
+    if (nHitSingle != nHitBatch) ++nMismatch;
+
+    TRE_LOG("SkinBvh batch (" << name << "): single-ray " << int(nRays / tSingle) << " k/s (" << nHitSingle << " hits), " <<
+                                             "batch " << int(nRays / tBatch) << " k/s (" << nHitBatch << " hits, " << tre::parallelThreadCount() << " threads), " <<
+                                             nMismatch << " mismatch(es)");
+    if (nMismatch != 0) status = false;
+  };
+
+  fnCompare("coherent", raysCoherent, -std::numeric_limits<float>::infinity());
+  fnCompare("coherent, ray-start", raysCoherent, 2.5f);
+  fnCompare("incoherent", raysIncoherent, 0.f);
+
+  return status;
+}
+
+// =============================================================================
+
+static bool testBroadphase3D()
+{
+  bool status = true;
+
+  const std::size_t nBodies = 10000;
+  const float       worldSize = 100.f;
+  const float       dt = 1.f / 60.f;
+
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<float> rand01(0.f, 1.f);
+
+  std::vector<glm::vec3> positions(nBodies), velocities(nBodies);
+  std::vector<float>     radii(nBodies);
+  std::vector<uint32_t>  proxies(nBodies);
+
+  const auto fnBox = [&](std::size_t i) { return tre::s_boundbox(positions[i] - radii[i], positions[i] + radii[i]); };
+
+  tre::s_broadphase3D broadphase;
+  broadphase.fatMargin = 0.2f;
+
+  for (std::size_t i = 0; i < nBodies; ++i)
+  {
+    positions[i] = worldSize * glm::vec3(rand01(rng), rand01(rng), rand01(rng));
+    velocities[i] = 10.f * (glm::vec3(rand01(rng), rand01(rng), rand01(rng)) - 0.5f);
+    radii[i] = 0.5f + 1.5f * rand01(rng) * rand01(rng);
+  }
+
+  systemtick tStart = systemclock::now();
+  for (std::size_t i = 0; i < nBodies; ++i)
+    proxies[i] = broadphase.insertProxy(fnBox(i), uint32_t(i));
+  const float tInsert = _elapsedMs(tStart);
+
+  // check the pairs against the brute-force
+
+  const auto fnCheckPairs = [&](const std::vector<std::pair<uint32_t, uint32_t>> &pairs) -> std::size_t
+  {
+    std::vector<uint64_t> keys;
+    keys.reserve(pairs.size());
+    for (const auto &p : pairs) keys.push_back(uint64_t(std::min(p.first, p.second)) << 32 | std::max(p.first, p.second));
+    std::sort(keys.begin(), keys.end());
+    std::size_t nMismatch = (std::adjacent_find(keys.begin(), keys.end()) != keys.end()) ? 1 : 0; // duplicated pairs
+
+    for (const auto &p : pairs)
+    {
+      if (!tre::s_contact3D::box_box(broadphase.getFatBox(proxies[p.first]), broadphase.getFatBox(proxies[p.second]))) ++nMismatch;
+    }
+    for (std::size_t i = 0; i < nBodies; ++i)
+    {
+      const tre::s_boundbox boxI = fnBox(i);
+      for (std::size_t j = i + 1; j < nBodies; ++j)
+      {
+        if (tre::s_contact3D::box_box(boxI, fnBox(j)) && !std::binary_search(keys.begin(), keys.end(), uint64_t(i) << 32 | j)) ++nMismatch;
+      }
+    }
+    return nMismatch;
+  };
+
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  broadphase.computePairs(pairs);
+  std::size_t nMismatch = fnCheckPairs(pairs);
+
+  TRE_LOG("Broadphase3D: " << nBodies << " bodies, insertion " << tInsert << " ms, tree-height " << broadphase.getHeight() <<
+          ", " << pairs.size() << " pairs, " << nMismatch << " mismatch(es) with the brute-force");
+  if (nMismatch != 0) status = false;
+
+  // simulation
+
+  const unsigned nFrames = 300;
+  std::size_t    nPairsTotal = 0, nReinserted = 0;
+  float          tMove = 0.f, tPairs = 0.f;
+  for (unsigned iFrame = 0; iFrame < nFrames; ++iFrame)
+  {
+    for (std::size_t i = 0; i < nBodies; ++i)
+    {
+      positions[i] += dt * velocities[i];
+      for (unsigned c = 0; c < 3; ++c)
+      {
+        if (positions[i][c] < 0.f || positions[i][c] > worldSize) velocities[i][c] = -velocities[i][c];
+      }
+    }
+
+    tStart = systemclock::now();
+    for (std::size_t i = 0; i < nBodies; ++i)
+    {
+      if (broadphase.moveProxy(proxies[i], fnBox(i), dt * velocities[i])) ++nReinserted;
+    }
+    tMove += _elapsedMs(tStart);
+
+    tStart = systemclock::now();
+    broadphase.computePairs(pairs);
+    tPairs += _elapsedMs(tStart);
+    nPairsTotal += pairs.size();
+  }
+
+  nMismatch = fnCheckPairs(pairs);
+  TRE_LOG("Broadphase3D: " << nFrames << " frames, move " << tMove / nFrames << " ms/frame (" << nReinserted / nFrames << " re-insertions/frame), " <<
+          "pairs " << tPairs / nFrames << " ms/frame (" << int(nPairsTotal / tPairs) << " k pairs/s), tree-height " << broadphase.getHeight() <<
+          ", " << nMismatch << " mismatch(es) with the brute-force");
+  if (nMismatch != 0) status = false;
+
+  // box and ray queries
+
+  nMismatch = 0;
+  std::vector<uint32_t> listHits;
+  std::size_t nHitsBox = 0, nHitsRay = 0;
+  tStart = systemclock::now();
+  for (unsigned iQ = 0; iQ < 200; ++iQ)
+  {
+    const glm::vec3       c = worldSize * glm::vec3(rand01(rng), rand01(rng), rand01(rng));
+    const tre::s_boundbox box(c - 5.f, c + 5.f);
+    broadphase.queryBox(listHits, box);
+    nHitsBox += listHits.size();
+    std::sort(listHits.begin(), listHits.end());
+    for (std::size_t i = 0; i < nBodies; ++i)
+    {
+      if (tre::s_contact3D::box_box(box, broadphase.getFatBox(proxies[i])) != std::binary_search(listHits.begin(), listHits.end(), uint32_t(i))) ++nMismatch;
+    }
+
+    const glm::vec3 dir = glm::normalize(glm::vec3(rand01(rng), rand01(rng), rand01(rng)) - 0.5f);
+    broadphase.queryRay(listHits, c, dir, 50.f);
+    nHitsRay += listHits.size();
+    std::sort(listHits.begin(), listHits.end());
+    for (std::size_t i = 0; i < nBodies; ++i)
+    {
+      tre::s_contact3D hit;
+      const bool isHitRef = tre::s_contact3D::raytrace_box(hit, c, dir, broadphase.getFatBox(proxies[i]), 0.f) && hit.penet <= 50.f;
+      if (isHitRef && !std::binary_search(listHits.begin(), listHits.end(), uint32_t(i))) ++nMismatch;
+    }
+  }
+  TRE_LOG("Broadphase3D: queries: " << nHitsBox / 200 << " proxies/box, " << nHitsRay / 200 << " proxies/ray, " << nMismatch << " mismatch(es) with the brute-force");
+  if (nMismatch != 0) status = false;
+
+  // remove and re-insert
+
+  for (std::size_t step : { 97, 2 }) // few changes, then many changes
+  {
+    for (std::size_t i = 0; i < nBodies; i += step)
+      broadphase.removeProxy(proxies[i]);
+    broadphase.computePairs(pairs);
+    for (std::size_t i = 0; i < nBodies; i += step)
+      proxies[i] = broadphase.insertProxy(fnBox(i), uint32_t(i));
+    broadphase.computePairs(pairs);
+    nMismatch = fnCheckPairs(pairs);
+    if (broadphase.getProxyCount() != nBodies) ++nMismatch;
+    TRE_LOG("Broadphase3D: remove+insert " << (nBodies + step - 1) / step << " proxies: tree-height " << broadphase.getHeight() << ", " << nMismatch << " mismatch(es) with the brute-force");
+    if (nMismatch != 0) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+static bool testBroadphase2D()
+{
+  bool status = true;
+
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> rand01(0.f, 1.f);
+
+  struct s_circles
+  {
+    std::vector<glm::vec2> centers, velocities;
+    std::vector<float>     radii;
+    std::vector<glm::vec4> boxes;
+
+    void updateBoxes()
+    {
+      boxes.resize(centers.size());
+      for (std::size_t i = 0; i < centers.size(); ++i)
+        boxes[i] = glm::vec4(centers[i] - radii[i], centers[i] + radii[i]);
+    }
+  };
+
+  const auto fnGenerate = [&](s_circles &circles, std::size_t n, float worldSize)
+  {
+    circles.centers.resize(n);
+    circles.velocities.resize(n);
+    circles.radii.resize(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      circles.centers[i] = worldSize * glm::vec2(rand01(rng), rand01(rng));
+      circles.velocities[i] = 10.f * (glm::vec2(rand01(rng), rand01(rng)) - 0.5f);
+      circles.radii[i] = 0.2f + 0.6f * rand01(rng) * rand01(rng);
+    }
+    circles.radii[0] = 0.1f * worldSize; // a large object
+    circles.updateBoxes();
+  };
+
+  // check against the brute-force
+
+  {
+    s_circles circles;
+    fnGenerate(circles, 4000, 100.f);
+
+    tre::s_broadphase2D broadphase;
+    broadphase.cellSize = 1.f;
+    broadphase.build(circles.boxes);
+
+    std::size_t nMismatch = 0;
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    broadphase.computePairs(pairs);
+    std::vector<uint64_t> keys;
+    for (const auto &p : pairs) keys.push_back(uint64_t(p.first) << 32 | p.second);
+    std::sort(keys.begin(), keys.end());
+    if (std::adjacent_find(keys.begin(), keys.end()) != keys.end()) ++nMismatch; // duplicated pairs
+    std::size_t nPairsRef = 0;
+    for (uint32_t i = 0; i < circles.boxes.size(); ++i)
+    {
+      for (uint32_t j = i + 1; j < circles.boxes.size(); ++j)
+      {
+        if (!tre::s_contact2D::box_box(circles.boxes[i], circles.boxes[j])) continue;
+        ++nPairsRef;
+        if (!std::binary_search(keys.begin(), keys.end(), uint64_t(i) << 32 | j)) ++nMismatch;
+      }
+    }
+    if (nPairsRef != pairs.size()) ++nMismatch;
+
+    std::vector<uint32_t> listObjects;
+    for (unsigned iQ = 0; iQ < 200; ++iQ)
+    {
+      const glm::vec2 c = 100.f * glm::vec2(rand01(rng), rand01(rng));
+      const glm::vec4 box = glm::vec4(c - 3.f, c + 3.f);
+      broadphase.queryBox(listObjects, box);
+      std::sort(listObjects.begin(), listObjects.end());
+      if (std::adjacent_find(listObjects.begin(), listObjects.end()) != listObjects.end()) ++nMismatch;
+      std::size_t nRef = 0;
+      for (uint32_t i = 0; i < circles.boxes.size(); ++i)
+      {
+        if (!tre::s_contact2D::box_box(box, circles.boxes[i])) continue;
+        ++nRef;
+        if (!std::binary_search(listObjects.begin(), listObjects.end(), i)) ++nMismatch;
+      }
+      if (nRef != listObjects.size()) ++nMismatch;
+
+      const float     angle = 6.2831853f * rand01(rng);
+      const glm::vec2 dir = glm::vec2(std::cos(angle), std::sin(angle));
+      broadphase.queryRay(listObjects, c, dir, 40.f);
+      std::sort(listObjects.begin(), listObjects.end());
+      for (uint32_t i = 0; i < circles.boxes.size(); ++i)
+      {
+        tre::s_contact2D hit;
+        if (tre::s_contact2D::raytrace_circle(hit, c, dir, circles.centers[i], circles.radii[i]) && hit.penet >= 0.f && hit.penet <= 40.f &&
+            !std::binary_search(listObjects.begin(), listObjects.end(), i)) ++nMismatch;
+      }
+    }
+
+    TRE_LOG("Broadphase2D: " << circles.boxes.size() << " circles, " << pairs.size() << " pairs, " << nMismatch << " mismatch(es) with the brute-force");
+    if (nMismatch != 0) status = false;
+  }
+
+  // performance with moving circles
+
+  {
+    const float worldSize = 500.f;
+    s_circles   circles;
+    fnGenerate(circles, 50000, worldSize);
+
+    tre::s_broadphase2D broadphase;
+    broadphase.cellSize = 1.f;
+
+    std::vector<std::pair<uint32_t, uint32_t>> pairs;
+    const unsigned nFrames = 100;
+    const float    dt = 1.f / 60.f;
+    float          tBuild = 0.f, tPairs = 0.f, tNarrow = 0.f;
+    std::size_t    nPairsTotal = 0, nContactsTotal = 0;
+    for (unsigned iFrame = 0; iFrame < nFrames; ++iFrame)
+    {
+      for (std::size_t i = 0; i < circles.centers.size(); ++i)
+      {
+        circles.centers[i] += dt * circles.velocities[i];
+        for (unsigned c = 0; c < 2; ++c)
+        {
+          if (circles.centers[i][c] < 0.f || circles.centers[i][c] > worldSize) circles.velocities[i][c] = -circles.velocities[i][c];
+        }
+      }
+      circles.updateBoxes();
+
+      systemtick tStart = systemclock::now();
+      broadphase.build(circles.boxes);
+      tBuild += _elapsedMs(tStart);
+
+      tStart = systemclock::now();
+      broadphase.computePairs(pairs);
+      tPairs += _elapsedMs(tStart);
+      nPairsTotal += pairs.size();
+
+      tStart = systemclock::now();
+      for (const auto &p : pairs)
+      {
+        tre::s_contact2D cnt;
+        if (tre::s_contact2D::circle_circle(cnt, circles.centers[p.first], circles.radii[p.first], circles.centers[p.second], circles.radii[p.second])) ++nContactsTotal;
+      }
+      tNarrow += _elapsedMs(tStart);
+    }
+
+    TRE_LOG("Broadphase2D: " << circles.centers.size() << " circles, " << nFrames << " frames: build " << tBuild / nFrames << " ms/frame, " <<
+            "pairs " << tPairs / nFrames << " ms/frame (" << nPairsTotal / nFrames << " pairs/frame, " << int(nPairsTotal / (tBuild + tPairs)) << " k pairs/s), " <<
+            "narrow-phase " << tNarrow / nFrames << " ms/frame (" << nContactsTotal / nFrames << " contacts/frame)");
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+/// Generate the skin of an ellipsoid (closed, convex), with about "2 * nLat * nLon" triangles.
+static void genSkinEllipsoid(tre::s_contact3D::s_skin &skin, unsigned nLat, unsigned nLon, const glm::vec3 &center, const glm::vec3 &radii)
+{
+  const auto fnPos = [&](unsigned i, unsigned j) -> glm::vec3
+  {
+    const float theta = 3.14159265f * float(i) / float(nLat);
+    const float phi = 6.28318531f * float(j % nLon) / float(nLon);
+    return center + radii * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+  };
+  const auto fnPushTri = [&](const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+  {
+    const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    if (glm::dot(n, n) < 1.e-14f) return; // degenerated
+    skin.push_back(p0);
+    if (glm::dot(n, p0 + p1 + p2 - 3.f * center) >= 0.f) { skin.push_back(p1); skin.push_back(p2); }
+    else                                                 { skin.push_back(p2); skin.push_back(p1); }
+  };
+
+  skin.clear();
+  for (unsigned i = 0; i < nLat; ++i)
+  {
+    for (unsigned j = 0; j < nLon; ++j)
+    {
+      const glm::vec3 p00 = fnPos(i, j), p01 = fnPos(i, j + 1), p10 = fnPos(i + 1, j), p11 = fnPos(i + 1, j + 1);
+      if (i != 0)        fnPushTri(p00, p10, p01);
+      if (i != nLat - 1) fnPushTri(p01, p10, p11);
+    }
+  }
+}
+
+/// Generate the skin of a box (closed, convex).
+static void genSkinBox(tre::s_contact3D::s_skin &skin, const tre::s_boundbox &box)
+{
+  const auto fnCorner = [&box](unsigned id) { return glm::vec3((id & 1) ? box.m_max.x : box.m_min.x, (id & 2) ? box.m_max.y : box.m_min.y, (id & 4) ? box.m_max.z : box.m_min.z); };
+  static const unsigned quads[6][4] = { { 0, 4, 6, 2 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 2, 3, 1 }, { 4, 5, 7, 6 } };
+  skin.clear();
+  for (const auto &q : quads)
+  {
+    skin.push_back(fnCorner(q[0])); skin.push_back(fnCorner(q[1])); skin.push_back(fnCorner(q[2]));
+    skin.push_back(fnCorner(q[0])); skin.push_back(fnCorner(q[2])); skin.push_back(fnCorner(q[3]));
+  }
+}
+
+/// Brute-force intersection of 2 convex skins.
+static bool bruteforceSkinSkin(const tre::s_contact3D::s_skin &skinA, const tre::s_contact3D::s_skin &skinB)
+{
+  for (const glm::vec3 &p : skinA) { if (tre::s_contact3D::point_skin(p, skinB)) return true; }
+  for (const glm::vec3 &p : skinB) { if (tre::s_contact3D::point_skin(p, skinA)) return true; }
+  const auto fnEdgesCrossFaces = [](const tre::s_contact3D::s_skin &skinE, const tre::s_contact3D::s_skin &skinF) -> bool
+  {
+    glm::vec3 uvt;
+    for (std::size_t iE = 0; iE < skinE.size(); ++iE)
+    {
+      const glm::vec3 &e0 = skinE[iE], &e1 = skinE[(iE % 3 == 2) ? iE - 2 : iE + 1];
+      for (std::size_t iF = 0; iF < skinF.size(); iF += 3)
+      {
+        if (tre::triangleRaytrace3D(skinF[iF], skinF[iF + 1], skinF[iF + 2], e0, e1 - e0, &uvt) && uvt.z <= 1.f) return true;
+      }
+    }
+    return false;
+  };
+  return fnEdgesCrossFaces(skinA, skinB) || fnEdgesCrossFaces(skinB, skinA);
+}
+
+/// Brute-force distance between a point and a triangle (see "Real-Time Collision Detection", C. Ericson, 5.1.5).
+static float bruteforceDistancePointTriangle(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c)
+{
+  const glm::vec3 ab = b - a, ac = c - a, ap = p - a, bp = p - b, cp = p - c;
+  const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap), d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp), d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+  const float va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+  glm::vec3 q;
+  if      (d1 <= 0.f && d2 <= 0.f)                                 q = a;
+  else if (d3 >= 0.f && d4 <= d3)                                  q = b;
+  else if (d6 >= 0.f && d5 <= d6)                                  q = c;
+  else if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)                    q = a + (d1 / (d1 - d3)) * ab;
+  else if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)                    q = a + (d2 / (d2 - d6)) * ac;
+  else if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)      q = b + ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b);
+  else                                                             q = a + (vb / (va + vb + vc)) * ab + (vc / (va + vb + vc)) * ac;
+  return glm::length(p - q);
+}
+
+static void translateSkin(tre::s_contact3D::s_skin &skin, tre::s_contact3D::s_skinConvex &convex, const glm::vec3 &offset)
+{
+  for (glm::vec3 &p : skin) p += offset;
+  for (glm::vec3 &p : convex.vertices) p += offset;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool testGjk()
+{
+  bool status = true;
+
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> rand01(0.f, 1.f);
+
+  const auto fnRandVec = [&](float scale) { return scale * glm::vec3(rand01(rng) - 0.5f, rand01(rng) - 0.5f, rand01(rng) - 0.5f); };
+  const auto fnRandBox = [&](float scale) { const glm::vec3 c = fnRandVec(scale), h = glm::vec3(0.1f) + fnRandVec(1.f) + 0.5f; return tre::s_boundbox(c - h, c + h); };
+
+  // check against the brute-force
+
+  {
+    tre::s_contact3D::s_skin       skinA, skinB;
+    tre::s_contact3D::s_skinConvex convexA, convexB;
+
+    std::size_t nMismatch = 0, nIntersect = 0, nBadPenet = 0, nBadDistance = 0;
+    const unsigned nTests = 300;
+    for (unsigned iTest = 0; iTest < nTests; ++iTest)
+    {
+      genSkinEllipsoid(skinA, 8, 12, fnRandVec(1.f), glm::vec3(0.3f) + fnRandVec(1.f) + 0.5f);
+      if (iTest % 3 == 0) genSkinBox(skinB, fnRandBox(3.f));
+      else                genSkinEllipsoid(skinB, 6, 10, fnRandVec(3.f), glm::vec3(0.3f) + fnRandVec(1.f) + 0.5f);
+      convexA.compute(skinA);
+      convexB.compute(skinB);
+
+      tre::s_contact3D cnt;
+      const bool isHitRef = bruteforceSkinSkin(skinA, skinB);
+      const bool isHit = tre::s_contact3D::skin_skin(cnt, convexA, convexB);
+      if (isHit != isHitRef) ++nMismatch;
+      if (isHit != tre::s_contact3D::skin_skin(convexA, convexB)) ++nMismatch;
+
+      if (isHit)
+      {
+        ++nIntersect;
+        // moving B along the normal of the penetration must separate the skins.
+        const glm::vec3 offset = cnt.normal * (cnt.penet * 1.01f + 1.e-4f);
+        translateSkin(skinB, convexB, offset);
+        if (tre::s_contact3D::skin_skin(convexA, convexB)) ++nBadPenet;
+        translateSkin(skinB, convexB, -offset);
+        if (cnt.penet > 1.e-2f)
+        {
+          const glm::vec3 offsetPartial = cnt.normal * (cnt.penet * 0.9f);
+          translateSkin(skinB, convexB, offsetPartial);
+          if (!tre::s_contact3D::skin_skin(convexA, convexB)) ++nBadPenet;
+          translateSkin(skinB, convexB, -offsetPartial);
+        }
+      }
+      else
+      {
+        // moving B by the closest points must make the skins touch.
+        glm::vec3   ptA, ptB;
+        const float dist = tre::s_contact3D::distance_skin_skin(ptA, ptB, convexA, convexB);
+        if (std::abs(glm::length(ptB - ptA) - dist) > 1.e-4f) ++nBadDistance;
+        const glm::vec3 offset = (ptA - ptB) * 1.01f;
+        translateSkin(skinB, convexB, offset);
+        if (!bruteforceSkinSkin(skinA, skinB)) ++nBadDistance;
+        translateSkin(skinB, convexB, -offset);
+        const glm::vec3 offsetPartial = (ptA - ptB) * 0.99f;
+        translateSkin(skinB, convexB, offsetPartial);
+        if (bruteforceSkinSkin(skinA, skinB)) ++nBadDistance;
+        translateSkin(skinB, convexB, -offsetPartial);
+      }
+
+      // sphere and box
+      const glm::vec3 center = fnRandVec(3.f);
+      const float     radius = 0.1f + 0.5f * rand01(rng);
+      bool isHitSphereRef = tre::s_contact3D::point_skin(center, skinA);
+      for (std::size_t iA = 0; iA < skinA.size() && !isHitSphereRef; iA += 3)
+        isHitSphereRef = bruteforceDistancePointTriangle(center, skinA[iA], skinA[iA + 1], skinA[iA + 2]) <= radius;
+      if (tre::s_contact3D::sphere_skin(center, radius, convexA) != isHitSphereRef) ++nMismatch;
+
+      const tre::s_boundbox box = fnRandBox(3.f);
+      genSkinBox(skinB, box);
+      if (tre::s_contact3D::box_skin(box, convexA) != bruteforceSkinSkin(skinB, skinA)) ++nMismatch;
+    }
+
+    TRE_LOG("GJK/EPA: " << nTests << " tests (" << nIntersect << " skin-skin intersections), " << nMismatch << " mismatch(es) with the brute-force, " <<
+            nBadPenet << " bad penetration(s), " << nBadDistance << " bad distance(s)");
+    if (nMismatch != 0 || nBadPenet != 0 || nBadDistance != 0) status = false;
+  }
+
+  // performance with moving shapes (cold vs warm-started)
+
+  {
+    const unsigned nPairs = 500, nFrames = 200;
+    const float    dt = 1.f / 60.f;
+
+    std::vector<tre::s_contact3D::s_skinConvex> convexA(nPairs), convexB(nPairs);
+    std::vector<glm::vec3>                      velocities(nPairs);
+    std::vector<tre::s_contact3D::s_gjkCache>   caches(nPairs);
+    tre::s_contact3D::s_skin                    skin;
+    for (unsigned i = 0; i < nPairs; ++i)
+    {
+      genSkinEllipsoid(skin, 16, 24, glm::vec3(0.f), glm::vec3(1.f, 0.7f, 0.5f));
+      convexA[i].compute(skin);
+      genSkinEllipsoid(skin, 16, 24, fnRandVec(4.f), glm::vec3(0.6f, 0.9f, 0.4f));
+      convexB[i].compute(skin);
+      velocities[i] = fnRandVec(3.f);
+    }
+
+    float                   tCold = 0.f, tWarm = 0.f;
+    std::size_t             nHit = 0, nMismatch = 0;
+    std::vector<uint8_t>    isHitCold(nPairs);
+    for (unsigned iFrame = 0; iFrame < nFrames; ++iFrame)
+    {
+      for (unsigned i = 0; i < nPairs; ++i)
+      {
+        glm::vec3 offset = dt * velocities[i];
+        if (glm::length(convexB[i].vertices[0] + offset) > 4.f) { velocities[i] = -velocities[i]; offset = -offset; }
+        for (glm::vec3 &p : convexB[i].vertices) p += offset;
+      }
+
+      tre::s_contact3D cnt;
+      systemtick tStart = systemclock::now();
+      for (unsigned i = 0; i < nPairs; ++i)
+        isHitCold[i] = tre::s_contact3D::skin_skin(cnt, convexA[i], convexB[i]) ? 1 : 0;
+      tCold += _elapsedMs(tStart);
+
+      tStart = systemclock::now();
+      for (unsigned i = 0; i < nPairs; ++i)
+      {
+        const bool isHitWarm = tre::s_contact3D::skin_skin(cnt, convexA[i], convexB[i], &caches[i]);
+        nHit += isHitWarm ? 1 : 0;
+        if (isHitWarm != bool(isHitCold[i])) isHitCold[i] = 2;
+      }
+      tWarm += _elapsedMs(tStart);
+
+      for (unsigned i = 0; i < nPairs; ++i)
+      {
+        glm::vec3 ptA, ptB;
+        if (isHitCold[i] == 2 && tre::s_contact3D::distance_skin_skin(ptA, ptB, convexA[i], convexB[i]) > 1.e-4f) ++nMismatch; // accept the grazing contacts
+      }
+    }
+
+    const std::size_t nQueries = std::size_t(nPairs) * nFrames;
+    TRE_LOG("GJK/EPA: " << convexA[0].vertices.size() << " vertices per skin, " << nQueries << " queries (" << nHit << " hits): cold " << int(nQueries / tCold) << " k/s, " <<
+            "warm-started " << int(nQueries / tWarm) << " k/s, " << nMismatch << " mismatch(es)");
+    if (nMismatch != 0) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  bool status = true;
+
+  status &= testSkinBvh();
+  status &= testSkinBvhBatch();
+  status &= testBroadphase3D();
+  status &= testBroadphase2D();
+  status &= testGjk();
+
+  TRE_LOG("Quit.");
+
+  return (status ? 0 : -1);
+}
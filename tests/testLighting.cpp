@@ -44,7 +44,7 @@ tre::modelStaticIndexed3D meshes = tre::modelStaticIndexed3D(tre::modelStaticInd
 std::size_t modelPart = 0;
 std::size_t NmodelPart = 0;
 glm::mat4 modelTransform = glm::mat4(1.f);
-std::vector<tre::s_contact3D::s_skinKdTree> meshesSkin;
+std::vector<tre::s_contact3D::s_skinBvh> meshesSkin;
 
 tre::modelRaw2D meshQuad;
 
@@ -0,0 +1,744 @@
+#include "tre_utils.h"
+#include "tre_model.h"
+#include "tre_model_tools.h"
+
+#include <random>
+#include <chrono>
+#include <string>
+#include <algorithm>
+#include <map>
+
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
+// =============================================================================
+
+/// Non-indexed layout over a list of points (CPU only, no model)
+struct s_pointCloud
+{
+  std::vector<glm::vec3> points;
+  tre::s_modelDataLayout layout;
+  tre::s_partInfo        part;
+
+  void updateLayout()
+  {
+    layout.m_positions.m_data = reinterpret_cast<GLfloat*>(points.data());
+    layout.m_positions.m_size = 3;
+    layout.m_positions.m_stride = 3;
+    layout.m_vertexCount = points.size();
+    part.m_offset = 0;
+    part.m_size = points.size();
+    part.m_bbox = tre::s_boundbox();
+    for (const glm::vec3 &pt : points) part.m_bbox.addPointInBox(pt);
+  }
+};
+
+// =============================================================================
+
+/// Check that the hull is closed, convex and contains the points. Returns the number of errors.
+static std::size_t checkConvexHull(const std::vector<glm::vec3> &hull, const std::vector<glm::vec3> &points, std::size_t pointStride, float tolerance)
+{
+  std::size_t nError = 0;
+  if (hull.empty() || hull.size() % 3 != 0) return 1;
+
+  // closed: each edge is shared by 2 triangles, with opposite directions
+
+  std::vector<glm::vec3> vertices(hull);
+  const auto fnLess = [](const glm::vec3 &a, const glm::vec3 &b) { return (a.x != b.x) ? a.x < b.x : (a.y != b.y) ? a.y < b.y : a.z < b.z; };
+  std::sort(vertices.begin(), vertices.end(), fnLess);
+  vertices.erase(std::unique(vertices.begin(), vertices.end()), vertices.end());
+  const auto fnVertexId = [&](const glm::vec3 &pt) { return uint64_t(std::lower_bound(vertices.begin(), vertices.end(), pt, fnLess) - vertices.begin()); };
+
+  std::vector<std::pair<uint64_t, std::size_t>> edges; // (edge, triangle)
+  edges.reserve(hull.size());
+  for (std::size_t iT = 0; iT < hull.size(); iT += 3)
+  {
+    for (unsigned k = 0; k < 3; ++k)
+      edges.emplace_back(fnVertexId(hull[iT + k]) << 32 | fnVertexId(hull[iT + (k + 1) % 3]), iT);
+  }
+  std::sort(edges.begin(), edges.end());
+  for (std::size_t iE = 1; iE < edges.size(); ++iE)
+  {
+    if (edges[iE].first == edges[iE - 1].first) ++nError;
+  }
+
+  // convex: the surface is closed and locally convex (the triangles behind the edges are below), and it contains the points
+
+  const auto fnDistance = [&hull](std::size_t iT, const glm::vec3 &pt) -> double
+  {
+    // (plane in double precision, the thin triangles are common on large hulls)
+    const glm::dvec3 p0 = hull[iT];
+    const glm::dvec3 n = glm::cross(glm::dvec3(hull[iT + 1]) - p0, glm::dvec3(hull[iT + 2]) - p0);
+    const double     nLength = glm::length(n);
+    return (nLength == 0.) ? std::numeric_limits<double>::infinity() : glm::dot(n, glm::dvec3(pt) - p0) / nLength;
+  };
+
+  for (const auto &e : edges)
+  {
+    const uint64_t eTwin = (e.first << 32) | (e.first >> 32);
+    const auto     itTwin = std::lower_bound(edges.begin(), edges.end(), std::make_pair(eTwin, std::size_t(0)));
+    if (itTwin == edges.end() || itTwin->first != eTwin) { ++nError; continue; }
+    for (unsigned k = 0; k < 3; ++k)
+    {
+      if (fnDistance(e.second, hull[itTwin->second + k]) > tolerance) ++nError;
+    }
+  }
+
+  for (std::size_t iT = 0; iT < hull.size(); iT += 3)
+  {
+    for (std::size_t iP = 0; iP < points.size(); iP += pointStride)
+    {
+      if (fnDistance(iT, points[iP]) > tolerance) ++nError;
+    }
+  }
+
+  return nError;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool testConvexHull()
+{
+  bool status = true;
+
+  std::mt19937 rng(13);
+  std::uniform_real_distribution<float> rand11(-1.f, 1.f);
+
+  const auto fnRandInBall = [&]() { while (true) { const glm::vec3 pt(rand11(rng), rand11(rng), rand11(rng)); if (glm::dot(pt, pt) <= 1.f) return pt; } };
+  const auto fnRandOnSphere = [&]() { return glm::normalize(fnRandInBall() + glm::vec3(1.e-6f)); };
+
+  s_pointCloud           cloud;
+  std::vector<glm::vec3> hull;
+
+  // cube (with points inside and on the faces)
+
+  {
+    cloud.points.clear();
+    for (unsigned i = 0; i < 8; ++i) cloud.points.emplace_back((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f);
+    for (unsigned i = 0; i < 1000; ++i) cloud.points.push_back(glm::vec3(rand11(rng), rand11(rng), rand11(rng)));
+    for (unsigned i = 0; i < 1000; ++i) { glm::vec3 pt(rand11(rng), rand11(rng), rand11(rng)); pt[i % 3] = (i & 4) ? 1.f : -1.f; cloud.points.push_back(pt); }
+    std::shuffle(cloud.points.begin(), cloud.points.end(), rng);
+    cloud.updateLayout();
+
+    tre::modelTools::computeConvexeSkin3D(cloud.layout, cloud.part, 1.e-4f, hull);
+    const std::size_t nError = checkConvexHull(hull, cloud.points, 1, 1.e-4f);
+    float volume = 0.f;
+    for (std::size_t iT = 0; iT < hull.size(); iT += 3) volume += glm::dot(glm::cross(hull[iT + 1], hull[iT + 2]), hull[iT]) / 6.f;
+    TRE_LOG("ConvexHull: cube, " << cloud.points.size() << " points, " << hull.size() / 3 << " triangles, volume " << volume << ", " << nError << " error(s)");
+    if (nError != 0 || std::abs(volume - 8.f) > 1.e-3f) status = false;
+  }
+
+  // random clouds
+
+  const auto fnTestCloud = [&](const std::string &name, std::size_t nPoints, bool onSphere, std::size_t maxVertexCount, std::size_t checkStride)
+  {
+    cloud.points.resize(nPoints);
+    for (glm::vec3 &pt : cloud.points) pt = onSphere ? fnRandOnSphere() : fnRandInBall();
+    cloud.updateLayout();
+
+    const systemtick tStart = systemclock::now();
+    tre::modelTools::computeConvexeSkin3D(cloud.layout, cloud.part, 0.f, hull, maxVertexCount);
+    const float tHull = _elapsedMs(tStart);
+
+    std::vector<glm::vec3> vertices(hull);
+    std::sort(vertices.begin(), vertices.end(), [](const glm::vec3 &a, const glm::vec3 &b) { return (a.x != b.x) ? a.x < b.x : (a.y != b.y) ? a.y < b.y : a.z < b.z; });
+    const std::size_t nVertices = std::unique(vertices.begin(), vertices.end()) - vertices.begin();
+
+    // with a vertex limit, the hull does not contain all the points
+    const std::size_t nError = checkConvexHull(hull, maxVertexCount == 0 ? cloud.points : std::vector<glm::vec3>(), checkStride, 1.e-4f);
+    TRE_LOG("ConvexHull: " << name << ", " << nPoints << " points, " << nVertices << " vertices, " << hull.size() / 3 << " triangles, " <<
+            tHull << " ms, " << nError << " error(s)");
+    if (nError != 0) status = false;
+    if (maxVertexCount != 0 && nVertices > maxVertexCount) status = false;
+  };
+
+  fnTestCloud("ball", 5000, false, 0, 1);
+  fnTestCloud("sphere", 2000, true, 0, 1);
+  fnTestCloud("sphere (max 64 vertices)", 100000, true, 64, 1);
+  fnTestCloud("ball", 1000000, false, 0, 97);
+  fnTestCloud("sphere", 100000, true, 0, 1009);
+
+  return status;
+}
+
+// =============================================================================
+
+/// Bumpy sphere (the points are not co-spherical), with about 2*subdiv^2 vertices
+static std::size_t createBumpySphere(tre::modelIndexed &model, int subdiv)
+{
+  const std::size_t ipart = model.createPartFromPrimitive_uvtrisphere(glm::mat4(1.f), 1.f, 2 * subdiv, subdiv);
+  const tre::s_partInfo &part = model.partInfo(ipart);
+  const tre::s_modelDataLayout &layout = model.layout();
+  const GLuint *indices = layout.m_index.getPointer(part.m_offset);
+  const unsigned vMin = *std::min_element(indices, indices + part.m_size);
+  const unsigned vMax = *std::max_element(indices, indices + part.m_size);
+  for (unsigned iV = vMin; iV <= vMax; ++iV)
+  {
+    glm::vec3 &pt = layout.m_positions.get<glm::vec3>(iV);
+    pt *= 1.f - 0.1f * (1.f + std::sin(3.f * pt.x) * std::sin(4.f * pt.y + 1.f) * std::sin(5.f * pt.z + 2.f));
+  }
+  model.computeBBoxPart(ipart);
+  return ipart;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool testTetrahedralize()
+{
+  bool status = true;
+
+  const auto fnTestMesh = [&](int subdiv)
+  {
+    tre::modelStaticIndexed3D model(tre::modelStaticIndexed3D::VB_NORMAL);
+    const std::size_t ipart = createBumpySphere(model, subdiv);
+    const tre::s_partInfo &part = model.partInfo(ipart);
+    const tre::s_modelDataLayout &layout = model.layout();
+
+    const float volumeMesh = std::abs(tre::modelTools::computeBarycenter3D(layout, part).w) / 6.f; // (the barycenter returns 6 times the volume)
+
+    std::vector<unsigned> tetras;
+    const systemtick tStart = systemclock::now();
+    const bool success = tre::modelTools::tetrahedralize(model, ipart, std::numeric_limits<std::size_t>::max(), false, tetras);
+    const float tTetra = _elapsedMs(tStart);
+
+    // validity: no degenerated tetrahedron, and the tetrahedrons fill the mesh's volume
+
+    std::size_t nDegenerated = 0;
+    float       volumeTetra = 0.f;
+    float       qualityMin = 1.f;
+    for (std::size_t iT = 0; iT < tetras.size(); iT += 4)
+    {
+      float volume, quality;
+      tre::tetrahedronQuality(layout.m_positions.get<glm::vec3>(tetras[iT + 0]), layout.m_positions.get<glm::vec3>(tetras[iT + 1]),
+                              layout.m_positions.get<glm::vec3>(tetras[iT + 2]), layout.m_positions.get<glm::vec3>(tetras[iT + 3]), &volume, &quality);
+      if (!(quality > 0.f)) ++nDegenerated;
+      volumeTetra += volume;
+      qualityMin = std::min(qualityMin, quality);
+    }
+    const float volumeError = std::abs(volumeTetra - volumeMesh) / volumeMesh;
+
+    TRE_LOG("Tetrahedralize: " << layout.m_vertexCount << " vertices, " << part.m_size / 3 << " triangles -> " << tetras.size() / 4 << " tetrahedrons, " <<
+            tTetra << " ms, volume error " << volumeError * 100.f << " %, min quality " << qualityMin << ", " << nDegenerated << " degenerated");
+    if (!success || tetras.empty() || nDegenerated != 0 || volumeError > 1.e-2f) status = false;
+  };
+
+  fnTestMesh(16);
+  fnTestMesh(32);
+  fnTestMesh(224); // 100k vertices
+
+  return status;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Copy a part, with an attribute-seam (2 charts, on both sides of the plane z=0, marked in the red of the colors) and a hole (y > holeY).
+static std::size_t createSeamedPart(tre::modelIndexed &model, std::size_t ipartIn, float holeY)
+{
+  const std::size_t offsetIn = model.partInfo(ipartIn).m_offset;
+  const std::size_t countIn = model.partInfo(ipartIn).m_size;
+  const GLuint *indicesIn = model.layout().m_index.getPointer(offsetIn);
+  const unsigned vMin = *std::min_element(indicesIn, indicesIn + countIn);
+  const unsigned vMax = *std::max_element(indicesIn, indicesIn + countIn);
+
+  std::size_t vertexOffset = 0;
+  const std::size_t ipart = model.createPart(countIn, vMax - vMin + 1, vertexOffset);
+  const tre::s_modelDataLayout &layout = model.layout();
+  layout.copyVertex(vMin, vMax - vMin + 1, vertexOffset);
+  for (unsigned iV = vMin; iV <= vMax; ++iV)
+  {
+    layout.m_colors.get<glm::vec4>(iV) = glm::vec4(0.f, 0.f, 0.f, 1.f);
+    layout.m_colors.get<glm::vec4>(vertexOffset + iV - vMin) = glm::vec4(1.f, 0.f, 0.f, 1.f);
+  }
+
+  const std::size_t offsetOut = model.partInfo(ipart).m_offset;
+  std::size_t       countOut = 0;
+  for (std::size_t i = 0; i < countIn; i += 3)
+  {
+    unsigned ind[3];
+    glm::vec3 center = glm::vec3(0.f);
+    for (unsigned k = 0; k < 3; ++k)
+    {
+      ind[k] = layout.m_index[offsetIn + i + k];
+      center += layout.m_positions.get<glm::vec3>(ind[k]) / 3.f;
+    }
+    if (center.y > holeY) continue;
+    for (unsigned k = 0; k < 3; ++k)
+      layout.m_index[offsetOut + countOut++] = (center.z < 0.f) ? unsigned(vertexOffset + ind[k] - vMin) : ind[k];
+  }
+  model.resizeRawPart(ipart, countOut);
+  model.computeBBoxPart(ipart);
+  return ipart;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Check the topology of a mesh, welded by position: the edges are shared by 2 triangles (or 1 on the boundary) with opposite orientations,
+/// no degenerated triangle, and the triangles do not mix the charts (when the colors are set). Returns the number of errors, and the number of boundary edges.
+static std::size_t checkMeshTopology(const tre::modelIndexed &model, std::size_t ipart, std::size_t &nBoundaryEdges)
+{
+  const tre::s_modelDataLayout &layout = model.layout();
+  const tre::s_partInfo        &part = model.partInfo(ipart);
+
+  std::map<std::array<float, 3>, unsigned>   pointIds;
+  std::map<std::pair<unsigned, unsigned>, unsigned> edgeCount;
+  std::size_t nError = 0;
+  for (std::size_t i = part.m_offset, iStop = part.m_offset + part.m_size; i < iStop; i += 3)
+  {
+    unsigned ids[3];
+    for (unsigned k = 0; k < 3; ++k)
+    {
+      const glm::vec3 pt = layout.m_positions.get<glm::vec3>(layout.m_index[i + k]);
+      ids[k] = pointIds.emplace(std::array<float, 3>{ pt.x, pt.y, pt.z }, unsigned(pointIds.size())).first->second;
+    }
+    if (ids[0] == ids[1] || ids[0] == ids[2] || ids[1] == ids[2]) ++nError;
+    if (layout.m_colors.hasData())
+    {
+      const float chart = layout.m_colors.get<glm::vec4>(layout.m_index[i]).x;
+      if (layout.m_colors.get<glm::vec4>(layout.m_index[i + 1]).x != chart || layout.m_colors.get<glm::vec4>(layout.m_index[i + 2]).x != chart) ++nError;
+    }
+    for (unsigned k = 0; k < 3; ++k) ++edgeCount[std::make_pair(ids[k], ids[(k + 1) % 3])];
+  }
+  nBoundaryEdges = 0;
+  for (const auto &edge : edgeCount)
+  {
+    if (edge.second != 1) ++nError;
+    if (edgeCount.find(std::make_pair(edge.first.second, edge.first.first)) == edgeCount.end()) ++nBoundaryEdges;
+  }
+  return nError;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Create a height-field (5 x 5 vertices) with exact coordinates. The column x = 0.5 is duplicated with opposite normals (seam).
+static std::size_t createSeamedHeightfield(tre::modelIndexed &model)
+{
+  const unsigned n = 5, seam = 2;
+  std::size_t    vertexOffset = 0;
+  const std::size_t ipart = model.createPart(6 * (n - 1) * (n - 1), n * n + n, vertexOffset);
+  const tre::s_modelDataLayout &layout = model.layout();
+  for (unsigned j = 0; j < n; ++j)
+  {
+    for (unsigned i = 0; i < n; ++i)
+    {
+      const glm::vec3 pos = glm::vec3(0.25f * float(i), 0.25f * float(j), 0.25f * float((i * 3 + j * 5) % 7));
+      const glm::vec3 nor = glm::vec3(0.25f * float(i % 3), 0.25f * float(j % 2), 1.f);
+      layout.m_positions.get<glm::vec3>(vertexOffset + j * n + i) = pos;
+      layout.m_normals.get<glm::vec3>(vertexOffset + j * n + i) = nor;
+      if (i != seam) continue;
+      layout.m_positions.get<glm::vec3>(vertexOffset + n * n + j) = pos;
+      layout.m_normals.get<glm::vec3>(vertexOffset + n * n + j) = -nor;
+    }
+  }
+  const auto fnIndex = [&](unsigned i, unsigned j, bool rightSide) { return unsigned(vertexOffset + ((rightSide && i == seam) ? n * n + j : j * n + i)); };
+  const std::size_t offset = model.partInfo(ipart).m_offset;
+  std::size_t       count = 0;
+  for (unsigned j = 0; j + 1 < n; ++j)
+  {
+    for (unsigned i = 0; i + 1 < n; ++i)
+    {
+      const bool     rightSide = (i >= seam);
+      const unsigned a = fnIndex(i, j, rightSide), b = fnIndex(i + 1, j, rightSide), c = fnIndex(i + 1, j + 1, rightSide), d = fnIndex(i, j + 1, rightSide);
+      const unsigned tris[6] = { a, b, c, a, c, d };
+      for (unsigned k = 0; k < 6; ++k) layout.m_index[offset + count++] = tris[k];
+    }
+  }
+  model.computeBBoxPart(ipart);
+  return ipart;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Outputs of decimateVoxel on the seamed height-field (grid 0.45), generated with the dense-grid implementation.
+/// All the values are exact, and the vertices are far from the cell boundaries: the outputs do not depend on the platform.
+
+struct s_refVertex
+{
+  unsigned index;
+  float    pos[3];
+  float    normal[3];
+};
+
+static const unsigned k_refVoxelSmoothIndices[84] = { 40, 47, 35, 40, 50, 47, 36, 48, 43, 36, 43, 30, 48, 37, 31, 48, 31, 43, 37, 4, 38, 37, 38, 31, 42, 30, 49, 42, 49, 39,
+                                                      30, 43, 40, 30, 40, 49, 43, 31, 45, 43, 45, 40, 31, 38, 34, 31, 34, 45, 39, 49, 44, 39, 44, 32, 49, 40, 33, 49, 33, 44,
+                                                      33, 35, 46, 33, 40, 35, 45, 34, 50, 45, 50, 40, 32, 44, 41, 32, 41, 20, 44, 33, 46, 44, 46, 41 };
+static const s_refVertex k_refVoxelSmoothVertices[23] = { { 4, { 1.f, 0.f, 1.25f }, { 0.25f, 0.f, 1.f } }, { 20, { 0.f, 1.f, 1.5f }, { 0.f, 0.f, 1.f } }, { 30, { 0.1875f, 0.1875f, 0.1875f }, { 0.25f, 0.25f, 1.f } },
+                                                          { 31, { 0.75f, 0.25f, 0.f }, { 0.f, 0.25f, 1.f } }, { 32, { 0.f, 0.75f, 0.25f }, { 0.f, 0.25f, 1.f } }, { 33, { 0.5f, 0.75f, 0.f }, { -0.5f, -0.25f, -1.f } },
+                                                          { 34, { 1.f, 0.5f, 0.25f }, { 0.25f, 0.f, 1.f } }, { 35, { 0.75f, 1.f, 0.25f }, { 0.f, 0.f, 1.f } }, { 36, { 0.25f, 0.f, 0.75f }, { 0.25f, 0.f, 1.f } },
+                                                          { 37, { 0.75f, 0.f, 0.5f }, { 0.f, 0.f, 1.f } }, { 38, { 1.f, 0.25f, 0.75f }, { 0.25f, 0.25f, 1.f } }, { 39, { 0.f, 0.5f, 0.75f }, { 0.f, 0.f, 1.f } },
+                                                          { 40, { 0.625f, 0.625f, 0.625f }, { 0.f, 0.25f, 1.f } }, { 41, { 0.25f, 1.f, 0.5f }, { 0.25f, 0.f, 1.f } }, { 42, { 0.f, 0.25f, 1.25f }, { 0.f, 0.25f, 1.f } },
+                                                          { 43, { 0.5f, 0.25f, 1.f }, { -0.5f, -0.25f, -1.f } }, { 44, { 0.25f, 0.75f, 1.f }, { 0.25f, 0.25f, 1.f } }, { 45, { 0.75f, 0.5f, 1.25f }, { 0.f, 0.f, 1.f } },
+                                                          { 46, { 0.5f, 1.f, 1.25f }, { -0.5f, 0.f, -1.f } }, { 47, { 1.f, 1.f, 1.f }, { 0.25f, 0.f, 1.f } }, { 48, { 0.5f, 0.f, 1.5f }, { -0.5f, 0.f, -1.f } },
+                                                          { 49, { 0.25f, 0.5f, 1.5f }, { 0.25f, 0.f, 1.f } }, { 50, { 1.f, 0.75f, 1.5f }, { 0.25f, 0.25f, 1.f } } };
+
+static const unsigned k_refVoxelSharpIndices[84] = { 41, 52, 36, 41, 56, 52, 37, 54, 46, 37, 46, 30, 53, 38, 31, 53, 31, 45, 38, 47, 39, 38, 39, 31, 44, 30, 55, 44, 55, 40,
+                                                     30, 46, 42, 30, 42, 55, 45, 31, 49, 45, 49, 41, 31, 39, 35, 31, 35, 49, 40, 55, 48, 40, 48, 32, 55, 42, 34, 55, 34, 48,
+                                                     33, 36, 50, 33, 41, 36, 49, 35, 56, 49, 56, 41, 32, 48, 43, 32, 43, 57, 48, 34, 51, 48, 51, 43 };
+static const s_refVertex k_refVoxelSharpVertices[28] = { { 30, { 0.1875f, 0.1875f, 0.1875f }, { 0.25f, 0.25f, 1.f } }, { 31, { 0.75f, 0.25f, 0.f }, { 0.f, 0.25f, 1.f } }, { 32, { 0.f, 0.75f, 0.25f }, { 0.f, 0.25f, 1.f } },
+                                                         { 33, { 0.5f, 0.75f, 0.f }, { -0.5f, -0.25f, -1.f } }, { 34, { 0.5f, 0.75f, 0.f }, { 0.5f, 0.25f, 1.f } }, { 35, { 1.f, 0.5f, 0.25f }, { 0.25f, 0.f, 1.f } },
+                                                         { 36, { 0.75f, 1.f, 0.25f }, { 0.f, 0.f, 1.f } }, { 37, { 0.25f, 0.f, 0.75f }, { 0.25f, 0.f, 1.f } }, { 38, { 0.75f, 0.f, 0.5f }, { 0.f, 0.f, 1.f } },
+                                                         { 39, { 1.f, 0.25f, 0.75f }, { 0.25f, 0.25f, 1.f } }, { 40, { 0.f, 0.5f, 0.75f }, { 0.f, 0.f, 1.f } }, { 41, { 0.625f, 0.625f, 0.625f }, { 0.f, 0.25f, 1.f } },
+                                                         { 42, { 0.625f, 0.625f, 0.625f }, { 0.5f, 0.f, 1.f } }, { 43, { 0.25f, 1.f, 0.5f }, { 0.25f, 0.f, 1.f } }, { 44, { 0.f, 0.25f, 1.25f }, { 0.f, 0.25f, 1.f } },
+                                                         { 45, { 0.5f, 0.25f, 1.f }, { -0.5f, -0.25f, -1.f } }, { 46, { 0.5f, 0.25f, 1.f }, { 0.5f, 0.25f, 1.f } }, { 47, { 1.f, 0.f, 1.25f }, { 0.25f, 0.f, 1.f } },
+                                                         { 48, { 0.25f, 0.75f, 1.f }, { 0.25f, 0.25f, 1.f } }, { 49, { 0.75f, 0.5f, 1.25f }, { 0.f, 0.f, 1.f } }, { 50, { 0.5f, 1.f, 1.25f }, { -0.5f, 0.f, -1.f } },
+                                                         { 51, { 0.5f, 1.f, 1.25f }, { 0.5f, 0.f, 1.f } }, { 52, { 1.f, 1.f, 1.f }, { 0.25f, 0.f, 1.f } }, { 53, { 0.5f, 0.f, 1.5f }, { -0.5f, 0.f, -1.f } },
+                                                         { 54, { 0.5f, 0.f, 1.5f }, { 0.5f, 0.f, 1.f } }, { 55, { 0.25f, 0.5f, 1.5f }, { 0.25f, 0.f, 1.f } }, { 56, { 1.f, 0.75f, 1.5f }, { 0.25f, 0.25f, 1.f } },
+                                                         { 57, { 0.f, 1.f, 1.5f }, { 0.f, 0.f, 1.f } } };
+
+// -----------------------------------------------------------------------------
+
+static bool testDecimateVoxel()
+{
+  bool status = true;
+
+  const auto fnTest = [&](int subdiv, float gridResolution, bool keepSharpEdges, bool expectSameCount)
+  {
+    tre::modelStaticIndexed3D model(tre::modelStaticIndexed3D::VB_NORMAL);
+    const std::size_t ipart = createBumpySphere(model, subdiv);
+    const std::size_t nTriIn = model.partInfo(ipart).m_size / 3;
+
+    const systemtick  tStart = systemclock::now();
+    const std::size_t ipartOut = tre::modelTools::decimateVoxel(model, ipart, gridResolution, keepSharpEdges);
+    const float       tDecimate = _elapsedMs(tStart);
+    if (ipartOut == std::size_t(-1)) { status = false; return; }
+
+    const tre::s_partInfo        &partOut = model.partInfo(ipartOut);
+    const tre::s_modelDataLayout &layout = model.layout();
+    const std::size_t nTriOut = partOut.m_size / 3;
+    std::size_t nDegenerated = 0;
+    for (std::size_t i = partOut.m_offset, iStop = partOut.m_offset + partOut.m_size; i < iStop; i += 3)
+    {
+      if (layout.m_index[i] == layout.m_index[i + 1] || layout.m_index[i] == layout.m_index[i + 2] || layout.m_index[i + 1] == layout.m_index[i + 2]) ++nDegenerated;
+    }
+
+    TRE_LOG("decimateVoxel: grid " << gridResolution << (keepSharpEdges ? " (sharp edges)" : "") << ", " << nTriIn << " -> " << nTriOut << " triangles, " <<
+            tDecimate << " ms, " << nDegenerated << " degenerated");
+    if (nDegenerated != 0 || nTriOut == 0) status = false;
+    if (expectSameCount ? (nTriOut != nTriIn) : (nTriOut * 4 > nTriIn)) status = false;
+  };
+
+  // the output must be identical to the reference (indices, and the position and normal of each vertex)
+
+  const auto fnTestReference = [&](bool keepSharpEdges, const unsigned *refIndices, std::size_t refIndexCount, const s_refVertex *refVertices, std::size_t refVertexCount)
+  {
+    tre::modelStaticIndexed3D model(tre::modelStaticIndexed3D::VB_NORMAL);
+    const std::size_t ipart = createSeamedHeightfield(model);
+    const std::size_t ipartOut = tre::modelTools::decimateVoxel(model, ipart, 0.45f, keepSharpEdges);
+    if (ipartOut == std::size_t(-1)) { status = false; return; }
+
+    const tre::s_partInfo        &partOut = model.partInfo(ipartOut);
+    const tre::s_modelDataLayout &layout = model.layout();
+    std::size_t nMismatch = (partOut.m_size != refIndexCount) ? 1 : 0;
+    for (std::size_t i = 0; i < refIndexCount && nMismatch == 0; ++i)
+    {
+      if (layout.m_index[partOut.m_offset + i] != refIndices[i]) ++nMismatch;
+    }
+    for (std::size_t iV = 0; iV < refVertexCount && nMismatch == 0; ++iV)
+    {
+      const s_refVertex &ref = refVertices[iV];
+      if (layout.m_positions.get<glm::vec3>(ref.index) != glm::vec3(ref.pos[0], ref.pos[1], ref.pos[2])) ++nMismatch;
+      if (layout.m_normals.get<glm::vec3>(ref.index) != glm::vec3(ref.normal[0], ref.normal[1], ref.normal[2])) ++nMismatch;
+    }
+
+    TRE_LOG("decimateVoxel: reference" << (keepSharpEdges ? " (sharp edges)" : "") << ", " << partOut.m_size / 3 << " triangles, " << nMismatch << " mismatch");
+    if (nMismatch != 0) status = false;
+  };
+
+  fnTestReference(false, k_refVoxelSmoothIndices, sizeof(k_refVoxelSmoothIndices) / sizeof(unsigned), k_refVoxelSmoothVertices, sizeof(k_refVoxelSmoothVertices) / sizeof(s_refVertex));
+  fnTestReference(true, k_refVoxelSharpIndices, sizeof(k_refVoxelSharpIndices) / sizeof(unsigned), k_refVoxelSharpVertices, sizeof(k_refVoxelSharpVertices) / sizeof(s_refVertex));
+
+  // counts and validity
+
+  fnTest(64, 0.1f, false, false);
+  fnTest(64, 0.1f, true, false);
+  fnTest(256, 0.04f, false, false);  // 260k triangles
+  fnTest(256, 1.e-5f, false, true);  // the dense grid would have 10^16 cells
+  fnTest(256, 1.e-5f, true, true);
+
+  return status;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool testDecimateQuadric()
+{
+  bool status = true;
+
+  // closed mesh: error-driven and count-driven, the volume is kept
+
+  const auto fnTestClosed = [&](int subdiv, std::size_t targetTriangleCount, float maxError, float maxVolumeError)
+  {
+    tre::modelStaticIndexed3D model(tre::modelStaticIndexed3D::VB_NORMAL);
+    const std::size_t ipart = createBumpySphere(model, subdiv);
+    const std::size_t nTriIn = model.partInfo(ipart).m_size / 3;
+    const float volumeIn = tre::modelTools::computeBarycenter3D(model.layout(), model.partInfo(ipart)).w;
+
+    const systemtick  tStart = systemclock::now();
+    const std::size_t ipartOut = tre::modelTools::decimateQuadric(model, ipart, targetTriangleCount, maxError);
+    const float       tDecimate = _elapsedMs(tStart);
+    if (ipartOut == std::size_t(-1)) { status = false; return; }
+
+    const std::size_t nTriOut = model.partInfo(ipartOut).m_size / 3;
+    const float volumeError = std::abs(tre::modelTools::computeBarycenter3D(model.layout(), model.partInfo(ipartOut)).w - volumeIn) / std::abs(volumeIn);
+    std::size_t nBoundaryEdges = 0;
+    const std::size_t nError = checkMeshTopology(model, ipartOut, nBoundaryEdges);
+
+    TRE_LOG("decimateQuadric: closed mesh, " << nTriIn << " -> " << nTriOut << " triangles, " << tDecimate << " ms (" <<
+            (nTriIn - nTriOut) / 2 / (tDecimate * 1.e3f) << " M collapses/s), volume error " << volumeError * 100.f << " %, " <<
+            nError << " topology error(s), " << nBoundaryEdges << " boundary edge(s)");
+    if (nError != 0 || nBoundaryEdges != 0 || volumeError > maxVolumeError) status = false;
+    if (targetTriangleCount != 0 && nTriOut > targetTriangleCount) status = false;
+    if (targetTriangleCount == 0 && nTriOut * 2 > nTriIn) status = false;
+  };
+
+  fnTestClosed(32, 400, 1.f, 0.05f);
+  fnTestClosed(64, 0, 2.e-3f, 0.01f);
+  fnTestClosed(256, 2600, 1.f, 0.01f);  // 260k triangles
+  fnTestClosed(512, 10000, 1.f, 0.01f); // 1M triangles
+
+  // mesh with an attribute-seam and a hole: the seam and the boundary are kept
+
+  {
+    tre::modelStaticIndexed3D model(tre::modelStaticIndexed3D::VB_NORMAL | tre::modelStaticIndexed3D::VB_COLOR);
+    const std::size_t ipartSphere = createBumpySphere(model, 48);
+    const std::size_t ipart = createSeamedPart(model, ipartSphere, 0.7f);
+    const std::size_t nTriIn = model.partInfo(ipart).m_size / 3;
+
+    std::size_t nBoundaryIn = 0;
+    const std::size_t nErrorIn = checkMeshTopology(model, ipart, nBoundaryIn);
+
+    const std::size_t targetTriangleCount = nTriIn / 10;
+    const std::size_t ipartOut = tre::modelTools::decimateQuadric(model, ipart, targetTriangleCount, 1.f);
+    if (ipartOut == std::size_t(-1)) return false;
+
+    const std::size_t nTriOut = model.partInfo(ipartOut).m_size / 3;
+    std::size_t nBoundaryOut = 0;
+    const std::size_t nErrorOut = checkMeshTopology(model, ipartOut, nBoundaryOut);
+
+    TRE_LOG("decimateQuadric: seamed mesh, " << nTriIn << " -> " << nTriOut << " triangles, " << nErrorIn << " -> " << nErrorOut << " topology error(s), " <<
+            nBoundaryIn << " -> " << nBoundaryOut << " boundary edge(s)");
+    if (nErrorIn != 0 || nErrorOut != 0 || nTriOut > targetTriangleCount || nBoundaryOut < 3 || nBoundaryOut > nBoundaryIn) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+/// Check a 2D triangulation: counter-clockwise triangles, no overlapping edge, the constrained edges exist (interior on the left-side),
+/// the other edges are locally Delaunay. Returns the number of errors, and the area.
+static std::size_t checkTriangulation(const std::vector<glm::vec2> &points, const std::vector<unsigned> &triangles, const std::vector<unsigned> &constrainedEdges, double &area)
+{
+  std::size_t nError = 0;
+  area = 0.;
+  if (triangles.empty() || triangles.size() % 3 != 0) return 1;
+
+  const auto fnPos = [&points](unsigned i) { return glm::dvec2(points[i]); };
+
+  std::vector<std::pair<uint64_t, std::size_t>> edges; // (edge, triangle)
+  edges.reserve(triangles.size());
+  for (std::size_t iT = 0; iT < triangles.size(); iT += 3)
+  {
+    const glm::dvec2 vAB = fnPos(triangles[iT + 1]) - fnPos(triangles[iT]);
+    const glm::dvec2 vAC = fnPos(triangles[iT + 2]) - fnPos(triangles[iT]);
+    const double     area2 = vAB.x * vAC.y - vAB.y * vAC.x;
+    if (!(area2 > 0.)) ++nError;
+    area += 0.5 * area2;
+    for (unsigned k = 0; k < 3; ++k)
+      edges.emplace_back(uint64_t(triangles[iT + k]) << 32 | triangles[iT + (k + 1) % 3], iT);
+  }
+  std::sort(edges.begin(), edges.end());
+  for (std::size_t iE = 1; iE < edges.size(); ++iE)
+  {
+    if (edges[iE].first == edges[iE - 1].first) ++nError;
+  }
+
+  const auto fnFindEdge = [&edges](uint64_t e) { const auto it = std::lower_bound(edges.begin(), edges.end(), std::make_pair(e, std::size_t(0))); return (it != edges.end() && it->first == e) ? it : edges.end(); };
+
+  std::vector<uint64_t> constrained;
+  for (std::size_t iE = 0; iE < constrainedEdges.size(); iE += 2)
+  {
+    const uint64_t e = uint64_t(constrainedEdges[iE]) << 32 | constrainedEdges[iE + 1];
+    if (fnFindEdge(e) == edges.end()) ++nError;
+    constrained.push_back(e);
+    constrained.push_back((e << 32) | (e >> 32));
+  }
+  std::sort(constrained.begin(), constrained.end());
+
+  for (const auto &e : edges)
+  {
+    if (std::binary_search(constrained.begin(), constrained.end(), e.first)) continue;
+    const auto itTwin = fnFindEdge((e.first << 32) | (e.first >> 32));
+    if (itTwin == edges.end()) continue; // boundary
+    unsigned iOpposite = triangles[itTwin->second];
+    for (unsigned k = 1; k < 3; ++k)
+    {
+      const unsigned iV = triangles[itTwin->second + k];
+      if (iV != unsigned(e.first) && iV != unsigned(e.first >> 32)) iOpposite = iV;
+    }
+    const glm::dvec2 vDA = fnPos(triangles[e.second + 0]) - fnPos(iOpposite);
+    const glm::dvec2 vDB = fnPos(triangles[e.second + 1]) - fnPos(iOpposite);
+    const glm::dvec2 vDC = fnPos(triangles[e.second + 2]) - fnPos(iOpposite);
+    const double     lDA = glm::dot(vDA, vDA), lDB = glm::dot(vDB, vDB), lDC = glm::dot(vDC, vDC);
+    const double     inCircle = lDA * (vDB.x * vDC.y - vDB.y * vDC.x) + lDB * (vDC.x * vDA.y - vDC.y * vDA.x) + lDC * (vDA.x * vDB.y - vDA.y * vDB.x);
+    if (inCircle > 1.e-9 * (lDA + lDB + lDC) * (lDA + lDB + lDC)) ++nError;
+  }
+
+  return nError;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool testTriangulate()
+{
+  bool status = true;
+
+  std::mt19937 rng(17);
+  std::uniform_real_distribution<float> rand01(0.f, 1.f);
+
+  std::vector<glm::vec2> points;
+  std::vector<unsigned>  constrainedEdges;
+  std::vector<unsigned>  triangles;
+
+  const auto fnAddContour = [&](const std::vector<glm::vec2> &contour)
+  {
+    const unsigned offset = unsigned(points.size());
+    for (std::size_t i = 0; i < contour.size(); ++i)
+    {
+      points.push_back(contour[i]);
+      constrainedEdges.push_back(offset + unsigned(i));
+      constrainedEdges.push_back(offset + unsigned((i + 1) % contour.size()));
+    }
+  };
+
+  // star polygon (envelop)
+
+  {
+    points.clear();
+    for (unsigned i = 0; i < 200; ++i)
+    {
+      const float angle = float(i) * 6.2831853f / 200.f;
+      const float radius = (i & 1) ? 0.3f : 1.f;
+      points.emplace_back(radius * std::cos(angle), radius * std::sin(angle));
+    }
+    tre::modelTools::triangulate(points, triangles);
+    constrainedEdges.clear();
+    for (unsigned i = 0; i < 200; ++i) { constrainedEdges.push_back(i); constrainedEdges.push_back((i + 1) % 200); }
+    double area;
+    const std::size_t nError = checkTriangulation(points, triangles, constrainedEdges, area);
+    const float       areaRef = tre::modelTools::computeBarycenter2D(points).z;
+    TRE_LOG("Triangulate: star, " << points.size() << " points -> " << triangles.size() / 3 << " triangles, area " << area << " (expected " << areaRef << "), " << nError << " error(s)");
+    if (nError != 0 || triangles.size() != 3 * (points.size() - 2) || std::abs(area - areaRef) > 1.e-5 * areaRef) status = false;
+  }
+
+  // square with holes, random points everywhere (also in the holes), points on the constrained edges and duplicated points
+
+  {
+    points.clear();
+    constrainedEdges.clear();
+    std::vector<glm::vec2> contour;
+    for (unsigned side = 0; side < 4; ++side)
+    {
+      for (unsigned i = 0; i < 10; ++i)
+      {
+        const float t = float(i) / 10.f;
+        const glm::vec2 pt = (side == 0) ? glm::vec2(t, 0.f) : (side == 1) ? glm::vec2(1.f, t) : (side == 2) ? glm::vec2(1.f - t, 1.f) : glm::vec2(0.f, 1.f - t);
+        contour.push_back(pt);
+      }
+    }
+    fnAddContour(contour); // counter-clockwise boundary
+    fnAddContour({ glm::vec2(0.25f, 0.25f), glm::vec2(0.25f, 0.75f), glm::vec2(0.5f, 0.75f), glm::vec2(0.5f, 0.25f) }); // clockwise hole
+    fnAddContour({ glm::vec2(0.6f, 0.1f), glm::vec2(0.7f, 0.9f), glm::vec2(0.9f, 0.1f) }); // clockwise hole
+    const float areaRef = 1.f - 0.25f * 0.5f - 0.5f * 0.3f * 0.8f;
+
+    points.emplace_back(0.25f, 0.5f); // on the hole's edge
+    points.emplace_back(0.375f, 0.25f); // on the hole's edge
+    points.emplace_back(0.5f, 0.5f);
+    for (unsigned i = 0; i < 5000; ++i) points.emplace_back(rand01(rng), rand01(rng));
+    for (unsigned i = 0; i < 50; ++i) points.push_back(points[points.size() - 1 - 2 * i]);
+
+    const systemtick tStart = systemclock::now();
+    tre::modelTools::triangulate(points, constrainedEdges, triangles);
+    const float tTri = _elapsedMs(tStart);
+
+    // (the constrained edges with a point on them are split)
+    std::vector<unsigned> constrainedEdgesCheck;
+    for (std::size_t iE = 0; iE < constrainedEdges.size(); iE += 2)
+    {
+      const glm::vec2 ptA = points[constrainedEdges[iE]], ptB = points[constrainedEdges[iE + 1]];
+      const bool isSplit = (ptA.x == 0.25f && ptB.x == 0.25f) || (ptA.y == 0.25f && ptB.y == 0.25f && ptA.x != 0.6f) || (ptA.x == 0.5f && ptB.x == 0.5f);
+      if (!isSplit) { constrainedEdgesCheck.push_back(constrainedEdges[iE]); constrainedEdgesCheck.push_back(constrainedEdges[iE + 1]); }
+    }
+    double area;
+    const std::size_t nError = checkTriangulation(points, triangles, constrainedEdgesCheck, area);
+    TRE_LOG("Triangulate: square with 2 holes, " << points.size() << " points -> " << triangles.size() / 3 << " triangles, " << tTri << " ms, area " << area <<
+            " (expected " << areaRef << "), " << nError << " error(s)");
+    if (nError != 0 || std::abs(area - areaRef) > 1.e-5 * areaRef) status = false;
+  }
+
+  // regular grid (co-circular and collinear points), shuffled
+
+  {
+    points.clear();
+    for (unsigned i = 0; i <= 256; ++i)
+      for (unsigned j = 0; j <= 256; ++j) points.emplace_back(float(i) / 256.f, float(j) / 256.f);
+    std::shuffle(points.begin(), points.end(), rng);
+
+    tre::modelTools::triangulate(points, std::vector<unsigned>(), triangles);
+    double area;
+    const std::size_t nError = checkTriangulation(points, triangles, std::vector<unsigned>(), area);
+    TRE_LOG("Triangulate: grid, " << points.size() << " points -> " << triangles.size() / 3 << " triangles, area " << area << ", " << nError << " error(s)");
+    if (nError != 0 || triangles.size() != 3 * 2 * 256 * 256 || std::abs(area - 1.) > 1.e-5) status = false;
+  }
+
+  // random points (convex hull)
+
+  const auto fnTestCloud = [&](std::size_t nPoints)
+  {
+    points.resize(nPoints);
+    for (glm::vec2 &pt : points) pt = glm::vec2(rand01(rng), rand01(rng));
+    points[0] = glm::vec2(0.f, 0.f);
+    points[1] = glm::vec2(1.f, 0.f);
+    points[2] = glm::vec2(1.f, 1.f);
+    points[3] = glm::vec2(0.f, 1.f);
+
+    const systemtick tStart = systemclock::now();
+    tre::modelTools::triangulate(points, std::vector<unsigned>(), triangles);
+    const float tTri = _elapsedMs(tStart);
+
+    double area;
+    const std::size_t nError = checkTriangulation(points, triangles, std::vector<unsigned>(), area);
+    TRE_LOG("Triangulate: random, " << nPoints << " points -> " << triangles.size() / 3 << " triangles, " << tTri << " ms, area " << area << ", " << nError << " error(s)");
+    if (nError != 0 || std::abs(area - 1.) > 1.e-5) status = false;
+  };
+
+  fnTestCloud(1000);
+  fnTestCloud(100000);
+  fnTestCloud(1000000);
+
+  return status;
+}
+
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  bool status = true;
+
+  status &= testConvexHull();
+  status &= testTetrahedralize();
+  status &= testDecimateQuadric();
+  status &= testDecimateVoxel();
+  status &= testTriangulate();
+
+  TRE_LOG("Quit.");
+
+  return (status ? 0 : -1);
+}
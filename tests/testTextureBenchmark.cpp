@@ -0,0 +1,685 @@
+#include "tre_utils.h"
+#include "tre_texture.h"
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
+// =============================================================================
+
+/// Generate a surface with smooth gradients, sharp edges and noise (RGB24 or RGBA32).
+static SDL_Surface *genSurface(int w, int h, bool withAlpha)
+{
+  SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, w, h, withAlpha ? 32 : 24, withAlpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24);
+  if (surf == nullptr) return nullptr;
+
+  const int pxByteSize = surf->format->BytesPerPixel;
+  uint32_t  randState = 0x2545F491u;
+  for (int y = 0; y < h; ++y)
+  {
+    uint8_t *row = static_cast<uint8_t*>(surf->pixels) + y * surf->pitch;
+    for (int x = 0; x < w; ++x)
+    {
+      randState ^= randState << 13;
+      randState ^= randState >> 17;
+      randState ^= randState << 5;
+      const bool edge = ((x / 64 + y / 64) % 3) == 0;
+      for (int c = 0; c < pxByteSize; ++c)
+      {
+        const float smooth = 127.f + 120.f * std::sin(0.013f * float(x) * float(c + 1) + 0.021f * float(y));
+        const int   noise = int((randState >> (c * 8)) & 0x0F) - 8;
+        const int   value = int(edge ? 255.f - smooth : smooth) + noise;
+        row[x * pxByteSize + c] = uint8_t(glm::clamp(value, 0, 255));
+      }
+    }
+  }
+  return surf;
+}
+
+// =============================================================================
+
+static bool testCompression()
+{
+  bool status = true;
+
+  const auto fnBench = [&](const char *name, int w, int h, bool withAlpha, std::size_t expectedByteSize, unsigned nRuns)
+  {
+    SDL_Surface *surf = genSurface(w, h, withAlpha);
+    if (surf == nullptr) { status = false; return; }
+
+    std::string outRef;
+    float       tBest = std::numeric_limits<float>::infinity();
+    bool        deterministic = true;
+    for (unsigned iRun = 0; iRun < nRuns; ++iRun)
+    {
+      std::ostringstream out;
+      const systemtick tStart = systemclock::now();
+      const bool       success = tre::texture::write(out, surf, tre::texture::MMASK_COMPRESS, false);
+      tBest = std::min(tBest, _elapsedMs(tStart));
+      status &= success;
+      if (iRun == 0) outRef = out.str();
+      else           deterministic &= (out.str() == outRef);
+    }
+
+    const std::size_t headerByteSize = 8 * sizeof(int32_t) + sizeof(unsigned);
+    const std::size_t outByteSize = outRef.size() - headerByteSize;
+
+    TRE_LOG("Texture compression " << name << ": " << w << " x " << h << ", " << outByteSize << " bytes, " <<
+            tBest << " ms, " << float(w) * float(h) / (tBest * 1.e3f) << " Mpx/s (" << tre::parallelThreadCount() << " threads)" <<
+            (deterministic ? "" : ", NOT DETERMINISTIC"));
+    if (outByteSize != expectedByteSize || !deterministic) status = false;
+
+    SDL_FreeSurface(surf);
+  };
+
+  fnBench("RGB  -> DXT1", 2048, 2048, false, 2048 * 2048 / 2, 5);
+  fnBench("RGBA -> DXT3", 2048, 2048, true , 2048 * 2048    , 5);
+  fnBench("RGB  -> DXT1", 4096, 4096, false, 4096 * 4096 / 2, 2);
+  fnBench("RGBA -> DXT3", 4096, 4096, true , 4096 * 4096    , 2);
+
+  return status;
+}
+
+// =============================================================================
+
+#ifndef TRE_OPENGL_ES
+
+/// Decode a RGTC block (BC4) into 16 values [0-255] (row-major).
+static void decodeBlock_RGTC(const uint8_t *block, float values[16])
+{
+  const int red0 = block[0];
+  const int red1 = block[1];
+  float     palette[8] = { float(red0), float(red1), 0.f, 0.f, 0.f, 0.f, 0.f, 255.f };
+  if (red0 > red1)
+  {
+    for (int k = 1; k < 7; ++k) palette[k + 1] = float((7 - k) * red0 + k * red1) / 7.f;
+  }
+  else
+  {
+    for (int k = 1; k < 5; ++k) palette[k + 1] = float((5 - k) * red0 + k * red1) / 5.f;
+  }
+  uint64_t indices = 0;
+  for (int k = 0; k < 6; ++k) indices |= uint64_t(block[2 + k]) << (k * 8);
+  for (int i = 0; i < 16; ++i) values[i] = palette[(indices >> (i * 3)) & 0x7];
+}
+
+#else
+
+/// Decode an EAC R11 block into 16 values [0-255] (row-major).
+static void decodeBlock_R11_EAC(const uint8_t *block, float values[16])
+{
+  static const int modifiers[16][8] = { {-3, -6,  -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12}, {-2, -4, -6, -13, 1, 3, 5, 12},
+                                        {-3, -6,  -8, -12, 2, 5, 7, 11}, {-3, -7,  -9, -11, 2, 6, 8, 10}, {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},
+                                        {-2, -6,  -8, -10, 1, 5, 7,  9}, {-2, -5,  -8, -10, 1, 4, 7,  9}, {-2, -4, -8, -10, 1, 3, 7,  9}, {-2, -5, -7, -10, 1, 4, 6,  9},
+                                        {-3, -4,  -7, -10, 2, 3, 6,  9}, {-1, -2,  -3, -10, 0, 1, 2,  9}, {-4, -6, -8,  -9, 3, 5, 7,  8}, {-3, -5, -7,  -9, 2, 4, 6,  8} };
+  uint64_t bits = 0;
+  for (int k = 0; k < 8; ++k) bits = (bits << 8) | block[k];
+  const int base11 = int(bits >> 56) * 8 + 4;
+  const int multiplier = int(bits >> 52) & 0xF;
+  const int tid = int(bits >> 48) & 0xF;
+  for (int i = 0; i < 16; ++i) // column-major
+  {
+    const int value11 = glm::clamp(base11 + modifiers[tid][(bits >> (45 - i * 3)) & 0x7] * (multiplier == 0 ? 1 : multiplier * 8), 0, 2047);
+    values[(i % 4) * 4 + (i / 4)] = float(value11) * 255.f / 2047.f;
+  }
+}
+
+#endif
+
+static bool testCompressionChannels()
+{
+  bool status = true;
+
+#ifdef TRE_OPENGL_ES
+  const auto        fnDecodeBlock = decodeBlock_R11_EAC;
+  const char *const formatNames[2] = { "R11_EAC", "RG11_EAC" };
+#else
+  const auto        fnDecodeBlock = decodeBlock_RGTC;
+  const char *const formatNames[2] = { "RGTC1", "RGTC2" };
+#endif
+
+  // The channels are compared to the uncompressed source (RGB24 surface, the 1-channel texture takes the red channel).
+
+  const auto fnBench = [&](int w, int h, int channelCount)
+  {
+    SDL_Surface *surf = genSurface(w, h, false);
+    if (surf == nullptr) { status = false; return; }
+
+    const int modemask = tre::texture::MMASK_COMPRESS | (channelCount == 1 ? tre::texture::MMASK_ALPHA_ONLY : tre::texture::MMASK_RG_ONLY);
+
+    std::ostringstream out;
+    const systemtick   tStart = systemclock::now();
+    status &= tre::texture::write(out, surf, modemask, false);
+    const float        tElapsed = _elapsedMs(tStart);
+
+    const std::string outStr = out.str();
+    const std::size_t headerByteSize = 8 * sizeof(int32_t) + sizeof(unsigned);
+    const std::size_t blockCountX = std::size_t(w / 4), blockCountY = std::size_t(h / 4);
+    const std::size_t expectedByteSize = blockCountX * blockCountY * 8 * channelCount;
+    if (outStr.size() != headerByteSize + expectedByteSize)
+    {
+      TRE_LOG("Texture compression " << formatNames[channelCount - 1] << ": invalid size (" << outStr.size() - headerByteSize << " bytes, expecting " << expectedByteSize << " bytes)");
+      status = false;
+      SDL_FreeSurface(surf);
+      return;
+    }
+
+    const uint8_t *blocks = reinterpret_cast<const uint8_t*>(outStr.data() + headerByteSize);
+    double         errorSq = 0.;
+    float          errorMax = 0.f;
+    for (std::size_t jb = 0; jb < blockCountY; ++jb)
+    {
+      for (std::size_t ib = 0; ib < blockCountX; ++ib)
+      {
+        for (int c = 0; c < channelCount; ++c)
+        {
+          float decoded[16];
+          fnDecodeBlock(blocks + ((jb * blockCountX + ib) * channelCount + c) * 8, decoded);
+          for (std::size_t j = 0; j < 4; ++j)
+          {
+            const uint8_t *row = static_cast<const uint8_t*>(surf->pixels) + (jb * 4 + j) * surf->pitch;
+            for (std::size_t i = 0; i < 4; ++i)
+            {
+              const float diff = std::abs(decoded[j * 4 + i] - float(row[(ib * 4 + i) * 3 + c]));
+              errorSq += double(diff * diff);
+              errorMax = std::max(errorMax, diff);
+            }
+          }
+        }
+      }
+    }
+    const double errorRMS = std::sqrt(errorSq / (double(w) * double(h) * channelCount));
+    const double psnr = 20. * std::log10(255. / std::max(errorRMS, 1.e-6));
+
+    TRE_LOG("Texture compression " << formatNames[channelCount - 1] << ": " << w << " x " << h << ", " <<
+            tElapsed << " ms, " << float(w) * float(h) / (tElapsed * 1.e3f) << " Mpx/s, " <<
+            "RMS error = " << errorRMS << ", max error = " << errorMax << ", PSNR = " << psnr << " dB");
+    if (psnr < 40. || errorMax > 16.f) status = false;
+
+    SDL_FreeSurface(surf);
+  };
+
+  fnBench(1024, 1024, 1);
+  fnBench(1024, 1024, 2);
+  fnBench(2048, 2048, 1);
+  fnBench(2048, 2048, 2);
+
+  return status;
+}
+
+// =============================================================================
+
+static bool testMipChain()
+{
+  bool status = true;
+
+  const std::size_t headerByteSize = 8 * sizeof(int32_t);
+
+  // The levels are read from the baked stream: [byte-size, pixels] for each level, down to 1x1.
+
+  const auto fnReadLevels = [](const std::string &outStr, std::vector<std::string> &levels)
+  {
+    std::size_t offset = headerByteSize;
+    while (offset + sizeof(unsigned) <= outStr.size())
+    {
+      unsigned byteSize = 0;
+      memcpy(&byteSize, outStr.data() + offset, sizeof(unsigned));
+      offset += sizeof(unsigned);
+      if (offset + byteSize > outStr.size()) return false;
+      levels.push_back(outStr.substr(offset, byteSize));
+      offset += byteSize;
+    }
+    return offset == outStr.size();
+  };
+
+  // Uncompressed, black and white checkerboard: the averaged levels are gray, gamma-corrected with sRGB.
+
+  for (const bool srgb : { false, true })
+  {
+    const int    w = 64, h = 16;
+    SDL_Surface *surf = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surf == nullptr) return false;
+    for (int y = 0; y < h; ++y)
+    {
+      uint32_t *row = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surf->pixels) + y * surf->pitch);
+      for (int x = 0; x < w; ++x) row[x] = ((x + y) & 1) ? 0xFFFFFFFF : 0xFF000000;
+    }
+
+    std::ostringstream out;
+    status &= tre::texture::write(out, surf, tre::texture::MMASK_MIPMAP | (srgb ? tre::texture::MMASK_SRBG_SPACE : 0), true);
+
+    std::vector<std::string> levels;
+    const bool               validStream = fnReadLevels(out.str(), levels);
+    const uint8_t            expectedGray = srgb ? 188 : 128;
+    int                      grayErrorMax = 0;
+    bool                     validSizes = (levels.size() == 7);
+    for (std::size_t level = 0; level < levels.size(); ++level)
+    {
+      const std::size_t wLevel = std::max(w >> level, 1), hLevel = std::max(h >> level, 1);
+      validSizes &= (levels[level].size() == wLevel * hLevel * 4);
+      if (level == 0) continue;
+      for (std::size_t ip = 0; ip < levels[level].size(); ++ip)
+      {
+        const int expected = (ip % 4 == 3) ? 255 : expectedGray;
+        grayErrorMax = std::max(grayErrorMax, std::abs(int(uint8_t(levels[level][ip])) - expected));
+      }
+    }
+
+    TRE_LOG("Mip-chain of checkerboard " << w << " x " << h << (srgb ? " (sRGB)" : "") << ": " << levels.size() << " levels, " <<
+            "max error on gray = " << grayErrorMax);
+    if (!validStream || !validSizes || grayErrorMax > 1) status = false;
+  }
+
+  // Compressed: each level is compressed (the levels smaller than a block are stored in a single block).
+
+  for (const bool withAlpha : { false, true })
+  {
+    const int    w = 512, h = 128;
+    SDL_Surface *surf = genSurface(w, h, withAlpha);
+    if (surf == nullptr) return false;
+
+    std::ostringstream out;
+    const systemtick   tStart = systemclock::now();
+    status &= tre::texture::write(out, surf, tre::texture::MMASK_MIPMAP | tre::texture::MMASK_COMPRESS | tre::texture::MMASK_SRBG_SPACE, true);
+    const float        tElapsed = _elapsedMs(tStart);
+
+    std::vector<std::string> levels;
+    const bool               validStream = fnReadLevels(out.str(), levels);
+    const std::size_t        blockByteSize = withAlpha ? 16 : 8;
+    bool                     validSizes = (levels.size() == 10);
+    for (std::size_t level = 0; level < levels.size(); ++level)
+    {
+      const std::size_t wLevel = std::max(w >> level, 1), hLevel = std::max(h >> level, 1);
+      validSizes &= (levels[level].size() == ((wLevel + 3) / 4) * ((hLevel + 3) / 4) * blockByteSize);
+    }
+
+    TRE_LOG("Mip-chain compressed " << (withAlpha ? "RGBA" : "RGB ") << " " << w << " x " << h << ": " << levels.size() << " levels, " <<
+            out.str().size() << " bytes, " << tElapsed << " ms");
+    if (!validStream || !validSizes) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+/// Decode RGB9E5 (EXT_texture_shared_exponent).
+static glm::vec3 decodeRGB9E5(uint32_t packed)
+{
+  const float scale = std::ldexp(1.f, int(packed >> 27) - 15 - 9);
+  return glm::vec3(float(packed & 0x1FF), float((packed >> 9) & 0x1FF), float((packed >> 18) & 0x1FF)) * scale;
+}
+
+/// Encode RGB9E5, reference implementation from the specification (EXT_texture_shared_exponent).
+static uint32_t encodeRGB9E5(const glm::vec3 &rgb)
+{
+  const float sharedExpMax = 65408.f;
+  const float rc = std::isnan(rgb.r) ? 0.f : glm::clamp(rgb.r, 0.f, sharedExpMax);
+  const float gc = std::isnan(rgb.g) ? 0.f : glm::clamp(rgb.g, 0.f, sharedExpMax);
+  const float bc = std::isnan(rgb.b) ? 0.f : glm::clamp(rgb.b, 0.f, sharedExpMax);
+  const float maxc = std::max(std::max(rc, gc), bc);
+  int         expShared = std::max(-16, (maxc > 0.f) ? int(std::floor(std::log2(maxc))) : -16) + 16;
+  float       denom = std::ldexp(1.f, expShared - 15 - 9);
+  if (int(std::floor(maxc / denom + 0.5f)) == 512)
+  {
+    denom *= 2.f;
+    ++expShared;
+  }
+  const uint32_t rm = uint32_t(std::floor(rc / denom + 0.5f));
+  const uint32_t gm = uint32_t(std::floor(gc / denom + 0.5f));
+  const uint32_t bm = uint32_t(std::floor(bc / denom + 0.5f));
+  return rm | (gm << 9) | (bm << 18) | (uint32_t(expShared) << 27);
+}
+
+/// Decode an unsigned float with a 5-bits exponent (EXT_packed_float).
+static float decodeSmallFloat(uint32_t packed, int mantissaBits)
+{
+  const int      exponent = int(packed >> mantissaBits);
+  const uint32_t mantissa = packed & ((1u << mantissaBits) - 1);
+  if (exponent == 0) return std::ldexp(float(mantissa), -14 - mantissaBits);
+  if (exponent == 31) return (mantissa == 0) ? std::numeric_limits<float>::infinity() : std::numeric_limits<float>::quiet_NaN();
+  return std::ldexp(float(mantissa | (1u << mantissaBits)), exponent - 15 - mantissaBits);
+}
+
+/// Decode R11G11B10F (EXT_packed_float).
+static glm::vec3 decodeR11G11B10F(uint32_t packed)
+{
+  return glm::vec3(decodeSmallFloat(packed & 0x7FF, 6), decodeSmallFloat((packed >> 11) & 0x7FF, 6), decodeSmallFloat(packed >> 22, 5));
+}
+
+static bool testHDRPacking()
+{
+  bool status = true;
+
+  const std::size_t headerByteSize = 8 * sizeof(int32_t);
+
+  // HDR image: values on the full range of the formats (log-uniform), with a few special values.
+
+  const int              w = 2048, h = 1024;
+  std::vector<glm::vec4> pixels(std::size_t(w) * std::size_t(h));
+  uint32_t               randState = 0x2545F491u;
+  for (glm::vec4 &px : pixels)
+  {
+    for (int c = 0; c < 4; ++c)
+    {
+      randState ^= randState << 13;
+      randState ^= randState >> 17;
+      randState ^= randState << 5;
+      px[c] = std::exp2(float(randState & 0xFFFF) / 65535.f * 40.f - 24.f); // [2^-24, 2^16]
+    }
+  }
+  const float specialValues[] = { 0.f, -1.f, -0.f, std::numeric_limits<float>::quiet_NaN(), std::numeric_limits<float>::infinity(),
+                                  65408.f, 65024.f, 64512.f, 65504.f, 1.f, 0.5f, 1.f / 16384.f, 1.f / 32768.f, 1.e-7f, 1.e-9f, 3.14159f };
+  for (std::size_t i = 0; i < sizeof(specialValues) / sizeof(float); ++i)
+  {
+    pixels[i] = glm::vec4(specialValues[i], 1.f, 0.f, 1.f);
+    pixels[i + 16] = glm::vec4(0.f, specialValues[i], 1.f, 1.f);
+    pixels[i + 32] = glm::vec4(1.f, 0.f, specialValues[i], 1.f);
+  }
+
+  const auto fnSanitize = [](float v, float vMax) { return std::isnan(v) ? 0.f : glm::clamp(v, 0.f, vMax); };
+
+  for (const int modemask : { tre::texture::MMASK_HDR_RGB9E5, tre::texture::MMASK_HDR_R11G11B10F })
+  {
+    const bool isRGB9E5 = (modemask == tre::texture::MMASK_HDR_RGB9E5);
+
+    std::ostringstream out;
+    const systemtick   tStart = systemclock::now();
+    status &= tre::texture::writeFloat(out, pixels.data(), w, h, modemask);
+    const float        tElapsed = _elapsedMs(tStart);
+
+    const std::string outStr = out.str();
+    const std::size_t expectedByteSize = headerByteSize + sizeof(unsigned) + pixels.size() * sizeof(uint32_t);
+    if (outStr.size() != expectedByteSize)
+    {
+      TRE_LOG("HDR packing " << (isRGB9E5 ? "RGB9E5" : "R11G11B10F") << ": invalid size (" << outStr.size() << " bytes, expecting " << expectedByteSize << " bytes)");
+      status = false;
+      continue;
+    }
+
+    const char *packedData = outStr.data() + headerByteSize + sizeof(unsigned);
+    float       errorMax = 0.f; // relative error
+    std::size_t mismatchCount = 0;
+    for (std::size_t ip = 0; ip < pixels.size(); ++ip)
+    {
+      uint32_t packed;
+      memcpy(&packed, packedData + ip * sizeof(uint32_t), sizeof(uint32_t));
+      const glm::vec3 rgb = glm::vec3(pixels[ip]);
+      if (isRGB9E5)
+      {
+        // bit-exact with the reference. The error is relative to the max channel (shared exponent).
+        if (packed != encodeRGB9E5(rgb)) ++mismatchCount;
+        const glm::vec3 decoded = decodeRGB9E5(packed);
+        const glm::vec3 ref = glm::vec3(fnSanitize(rgb.r, 65408.f), fnSanitize(rgb.g, 65408.f), fnSanitize(rgb.b, 65408.f));
+        const float     refMax = std::max(std::max(ref.r, ref.g), std::max(ref.b, std::ldexp(1.f, -15))); // below 2^-15: the exponent is clamped
+        const glm::vec3 diff = glm::abs(decoded - ref);
+        errorMax = std::max(errorMax, std::max(std::max(diff.r, diff.g), diff.b) / refMax);
+      }
+      else
+      {
+        // the error is relative to each channel (absolute for denormals)
+        const glm::vec3 decoded = decodeR11G11B10F(packed);
+        const glm::vec3 ref = glm::vec3(fnSanitize(rgb.r, 65024.f), fnSanitize(rgb.g, 65024.f), fnSanitize(rgb.b, 64512.f));
+        for (int c = 0; c < 3; ++c)
+        {
+          const float error = std::abs(decoded[c] - ref[c]) / std::max(ref[c], 1.f / 16384.f);
+          errorMax = std::max(errorMax, (c == 2) ? error * 0.5f : error); // normalized to the 6-bits mantissa
+          if (std::isnan(decoded[c]) || std::isinf(decoded[c])) ++mismatchCount;
+        }
+      }
+    }
+
+    // half an ulp of the mantissa: 2^-9 (RGB9E5, relative to the max channel), 2^-7 (R11, G11) and 2^-6 (B10, normalized to 2^-7)
+    const float errorTolerance = isRGB9E5 ? 1.f / 512.f : 1.f / 128.f;
+    TRE_LOG("HDR packing " << (isRGB9E5 ? "RGB9E5    " : "R11G11B10F") << ": " << w << " x " << h << ", " <<
+            tElapsed << " ms, " << float(w) * float(h) / (tElapsed * 1.e3f) << " Mpx/s, " <<
+            "max relative error = " << errorMax << " (tolerance " << errorTolerance << "), mismatch = " << mismatchCount);
+    if (errorMax > errorTolerance || mismatchCount != 0) status = false;
+  }
+
+  // Mip-chain: a constant image gives constant levels.
+
+  {
+    const int              wm = 64, hm = 16;
+    const glm::vec4        color = glm::vec4(3.5f, 100.f, 0.01f, 1.f);
+    std::vector<glm::vec4> pixelsMip(std::size_t(wm) * std::size_t(hm), color);
+
+    std::ostringstream out;
+    status &= tre::texture::writeFloat(out, pixelsMip.data(), wm, hm, tre::texture::MMASK_HDR_R11G11B10F | tre::texture::MMASK_MIPMAP);
+
+    const std::string outStr = out.str();
+    std::size_t       offset = headerByteSize;
+    std::size_t       levelCount = 0;
+    float             errorMax = 0.f;
+    bool              validSizes = true;
+    while (offset + sizeof(unsigned) <= outStr.size())
+    {
+      unsigned byteSize = 0;
+      memcpy(&byteSize, outStr.data() + offset, sizeof(unsigned));
+      offset += sizeof(unsigned);
+      const std::size_t wLevel = std::max(wm >> levelCount, 1), hLevel = std::max(hm >> levelCount, 1);
+      validSizes &= (byteSize == wLevel * hLevel * sizeof(uint32_t)) && (offset + byteSize <= outStr.size());
+      if (!validSizes) break;
+      for (std::size_t ip = 0; ip < wLevel * hLevel; ++ip)
+      {
+        uint32_t packed;
+        memcpy(&packed, outStr.data() + offset + ip * sizeof(uint32_t), sizeof(uint32_t));
+        const glm::vec3 diff = glm::abs(decodeR11G11B10F(packed) - glm::vec3(color)) / glm::vec3(color);
+        errorMax = std::max(errorMax, std::max(std::max(diff.r, diff.g), diff.b));
+      }
+      offset += byteSize;
+      ++levelCount;
+    }
+
+    TRE_LOG("HDR mip-chain R11G11B10F " << wm << " x " << hm << ": " << levelCount << " levels, max relative error = " << errorMax);
+    if (!validSizes || offset != outStr.size() || levelCount != 7 || errorMax > 1.f / 64.f) status = false;
+  }
+
+  // Cubemap: 6 faces with their mip-chain.
+
+  {
+    const int                              size = 32;
+    std::vector<glm::vec4>                 face(std::size_t(size) * std::size_t(size), glm::vec4(1.f));
+    const std::array<const glm::vec4*, 6>  faces = { face.data(), face.data(), face.data(), face.data(), face.data(), face.data() };
+
+    std::ostringstream out;
+    status &= tre::texture::writeCubeFloat(out, faces, size, tre::texture::MMASK_HDR_RGB9E5 | tre::texture::MMASK_MIPMAP);
+
+    std::size_t levelsByteSize = 0;
+    for (int level = 0; level < 6; ++level) levelsByteSize += sizeof(unsigned) + std::size_t(size >> level) * std::size_t(size >> level) * sizeof(uint32_t);
+    const std::size_t expectedByteSize = headerByteSize + 6 * levelsByteSize;
+
+    TRE_LOG("HDR cubemap RGB9E5 " << size << " x " << size << ": " << out.str().size() << " bytes (expecting " << expectedByteSize << " bytes)");
+    if (out.str().size() != expectedByteSize) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+static bool testAtlas()
+{
+  bool status = true;
+
+  // Random sizes: square icons and heterogeneous sprites.
+
+  const auto fnGenSizes = [](std::size_t count, std::vector<glm::ivec2> &sizes)
+  {
+    uint32_t randState = 0x2545F491u;
+    const auto fnRand = [&randState](int vmin, int vmax)
+    {
+      randState ^= randState << 13;
+      randState ^= randState >> 17;
+      randState ^= randState << 5;
+      return vmin + int(randState % uint32_t(vmax - vmin + 1));
+    };
+    sizes.resize(count);
+    for (glm::ivec2 &size : sizes)
+    {
+      if (fnRand(0, 1) == 0) size = glm::ivec2(8 << fnRand(0, 3)); // icons 8, 16, 32, 64
+      else                   size = glm::ivec2(fnRand(4, 96), fnRand(4, 96));
+    }
+  };
+
+  // The packed rectangles (with padding) must be in the atlas, aligned, and must not overlap.
+
+  const auto fnValidate = [](const tre::textureAtlas &atlas, const std::vector<glm::ivec4> &rects, const tre::textureAtlas::s_settings &settings)
+  {
+    const int padding = int(settings.m_padding), alignment = int(settings.m_alignment);
+    std::vector<glm::ivec4> reserved;
+    for (const glm::ivec4 &r : rects)
+    {
+      if (r.x < 0) continue;
+      const glm::ivec4 res = glm::ivec4(r.x - padding, r.y - padding, r.z + 2 * padding, r.w + 2 * padding);
+      if (res.x < 0 || res.y < 0 || res.x + res.z > atlas.w() || res.y + res.w > atlas.usedHeight()) return false;
+      if ((res.x % alignment) != 0 || (res.y % alignment) != 0) return false;
+      reserved.push_back(res);
+    }
+    std::sort(reserved.begin(), reserved.end(), [](const glm::ivec4 &a, const glm::ivec4 &b) { return a.x < b.x; });
+    for (std::size_t i = 0; i < reserved.size(); ++i)
+    {
+      for (std::size_t j = i + 1; j < reserved.size() && reserved[j].x < reserved[i].x + reserved[i].z; ++j)
+      {
+        if (reserved[j].y < reserved[i].y + reserved[i].w && reserved[i].y < reserved[j].y + reserved[j].w) return false;
+      }
+    }
+    return true;
+  };
+
+  static const char *packingNames[3] = { "auto    ", "skyline ", "maxrects" };
+
+  for (const std::size_t count : { 1000, 4000 })
+  {
+    std::vector<glm::ivec2> sizes;
+    fnGenSizes(count, sizes);
+
+    for (const tre::textureAtlas::e_packing packing : { tre::textureAtlas::PACK_SKYLINE, tre::textureAtlas::PACK_MAXRECTS, tre::textureAtlas::PACK_AUTO })
+    {
+      tre::textureAtlas::s_settings settings;
+      settings.m_packing = packing;
+      settings.m_padding = 1;
+      settings.m_alignment = 4;
+
+      tre::textureAtlas       atlas;
+      std::vector<glm::ivec4> rects;
+      const systemtick        tStart = systemclock::now();
+      const bool              success = atlas.resetFit(sizes, rects, settings);
+      const float             tElapsed = _elapsedMs(tStart);
+
+      const bool  valid = success && fnValidate(atlas, rects, settings);
+      const float density = atlas.occupancy() * float(atlas.h()) / float(std::max(atlas.usedHeight(), 1));
+
+      TRE_LOG("Atlas " << packingNames[packing] << " (padding 1, alignment 4): " << count << " rectangles into " << atlas.w() << " x " << atlas.usedHeight() <<
+              " (" << packingNames[atlas.packing()] << "), " << tElapsed << " ms, density = " << density << (valid ? "" : " INVALID"));
+      if (!valid || (packing != tre::textureAtlas::PACK_MAXRECTS && density < 0.75f)) status = false; // the max-rects is not bottom-left: it spreads over the atlas
+    }
+  }
+
+  // Fixed atlas, too small for all the rectangles: the heuristic keeps the packer that packs the most.
+
+  {
+    std::vector<glm::ivec2> sizes;
+    fnGenSizes(2000, sizes);
+
+    for (const tre::textureAtlas::e_packing packing : { tre::textureAtlas::PACK_SKYLINE, tre::textureAtlas::PACK_MAXRECTS, tre::textureAtlas::PACK_AUTO })
+    {
+      tre::textureAtlas::s_settings settings;
+      settings.m_packing = packing;
+
+      tre::textureAtlas       atlas(1024, 1024, settings);
+      std::vector<glm::ivec4> rects;
+      const systemtick        tStart = systemclock::now();
+      const std::size_t       packedCount = atlas.insert(sizes, rects);
+      const float             tElapsed = _elapsedMs(tStart);
+
+      const bool valid = fnValidate(atlas, rects, settings);
+      TRE_LOG("Atlas " << packingNames[packing] << " (padding 1, fixed 1024 x 1024): " << packedCount << " / " << sizes.size() << " rectangles" <<
+              " (" << packingNames[atlas.packing()] << "), " << tElapsed << " ms, occupancy = " << atlas.occupancy() << (valid ? "" : " INVALID"));
+      if (!valid || atlas.occupancy() < 0.75f) status = false;
+    }
+  }
+
+  // Incremental insertion, after a batch.
+
+  {
+    std::vector<glm::ivec2> sizes;
+    fnGenSizes(1500, sizes);
+
+    tre::textureAtlas::s_settings settings;
+    tre::textureAtlas             atlas(2048, 2048, settings);
+    std::vector<glm::ivec4>       rects;
+    const systemtick              tStart = systemclock::now();
+    std::size_t                   packedCount = atlas.insert(tre::span<glm::ivec2>(sizes, 0, 500), rects);
+    rects.resize(sizes.size());
+    for (std::size_t i = 500; i < sizes.size(); ++i) packedCount += atlas.insert(sizes[i], rects[i]) ? 1 : 0;
+    const float                   tElapsed = _elapsedMs(tStart);
+
+    const bool valid = fnValidate(atlas, rects, settings);
+    TRE_LOG("Atlas incremental: " << packedCount << " / " << sizes.size() << " rectangles into " << atlas.w() << " x " << atlas.h() <<
+            ", " << tElapsed << " ms, occupancy = " << atlas.occupancy() << (valid ? "" : " INVALID"));
+    if (!valid || packedCount != sizes.size()) status = false;
+  }
+
+  // UV remap and grid indices (VI_ATLAS): cells of 32 x 32, packed without padding and aligned on the cells.
+
+  {
+    tre::textureAtlas::s_settings settings;
+    settings.m_padding = 0;
+    settings.m_alignment = 32;
+
+    tre::textureAtlas       atlas(256, 256, settings);
+    std::vector<glm::ivec2> sizes(64, glm::ivec2(32));
+    std::vector<glm::ivec4> rects;
+    const std::size_t       packedCount = atlas.insert(sizes, rects);
+
+    std::vector<bool> cellUsed(64, false);
+    bool              validGrid = (packedCount == 64);
+    for (const glm::ivec4 &r : rects)
+    {
+      const int index = atlas.gridIndex(r, glm::ivec2(32));
+      validGrid &= (index >= 0 && index < 64 && !cellUsed[std::size_t(std::max(index, 0))]);
+      if (index >= 0 && index < 64) cellUsed[std::size_t(index)] = true;
+    }
+    validGrid &= (atlas.gridInvDim(glm::ivec2(32)) == glm::vec2(0.125f));
+
+    std::vector<glm::vec4> uvs;
+    atlas.uvRemap(rects, uvs);
+    const glm::vec4 uvExpected = glm::vec4(rects[0].x, rects[0].y + 32, rects[0].x + 32, rects[0].y) / 256.f;
+    const bool      validUV = (uvs.size() == 64) && (uvs[0] == uvExpected);
+
+    TRE_LOG("Atlas grid: " << packedCount << " cells, grid-indices " << (validGrid ? "valid" : "INVALID") << ", uv-remap " << (validUV ? "valid" : "INVALID"));
+    if (!validGrid || !validUV) status = false;
+  }
+
+  return status;
+}
+
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  bool status = true;
+
+  status &= testCompression();
+  status &= testCompressionChannels();
+  status &= testMipChain();
+  status &= testHDRPacking();
+  status &= testAtlas();
+
+  TRE_LOG("Quit.");
+
+  return (status ? 0 : -1);
+}
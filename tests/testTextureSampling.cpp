@@ -1,17 +1,30 @@
 
 #include "tre_utils.h"
 #include "tre_textureSampler.h"
+#include "tre_texture.h"
 
 #ifdef TRE_WITH_LIBTIFF
 #include "tiffio.h"
 #endif
 
+#include <chrono>
+#include <cstring>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #ifndef TESTIMPORTPATH
 #define TESTIMPORTPATH ""
 #endif
 
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
 // =============================================================================
 
 void getSize(SDL_Surface *surf, unsigned &w, unsigned &h)
@@ -291,6 +304,800 @@ void genRotated(_S *inTexture, float angle, const std::string &outFilePrefix)
   TRE_LOG("Texture " << outFileName << " written.");
 }
 
+// =============================================================================
+// Check against a reference: straight single-threaded implementation of the C0-kernel sampling,
+// as the resampler was computing before its tiles were multi-threaded and vectorized.
+
+static void _syntheticPixel(unsigned iu, unsigned iv, uint8_t *px)
+{
+  px[0] = uint8_t((iu * 7 + iv * 3) ^ (iu >> 2));
+  px[1] = uint8_t(128.f + 127.f * sinf(iu * 0.05f) * cosf(iv * 0.031f));
+  px[2] = (((iu / 16) + (iv / 16)) & 1) * 0xFF;
+}
+
+static SDL_Surface *genSyntheticSurface(unsigned w, unsigned h)
+{
+  SDL_Surface *surf = SDL_CreateRGBSurface(0, int(w), int(h), 24, 0x0000FF, 0x00FF00, 0xFF0000, 0);
+  for (unsigned iv = 0; iv < h; ++iv)
+  {
+    uint8_t *px = reinterpret_cast<uint8_t*>(surf->pixels) + iv * unsigned(surf->pitch);
+    for (unsigned iu = 0; iu < w; ++iu, px += 3)
+      _syntheticPixel(iu, iv, px);
+  }
+  return surf;
+}
+
+static float _refKernelIntg(const float _s, const float _e)
+{
+  const float s = glm::clamp(_s, -1.f, 1.f);
+  const float e = glm::clamp(_e, -1.f, 1.f);
+  return 0.5f * (2.f - glm::abs(e)) * e - 0.5f * (2.f - glm::abs(s)) * s;
+}
+
+/// Sample the pixels in the zone "nnmm" (in pixel unit). The pixel-range is clamped within [0, zoneW-1]*[0, zoneH-1] when the zone is not empty.
+template<class _F>
+static glm::vec3 _refSample(const _F &fnctFetch, const glm::vec4 &nnmm, const int zoneW, const int zoneH)
+{
+  const glm::vec4 nnmm_Kf = nnmm - 0.5f;
+  int iuStart = int(std::floor(nnmm_Kf.x)), iuStop = int(std::floor(nnmm_Kf.y)) + 1;
+  int ivStart = int(std::floor(nnmm_Kf.z)), ivStop = int(std::floor(nnmm_Kf.w)) + 1;
+  if (zoneW != 0)
+  {
+    iuStart = glm::max(iuStart, 0); iuStop = glm::min(iuStop, zoneW - 1);
+    ivStart = glm::max(ivStart, 0); ivStop = glm::min(ivStop, zoneH - 1);
+  }
+  glm::vec3 value = glm::vec3(0.f);
+  float     weight = 0.f;
+  for (int iv = ivStart; iv <= ivStop; ++iv)
+  {
+    const float v_w = _refKernelIntg(nnmm_Kf.z - iv, nnmm_Kf.w - iv);
+    for (int iu = iuStart; iu <= iuStop; ++iu)
+    {
+      const float w_uv = _refKernelIntg(nnmm_Kf.x - iu, nnmm_Kf.y - iu) * v_w;
+      value += fnctFetch(iu, iv) * w_uv;
+      weight += w_uv;
+    }
+  }
+  return value / weight;
+}
+
+static glm::vec3 _refPixel(SDL_Surface *surf, int iu, int iv)
+{
+  const uint8_t *px = reinterpret_cast<const uint8_t*>(surf->pixels) + iv * surf->pitch + iu * 3;
+  return glm::vec3(px[0], px[1], px[2]) / 255.f;
+}
+
+static glm::vec2 _refCubeMap(const glm::vec3 &coordUVW)
+{
+  const glm::vec3 coordUVW_n = glm::normalize(coordUVW);
+  if (coordUVW_n.y >=  1.f) return glm::vec2(0.f, 0.f);
+  if (coordUVW_n.y <= -1.f) return glm::vec2(0.f, 1.f);
+  return 0.5f + 0.5f * glm::vec2(atan2f(-coordUVW_n.x, -coordUVW_n.z) * 0.3183098861837907f, -asinf(coordUVW_n.y) * 0.6366197723675814f);
+}
+
+static glm::vec4 _refCubeZone(const glm::vec3 &coord3D, const glm::vec3 &du, const glm::vec3 &dv, const glm::vec2 &coordRef)
+{
+  glm::vec2 coordMap = _refCubeMap(coord3D);
+  coordMap.x += std::round(coordRef.x - coordMap.x); // repeat-x
+
+  const glm::vec3 P = glm::normalize(coord3D);
+  const glm::vec3 dPu = glm::normalize(coord3D + 0.5f * du) - P;
+  const glm::vec3 dPv = glm::normalize(coord3D + 0.5f * dv) - P;
+  const float     inv1myy = 1.f / glm::max(1.e-3f, 1.f - P.y * P.y);
+  const glm::vec3 map_derr = 0.5f * glm::vec3(0.3183098861837907f * P.z * inv1myy, 0.3183098861837907f * (-P.x) * inv1myy, -0.6366197723675814f * sqrtf(inv1myy));
+  const glm::vec2 dudv_onU = glm::abs(glm::vec2(map_derr.x * dPu.x + map_derr.y * dPu.z, map_derr.z * dPu.y));
+  const glm::vec2 dudv_onV = glm::abs(glm::vec2(map_derr.x * dPv.x + map_derr.y * dPv.z, map_derr.z * dPv.y));
+  const glm::vec2 dudv = glm::max(dudv_onU + dudv_onV, glm::vec2(1.e-6f));
+
+  return glm::vec4(coordMap.x - dudv.x, coordMap.x + dudv.x, coordMap.y - dudv.y, coordMap.y + dudv.y);
+}
+
+static bool _checkOutput(const char *name, SDL_Surface *outSurface, const std::vector<glm::vec3> &refValues, const float tStartMs)
+{
+  unsigned maxError = 0;
+  for (int iv = 0; iv < outSurface->h; ++iv)
+  {
+    for (int iu = 0; iu < outSurface->w; ++iu)
+    {
+      const uint32_t pixel = *reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(outSurface->pixels) + iv * outSurface->pitch + iu * 4);
+      const glm::vec3 &ref = refValues[iv * outSurface->w + iu];
+      const int outR = int((pixel >> 16) & 0xFF), outG = int((pixel >> 8) & 0xFF), outB = int(pixel & 0xFF);
+      maxError = glm::max(maxError, unsigned(glm::abs(outR - int(ref.r * 0xFF))));
+      maxError = glm::max(maxError, unsigned(glm::abs(outG - int(ref.g * 0xFF))));
+      maxError = glm::max(maxError, unsigned(glm::abs(outB - int(ref.b * 0xFF))));
+    }
+  }
+  TRE_LOG("Check " << name << " " << outSurface->w << " x " << outSurface->h << ": " << tStartMs << " ms, max error = " << maxError);
+  return maxError <= 1; // the sum of the weights is done in a different order
+}
+
+static bool _checkOutput(const char *name, const tre::textureSampler::s_ImageData_R32F &outImage, const std::vector<glm::vec3> &refValues, const float tStartMs)
+{
+  float maxError = 0.f;
+  for (unsigned i = 0; i < outImage.w * outImage.h; ++i)
+    maxError = glm::max(maxError, glm::abs(outImage.pixels[i] - refValues[i].r));
+  TRE_LOG("Check " << name << " (R32F) " << outImage.w << " x " << outImage.h << ": " << tStartMs << " ms, max error = " << maxError);
+  return maxError < 1.e-4f;
+}
+
+static bool checkResampleFlat(SDL_Surface *inSurface, unsigned outW, unsigned outH, const glm::vec2 &coord0, const glm::vec2 &coordU, const glm::vec2 &coordV)
+{
+  const glm::vec2 inWH = glm::vec2(inSurface->w, inSurface->h);
+  const glm::vec2 du = coordU / float(outW);
+  const glm::vec2 dv = coordV / float(outH);
+  const glm::vec2 px_uv = glm::abs(du) + glm::abs(dv);
+
+  auto fnctFetch = [&](int iu, int iv) { return _refPixel(inSurface, glm::clamp(iu, 0, inSurface->w - 1), glm::clamp(iv, 0, inSurface->h - 1)); };
+
+  std::vector<glm::vec3> refValues(outW * outH);
+  for (unsigned iv = 0; iv < outH; ++iv)
+  {
+    for (unsigned iu = 0; iu < outW; ++iu)
+    {
+      const glm::vec2 uv = coord0 + du * float(iu + 0.5f) + dv * float(iv + 0.5f);
+      const glm::vec4 nnmm = glm::vec4(uv.x - 0.5f * px_uv.x, uv.x + 0.5f * px_uv.x, uv.y - 0.5f * px_uv.y, uv.y + 0.5f * px_uv.y) * glm::vec4(inWH.x, inWH.x, inWH.y, inWH.y);
+      refValues[iv * outW + iu] = _refSample(fnctFetch, nnmm, 0, 0);
+    }
+  }
+
+  bool status = true;
+
+  SDL_Surface *outSurface = SDL_CreateRGBSurface(0, int(outW), int(outH), 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+  systemtick tStart = systemclock::now();
+  tre::textureSampler::resample(outSurface, inSurface, coord0, coordU, coordV);
+  status &= _checkOutput("resample", outSurface, refValues, _elapsedMs(tStart));
+  SDL_FreeSurface(outSurface);
+
+  std::vector<float> outValues(outW * outH);
+  tre::textureSampler::s_ImageData_R32F outImage;
+  outImage.w = outW;
+  outImage.h = outH;
+  outImage.pixels = outValues.data();
+  tStart = systemclock::now();
+  tre::textureSampler::resample(&outImage, inSurface, coord0, coordU, coordV);
+  status &= _checkOutput("resample", outImage, refValues, _elapsedMs(tStart));
+
+  return status;
+}
+
+static bool checkResampleCubeFace(SDL_Surface *inSurface, unsigned outSize, e_cubeFace face)
+{
+  glm::vec3 coord0, coordU, coordV;
+  _get_CubeMap_FaceCoord(face, true, coord0, coordU, coordV);
+
+  const int inW = inSurface->w, inH = inSurface->h;
+  const glm::vec4 inWWHH = glm::vec4(inW, inW, inH, inH);
+  const glm::vec3 du = coordU / float(outSize);
+  const glm::vec3 dv = coordV / float(outSize);
+  const glm::vec2 coordRef = _refCubeMap(coord0 + du * float(outSize / 2 + 0.5f) + dv * float(outSize / 2 + 0.5f));
+
+  std::vector<glm::vec4> zones(outSize * outSize);
+  for (unsigned iv = 0; iv < outSize; ++iv)
+  {
+    for (unsigned iu = 0; iu < outSize; ++iu)
+      zones[iv * outSize + iu] = _refCubeZone(coord0 + du * float(iu + 0.5f) + dv * float(iv + 0.5f), du, dv, coordRef);
+  }
+
+  auto fnctFetch = [&](int iu, int ivRaw)
+  {
+    if (ivRaw >= 0 && ivRaw < inH)
+      return _refPixel(inSurface, (iu + 2 * inW) % inW, ivRaw);
+    const int iv = (ivRaw < 0) ? -ivRaw : 2 * inH - 1 - ivRaw; // pole-flip
+    return _refPixel(inSurface, (3 * inW - iu) % inW, iv);
+  };
+
+  std::vector<glm::vec3> refValues(outSize * outSize);
+  for (unsigned i = 0; i < outSize * outSize; ++i)
+    refValues[i] = _refSample(fnctFetch, zones[i] * inWWHH, 0, 0);
+
+  bool status = true;
+
+  SDL_Surface *outSurface = SDL_CreateRGBSurface(0, int(outSize), int(outSize), 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+  systemtick tStart = systemclock::now();
+  tre::textureSampler::resample_toCubeMap(outSurface, inSurface, coord0, coordU, coordV);
+  status &= _checkOutput("resample_toCubeMap", outSurface, refValues, _elapsedMs(tStart));
+  SDL_FreeSurface(outSurface);
+
+  std::vector<float> outValues(outSize * outSize);
+  tre::textureSampler::s_ImageData_R32F outImage;
+  outImage.w = outSize;
+  outImage.h = outSize;
+  outImage.pixels = outValues.data();
+  tStart = systemclock::now();
+  tre::textureSampler::resample_toCubeMap(&outImage, inSurface, coord0, coordU, coordV);
+  status &= _checkOutput("resample_toCubeMap", outImage, refValues, _elapsedMs(tStart));
+
+  return status;
+}
+
+bool checkAgainstReference()
+{
+  SDL_Surface *inSurface = genSyntheticSurface(1024, 512);
+
+  bool status = true;
+  status &= checkResampleFlat(inSurface, 1024, 512, glm::vec2(0.f, 0.f), glm::vec2(1.f, 0.f), glm::vec2(0.f, 1.f));
+  status &= checkResampleFlat(inSurface,  300, 170, glm::vec2(0.f, 0.f), glm::vec2(1.f, 0.f), glm::vec2(0.f, 1.f));
+  status &= checkResampleFlat(inSurface,  512, 512, glm::vec2(0.1f, 0.2f), glm::vec2(0.7f, 0.1f), glm::vec2(-0.1f, 0.7f));
+  status &= checkResampleFlat(inSurface, 1024, 1024, glm::vec2(0.f, 0.f), glm::vec2(0.01f, 0.f), glm::vec2(0.f, 0.02f));
+  status &= checkResampleCubeFace(inSurface, 256, CUBE_X_POS);
+  status &= checkResampleCubeFace(inSurface, 256, CUBE_Y_POS);
+  status &= checkResampleCubeFace(inSurface, 512, CUBE_Z_NEG);
+
+  SDL_FreeSurface(inSurface);
+
+  if (!status) TRE_LOG("Check against reference: FAILED");
+  return status;
+}
+
+// =============================================================================
+// Check the prefiltering for image-based lighting, with analytic environments (linear color-space).
+
+static glm::vec3 _envLinear(const glm::vec3 &d) { return glm::vec3(0.5f + 0.4f * d.y, 0.5f + 0.3f * d.x, 0.6f); }
+
+static glm::vec3 _cubeTexelDir(unsigned face, unsigned iu, unsigned iv, unsigned n)
+{
+  glm::vec3 coord0, coordU, coordV;
+  _get_CubeMap_FaceCoord(e_cubeFace(face), true, coord0, coordU, coordV);
+  return glm::normalize(coord0 + coordU * ((float(iu) + 0.5f) / float(n)) + coordV * ((float(iv) + 0.5f) / float(n)));
+}
+
+static glm::vec3 _readPixel(SDL_Surface *surf, unsigned iu, unsigned iv)
+{
+  const uint32_t pixel = *reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(surf->pixels) + iv * surf->pitch + iu * 4);
+  return glm::vec3(float((pixel >> 16) & 0xFF), float((pixel >> 8) & 0xFF), float(pixel & 0xFF)) / 255.f;
+}
+
+/// Decode the texel (iu, iv) of a S3TC color block (4-colors mode, as written by the compressor).
+static glm::vec3 _decodeS3TC(const uint8_t *block, unsigned iu, unsigned iv)
+{
+  const auto fnColor565 = [](unsigned c)
+  {
+    const unsigned r = c >> 11, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    return glm::vec3(float((r << 3) | (r >> 2)), float((g << 2) | (g >> 4)), float((b << 3) | (b >> 2))) / 255.f;
+  };
+  const glm::vec3 col0 = fnColor565(block[0] | (block[1] << 8));
+  const glm::vec3 col1 = fnColor565(block[2] | (block[3] << 8));
+  const unsigned  index = (block[4 + iv] >> (2 * iu)) & 0x3;
+  static const float k_weight1[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+  return col0 + (col1 - col0) * k_weight1[index];
+}
+
+/// Reference of the GGX prefiltering (V = N): integral of L(l) * D(h) * NdotL over the hemisphere, normalized.
+static glm::vec3 _refGGX(const glm::vec3 &N, float roughness)
+{
+  const float alpha2 = glm::max(roughness * roughness, 1.e-4f) * glm::max(roughness * roughness, 1.e-4f);
+  const unsigned nTheta = 512, nPhi = 1024;
+  glm::dvec3 acc(0.);
+  double     accW = 0.;
+  const glm::vec3 up = (glm::abs(N.z) < 0.999f) ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(1.f, 0.f, 0.f);
+  const glm::vec3 T = glm::normalize(glm::cross(up, N));
+  const glm::vec3 B = glm::cross(N, T);
+  for (unsigned it = 0; it < nTheta; ++it)
+  {
+    const float theta = (float(it) + 0.5f) / float(nTheta) * 1.5707963f;
+    for (unsigned ip = 0; ip < nPhi; ++ip)
+    {
+      const float     phi = (float(ip) + 0.5f) / float(nPhi) * 6.2831853f;
+      const glm::vec3 l = T * (std::sin(theta) * std::cos(phi)) + B * (std::sin(theta) * std::sin(phi)) + N * std::cos(theta);
+      const glm::vec3 h = glm::normalize(l + N);
+      const float     NdotH = glm::dot(N, h);
+      const float     d = (alpha2 - 1.f) * NdotH * NdotH + 1.f;
+      const double    w = double(alpha2 / (d * d)) * double(std::cos(theta)) * double(std::sin(theta));
+      acc += glm::dvec3(_envLinear(l)) * w;
+      accW += w;
+    }
+  }
+  return glm::vec3(acc / accW);
+}
+
+bool checkIBL()
+{
+  bool status = true;
+
+  const unsigned n = 64;
+  std::array<SDL_Surface*, 6> faces;
+  for (unsigned face = 0; face < 6; ++face)
+  {
+    faces[face] = SDL_CreateRGBSurface(0, n, n, 32, 0, 0, 0, 0);
+    for (unsigned iv = 0; iv < n; ++iv)
+    {
+      for (unsigned iu = 0; iu < n; ++iu)
+      {
+        const glm::vec3 c = _envLinear(_cubeTexelDir(face, iu, iv, n));
+        uint32_t *p = reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(faces[face]->pixels) + iv * faces[face]->pitch + iu * 4);
+        *p = SDL_MapRGBA(faces[face]->format, uint8_t(c.r * 255.f + 0.5f), uint8_t(c.g * 255.f + 0.5f), uint8_t(c.b * 255.f + 0.5f), 0xFF);
+      }
+    }
+  }
+
+  // irradiance: with a linear environment, the SH are exact: E/PI = a + 2/3 * b.d
+
+  {
+    glm::vec3 sh[9];
+    systemtick tStart = systemclock::now();
+    status &= tre::textureSampler::computeIBL_irradianceSH9(sh, faces, false);
+    const float tSH = _elapsedMs(tStart);
+
+    std::array<SDL_Surface*, 6> irrFaces;
+    for (SDL_Surface *&surf : irrFaces) surf = SDL_CreateRGBSurface(0, 16, 16, 32, 0, 0, 0, 0);
+    tre::textureSampler::mapIBL_irradiance(irrFaces, sh, false);
+
+    float maxError = 0.f;
+    for (unsigned face = 0; face < 6; ++face)
+    {
+      for (unsigned iv = 0; iv < 16; ++iv)
+      {
+        for (unsigned iu = 0; iu < 16; ++iu)
+        {
+          const glm::vec3 d = _cubeTexelDir(face, iu, iv, 16);
+          const glm::vec3 ref = glm::vec3(0.5f + 0.4f * 2.f / 3.f * d.y, 0.5f + 0.3f * 2.f / 3.f * d.x, 0.6f);
+          maxError = glm::max(maxError, glm::length(_readPixel(irrFaces[face], iu, iv) - ref));
+        }
+      }
+    }
+    for (SDL_Surface *surf : irrFaces) SDL_FreeSurface(surf);
+
+    TRE_LOG("Check IBL irradiance (SH9) " << n << " x " << n << " x 6: " << tSH << " ms, max error = " << maxError * 255.f << " / 255");
+    if (maxError > 3.f / 255.f) status = false;
+  }
+
+  // specular: compare with the integral of the GGX lobe
+
+  {
+    std::vector<std::array<SDL_Surface*, 6>> mipChain;
+    tre::textureSampler::s_IBLSettings settings;
+    settings.m_gammaCorrect = false;
+    settings.m_sampleCount = 256;
+    systemtick tStart = systemclock::now();
+    status &= tre::textureSampler::prefilterIBL_specular(mipChain, faces, settings);
+    const float tSpecular = _elapsedMs(tStart);
+
+    float maxError = 0.f;
+    if (mipChain.size() != 7) status = false;
+    for (std::size_t level = 1; level < mipChain.size() && status; ++level)
+    {
+      const unsigned nL = n >> level;
+      const float    roughness = float(level) / float(mipChain.size() - 1);
+      for (unsigned face = 0; face < 6; ++face)
+      {
+        for (unsigned iv = 0; iv < nL; iv += std::max(1u, nL / 3))
+        {
+          for (unsigned iu = 0; iu < nL; iu += std::max(1u, nL / 3))
+          {
+            if (mipChain[level][face]->w != int(nL)) status = false;
+            const glm::vec3 ref = _refGGX(_cubeTexelDir(face, iu, iv, nL), roughness);
+            maxError = glm::max(maxError, glm::length(_readPixel(mipChain[level][face], iu, iv) - ref));
+          }
+        }
+      }
+    }
+
+    // compressed bake: the levels smaller than a block are padded. Read it back as texture::read does, and decode the color blocks.
+    {
+      std::ostringstream bakedCompressed;
+      if (!tre::texture::writeCubeMipChain(bakedCompressed, mipChain, tre::texture::MMASK_MIPMAP | tre::texture::MMASK_COMPRESS, false)) status = false;
+
+      std::istringstream inbuffer(bakedCompressed.str());
+      int32_t            tinfo[8];
+      inbuffer.read(reinterpret_cast<char*>(&tinfo), sizeof(tinfo));
+      if (!inbuffer || tinfo[0] != tre::texture::TI_CUBEMAP || tinfo[1] != int(n) || tinfo[6] != 4) status = false;
+      if ((tinfo[3] & tre::texture::MMASK_COMPRESS) == 0) status = false;
+
+      float             sumErrorCompressed = 0.f, lastLevelErrorCompressed = 0.f;
+      std::size_t       texelCount = 0;
+      std::vector<char> readBuffer;
+      for (unsigned face = 0; face < 6 && status; ++face)
+      {
+        for (std::size_t level = 0; level < mipChain.size() && status; ++level)
+        {
+          const unsigned nL = std::max(n >> level, 1u);
+          const unsigned blockCount = (nL + 3) / 4;
+          unsigned       dataSize = 0;
+          inbuffer.read(reinterpret_cast<char*>(&dataSize), sizeof(unsigned));
+          if (!inbuffer || dataSize != blockCount * blockCount * 16) { status = false; break; } // DXT3: alpha block + color block
+          readBuffer.resize(dataSize);
+          inbuffer.read(readBuffer.data(), dataSize);
+          for (unsigned iv = 0; iv < nL; ++iv)
+          {
+            for (unsigned iu = 0; iu < nL; ++iu)
+            {
+              const uint8_t  *block = reinterpret_cast<const uint8_t*>(readBuffer.data()) + 16 * ((iv / 4) * blockCount + (iu / 4));
+              const glm::vec3 decoded = _decodeS3TC(block + 8, iu % 4, iv % 4);
+              const float     error = glm::length(decoded - _readPixel(mipChain[level][face], iu, iv));
+              sumErrorCompressed += error;
+              ++texelCount;
+              if (level + 1 == mipChain.size()) lastLevelErrorCompressed = glm::max(lastLevelErrorCompressed, error);
+            }
+          }
+        }
+      }
+      if (inbuffer.peek() != std::char_traits<char>::eof()) status = false; // the whole stream is consumed
+
+      const float meanErrorCompressed = sumErrorCompressed / float(std::max(texelCount, std::size_t(1)));
+      TRE_LOG("Check IBL specular (GGX) baked compressed: " << bakedCompressed.str().size() << " bytes, mean error = " << meanErrorCompressed * 255.f << " / 255, 1x1-level error = " << lastLevelErrorCompressed * 255.f << " / 255");
+      if (meanErrorCompressed > 10.f / 255.f) status = false;
+      if (lastLevelErrorCompressed > 12.f / 255.f) status = false; // the padded block is uni-color
+    }
+
+    std::ostringstream baked;
+    if (!tre::texture::writeCubeMipChain(baked, mipChain, tre::texture::MMASK_MIPMAP, true)) status = false;
+    std::size_t expectedSize = 8 * sizeof(int32_t);
+    for (unsigned level = 0; level < 7; ++level) expectedSize += 6 * (sizeof(unsigned) + 4 * (n >> level) * (n >> level));
+    if (baked.str().size() != expectedSize) status = false;
+
+    TRE_LOG("Check IBL specular (GGX) " << n << " x " << n << " x 6, " << settings.m_sampleCount << " samples: " << tSpecular << " ms, max error = " << maxError * 255.f << " / 255");
+    if (maxError > 4.f / 255.f) status = false;
+  }
+
+  for (SDL_Surface *surf : faces) SDL_FreeSurface(surf);
+
+  if (!status) TRE_LOG("Check IBL: FAILED");
+  return status;
+}
+
+// =============================================================================
+// Check the TIFF decoding: striped and tiled images, with several cache settings. The outputs must match the ones from the SDL_Surface.
+
+#ifdef TRE_WITH_LIBTIFF
+
+static bool writeSyntheticTIFF(SDL_Surface *surf, const std::string &fileName, const unsigned tileSize)
+{
+  TIFF *tif = TIFFOpen(fileName.c_str(), "w");
+  if (tif == nullptr) return false;
+
+  const unsigned w = unsigned(surf->w), h = unsigned(surf->h);
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+
+  auto fnctPixel = [&](unsigned u, unsigned v) { return reinterpret_cast<const uint8_t*>(surf->pixels) + v * unsigned(surf->pitch) + u * 3; };
+
+  bool status = true;
+  if (tileSize == 0) // strips of 4 rows
+  {
+    const unsigned rowsPerStrip = 4;
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
+    std::vector<uint8_t> buffer(w * rowsPerStrip * 3);
+    for (unsigned iStrip = 0; iStrip * rowsPerStrip < h; ++iStrip)
+    {
+      const unsigned rowCount = glm::min(rowsPerStrip, h - iStrip * rowsPerStrip);
+      for (unsigned iRow = 0; iRow < rowCount; ++iRow)
+        memcpy(buffer.data() + iRow * w * 3, fnctPixel(0, iStrip * rowsPerStrip + iRow), w * 3);
+      status &= (TIFFWriteEncodedStrip(tif, iStrip, buffer.data(), tsize_t(rowCount * w * 3)) != -1);
+    }
+  }
+  else
+  {
+    TIFFSetField(tif, TIFFTAG_TILEWIDTH, tileSize);
+    TIFFSetField(tif, TIFFTAG_TILELENGTH, tileSize);
+    std::vector<uint8_t> buffer(tileSize * tileSize * 3);
+    for (unsigned v0 = 0; v0 < h; v0 += tileSize)
+    {
+      for (unsigned u0 = 0; u0 < w; u0 += tileSize)
+      {
+        std::fill(buffer.begin(), buffer.end(), uint8_t(0));
+        for (unsigned iRow = 0; iRow < tileSize && v0 + iRow < h; ++iRow)
+          memcpy(buffer.data() + iRow * tileSize * 3, fnctPixel(u0, v0 + iRow), glm::min(tileSize, w - u0) * 3);
+        status &= (TIFFWriteEncodedTile(tif, TIFFComputeTile(tif, u0, v0, 0, 0), buffer.data(), tsize_t(buffer.size())) != -1);
+      }
+    }
+  }
+
+  TIFFClose(tif);
+  return status;
+}
+
+static bool _isSameSurface(SDL_Surface *surfA, SDL_Surface *surfB)
+{
+  for (int iv = 0; iv < surfA->h; ++iv)
+  {
+    if (memcmp(reinterpret_cast<const uint8_t*>(surfA->pixels) + iv * surfA->pitch,
+               reinterpret_cast<const uint8_t*>(surfB->pixels) + iv * surfB->pitch, surfA->w * surfA->format->BytesPerPixel) != 0)
+      return false;
+  }
+  return true;
+}
+
+bool checkTIFFCache()
+{
+  SDL_Surface *inSurface = genSyntheticSurface(1024, 512);
+
+  // reference from the SDL_Surface
+  SDL_Surface *refFlat = SDL_CreateRGBSurface(0, 300, 170, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+  tre::textureSampler::resample(refFlat, inSurface, glm::vec2(0.1f, 0.2f), glm::vec2(0.7f, 0.1f), glm::vec2(-0.1f, 0.7f));
+  std::vector<SDL_Surface*> refCube(6);
+  for (int face = CUBE_X_POS; face <= CUBE_Z_NEG; ++face)
+  {
+    glm::vec3 coord0, coordU, coordV;
+    _get_CubeMap_FaceCoord(e_cubeFace(face), true, coord0, coordU, coordV);
+    refCube[face] = SDL_CreateRGBSurface(0, 256, 256, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+    tre::textureSampler::resample_toCubeMap(refCube[face], inSurface, coord0, coordU, coordV);
+  }
+
+  SDL_Surface *outFlat = SDL_CreateRGBSurface(0, 300, 170, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+  SDL_Surface *outCube = SDL_CreateRGBSurface(0, 256, 256, 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+
+  struct s_config { const char *name; std::size_t budget; bool prefetch; };
+  const s_config configs[] = { { "64MB + prefetch ", 64 * 1024 * 1024, true  },
+                               { "256kB + prefetch", 256 * 1024      , true  },
+                               { "256kB           ", 256 * 1024      , false },
+                               { "2 blocks        ", 0               , false } };
+
+  bool status = true;
+
+  for (const unsigned tileSize : { 0u, 64u })
+  {
+    const std::string fileName = (tileSize == 0) ? "synthetic.strips.tif" : "synthetic.tiles.tif";
+    if (!writeSyntheticTIFF(inSurface, fileName, tileSize))
+    {
+      TRE_LOG("Fail to write the TIFF image " << fileName);
+      status = false;
+      continue;
+    }
+
+    TIFF *tif = TIFFOpen(fileName.c_str(), "r");
+    if (tif == nullptr)
+    {
+      TRE_LOG("Fail to read the TIFF image " << fileName);
+      status = false;
+      continue;
+    }
+
+    for (const s_config &config : configs)
+    {
+      tre::textureSampler::s_TIFFCacheSettings settings;
+      settings.m_budgetInBytes = config.budget;
+      settings.m_prefetch = config.prefetch;
+      tre::textureSampler::setTIFFCacheSettings(settings);
+      tre::textureSampler::resetTIFFCacheStats();
+
+      bool isSame = true;
+      const systemtick tStart = systemclock::now();
+
+      tre::textureSampler::resample(outFlat, tif, glm::vec2(0.1f, 0.2f), glm::vec2(0.7f, 0.1f), glm::vec2(-0.1f, 0.7f));
+      isSame &= _isSameSurface(outFlat, refFlat);
+
+      for (int face = CUBE_X_POS; face <= CUBE_Z_NEG; ++face)
+      {
+        glm::vec3 coord0, coordU, coordV;
+        _get_CubeMap_FaceCoord(e_cubeFace(face), true, coord0, coordU, coordV);
+        tre::textureSampler::resample_toCubeMap(outCube, tif, coord0, coordU, coordV);
+        isSame &= _isSameSurface(outCube, refCube[face]);
+      }
+
+      const float elapsedMs = _elapsedMs(tStart);
+      const tre::textureSampler::s_TIFFCacheStats stats = tre::textureSampler::getTIFFCacheStats();
+      TRE_LOG("TIFF " << (tileSize == 0 ? "strips" : "tiles ") << ", cache " << config.name << ": " << elapsedMs << " ms, " <<
+              stats.m_decodeCount << " decodes (" << stats.m_prefetchCount << " prefetched, " << stats.m_missCount << " misses), " <<
+              "peak " << stats.m_peakBytes / 1024 << " kB" << (isSame ? "" : ", output MISMATCH"));
+      status &= isSame;
+    }
+
+    TIFFClose(tif);
+  }
+
+  tre::textureSampler::setTIFFCacheSettings(tre::textureSampler::s_TIFFCacheSettings());
+
+  SDL_FreeSurface(outFlat);
+  SDL_FreeSurface(outCube);
+  SDL_FreeSurface(refFlat);
+  for (SDL_Surface *surf : refCube) SDL_FreeSurface(surf);
+  SDL_FreeSurface(inSurface);
+
+  if (!status) TRE_LOG("Check of the TIFF cache: FAILED");
+  return status;
+}
+
+// =============================================================================
+// Check the streamed resampling: the in-image is generated row by row into a TIFF file (it can be larger than the memory).
+// The tiles are checked against the reference computed from the procedural pixels, and against the non-streamed resampling.
+
+static bool writeProceduralTIFF(const std::string &fileName, const unsigned w, const unsigned h)
+{
+  const bool isBig = (uint64_t(w) * uint64_t(h) * 3 > (uint64_t(1) << 31));
+  TIFF *tif = TIFFOpen(fileName.c_str(), isBig ? "w8" : "w"); // BigTIFF when the image may exceed 4GB
+  if (tif == nullptr) return false;
+
+  const unsigned rowsPerStrip = 16;
+  TIFFSetField(tif, TIFFTAG_IMAGEWIDTH, w);
+  TIFFSetField(tif, TIFFTAG_IMAGELENGTH, h);
+  TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, 8);
+  TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, 3);
+  TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
+  TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_LZW);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, rowsPerStrip);
+
+  bool status = true;
+  std::vector<uint8_t> buffer(std::size_t(w) * rowsPerStrip * 3);
+  for (unsigned iStrip = 0; iStrip * rowsPerStrip < h && status; ++iStrip)
+  {
+    const unsigned rowCount = glm::min(rowsPerStrip, h - iStrip * rowsPerStrip);
+    for (unsigned iRow = 0; iRow < rowCount; ++iRow)
+    {
+      uint8_t *px = buffer.data() + std::size_t(iRow) * w * 3;
+      for (unsigned iu = 0; iu < w; ++iu, px += 3)
+        _syntheticPixel(iu, iStrip * rowsPerStrip + iRow, px);
+    }
+    status &= (TIFFWriteEncodedStrip(tif, iStrip, buffer.data(), tsize_t(std::size_t(rowCount) * w * 3)) != -1);
+  }
+
+  TIFFClose(tif);
+  return status;
+}
+
+static bool checkStreamedCubeFace(TIFF *tif, const unsigned inW, const unsigned inH, const unsigned outSize, const e_cubeFace face,
+                                  const std::size_t budgetInBytes, const unsigned checkStep, const bool checkFull)
+{
+  glm::vec3 coord0, coordU, coordV;
+  _get_CubeMap_FaceCoord(face, true, coord0, coordU, coordV);
+
+  const glm::vec4 inWWHH = glm::vec4(inW, inW, inH, inH);
+  const glm::vec3 du = coordU / float(outSize);
+  const glm::vec3 dv = coordV / float(outSize);
+  const glm::vec2 coordRef = _refCubeMap(coord0 + du * float(outSize / 2 + 0.5f) + dv * float(outSize / 2 + 0.5f));
+
+  auto fnctFetch = [&](int iu, int ivRaw)
+  {
+    uint8_t px[3];
+    if (ivRaw >= 0 && ivRaw < int(inH))
+      _syntheticPixel(unsigned(iu + 2 * int(inW)) % inW, unsigned(ivRaw), px);
+    else
+      _syntheticPixel(unsigned(3 * int(inW) - iu) % inW, (ivRaw < 0) ? unsigned(-ivRaw) : unsigned(2 * int(inH) - 1 - ivRaw), px); // pole-flip
+    return glm::vec3(px[0], px[1], px[2]) / 255.f;
+  };
+
+  // non-streamed output
+
+  SDL_Surface *outFull = nullptr;
+  if (checkFull)
+  {
+    outFull = SDL_CreateRGBSurface(0, int(outSize), int(outSize), 32, 0xFF0000, 0x00FF00, 0x0000FF, 0);
+    tre::textureSampler::resample_toCubeMap(outFull, tif, coord0, coordU, coordV);
+  }
+
+  // streamed output
+
+  std::vector<uint8_t> coverage(std::size_t(outSize) * outSize, 0);
+  unsigned             maxErrorRef = 0, maxErrorFull = 0;
+  std::size_t          tileCount = 0;
+  float                firstTileMs = 0.f, checkMs = 0.f;
+
+  const systemtick tStart = systemclock::now();
+
+  auto fnctTile = [&](unsigned u0, unsigned v0, SDL_Surface *tile)
+  {
+    if (tileCount++ == 0) firstTileMs = _elapsedMs(tStart);
+    const systemtick tStartCheck = systemclock::now();
+    for (unsigned iv = 0; iv < unsigned(tile->h); ++iv)
+    {
+      for (unsigned iu = 0; iu < unsigned(tile->w); ++iu)
+      {
+        const uint32_t pixel = *reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(tile->pixels) + iv * unsigned(tile->pitch) + iu * 4);
+        uint8_t r, g, b, a;
+        SDL_GetRGBA(pixel, tile->format, &r, &g, &b, &a);
+        const unsigned gu = u0 + iu, gv = v0 + iv;
+        coverage[gv * outSize + gu]++;
+
+        if ((gu + gv * 3) % checkStep == 0)
+        {
+          const glm::vec4 zone = _refCubeZone(coord0 + du * float(gu + 0.5f) + dv * float(gv + 0.5f), du, dv, coordRef);
+          const glm::vec3 ref = _refSample(fnctFetch, zone * inWWHH, 0, 0);
+          maxErrorRef = glm::max(maxErrorRef, unsigned(glm::abs(int(r) - int(ref.r * 0xFF))));
+          maxErrorRef = glm::max(maxErrorRef, unsigned(glm::abs(int(g) - int(ref.g * 0xFF))));
+          maxErrorRef = glm::max(maxErrorRef, unsigned(glm::abs(int(b) - int(ref.b * 0xFF))));
+        }
+
+        if (outFull != nullptr)
+        {
+          const uint32_t pixelFull = *reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(outFull->pixels) + gv * unsigned(outFull->pitch) + gu * 4);
+          uint8_t rF, gF, bF, aF;
+          SDL_GetRGBA(pixelFull, outFull->format, &rF, &gF, &bF, &aF);
+          maxErrorFull = glm::max(maxErrorFull, unsigned(glm::abs(int(r) - int(rF))));
+          maxErrorFull = glm::max(maxErrorFull, unsigned(glm::abs(int(g) - int(gF))));
+          maxErrorFull = glm::max(maxErrorFull, unsigned(glm::abs(int(b) - int(bF))));
+        }
+      }
+    }
+    checkMs += _elapsedMs(tStartCheck);
+  };
+
+  tre::textureSampler::resetTIFFCacheStats();
+  const bool isDone = tre::textureSampler::resample_toCubeMap_streamed(outSize, outSize, fnctTile, tif, coord0, coordU, coordV, budgetInBytes);
+  const float elapsedMs = _elapsedMs(tStart) - checkMs;
+  const tre::textureSampler::s_TIFFCacheStats stats = tre::textureSampler::getTIFFCacheStats();
+
+  bool isCovered = true;
+  for (uint8_t c : coverage) isCovered &= (c == 1);
+
+  TRE_LOG("Check resample_toCubeMap_streamed " << PART_NAME[face] << " " << outSize << " x " << outSize << " from " << inW << " x " << inH <<
+          ", budget " << budgetInBytes / 1024 << " kB: " << elapsedMs << " ms (first tile after " << firstTileMs << " ms), " <<
+          tileCount << " tiles, " << stats.m_decodeCount << " decodes, decoding peak " << stats.m_peakBytes / 1024 << " kB, " <<
+          "max error = " << maxErrorRef << (outFull != nullptr ? " (with non-streamed: " : "") << (outFull != nullptr ? std::to_string(maxErrorFull) + ")" : "") <<
+          (isCovered ? "" : ", output NOT COVERED"));
+
+  if (outFull != nullptr) SDL_FreeSurface(outFull);
+
+  return isDone && isCovered && maxErrorRef <= 1 && maxErrorFull <= 1 && stats.m_peakBytes < budgetInBytes;
+}
+
+/// Check the streamed resampling on a procedural image of "inW * inH" pixels. A gigapixel image can be given (the non-streamed resampling is then skipped).
+bool checkStreamed(const unsigned inW, const unsigned inH, const unsigned outSize, const std::size_t budgetInBytes)
+{
+  const bool isLarge = (uint64_t(inW) * uint64_t(inH) > (uint64_t(1) << 26));
+
+  const std::string fileName = "synthetic.streamed.tif";
+  {
+    const systemtick tStart = systemclock::now();
+    if (!writeProceduralTIFF(fileName, inW, inH))
+    {
+      TRE_LOG("Fail to write the TIFF image " << fileName);
+      return false;
+    }
+    TRE_LOG("TIFF image " << fileName << " (" << inW << " x " << inH << ") written in " << _elapsedMs(tStart) << " ms");
+  }
+
+  TIFF *tif = TIFFOpen(fileName.c_str(), "rm"); // no memory-mapping of the file, so the resident memory reflects the budget
+  if (tif == nullptr)
+  {
+    TRE_LOG("Fail to read the TIFF image " << fileName);
+    return false;
+  }
+
+  bool status = true;
+
+  for (const e_cubeFace face : { CUBE_X_POS, CUBE_Y_POS, CUBE_Z_NEG })
+    status &= checkStreamedCubeFace(tif, inW, inH, outSize, face, budgetInBytes, isLarge ? 97 : 1, !isLarge);
+
+  // the budget is too small: it must fail without sampling
+
+  status &= !tre::textureSampler::resample_toCubeMap_streamed(outSize, outSize, [](unsigned, unsigned, SDL_Surface*) {}, tif,
+                                                              glm::vec3(-1.f, 1.f, -1.f), glm::vec3(2.f, 0.f, 0.f), glm::vec3(0.f, -2.f, 0.f), 1024);
+
+  // R32F output
+
+  {
+    glm::vec3 coord0, coordU, coordV;
+    _get_CubeMap_FaceCoord(CUBE_Z_NEG, true, coord0, coordU, coordV);
+
+    std::vector<float> outValues;
+    if (!isLarge) outValues.resize(std::size_t(outSize) * outSize);
+    tre::textureSampler::s_ImageData_R32F outImage;
+    outImage.w = outSize;
+    outImage.h = outSize;
+    outImage.pixels = outValues.data();
+    if (!isLarge) tre::textureSampler::resample_toCubeMap(&outImage, tif, coord0, coordU, coordV);
+
+    float       maxError = 0.f;
+    std::size_t pixelCount = 0;
+    auto fnctTile = [&](unsigned u0, unsigned v0, const tre::textureSampler::s_ImageData_R32F &tile)
+    {
+      pixelCount += tile.w * tile.h;
+      if (isLarge) return;
+      for (unsigned iv = 0; iv < tile.h; ++iv)
+        for (unsigned iu = 0; iu < tile.w; ++iu)
+          maxError = glm::max(maxError, glm::abs(tile.pixels[iv * tile.w + iu] - outValues[(v0 + iv) * outSize + u0 + iu]));
+    };
+    const bool isDone = tre::textureSampler::resample_toCubeMap_streamed(outSize, outSize, fnctTile, tif, coord0, coordU, coordV, budgetInBytes);
+    TRE_LOG("Check resample_toCubeMap_streamed (R32F): max error = " << maxError);
+    status &= isDone && pixelCount == std::size_t(outSize) * outSize && maxError < 1.e-4f;
+  }
+
+  TIFFClose(tif);
+  remove(fileName.c_str());
+
+  if (!status) TRE_LOG("Check of the streamed resampling: FAILED");
+  return status;
+}
+
+#endif // TRE_WITH_LIBTIFF
+
 // =============================================================================
 
 int main(int argc, char **argv)
@@ -302,6 +1109,9 @@ int main(int argc, char **argv)
   std::string outputSDL_Prefix = "imageSDL";
   std::string outputTiff_Prefix = "imageTIFF";
 
+  const bool isGigapixel = (argc >= 2 && std::string(argv[argc - 1]) == "--gigapixel"); // streamed resampling of a gigapixel image (slow, ~4GB on disk)
+  if (isGigapixel) --argc;
+
   if (argc >= 2)
     inputSDL_Map2D = argv[1];
 
@@ -338,6 +1148,14 @@ int main(int argc, char **argv)
 
   bool status = true;
 
+  // TEST: check against the reference (synthetic input)
+
+  status &= checkAgainstReference();
+
+  // TEST: prefiltering for image-based lighting
+
+  status &= checkIBL();
+
   // TEST: SDL_Surface sampling
 
   SDL_Surface *inputSurface = nullptr;
@@ -379,6 +1197,11 @@ int main(int argc, char **argv)
 
 #ifdef TRE_WITH_LIBTIFF
   TRE_LOG("Info: Testing of TIFF is enabled.");
+  status &= checkTIFFCache();
+  if (isGigapixel)
+    status &= checkStreamed(46400, 23200, 4096, 256 * 1024 * 1024); // 1.08 GPixels, 3.2 GB once decoded
+  else
+    status &= checkStreamed(8192, 4096, 512, 16 * 1024 * 1024);
   TIFF* tif = TIFFOpen(inputTiff_Map2D.c_str(), "r");
   if (tif)
   {
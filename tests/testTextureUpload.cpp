@@ -0,0 +1,490 @@
+#include "tre_utils.h"
+#include "tre_texture.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock systemclock;
+typedef systemclock::time_point   systemtick;
+
+static float _elapsedMs(const systemtick tStart)
+{
+  return std::chrono::duration<float, std::milli>(systemclock::now() - tStart).count();
+}
+
+// =============================================================================
+// Mock of the OpenGL layer: the pixel-buffers live in the CPU memory, the uploads are copied into CPU-images.
+// The fences are signaled after a fixed count of frames.
+
+struct s_mockBuffer
+{
+  std::vector<uint8_t> m_data;
+  bool                 m_isMapped = false;
+  std::size_t          m_busyUntilFrame = 0; ///< the GPU is reading the buffer
+};
+
+struct s_mockFence
+{
+  std::size_t m_signalFrame;
+};
+
+struct s_mockImage
+{
+  unsigned             m_w = 0, m_h = 0;
+  unsigned             m_bpp = 4; ///< byte per pixel, or per 4x4-block for compressed images
+  bool                 m_isCompressed = false;
+  std::vector<uint8_t> m_data;
+};
+
+struct s_mockUpload
+{
+  GLuint      m_texture;
+  GLint       m_level;
+  GLint       m_y;
+  GLsizei     m_h;
+  std::size_t m_byteSize;
+  bool        m_isAllocation;
+  bool        m_isCompressed;
+};
+
+struct s_mockGL
+{
+  std::map<GLuint, s_mockBuffer> m_buffers;
+  GLuint                         m_bufferNext = 1;
+  GLuint                         m_bufferBound = 0;
+  GLuint                         m_textureBound = 0;
+  GLint                          m_unpackAlignment = 4;
+  std::size_t                    m_frame = 0;
+  std::size_t                    m_fenceLatency = 2;
+  std::size_t                    m_fenceCount = 0;
+  std::map<uint64_t, s_mockImage> m_images; ///< key: texture * 16 + level
+  std::vector<s_mockUpload>      m_uploads;
+  std::size_t                    m_errors = 0;
+};
+
+static s_mockGL g_gl;
+
+#define MOCK_CHECK(cond) if (!(cond)) { ++g_gl.m_errors; TRE_LOG("mock-GL error: " #cond); }
+
+static void _mockCopy(GLuint texture, GLint level, GLint x, GLint y, GLsizei w, GLsizei h, bool isCompressed, std::size_t byteSize, const void *offset, bool isAllocation, GLenum internalformat)
+{
+  MOCK_CHECK(g_gl.m_bufferBound != 0);
+  MOCK_CHECK(g_gl.m_textureBound == texture);
+  MOCK_CHECK(g_gl.m_unpackAlignment == 1);
+  s_mockBuffer &buffer = g_gl.m_buffers[g_gl.m_bufferBound];
+  MOCK_CHECK(!buffer.m_isMapped);
+  const std::size_t bufferOffset = reinterpret_cast<std::size_t>(offset);
+  MOCK_CHECK(bufferOffset + byteSize <= buffer.m_data.size());
+  buffer.m_busyUntilFrame = g_gl.m_frame + g_gl.m_fenceLatency;
+
+  s_mockImage &img = g_gl.m_images[uint64_t(texture) * 16 + uint64_t(level)];
+  if (isAllocation)
+  {
+    img.m_w = unsigned(w);
+    img.m_h = unsigned(h);
+    img.m_isCompressed = isCompressed;
+    img.m_bpp = isCompressed ? 8 : (internalformat == GL_R8 ? 1 : 4);
+    img.m_data.assign(isCompressed ? std::size_t((w + 3) / 4) * std::size_t((h + 3) / 4) * 8 : std::size_t(w) * std::size_t(h) * img.m_bpp, 0);
+  }
+  MOCK_CHECK(!img.m_data.empty() && img.m_isCompressed == isCompressed);
+  if (img.m_data.empty()) return;
+
+  const unsigned    block = isCompressed ? 4 : 1;
+  MOCK_CHECK(x % block == 0 && y % block == 0);
+  MOCK_CHECK(h % block == 0 || unsigned(y + h) == img.m_h);
+  const std::size_t rowByteSize = std::size_t((w + block - 1) / block) * img.m_bpp;
+  const std::size_t rowCount = std::size_t((h + block - 1) / block);
+  MOCK_CHECK(rowByteSize * rowCount == byteSize);
+  const std::size_t imgRowByteSize = std::size_t((img.m_w + block - 1) / block) * img.m_bpp;
+  for (std::size_t r = 0; r < rowCount; ++r)
+  {
+    const std::size_t dstOffset = (std::size_t(y / block) + r) * imgRowByteSize + std::size_t(x / block) * img.m_bpp;
+    if (dstOffset + rowByteSize > img.m_data.size()) { ++g_gl.m_errors; return; }
+    memcpy(img.m_data.data() + dstOffset, buffer.m_data.data() + bufferOffset + r * rowByteSize, rowByteSize);
+  }
+
+  g_gl.m_uploads.push_back(s_mockUpload{ texture, level, y, h, byteSize, isAllocation, isCompressed });
+}
+
+static std::size_t _mockPixelSize(GLenum format) { return format == GL_RED ? 1 : 4; }
+
+static tre::textureUploader::s_GLBackend mockBackend()
+{
+  tre::textureUploader::s_GLBackend backend;
+  backend.m_genBuffers = [](GLsizei n, GLuint *buffers) { for (GLsizei i = 0; i < n; ++i) { buffers[i] = g_gl.m_bufferNext++; g_gl.m_buffers[buffers[i]]; } };
+  backend.m_deleteBuffers = [](GLsizei n, const GLuint *buffers) { for (GLsizei i = 0; i < n; ++i) g_gl.m_buffers.erase(buffers[i]); };
+  backend.m_bindBuffer = [](GLenum target, GLuint buffer) { MOCK_CHECK(target == GL_PIXEL_UNPACK_BUFFER); g_gl.m_bufferBound = buffer; };
+  backend.m_bufferData = [](GLenum, GLsizeiptr size, const void *, GLenum) { g_gl.m_buffers[g_gl.m_bufferBound].m_data.resize(std::size_t(size)); };
+  backend.m_bufferSubData = [](GLenum, GLintptr offset, GLsizeiptr size, const void *data) { memcpy(g_gl.m_buffers[g_gl.m_bufferBound].m_data.data() + offset, data, std::size_t(size)); };
+  backend.m_mapBufferRange = [](GLenum, GLintptr offset, GLsizeiptr length, GLbitfield) -> void*
+  {
+    s_mockBuffer &buffer = g_gl.m_buffers[g_gl.m_bufferBound];
+    MOCK_CHECK(!buffer.m_isMapped);
+    MOCK_CHECK(buffer.m_busyUntilFrame <= g_gl.m_frame); // the GPU must have consumed the buffer
+    MOCK_CHECK(std::size_t(offset + length) <= buffer.m_data.size());
+    buffer.m_isMapped = true;
+    memset(buffer.m_data.data(), 0xCD, buffer.m_data.size()); // invalidated
+    return buffer.m_data.data() + offset;
+  };
+  backend.m_unmapBuffer = [](GLenum) -> GLboolean { s_mockBuffer &buffer = g_gl.m_buffers[g_gl.m_bufferBound]; MOCK_CHECK(buffer.m_isMapped); buffer.m_isMapped = false; return GL_TRUE; };
+  backend.m_fenceSync = [](GLenum, GLbitfield) -> GLsync { ++g_gl.m_fenceCount; return reinterpret_cast<GLsync>(new s_mockFence{ g_gl.m_frame + g_gl.m_fenceLatency }); };
+  backend.m_clientWaitSync = [](GLsync sync, GLbitfield, GLuint64) -> GLenum { return reinterpret_cast<s_mockFence*>(sync)->m_signalFrame <= g_gl.m_frame ? GLenum(GL_ALREADY_SIGNALED) : GLenum(GL_TIMEOUT_EXPIRED); };
+  backend.m_deleteSync = [](GLsync sync) { --g_gl.m_fenceCount; delete reinterpret_cast<s_mockFence*>(sync); };
+  backend.m_bindTexture = [](GLenum, GLuint texture) { g_gl.m_textureBound = texture; };
+  backend.m_pixelStorei = [](GLenum pname, GLint param) { if (pname == GL_UNPACK_ALIGNMENT) g_gl.m_unpackAlignment = param; };
+  backend.m_texImage2D = [](GLenum, GLint level, GLint internalformat, GLsizei width, GLsizei height, GLint, GLenum format, GLenum, const void *pixels)
+                         { _mockCopy(g_gl.m_textureBound, level, 0, 0, width, height, false, std::size_t(width) * std::size_t(height) * _mockPixelSize(format), pixels, true, GLenum(internalformat)); };
+  backend.m_texImage3D = [](GLenum, GLint, GLint, GLsizei, GLsizei, GLsizei, GLint, GLenum, GLenum, const void *) { ++g_gl.m_errors; };
+  backend.m_texSubImage2D = [](GLenum, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum format, GLenum, const void *pixels)
+                            { _mockCopy(g_gl.m_textureBound, level, xoffset, yoffset, width, height, false, std::size_t(width) * std::size_t(height) * _mockPixelSize(format), pixels, false, 0); };
+  backend.m_texSubImage3D = [](GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLenum, const void *) { ++g_gl.m_errors; };
+  backend.m_compressedTexImage2D = [](GLenum, GLint level, GLenum internalformat, GLsizei width, GLsizei height, GLint, GLsizei imageSize, const void *data)
+                                   { _mockCopy(g_gl.m_textureBound, level, 0, 0, width, height, true, std::size_t(imageSize), data, true, internalformat); };
+  backend.m_compressedTexImage3D = [](GLenum, GLint, GLenum, GLsizei, GLsizei, GLsizei, GLint, GLsizei, const void *) { ++g_gl.m_errors; };
+  backend.m_compressedTexSubImage2D = [](GLenum, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height, GLenum, GLsizei imageSize, const void *data)
+                                      { _mockCopy(g_gl.m_textureBound, level, xoffset, yoffset, width, height, true, std::size_t(imageSize), data, false, 0); };
+  backend.m_compressedTexSubImage3D = [](GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLsizei, const void *) { ++g_gl.m_errors; };
+  return backend;
+}
+
+static void mockReset()
+{
+  g_gl = s_mockGL();
+}
+
+static void mockProcess(tre::textureUploader &uploader, std::size_t budget)
+{
+  uploader.process(budget);
+  MOCK_CHECK(g_gl.m_bufferBound == 0);
+  MOCK_CHECK(g_gl.m_unpackAlignment == 4);
+  ++g_gl.m_frame;
+}
+
+static void fillPixels(std::vector<uint8_t> &pixels, std::size_t byteSize, unsigned seed)
+{
+  pixels.resize(byteSize);
+  uint32_t state = seed * 2654435761u + 1u;
+  for (uint8_t &p : pixels) { state = state * 1664525u + 1013904223u; p = uint8_t(state >> 24); }
+}
+
+static bool checkImage(GLuint texture, GLint level, const std::vector<uint8_t> &pixels)
+{
+  const auto it = g_gl.m_images.find(uint64_t(texture) * 16 + uint64_t(level));
+  return it != g_gl.m_images.end() && it->second.m_data == pixels;
+}
+
+// =============================================================================
+
+static bool testBudget()
+{
+  bool status = true;
+  mockReset();
+
+  tre::textureUploader uploader;
+  status &= uploader.init(64 * 1024, 4, mockBackend());
+
+  // 12 allocations of 64x64 RGBA (16 KB), with a budget of 40 KB per frame
+
+  std::vector<std::vector<uint8_t>> sources(12);
+  std::vector<uint64_t>             tickets(12);
+  for (unsigned i = 0; i < 12; ++i)
+  {
+    fillPixels(sources[i], 64 * 64 * 4, i);
+    tre::textureUploader::s_request request;
+    request.m_texture = 100 + i;
+    request.m_w = 64;
+    request.m_h = 64;
+    request.m_internalFormat = GL_RGBA8;
+    tickets[i] = uploader.push(request, sources[i].data(), sources[i].size());
+    if (tickets[i] == 0 || (i != 0 && tickets[i] <= tickets[i - 1])) status = false;
+  }
+
+  std::size_t frameCount = 0;
+  std::size_t uploadCountPrev = 0;
+  while (!uploader.isIdle() && frameCount < 100)
+  {
+    mockProcess(uploader, 40 * 1024);
+    ++frameCount;
+    std::size_t frameBytes = 0;
+    for (std::size_t iU = uploadCountPrev; iU < g_gl.m_uploads.size(); ++iU) frameBytes += g_gl.m_uploads[iU].m_byteSize;
+    uploadCountPrev = g_gl.m_uploads.size();
+    if (frameBytes > 40 * 1024) status = false;
+  }
+
+  // order and content
+  for (unsigned i = 0; i < 12; ++i)
+  {
+    if (i >= g_gl.m_uploads.size() || g_gl.m_uploads[i].m_texture != 100 + i) status = false;
+    if (!checkImage(100 + i, 0, sources[i])) status = false;
+    if (!uploader.isComplete(tickets[i])) status = false;
+  }
+
+  const tre::textureUploader::s_stats stats = uploader.stats();
+  TRE_LOG("Budget: 12 requests of 16 KB, budget 40 KB: " << frameCount << " frames, " << stats.m_uploadCount << " uploads, max " << stats.m_frameBytesMax << " bytes per frame");
+  if (stats.m_frameBytesMax > 40 * 1024 || stats.m_uploadCount != 12 || frameCount > 10) status = false;
+
+  // a request larger than the budget is uploaded alone
+  {
+    std::vector<uint8_t> pixels;
+    fillPixels(pixels, 128 * 64 * 4, 77);
+    tre::textureUploader::s_request request;
+    request.m_texture = 200;
+    request.m_w = 128;
+    request.m_h = 64;
+    request.m_internalFormat = GL_RGBA8;
+    const uint64_t ticket = uploader.push(request, pixels.data(), pixels.size());
+    const std::size_t uploadCount = g_gl.m_uploads.size();
+    mockProcess(uploader, 1024);
+    if (g_gl.m_uploads.size() != uploadCount + 1 || !checkImage(200, 0, pixels)) status = false;
+    for (unsigned f = 0; f < g_gl.m_fenceLatency; ++f) mockProcess(uploader, 1024);
+    if (!uploader.isComplete(ticket) || !uploader.isIdle()) status = false;
+  }
+
+  uploader.clear();
+  if (g_gl.m_errors != 0 || g_gl.m_fenceCount != 0 || !g_gl.m_buffers.empty()) status = false;
+
+  if (!status) TRE_LOG("Budget: FAILED (" << g_gl.m_errors << " mock-GL errors)");
+  return status;
+}
+
+// =============================================================================
+
+static bool testSplit()
+{
+  bool status = true;
+  mockReset();
+
+  tre::textureUploader uploader;
+  status &= uploader.init(16 * 1024, 8, mockBackend());
+
+  // uncompressed sub-image (100x200 RGBA, 80 KB) into 16 KB buffers: bands of 40 rows
+
+  {
+    std::vector<uint8_t> allocPixels(128 * 256 * 4, 0);
+    g_gl.m_images[300 * 16] = s_mockImage{ 128, 256, 4, false, allocPixels };
+
+    std::vector<uint8_t> pixels;
+    fillPixels(pixels, 100 * 200 * 4, 3);
+    tre::textureUploader::s_request request;
+    request.m_texture = 300;
+    request.m_x = 16;
+    request.m_y = 24;
+    request.m_w = 100;
+    request.m_h = 200;
+    const uint64_t ticket = uploader.push(request, pixels.data(), pixels.size());
+    while (!uploader.isIdle() && g_gl.m_frame < 100) mockProcess(uploader, 1024 * 1024);
+
+    for (unsigned j = 0; j < 200; ++j) std::memcpy(allocPixels.data() + ((24 + j) * 128 + 16) * 4, pixels.data() + j * 100 * 4, 100 * 4);
+    if (!checkImage(300, 0, allocPixels) || !uploader.isComplete(ticket)) status = false;
+
+    GLint yNext = 24;
+    for (const s_mockUpload &upload : g_gl.m_uploads)
+    {
+      if (upload.m_y != yNext || upload.m_byteSize > 16 * 1024) status = false;
+      yNext += upload.m_h;
+    }
+    TRE_LOG("Split: 80 KB sub-image into 16 KB buffers: " << g_gl.m_uploads.size() << " bands");
+    if (yNext != 224 || g_gl.m_uploads.size() != 5) status = false;
+  }
+
+  // compressed level (256x256 with 8 bytes per block, 32 KB) into 16 KB buffers: bands of complete block-rows
+
+  {
+    g_gl.m_uploads.clear();
+    std::vector<uint8_t> pixels;
+    fillPixels(pixels, 64 * 64 * 8, 4);
+    g_gl.m_images[301 * 16 + 2] = s_mockImage{ 256, 256, 8, true, std::vector<uint8_t>(pixels.size(), 0) };
+
+    tre::textureUploader::s_request request;
+    request.m_texture = 301;
+    request.m_level = 2;
+    request.m_w = 256;
+    request.m_h = 256;
+    request.m_format = GL_COMPRESSED_RGB8_ETC2;
+    request.m_type = GL_NONE;
+    const uint64_t ticket = uploader.push(request, pixels.data(), pixels.size());
+    while (!uploader.isIdle() && g_gl.m_frame < 200) mockProcess(uploader, 1024 * 1024);
+
+    if (!checkImage(301, 2, pixels) || !uploader.isComplete(ticket) || g_gl.m_uploads.size() < 2) status = false;
+    for (const s_mockUpload &upload : g_gl.m_uploads)
+      if (!upload.m_isCompressed || upload.m_y % 4 != 0) status = false;
+  }
+
+  // an allocation larger than a buffer is rejected
+
+  {
+    std::vector<uint8_t> pixels;
+    fillPixels(pixels, 128 * 64 * 4, 5);
+    tre::textureUploader::s_request request;
+    request.m_texture = 302;
+    request.m_w = 128;
+    request.m_h = 64;
+    request.m_internalFormat = GL_RGBA8;
+    if (uploader.push(request, pixels.data(), pixels.size()) != 0 || uploader.stats().m_rejectCount != 1) status = false;
+  }
+
+  uploader.clear();
+  if (g_gl.m_errors != 0 || g_gl.m_fenceCount != 0) status = false;
+
+  if (!status) TRE_LOG("Split: FAILED (" << g_gl.m_errors << " mock-GL errors)");
+  return status;
+}
+
+// =============================================================================
+
+static bool testBackPressure()
+{
+  bool status = true;
+  mockReset();
+  g_gl.m_fenceLatency = 3;
+
+  tre::textureUploader uploader;
+  status &= uploader.init(16 * 1024, 3, mockBackend());
+
+  std::vector<uint8_t> pixels;
+  fillPixels(pixels, 32 * 32 * 4, 6); // 4 KB
+
+  tre::textureUploader::s_request request;
+  request.m_w = 32;
+  request.m_h = 32;
+  request.m_internalFormat = GL_RGBA8;
+
+  // fill the 3 buffers (12 requests), then the push is rejected
+  unsigned accepted = 0;
+  for (unsigned i = 0; i < 16; ++i)
+  {
+    request.m_texture = 400 + i;
+    if (uploader.push(request, pixels.data(), pixels.size()) != 0) ++accepted;
+  }
+  if (accepted != 12 || uploader.stats().m_rejectCount != 4) status = false;
+
+  // the buffers are released once their fence is signaled
+  std::size_t frameRoom = 0;
+  for (unsigned f = 0; f < 10 && frameRoom == 0; ++f)
+  {
+    mockProcess(uploader, 1024 * 1024);
+    request.m_texture = 450;
+    if (uploader.push(request, pixels.data(), pixels.size()) != 0) frameRoom = g_gl.m_frame;
+  }
+  TRE_LOG("BackPressure: " << accepted << " requests accepted, the room is back after " << frameRoom << " frames (fence latency " << g_gl.m_fenceLatency << ")");
+  if (frameRoom != g_gl.m_fenceLatency + 1) status = false;
+
+  while (!uploader.isIdle() && g_gl.m_frame < 100) mockProcess(uploader, 1024 * 1024);
+  for (unsigned i = 0; i < 12; ++i) if (!checkImage(400 + i, 0, pixels)) status = false;
+  if (!checkImage(450, 0, pixels)) status = false;
+
+  uploader.clear();
+  if (g_gl.m_errors != 0 || g_gl.m_fenceCount != 0) status = false;
+
+  if (!status) TRE_LOG("BackPressure: FAILED (" << g_gl.m_errors << " mock-GL errors)");
+  return status;
+}
+
+// =============================================================================
+
+static bool testProducers()
+{
+  bool status = true;
+  mockReset();
+
+  tre::textureUploader uploader;
+  status &= uploader.init(64 * 1024, 4, mockBackend());
+
+  const unsigned threadCount = 4;
+  const unsigned requestPerThread = 60;
+
+  // each request updates the rows of its own texture
+
+  struct s_job
+  {
+    GLuint               m_texture;
+    unsigned             m_w, m_h;
+    std::vector<uint8_t> m_pixels;
+    uint64_t             m_ticket = 0;
+  };
+  std::vector<s_job> jobs(threadCount * requestPerThread);
+  std::mt19937 rng(17);
+  for (std::size_t iJ = 0; iJ < jobs.size(); ++iJ)
+  {
+    s_job &job = jobs[iJ];
+    job.m_texture = GLuint(1000 + iJ);
+    job.m_w = 16u << (rng() % 4);
+    job.m_h = 16u << (rng() % 5); // up to 128x256 RGBA (128 KB, larger than a buffer)
+    fillPixels(job.m_pixels, job.m_w * job.m_h * 4, unsigned(iJ));
+    g_gl.m_images[uint64_t(job.m_texture) * 16] = s_mockImage{ job.m_w, job.m_h, 4, false, std::vector<uint8_t>(job.m_pixels.size(), 0) };
+  }
+
+  std::atomic<unsigned> threadDone(0);
+  const systemtick tStart = systemclock::now();
+
+  std::vector<std::thread> threads;
+  for (unsigned iT = 0; iT < threadCount; ++iT)
+  {
+    threads.emplace_back([&, iT]()
+    {
+      for (unsigned iR = 0; iR < requestPerThread; ++iR)
+      {
+        s_job &job = jobs[iT * requestPerThread + iR];
+        tre::textureUploader::s_request request;
+        request.m_texture = job.m_texture;
+        request.m_w = GLsizei(job.m_w);
+        request.m_h = GLsizei(job.m_h);
+        job.m_ticket = uploader.push(request, job.m_pixels.data(), job.m_pixels.size(), true);
+      }
+      ++threadDone;
+    });
+  }
+
+  std::size_t frameCount = 0;
+  while (threadDone.load() != threadCount || !uploader.isIdle())
+  {
+    mockProcess(uploader, 96 * 1024);
+    ++frameCount;
+    std::this_thread::yield();
+  }
+  for (std::thread &t : threads) t.join();
+
+  const float elapsed = _elapsedMs(tStart);
+
+  std::size_t nError = 0;
+  for (const s_job &job : jobs)
+  {
+    if (job.m_ticket == 0 || !uploader.isComplete(job.m_ticket)) ++nError;
+    if (!checkImage(job.m_texture, 0, job.m_pixels)) ++nError;
+  }
+
+  const tre::textureUploader::s_stats stats = uploader.stats();
+  TRE_LOG("Producers: " << threadCount << " threads, " << jobs.size() << " requests, " << stats.m_uploadBytes / 1024 << " KB in " << frameCount << " frames (max "
+          << stats.m_frameBytesMax / 1024 << " KB per frame), " << nError << " error(s), in " << elapsed << " ms");
+  if (nError != 0 || stats.m_pushCount != jobs.size() || stats.m_frameBytesMax > 96 * 1024) status = false;
+
+  uploader.clear();
+  if (g_gl.m_errors != 0 || g_gl.m_fenceCount != 0) status = false;
+
+  if (!status) TRE_LOG("Producers: FAILED (" << g_gl.m_errors << " mock-GL errors)");
+  return status;
+}
+
+// =============================================================================
+
+int main(int argc, char **argv)
+{
+  (void)argc;
+  (void)argv;
+
+  bool status = true;
+
+  status &= testBudget();
+  status &= testSplit();
+  status &= testBackPressure();
+  status &= testProducers();
+
+  TRE_LOG("Quit.");
+
+  return (status ? 0 : -1);
+}
@@ -1,6 +1,7 @@
 
 #include <vector>
 #include <array>
+#include <atomic>
 
 #include "tre_utils.h"
 #include "tre_ui.h"
@@ -251,9 +252,9 @@ public:
   unsigned m_tickid = 0; // read-back
 
 protected:
-  unsigned ac_cursor = 0;
-  unsigned ac_tempo = 0; // current tempo
-  unsigned ac_tickid = 0;
+  unsigned              ac_cursor = 0;
+  std::atomic<unsigned> ac_tempo = { 0 }; // current tempo
+  std::atomic<unsigned> ac_tickid = { 0 };
 
 public:
   virtual void sync() override final
@@ -342,12 +343,13 @@ public:
 
   int      freq = 0; ///< sampling frequency [Hz]
 protected:
-  bool     ac_play = false;
-  float    ac_volume = 0.f;
-  unsigned ac_playCursorStart = 0; ///< [sampleIndex], in played audio
-  unsigned ac_playCursorEnd   = 0; ///< [sampleIndex], in played audio
-  unsigned ac_playCursor      = 0; ///< [sampleIndex], in played audio
-  std::size_t ac_audioPlayDataSizeLast = 0;
+  std::atomic<bool>     ac_play = { false };
+  float                 ac_volume = 0.f;
+  std::atomic<unsigned> ac_playCursorStart = { 0 }; ///< [sampleIndex], in played audio
+  std::atomic<unsigned> ac_playCursorEnd   = { 0 }; ///< [sampleIndex], in played audio
+  std::atomic<unsigned> ac_playCursor      = { 0 }; ///< [sampleIndex], in played audio (read-back)
+  std::atomic<unsigned> ac_playCursorSet   = { unsigned(-1) }; ///< [sampleIndex], in played audio (set when valid)
+  std::size_t           ac_audioPlayDataSizeLast = 0;
 
 public:
 
@@ -389,27 +391,34 @@ public:
     ac_play = m_play;
     ac_playCursorStart = unsigned(m_playCursorStart * psc);
     ac_playCursorEnd   = unsigned(m_playCursorEnd   * psc);
-    if (m_playCursorSet >= 0.f) { ac_playCursor = unsigned(m_playCursorSet * psc); m_playCursorSet = -1.f; }
-    else if (psc != ac_audioPlayDataSizeLast) { ac_playCursor = unsigned(m_playCursor * psc);  }
+    if (m_playCursorSet >= 0.f) { ac_playCursorSet = unsigned(m_playCursorSet * psc); m_playCursorSet = -1.f; }
+    else if (psc != ac_audioPlayDataSizeLast) { ac_playCursorSet = unsigned(m_playCursor * psc);  }
     ac_audioPlayDataSizeLast = psc;
   }
 
   virtual void sample(float* __restrict outBufferAdd, unsigned sampleCount, int sampleFreq) override final
   {
     freq = sampleFreq;
+
+    unsigned playCursor = ac_playCursorSet.exchange(unsigned(-1));
+    if (playCursor == unsigned(-1)) playCursor = ac_playCursor;
+    else                            ac_playCursor = playCursor;
+
     if (!ac_play) return;
 
+    const unsigned playCursorStart = ac_playCursorStart; // local copy
+    const unsigned playCursorEnd = ac_playCursorEnd; // local copy
     const unsigned blockCount = unsigned(m_audioPlayBlockFlag.size());
     const unsigned overlap = unsigned(m_audioPlaySamplesDataPerBlock - m_audioPlaySamplesDataPerBlock);
 
-    for (unsigned i = 0; i < sampleCount; ++i, ++ac_playCursor)
+    for (unsigned i = 0; i < sampleCount; ++i, ++playCursor)
     {
       ac_volume = ac_volume * 0.9f + m_volume * 0.1f;
 
-      const unsigned blockId = ac_playCursor / unsigned(m_audioPlaySamplesRealPerBlock);
-      const unsigned posInBlock = ac_playCursor - blockId * unsigned(m_audioPlaySamplesRealPerBlock);
+      const unsigned blockId = playCursor / unsigned(m_audioPlaySamplesRealPerBlock);
+      const unsigned posInBlock = playCursor - blockId * unsigned(m_audioPlaySamplesRealPerBlock);
 
-      if (ac_playCursor >= ac_playCursorEnd) ac_playCursor = ac_playCursorStart - 1;
+      if (playCursor >= playCursorEnd) playCursor = playCursorStart - 1;
       if (blockId >= blockCount) continue;
 
       float v = m_audioPlayBlockData[blockId * unsigned(m_audioPlaySamplesDataPerBlock) + posInBlock];
@@ -424,6 +433,7 @@ public:
       outBufferAdd[2*i+1] += v;
     }
 
+    ac_playCursor = playCursor;
   }
 };
 